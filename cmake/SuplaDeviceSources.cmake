@@ -11,8 +11,10 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/channels/channel_types.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/channels/binary_sensor_channel.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/channels/channel_extended.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/channels/reporting_policy.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/io.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/io/io_pin.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/io/port_snapshot.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/tools.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/element.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/local_action.cpp
@@ -51,6 +53,7 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/channel_conflict_resolver.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/status_led.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/sw_update.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/device/delta_patch.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/remote_device_config.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/notifications.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/enter_cfg_mode_after_power_cycle.cpp
@@ -59,6 +62,7 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/device/security_logger.cpp
 
   ${SUPLA_DEVICE_SRC_DIR}/supla/debug/command_processor.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/debug/async_log.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/debug/debug_log.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/debug/debug_log_tcp_server.cpp
 
@@ -76,12 +80,14 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/storage/state_wear_leveling_sector.cpp
 
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/assignment_applier.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/binary_definition.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/calcfg_handler.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/capability_registry.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/channel_map.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/definition.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/definition_cache.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/json_definition.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/json_definition_stream.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/json_instance_config.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/manager.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/suplet/registry.cpp
@@ -145,6 +151,7 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/div.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/hide_show_container.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/channel_correction.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/channel_reporting_policy.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/hvac_parameters.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/container_parameters.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/network/html/pwm_frequency_parameters.cpp
@@ -202,6 +209,7 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/binary.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/binary_base.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/electricity_meter.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/em_aggregation.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/hygro_meter.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/impulse_counter.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/virtual_impulse_counter.cpp
@@ -210,6 +218,7 @@ set(SUPLA_DEVICE_SRCS
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/therm_hygro_press_meter.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/thermometer.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/thermometer_driver.cpp
+  ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/ds_conversion_scheduler.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/multi_ds_sensor.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/multi_ds_handler_base.cpp
   ${SUPLA_DEVICE_SRC_DIR}/supla/sensor/general_purpose_channel_base.cpp
@@ -17,10 +17,14 @@
 // Below includes are added just for CI compilation check. Some of them
 // are not used in any cpp file, so they would not be compiled otherwise.
 // Remove them and keep only required one in real application.
+#include <linux_async_log.h>
+#include <linux_client.h>
 #include <linux_clock.h>
 #include <linux_file_state_logger.h>
 #include <linux_file_storage.h>
+#include <linux_modbus_tcp_server.h>
 #include <linux_mqtt_client.h>
+#include <linux_sw_update.h>
 #include <linux_yaml_config.h>
 #include <supla/IEEE754tools.h>
 #include <supla/action_handler.h>
@@ -80,6 +84,12 @@
 int logLevel = LOG_INFO;
 int runAsDaemon = 0;
 
+namespace {
+// Static, so it is stopped (and remaining records are written) also when
+// application ends with exit()
+std::unique_ptr<Supla::Linux::AsyncLogWorker> asyncLogWorker;
+}  // namespace
+
 int main(int argc, char *argv[]) {
   try {
     cxxopts::Options options(argv[0], "Supla device client. See www.supla.org");
@@ -98,6 +108,8 @@ int main(int argc, char *argv[]) {
         "debug-log-port",
         "Stream SUPLA logs over insecure TCP port, 0 disables",
         cxxopts::value<uint16_t>()->default_value("0"))(
+        "async-log",
+        "Format and write logs on a low priority thread")(
         "d,daemon", "Run in daemon mode (run in background and log to syslog)")(
         "s,service", "Run as a service (log to syslog but don't fork)")(
         "h,help", "Show this help")("v,version", "Show version");
@@ -162,6 +174,11 @@ int main(int argc, char *argv[]) {
     }
     SuplaDevice.setLogLevel(logLevel);
 
+    if (result.count("async-log") || config->isAsyncLog()) {
+      asyncLogWorker = std::make_unique<Supla::Linux::AsyncLogWorker>();
+      asyncLogWorker->start();
+    }
+
     SUPLA_LOG_INFO(" *** Starting supla-device ***");
     SUPLA_LOG_INFO("Using config file %s", cfgFile.c_str());
 
@@ -179,6 +196,8 @@ int main(int argc, char *argv[]) {
 
     SuplaDevice.setLastStateLogger(
         new Supla::Device::FileStateLogger(config->getStateFilesPath()));
+    Supla::LinuxSwUpdate::SetSlotsPath(config->getStateFilesPath() +
+                                       "/firmware");
     Supla::LinuxNetwork network;
 
     if (!setupLinuxSupletRuntime(config.get())) {
@@ -186,6 +205,10 @@ int main(int argc, char *argv[]) {
       exit(1);
     }
 
+    if (config->isNonBlockingConnect()) {
+      Supla::LinuxClient::SetNonBlockingConnect(true);
+    }
+
     SuplaDevice.setProtoVerboseLog(config->isProtoVerboseLog());
     SuplaDevice.begin(config->getProtoVersion());
 
@@ -211,6 +234,7 @@ int main(int argc, char *argv[]) {
       delay(10);
     }
     SUPLA_LOG_INFO("Exit");
+    asyncLogWorker.reset();
 
     exit(0);
   } catch (const cxxopts::exceptions::exception &e) {
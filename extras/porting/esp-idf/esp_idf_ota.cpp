@@ -137,119 +137,8 @@ void Supla::EspIdfOta::iterate() {
 
   char queryParams[URL_SIZE] = {};
   char buf[BUF_SIZE] = {};
-  int curPos = 0;
-
-  int v = 0;
-
-  while (1) {
-    v = stringAppend(
-        queryParams + curPos, "manufacturerId=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    snprintf(
-        buf, sizeof(buf), "%d", Supla::RegisterDevice::getManufacturerId());
-    v = stringAppend(queryParams + curPos, buf, URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-
-    v = stringAppend(
-        queryParams + curPos, "&productId=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    snprintf(buf, sizeof(buf), "%d", Supla::RegisterDevice::getProductId());
-    v = stringAppend(queryParams + curPos, buf, URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-
-    v = stringAppend(
-        queryParams + curPos, "&productName=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    urlEncode(Supla::RegisterDevice::getName(), buf, BUF_SIZE);
-    v = stringAppend(queryParams + curPos, buf, URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-
-    v = stringAppend(queryParams + curPos, "&platform=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    snprintf(buf, sizeof(buf), "%d", Supla::getPlatformId());
-    v = stringAppend(queryParams + curPos, buf, URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-
-    v = stringAppend(queryParams + curPos, "&version=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    urlEncode(Supla::RegisterDevice::getSoftVer(), buf, BUF_SIZE);
-    v = stringAppend(queryParams + curPos, buf, URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-
-    v = stringAppend(queryParams + curPos, "&guidHash=", URL_SIZE - curPos - 1);
-    if (v == 0) break;
-    curPos += v;
-    {
-      Supla::Sha256 hash;
-      hash.update(
-          reinterpret_cast<const uint8_t *>(Supla::RegisterDevice::getGUID()),
-          SUPLA_GUID_SIZE);
-
-      uint8_t sha[32] = {};
-      hash.digest(sha);
-
-      if (curPos < URL_SIZE - 1 - 32 * 2) {
-        curPos += generateHexString(sha, queryParams + curPos, 32);
-      } else {
-        v = 0;
-        break;
-      }
-    }
-
-    if (!Supla::RegisterDevice::isEmailEmpty()) {
-      v = stringAppend(
-          queryParams + curPos, "&userEmailHash=", URL_SIZE - curPos - 1);
-      if (v == 0) break;
-      curPos += v;
-      Supla::Sha256 hash;
-      strncpy(buf, Supla::RegisterDevice::getEmail(), BUF_SIZE - 1);
-      buf[BUF_SIZE - 1] = '\0';
-      auto bufPtr = buf;
-      int size = 0;
-      while (*bufPtr) {
-        *bufPtr = tolower(*bufPtr);
-        bufPtr++;
-        size++;
-      }
-      hash.update(reinterpret_cast<uint8_t *>(buf), size);
-      uint8_t sha[32] = {};
-      hash.digest(sha);
-      if (curPos < URL_SIZE - 1 - 32 * 2) {
-        curPos += generateHexString(sha, queryParams + curPos, 32);
-      } else {
-        v = 0;
-        break;
-      }
-    }
-
-    if (beta) {
-      v = stringAppend(
-          queryParams + curPos, "&beta=true", URL_SIZE - curPos - 1);
-      if (v == 0) break;
-      curPos += v;
-    }
-
-    if (isSecurityOnly()) {
-      v = stringAppend(
-          queryParams + curPos, "&securityOnly=true", URL_SIZE - curPos - 1);
-      if (v == 0) break;
-      curPos += v;
-    }
-
-    break;
-  }
 
-  if (v == 0) {
+  if (!generateCheckUpdateQuery(queryParams, URL_SIZE)) {
     fail("SW update: fail - too long request url");
     return;
   }
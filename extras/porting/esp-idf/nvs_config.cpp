@@ -261,6 +261,61 @@ bool NvsConfig::eraseKey(const char* key) {
   return err == ESP_OK;
 }
 
+bool NvsConfig::isKeyIterationSupported() const {
+  return true;
+}
+
+bool NvsConfig::findFirstKey(ConfigKeyCursor* cursor) {
+  if (cursor == nullptr || nvsPartitionName == nullptr) {
+    return false;
+  }
+  if (cursor->owner) {
+    cursor->owner->releaseKeyCursor(cursor);
+  }
+  nvs_iterator_t it = nullptr;
+  esp_err_t err =
+      nvs_entry_find(nvsPartitionName, "supla", NVS_TYPE_ANY, &it);
+  if (err != ESP_OK || it == nullptr) {
+    return false;
+  }
+  cursor->owner = this;
+  cursor->handle = it;
+  return findKeyFromIterator(cursor, false);
+}
+
+bool NvsConfig::findNextKey(ConfigKeyCursor* cursor) {
+  if (cursor == nullptr || cursor->owner != this) {
+    return false;
+  }
+  return findKeyFromIterator(cursor, true);
+}
+
+bool NvsConfig::findKeyFromIterator(ConfigKeyCursor* cursor, bool advance) {
+  nvs_iterator_t it = static_cast<nvs_iterator_t>(cursor->handle);
+  while (it != nullptr) {
+    // nvs_entry_next releases iterator and sets it to null at the end
+    if (advance && nvs_entry_next(&it) != ESP_OK) {
+      break;
+    }
+    advance = true;
+    nvs_entry_info_t info = {};
+    if (nvs_entry_info(it, &info) == ESP_OK && cursor->match(info.key)) {
+      cursor->handle = it;
+      return true;
+    }
+  }
+  cursor->handle = it;
+  return false;
+}
+
+void NvsConfig::releaseKeyCursor(ConfigKeyCursor* cursor) {
+  if (cursor != nullptr && cursor->owner == this &&
+      cursor->handle != nullptr) {
+    nvs_release_iterator(static_cast<nvs_iterator_t>(cursor->handle));
+  }
+  Config::releaseKeyCursor(cursor);
+}
+
 // Generic getters and setters
 bool NvsConfig::setString(const char* key, const char* value) {
   esp_err_t err = nvs_set_str(nvsHandle, key, value);
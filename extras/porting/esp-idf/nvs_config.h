@@ -50,10 +50,16 @@ class NvsConfig : public Config {
   bool setUInt32(const char* key, const uint32_t value) override;
   bool eraseKey(const char* key) override;
 
+  bool isKeyIterationSupported() const override;
+  bool findFirstKey(ConfigKeyCursor* cursor) override;
+  bool findNextKey(ConfigKeyCursor* cursor) override;
+  void releaseKeyCursor(ConfigKeyCursor* cursor) override;
+
   void commit() override;
 
  protected:
   int getBlobSize(const char* key) override;
+  bool findKeyFromIterator(ConfigKeyCursor* cursor, bool advance);
   bool readDataPartition(int offset, char* buffer, int size);
   bool readDataPartitionImp(int address, char* buf, int size);
   bool initDeviceDataPartitionCopyAndChecksum();
@@ -70,17 +70,24 @@ set(SUPLA_DEVICE_LINUX_SRCS
 
   ${SUPLA_LINUX_PORT_DIR}/linux_timers.cpp
   ${SUPLA_LINUX_PORT_DIR}/linux_clock.cpp
+  ${SUPLA_LINUX_PORT_DIR}/linux_async_log.cpp
+  ${SUPLA_LINUX_PORT_DIR}/linux_modbus_tcp_server.cpp
+  ${SUPLA_LINUX_PORT_DIR}/linux_sw_update.cpp
 
   ${SUPLA_LINUX_PORT_DIR}/supla/custom_channel.cpp
 
   ${SUPLA_LINUX_PORT_DIR}/supla/source/cmd.cpp
+  ${SUPLA_LINUX_PORT_DIR}/supla/source/coprocess.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/linux_command.cpp
+  ${SUPLA_LINUX_PORT_DIR}/supla/command_executor.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/source/file.cpp
+  ${SUPLA_LINUX_PORT_DIR}/supla/source/modbus.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/source/mqtt_src.cpp
 
   ${SUPLA_LINUX_PORT_DIR}/supla/parser/parser.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/parser/simple.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/parser/json.cpp
+  ${SUPLA_LINUX_PORT_DIR}/supla/parser/modbus.cpp
 
   ${SUPLA_LINUX_PORT_DIR}/supla/output/cmd.cpp
   ${SUPLA_LINUX_PORT_DIR}/supla/output/file.cpp
@@ -119,6 +126,8 @@ set(SUPLA_DEVICE_LINUX_SRCS
   ${_SUPLA_ROOT_FROM_LINUX}/src/supla/pv/fronius.cpp
   ${_SUPLA_ROOT_FROM_LINUX}/src/supla/pv/solaredge.cpp
   ${_SUPLA_ROOT_FROM_LINUX}/src/supla/pv/afore.cpp
+  ${_SUPLA_ROOT_FROM_LINUX}/src/supla/pv/http_poller.cpp
+  ${_SUPLA_ROOT_FROM_LINUX}/src/supla/pv/json_stream_tokenizer.cpp
 
   ${_SUPLA_ROOT_FROM_LINUX}/src/supla-common/tools.c
   ${_SUPLA_ROOT_FROM_LINUX}/src/supla-common/eh.c
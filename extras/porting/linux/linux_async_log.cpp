@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "linux_async_log.h"
+
+#include <supla/log_wrapper.h>
+#include <supla/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+// lowered priority of log worker thread (nice value)
+constexpr int AsyncLogWorkerNice = 10;
+constexpr int AsyncLogWorkerIdleDelayMs = 5;
+}  // namespace
+
+Supla::Linux::AsyncLogWorker::AsyncLogWorker(uint32_t capacity)
+    : asyncLog(supla_vlog, capacity), running(false) {
+  // logs are queued only while worker thread is running
+  asyncLog.unregisterInstance();
+}
+
+Supla::Linux::AsyncLogWorker::~AsyncLogWorker() {
+  stop();
+}
+
+bool Supla::Linux::AsyncLogWorker::start() {
+  if (running) {
+    return true;
+  }
+  running = true;
+  worker = std::thread(&AsyncLogWorker::run, this);
+  asyncLog.registerInstance();
+  return true;
+}
+
+void Supla::Linux::AsyncLogWorker::stop() {
+  asyncLog.unregisterInstance();
+  if (running.exchange(false) && worker.joinable()) {
+    worker.join();
+  }
+  // flush whatever is left in the queue on the calling thread
+  asyncLog.drain();
+}
+
+void Supla::Linux::AsyncLogWorker::run() {
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  setpriority(PRIO_PROCESS, tid, AsyncLogWorkerNice);
+
+  while (running) {
+    if (asyncLog.drain() == 0) {
+      delay(AsyncLogWorkerIdleDelayMs);
+    }
+  }
+}
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_LINUX_ASYNC_LOG_H_
+#define EXTRAS_PORTING_LINUX_LINUX_ASYNC_LOG_H_
+
+#include <supla/debug/async_log.h>
+
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+
+namespace Supla {
+namespace Linux {
+
+/**
+ * Low priority thread which drains Supla::Debug::AsyncLog queue and writes
+ * records to supla_vlog (stdout/syslog and debug log sinks).
+ *
+ * Requires SUPLA_ASYNC_LOG define, otherwise SUPLA_LOG_* macros write
+ * synchronously and queue stays empty.
+ */
+class AsyncLogWorker {
+ public:
+  explicit AsyncLogWorker(uint32_t capacity = 1024);
+  ~AsyncLogWorker();
+
+  bool start();
+  void stop();
+
+ private:
+  void run();
+
+  Supla::Debug::AsyncLog asyncLog;
+  std::thread worker;
+  std::atomic<bool> running;
+};
+
+}  // namespace Linux
+}  // namespace Supla
+
+#endif  // EXTRAS_PORTING_LINUX_LINUX_ASYNC_LOG_H_
@@ -18,9 +18,32 @@
 #include <openssl/err.h>
 #include <openssl/pem.h>
 #include <openssl/x509_vfy.h>
+#include <SuplaDevice.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
 
 #include "linux_client.h"
 
+namespace {
+
+bool defaultNonBlockingConnect = false;
+// guards sessionCache and tlsStats
+std::mutex sessionCacheMutex;
+std::map<std::string, SSL_SESSION *> sessionCache;
+Supla::LinuxTlsStats tlsStats;
+
+uint64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
 Supla::LinuxClient::LinuxClient() {
 }
 
@@ -33,6 +56,11 @@ Supla::LinuxClient::~LinuxClient() {
 }
 
 bool Supla::LinuxClient::setupSslContext() {
+  if (ctx && ctxRootCACert == rootCACert &&
+      ctxUseDefaultCACerts == useDefaultCACerts) {
+    return true;
+  }
+
   if (ctx) {
     SSL_CTX_free(ctx);
     ctx = nullptr;
@@ -52,6 +80,20 @@ bool Supla::LinuxClient::setupSslContext() {
     return false;
   }
 
+  // Sessions are stored only in our cache (keyed by host and port), so they
+  // can be offered on reconnect
+  SSL_CTX_set_session_cache_mode(
+      ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, NewSessionCallback);
+  ctxRootCACert = rootCACert;
+  ctxUseDefaultCACerts = useDefaultCACerts;
+  if (rootCACert != nullptr) {
+    ctxTrustTag =
+        "ca" + std::to_string(std::hash<std::string>{}(rootCACert));
+  } else {
+    ctxTrustTag = useDefaultCACerts ? "default" : "none";
+  }
+
   if (rootCACert == nullptr && !useDefaultCACerts) {
     SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
     return true;
@@ -137,8 +179,19 @@ bool Supla::LinuxClient::setupSslContext() {
 int Supla::LinuxClient::connectImp(const char *server, uint16_t port) {
   stop();
 
+  if (!startConnect(server, port)) {
+    return 0;
+  }
+
+  if (nonBlockingConnect || defaultNonBlockingConnect) {
+    return iterateConnect(0) ? 1 : 0;
+  }
+
+  return finishConnect() ? 1 : 0;
+}
+
+bool Supla::LinuxClient::startConnect(const char *server, uint16_t port) {
   struct addrinfo hints = {};
-  struct addrinfo *addresses = {};
   hints.ai_family = AF_INET;
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_protocol = IPPROTO_TCP;
@@ -149,148 +202,254 @@ int Supla::LinuxClient::connectImp(const char *server, uint16_t port) {
   const int status = getaddrinfo(server, portStr, &hints, &addresses);
   if (status != 0) {
     SUPLA_LOG_ERROR("%s: %s", server, gai_strerror(status));
-    return 0;
+    addresses = nullptr;
+    return false;
   }
 
-  int err = 0;
-  int flagsCopy = 0;
-  for (struct addrinfo *addr = addresses; addr != nullptr;
-       addr = addr->ai_next) {
+  connectHost = server;
+  connectPort = port;
+  lastConnectError = 0;
+  nextAddress = addresses;
+  stepStartMs = nowMs();
+  return startNextAddress();
+}
+
+bool Supla::LinuxClient::startNextAddress() {
+  while (nextAddress != nullptr) {
+    struct addrinfo *addr = nextAddress;
+    nextAddress = addr->ai_next;
+
     connectionFd = socket(
         addr->ai_family, addr->ai_socktype, addr->ai_protocol);
     if (connectionFd == -1) {
-      err = errno;
+      lastConnectError = errno;
       continue;
     }
 
-    flagsCopy = ::fcntl(connectionFd, F_GETFL, 0);
-    if (flagsCopy == -1) {
-      err = errno;
-      ::close(connectionFd);
-      connectionFd = -1;
-      continue;
-    }
-    struct timeval timeout = {};
-    timeout.tv_sec = 10;
-    ::setsockopt(
-        connectionFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    ::setsockopt(
-        connectionFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-    if (::fcntl(connectionFd, F_SETFL, flagsCopy | O_NONBLOCK) == -1) {
-      err = errno;
+    int flags = ::fcntl(connectionFd, F_GETFL, 0);
+    if (flags == -1 ||
+        ::fcntl(connectionFd, F_SETFL, flags | O_NONBLOCK) == -1) {
+      lastConnectError = errno;
       ::close(connectionFd);
       connectionFd = -1;
       continue;
     }
+
     if (::connect(connectionFd, addr->ai_addr, addr->ai_addrlen) == 0) {
-      if (::fcntl(connectionFd, F_SETFL, flagsCopy) == -1) {
-        err = errno;
-        srcIp = 0;
-        ::close(connectionFd);
-        connectionFd = -1;
-        continue;
-      }
-      break;
+      onTcpConnected();
+      return connectState != ConnectState::IDLE;
+    }
+
+    if (errno == EINPROGRESS || errno == EWOULDBLOCK) {
+      connectState = ConnectState::TCP_CONNECTING;
+      return true;
     }
 
-    err = errno;
-    bool isConnected = false;
+    lastConnectError = errno;
+    ::close(connectionFd);
+    connectionFd = -1;
+  }
 
-    if (errno == EWOULDBLOCK || errno == EINPROGRESS) {
+  SUPLA_LOG_ERROR("%s: %s", connectHost.c_str(), strerror(lastConnectError));
+  failConnect();
+  return false;
+}
+
+bool Supla::LinuxClient::iterateConnect(int waitMs) {
+  switch (connectState) {
+    case ConnectState::TCP_CONNECTING: {
       struct pollfd pfd = {};
       pfd.fd = connectionFd;
       pfd.events = POLLOUT;
-
-      int result = ::poll(&pfd, 1, timeoutMs);
+      syscallStats.polls++;
+      int result = ::poll(&pfd, 1, waitMs);
       if (result > 0) {
+        int err = 0;
         socklen_t len = sizeof(err);
-        int retval =
-            ::getsockopt(connectionFd, SOL_SOCKET, SO_ERROR, &err, &len);
-
-        if (retval == 0 && err == 0) {
-          isConnected = true;
+        if (::getsockopt(connectionFd, SOL_SOCKET, SO_ERROR, &err, &len) !=
+            0) {
+          err = errno;
+        }
+        if (err == 0) {
+          onTcpConnected();
+          break;
         }
+        lastConnectError = err;
+      } else if (result < 0 && errno != EINTR) {
+        lastConnectError = errno;
+      } else if (nowMs() - stepStartMs > timeoutMs) {
+        lastConnectError = ETIMEDOUT;
+      } else {
+        break;
       }
-    }
-
-    if (::fcntl(connectionFd, F_SETFL, flagsCopy) == -1) {
-      err = errno;
-      srcIp = 0;
       ::close(connectionFd);
       connectionFd = -1;
-      continue;
-    }
-
-    if (isConnected) {
+      if (lastConnectError == ETIMEDOUT) {
+        // timeout is common for all addresses, so slow host can't stall
+        // blocking connect for timeoutMs per each address
+        nextAddress = nullptr;
+      }
+      startNextAddress();
       break;
     }
-    srcIp = 0;
-    ::close(connectionFd);
-    connectionFd = -1;
-  }
-
-  freeaddrinfo(addresses);
 
-  if (connectionFd == -1) {
-    srcIp = 0;
-    SUPLA_LOG_ERROR("%s: %s", server, strerror(err));
-    return 0;
-  }
-
-
-  if (sslEnabled) {
-    if (!setupSslContext()) {
-      stop();
-      return 0;
-    }
-    ssl = SSL_new(ctx);
-    if (ssl == nullptr) {
-      SUPLA_LOG_ERROR("SSL_new() failed");
-      stop();
-      return 0;
-    }
-    if (SSL_set_fd(ssl, connectionFd) != 1) {
-      SUPLA_LOG_ERROR("SSL_set_fd failed");
-      stop();
-      return 0;
-    }
-    if (SSL_set_tlsext_host_name(ssl, server) != 1) {
-      SUPLA_LOG_ERROR("SSL_set_tlsext_host_name failed");
-      stop();
-      return 0;
-    }
-    if (isCertificateValidationEnabled() && SSL_set1_host(ssl, server) != 1) {
-      SUPLA_LOG_ERROR("SSL_set1_host failed");
-      stop();
-      return 0;
-    }
-    int ret = SSL_connect(ssl);
-    if (ret <= 0) {
+    case ConnectState::TLS_HANDSHAKE: {
+      if (waitMs > 0 && sslWaitEvents != 0) {
+        struct pollfd pfd = {};
+        pfd.fd = connectionFd;
+        pfd.events = sslWaitEvents;
+        syscallStats.polls++;
+        ::poll(&pfd, 1, waitMs);
+      }
+      ERR_clear_error();
+      int ret = SSL_connect(ssl);
+      if (ret == 1) {
+        onTlsConnected();
+        break;
+      }
+      int sslError = SSL_get_error(ssl, ret);
+      if (sslError == SSL_ERROR_WANT_READ ||
+          sslError == SSL_ERROR_WANT_WRITE) {
+        sslWaitEvents = sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+        if (nowMs() - stepStartMs > SUPLA_LINUX_CLIENT_HANDSHAKE_TIMEOUT_MS) {
+          SUPLA_LOG_ERROR("%s: TLS handshake timeout", connectHost.c_str());
+          failConnect();
+        }
+        break;
+      }
       printSslError(ssl, ret);
       if (isCertificateValidationEnabled()) {
         SUPLA_LOG_WARNING("SSL verify result: %s",
                           X509_verify_cert_error_string(
                               SSL_get_verify_result(ssl)));
       }
-      stop();
-      return 0;
+      failConnect();
+      break;
     }
 
-    SUPLA_LOG_DEBUG("TLS version: %s", SSL_get_version(ssl));
-    SUPLA_LOG_DEBUG("Cipher suite: %s", SSL_get_cipher(ssl));
-    if (!checkSslCerts(ssl)) {
-      stop();
-      return 0;
+    default: {
+      break;
+    }
+  }
+
+  return connectState != ConnectState::IDLE;
+}
+
+bool Supla::LinuxClient::finishConnect() {
+  while (isConnecting()) {
+    if (!iterateConnect(100)) {
+      return false;
     }
+  }
+  return connectState == ConnectState::CONNECTED;
+}
+
+void Supla::LinuxClient::onTcpConnected() {
+  if (sslEnabled) {
+    startTlsHandshake();
   } else {
-    // TODO(klew): implement non ssl connection handling for Linux
+    onConnected();
   }
+}
 
-  if (::fcntl(connectionFd, F_SETFL, flagsCopy | O_NONBLOCK) == -1) {
-    SUPLA_LOG_ERROR("Failed to set socket nonblocking mode");
-    stop();
-    return 0;
+void Supla::LinuxClient::startTlsHandshake() {
+  if (!setupSslContext()) {
+    failConnect();
+    return;
+  }
+  ssl = SSL_new(ctx);
+  if (ssl == nullptr) {
+    SUPLA_LOG_ERROR("SSL_new() failed");
+    failConnect();
+    return;
+  }
+  if (SSL_set_fd(ssl, connectionFd) != 1) {
+    SUPLA_LOG_ERROR("SSL_set_fd failed");
+    failConnect();
+    return;
+  }
+  if (SSL_set_tlsext_host_name(ssl, connectHost.c_str()) != 1) {
+    SUPLA_LOG_ERROR("SSL_set_tlsext_host_name failed");
+    failConnect();
+    return;
+  }
+  if (isCertificateValidationEnabled() &&
+      SSL_set1_host(ssl, connectHost.c_str()) != 1) {
+    SUPLA_LOG_ERROR("SSL_set1_host failed");
+    failConnect();
+    return;
+  }
+  SSL_set_app_data(ssl, this);
+  // count socket reads and writes made by OpenSSL (SSL_set_fd uses the same
+  // BIO for both directions)
+  BIO_set_callback_arg(SSL_get_rbio(ssl), reinterpret_cast<char *>(this));
+  BIO_set_callback_ex(SSL_get_rbio(ssl), BioCallback);
+
+  {
+    std::lock_guard<std::mutex> lock(sessionCacheMutex);
+    auto it = sessionCache.find(sessionCacheKey());
+    if (it != sessionCache.end()) {
+      SSL_set_session(ssl, it->second);
+    }
+  }
+
+  connectState = ConnectState::TLS_HANDSHAKE;
+  sslWaitEvents = 0;
+  stepStartMs = nowMs();
+  iterateConnect(0);
+}
+
+void Supla::LinuxClient::onTlsConnected() {
+  uint32_t handshakeMs = nowMs() - stepStartMs;
+  sessionReused = SSL_session_reused(ssl) == 1;
+
+  SUPLA_LOG_DEBUG("TLS version: %s", SSL_get_version(ssl));
+  SUPLA_LOG_DEBUG("Cipher suite: %s", SSL_get_cipher(ssl));
+  if (!checkSslCerts(ssl)) {
+    failConnect();
+    return;
+  }
+
+  LinuxTlsStats stats;
+  {
+    std::lock_guard<std::mutex> lock(sessionCacheMutex);
+    tlsStats.handshakes++;
+    if (sessionReused) {
+      tlsStats.resumed++;
+    }
+    tlsStats.lastHandshakeMs = handshakeMs;
+    if (handshakeMs > tlsStats.maxHandshakeMs) {
+      tlsStats.maxHandshakeMs = handshakeMs;
+    }
+    tlsStats.totalHandshakeMs += handshakeMs;
+    stats = tlsStats;
+  }
+
+  char buf[100] = {};
+  snprintf(buf,
+           sizeof(buf),
+           "TLS handshake %u ms (%s), resumed %u/%u",
+           handshakeMs,
+           sessionReused ? "resumed" : "full",
+           stats.resumed,
+           stats.handshakes);
+  SUPLA_LOG_INFO("%s", buf);
+  if (sdc) {
+    sdc->addLastStateLog(buf);
+  }
+
+  onConnected();
+}
+
+void Supla::LinuxClient::onConnected() {
+  connectState = ConnectState::CONNECTED;
+  peerClosed = false;
+  onAlive();
+  if (addresses) {
+    freeaddrinfo(addresses);
+    addresses = nullptr;
   }
+  nextAddress = nullptr;
 
   // store connection source IP address
   struct sockaddr_in addr = {};
@@ -307,11 +466,80 @@ int Supla::LinuxClient::connectImp(const char *server, uint16_t port) {
 
   SUPLA_LOG_DEBUG("Connected via IP %d.%d.%d.%d", ipArr[0], ipArr[1],
       ipArr[2], ipArr[3]);
+}
+
+void Supla::LinuxClient::failConnect() {
+  if (connectState == ConnectState::TLS_HANDSHAKE) {
+    // cached session may be the reason of failure (i.e. server was
+    // reconfigured), so next attempt will use full handshake
+    std::lock_guard<std::mutex> lock(sessionCacheMutex);
+    auto it = sessionCache.find(sessionCacheKey());
+    if (it != sessionCache.end()) {
+      SSL_SESSION_free(it->second);
+      sessionCache.erase(it);
+    }
+  }
+  stop();
+}
+
+std::string Supla::LinuxClient::sessionCacheKey() const {
+  return connectHost + ":" + std::to_string(connectPort) + "/" + ctxTrustTag;
+}
+
+int Supla::LinuxClient::NewSessionCallback(SSL *ssl, SSL_SESSION *session) {
+  auto client = static_cast<LinuxClient *>(SSL_get_app_data(ssl));
+  if (client == nullptr) {
+    return 0;
+  }
 
+  std::string key = client->sessionCacheKey();
+  std::lock_guard<std::mutex> lock(sessionCacheMutex);
+  auto it = sessionCache.find(key);
+  if (it != sessionCache.end()) {
+    SSL_SESSION_free(it->second);
+    it->second = session;
+    return 1;
+  }
+  if (sessionCache.size() >= SUPLA_LINUX_CLIENT_SESSION_CACHE_SIZE) {
+    SSL_SESSION_free(sessionCache.begin()->second);
+    sessionCache.erase(sessionCache.begin());
+  }
+  sessionCache[key] = session;
+  // returning 1 means that we took ownership of session
   return 1;
 }
 
+void Supla::LinuxClient::SetNonBlockingConnect(bool enabled) {
+  defaultNonBlockingConnect = enabled;
+}
+
+bool Supla::LinuxClient::IsNonBlockingConnect() {
+  return defaultNonBlockingConnect;
+}
+
+Supla::LinuxTlsStats Supla::LinuxClient::GetTlsStats() {
+  std::lock_guard<std::mutex> lock(sessionCacheMutex);
+  return tlsStats;
+}
+
+void Supla::LinuxClient::ClearTlsSessionCache() {
+  std::lock_guard<std::mutex> lock(sessionCacheMutex);
+  for (auto &entry : sessionCache) {
+    SSL_SESSION_free(entry.second);
+  }
+  sessionCache.clear();
+  tlsStats = {};
+}
+
+bool Supla::LinuxClient::isConnecting() {
+  return connectState == ConnectState::TCP_CONNECTING ||
+         connectState == ConnectState::TLS_HANDSHAKE;
+}
+
 size_t Supla::LinuxClient::writeImp(const uint8_t *buf, size_t size) {
+  if (isConnecting() && !finishConnect()) {
+    return 0;
+  }
   if (connectionFd == -1) {
     return 0;
   }
@@ -335,6 +563,7 @@ size_t Supla::LinuxClient::writeImp(const uint8_t *buf, size_t size) {
         struct pollfd pfd = {};
         pfd.fd = connectionFd;
         pfd.events = sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+        syscallStats.polls++;
         int pollResult = ::poll(&pfd, 1, timeoutMs);
         if (pollResult > 0) {
           if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
@@ -362,11 +591,13 @@ size_t Supla::LinuxClient::writeImp(const uint8_t *buf, size_t size) {
       stop();
       return 0;
     }
+    onAlive();
     return sent;
   }
 
   size_t sent = 0;
   while (sent < size) {
+    syscallStats.writes++;
     ssize_t result = ::write(connectionFd, buf + sent, size - sent);
     if (result > 0) {
       sent += result;
@@ -386,6 +617,7 @@ size_t Supla::LinuxClient::writeImp(const uint8_t *buf, size_t size) {
       struct pollfd pfd = {};
       pfd.fd = connectionFd;
       pfd.events = POLLOUT;
+      syscallStats.polls++;
       int pollResult = ::poll(&pfd, 1, timeoutMs);
       if (pollResult > 0) {
         if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
@@ -408,11 +640,12 @@ size_t Supla::LinuxClient::writeImp(const uint8_t *buf, size_t size) {
     stop();
     return 0;
   }
+  onAlive();
   return sent;
 }
 
 int Supla::LinuxClient::available() {
-  if (connectionFd < 0) {
+  if (connectionFd < 0 || isConnecting()) {
     return 0;
   }
 
@@ -425,6 +658,7 @@ int Supla::LinuxClient::available() {
     struct pollfd pfd = {};
     pfd.fd = connectionFd;
     pfd.events = POLLIN;
+    syscallStats.polls++;
     int pollResult = ::poll(&pfd, 1, 0);
     if (pollResult <= 0) {
       return 0;
@@ -437,6 +671,7 @@ int Supla::LinuxClient::available() {
   }
 
   int value;
+  syscallStats.ioctls++;
   int error = ioctl(connectionFd, FIONREAD, &value);
 
   if (error) {
@@ -457,12 +692,17 @@ int Supla::LinuxClient::readImp(uint8_t *buf, size_t size) {
     return 0;
   }
 
+  if (isConnecting()) {
+    return -1;
+  }
+
   if (sslEnabled) {
     if (ssl == nullptr) {
       return 0;
     }
     response = SSL_read(ssl, buf, size);
     if (response > 0) {
+      onAlive();
       return response;
     } else {
       int sslError = SSL_get_error(ssl, response);
@@ -470,6 +710,8 @@ int Supla::LinuxClient::readImp(uint8_t *buf, size_t size) {
 
       switch (sslError) {
         case SSL_ERROR_WANT_READ: {
+          // socket has no data, but it isn't closed either
+          onAlive();
           break;
         }
         case SSL_ERROR_WANT_WRITE: {
@@ -515,6 +757,7 @@ int Supla::LinuxClient::readImp(uint8_t *buf, size_t size) {
     return -1;
 
   } else {
+    syscallStats.reads++;
     response = ::read(connectionFd, buf, size);
 
     if (response == 0) {
@@ -531,6 +774,7 @@ int Supla::LinuxClient::readImp(uint8_t *buf, size_t size) {
       stop();
       return 0;
     }
+    onAlive();
   }
 
   return response;
@@ -538,6 +782,11 @@ int Supla::LinuxClient::readImp(uint8_t *buf, size_t size) {
 
 void Supla::LinuxClient::stop() {
   if (ssl) {
+    if (connectState == ConnectState::CONNECTED) {
+      // Without close_notify OpenSSL treats session as broken and marks it
+      // as not resumable, which would invalidate our session cache entry
+      SSL_shutdown(ssl);
+    }
     SSL_free(ssl);
   }
   if (connectionFd >= 0) {
@@ -546,26 +795,77 @@ void Supla::LinuxClient::stop() {
   connectionFd = -1;
   ssl = nullptr;
   srcIp = 0;
+  if (addresses) {
+    freeaddrinfo(addresses);
+    addresses = nullptr;
+  }
+  nextAddress = nullptr;
+  connectState = ConnectState::IDLE;
+  peerClosed = false;
 }
 
 uint8_t Supla::LinuxClient::connected() {
-  if (connectionFd == -1) {
+  if (isConnecting()) {
+    return iterateConnect(0);
+  }
+
+  if (connectionFd == -1 || peerClosed) {
     return false;
   }
 
+  uint64_t now = nowMs();
+  if (livenessProbeIntervalMs > 0 &&
+      now - lastAliveMs < livenessProbeIntervalMs) {
+    return true;
+  }
+  lastAliveMs = now;
+
   char tmp;
+  syscallStats.peeks++;
   ssize_t response = ::recv(connectionFd, &tmp, 1, MSG_DONTWAIT | MSG_PEEK);
-  if (response == 0) {
-    return false;
+  if (response == -1 &&
+      (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return true;
   }
+  // closed by peer or socket error. Socket is kept open until stop(), so
+  // remaining data can still be read
+  peerClosed = response <= 0;
+  return !peerClosed;
+}
 
-  if (response == -1) {
-    if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
-      return true;
-    }
-    return false;
-  }
-  return true;
+void Supla::LinuxClient::onAlive() {
+  lastAliveMs = nowMs();
+}
+
+void Supla::LinuxClient::setLivenessProbeIntervalMs(uint32_t intervalMs) {
+  livenessProbeIntervalMs = intervalMs;
+}
+
+Supla::LinuxClientSyscallStats Supla::LinuxClient::getSyscallStats() const {
+  return syscallStats;
+}
+
+void Supla::LinuxClient::resetSyscallStats() {
+  syscallStats = {};
+}
+
+long Supla::LinuxClient::BioCallback(BIO *bio,  // NOLINT(runtime/int)
+                                     int oper,
+                                     const char *,
+                                     size_t,
+                                     int,
+                                     long,  // NOLINT(runtime/int)
+                                     int ret,
+                                     size_t *) {
+  auto client = reinterpret_cast<LinuxClient *>(BIO_get_callback_arg(bio));
+  if (client != nullptr) {
+    if (oper == BIO_CB_READ) {
+      client->syscallStats.reads++;
+    } else if (oper == BIO_CB_WRITE) {
+      client->syscallStats.writes++;
+    }
+  }
+  return ret;
 }
 
 void Supla::LinuxClient::setTimeoutMs(uint16_t _timeoutMs) {
@@ -4,11 +4,43 @@
 #ifndef EXTRAS_PORTING_LINUX_LINUX_CLIENT_H_
 #define EXTRAS_PORTING_LINUX_LINUX_CLIENT_H_
 
+#include <netdb.h>
 #include <openssl/ssl.h>
 #include <supla/network/client.h>
+
+#include <string>
+
 #include "supla/network/network.h"
 
+// Max time of TLS handshake. TCP connect to all resolved addresses together
+// is limited by client's timeoutMs.
+#define SUPLA_LINUX_CLIENT_HANDSHAKE_TIMEOUT_MS 10000
+// Max number of TLS sessions kept for resumption (one per host:port)
+#define SUPLA_LINUX_CLIENT_SESSION_CACHE_SIZE 32
+// Default interval of connected() liveness probes
+#define SUPLA_LINUX_CLIENT_LIVENESS_PROBE_MS 100
+
 namespace Supla {
+
+struct LinuxTlsStats {
+  uint32_t handshakes = 0;
+  uint32_t resumed = 0;
+  uint32_t lastHandshakeMs = 0;
+  uint32_t maxHandshakeMs = 0;
+  uint64_t totalHandshakeMs = 0;
+};
+
+// Socket I/O system calls made by a single LinuxClient instance. Reads and
+// writes done by OpenSSL (including TLS handshake) are included.
+struct LinuxClientSyscallStats {
+  uint32_t reads = 0;
+  uint32_t writes = 0;
+  uint32_t polls = 0;
+  uint32_t ioctls = 0;
+  // recv(MSG_PEEK) liveness probes made by connected()
+  uint32_t peeks = 0;
+};
+
 class LinuxClient : public Client {
  public:
   LinuxClient();
@@ -17,25 +49,100 @@ class LinuxClient : public Client {
   int available() override;
   void stop() override;
   uint8_t connected() override;
+  bool isConnecting() override;
 
   void setTimeoutMs(uint16_t timeoutMs) override;
   void setUseDefaultCACerts(bool useDefault);
 
+  // When enabled, connect() returns as soon as TCP connection is started and
+  // the rest of TCP connect and TLS handshake is driven from connected()
+  // calls (isConnecting() returns true in the meantime). DNS lookup is still
+  // blocking. This sets default for all clients, single client can enable it
+  // with setNonBlockingConnect().
+  static void SetNonBlockingConnect(bool enabled);
+  static bool IsNonBlockingConnect();
+  // TLS handshake statistics of all LinuxClient instances
+  static LinuxTlsStats GetTlsStats();
+  static void ClearTlsSessionCache();
+
+  // connected() returns cached connection state, which is updated by reads,
+  // writes and readiness checks. Additionally it peeks the socket to detect
+  // connection closed by peer, but not more often than once per intervalMs
+  // since last probe or successful I/O. 0 probes on each call.
+  void setLivenessProbeIntervalMs(uint32_t intervalMs);
+  LinuxClientSyscallStats getSyscallStats() const;
+  void resetSyscallStats();
+
  protected:
   bool isCertificateValidationEnabled() const override;
   int readImp(uint8_t *buf, size_t size) override;
   size_t writeImp(const uint8_t *buf, size_t size) override;
   int connectImp(const char *host, uint16_t port) override;
 
+  enum class ConnectState {
+    IDLE,
+    TCP_CONNECTING,
+    TLS_HANDSHAKE,
+    CONNECTED
+  };
+
   bool checkSslCerts(SSL *ssl);
   bool setupSslContext();
   int32_t printSslError(SSL *ssl, int ret_code);
 
+  bool startConnect(const char *server, uint16_t port);
+  bool startNextAddress();
+  // Performs next connect step, waiting up to waitMs for socket readiness.
+  // Returns false when connection failed.
+  bool iterateConnect(int waitMs);
+  // Blocks until connection is established or failed
+  bool finishConnect();
+  void onTcpConnected();
+  void startTlsHandshake();
+  void onTlsConnected();
+  void onConnected();
+  void failConnect();
+  std::string sessionCacheKey() const;
+  static int NewSessionCallback(SSL *ssl, SSL_SESSION *session);
+  static long BioCallback(BIO *bio,  // NOLINT(runtime/int)
+                          int oper,
+                          const char *argp,
+                          size_t len,
+                          int argi,
+                          long argl,  // NOLINT(runtime/int)
+                          int ret,
+                          size_t *processed);
+  // Marks connection as alive at the moment, so liveness probe is postponed
+  void onAlive();
+
   int connectionFd = -1;
   SSL_CTX *ctx = nullptr;
   SSL *ssl = nullptr;
   uint16_t timeoutMs = 3000;
   bool useDefaultCACerts = false;
+
+  ConnectState connectState = ConnectState::IDLE;
+  struct addrinfo *addresses = nullptr;
+  struct addrinfo *nextAddress = nullptr;
+  std::string connectHost;
+  uint16_t connectPort = 0;
+  int lastConnectError = 0;
+  int16_t sslWaitEvents = 0;
+  // start of TCP connect (shared by all addresses) or TLS handshake
+  uint64_t stepStartMs = 0;
+  bool sessionReused = false;
+
+  // set when liveness probe found connection closed by peer
+  bool peerClosed = false;
+  uint64_t lastAliveMs = 0;
+  uint32_t livenessProbeIntervalMs = SUPLA_LINUX_CLIENT_LIVENESS_PROBE_MS;
+  LinuxClientSyscallStats syscallStats;
+
+  // SSL_CTX is reused between connections as long as trust settings
+  // don't change
+  const char *ctxRootCACert = nullptr;
+  bool ctxUseDefaultCACerts = false;
+  std::string ctxTrustTag;
 };
 };  // namespace Supla
 
@@ -0,0 +1,578 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "linux_modbus_tcp_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <supla/log_wrapper.h>
+#include <supla/modbus/modbus_client_handler.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+constexpr size_t kMbapHeaderSize = 7;
+constexpr size_t kRxBufferSize = 4 * SUPLA_MODBUS_TCP_MAX_ADU_SIZE;
+// responses waiting for the master to read them; when limit is reached,
+// further requests are not processed until tx buffer is flushed
+constexpr size_t kTxBufferLimit = 16 * SUPLA_MODBUS_TCP_MAX_ADU_SIZE;
+constexpr int kMaxEvents = 32;
+
+enum FunctionCode : uint8_t {
+  READ_COILS = 0x01,
+  READ_DISCRETE_INPUTS = 0x02,
+  READ_HOLDING_REGISTERS = 0x03,
+  READ_INPUT_REGISTERS = 0x04,
+  WRITE_SINGLE_COIL = 0x05,
+  WRITE_SINGLE_REGISTER = 0x06,
+  WRITE_MULTIPLE_COILS = 0x0F,
+  WRITE_MULTIPLE_REGISTERS = 0x10,
+};
+
+enum ExceptionCode : uint8_t {
+  ILLEGAL_FUNCTION = 0x01,
+  ILLEGAL_DATA_ADDRESS = 0x02,
+  ILLEGAL_DATA_VALUE = 0x03,
+  SERVER_DEVICE_FAILURE = 0x04,
+};
+
+uint16_t readUInt16(const uint8_t *buf) {
+  return static_cast<uint16_t>((buf[0] << 8) | buf[1]);
+}
+
+void writeUInt16(uint8_t *buf, uint16_t value) {
+  buf[0] = value >> 8;
+  buf[1] = value & 0xFF;
+}
+
+uint8_t resultToExceptionCode(Supla::Modbus::Result result) {
+  switch (result) {
+    case Supla::Modbus::Result::OK:
+      return 0;
+    case Supla::Modbus::Result::INVALID_REGISTER_ADDRESS:
+      return ILLEGAL_DATA_ADDRESS;
+    case Supla::Modbus::Result::INVALID_STATE:
+      return SERVER_DEVICE_FAILURE;
+  }
+  return SERVER_DEVICE_FAILURE;
+}
+
+bool isRangeValid(uint16_t address, uint16_t count) {
+  return static_cast<uint32_t>(address) + count <= 0x10000;
+}
+
+// Returns PDU size (function code + data) or exception code with 0x80 bit set
+// in pdu[0]
+size_t processPdu(const uint8_t *request, size_t requestSize, uint8_t *pdu) {
+  uint8_t functionCode = request[0];
+  const uint8_t *data = request + 1;
+  size_t dataSize = requestSize - 1;
+  pdu[0] = functionCode;
+
+  auto exception = [pdu, functionCode](uint8_t code) -> size_t {
+    pdu[0] = functionCode | 0x80;
+    pdu[1] = code;
+    return 2;
+  };
+
+  switch (functionCode) {
+    case READ_HOLDING_REGISTERS:
+    case READ_INPUT_REGISTERS: {
+      bool holding = functionCode == READ_HOLDING_REGISTERS;
+      if (holding ? !Supla::ModbusClientHandler::IsHoldingSupported()
+                  : !Supla::ModbusClientHandler::IsInputSupported()) {
+        return exception(ILLEGAL_FUNCTION);
+      }
+      if (dataSize != 4) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint16_t address = readUInt16(data);
+      uint16_t count = readUInt16(data + 2);
+      if (count < 1 || count > 125) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      if (!isRangeValid(address, count)) {
+        return exception(ILLEGAL_DATA_ADDRESS);
+      }
+      memset(pdu + 2, 0, count * 2);
+      auto result =
+          holding ? Supla::ModbusClientHandler::HoldingProcessRequest(
+                        address, count, pdu + 2, Supla::Modbus::Access::READ)
+                  : Supla::ModbusClientHandler::InputProcessRequest(
+                        address, count, pdu + 2);
+      if (result != Supla::Modbus::Result::OK) {
+        return exception(resultToExceptionCode(result));
+      }
+      pdu[1] = count * 2;
+      return 2 + count * 2;
+    }
+
+    case READ_COILS:
+    case READ_DISCRETE_INPUTS: {
+      bool coils = functionCode == READ_COILS;
+      if (coils ? !Supla::ModbusClientHandler::IsCoilsSupported()
+                : !Supla::ModbusClientHandler::IsDiscreteSupported()) {
+        return exception(ILLEGAL_FUNCTION);
+      }
+      if (dataSize != 4) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint16_t address = readUInt16(data);
+      uint16_t count = readUInt16(data + 2);
+      if (count < 1 || count > 2000) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      if (!isRangeValid(address, count)) {
+        return exception(ILLEGAL_DATA_ADDRESS);
+      }
+      uint8_t byteCount = (count + 7) / 8;
+      memset(pdu + 2, 0, byteCount);
+      auto result =
+          coils ? Supla::ModbusClientHandler::CoilsProcessRequest(
+                      address, count, pdu + 2, Supla::Modbus::Access::READ)
+                : Supla::ModbusClientHandler::DiscreteProcessRequest(
+                      address, count, pdu + 2);
+      if (result != Supla::Modbus::Result::OK) {
+        return exception(resultToExceptionCode(result));
+      }
+      pdu[1] = byteCount;
+      return 2 + byteCount;
+    }
+
+    case WRITE_SINGLE_COIL: {
+      if (!Supla::ModbusClientHandler::IsCoilsSupported()) {
+        return exception(ILLEGAL_FUNCTION);
+      }
+      if (dataSize != 4) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint16_t address = readUInt16(data);
+      uint16_t value = readUInt16(data + 2);
+      if (value != 0xFF00 && value != 0x0000) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint8_t coil = value ? 1 : 0;
+      auto result = Supla::ModbusClientHandler::CoilsProcessRequest(
+          address, 1, &coil, Supla::Modbus::Access::WRITE);
+      if (result != Supla::Modbus::Result::OK) {
+        return exception(resultToExceptionCode(result));
+      }
+      memcpy(pdu + 1, data, 4);
+      return 5;
+    }
+
+    case WRITE_SINGLE_REGISTER: {
+      if (!Supla::ModbusClientHandler::IsHoldingSupported()) {
+        return exception(ILLEGAL_FUNCTION);
+      }
+      if (dataSize != 4) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint16_t address = readUInt16(data);
+      uint8_t value[2] = {data[2], data[3]};
+      auto result = Supla::ModbusClientHandler::HoldingProcessRequest(
+          address, 1, value, Supla::Modbus::Access::WRITE);
+      if (result != Supla::Modbus::Result::OK) {
+        return exception(resultToExceptionCode(result));
+      }
+      memcpy(pdu + 1, data, 4);
+      return 5;
+    }
+
+    case WRITE_MULTIPLE_COILS:
+    case WRITE_MULTIPLE_REGISTERS: {
+      bool coils = functionCode == WRITE_MULTIPLE_COILS;
+      if (coils ? !Supla::ModbusClientHandler::IsCoilsSupported()
+                : !Supla::ModbusClientHandler::IsHoldingSupported()) {
+        return exception(ILLEGAL_FUNCTION);
+      }
+      if (dataSize < 5) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      uint16_t address = readUInt16(data);
+      uint16_t count = readUInt16(data + 2);
+      uint8_t byteCount = data[4];
+      uint16_t maxCount = coils ? 1968 : 123;
+      size_t expectedByteCount = coils ? (count + 7) / 8 : count * 2;
+      if (count < 1 || count > maxCount || byteCount != expectedByteCount ||
+          dataSize != 5u + byteCount) {
+        return exception(ILLEGAL_DATA_VALUE);
+      }
+      if (!isRangeValid(address, count)) {
+        return exception(ILLEGAL_DATA_ADDRESS);
+      }
+      uint8_t values[256] = {};
+      memcpy(values, data + 5, byteCount);
+      auto result =
+          coils ? Supla::ModbusClientHandler::CoilsProcessRequest(
+                      address, count, values, Supla::Modbus::Access::WRITE)
+                : Supla::ModbusClientHandler::HoldingProcessRequest(
+                      address, count, values, Supla::Modbus::Access::WRITE);
+      if (result != Supla::Modbus::Result::OK) {
+        return exception(resultToExceptionCode(result));
+      }
+      memcpy(pdu + 1, data, 4);
+      return 5;
+    }
+  }
+
+  return exception(ILLEGAL_FUNCTION);
+}
+
+}  // namespace
+
+struct Supla::Linux::ModbusTcpServer::Client {
+  int fd = -1;
+  uint32_t events = 0;
+  uint8_t rx[kRxBufferSize] = {};
+  size_t rxSize = 0;
+  std::vector<uint8_t> tx;
+  size_t txOffset = 0;
+};
+
+using Supla::Linux::ModbusTcpServer;
+
+ModbusTcpServer::ModbusTcpServer(uint16_t port,
+                                 const std::string &bindAddress,
+                                 uint8_t unitId,
+                                 int maxClients)
+    : port(port),
+      bindAddress(bindAddress),
+      unitId(unitId),
+      maxClients(maxClients) {
+}
+
+ModbusTcpServer::~ModbusTcpServer() {
+  end();
+}
+
+void ModbusTcpServer::onInit() {
+  begin();
+}
+
+void ModbusTcpServer::iterateAlways() {
+  iterate(0);
+}
+
+bool ModbusTcpServer::begin() {
+  if (listenSocket >= 0) {
+    return true;
+  }
+  Supla::ModbusClientHandler::BuildIndex();
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (!bindAddress.empty() &&
+      inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1) {
+    SUPLA_LOG_ERROR("ModbusTcp: invalid bind address \"%s\"",
+                    bindAddress.c_str());
+    return false;
+  }
+
+  listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenSocket < 0) {
+    SUPLA_LOG_ERROR("ModbusTcp: socket failed: %s", strerror(errno));
+    return false;
+  }
+
+  int reuse = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listenSocket, 16) < 0) {
+    SUPLA_LOG_ERROR(
+        "ModbusTcp: failed to listen on port %d: %s", port, strerror(errno));
+    end();
+    return false;
+  }
+
+  socklen_t addressSize = sizeof(address);
+  if (getsockname(listenSocket, reinterpret_cast<sockaddr *>(&address),
+                  &addressSize) == 0) {
+    port = ntohs(address.sin_port);
+  }
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+    SUPLA_LOG_ERROR("ModbusTcp: epoll_create1 failed: %s", strerror(errno));
+    end();
+    return false;
+  }
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &event) < 0) {
+    SUPLA_LOG_ERROR("ModbusTcp: epoll_ctl failed: %s", strerror(errno));
+    end();
+    return false;
+  }
+
+  SUPLA_LOG_INFO("ModbusTcp: server listening on port %d (unit id %d)",
+                 port,
+                 unitId);
+  return true;
+}
+
+void ModbusTcpServer::end() {
+  while (!clients.empty()) {
+    closeClient(clients.back().get());
+  }
+  if (epollFd >= 0) {
+    close(epollFd);
+    epollFd = -1;
+  }
+  if (listenSocket >= 0) {
+    close(listenSocket);
+    listenSocket = -1;
+  }
+}
+
+uint16_t ModbusTcpServer::getPort() const {
+  return port;
+}
+
+int ModbusTcpServer::getClientCount() const {
+  return static_cast<int>(clients.size());
+}
+
+uint32_t ModbusTcpServer::getRequestCount() const {
+  return requestCount;
+}
+
+void ModbusTcpServer::iterate(int timeoutMs) {
+  if (epollFd < 0) {
+    return;
+  }
+
+  epoll_event events[kMaxEvents];
+  int count = epoll_wait(epollFd, events, kMaxEvents, timeoutMs);
+  if (count < 0) {
+    if (errno != EINTR) {
+      SUPLA_LOG_WARNING("ModbusTcp: epoll_wait failed: %s", strerror(errno));
+    }
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    auto client = static_cast<Client *>(events[i].data.ptr);
+    if (client == nullptr) {
+      acceptClients();
+      continue;
+    }
+    if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+      closeClient(client);
+      continue;
+    }
+    if (events[i].events & EPOLLOUT) {
+      if (!flush(client)) {
+        closeClient(client);
+        continue;
+      }
+      // requests could be held back because of full tx buffer
+      if (!processFrames(client) || !flush(client)) {
+        closeClient(client);
+        continue;
+      }
+    }
+    if (events[i].events & EPOLLIN) {
+      handleRead(client);
+      continue;
+    }
+    updateEvents(client);
+  }
+}
+
+void ModbusTcpServer::acceptClients() {
+  while (true) {
+    int fd = accept4(listenSocket, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        SUPLA_LOG_WARNING("ModbusTcp: accept failed: %s", strerror(errno));
+      }
+      return;
+    }
+    if (static_cast<int>(clients.size()) >= maxClients) {
+      SUPLA_LOG_WARNING("ModbusTcp: too many clients (max %d), rejecting",
+                        maxClients);
+      close(fd);
+      continue;
+    }
+
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    auto client = std::make_unique<Client>();
+    client->fd = fd;
+    client->events = EPOLLIN | EPOLLRDHUP;
+    epoll_event event = {};
+    event.events = client->events;
+    event.data.ptr = client.get();
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+      SUPLA_LOG_WARNING("ModbusTcp: epoll_ctl failed: %s", strerror(errno));
+      close(fd);
+      continue;
+    }
+    clients.push_back(std::move(client));
+    SUPLA_LOG_DEBUG("ModbusTcp: client connected (%d active)",
+                    getClientCount());
+  }
+}
+
+void ModbusTcpServer::handleRead(Client *client) {
+  if (client->rxSize < kRxBufferSize) {
+    ssize_t size = recv(client->fd,
+                        client->rx + client->rxSize,
+                        kRxBufferSize - client->rxSize,
+                        0);
+    if (size == 0) {
+      closeClient(client);
+      return;
+    }
+    if (size < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        closeClient(client);
+      }
+      return;
+    }
+    client->rxSize += size;
+  }
+
+  if (!processFrames(client) || !flush(client)) {
+    closeClient(client);
+    return;
+  }
+  updateEvents(client);
+}
+
+bool ModbusTcpServer::processFrames(Client *client) {
+  size_t offset = 0;
+  while (client->rxSize - offset >= kMbapHeaderSize &&
+         client->tx.size() - client->txOffset < kTxBufferLimit) {
+    const uint8_t *frame = client->rx + offset;
+    uint16_t length = readUInt16(frame + 4);
+    // length contains unit id and PDU
+    if (length < 2 || length > SUPLA_MODBUS_TCP_MAX_ADU_SIZE - 6) {
+      SUPLA_LOG_WARNING("ModbusTcp: invalid frame length %d, disconnecting",
+                        length);
+      return false;
+    }
+    size_t frameSize = 6 + length;
+    if (client->rxSize - offset < frameSize) {
+      break;
+    }
+
+    uint8_t response[SUPLA_MODBUS_TCP_MAX_ADU_SIZE];
+    size_t responseSize = ProcessAdu(frame, frameSize, response, unitId);
+    requestCount++;
+    if (responseSize > 0) {
+      client->tx.insert(
+          client->tx.end(), response, response + responseSize);
+    }
+    offset += frameSize;
+  }
+
+  if (offset > 0) {
+    client->rxSize -= offset;
+    memmove(client->rx, client->rx + offset, client->rxSize);
+  }
+  return true;
+}
+
+bool ModbusTcpServer::flush(Client *client) {
+  while (client->txOffset < client->tx.size()) {
+    ssize_t size = send(client->fd,
+                        client->tx.data() + client->txOffset,
+                        client->tx.size() - client->txOffset,
+                        MSG_NOSIGNAL);
+    if (size < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        break;
+      }
+      return false;
+    }
+    client->txOffset += size;
+  }
+  if (client->txOffset == client->tx.size()) {
+    client->tx.clear();
+    client->txOffset = 0;
+  }
+  return true;
+}
+
+void ModbusTcpServer::updateEvents(Client *client) {
+  // EPOLLRDHUP is level triggered, so it is watched only together with
+  // EPOLLIN. Otherwise half closed connection with full rx buffer would wake
+  // up epoll_wait in a loop. Peer close is detected by recv() after rx buffer
+  // is drained by sending pending responses.
+  uint32_t events = 0;
+  if (client->rxSize < kRxBufferSize) {
+    events |= EPOLLIN | EPOLLRDHUP;
+  }
+  if (client->txOffset < client->tx.size()) {
+    events |= EPOLLOUT;
+  }
+  if (events == client->events) {
+    return;
+  }
+  epoll_event event = {};
+  event.events = events;
+  event.data.ptr = client;
+  if (epoll_ctl(epollFd, EPOLL_CTL_MOD, client->fd, &event) == 0) {
+    client->events = events;
+  }
+}
+
+void ModbusTcpServer::closeClient(Client *client) {
+  if (epollFd >= 0) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->fd, nullptr);
+  }
+  close(client->fd);
+  auto it = std::find_if(
+      clients.begin(), clients.end(), [client](const auto &c) {
+        return c.get() == client;
+      });
+  if (it != clients.end()) {
+    clients.erase(it);
+  }
+  SUPLA_LOG_DEBUG("ModbusTcp: client disconnected (%d active)",
+                  getClientCount());
+}
+
+size_t ModbusTcpServer::ProcessAdu(const uint8_t *request,
+                                   size_t requestSize,
+                                   uint8_t *response,
+                                   uint8_t unitId) {
+  if (request == nullptr || response == nullptr ||
+      requestSize < kMbapHeaderSize + 1 ||
+      requestSize > SUPLA_MODBUS_TCP_MAX_ADU_SIZE) {
+    return 0;
+  }
+  uint16_t protocolId = readUInt16(request + 2);
+  uint16_t length = readUInt16(request + 4);
+  uint8_t requestUnitId = request[6];
+  if (protocolId != 0 || length != requestSize - 6) {
+    return 0;
+  }
+  if (unitId != 0 && requestUnitId != unitId && requestUnitId != 0xFF) {
+    return 0;
+  }
+
+  // transaction id, protocol id and unit id are copied from the request
+  memcpy(response, request, kMbapHeaderSize);
+  size_t pduSize = processPdu(request + kMbapHeaderSize,
+                              requestSize - kMbapHeaderSize,
+                              response + kMbapHeaderSize);
+  writeUInt16(response + 4, static_cast<uint16_t>(pduSize + 1));
+  return kMbapHeaderSize + pduSize;
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_LINUX_MODBUS_TCP_SERVER_H_
+#define EXTRAS_PORTING_LINUX_LINUX_MODBUS_TCP_SERVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <supla/element.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// MBAP header (7) + function code (1) + max PDU data (252)
+#define SUPLA_MODBUS_TCP_MAX_ADU_SIZE 260
+
+namespace Supla {
+namespace Linux {
+
+/**
+ * Modbus TCP server (slave) serving all registered Supla::ModbusClientHandler
+ * instances (i.e. ModbusEMHandler, ModbusDeviceHandler).
+ *
+ * Sockets are non-blocking and multiplexed with epoll, so multiple masters
+ * can be connected at the same time and pipelined requests are supported.
+ * Server is iterated from the device loop (iterateAlways), so handlers are
+ * called from the same thread which updates channel values.
+ *
+ * Supported function codes: 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0F, 0x10.
+ */
+class ModbusTcpServer : public Supla::Element {
+ public:
+  /**
+   * @param port TCP port, 0 - ephemeral port (see getPort())
+   * @param bindAddress IPv4 address to bind, empty - all interfaces
+   * @param unitId accepted unit identifier, 0 - accept any. Requests with
+   *        unit id 0xFF are always accepted
+   * @param maxClients max number of concurrently connected masters
+   */
+  explicit ModbusTcpServer(uint16_t port = 502,
+                           const std::string &bindAddress = "",
+                           uint8_t unitId = 0,
+                           int maxClients = 8);
+  ~ModbusTcpServer() override;
+
+  void onInit() override;
+  void iterateAlways() override;
+
+  bool begin();
+  void end();
+  /**
+   * Handles pending socket events.
+   *
+   * @param timeoutMs max time to wait for events (0 - don't wait)
+   */
+  void iterate(int timeoutMs = 0);
+
+  uint16_t getPort() const;
+  int getClientCount() const;
+  uint32_t getRequestCount() const;
+
+  /**
+   * Processes single Modbus TCP ADU (MBAP header + PDU).
+   *
+   * @param request request ADU
+   * @param requestSize size of request ADU
+   * @param response output buffer, at least SUPLA_MODBUS_TCP_MAX_ADU_SIZE
+   * @param unitId accepted unit id, 0 - any
+   *
+   * @return size of response ADU, 0 when request should be left without
+   *         response
+   */
+  static size_t ProcessAdu(const uint8_t *request,
+                           size_t requestSize,
+                           uint8_t *response,
+                           uint8_t unitId);
+
+ private:
+  struct Client;
+
+  void acceptClients();
+  void handleRead(Client *client);
+  bool processFrames(Client *client);
+  bool flush(Client *client);
+  void updateEvents(Client *client);
+  void closeClient(Client *client);
+
+  uint16_t port = 502;
+  std::string bindAddress;
+  uint8_t unitId = 0;
+  int maxClients = 8;
+  int listenSocket = -1;
+  int epollFd = -1;
+  uint32_t requestCount = 0;
+  std::vector<std::unique_ptr<Client>> clients;
+};
+
+}  // namespace Linux
+}  // namespace Supla
+
+#endif  // EXTRAS_PORTING_LINUX_LINUX_MODBUS_TCP_SERVER_H_
@@ -0,0 +1,739 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "linux_sw_update.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <supla/device/supla_ca_cert.h>
+#include <supla/log_wrapper.h>
+#include <supla/rsa_verificator.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#define URL_SIZE 512
+#define BUF_SIZE 512
+
+namespace {
+
+const char slotA[] = "slot_a";
+const char slotB[] = "slot_b";
+const char currentLink[] = "current";
+
+const uint8_t expectedFooter[Supla::LinuxSwUpdate::FooterSize] = {
+    0xBA, 0xBE, 0x2B, 0xED, 0x00, 0x01, 0x02, 0x00,
+    0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// Splits http(s)://host[:port][/path] url. Returns false for other schemes.
+bool parseUrl(const char *url,
+              std::string *host,
+              uint16_t *port,
+              bool *ssl,
+              const char **path) {
+  if (strncmp(url, "https://", 8) == 0) {
+    *ssl = true;
+    *port = 443;
+    url += 8;
+  } else if (strncmp(url, "http://", 7) == 0) {
+    *ssl = false;
+    *port = 80;
+    url += 7;
+  } else {
+    return false;
+  }
+  const char *hostEnd = url;
+  while (*hostEnd && *hostEnd != ':' && *hostEnd != '/') {
+    hostEnd++;
+  }
+  host->assign(url, hostEnd - url);
+  *path = hostEnd;
+  if (*hostEnd == ':') {
+    *port = strtoul(hostEnd + 1, nullptr, 10);
+    *path = strchr(hostEnd, '/');
+  }
+  if (*path == nullptr || **path == '\0') {
+    *path = "/";
+  }
+  return !host->empty() && *port != 0;
+}
+
+}  // namespace
+
+std::string Supla::LinuxSwUpdate::slotsPath = "/var/lib/supla-device/firmware";
+
+#ifndef SUPLA_TEST
+Supla::Device::SwUpdate *Supla::Device::SwUpdate::Create(
+    SuplaDeviceClass *sdc, const char *newUrl, Supla::SwUpdateMode mode) {
+  return new Supla::LinuxSwUpdate(sdc, newUrl, mode);
+}
+#endif  // SUPLA_TEST
+
+void Supla::LinuxSwUpdate::SetSlotsPath(const std::string &path) {
+  slotsPath = path;
+}
+
+const std::string &Supla::LinuxSwUpdate::GetSlotsPath() {
+  return slotsPath;
+}
+
+Supla::LinuxSwUpdate::LinuxSwUpdate(SuplaDeviceClass *sdc,
+                                    const char *newUrl,
+                                    Supla::SwUpdateMode mode)
+    : Supla::Device::SwUpdate(sdc, newUrl, mode), http(this) {
+  http.setTimeoutMs(10000);
+}
+
+Supla::LinuxSwUpdate::~LinuxSwUpdate() {
+  http.stop();
+  closePartFile();
+  closeDeltaPatch();
+  delete hash;
+  hash = nullptr;
+}
+
+std::string Supla::LinuxSwUpdate::getInactiveSlot() const {
+  std::string link = slotsPath + "/" + currentLink;
+  char target[256] = {};
+  ssize_t size = readlink(link.c_str(), target, sizeof(target) - 1);
+  if (size > 0) {
+    target[size] = '\0';
+    const char *name = strrchr(target, '/');
+    name = name ? name + 1 : target;
+    if (strcmp(name, slotA) == 0) {
+      return slotB;
+    }
+  }
+  return slotA;
+}
+
+uint32_t Supla::LinuxSwUpdate::getResumeOffset() const {
+  return resumeOffset;
+}
+
+bool Supla::LinuxSwUpdate::isDeltaUpdate() const {
+  return deltaUpdate;
+}
+
+void Supla::LinuxSwUpdate::iterate() {
+  if (!isStarted() || isAborted() || isFinished()) {
+    return;
+  }
+
+  switch (state) {
+    case State::IDLE: {
+      startCheck();
+      return;
+    }
+    case State::CHECKING: {
+      http.iterate();
+      return;
+    }
+    case State::DOWNLOADING: {
+      // HttpPoller processes limited amount of data per call, so it is
+      // called until budget is used or there is nothing more to read
+      receivedInIterate = 0;
+      uint32_t lastReceived = 0;
+      do {
+        lastReceived = receivedInIterate;
+        http.iterate();
+      } while (state == State::DOWNLOADING && http.isBusy() &&
+               !deltaFailed && receivedInIterate != lastReceived &&
+               receivedInIterate < SUPLA_LINUX_SW_UPDATE_ITERATE_BUDGET);
+      if (state == State::DOWNLOADING && deltaUpdate && deltaFailed) {
+        // rest of the patch is not downloaded
+        fallbackToFullImage(patch->getError());
+      }
+      return;
+    }
+    case State::DONE: {
+      return;
+    }
+  }
+}
+
+bool Supla::LinuxSwUpdate::setServer(const char *requestUrl,
+                                     const char **path) {
+  std::string host;
+  uint16_t port = 0;
+  bool ssl = false;
+  if (requestUrl == nullptr ||
+      !parseUrl(requestUrl, &host, &port, &ssl, path)) {
+    return false;
+  }
+  http.stop();
+  http.setServer(host.c_str(), port);
+  auto client = http.getClient();
+  if (client == nullptr) {
+    return false;
+  }
+  client->setSSLEnabled(ssl);
+  if (ssl && skipCert) {
+    SUPLA_LOG_WARNING("SW update: skip checking Supla CA cert (INSECURE)");
+    client->setCACert(nullptr);
+  } else if (ssl) {
+    client->setCACert(::suplaCACert);
+  }
+  return true;
+}
+
+bool Supla::LinuxSwUpdate::hashCurrentImage() {
+  std::string path = slotsPath + "/" + currentLink;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (in == nullptr) {
+    return false;
+  }
+  Supla::Sha256 imageHash;
+  uint8_t buf[4096];
+  size_t size = 0;
+  uint32_t total = 0;
+  while ((size = fread(buf, 1, sizeof(buf), in)) > 0) {
+    imageHash.update(buf, size);
+    total += size;
+  }
+  bool readError = ferror(in) != 0;
+  fclose(in);
+  if (readError || total == 0) {
+    return false;
+  }
+  uint8_t sha[32] = {};
+  imageHash.digest(sha);
+  setCurrentImageSha256(sha);
+  currentImageSize = total;
+  return true;
+}
+
+void Supla::LinuxSwUpdate::startCheck() {
+  if (!currentImageSha256Set && !hashCurrentImage()) {
+    SUPLA_LOG_DEBUG("SW update: active slot not found, delta update disabled");
+  }
+
+  char queryParams[URL_SIZE] = {};
+  if (!generateCheckUpdateQuery(queryParams, URL_SIZE)) {
+    fail("SW update: fail - too long request url");
+    return;
+  }
+
+  const char *path = nullptr;
+  if (!setServer(url, &path)) {
+    fail("SW update: invalid update server url");
+    return;
+  }
+  response.clear();
+  responseOverflow = false;
+  state = State::CHECKING;
+  if (!http.sendPostRequest(
+          path, "application/x-www-form-urlencoded", queryParams)) {
+    fail("SW update: failed to open connection with update server");
+  }
+}
+
+void Supla::LinuxSwUpdate::onHttpHeaders(int statusCode,
+                                         int32_t contentLength) {
+  httpStatus = statusCode;
+  if (state != State::DOWNLOADING || deltaUpdate) {
+    return;
+  }
+  if (statusCode == 200 && resumeOffset > 0) {
+    SUPLA_LOG_INFO("SW update: server ignored range request, restarting");
+    closePartFile();
+    resumeOffset = 0;
+    if (!openPartFile()) {
+      writeError = true;
+    }
+  } else if (statusCode != 206 && statusCode != 200) {
+    return;
+  }
+  totalBytes =
+      contentLength >= 0 ? resumeOffset + static_cast<uint32_t>(contentLength)
+                         : 0;
+  notifyProgress(imageSize, totalBytes);
+}
+
+void Supla::LinuxSwUpdate::onHttpBody(const char *data, int size) {
+  if (state == State::CHECKING) {
+    if (response.size() + size > SUPLA_LINUX_SW_UPDATE_MAX_RESPONSE) {
+      responseOverflow = true;
+      return;
+    }
+    response.append(data, size);
+    return;
+  }
+  if (state != State::DOWNLOADING || writeError ||
+      (httpStatus != 200 && httpStatus != 206)) {
+    return;
+  }
+  receivedInIterate += size;
+  if (deltaUpdate) {
+    if (!deltaFailed &&
+        !patch->feed(reinterpret_cast<const uint8_t *>(data), size)) {
+      deltaFailed = true;
+    }
+    totalBytes = patch->getTargetSize();
+  } else if (!writeTargetImage(reinterpret_cast<const uint8_t *>(data),
+                               size)) {
+    return;
+  }
+  if (imageSize - lastNotifiedBytes > 64 * 1024) {
+    notifyProgress(imageSize, totalBytes);
+    lastNotifiedBytes = imageSize;
+  }
+}
+
+void Supla::LinuxSwUpdate::onHttpResponseComplete(bool success,
+                                                  int statusCode) {
+  if (state == State::CHECKING) {
+    if (!success) {
+      fail("SW update: error in receiving check update response");
+      return;
+    }
+    if (responseOverflow) {
+      fail("SW update: check update response too large");
+      return;
+    }
+    handleCheckResponse();
+    return;
+  }
+  if (state != State::DOWNLOADING) {
+    return;
+  }
+  if (deltaUpdate) {
+    if (statusCode != 200) {
+      fallbackToFullImage("HTTP GET failed");
+    } else if (deltaFailed) {
+      fallbackToFullImage(patch->getError());
+    } else if (writeError) {
+      fallbackToFullImage("file write fail");
+    } else if (!success || !patch->isComplete()) {
+      fallbackToFullImage("incomplete patch");
+    } else {
+      finishDownload();
+    }
+    return;
+  }
+  if (statusCode != 200 && statusCode != 206) {
+    char buf[BUF_SIZE] = {};
+    snprintf(buf,
+             BUF_SIZE,
+             "SW update: HTTP GET failed with status code %d",
+             statusCode);
+    if (statusCode == 416) {
+      // stored part doesn't match file on the server
+      removePartFile();
+    }
+    retryAllowed = true;
+    fail(buf);
+    return;
+  }
+  if (writeError) {
+    retryAllowed = true;
+    fail("SW update: file write fail");
+    return;
+  }
+  if (!success) {
+    // downloaded part is kept for the next attempt
+    retryAllowed = true;
+    fail("SW update: error in receiving complete file");
+    return;
+  }
+  finishDownload();
+}
+
+void Supla::LinuxSwUpdate::handleCheckResponse() {
+  auto json = nlohmann::json::parse(response, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    fail("SW update: failed to parse check update response");
+    return;
+  }
+  char buf[BUF_SIZE] = {};
+  auto status = json.find("status");
+  if (status != json.end() && status->is_string()) {
+    snprintf(buf,
+             BUF_SIZE,
+             "SW update status: %s",
+             status->get<std::string>().c_str());
+    SUPLA_LOG_INFO("%s", buf);
+  }
+
+  auto latestUpdate = json.find("latestUpdate");
+  if (latestUpdate == json.end() || !latestUpdate->is_object()) {
+    abort = true;
+    retryAllowed = false;
+    state = State::DONE;
+    notifyFinished(Supla::Device::SwUpdateResult::UP_TO_DATE);
+    return;
+  }
+
+  auto version = latestUpdate->find("version");
+  auto newUrl = latestUpdate->find("updateUrl");
+  if (version == latestUpdate->end() || !version->is_string() ||
+      newUrl == latestUpdate->end() || !newUrl->is_string()) {
+    fail("SW update: no url and version received - finishing");
+    return;
+  }
+  if (mode == Supla::SwUpdateMode::PeriodicCheckAndUpdate) {
+    mode = Supla::SwUpdateMode::CheckAndUpdate;
+  }
+
+  std::string versionStr = version->get<std::string>();
+  std::string urlStr = newUrl->get<std::string>();
+  snprintf(buf, BUF_SIZE, "SW update new version: %s", versionStr.c_str());
+  SUPLA_LOG_INFO("%s", buf);
+  log(buf);
+  snprintf(buf, BUF_SIZE, "SW update url: \"%s\"", urlStr.c_str());
+  SUPLA_LOG_INFO("%s", buf);
+  log(buf);
+
+  delete[] newVersion;
+  newVersion = new char[versionStr.size() + 1];
+  snprintf(newVersion, versionStr.size() + 1, "%s", versionStr.c_str());
+
+  delete[] updateUrl;
+  updateUrl = new char[urlStr.size() + 1];
+  snprintf(updateUrl, urlStr.size() + 1, "%s", urlStr.c_str());
+
+  deltaUrl.clear();
+  auto newDeltaUrl = latestUpdate->find("deltaUpdateUrl");
+  if (newDeltaUrl != latestUpdate->end() && newDeltaUrl->is_string()) {
+    deltaUrl = newDeltaUrl->get<std::string>();
+    snprintf(buf, BUF_SIZE, "SW update delta url: \"%s\"", deltaUrl.c_str());
+    SUPLA_LOG_INFO("%s", buf);
+  }
+
+  auto changelog = latestUpdate->find("changelogUrl");
+  if (changelog != latestUpdate->end() && changelog->is_string()) {
+    std::string changelogStr = changelog->get<std::string>();
+    if (changelogStr.size() + 1 < SUPLA_URL_PATH_MAXSIZE) {
+      delete[] changelogUrl;
+      changelogUrl = new char[changelogStr.size() + 1];
+      snprintf(changelogUrl,
+               changelogStr.size() + 1,
+               "%s",
+               changelogStr.c_str());
+    } else {
+      SUPLA_LOG_WARNING("SW update: changelogUrl too long, skipping");
+    }
+  } else {
+    SUPLA_LOG_WARNING("SW update: no changelogUrl received");
+  }
+
+  if (mode == Supla::SwUpdateMode::OnlyCheck) {
+    abort = true;
+    retryAllowed = false;
+    state = State::DONE;
+    notifyFinished(true);
+    return;
+  }
+  mode = Supla::SwUpdateMode::CheckAndUpdate;
+  if (!deltaUrl.empty() && currentImageSha256Set) {
+    startDeltaDownload();
+  } else {
+    startDownload();
+  }
+}
+
+bool Supla::LinuxSwUpdate::openPartFile() {
+  delete hash;
+  hash = new Supla::Sha256;
+  tailSize = 0;
+  imageSize = 0;
+  lastNotifiedBytes = 0;
+  part = fopen(partFile.c_str(), resumeOffset > 0 ? "ab" : "wb");
+  return part != nullptr;
+}
+
+void Supla::LinuxSwUpdate::startDownload() {
+  slot = getInactiveSlot();
+  partFile = slotsPath + "/" + slot + ".part";
+  std::string urlFile = partFile + ".url";
+
+  mkdir(slotsPath.c_str(), 0755);
+
+  // previous attempt is continued only if it was for the same file
+  resumeOffset = 0;
+  std::string partUrl;
+  {
+    std::ifstream in(urlFile);
+    std::getline(in, partUrl);
+  }
+  struct stat st = {};
+  if (partUrl == updateUrl && stat(partFile.c_str(), &st) == 0 &&
+      st.st_size > 0) {
+    resumeOffset = static_cast<uint32_t>(st.st_size);
+  }
+  if (resumeOffset == 0) {
+    std::ofstream out(urlFile, std::ios::trunc);
+    out << updateUrl << "\n";
+    if (!out) {
+      retryAllowed = true;
+      fail("SW update: failed to create update file");
+      return;
+    }
+  }
+
+  if (!openPartFile()) {
+    retryAllowed = true;
+    fail("SW update: failed to create update file");
+    return;
+  }
+
+  if (resumeOffset > 0) {
+    // hash and tail state isn't stored, so stored part is hashed again
+    SUPLA_LOG_INFO("SW update: resuming download from %u bytes",
+                   resumeOffset);
+    FILE *in = fopen(partFile.c_str(), "rb");
+    uint8_t buf[4096];
+    size_t size = 0;
+    while (in && (size = fread(buf, 1, sizeof(buf), in)) > 0) {
+      processImageData(buf, size);
+    }
+    if (in) {
+      fclose(in);
+    }
+    if (imageSize != resumeOffset) {
+      retryAllowed = true;
+      removePartFile();
+      fail("SW update: failed to read update file");
+      return;
+    }
+  }
+
+  const char *path = nullptr;
+  if (!setServer(updateUrl, &path)) {
+    fail("SW update: invalid update url");
+    return;
+  }
+  char rangeHeader[64] = {};
+  if (resumeOffset > 0) {
+    snprintf(
+        rangeHeader, sizeof(rangeHeader), "Range: bytes=%u-\r\n", resumeOffset);
+  }
+  httpStatus = 0;
+  writeError = false;
+  state = State::DOWNLOADING;
+  if (!http.sendRequest(path, resumeOffset > 0 ? rangeHeader : nullptr)) {
+    retryAllowed = true;
+    fail("SW update: connection init with update server failed");
+  }
+}
+
+void Supla::LinuxSwUpdate::startDeltaDownload() {
+  slot = getInactiveSlot();
+  partFile = slotsPath + "/" + slot + ".part";
+  mkdir(slotsPath.c_str(), 0755);
+
+  // patch is applied in a single pass, so it isn't resumed and previously
+  // stored part is dropped
+  removePartFile();
+  resumeOffset = 0;
+  deltaUpdate = true;
+  deltaFailed = false;
+
+  std::string path = slotsPath + "/" + currentLink;
+  currentImage = fopen(path.c_str(), "rb");
+  if (currentImage == nullptr) {
+    fallbackToFullImage("failed to open active slot");
+    return;
+  }
+  if (!openPartFile()) {
+    fallbackToFullImage("failed to create update file");
+    return;
+  }
+  delete patch;
+  patch = new Supla::Device::DeltaPatch(
+      this, this, currentImageSize, currentImageSha256);
+
+  const char *urlPath = nullptr;
+  if (!setServer(deltaUrl.c_str(), &urlPath)) {
+    fallbackToFullImage("invalid delta update url");
+    return;
+  }
+  SUPLA_LOG_INFO("SW update: downloading delta patch");
+  httpStatus = 0;
+  writeError = false;
+  totalBytes = 0;
+  state = State::DOWNLOADING;
+  if (!http.sendRequest(urlPath, nullptr)) {
+    fallbackToFullImage("connection init with update server failed");
+  }
+}
+
+void Supla::LinuxSwUpdate::fallbackToFullImage(const char *reason) {
+  char buf[BUF_SIZE] = {};
+  snprintf(buf,
+           BUF_SIZE,
+           "SW update: delta update failed (%s), downloading full image",
+           reason ? reason : "unknown error");
+  SUPLA_LOG_WARNING("%s", buf);
+  log(buf);
+  http.stop();
+  closeDeltaPatch();
+  removePartFile();
+  deltaUpdate = false;
+  deltaFailed = false;
+  startDownload();
+}
+
+void Supla::LinuxSwUpdate::closeDeltaPatch() {
+  if (currentImage) {
+    fclose(currentImage);
+    currentImage = nullptr;
+  }
+  delete patch;
+  patch = nullptr;
+}
+
+bool Supla::LinuxSwUpdate::readSourceImage(uint32_t offset,
+                                           uint8_t *buf,
+                                           int size) {
+  return currentImage != nullptr &&
+         fseek(currentImage, offset, SEEK_SET) == 0 &&
+         fread(buf, 1, size, currentImage) == static_cast<size_t>(size);
+}
+
+bool Supla::LinuxSwUpdate::writeTargetImage(const uint8_t *data, int size) {
+  if (fwrite(data, 1, size, part) != static_cast<size_t>(size)) {
+    writeError = true;
+    return false;
+  }
+  processImageData(data, size);
+  return true;
+}
+
+void Supla::LinuxSwUpdate::processImageData(const uint8_t *data, int size) {
+  imageSize += size;
+  // bytes which are moved out of tail belong to the app and are hashed
+  const int tailCapacity = sizeof(tail);
+  if (size >= tailCapacity) {
+    hash->update(tail, tailSize);
+    hash->update(data, size - tailCapacity);
+    memcpy(tail, data + size - tailCapacity, tailCapacity);
+    tailSize = tailCapacity;
+    return;
+  }
+  int overflow = tailSize + size - tailCapacity;
+  if (overflow > 0) {
+    hash->update(tail, overflow);
+    memmove(tail, tail + overflow, tailSize - overflow);
+    tailSize -= overflow;
+  }
+  memcpy(tail + tailSize, data, size);
+  tailSize += size;
+}
+
+void Supla::LinuxSwUpdate::finishDownload() {
+  SUPLA_LOG_INFO("Download complete. Wrote %u bytes", imageSize);
+  if (fflush(part) != 0 || fsync(fileno(part)) != 0) {
+    retryAllowed = true;
+    fail("SW update: file write fail");
+    return;
+  }
+  closePartFile();
+  closeDeltaPatch();
+
+  if (totalBytes != 0 && imageSize != totalBytes) {
+    retryAllowed = true;
+    fail("SW update: error in receiving complete file");
+    return;
+  }
+
+  if (tailSize != SignatureSize + FooterSize ||
+      imageSize == static_cast<uint32_t>(tailSize) ||
+      memcmp(tail + SignatureSize, expectedFooter, FooterSize) != 0 ||
+      !verifySignature(hash, tail)) {
+    removePartFile();
+    if (deltaUpdate) {
+      fallbackToFullImage("reconstructed image verification failed");
+      return;
+    }
+    retryAllowed = true;
+    fail("SW update: RSA signature verification failed");
+    return;
+  }
+
+  if (!activateSlot()) {
+    retryAllowed = true;
+    fail("SW update: failed to switch active slot");
+    return;
+  }
+
+  state = State::DONE;
+  finished = true;
+  notifyProgress(imageSize, totalBytes ? totalBytes : imageSize);
+  notifyFinished(true);
+}
+
+bool Supla::LinuxSwUpdate::activateSlot() {
+  std::string slotFile = slotsPath + "/" + slot;
+  if (chmod(partFile.c_str(), 0755) != 0 ||
+      rename(partFile.c_str(), slotFile.c_str()) != 0) {
+    SUPLA_LOG_ERROR("SW update: failed to store %s", slotFile.c_str());
+    return false;
+  }
+  unlink((partFile + ".url").c_str());
+
+  std::string link = slotsPath + "/" + currentLink;
+  std::string newLink = link + ".new";
+  unlink(newLink.c_str());
+  if (symlink(slot.c_str(), newLink.c_str()) != 0 ||
+      rename(newLink.c_str(), link.c_str()) != 0) {
+    SUPLA_LOG_ERROR("SW update: failed to update %s", link.c_str());
+    return false;
+  }
+  SUPLA_LOG_INFO("SW update: %s is active", slot.c_str());
+  return true;
+}
+
+bool Supla::LinuxSwUpdate::verifySignature(Supla::Sha256 *hash,
+                                           const uint8_t *signature) {
+#if !defined(SUPLA_TEST) || defined(SUPLA_TEST_RSA_VERIFICATOR)
+  static_assert(SignatureSize == RSA_NUM_BYTES, "Invalid signature size");
+  if (sdc && sdc->getRsaPublicKey()) {
+    Supla::RsaVerificator rsa(sdc->getRsaPublicKey());
+    if (rsa.verify(hash, signature)) {
+      SUPLA_LOG_DEBUG("RSA signature verification successful");
+      return true;
+    }
+    SUPLA_LOG_ERROR("Fail: Incorrect RSA signature");
+    return false;
+  }
+  SUPLA_LOG_ERROR("Fail: RSA public key not set in SuplaDevice instance");
+#else
+  (void)(hash);
+  (void)(signature);
+#endif
+  return false;
+}
+
+void Supla::LinuxSwUpdate::closePartFile() {
+  if (part) {
+    fclose(part);
+    part = nullptr;
+  }
+}
+
+void Supla::LinuxSwUpdate::removePartFile() {
+  closePartFile();
+  unlink(partFile.c_str());
+  unlink((partFile + ".url").c_str());
+}
+
+void Supla::LinuxSwUpdate::fail(const char *reason) {
+  http.stop();
+  closePartFile();
+  closeDeltaPatch();
+  state = State::DONE;
+  log(reason);
+  notifyFinished(false, reason);
+  abort = true;
+}
+
+void Supla::LinuxSwUpdate::log(const char *value) {
+  if (sdc && mode != Supla::SwUpdateMode::PeriodicCheckAndUpdate) {
+    // in periodic check mode we don't log to last state
+    sdc->addLastStateLog(value);
+  }
+}
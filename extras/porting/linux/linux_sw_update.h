@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_LINUX_SW_UPDATE_H_
+#define EXTRAS_PORTING_LINUX_LINUX_SW_UPDATE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <supla/device/delta_patch.h>
+#include <supla/device/sw_update.h>
+#include <supla/pv/http_poller.h>
+#include <supla/sha256.h>
+
+#include <string>
+
+// max number of firmware bytes processed in a single iterate() call
+#define SUPLA_LINUX_SW_UPDATE_ITERATE_BUDGET (64 * 1024)
+// max size of check update response
+#define SUPLA_LINUX_SW_UPDATE_MAX_RESPONSE 4096
+
+namespace Supla {
+
+/**
+ * SW update for sd4linux with A/B slots.
+ *
+ * Slots directory contains "slot_a" and "slot_b" executables and "current"
+ * symlink to the active one (service should be started through it).
+ * New image is downloaded to "<inactive slot>.part" file. It is hashed
+ * while it is written, with signature and footer kept in memory, so the
+ * file is never read back for verification. Image format is the same as
+ * for ESP-IDF: app, RSA signature (512 B) and footer (16 B).
+ * After successful verification part file is renamed to the slot and
+ * "current" symlink is replaced with rename(), so switch is atomic.
+ *
+ * Interrupted download is continued with HTTP Range request by the next
+ * attempt for the same url. Already stored part is hashed once then.
+ *
+ * SHA-256 of the active slot is sent in check update request. When server
+ * responds with "deltaUpdateUrl", patch is downloaded instead of the full
+ * image and applied on the fly to the active slot (see
+ * Supla::Device::DeltaPatch). Reconstructed image is verified in the same
+ * way as the full one. If patch can't be applied or verification fails,
+ * full image is downloaded from "updateUrl".
+ */
+class LinuxSwUpdate : public Supla::Device::SwUpdate,
+                      public Supla::PV::HttpResponseHandler,
+                      public Supla::Device::DeltaPatchSource,
+                      public Supla::Device::DeltaPatchOutput {
+ public:
+  friend Supla::Device::SwUpdate *Supla::Device::SwUpdate::Create(
+      SuplaDeviceClass *sdc, const char *url, Supla::SwUpdateMode mode);
+
+  static constexpr int SignatureSize = 512;
+  static constexpr int FooterSize = 16;
+
+  static void SetSlotsPath(const std::string &path);
+  static const std::string &GetSlotsPath();
+
+  ~LinuxSwUpdate();
+  void iterate() override;
+
+  void onHttpBody(const char *data, int size) override;
+  void onHttpHeaders(int statusCode, int32_t contentLength) override;
+  void onHttpResponseComplete(bool success, int statusCode) override;
+
+  bool readSourceImage(uint32_t offset, uint8_t *buf, int size) override;
+  bool writeTargetImage(const uint8_t *data, int size) override;
+
+  // Name of slot which is used for the next update
+  std::string getInactiveSlot() const;
+  // Offset from which last download was started (0 - not resumed)
+  uint32_t getResumeOffset() const;
+  // True when image is (or was) reconstructed from delta patch
+  bool isDeltaUpdate() const;
+
+ protected:
+  enum class State : uint8_t {
+    IDLE,
+    CHECKING,
+    DOWNLOADING,
+    DONE
+  };
+
+  LinuxSwUpdate(SuplaDeviceClass *sdc,
+                const char *newUrl,
+                Supla::SwUpdateMode mode);
+
+  virtual bool verifySignature(Supla::Sha256 *hash, const uint8_t *signature);
+
+  bool setServer(const char *requestUrl, const char **path);
+  bool hashCurrentImage();
+  void startCheck();
+  void handleCheckResponse();
+  void startDownload();
+  void startDeltaDownload();
+  void fallbackToFullImage(const char *reason);
+  void closeDeltaPatch();
+  bool openPartFile();
+  void processImageData(const uint8_t *data, int size);
+  void finishDownload();
+  bool activateSlot();
+  void closePartFile();
+  void removePartFile();
+  void fail(const char *reason);
+  void log(const char *value);
+
+  Supla::PV::HttpPoller http;
+  State state = State::IDLE;
+  std::string response;
+  int httpStatus = 0;
+  bool responseOverflow = false;
+
+  std::string slot;
+  std::string partFile;
+  FILE *part = nullptr;
+  Supla::Sha256 *hash = nullptr;
+  // last SignatureSize + FooterSize bytes of image, not hashed yet
+  uint8_t tail[SignatureSize + FooterSize] = {};
+  int tailSize = 0;
+  uint32_t imageSize = 0;
+  uint32_t resumeOffset = 0;
+  uint32_t totalBytes = 0;
+  uint32_t lastNotifiedBytes = 0;
+  uint32_t receivedInIterate = 0;
+  bool writeError = false;
+
+  std::string deltaUrl;
+  Supla::Device::DeltaPatch *patch = nullptr;
+  FILE *currentImage = nullptr;
+  uint32_t currentImageSize = 0;
+  bool deltaUpdate = false;
+  bool deltaFailed = false;
+
+  static std::string slotsPath;
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_PORTING_LINUX_LINUX_SW_UPDATE_H_
@@ -4,6 +4,7 @@
 #include "linux_yaml_config.h"
 
 #include <supla-common/proto.h>
+#include <supla/command_executor.h>
 #include <supla/control/action_trigger_parsed.h>
 #include <supla/control/cmd_relay.h>
 #include <supla/control/cmd_roller_shutter.h>
@@ -15,12 +16,14 @@
 #include <supla/custom_channel.h>
 #include <supla/device/register_device.h>
 #include <supla/log_wrapper.h>
+#include <supla/modbus/modbus_em_handler.h>
 #include <supla/network/ip_address.h>
 #include <supla/output/cmd.h>
 #include <supla/output/file.h>
 #include <supla/output/mqtt.h>
 #include <supla/output/output.h>
 #include <supla/parser/json.h>
+#include <supla/parser/modbus.h>
 #include <supla/parser/parser.h>
 #include <supla/parser/simple.h>
 #include <supla/payload/json.h>
@@ -42,11 +45,13 @@
 #include <supla/sensor/weight_parsed.h>
 #include <supla/sensor/wind_parsed.h>
 #include <supla/source/cmd.h>
+#include <supla/source/coprocess.h>
 #include <supla/source/file.h>
 #ifdef SUPLA_LINUX_HTTP_SOURCE_ENABLED
 #include <supla/source/http.h>
 #endif
 #include <SuplaDevice.h>
+#include <supla/source/modbus.h>
 #include <supla/source/mqtt_src.h>
 #include <supla/source/source.h>
 #include <supla/tools.h>
@@ -63,6 +68,7 @@
 
 #include "linux_channel_factory.h"
 #include "linux_extension_init.h"
+#include "linux_modbus_tcp_server.h"
 #include "supla/control/custom_hvac.h"
 #include "supla/control/hvac_parsed.h"
 #include "supla/sensor/sensor_parsed.h"
@@ -291,6 +297,28 @@ bool Supla::LinuxYamlConfig::isProtoVerboseLog() {
   return false;
 }
 
+bool Supla::LinuxYamlConfig::isAsyncLog() {
+  try {
+    if (config["async_log"]) {
+      return config["async_log"].as<bool>();
+    }
+  } catch (const YAML::Exception& ex) {
+    logError(file, ex);
+  }
+  return false;
+}
+
+bool Supla::LinuxYamlConfig::isNonBlockingConnect() {
+  try {
+    if (config["nonblocking_connect"]) {
+      return config["nonblocking_connect"].as<bool>();
+    }
+  } catch (const YAML::Exception& ex) {
+    logError(file, ex);
+  }
+  return false;
+}
+
 bool Supla::LinuxYamlConfig::generateGuidAndAuthkey() {
   char guid[SUPLA_GUID_SIZE] = {};
   char authkey[SUPLA_AUTHKEY_SIZE] = {};
@@ -331,6 +359,67 @@ bool Supla::LinuxYamlConfig::getUInt8(const char* key, uint8_t* result) {
   return false;
 }
 
+bool Supla::LinuxYamlConfig::findFirstKey(ConfigKeyCursor* cursor) {
+  if (Supla::KeyValue::findFirstKey(cursor)) {
+    return true;
+  }
+  return cursor != nullptr && cursor->owner == this &&
+         findYamlKey(cursor, true);
+}
+
+bool Supla::LinuxYamlConfig::findNextKey(ConfigKeyCursor* cursor) {
+  if (cursor == nullptr || cursor->owner != this) {
+    return false;
+  }
+  if (cursor->position == 0) {
+    if (Supla::KeyValue::findNextKey(cursor)) {
+      return true;
+    }
+    return findYamlKey(cursor, true);
+  }
+  return findYamlKey(cursor, false);
+}
+
+void Supla::LinuxYamlConfig::releaseKeyCursor(ConfigKeyCursor* cursor) {
+  if (cursor != nullptr && cursor->owner == this && cursor->position == 1) {
+    delete static_cast<YAML::const_iterator*>(cursor->handle);
+  }
+  Supla::KeyValue::releaseKeyCursor(cursor);
+}
+
+bool Supla::LinuxYamlConfig::findYamlKey(ConfigKeyCursor* cursor, bool start) {
+  if (start) {
+    // position 1 means that handle holds yaml iterator
+    cursor->handle = nullptr;
+    if (!config.IsMap()) {
+      return false;
+    }
+    cursor->position = 1;
+    cursor->handle = new YAML::const_iterator(config.begin());
+  }
+  auto it = static_cast<YAML::const_iterator*>(cursor->handle);
+  if (it == nullptr) {
+    return false;
+  }
+  try {
+    for (; *it != config.end(); ++(*it)) {
+      if (!(*it)->second.IsScalar()) {
+        continue;
+      }
+      auto name = (*it)->first.as<std::string>();
+      // keys present in KeyValue storage were already reported
+      if (cursor->match(name.c_str()) &&
+          Supla::KeyValue::find(name.c_str()) == nullptr) {
+        ++(*it);
+        return true;
+      }
+    }
+  } catch (const YAML::Exception& ex) {
+    logError(file, ex);
+  }
+  return false;
+}
+
 void Supla::LinuxYamlConfig::commit() {
   uint8_t buf[SUPLA_LINUX_CONFIG_BUF_SIZE] = {};
 
@@ -588,6 +677,9 @@ bool Supla::LinuxYamlConfig::loadChannels() {
     if (!loadTopLevelParsers(config["parsers"])) {
       return false;
     }
+    if (!loadModbusTcpServer(config["modbus_tcp_server"])) {
+      return false;
+    }
     if (config["channels"]) {
       auto channels = config["channels"];
       int channelCount = 0;
@@ -730,6 +822,57 @@ bool Supla::LinuxYamlConfig::loadTopLevelParsers(
   return true;
 }
 
+bool Supla::LinuxYamlConfig::loadModbusTcpServer(
+    const YAML::Node& modbusNode) {
+  if (!modbusNode) {
+    return true;
+  }
+  if (!modbusNode.IsMap()) {
+    SUPLA_LOG_ERROR("Config: \"modbus_tcp_server\" section has to be a map");
+    return false;
+  }
+
+  int port = 502;
+  std::string bindAddress;
+  int unitId = 0;
+  int maxClients = 8;
+  if (modbusNode["port"]) {
+    port = modbusNode["port"].as<int>();
+  }
+  if (modbusNode["bind_address"]) {
+    bindAddress = modbusNode["bind_address"].as<std::string>();
+  }
+  if (modbusNode["unit_id"]) {
+    unitId = modbusNode["unit_id"].as<int>();
+  }
+  if (modbusNode["max_clients"]) {
+    maxClients = modbusNode["max_clients"].as<int>();
+  }
+  if (port < 1 || port > 65535 || unitId < 0 || unitId > 247 ||
+      maxClients < 1) {
+    SUPLA_LOG_ERROR("Config: invalid \"modbus_tcp_server\" parameters");
+    return false;
+  }
+
+  SUPLA_LOG_INFO("Config: adding Modbus TCP server on port %d", port);
+  new Supla::Linux::ModbusTcpServer(
+      port, bindAddress, static_cast<uint8_t>(unitId), maxClients);
+  return true;
+}
+
+bool Supla::LinuxYamlConfig::addModbusEmHandler(
+    const YAML::Node& ch, Supla::Sensor::ElectricityMeter* em) {
+  if (auto offsetParameter = getAndMarkChannelParameter(ch, "modbus_offset")) {
+    int offset = offsetParameter.as<int>();
+    if (offset < 0 || offset > 65535 - 4 * EM_REGISTER_BLOCK_MAX_SIZE) {
+      SUPLA_LOG_ERROR("Channel config: invalid \"modbus_offset\" %d", offset);
+      return false;
+    }
+    new Supla::ModbusEMHandler(em, static_cast<uint16_t>(offset));
+  }
+  return true;
+}
+
 bool Supla::LinuxYamlConfig::parseChannel(const YAML::Node& ch,
                                           int channelIndex) {
   if (channelIndex >= SUPLA_CHANNELMAXCOUNT) {
@@ -1170,7 +1313,8 @@ bool Supla::LinuxYamlConfig::addFronius(const YAML::Node& ch,
 
     IPAddress ipAddr(ip);
     auto fronius = new Supla::PV::Fronius(ipAddr, port, deviceId, deviceType);
-    return addCommonParameters(ch, fronius);
+    return addModbusEmHandler(ch, fronius) &&
+           addCommonParameters(ch, fronius);
   } else {
     SUPLA_LOG_ERROR("Channel[%d] config: missing mandatory \"ip\" parameter",
                     channelNumber);
@@ -1231,7 +1375,8 @@ bool Supla::LinuxYamlConfig::addSolarEdge(const YAML::Node& ch,
 
   auto solarEdge = new Supla::PV::SolarEdge(
       apiKey.c_str(), siteId.c_str(), inverterSerialNumber.c_str(), clock);
-  return addCommonParameters(ch, solarEdge);
+  return addModbusEmHandler(ch, solarEdge) &&
+         addCommonParameters(ch, solarEdge);
 }
 
 bool Supla::LinuxYamlConfig::addAfore(const YAML::Node& ch, int channelNumber) {
@@ -1265,7 +1410,7 @@ bool Supla::LinuxYamlConfig::addAfore(const YAML::Node& ch, int channelNumber) {
 
     IPAddress ipAddr(ip);
     auto afore = new Supla::PV::Afore(ipAddr, port, loginAndPassword.c_str());
-    return addCommonParameters(ch, afore);
+    return addModbusEmHandler(ch, afore) && addCommonParameters(ch, afore);
   } else {
     SUPLA_LOG_ERROR("Channel[%d] config: missing mandatory \"ip\" parameter",
                     channelNumber);
@@ -1804,7 +1949,8 @@ bool Supla::LinuxYamlConfig::addElectricityMeterParsed(
     }
   }
 
-  return addCommonParametersParsed(ch, em, parser);
+  return addModbusEmHandler(ch, em) &&
+         addCommonParametersParsed(ch, em, parser);
 }
 
 bool Supla::LinuxYamlConfig::addBinaryParsed(const YAML::Node& ch,
@@ -1995,6 +2141,13 @@ Supla::Parser::Parser* Supla::LinuxYamlConfig::addParser(
       prs = new Supla::Parser::Simple(src);
     } else if (type == "Json") {
       prs = new Supla::Parser::Json(src);
+    } else if (type == "Modbus") {
+      auto modbusSrc = dynamic_cast<Supla::Source::Modbus*>(src);
+      if (!modbusSrc) {
+        SUPLA_LOG_ERROR("Config: \"Modbus\" parser requires \"Modbus\" source");
+        return nullptr;
+      }
+      prs = new Supla::Parser::Modbus(modbusSrc);
     } else {
       SUPLA_LOG_ERROR("Config: unknown parser type \"%s\"", type.c_str());
       return nullptr;
@@ -2110,7 +2263,40 @@ Supla::Source::Source* Supla::LinuxYamlConfig::addSource(
         return nullptr;
       }
       std::string cmd = source["command"].as<std::string>();
-      src = new Supla::Source::Cmd(cmd.c_str());
+      auto cmdSource = new Supla::Source::Cmd(cmd.c_str());
+      if (source["async"].as<bool>(false)) {
+        cmdSource->setExecutor(Supla::Linux::CommandExecutor::Instance(),
+                               source["timeout_ms"].as<uint32_t>(0));
+      }
+      src = cmdSource;
+    } else if (type == "CoProcess") {
+      if (!source["command"]) {
+        SUPLA_LOG_ERROR("Config: 'command' not defined for 'CoProcess' source");
+        return nullptr;
+      }
+      auto format = Supla::Source::CoProcess::Format::Lines;
+      std::string formatName = source["format"].as<std::string>("lines");
+      if (formatName == "json") {
+        format = Supla::Source::CoProcess::Format::Json;
+      } else if (formatName != "lines") {
+        SUPLA_LOG_ERROR(
+            "Config: unknown 'format' \"%s\" for 'CoProcess' source",
+            formatName.c_str());
+        return nullptr;
+      }
+      auto coProcess = new Supla::Source::CoProcess(
+          source["command"].as<std::string>(), format);
+      if (source["key"] &&
+          !coProcess->setKey(source["key"].as<std::string>())) {
+        SUPLA_LOG_ERROR("Config: invalid 'key' for 'CoProcess' source");
+        delete coProcess;
+        return nullptr;
+      }
+      if (source["max_record_size"]) {
+        coProcess->setMaxRecordSize(source["max_record_size"].as<size_t>());
+      }
+      coProcess->setExpirationTime(source["expiration_time_sec"].as<int>(0));
+      src = coProcess;
     } else if (type == "MQTT") {
       auto base_state_topic = source["state_topic"].as<std::string>();
       int qos = source["qos"].as<int>(0);
@@ -2126,6 +2312,11 @@ Supla::Source::Source* Supla::LinuxYamlConfig::addSource(
         allSubTopics.push_back(base_state_topic);
       }
       src = new Supla::Source::Mqtt(*this, allSubTopics, qos);
+    } else if (type == "Modbus") {
+      src = addModbusSource(source);
+      if (!src) {
+        return nullptr;
+      }
     } else if (type == "HTTP") {
 #ifndef SUPLA_LINUX_HTTP_SOURCE_ENABLED
       SUPLA_LOG_ERROR(
@@ -2233,6 +2424,66 @@ Supla::Source::Source* Supla::LinuxYamlConfig::addSource(
   return src;
 }
 
+Supla::Source::Source* Supla::LinuxYamlConfig::addModbusSource(
+    const YAML::Node& source) {
+  Supla::Source::ModbusConfig modbusConfig;
+  std::string protocol = source["protocol"].as<std::string>("tcp");
+  if (protocol == "tcp") {
+    if (!source["host"]) {
+      SUPLA_LOG_ERROR("Config: 'host' not defined for 'Modbus' tcp source");
+      return nullptr;
+    }
+    modbusConfig.protocol = Supla::Source::ModbusProtocol::TCP;
+    modbusConfig.host = source["host"].as<std::string>();
+    int port = source["port"].as<int>(502);
+    if (port < 1 || port > 65535) {
+      SUPLA_LOG_ERROR("Config: invalid 'port' for 'Modbus' source");
+      return nullptr;
+    }
+    modbusConfig.port = port;
+  } else if (protocol == "rtu") {
+    if (!source["device"]) {
+      SUPLA_LOG_ERROR("Config: 'device' not defined for 'Modbus' rtu source");
+      return nullptr;
+    }
+    modbusConfig.protocol = Supla::Source::ModbusProtocol::RTU;
+    modbusConfig.device = source["device"].as<std::string>();
+    modbusConfig.baudRate = source["baudrate"].as<int>(9600);
+    std::string parity = source["parity"].as<std::string>("none");
+    if (parity == "none") {
+      modbusConfig.parity = 'N';
+    } else if (parity == "even") {
+      modbusConfig.parity = 'E';
+    } else if (parity == "odd") {
+      modbusConfig.parity = 'O';
+    } else {
+      SUPLA_LOG_ERROR("Config: invalid 'parity' for 'Modbus' source");
+      return nullptr;
+    }
+    modbusConfig.stopBits = source["stop_bits"].as<int>(1);
+    if (modbusConfig.stopBits != 1 && modbusConfig.stopBits != 2) {
+      SUPLA_LOG_ERROR("Config: invalid 'stop_bits' for 'Modbus' source");
+      return nullptr;
+    }
+  } else {
+    SUPLA_LOG_ERROR("Config: unknown Modbus protocol \"%s\"",
+                    protocol.c_str());
+    return nullptr;
+  }
+
+  int timeoutMs = source["timeout_ms"].as<int>(1000);
+  int maxGap = source["max_gap"].as<int>(8);
+  int maxPipelined = source["max_pipelined"].as<int>(8);
+  if (timeoutMs <= 0 || maxGap < 0 || maxGap > 125 || maxPipelined < 1) {
+    SUPLA_LOG_ERROR("Config: invalid 'Modbus' source parameters");
+    return nullptr;
+  }
+  modbusConfig.timeoutMs = timeoutMs;
+  modbusConfig.maxGap = maxGap;
+  modbusConfig.maxPipelined = maxPipelined;
+  return new Supla::Source::Modbus(modbusConfig);
+}
+
 Supla::Output::Output* Supla::LinuxYamlConfig::addOutput(
     const YAML::Node& output) {
   Supla::Output::Output* out = nullptr;
@@ -2267,7 +2518,12 @@ Supla::Output::Output* Supla::LinuxYamlConfig::addOutput(
         return nullptr;
       }
       std::string cmd = output["command"].as<std::string>();
-      out = new Supla::Output::Cmd(cmd);
+      auto cmdOutput = new Supla::Output::Cmd(cmd);
+      if (output["async"].as<bool>(false)) {
+        cmdOutput->setExecutor(Supla::Linux::CommandExecutor::Instance(),
+                               output["timeout_ms"].as<uint32_t>(0));
+      }
+      out = cmdOutput;
     } else if (type == "File") {
       std::string fileName = output["file"].as<std::string>();
       out = new Supla::Output::File(fileName.c_str());
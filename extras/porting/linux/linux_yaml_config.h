@@ -22,6 +22,18 @@ log_level: debug
 # proto_verbose_log - optional, defaults to false; enables insecure low-level
 # protocol dumps that may expose secrets
 proto_verbose_log: false
+# async_log - optional, defaults to false; logs are written by low priority
+# thread
+async_log: false
+# nonblocking_connect - optional, defaults to false; TCP connect and TLS
+# handshake with Supla server don't block the main loop
+nonblocking_connect: false
+
+# modbus_tcp_server - optional; Modbus TCP server exposing channels with
+# "modbus_offset" parameter (electricity meters). Disabled by default:
+# port 502 requires root privileges and the server has no authentication.
+# modbus_tcp_server:
+#   port: 502
 
 supla:
   server: svrXYZ.supla.org
@@ -76,6 +88,8 @@ class LinuxYamlConfig : public KeyValue {
   bool isWarning();
   bool isError();
   bool isProtoVerboseLog();
+  bool isAsyncLog();
+  bool isNonBlockingConnect();
 
   bool loadChannels();
 
@@ -89,6 +103,11 @@ class LinuxYamlConfig : public KeyValue {
   // this method. It may be extended to other parameters in future (if needed).
   bool getUInt8(const char* key, uint8_t* result) override;
 
+  // Enumerates KeyValue storage first and then scalar top-level yaml keys
+  bool findFirstKey(ConfigKeyCursor* cursor) override;
+  bool findNextKey(ConfigKeyCursor* cursor) override;
+  void releaseKeyCursor(ConfigKeyCursor* cursor) override;
+
   void commit() override;
 
   // Device generic config
@@ -135,6 +154,9 @@ class LinuxYamlConfig : public KeyValue {
  protected:
   bool loadTopLevelSources(const YAML::Node& sourcesNode);
   bool loadTopLevelParsers(const YAML::Node& parsersNode);
+  bool loadModbusTcpServer(const YAML::Node& modbusNode);
+  bool addModbusEmHandler(const YAML::Node& ch,
+                          Supla::Sensor::ElectricityMeter* em);
   bool parseChannel(const YAML::Node& ch, int channelNumber);
   Supla::Source::Source* findSource(const std::string& name);
   Supla::Parser::Parser* findParser(const std::string& name);
@@ -146,6 +168,7 @@ class LinuxYamlConfig : public KeyValue {
   Supla::Parser::Parser* addParser(const YAML::Node& parser,
                                    Supla::Source::Source* src);
   Supla::Source::Source* addSource(const YAML::Node& ch);
+  Supla::Source::Source* addModbusSource(const YAML::Node& source);
   Supla::Payload::Payload* addPayload(const YAML::Node& payload,
                                          Supla::Output::Output* out);
   Supla::Output::Output* addOutput(const YAML::Node& ch);
@@ -239,6 +262,7 @@ class LinuxYamlConfig : public KeyValue {
                                     int channelNumber,
                                     Supla::Parser::Parser* parser);
 
+  bool findYamlKey(ConfigKeyCursor* cursor, bool start);
   void logError(const std::string& filename, const YAML::Exception& ex) const;
 
   std::string file;
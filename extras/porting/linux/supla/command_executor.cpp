@@ -0,0 +1,301 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "command_executor.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <supla/log_wrapper.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+extern char **environ;
+
+using Supla::Linux::CommandExecutor;
+using Supla::Linux::CommandResult;
+
+bool Supla::Linux::SpawnProcess(const std::vector<std::string> &argv,
+                                bool captureOutput,
+                                pid_t *pid,
+                                int *outputFd) {
+  if (argv.empty()) {
+    return false;
+  }
+  std::vector<char *> arguments;
+  arguments.reserve(argv.size() + 1);
+  for (auto &argument : argv) {
+    arguments.push_back(const_cast<char *>(argument.c_str()));
+  }
+  arguments.push_back(nullptr);
+
+  int fds[2] = {-1, -1};
+  if (captureOutput && pipe2(fds, O_CLOEXEC) != 0) {
+    SUPLA_LOG_WARNING("SpawnProcess: pipe() failed: %s", strerror(errno));
+    return false;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (captureOutput) {
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+  }
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  // own process group, so kill(-pid) stops also children of the shell
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setpgroup(&attributes, 0);
+
+  int result = posix_spawn(pid,
+                           arguments[0],
+                           &actions,
+                           &attributes,
+                           arguments.data(),
+                           environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+
+  if (captureOutput) {
+    close(fds[1]);
+  }
+  if (result != 0) {
+    SUPLA_LOG_WARNING("SpawnProcess: posix_spawn() failed: %s",
+                      strerror(result));
+    if (captureOutput) {
+      close(fds[0]);
+    }
+    return false;
+  }
+
+  if (captureOutput) {
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    *outputFd = fds[0];
+  }
+  return true;
+}
+
+bool CommandResult::isSuccess() const {
+  return status == Status::Finished && exitCode == 0;
+}
+
+CommandExecutor::CommandExecutor(int maxRunning, uint32_t defaultTimeoutMs)
+    : maxRunning(maxRunning > 0 ? maxRunning : 1),
+      defaultTimeoutMs(defaultTimeoutMs) {
+}
+
+CommandExecutor::~CommandExecutor() {
+  for (auto &process : running) {
+    kill(-process.pid, SIGKILL);
+    int status = 0;
+    while (waitpid(process.pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    closeOutput(&process);
+  }
+}
+
+CommandExecutor *CommandExecutor::Instance() {
+  static CommandExecutor *instance = nullptr;
+  if (instance == nullptr) {
+    instance = new CommandExecutor();
+  }
+  return instance;
+}
+
+void CommandExecutor::submit(const void *owner,
+                             std::vector<std::string> argv,
+                             CommandCallback callback,
+                             bool captureOutput,
+                             uint32_t timeoutMs) {
+  if (argv.empty()) {
+    return;
+  }
+  Job job;
+  job.owner = owner;
+  job.argv = std::move(argv);
+  job.callback = std::move(callback);
+  job.captureOutput = captureOutput;
+  job.timeoutMs = timeoutMs > 0 ? timeoutMs : defaultTimeoutMs;
+
+  for (auto &queued : queue) {
+    if (queued.owner == owner) {
+      SUPLA_LOG_DEBUG("CommandExecutor: queued command replaced by newer one");
+      queued = std::move(job);
+      supersededCount++;
+      return;
+    }
+  }
+  queue.push_back(std::move(job));
+  poll();
+}
+
+void CommandExecutor::cancel(const void *owner) {
+  for (auto it = queue.begin(); it != queue.end();) {
+    if (it->owner == owner) {
+      it = queue.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto &process : running) {
+    if (process.job.owner == owner) {
+      process.job.callback = nullptr;
+    }
+  }
+}
+
+void CommandExecutor::iterateAlways() {
+  poll();
+}
+
+void CommandExecutor::poll() {
+  std::vector<std::pair<CommandCallback, CommandResult>> finished;
+  auto now = Clock::now();
+
+  for (auto it = running.begin(); it != running.end();) {
+    auto &process = *it;
+    readOutput(&process);
+
+    int status = 0;
+    pid_t result = waitpid(process.pid, &status, WNOHANG);
+    if (result == 0) {
+      if (!process.timedOut && now >= process.deadline) {
+        SUPLA_LOG_WARNING("CommandExecutor: command timeout, killing pid %d",
+                          process.pid);
+        kill(-process.pid, SIGKILL);
+        process.timedOut = true;
+      }
+      ++it;
+      continue;
+    }
+    if (result == -1 && errno == EINTR) {
+      ++it;
+      continue;
+    }
+
+    readOutput(&process);
+    closeOutput(&process);
+    CommandResult commandResult;
+    if (process.timedOut) {
+      commandResult.status = CommandResult::Status::Timeout;
+    } else {
+      commandResult.status = CommandResult::Status::Finished;
+      if (result > 0 && WIFEXITED(status)) {
+        commandResult.exitCode = WEXITSTATUS(status);
+      }
+    }
+    commandResult.output = std::move(process.output);
+    if (process.job.callback) {
+      finished.emplace_back(std::move(process.job.callback),
+                            std::move(commandResult));
+    }
+    it = running.erase(it);
+  }
+
+  startQueued(&finished);
+
+  // callbacks may submit new commands, so they are called at the end
+  for (auto &entry : finished) {
+    entry.first(entry.second);
+  }
+}
+
+bool CommandExecutor::waitForIdle(uint32_t timeoutMs) {
+  auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+  poll();
+  while (!isIdle()) {
+    if (Clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    poll();
+  }
+  return true;
+}
+
+bool CommandExecutor::isIdle() const {
+  return running.empty() && queue.empty();
+}
+
+size_t CommandExecutor::getRunningCount() const {
+  return running.size();
+}
+
+size_t CommandExecutor::getQueuedCount() const {
+  return queue.size();
+}
+
+uint32_t CommandExecutor::getSupersededCount() const {
+  return supersededCount;
+}
+
+bool CommandExecutor::isOwnerRunning(const void *owner) const {
+  for (auto &process : running) {
+    if (process.job.owner == owner) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CommandExecutor::startQueued(
+    std::vector<std::pair<CommandCallback, CommandResult>> *finished) {
+  for (auto it = queue.begin();
+       it != queue.end() && static_cast<int>(running.size()) < maxRunning;) {
+    if (isOwnerRunning(it->owner)) {
+      // waits for previous command of the same owner
+      ++it;
+      continue;
+    }
+    Process process;
+    process.job = std::move(*it);
+    it = queue.erase(it);
+    process.deadline =
+        Clock::now() + std::chrono::milliseconds(process.job.timeoutMs);
+    if (SpawnProcess(process.job.argv,
+                     process.job.captureOutput,
+                     &process.pid,
+                     &process.outputFd)) {
+      running.push_back(std::move(process));
+    } else if (process.job.callback) {
+      CommandResult result;
+      result.status = CommandResult::Status::SpawnFailed;
+      finished->emplace_back(std::move(process.job.callback),
+                             std::move(result));
+    }
+  }
+}
+
+void CommandExecutor::readOutput(Process *process) {
+  if (process->outputFd < 0) {
+    return;
+  }
+  char buffer[1024];
+  while (true) {
+    ssize_t size = read(process->outputFd, buffer, sizeof(buffer));
+    if (size > 0) {
+      size_t space = MaxOutputSize - process->output.size();
+      process->output.append(
+          buffer, static_cast<size_t>(size) < space ? size : space);
+      continue;
+    }
+    if (size == -1 && errno == EINTR) {
+      continue;
+    }
+    // EAGAIN - no more data now, 0 - end of output
+    break;
+  }
+}
+
+void CommandExecutor::closeOutput(Process *process) {
+  if (process->outputFd >= 0) {
+    close(process->outputFd);
+    process->outputFd = -1;
+  }
+}
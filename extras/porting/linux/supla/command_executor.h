@@ -0,0 +1,140 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_SUPLA_COMMAND_EXECUTOR_H_
+#define EXTRAS_PORTING_LINUX_SUPLA_COMMAND_EXECUTOR_H_
+
+#include <supla/element.h>
+#include <sys/types.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Supla {
+namespace Linux {
+
+struct CommandResult {
+  enum class Status {
+    Finished,
+    Timeout,
+    SpawnFailed,
+  };
+
+  Status status = Status::SpawnFailed;
+  // exit code of the process (valid for Finished status)
+  int exitCode = -1;
+  // stdout of the process (only when output capture was requested)
+  std::string output;
+
+  bool isSuccess() const;
+};
+
+using CommandCallback = std::function<void(const CommandResult &)>;
+
+// Starts argv[0] (full path) in a new process group. When captureOutput is
+// set, *outputFd receives non-blocking read end of process' stdout.
+// Returns false when process couldn't be started.
+bool SpawnProcess(const std::vector<std::string> &argv,
+                  bool captureOutput,
+                  pid_t *pid,
+                  int *outputFd);
+
+/**
+ * Runs Linux commands without blocking the main loop.
+ *
+ * Commands are started with posix_spawn() in their own process group, so
+ * whole command (including its children) is killed on timeout. At most
+ * maxRunning processes run at the same time, others wait in the queue.
+ * Stdout is read through a non-blocking pipe.
+ *
+ * Each command belongs to an owner (i.e. Output::Cmd instance). Only one
+ * command of an owner runs at a time and only the latest one waits in the
+ * queue: a new command replaces the queued one, so repeated relay toggles
+ * don't execute stale requests. Running command is not interrupted.
+ *
+ * Results are delivered by callbacks called from iterateAlways() (main loop).
+ */
+class CommandExecutor : public Supla::Element {
+ public:
+  static constexpr int DefaultMaxRunning = 4;
+  static constexpr uint32_t DefaultTimeoutMs = 30000;
+  static constexpr size_t MaxOutputSize = 256 * 1024;
+
+  explicit CommandExecutor(int maxRunning = DefaultMaxRunning,
+                           uint32_t defaultTimeoutMs = DefaultTimeoutMs);
+  ~CommandExecutor() override;
+
+  // Shared executor used by sd4linux config. Created on first call.
+  static CommandExecutor *Instance();
+
+  /**
+   * Queues command for execution.
+   *
+   * @param owner identifies commands which supersede each other
+   * @param argv program path (argv[0]) followed by its arguments
+   * @param callback called from main loop when command ends (may be empty)
+   * @param captureOutput true to collect stdout in result
+   * @param timeoutMs 0 to use executor's default timeout
+   */
+  void submit(const void *owner,
+              std::vector<std::string> argv,
+              CommandCallback callback,
+              bool captureOutput = false,
+              uint32_t timeoutMs = 0);
+  // Drops queued command of owner. Running command is finished, but its
+  // callback is not called. Has to be called when owner is destroyed.
+  void cancel(const void *owner);
+
+  void iterateAlways() override;
+  // Checks running processes and starts queued ones. Never blocks.
+  void poll();
+  // Polls until all commands end. Returns false on timeout.
+  bool waitForIdle(uint32_t timeoutMs);
+
+  bool isIdle() const;
+  size_t getRunningCount() const;
+  size_t getQueuedCount() const;
+  // Number of queued commands replaced by newer ones
+  uint32_t getSupersededCount() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Job {
+    const void *owner = nullptr;
+    std::vector<std::string> argv;
+    CommandCallback callback;
+    bool captureOutput = false;
+    uint32_t timeoutMs = 0;
+  };
+
+  struct Process {
+    Job job;
+    pid_t pid = -1;
+    int outputFd = -1;
+    std::string output;
+    Clock::time_point deadline;
+    bool timedOut = false;
+  };
+
+  bool isOwnerRunning(const void *owner) const;
+  void startQueued(std::vector<std::pair<CommandCallback, CommandResult>>
+                       *finished);
+  void readOutput(Process *process);
+  void closeOutput(Process *process);
+
+  std::deque<Job> queue;
+  std::vector<Process> running;
+  int maxRunning = DefaultMaxRunning;
+  uint32_t defaultTimeoutMs = DefaultTimeoutMs;
+  uint32_t supersededCount = 0;
+};
+
+}  // namespace Linux
+}  // namespace Supla
+
+#endif  // EXTRAS_PORTING_LINUX_SUPLA_COMMAND_EXECUTOR_H_
@@ -3,6 +3,7 @@
 
 #include "cmd.h"
 
+#include <supla/command_executor.h>
 #include <supla/log_wrapper.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -442,11 +443,12 @@ static std::optional<std::string> buildCmd(std::string_view trustedCmdTemplate,
   return command;
 }
 
-static bool execCmd(const std::string& transformedTemplate,
-                    const std::vector<std::string>& payloadArguments) {
+static std::vector<std::string> buildArgv(
+    const std::string& transformedTemplate,
+    const std::vector<std::string>& payloadArguments) {
   std::vector<std::string> argvStorage;
   argvStorage.reserve(payloadArguments.size() + 4);
-  argvStorage.emplace_back("sh");
+  argvStorage.emplace_back("/bin/sh");
   argvStorage.emplace_back("-c");
   argvStorage.emplace_back(transformedTemplate);
   argvStorage.emplace_back("supla-cmd");
@@ -454,6 +456,13 @@ static bool execCmd(const std::string& transformedTemplate,
     argvStorage.push_back(argument);
   }
 
+  SUPLA_LOG_DEBUG("Command template: %s, argument count: %zu",
+                  transformedTemplate.c_str(),
+                  payloadArguments.size());
+  return argvStorage;
+}
+
+static bool execCmd(std::vector<std::string> argvStorage) {
   std::vector<char*> argv;
   argv.reserve(argvStorage.size() + 1);
   for (auto& argument : argvStorage) {
@@ -461,10 +470,6 @@ static bool execCmd(const std::string& transformedTemplate,
   }
   argv.push_back(nullptr);
 
-  SUPLA_LOG_DEBUG("Command template: %s, argument count: %zu",
-                  transformedTemplate.c_str(),
-                  payloadArguments.size());
-
   const pid_t pid = fork();
   if (pid == -1) {
     SUPLA_LOG_WARNING("Failed to fork command process: %s", strerror(errno));
@@ -491,39 +496,82 @@ static bool execCmd(const std::string& transformedTemplate,
   return WIFEXITED(status) && WEXITSTATUS(status) == 0;
 }
 
-static bool putScalarContent(std::string_view trustedCmdTemplate,
-                             std::string payload) {
+static std::optional<std::vector<std::string>> buildScalarArgv(
+    std::string_view trustedCmdTemplate, std::string payload) {
   if (payload.find('\0') != std::string::npos) {
-    return false;
+    return std::nullopt;
   }
 
   const auto command = buildCmd(trustedCmdTemplate, PayloadKind::kScalar);
   if (!command) {
-    return false;
+    return std::nullopt;
   }
 
-  return execCmd(*command, {std::move(payload)});
+  return buildArgv(*command, {std::move(payload)});
 }
 
 Supla::Output::Cmd::Cmd(std::string cmd) : cmdLine(cmd) {
 }
 
 Supla::Output::Cmd::~Cmd() {
+  if (executor) {
+    executor->cancel(this);
+  }
+}
+
+void Supla::Output::Cmd::setExecutor(Supla::Linux::CommandExecutor* executor,
+                                     uint32_t timeoutMs) {
+  if (this->executor && this->executor != executor) {
+    this->executor->cancel(this);
+  }
+  this->executor = executor;
+  this->timeoutMs = timeoutMs;
+}
+
+bool Supla::Output::Cmd::execute(std::vector<std::string> argv) {
+  if (executor == nullptr) {
+    return execCmd(std::move(argv));
+  }
+
+  executor->submit(
+      this,
+      std::move(argv),
+      [this](const Supla::Linux::CommandResult& result) {
+        // putContent() already returned, so failure can only be logged
+        using Status = Supla::Linux::CommandResult::Status;
+        if (result.status == Status::Timeout) {
+          SUPLA_LOG_WARNING("Output::Cmd: command timeout: %s",
+                            cmdLine.c_str());
+        } else if (result.status == Status::SpawnFailed) {
+          SUPLA_LOG_WARNING("Output::Cmd: failed to start command: %s",
+                            cmdLine.c_str());
+        } else if (!result.isSuccess()) {
+          SUPLA_LOG_WARNING("Output::Cmd: command failed (%d): %s",
+                            result.exitCode,
+                            cmdLine.c_str());
+        }
+      },
+      false,
+      timeoutMs);
+  return true;
 }
 
 bool Supla::Output::Cmd::putContent(int payload) {
   if (cmdLine.empty()) return false;
-  return putScalarContent(cmdLine, std::to_string(payload));
+  auto argv = buildScalarArgv(cmdLine, std::to_string(payload));
+  return argv && execute(std::move(*argv));
 }
 
 bool Supla::Output::Cmd::putContent(bool payload) {
   if (cmdLine.empty()) return false;
-  return putScalarContent(cmdLine, payload ? "true" : "false");
+  auto argv = buildScalarArgv(cmdLine, payload ? "true" : "false");
+  return argv && execute(std::move(*argv));
 }
 
 bool Supla::Output::Cmd::putContent(const std::string& payload) {
   if (cmdLine.empty()) return false;
-  return putScalarContent(cmdLine, payload);
+  auto argv = buildScalarArgv(cmdLine, payload);
+  return argv && execute(std::move(*argv));
 }
 
 bool Supla::Output::Cmd::putContent(const std::vector<int>& payload) {
@@ -540,5 +588,5 @@ bool Supla::Output::Cmd::putContent(const std::vector<int>& payload) {
     arguments.push_back(std::to_string(value));
   }
 
-  return execCmd(*command, arguments);
+  return execute(buildArgv(*command, arguments));
 }
@@ -4,12 +4,17 @@
 #ifndef EXTRAS_PORTING_LINUX_SUPLA_OUTPUT_CMD_H_
 #define EXTRAS_PORTING_LINUX_SUPLA_OUTPUT_CMD_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "output.h"
 
 namespace Supla {
+namespace Linux {
+class CommandExecutor;
+}  // namespace Linux
+
 namespace Output {
 
 class Cmd : public Output {
@@ -17,10 +22,20 @@ class Cmd : public Output {
   explicit Cmd(std::string cmd);
   virtual ~Cmd();
 
+  // When executor is set, commands are run asynchronously and putContent()
+  // returns true once command is queued. Failures and timeouts are logged
+  // when the command ends. Otherwise putContent() waits for the command and
+  // returns its result. timeoutMs 0 - executor's default.
+  void setExecutor(Supla::Linux::CommandExecutor *executor,
+                   uint32_t timeoutMs = 0);
+
  protected:
   std::string cmdLine;
+  Supla::Linux::CommandExecutor *executor = nullptr;
+  uint32_t timeoutMs = 0;
 
  private:
+  bool execute(std::vector<std::string> argv);
   bool putContent(int payload) override;
   bool putContent(const std::string &payload) override;
   bool putContent(const std::vector<int> &payload) override;
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "modbus.h"
+
+#include <supla/log_wrapper.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+Supla::Parser::Modbus::Modbus(Supla::Source::Modbus *src)
+    : Supla::Parser::Parser(src), modbusSource(src) {
+}
+
+void Supla::Parser::Modbus::addKey(const std::string &key, int index) {
+  Parser::addKey(key, index);
+  if (modbusSource) {
+    modbusSource->addKey(key);
+  }
+}
+
+bool Supla::Parser::Modbus::refreshSource() {
+  sourceValid = modbusSource && modbusSource->refresh();
+  valid = sourceValid;
+  return valid;
+}
+
+bool Supla::Parser::Modbus::isSourceValid() {
+  return sourceValid;
+}
+
+double Supla::Parser::Modbus::getValue(const std::string &key) {
+  double value = 0;
+  valid = sourceValid &&
+          modbusSource->getValue(modbusSource->findKey(key), &value) &&
+          std::isfinite(value);
+  return valid ? value : 0;
+}
+
+std::variant<int, bool, std::string> Supla::Parser::Modbus::getStateValue(
+    const std::string &key) {
+  double value = getValue(key);
+  if (!valid || std::fabs(value) > INT32_MAX) {
+    return -1;
+  }
+  return static_cast<int>(value);
+}
+
+bool Supla::Parser::Modbus::isBasedOnIndex() {
+  return false;
+}
@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_SUPLA_PARSER_MODBUS_H_
+#define EXTRAS_PORTING_LINUX_SUPLA_PARSER_MODBUS_H_
+
+#include <supla/source/modbus.h>
+
+#include <string>
+#include <variant>
+
+#include "parser.h"
+
+namespace Supla::Parser {
+
+/**
+ * Parser for Supla::Source::Modbus. Keys mapped to channel parameters are
+ * register specifications (see Supla::Source::Modbus), which are registered
+ * in the source, so all channels which use the same source are read in one
+ * poll cycle. Values are decoded directly from register data.
+ */
+class Modbus : public Parser {
+ public:
+  explicit Modbus(Supla::Source::Modbus *);
+
+  void addKey(const std::string &key, int index) override;
+  bool refreshSource() override;
+
+  double getValue(const std::string &key) override;
+  std::variant<int, bool, std::string> getStateValue(
+      const std::string &key) override;
+
+  bool isBasedOnIndex() override;
+  bool isSourceValid() override;
+
+ protected:
+  Supla::Source::Modbus *modbusSource = nullptr;
+  bool sourceValid = false;
+};
+
+}  // namespace Supla::Parser
+
+#endif  // EXTRAS_PORTING_LINUX_SUPLA_PARSER_MODBUS_H_
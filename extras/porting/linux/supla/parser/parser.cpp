@@ -24,6 +24,14 @@ bool Supla::Parser::Parser::isSourceValid() {
 bool Supla::Parser::Parser::refreshParserSource() {
   if (!lastRefreshTime || millis() - lastRefreshTime > refreshTimeMs) {
     lastRefreshTime = millis();
+    if (source && source->requestContent()) {
+      // content is parsed as soon as source reports that it is ready
+      return true;
+    }
+    return refreshSource();
+  }
+  if (source && source->getContentVersion() != contentVersion) {
+    contentVersion = source->getContentVersion();
     return refreshSource();
   }
   return true;
@@ -38,6 +38,8 @@ class Parser {
   bool valid = false;
   Supla::Source::Source *source = nullptr;
   uint32_t lastRefreshTime = 0;
+  // version of background source content which was parsed
+  uint32_t contentVersion = 0;
   unsigned int refreshTimeMs = 5 * 1000;  // 5 s
 };
 };  // namespace Parser
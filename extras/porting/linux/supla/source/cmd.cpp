@@ -3,7 +3,9 @@
 
 #include "cmd.h"
 
+#include <supla/command_executor.h>
 #include <supla/linux_command.h>
+#include <supla/log_wrapper.h>
 
 #include <cstdio>
 #include <string>
@@ -12,9 +14,61 @@ Supla::Source::Cmd::Cmd(const char *cmd) : cmdLine(cmd) {
 }
 
 Supla::Source::Cmd::~Cmd() {
+  if (executor) {
+    executor->cancel(this);
+  }
+}
+
+void Supla::Source::Cmd::setExecutor(Supla::Linux::CommandExecutor *executor,
+                                     uint32_t timeoutMs) {
+  if (this->executor && this->executor != executor) {
+    this->executor->cancel(this);
+  }
+  this->executor = executor;
+  this->timeoutMs = timeoutMs;
+  requestPending = false;
+}
+
+bool Supla::Source::Cmd::requestContent() {
+  if (executor == nullptr) {
+    return false;
+  }
+  if (requestPending) {
+    // i.e. source shared by a few parsers
+    return true;
+  }
+  requestPending = true;
+  executor->submit(
+      this,
+      {"/bin/sh", "-c", cmdLine},
+      [this](const Supla::Linux::CommandResult &result) {
+        using Status = Supla::Linux::CommandResult::Status;
+        requestPending = false;
+        contentVersion++;
+        if (result.status == Status::Finished) {
+          lastContent = result.output;
+          return;
+        }
+        SUPLA_LOG_WARNING(
+            "Source::Cmd: command %s: %s",
+            result.status == Status::Timeout ? "timeout" : "failed to start",
+            cmdLine.c_str());
+        lastContent.clear();
+      },
+      true,
+      timeoutMs);
+  return true;
+}
+
+uint32_t Supla::Source::Cmd::getContentVersion() {
+  return contentVersion;
 }
 
 std::string Supla::Source::Cmd::getContent() {
+  if (executor) {
+    return lastContent;
+  }
+
   auto p = Supla::Linux::openCommandPipe(cmdLine, "Source::Cmd");
   if (p) {
     std::string content;
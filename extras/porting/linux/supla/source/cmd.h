@@ -6,21 +6,39 @@
 
 #include <supla/parser/parser.h>
 
+#include <cstdint>
 #include <string>
 
 #include "source.h"
 
 namespace Supla {
+namespace Linux {
+class CommandExecutor;
+}  // namespace Linux
 
 namespace Source {
 class Cmd : public Source {
  public:
   explicit Cmd(const char *cmd);
   virtual ~Cmd();
+  // When executor is set, requestContent() starts the command in background
+  // and getContent() returns output of the last finished run (empty until
+  // the first one ends or when it failed). Content version is incremented
+  // when run ends, so parser reads fresh output right away.
+  // timeoutMs 0 - executor's default.
+  void setExecutor(Supla::Linux::CommandExecutor *executor,
+                   uint32_t timeoutMs = 0);
   std::string getContent() override;
+  bool requestContent() override;
+  uint32_t getContentVersion() override;
 
  protected:
   std::string cmdLine;
+  std::string lastContent;
+  Supla::Linux::CommandExecutor *executor = nullptr;
+  uint32_t timeoutMs = 0;
+  uint32_t contentVersion = 0;
+  bool requestPending = false;
 };
 };  // namespace Source
 };  // namespace Supla
@@ -0,0 +1,311 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "coprocess.h"
+
+#include <signal.h>
+#include <supla/command_executor.h>
+#include <supla/log_wrapper.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <utility>
+
+using Supla::Source::CoProcess;
+
+CoProcess::CoProcess(const std::string &command, Format format)
+    : command(command), format(format) {
+}
+
+CoProcess::~CoProcess() {
+  stop();
+}
+
+bool CoProcess::setKey(const std::string &key) {
+  nlohmann::json::json_pointer pointer;
+  if (!key.empty() && key[0] == '/') {
+    try {
+      pointer = nlohmann::json::json_pointer(key);
+    } catch (const nlohmann::json::exception &e) {
+      SUPLA_LOG_ERROR("CoProcess: invalid key \"%s\": %s", key.c_str(),
+                      e.what());
+      return false;
+    }
+  }
+  this->key = key;
+  keyPointer = std::move(pointer);
+  return true;
+}
+
+void CoProcess::setMaxRecordSize(size_t size) {
+  if (size > 0) {
+    maxRecordSize = size;
+  }
+}
+
+void CoProcess::setExpirationTime(int timeSec) {
+  expirationSec = timeSec > 0 ? timeSec : 0;
+}
+
+std::string CoProcess::getContent() {
+  poll();
+  if (!isConnected()) {
+    return {};
+  }
+  if (format == Format::Lines || key.empty()) {
+    return lastRecord;
+  }
+  nlohmann::json result = nlohmann::json::object();
+  for (auto &entry : records) {
+    result[entry.first] = entry.second;
+  }
+  return result.dump();
+}
+
+bool CoProcess::isConnected() {
+  if (!receivedRecord) {
+    return false;
+  }
+  if (expirationSec == 0) {
+    return true;
+  }
+  return Clock::now() - lastRecordTime <= std::chrono::seconds(expirationSec);
+}
+
+void CoProcess::iterateAlways() {
+  poll();
+}
+
+void CoProcess::poll() {
+  if (pid < 0) {
+    if (!started || Clock::now() >= restartAt) {
+      start();
+    }
+    return;
+  }
+
+  readOutput();
+  int status = 0;
+  pid_t result = waitpid(pid, &status, WNOHANG);
+  if (result == 0 || (result == -1 && errno == EINTR)) {
+    return;
+  }
+  readOutput();
+  if (result > 0 && WIFEXITED(status)) {
+    SUPLA_LOG_WARNING("CoProcess: \"%s\" exited with code %d",
+                      command.c_str(), WEXITSTATUS(status));
+  } else {
+    SUPLA_LOG_WARNING("CoProcess: \"%s\" terminated", command.c_str());
+  }
+  pid = -1;
+  onProcessExit();
+}
+
+bool CoProcess::isRunning() const {
+  return pid >= 0;
+}
+
+uint32_t CoProcess::getRestartCount() const {
+  return restartCount;
+}
+
+uint32_t CoProcess::getDroppedRecordCount() const {
+  return droppedRecords;
+}
+
+uint32_t CoProcess::getRestartDelayMs() const {
+  return restartDelayMs;
+}
+
+void CoProcess::start() {
+  if (started) {
+    restartCount++;
+  }
+  started = true;
+  if (!Supla::Linux::SpawnProcess(
+          {"/bin/sh", "-c", command}, true, &pid, &outputFd)) {
+    pid = -1;
+    onProcessExit();
+    return;
+  }
+  SUPLA_LOG_INFO("CoProcess: started \"%s\" (pid %d)", command.c_str(), pid);
+}
+
+void CoProcess::stop() {
+  if (pid >= 0) {
+    kill(-pid, SIGKILL);
+    int status = 0;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    pid = -1;
+  }
+  if (outputFd >= 0) {
+    close(outputFd);
+    outputFd = -1;
+  }
+}
+
+void CoProcess::readOutput() {
+  if (outputFd < 0) {
+    return;
+  }
+  char buffer[1024];
+  while (true) {
+    ssize_t size = read(outputFd, buffer, sizeof(buffer));
+    if (size > 0) {
+      consume(buffer, size);
+      continue;
+    }
+    if (size == -1 && errno == EINTR) {
+      continue;
+    }
+    if (size == 0) {
+      // end of output - process exit is handled by waitpid
+      close(outputFd);
+      outputFd = -1;
+    }
+    // EAGAIN - no more data now
+    break;
+  }
+}
+
+void CoProcess::consume(const char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    char c = data[i];
+    if (format == Format::Lines) {
+      if (c == '\n') {
+        if (!skipRecord) {
+          if (!record.empty() && record.back() == '\r') {
+            record.pop_back();
+          }
+          if (!record.empty()) {
+            onRecord();
+          }
+        }
+        record.clear();
+        skipRecord = false;
+      } else if (!skipRecord) {
+        if (record.size() >= maxRecordSize) {
+          dropRecord();
+        } else {
+          record.push_back(c);
+        }
+      }
+      continue;
+    }
+
+    if (depth == 0) {
+      // text between JSON objects is ignored
+      if (c == '{') {
+        depth = 1;
+        inString = false;
+        escaped = false;
+        skipRecord = false;
+        record.assign(1, c);
+      }
+      continue;
+    }
+    if (!skipRecord) {
+      if (record.size() >= maxRecordSize) {
+        dropRecord();
+      } else {
+        record.push_back(c);
+      }
+    }
+    if (inString) {
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        inString = false;
+      }
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      depth--;
+      if (depth == 0) {
+        if (!skipRecord) {
+          onRecord();
+        }
+        record.clear();
+        skipRecord = false;
+      }
+    }
+  }
+}
+
+void CoProcess::onRecord() {
+  if (format == Format::Json) {
+    auto json = nlohmann::json::parse(record, nullptr, false);
+    if (json.is_discarded()) {
+      SUPLA_LOG_DEBUG("CoProcess: invalid JSON record dropped");
+      droppedRecords++;
+      return;
+    }
+    if (!key.empty()) {
+      const nlohmann::json *keyValue = nullptr;
+      if (key[0] == '/') {
+        if (json.contains(keyPointer)) {
+          keyValue = &json.at(keyPointer);
+        }
+      } else if (json.contains(key)) {
+        keyValue = &json.at(key);
+      }
+      if (keyValue == nullptr) {
+        SUPLA_LOG_DEBUG("CoProcess: record without key \"%s\" dropped",
+                        key.c_str());
+        droppedRecords++;
+        return;
+      }
+      std::string keyString = keyValue->is_string()
+                                  ? keyValue->get<std::string>()
+                                  : keyValue->dump();
+      if (records.size() >= MaxKeys && records.count(keyString) == 0) {
+        SUPLA_LOG_WARNING("CoProcess: too many keys, record \"%s\" dropped",
+                          keyString.c_str());
+        droppedRecords++;
+        return;
+      }
+      records[keyString] = std::move(json);
+    }
+  }
+  if (format == Format::Lines || key.empty()) {
+    lastRecord = record;
+  }
+  receivedRecord = true;
+  lastRecordTime = Clock::now();
+  restartDelayMs = MinRestartDelayMs;
+}
+
+void CoProcess::dropRecord() {
+  SUPLA_LOG_WARNING("CoProcess: record exceeds %zu bytes, dropped",
+                    maxRecordSize);
+  droppedRecords++;
+  record.clear();
+  skipRecord = true;
+}
+
+void CoProcess::onProcessExit() {
+  if (outputFd >= 0) {
+    close(outputFd);
+    outputFd = -1;
+  }
+  // partial record of previous instance is not continued
+  record.clear();
+  depth = 0;
+  inString = false;
+  escaped = false;
+  skipRecord = false;
+
+  restartAt = Clock::now() + std::chrono::milliseconds(restartDelayMs);
+  SUPLA_LOG_INFO("CoProcess: restart of \"%s\" in %u ms",
+                 command.c_str(), restartDelayMs);
+  restartDelayMs = restartDelayMs * 2 < MaxRestartDelayMs
+                       ? restartDelayMs * 2
+                       : MaxRestartDelayMs;
+}
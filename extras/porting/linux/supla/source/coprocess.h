@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_SUPLA_SOURCE_COPROCESS_H_
+#define EXTRAS_PORTING_LINUX_SUPLA_SOURCE_COPROCESS_H_
+
+#include <supla/element.h>
+#include <sys/types.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "source.h"
+
+namespace Supla {
+namespace Source {
+
+/**
+ * Source backed by a long-running process (i.e. serial decoder, rtl_433,
+ * "tail -F").
+ *
+ * Process is started once and its stdout is read without blocking from
+ * iterateAlways(). Output is split into records:
+ * - Lines: each non-empty line is a record, getContent() returns the latest
+ *   one,
+ * - Json: each top-level JSON object is a record (objects may span lines).
+ *   Without key, getContent() returns the latest record. With key (field
+ *   name or JSON pointer), the latest record for each key value is kept and
+ *   getContent() returns JSON object {"<key value>": <record>, ...}, so
+ *   parser can address i.e. "/sensor_12/temperature_C".
+ *
+ * Record size and number of kept keys are bounded; oversized records are
+ * dropped. When the process exits, it is restarted with exponential backoff
+ * (reset after the first received record).
+ */
+class CoProcess : public Source, public Supla::Element {
+ public:
+  enum class Format {
+    Lines,
+    Json,
+  };
+
+  static constexpr size_t DefaultMaxRecordSize = 64 * 1024;
+  static constexpr size_t MaxKeys = 64;
+  static constexpr uint32_t MinRestartDelayMs = 1000;
+  static constexpr uint32_t MaxRestartDelayMs = 60000;
+
+  explicit CoProcess(const std::string &command, Format format = Format::Lines);
+  ~CoProcess() override;
+
+  // Returns false (and keeps previous key) when JSON pointer is malformed
+  bool setKey(const std::string &key);
+  void setMaxRecordSize(size_t size);
+  // 0 - records never expire
+  void setExpirationTime(int timeSec);
+
+  std::string getContent() override;
+  // false when process doesn't provide records (or they are too old)
+  bool isConnected() override;
+
+  void iterateAlways() override;
+  // Reads available output and restarts process if needed. Never blocks.
+  void poll();
+
+  bool isRunning() const;
+  uint32_t getRestartCount() const;
+  uint32_t getDroppedRecordCount() const;
+  uint32_t getRestartDelayMs() const;
+
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  void start();
+  void stop();
+  void readOutput();
+  void consume(const char *data, size_t size);
+  void onRecord();
+  void dropRecord();
+  void onProcessExit();
+
+  std::string command;
+  Format format = Format::Lines;
+  std::string key;
+  nlohmann::json::json_pointer keyPointer;
+  size_t maxRecordSize = DefaultMaxRecordSize;
+  int expirationSec = 0;
+
+  pid_t pid = -1;
+  int outputFd = -1;
+  Clock::time_point restartAt;
+  uint32_t restartDelayMs = MinRestartDelayMs;
+  uint32_t restartCount = 0;
+  bool started = false;
+
+  // record framing
+  std::string record;
+  int depth = 0;
+  bool inString = false;
+  bool escaped = false;
+  bool skipRecord = false;
+  uint32_t droppedRecords = 0;
+
+  std::string lastRecord;
+  std::map<std::string, nlohmann::json> records;
+  bool receivedRecord = false;
+  Clock::time_point lastRecordTime;
+};
+
+}  // namespace Source
+}  // namespace Supla
+
+#endif  // EXTRAS_PORTING_LINUX_SUPLA_SOURCE_COPROCESS_H_
@@ -0,0 +1,882 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "modbus.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <supla/crc16.h>
+#include <supla/log_wrapper.h>
+#include <supla/time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint16_t MAX_REGISTERS_PER_REQUEST = 125;
+constexpr uint16_t MAX_BITS_PER_REQUEST = 2000;
+constexpr uint32_t RECONNECT_INTERVAL_MS = 5000;
+constexpr uint32_t MIN_REFRESH_INTERVAL_MS = 10;
+// unit id + function code + byte count + 250 bytes of data + crc
+constexpr size_t MAX_RTU_FRAME_SIZE = 256;
+
+uint64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool isBitTable(Supla::Source::ModbusTable table) {
+  return table == Supla::Source::ModbusTable::COIL ||
+         table == Supla::Source::ModbusTable::DISCRETE_INPUT;
+}
+
+bool parseNumber(const std::string &text, int max, int *result) {
+  if (text.empty() || text.size() > 5) {
+    return false;
+  }
+  int value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    value = value * 10 + (c - '0');
+  }
+  if (value > max) {
+    return false;
+  }
+  *result = value;
+  return true;
+}
+
+speed_t toSpeed(int baudRate) {
+  switch (baudRate) {
+    case 1200:
+      return B1200;
+    case 2400:
+      return B2400;
+    case 4800:
+      return B4800;
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace
+
+using Supla::Source::ModbusDataType;
+using Supla::Source::ModbusTable;
+
+Supla::Source::Modbus::Modbus(const ModbusConfig &config) : config(config) {
+  if (this->config.maxPipelined < 1) {
+    this->config.maxPipelined = 1;
+  }
+}
+
+Supla::Source::Modbus::~Modbus() {
+  disconnect();
+}
+
+bool Supla::Source::Modbus::ParseKey(const std::string &key,
+                                     uint8_t *unitId,
+                                     ModbusTable *table,
+                                     uint16_t *address,
+                                     ModbusDataType *type,
+                                     bool *swapped) {
+  std::vector<std::string> parts;
+  std::stringstream stream(key);
+  std::string part;
+  while (std::getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+  if (parts.size() < 3 || parts.size() > 4) {
+    return false;
+  }
+
+  int number = 0;
+  if (!parseNumber(parts[0], 255, &number)) {
+    return false;
+  }
+  *unitId = number;
+
+  if (parts[1] == "holding") {
+    *table = ModbusTable::HOLDING_REGISTER;
+  } else if (parts[1] == "input") {
+    *table = ModbusTable::INPUT_REGISTER;
+  } else if (parts[1] == "coil") {
+    *table = ModbusTable::COIL;
+  } else if (parts[1] == "discrete") {
+    *table = ModbusTable::DISCRETE_INPUT;
+  } else {
+    return false;
+  }
+
+  if (!parseNumber(parts[2], 65535, &number)) {
+    return false;
+  }
+  *address = number;
+
+  *swapped = false;
+  if (isBitTable(*table)) {
+    *type = ModbusDataType::BOOL;
+    return parts.size() == 3 || parts[3] == "bool";
+  }
+
+  *type = ModbusDataType::UINT16;
+  if (parts.size() == 3) {
+    return true;
+  }
+
+  std::string typeName = parts[3];
+  const std::string swappedSuffix = "_swapped";
+  if (typeName.size() > swappedSuffix.size() &&
+      typeName.compare(typeName.size() - swappedSuffix.size(),
+                       swappedSuffix.size(),
+                       swappedSuffix) == 0) {
+    typeName.resize(typeName.size() - swappedSuffix.size());
+    *swapped = true;
+  }
+
+  static const std::map<std::string, ModbusDataType> types = {
+      {"uint16", ModbusDataType::UINT16},
+      {"int16", ModbusDataType::INT16},
+      {"uint32", ModbusDataType::UINT32},
+      {"int32", ModbusDataType::INT32},
+      {"float32", ModbusDataType::FLOAT32},
+      {"uint64", ModbusDataType::UINT64},
+      {"int64", ModbusDataType::INT64},
+      {"float64", ModbusDataType::FLOAT64}};
+  auto it = types.find(typeName);
+  if (it == types.end()) {
+    return false;
+  }
+  *type = it->second;
+  if (*swapped && RegisterCount(*type) == 1) {
+    return false;
+  }
+  return static_cast<uint32_t>(*address) + RegisterCount(*type) <= 65536;
+}
+
+uint16_t Supla::Source::Modbus::RegisterCount(ModbusDataType type) {
+  switch (type) {
+    case ModbusDataType::UINT32:
+    case ModbusDataType::INT32:
+    case ModbusDataType::FLOAT32:
+      return 2;
+    case ModbusDataType::UINT64:
+    case ModbusDataType::INT64:
+    case ModbusDataType::FLOAT64:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+int Supla::Source::Modbus::addKey(const std::string &key) {
+  int id = findKey(key);
+  if (id >= 0) {
+    return id;
+  }
+
+  Value value;
+  if (!ParseKey(key,
+                &value.unitId,
+                &value.table,
+                &value.address,
+                &value.type,
+                &value.swapped)) {
+    SUPLA_LOG_ERROR("Modbus: invalid key \"%s\"", key.c_str());
+    return -1;
+  }
+  value.key = key;
+  values.push_back(value);
+  planValid = false;
+  return values.size() - 1;
+}
+
+int Supla::Source::Modbus::findKey(const std::string &key) const {
+  for (size_t i = 0; i < values.size(); i++) {
+    if (values[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Supla::Source::Modbus::plan() {
+  blocks.clear();
+  std::vector<int> order(values.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](int a, int b) {
+    const auto &va = values[a];
+    const auto &vb = values[b];
+    if (va.unitId != vb.unitId) {
+      return va.unitId < vb.unitId;
+    }
+    if (va.table != vb.table) {
+      return va.table < vb.table;
+    }
+    return va.address < vb.address;
+  });
+
+  for (int id : order) {
+    auto &value = values[id];
+    uint32_t end = value.address + RegisterCount(value.type);
+    if (!blocks.empty()) {
+      auto &block = blocks.back();
+      uint32_t blockEnd = block.address + block.count;
+      uint32_t newEnd = std::max(end, blockEnd);
+      uint16_t maxCount = isBitTable(block.table) ? MAX_BITS_PER_REQUEST
+                                                  : MAX_REGISTERS_PER_REQUEST;
+      if (block.unitId == value.unitId && block.table == value.table &&
+          value.address <= blockEnd + config.maxGap &&
+          newEnd - block.address <= maxCount) {
+        block.count = newEnd - block.address;
+        value.block = blocks.size() - 1;
+        value.offset = value.address - block.address;
+        continue;
+      }
+    }
+    Block block;
+    block.unitId = value.unitId;
+    block.table = value.table;
+    block.address = value.address;
+    block.count = end - value.address;
+    blocks.push_back(block);
+    value.block = blocks.size() - 1;
+    value.offset = 0;
+  }
+
+  for (auto &block : blocks) {
+    block.data.assign(block.count, 0);
+  }
+  planValid = true;
+  SUPLA_LOG_DEBUG("Modbus: %d values are read with %d requests",
+                  static_cast<int>(values.size()),
+                  static_cast<int>(blocks.size()));
+}
+
+size_t Supla::Source::Modbus::getPlannedRequestCount() {
+  if (!planValid) {
+    plan();
+  }
+  return blocks.size();
+}
+
+uint32_t Supla::Source::Modbus::getRequestCount() const {
+  return requestCount;
+}
+
+bool Supla::Source::Modbus::refresh() {
+  uint32_t now = millis();
+  if (refreshed && now - lastRefreshMs < MIN_REFRESH_INTERVAL_MS) {
+    return lastResult;
+  }
+  refreshed = true;
+  lastRefreshMs = now;
+
+  if (!planValid) {
+    plan();
+  }
+  for (auto &block : blocks) {
+    block.valid = false;
+  }
+
+  uint64_t deadline = nowMs() + config.timeoutMs;
+  lastResult = false;
+  if (blocks.empty()) {
+    lastResult = true;
+  } else if (connect(deadline)) {
+    lastResult = config.protocol == ModbusProtocol::TCP ? pollTcp(deadline)
+                                                        : pollRtu(deadline);
+  }
+  return lastResult;
+}
+
+bool Supla::Source::Modbus::isConnected() {
+  // connection is handled by refresh(), so source is reported as connected
+  // also when connection is in progress or when reconnect attempt is due
+  if (connectState != ConnectState::DISCONNECTED || !connectAttempted) {
+    return true;
+  }
+  return millis() - lastConnectAttemptMs >= RECONNECT_INTERVAL_MS;
+}
+
+bool Supla::Source::Modbus::connect(uint64_t deadlineMs) {
+  if (connectState == ConnectState::CONNECTED) {
+    return true;
+  }
+  if (connectState == ConnectState::DISCONNECTED) {
+    uint32_t now = millis();
+    if (connectAttempted &&
+        now - lastConnectAttemptMs < RECONNECT_INTERVAL_MS) {
+      return false;
+    }
+    connectAttempted = true;
+    lastConnectAttemptMs = now;
+    if (config.protocol == ModbusProtocol::RTU) {
+      if (!connectRtu()) {
+        return false;
+      }
+      connectState = ConnectState::CONNECTED;
+      connectionErrorLogged = false;
+      return true;
+    }
+    nextAddress = 0;
+    if (!addresses.empty()) {
+      connectState = ConnectState::CONNECTING;
+    } else {
+      // numeric addresses are resolved without blocking, otherwise
+      // getaddrinfo is called from background thread
+      auto result = Resolve(config.host, config.port, true);
+      if (result.error == 0) {
+        addresses = std::move(result.addresses);
+        connectState = ConnectState::CONNECTING;
+      } else {
+        pendingResolve = std::async(
+            std::launch::async, Resolve, config.host, config.port, false);
+        connectState = ConnectState::RESOLVING;
+      }
+    }
+  }
+  return connectTcp(deadlineMs);
+}
+
+Supla::Source::Modbus::ResolveResult Supla::Source::Modbus::Resolve(
+    const std::string &host, uint16_t port, bool numericOnly) {
+  ResolveResult result;
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (numericOnly) {
+    hints.ai_flags = AI_NUMERICHOST;
+  }
+  addrinfo *info = nullptr;
+  result.error = getaddrinfo(
+      host.c_str(), std::to_string(port).c_str(), &hints, &info);
+  if (result.error != 0) {
+    return result;
+  }
+  for (addrinfo *ai = info; ai != nullptr; ai = ai->ai_next) {
+    if (ai->ai_addrlen > sizeof(sockaddr_storage)) {
+      continue;
+    }
+    ResolvedAddress address;
+    memcpy(&address.address, ai->ai_addr, ai->ai_addrlen);
+    address.length = ai->ai_addrlen;
+    result.addresses.push_back(address);
+  }
+  freeaddrinfo(info);
+  return result;
+}
+
+bool Supla::Source::Modbus::connectTcp(uint64_t deadlineMs) {
+  if (connectState == ConnectState::RESOLVING) {
+    uint64_t now = nowMs();
+    auto waitMs = std::chrono::milliseconds(
+        deadlineMs > now ? deadlineMs - now : 0);
+    if (pendingResolve.wait_for(waitMs) != std::future_status::ready) {
+      return false;
+    }
+    auto result = pendingResolve.get();
+    if (result.error != 0 || result.addresses.empty()) {
+      if (!connectionErrorLogged) {
+        SUPLA_LOG_WARNING("Modbus: failed to resolve %s: %s",
+                          config.host.c_str(),
+                          gai_strerror(result.error));
+        connectionErrorLogged = true;
+      }
+      connectState = ConnectState::DISCONNECTED;
+      return false;
+    }
+    addresses = std::move(result.addresses);
+    nextAddress = 0;
+    connectState = ConnectState::CONNECTING;
+  }
+
+  while (true) {
+    if (fd < 0) {
+      if (nextAddress >= addresses.size()) {
+        onConnectFailed();
+        return false;
+      }
+      const auto &address = addresses[nextAddress++];
+      fd = socket(address.address.ss_family,
+                  SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  0);
+      if (fd < 0) {
+        continue;
+      }
+      if (::connect(fd,
+                    reinterpret_cast<const sockaddr *>(&address.address),
+                    address.length) == 0) {
+        onTcpConnected();
+        return true;
+      }
+      if (errno != EINPROGRESS) {
+        close(fd);
+        fd = -1;
+        continue;
+      }
+      addressDeadlineMs = nowMs() + config.timeoutMs;
+    }
+
+    // connection which is not established within poll cycle is continued
+    // in the next one
+    uint64_t now = nowMs();
+    uint64_t waitUntil = std::min(deadlineMs, addressDeadlineMs);
+    int waitMs = waitUntil > now ? static_cast<int>(waitUntil - now) : 0;
+    pollfd pfd = {fd, POLLOUT, 0};
+    int ready = poll(&pfd, 1, waitMs);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready == 1) {
+      int soError = 0;
+      socklen_t soErrorLen = sizeof(soError);
+      if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &soError, &soErrorLen) == 0 &&
+          soError == 0) {
+        onTcpConnected();
+        return true;
+      }
+    } else if (nowMs() < addressDeadlineMs) {
+      return false;
+    }
+    // try next address
+    close(fd);
+    fd = -1;
+  }
+}
+
+void Supla::Source::Modbus::onTcpConnected() {
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  connectState = ConnectState::CONNECTED;
+  connectionErrorLogged = false;
+  SUPLA_LOG_INFO(
+      "Modbus: connected to %s:%d", config.host.c_str(), config.port);
+}
+
+void Supla::Source::Modbus::onConnectFailed() {
+  if (!connectionErrorLogged) {
+    SUPLA_LOG_WARNING("Modbus: failed to connect to %s:%d",
+                      config.host.c_str(),
+                      config.port);
+    connectionErrorLogged = true;
+  }
+  // host name is resolved again on next attempt
+  addresses.clear();
+  connectState = ConnectState::DISCONNECTED;
+}
+
+bool Supla::Source::Modbus::connectRtu() {
+  speed_t speed = toSpeed(config.baudRate);
+  if (speed == 0) {
+    if (!connectionErrorLogged) {
+      SUPLA_LOG_ERROR("Modbus: unsupported baud rate %d", config.baudRate);
+      connectionErrorLogged = true;
+    }
+    return false;
+  }
+
+  int dev = open(config.device.c_str(),
+                 O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (dev < 0) {
+    if (!connectionErrorLogged) {
+      SUPLA_LOG_WARNING("Modbus: failed to open %s: %s",
+                        config.device.c_str(),
+                        strerror(errno));
+      connectionErrorLogged = true;
+    }
+    return false;
+  }
+
+  termios tty = {};
+  if (tcgetattr(dev, &tty) != 0) {
+    SUPLA_LOG_ERROR("Modbus: %s is not a serial device",
+                    config.device.c_str());
+    close(dev);
+    return false;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, speed);
+  cfsetospeed(&tty, speed);
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cflag &= ~(PARENB | PARODD | CSTOPB);
+  if (config.parity == 'E') {
+    tty.c_cflag |= PARENB;
+  } else if (config.parity == 'O') {
+    tty.c_cflag |= PARENB | PARODD;
+  }
+  if (config.stopBits == 2) {
+    tty.c_cflag |= CSTOPB;
+  }
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 0;
+  if (tcsetattr(dev, TCSANOW, &tty) != 0) {
+    SUPLA_LOG_ERROR("Modbus: failed to configure %s", config.device.c_str());
+    close(dev);
+    return false;
+  }
+  tcflush(dev, TCIOFLUSH);
+  fd = dev;
+  SUPLA_LOG_INFO("Modbus: opened %s", config.device.c_str());
+  return true;
+}
+
+void Supla::Source::Modbus::disconnect() {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  connectState = ConnectState::DISCONNECTED;
+}
+
+size_t Supla::Source::Modbus::buildPdu(const Block &block,
+                                       uint8_t *pdu) const {
+  // table values are equal to the read function codes
+  pdu[0] = static_cast<uint8_t>(block.table);
+  pdu[1] = block.address >> 8;
+  pdu[2] = block.address & 0xFF;
+  pdu[3] = block.count >> 8;
+  pdu[4] = block.count & 0xFF;
+  return 5;
+}
+
+bool Supla::Source::Modbus::decodePdu(Block *block,
+                                      const uint8_t *pdu,
+                                      size_t size) {
+  uint8_t functionCode = static_cast<uint8_t>(block->table);
+  if (size >= 2 && pdu[0] == (functionCode | 0x80)) {
+    SUPLA_LOG_WARNING(
+        "Modbus: unit %d: exception %d for function %d, address %d (%d)",
+        block->unitId,
+        pdu[1],
+        functionCode,
+        block->address,
+        block->count);
+    return false;
+  }
+
+  size_t byteCount = isBitTable(block->table) ? (block->count + 7) / 8
+                                              : block->count * 2;
+  if (size != byteCount + 2 || pdu[0] != functionCode ||
+      pdu[1] != byteCount) {
+    SUPLA_LOG_WARNING("Modbus: unit %d: invalid response for function %d",
+                      block->unitId,
+                      functionCode);
+    return false;
+  }
+
+  const uint8_t *data = pdu + 2;
+  for (uint16_t i = 0; i < block->count; i++) {
+    if (isBitTable(block->table)) {
+      block->data[i] = (data[i / 8] >> (i % 8)) & 1;
+    } else {
+      block->data[i] = (data[2 * i] << 8) | data[2 * i + 1];
+    }
+  }
+  block->valid = true;
+  return true;
+}
+
+bool Supla::Source::Modbus::pollTcp(uint64_t deadlineMs) {
+  // Interleave requests between unit ids, so pipelined requests are spread
+  // between devices behind the gateway
+  std::vector<int> queue;
+  queue.reserve(blocks.size());
+  std::vector<size_t> unitStart;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    if (i == 0 || blocks[i].unitId != blocks[i - 1].unitId) {
+      unitStart.push_back(i);
+    }
+  }
+  for (size_t round = 0; queue.size() < blocks.size(); round++) {
+    for (size_t u = 0; u < unitStart.size(); u++) {
+      size_t end = u + 1 < unitStart.size() ? unitStart[u + 1] : blocks.size();
+      if (unitStart[u] + round < end) {
+        queue.push_back(unitStart[u] + round);
+      }
+    }
+  }
+
+  std::vector<uint8_t> rx;
+  size_t nextToSend = 0;
+  size_t pending = queue.size();
+  int inFlight = 0;
+
+  while (pending > 0) {
+    while (nextToSend < queue.size() && inFlight < config.maxPipelined) {
+      auto &block = blocks[queue[nextToSend]];
+      if (nextTransactionId == 0) {
+        nextTransactionId = 1;
+      }
+      block.transactionId = nextTransactionId++;
+      uint8_t adu[12] = {static_cast<uint8_t>(block.transactionId >> 8),
+                         static_cast<uint8_t>(block.transactionId & 0xFF),
+                         0,
+                         0,
+                         0,
+                         6,
+                         block.unitId};
+      buildPdu(block, adu + 7);
+      ssize_t sent = send(fd, adu, sizeof(adu), MSG_NOSIGNAL);
+      if (sent != static_cast<ssize_t>(sizeof(adu))) {
+        // request frames are small, so partial write means that socket
+        // buffer is full and connection is broken
+        SUPLA_LOG_WARNING("Modbus: send failed, closing connection");
+        disconnect();
+        return false;
+      }
+      requestCount++;
+      inFlight++;
+      nextToSend++;
+    }
+
+    uint64_t now = nowMs();
+    int waitMs = deadlineMs > now ? static_cast<int>(deadlineMs - now) : 0;
+    pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, waitMs);
+    if (ready <= 0) {
+      if (ready < 0 && errno == EINTR) {
+        continue;
+      }
+      SUPLA_LOG_WARNING(
+          "Modbus: timeout, %d requests without response",
+          static_cast<int>(pending));
+      // late responses would be mismatched with next requests
+      disconnect();
+      return false;
+    }
+
+    uint8_t buffer[4096];
+    ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      if (received < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      SUPLA_LOG_WARNING("Modbus: connection closed");
+      disconnect();
+      return false;
+    }
+    rx.insert(rx.end(), buffer, buffer + received);
+
+    size_t consumed = 0;
+    while (rx.size() - consumed >= 7) {
+      const uint8_t *adu = rx.data() + consumed;
+      uint16_t length = (adu[4] << 8) | adu[5];
+      if (length < 3 || length > 254 || adu[2] != 0 || adu[3] != 0) {
+        SUPLA_LOG_WARNING("Modbus: invalid MBAP header, closing connection");
+        disconnect();
+        return false;
+      }
+      if (rx.size() - consumed < 6u + length) {
+        break;
+      }
+      uint16_t transactionId = (adu[0] << 8) | adu[1];
+      for (size_t i = 0; i < nextToSend; i++) {
+        auto &block = blocks[queue[i]];
+        if (block.transactionId == transactionId && transactionId != 0) {
+          block.transactionId = 0;
+          if (adu[6] == block.unitId) {
+            decodePdu(&block, adu + 7, length - 1);
+          }
+          inFlight--;
+          pending--;
+          break;
+        }
+      }
+      consumed += 6 + length;
+    }
+    rx.erase(rx.begin(), rx.begin() + consumed);
+  }
+  return true;
+}
+
+bool Supla::Source::Modbus::readExact(uint8_t *buffer,
+                                      size_t size,
+                                      uint64_t deadlineMs) {
+  size_t received = 0;
+  while (received < size) {
+    uint64_t now = nowMs();
+    if (now >= deadlineMs) {
+      return false;
+    }
+    pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, static_cast<int>(deadlineMs - now));
+    if (ready < 0 && errno != EINTR) {
+      return false;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    ssize_t result = read(fd, buffer + received, size - received);
+    if (result < 0 && errno != EAGAIN && errno != EINTR) {
+      return false;
+    }
+    if (result > 0) {
+      received += result;
+    }
+  }
+  return true;
+}
+
+bool Supla::Source::Modbus::pollRtu(uint64_t deadlineMs) {
+  // 3.5 characters of silence between frames, 1.75 ms above 19200 bps
+  uint64_t charTimeUs = 11 * 1000000 / config.baudRate;
+  uint64_t frameDelayUs =
+      config.baudRate > 19200 ? 1750 : charTimeUs * 7 / 2;
+
+  size_t count = blocks.size();
+  for (size_t n = 0; n < count; n++) {
+    size_t index = (nextRtuBlock + n) % count;
+    if (nowMs() >= deadlineMs) {
+      // skipped requests are sent first in the next cycle, so slow or
+      // missing units don't block the same values forever
+      SUPLA_LOG_WARNING("Modbus: poll cycle timeout, %d requests skipped",
+                        static_cast<int>(count - n));
+      nextRtuBlock = index;
+      return true;
+    }
+    auto &block = blocks[index];
+    uint8_t frame[MAX_RTU_FRAME_SIZE] = {block.unitId};
+    size_t size = 1 + buildPdu(block, frame + 1);
+    uint16_t crc = calculateCrc16(frame, size);
+    frame[size++] = crc & 0xFF;
+    frame[size++] = crc >> 8;
+
+    // only remaining part of the silence interval is awaited
+    uint64_t now = nowUs();
+    if (now < lastRtuFrameUs + frameDelayUs) {
+      usleep(lastRtuFrameUs + frameDelayUs - now);
+    }
+    tcflush(fd, TCIFLUSH);
+    if (write(fd, frame, size) != static_cast<ssize_t>(size)) {
+      SUPLA_LOG_WARNING("Modbus: write to %s failed", config.device.c_str());
+      disconnect();
+      return false;
+    }
+    requestCount++;
+
+    // unit id, function code, byte count or exception code
+    bool ok = readExact(frame, 3, deadlineMs);
+    size_t responseSize = 0;
+    if (ok) {
+      responseSize = (frame[1] & 0x80) ? 5 : 5 + frame[2];
+      ok = responseSize <= MAX_RTU_FRAME_SIZE &&
+           readExact(frame + 3, responseSize - 3, deadlineMs);
+    }
+    lastRtuFrameUs = nowUs();
+    if (!ok) {
+      // other units on the bus may still respond, so connection is kept
+      SUPLA_LOG_WARNING("Modbus: unit %d: no response", block.unitId);
+    } else if (calculateCrc16(frame, responseSize - 2) !=
+                   (frame[responseSize - 2] |
+                    (frame[responseSize - 1] << 8)) ||
+               frame[0] != block.unitId) {
+      SUPLA_LOG_WARNING("Modbus: unit %d: invalid response frame",
+                        block.unitId);
+    } else {
+      decodePdu(&block, frame + 1, responseSize - 3);
+    }
+  }
+  nextRtuBlock = 0;
+  return true;
+}
+
+bool Supla::Source::Modbus::getValue(int id, double *result) const {
+  if (id < 0 || id >= static_cast<int>(values.size()) || !planValid) {
+    return false;
+  }
+  const auto &value = values[id];
+  const auto &block = blocks[value.block];
+  if (!block.valid) {
+    return false;
+  }
+
+  int count = RegisterCount(value.type);
+  uint64_t raw = 0;
+  for (int i = 0; i < count; i++) {
+    int reg = value.swapped ? count - 1 - i : i;
+    raw = (raw << 16) | block.data[value.offset + reg];
+  }
+
+  switch (value.type) {
+    case ModbusDataType::BOOL:
+    case ModbusDataType::UINT16:
+    case ModbusDataType::UINT32:
+      *result = static_cast<double>(raw);
+      break;
+    case ModbusDataType::INT16:
+      *result = static_cast<int16_t>(raw);
+      break;
+    case ModbusDataType::INT32:
+      *result = static_cast<int32_t>(raw);
+      break;
+    case ModbusDataType::UINT64:
+      *result = static_cast<double>(raw);
+      break;
+    case ModbusDataType::INT64:
+      *result = static_cast<double>(static_cast<int64_t>(raw));
+      break;
+    case ModbusDataType::FLOAT32: {
+      uint32_t bits = raw;
+      float f = 0;
+      memcpy(&f, &bits, sizeof(f));
+      *result = f;
+      break;
+    }
+    case ModbusDataType::FLOAT64: {
+      double d = 0;
+      memcpy(&d, &raw, sizeof(d));
+      *result = d;
+      break;
+    }
+  }
+  return true;
+}
+
+std::string Supla::Source::Modbus::getContent() {
+  refresh();
+  nlohmann::json json = nlohmann::json::object();
+  for (size_t i = 0; i < values.size(); i++) {
+    double value = 0;
+    if (getValue(i, &value)) {
+      json[values[i].key] = value;
+    }
+  }
+  return json.dump();
+}
@@ -0,0 +1,211 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_PORTING_LINUX_SUPLA_SOURCE_MODBUS_H_
+#define EXTRAS_PORTING_LINUX_SUPLA_SOURCE_MODBUS_H_
+
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>  // NOLINT(build/c++11)
+#include <string>
+#include <vector>
+
+#include "source.h"
+
+namespace Supla::Source {
+
+enum class ModbusProtocol : uint8_t { TCP, RTU };
+
+enum class ModbusTable : uint8_t {
+  COIL = 1,
+  DISCRETE_INPUT = 2,
+  HOLDING_REGISTER = 3,
+  INPUT_REGISTER = 4
+};
+
+enum class ModbusDataType : uint8_t {
+  BOOL,
+  UINT16,
+  INT16,
+  UINT32,
+  INT32,
+  FLOAT32,
+  UINT64,
+  INT64,
+  FLOAT64
+};
+
+struct ModbusConfig {
+  ModbusProtocol protocol = ModbusProtocol::TCP;
+  // TCP
+  std::string host;
+  uint16_t port = 502;
+  // RTU
+  std::string device;
+  int baudRate = 9600;
+  char parity = 'N';  // N, E, O
+  int stopBits = 1;
+
+  // max duration of a single poll cycle, including connection setup
+  unsigned int timeoutMs = 1000;
+  // max number of unused registers read in order to join two reads into
+  // a single request
+  uint16_t maxGap = 8;
+  // max number of requests sent without waiting for response (TCP only)
+  int maxPipelined = 8;
+};
+
+/**
+ * Modbus master (client) source.
+ *
+ * Values are registered with addKey() using "unit:table:address[:type]"
+ * format, i.e. "1:holding:100:float32" or "3:coil:5". Table is one of
+ * "holding", "input", "coil", "discrete". Type defaults to "uint16" for
+ * registers and "bool" for coils and discrete inputs. Supported register
+ * types: uint16, int16, uint32, int32, float32, uint64, int64, float64.
+ * Multi register types are big endian with the most significant word first;
+ * "_swapped" suffix (i.e. "float32_swapped") selects least significant word
+ * first order.
+ *
+ * All registered values are read in a single poll cycle. Reads from the same
+ * unit and table are merged into as few requests as possible (gaps up to
+ * maxGap registers are read and ignored). With Modbus TCP up to maxPipelined
+ * requests are sent before waiting for responses, interleaved between unit
+ * ids, so gateways with several slaves on the bus are queried in parallel.
+ * Modbus RTU requests are sent one by one.
+ *
+ * Poll cycle (refresh()) never takes longer than timeoutMs. Host name is
+ * resolved in background and TCP connection is established without
+ * blocking, so both may continue in the next poll cycles. When RTU cycle
+ * runs out of time, remaining requests are sent first in the next cycle.
+ */
+class Modbus : public Source {
+ public:
+  explicit Modbus(const ModbusConfig &config);
+  ~Modbus();
+
+  /**
+   * Registers value to read.
+   *
+   * @return value id used by getValue(), -1 on invalid key
+   */
+  int addKey(const std::string &key);
+  int findKey(const std::string &key) const;
+
+  /**
+   * Executes poll cycle. Calls made within 10 ms from the previous cycle
+   * are ignored, so the same source can be shared by multiple parsers.
+   *
+   * @return false on connection error. Values which were not read (i.e.
+   *         exception response) are reported by getValue()
+   */
+  bool refresh();
+
+  /**
+   * @return false if value wasn't read in the last poll cycle
+   */
+  bool getValue(int id, double *value) const;
+
+  // Returns JSON object with all registered keys and their values
+  std::string getContent() override;
+  // Returns false after failed connection attempt, until next attempt is due
+  // (every 5 s). Connection is established by refresh()
+  bool isConnected() override;
+
+  uint32_t getRequestCount() const;
+  size_t getPlannedRequestCount();
+
+  static bool ParseKey(const std::string &key,
+                       uint8_t *unitId,
+                       ModbusTable *table,
+                       uint16_t *address,
+                       ModbusDataType *type,
+                       bool *swapped);
+
+ protected:
+  struct Value {
+    std::string key;
+    uint8_t unitId = 0;
+    ModbusTable table = ModbusTable::HOLDING_REGISTER;
+    uint16_t address = 0;
+    ModbusDataType type = ModbusDataType::UINT16;
+    bool swapped = false;
+    int block = -1;
+    uint16_t offset = 0;
+  };
+
+  struct Block {
+    uint8_t unitId = 0;
+    ModbusTable table = ModbusTable::HOLDING_REGISTER;
+    uint16_t address = 0;
+    uint16_t count = 0;
+    // one entry per register, or per bit for coils and discrete inputs
+    std::vector<uint16_t> data;
+    bool valid = false;
+    uint16_t transactionId = 0;
+  };
+
+  struct ResolvedAddress {
+    sockaddr_storage address = {};
+    socklen_t length = 0;
+  };
+
+  struct ResolveResult {
+    int error = 0;
+    std::vector<ResolvedAddress> addresses;
+  };
+
+  enum class ConnectState : uint8_t {
+    DISCONNECTED,
+    RESOLVING,
+    CONNECTING,
+    CONNECTED
+  };
+
+  static uint16_t RegisterCount(ModbusDataType type);
+  static ResolveResult Resolve(const std::string &host,
+                               uint16_t port,
+                               bool numericOnly);
+
+  void plan();
+  // Progresses connection setup until deadline, returns true when connected
+  bool connect(uint64_t deadlineMs);
+  bool connectTcp(uint64_t deadlineMs);
+  bool connectRtu();
+  void onTcpConnected();
+  void onConnectFailed();
+  void disconnect();
+  bool pollTcp(uint64_t deadlineMs);
+  bool pollRtu(uint64_t deadlineMs);
+  size_t buildPdu(const Block &block, uint8_t *pdu) const;
+  bool decodePdu(Block *block, const uint8_t *pdu, size_t size);
+  bool readExact(uint8_t *buffer, size_t size, uint64_t deadlineMs);
+
+  ModbusConfig config;
+  std::vector<Value> values;
+  std::vector<Block> blocks;
+  bool planValid = false;
+  int fd = -1;
+  ConnectState connectState = ConnectState::DISCONNECTED;
+  std::future<ResolveResult> pendingResolve;
+  std::vector<ResolvedAddress> addresses;
+  size_t nextAddress = 0;
+  uint64_t addressDeadlineMs = 0;
+  // RTU: index of block which is sent first in the next poll cycle
+  size_t nextRtuBlock = 0;
+  uint64_t lastRtuFrameUs = 0;
+  uint16_t nextTransactionId = 1;
+  uint32_t requestCount = 0;
+  uint32_t lastRefreshMs = 0;
+  uint32_t lastConnectAttemptMs = 0;
+  bool refreshed = false;
+  bool lastResult = false;
+  bool connectAttempted = false;
+  bool connectionErrorLogged = false;
+};
+
+}  // namespace Supla::Source
+
+#endif  // EXTRAS_PORTING_LINUX_SUPLA_SOURCE_MODBUS_H_
@@ -4,6 +4,7 @@
 #ifndef EXTRAS_PORTING_LINUX_SUPLA_SOURCE_SOURCE_H_
 #define EXTRAS_PORTING_LINUX_SUPLA_SOURCE_SOURCE_H_
 
+#include <cstdint>
 #include <string>
 
 namespace Supla {
@@ -14,6 +15,12 @@ class Source {
   virtual ~Source() {}
   virtual std::string getContent() = 0;
   virtual bool isConnected() { return true; }
+  // Sources which prepare content in background (i.e. asynchronous command)
+  // start preparing it and return true. getContentVersion() changes when new
+  // content is ready to be read with getContent(). Other sources return
+  // false and prepare content in getContent().
+  virtual bool requestContent() { return false; }
+  virtual uint32_t getContentVersion() { return 0; }
 };
 };  // namespace Source
 };  // namespace Supla
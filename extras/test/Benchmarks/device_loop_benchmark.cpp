@@ -0,0 +1,503 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Main loop benchmark.
+//
+// Builds SuplaDeviceClass with N synthetic elements (relays, thermometers,
+// electricity meters, HVACs and buttons with actions), registers it against
+// test doubles and drives iterate(), onTimer() and onFastTimer() like the
+// device does. Reports average and worst time of one loop pass and number of
+// heap allocations per pass.
+//
+// Usage: supladevicebenchmark [--passes P] [N...]
+// Default: 2000 passes for N = 10 50 100 250 500 1000.
+//
+// Channel count is limited by SUPLA_CHANNELMAXCOUNT, so for large N the
+// population above that limit consists of buttons (elements without channel).
+// Doubles used here are plain stubs instead of gmock mocks, so mock dispatch
+// doesn't dominate measured time.
+
+#include <SuplaDevice.h>
+#include <arduino_mock.h>
+#include <board_mock.h>
+#include <network_client_mock.h>
+#include <network_mock.h>
+#include <simple_time.h>
+#include <srpc_mock.h>
+#include <supla/actions.h>
+#include <supla/channels/channel.h>
+#include <supla/clock/clock.h>
+#include <supla/control/button.h>
+#include <supla/control/hvac_base.h>
+#include <supla/control/output_interface.h>
+#include <supla/control/virtual_relay.h>
+#include <supla/device/register_device.h>
+#include <supla/events.h>
+#include <supla/protocol/supla_srpc.h>
+#include <supla/sensor/electricity_meter.h>
+#include <supla/sensor/virtual_thermometer.h>
+#include <timer_mock.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+
+uint64_t allocationCount = 0;
+bool countAllocations = false;
+
+void *allocate(size_t size) {
+  if (countAllocations) {
+    allocationCount++;
+  }
+  void *ptr = malloc(size ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+}  // namespace
+
+void *operator new(size_t size) {
+  return allocate(size);
+}
+
+void *operator new[](size_t size) {
+  return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+namespace {
+
+constexpr int ButtonPin = 5;
+// Channels reserved for HVAC thermometers etc. are not counted here
+constexpr int MaxChannelElements = SUPLA_CHANNELMAXCOUNT - 8;
+
+class SrpcStub : public SrpcInterface {
+ public:
+  _supla_int_t valueChanged(void *,
+                            unsigned char,
+                            std::vector<char>,
+                            unsigned char,
+                            unsigned _supla_int_t) override {
+    valueChangedCount++;
+    return 1;
+  }
+  _supla_int_t actionTrigger(unsigned char, int) override {
+    return 1;
+  }
+  _supla_int_t srpc_dcs_async_set_activity_timeout(
+      void *, TDCS_SuplaSetActivityTimeout *) override {
+    return 1;
+  }
+  void srpc_params_init(TsrpcParams *) override {
+  }
+  _supla_int_t srpc_ds_async_set_channel_result(void *,
+                                                unsigned char,
+                                                _supla_int_t,
+                                                char) override {
+    return 1;
+  }
+  _supla_int_t srpc_ds_async_device_calcfg_result(
+      void *, TDS_DeviceCalCfgResult *) override {
+    return 1;
+  }
+  void *srpc_init(TsrpcParams *) override {
+    return &srpc;
+  }
+  void srpc_free(void *) override {
+  }
+  void srpc_rd_free(TsrpcReceivedData *) override {
+  }
+  char srpc_getdata(void *, TsrpcReceivedData *, unsigned _supla_int_t)
+      override {
+    return 0;
+  }
+  char srpc_iterate(void *) override {
+    return SUPLA_RESULT_TRUE;
+  }
+  void srpc_set_proto_version(void *, unsigned char) override {
+  }
+  _supla_int_t srpc_ds_async_registerdevice_in_chunks(
+      void *, TDS_SuplaRegisterDeviceHeader *) override {
+    return 1;
+  }
+  _supla_int_t srpc_ds_async_registerdevice_in_chunks_g(
+      void *, TDS_SuplaRegisterDeviceHeader *) override {
+    return 1;
+  }
+  _supla_int_t srpc_dcs_async_ping_server(void *) override {
+    return 1;
+  }
+  _supla_int_t srpc_csd_async_channel_state_result(void *,
+                                                   TDSC_ChannelState *)
+      override {
+    return 1;
+  }
+  _supla_int_t srpc_dcs_async_get_user_localtime(void *) override {
+    return 1;
+  }
+  _supla_int_t getChannelConfig(unsigned char, unsigned char) override {
+    return 1;
+  }
+  _supla_int_t setDeviceConfigResult(TSDS_SetDeviceConfigResult *) override {
+    return 1;
+  }
+  _supla_int_t setDeviceConfigRequest(TSDS_SetDeviceConfig *) override {
+    return 1;
+  }
+  _supla_int_t setChannelConfigResult(TSDS_SetChannelConfigResult *)
+      override {
+    return 1;
+  }
+  _supla_int_t setChannelConfigRequest(TSDS_SetChannelConfig *) override {
+    return 1;
+  }
+  _supla_int_t registerPushNotification(int, unsigned char) override {
+    return 1;
+  }
+  _supla_int_t sendPushNotification(int,
+                                    unsigned char,
+                                    unsigned char,
+                                    const signed char *) override {
+    return 1;
+  }
+  _supla_int_t setSubdeviceDetails(int, char *, char *, char *, char *)
+      override {
+    return 1;
+  }
+  _supla_int_t setChannelCaption(int, const char *) override {
+    return 1;
+  }
+
+  int srpc = 0;
+  uint64_t valueChangedCount = 0;
+};
+
+class NetworkStub : public NetworkMock {
+ public:
+  void setup() override {
+  }
+  void disable() override {
+  }
+  bool isReady() override {
+    return true;
+  }
+  bool iterate() override {
+    return true;
+  }
+  bool isWifiConfigRequired() override {
+    return false;
+  }
+};
+
+// Destroyed by Supla::Protocol::SuplaSrpc
+class ClientStub : public NetworkClientMock {
+ public:
+  int available() override {
+    return 0;
+  }
+  void stop() override {
+    isConnected = false;
+  }
+  uint8_t connected() override {
+    return isConnected;
+  }
+  void setTimeoutMs(uint16_t) override {
+  }
+  int connectImp(const char *, uint16_t) override {
+    isConnected = true;
+    return 1;
+  }
+  size_t writeImp(const uint8_t *, size_t size) override {
+    return size;
+  }
+  int readImp(uint8_t *, size_t) override {
+    return -1;
+  }
+
+  bool isConnected = false;
+};
+
+class TimerStub : public TimerInterface {
+ public:
+  void initTimers() override {
+  }
+};
+
+class BoardStub : public BoardInterface {
+ public:
+  void deviceSoftwareReset() override {
+  }
+};
+
+class DigitalStub : public DigitalInterface {
+ public:
+  void digitalWrite(uint8_t, uint8_t) override {
+  }
+  int digitalRead(uint8_t pin) override {
+    return pin == ButtonPin ? buttonState : 0;
+  }
+  void analogWrite(uint8_t, int) override {
+  }
+  void pinMode(uint8_t, uint8_t) override {
+  }
+  unsigned int pulseIn(uint8_t, uint8_t, uint64_t) override {
+    return 0;
+  }
+
+  int buttonState = 0;
+};
+
+class OutputStub : public Supla::Control::OutputInterface {
+ public:
+  int getOutputValue() const override {
+    return value;
+  }
+  void setOutputValue(int value) override {
+    this->value = value;
+  }
+  bool isOnOffOnly() const override {
+    return true;
+  }
+
+  int value = 0;
+};
+
+class SyntheticMeter : public Supla::Sensor::ElectricityMeter {
+ public:
+  void readValuesFromDevice() override {
+    step++;
+    setVoltage(0, 23000 + step % 100);
+    setCurrent(0, 1000 + step % 50);
+    setPowerActive(0, 230000 + step % 1000);
+    setFwdActEnergy(0, 100000 + step);
+  }
+
+  uint32_t step = 0;
+};
+
+struct Population {
+  std::vector<std::unique_ptr<Supla::Control::VirtualRelay>> relays;
+  std::vector<std::unique_ptr<Supla::Sensor::VirtualThermometer>>
+      thermometers;
+  std::vector<std::unique_ptr<SyntheticMeter>> meters;
+  std::vector<std::unique_ptr<OutputStub>> outputs;
+  std::vector<std::unique_ptr<Supla::Control::HvacBase>> hvacs;
+  std::vector<std::unique_ptr<Supla::Control::Button>> buttons;
+
+  // Builds N elements: relay, thermometer, meter, HVAC and button in turn
+  void build(int count) {
+    int channelElements = 0;
+    for (int i = 0; i < count; i++) {
+      int kind = i % 5;
+      if (kind == 3 && thermometers.empty()) {
+        kind = 1;
+      }
+      if (kind != 4 && channelElements >= MaxChannelElements) {
+        kind = 4;
+      }
+      switch (kind) {
+        case 0: {
+          relays.emplace_back(new Supla::Control::VirtualRelay());
+          channelElements++;
+          break;
+        }
+        case 1: {
+          thermometers.emplace_back(new Supla::Sensor::VirtualThermometer());
+          channelElements++;
+          break;
+        }
+        case 2: {
+          meters.emplace_back(new SyntheticMeter());
+          channelElements++;
+          break;
+        }
+        case 3: {
+          outputs.emplace_back(new OutputStub());
+          auto hvac = new Supla::Control::HvacBase(outputs.back().get());
+          hvac->addAvailableAlgorithm(
+              SUPLA_HVAC_ALGORITHM_ON_OFF_SETPOINT_MIDDLE);
+          hvac->setMainThermometerChannelNo(
+              thermometers.back()->getChannelNumber());
+          hvacs.emplace_back(hvac);
+          channelElements++;
+          break;
+        }
+        default: {
+          auto button = new Supla::Control::Button(ButtonPin);
+          if (!relays.empty()) {
+            button->addAction(Supla::TOGGLE,
+                              relays[buttons.size() % relays.size()].get(),
+                              Supla::ON_PRESS);
+          }
+          buttons.emplace_back(button);
+          break;
+        }
+      }
+    }
+  }
+
+  // Changes inputs, so part of passes generates channel updates
+  void stimulate(uint32_t pass, DigitalStub *digital) {
+    if (pass % 50 == 0) {
+      double temperature = 20.0 + (pass / 50 % 10) * 0.1;
+      for (auto &thermometer : thermometers) {
+        thermometer->setValue(temperature);
+      }
+    }
+    // buttons are pressed for 100 ms every 500 ms
+    digital->buttonState = (pass % 500 < 100) ? 1 : 0;
+  }
+};
+
+struct Result {
+  int elements = 0;
+  int channels = 0;
+  double avgNsPerPass = 0;
+  uint64_t maxNsPerPass = 0;
+  double allocationsPerPass = 0;
+  double valuesPerPass = 0;
+};
+
+Result runBenchmark(int elementCount, uint32_t passes) {
+  SimpleTime time;
+  time.value = 1000;
+  SrpcStub srpc;
+  NetworkStub network;
+  TimerStub timer;
+  BoardStub board;
+  DigitalStub digital;
+  Result result;
+  result.elements = elementCount;
+
+  Supla::Channel::resetToDefaults();
+  {
+    Population population;
+    population.build(elementCount);
+    result.channels = Supla::RegisterDevice::getNextFreeChannelNumber();
+
+    new ClientStub();
+    SuplaDeviceClass sd;
+    char guid[SUPLA_GUID_SIZE] = {1};
+    char authkey[SUPLA_AUTHKEY_SIZE] = {2};
+    sd.begin(guid, "supla.rulez", "superman@supla.org", authkey, 23);
+    for (int i = 0; i < 5; i++) {
+      sd.iterate();
+      time.advance(1000);
+    }
+    TSD_SuplaRegisterDeviceResult registerResult = {};
+    registerResult.result_code = SUPLA_RESULTCODE_TRUE;
+    registerResult.activity_timeout = 45;
+    registerResult.version = 23;
+    registerResult.version_min = 1;
+    sd.getSrpcLayer()->onRegisterResult(&registerResult);
+    if (sd.getCurrentStatus() != STATUS_REGISTERED_AND_READY) {
+      fprintf(stderr, "N=%d: device not registered (status %d)\n",
+              elementCount, sd.getCurrentStatus());
+    }
+
+    auto pass = [&](uint32_t i) {
+      population.stimulate(i, &digital);
+      sd.onFastTimer();
+      if (i % 10 == 0) {
+        sd.onTimer();
+      }
+      sd.iterate();
+      time.advance(1);
+    };
+
+    // warm up: initial value sends, lazy allocations
+    for (uint32_t i = 0; i < 1000; i++) {
+      pass(i);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    uint64_t totalNs = 0;
+    uint64_t valuesBefore = srpc.valueChangedCount;
+    allocationCount = 0;
+    for (uint32_t i = 0; i < passes; i++) {
+      countAllocations = true;
+      auto start = Clock::now();
+      pass(1000 + i);
+      auto end = Clock::now();
+      countAllocations = false;
+      uint64_t ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
+      totalNs += ns;
+      result.maxNsPerPass = std::max(result.maxNsPerPass, ns);
+    }
+    result.avgNsPerPass = static_cast<double>(totalNs) / passes;
+    result.allocationsPerPass =
+        static_cast<double>(allocationCount) / passes;
+    result.valuesPerPass =
+        static_cast<double>(srpc.valueChangedCount - valuesBefore) / passes;
+    delete sd.getClock();
+  }
+  Supla::Channel::resetToDefaults();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  uint32_t passes = 2000;
+  std::vector<int> counts;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+      passes = strtoul(argv[++i], nullptr, 10);
+    } else {
+      int count = atoi(argv[i]);
+      if (count <= 0) {
+        fprintf(stderr, "Usage: %s [--passes P] [N...]\n", argv[0]);
+        return 1;
+      }
+      counts.push_back(count);
+    }
+  }
+  if (passes == 0) {
+    passes = 1;
+  }
+  if (counts.empty()) {
+    counts = {10, 50, 100, 250, 500, 1000};
+  }
+
+  printf("%8s %8s %14s %14s %12s %12s\n",
+         "elements", "channels", "avg ns/pass", "max ns/pass", "allocs/pass",
+         "values/pass");
+  for (int count : counts) {
+    auto result = runBenchmark(count, passes);
+    printf("%8d %8d %14.0f %14llu %12.2f %12.3f\n",
+           result.elements,
+           result.channels,
+           result.avgNsPerPass,
+           static_cast<unsigned long long>(result.maxNsPerPass),  // NOLINT
+           result.allocationsPerPass,
+           result.valuesPerPass);
+  }
+  return 0;
+}
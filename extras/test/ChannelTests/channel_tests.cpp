@@ -12,6 +12,9 @@
 #include <supla/events.h>
 #include <supla/protocol/supla_srpc.h>
 
+#include <memory>
+#include <vector>
+
 #include "supla/device/register_device.h"
 
 class ChannelTestsFixture : public ::testing::Test {
@@ -1047,3 +1050,38 @@ TEST_F(ChannelTestsFixture, ChannelArbitaryNumbers) {
   // channel number 2 is for "third"
   EXPECT_EQ(Supla::RegisterDevice::getChannelValuePtr(2)[0], 3);
 }
+
+TEST_F(ChannelTestsFixture, RegisterChannelRecordsFollowCreationOrder) {
+  std::vector<std::unique_ptr<Supla::Channel>> channels;
+  for (int i = 0; i < SUPLA_CHANNELMAXCOUNT; i++) {
+    // channel numbers are assigned in reverse order
+    channels.emplace_back(new Supla::Channel(SUPLA_CHANNELMAXCOUNT - 1 - i));
+    channels.back()->setNewValue(i);
+  }
+  ASSERT_EQ(Supla::RegisterDevice::getChannelCount(), SUPLA_CHANNELMAXCOUNT);
+
+  // registration reads records one by one
+  for (int i = 0; i < SUPLA_CHANNELMAXCOUNT; i++) {
+    auto record = Supla::RegisterDevice::getChannelPtr_E(i);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->Number, SUPLA_CHANNELMAXCOUNT - 1 - i);
+    EXPECT_EQ(record->value[0], i);
+  }
+  EXPECT_EQ(Supla::RegisterDevice::getChannelPtr_E(SUPLA_CHANNELMAXCOUNT),
+            nullptr);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelPtr_D(-1), nullptr);
+
+  // random access still works
+  EXPECT_EQ(Supla::RegisterDevice::getChannelPtr_D(7)->Number, 120);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelPtr_D(7)->Number, 120);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelPtr_D(3)->Number, 124);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelNumber(100), 27);
+
+  // removing channel doesn't leave stale position of the list
+  channels.erase(channels.begin() + 100);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelNumber(101), 25);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelNumber(100), 26);
+  EXPECT_EQ(Supla::RegisterDevice::getChannelNumber(
+                SUPLA_CHANNELMAXCOUNT - 1),
+            -1);
+}
@@ -0,0 +1,292 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <config_mock.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <protocol_layer_mock.h>
+#include <simple_time.h>
+#include <string.h>
+#include <supla/channels/channel.h>
+#include <supla/channels/reporting_policy.h>
+
+#include <vector>
+
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::StrEq;
+
+namespace {
+
+class ReportingPolicyTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+    ON_CALL(proto, sendChannelValueChanged(_, _, _, _))
+        .WillByDefault([this](uint8_t, int8_t *value, unsigned char,
+                              uint32_t) {
+          int8_t raw[SUPLA_CHANNELVALUE_SIZE] = {};
+          memcpy(raw, value, sizeof(raw));
+          sentValues.push_back(std::vector<int8_t>(raw, raw + sizeof(raw)));
+        });
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  // Sends update if channel is ready, like Element::iterateConnected does
+  bool iterate(Supla::Channel *channel) {
+    if (!channel->isUpdateReady()) {
+      return false;
+    }
+    channel->sendUpdate();
+    return true;
+  }
+
+  double lastSentDouble() const {
+    double value = 0;
+    memcpy(&value, sentValues.back().data(), sizeof(value));
+    return value;
+  }
+
+  SimpleTime time;
+  NiceMock<ProtocolLayerMock> proto;
+  std::vector<std::vector<int8_t>> sentValues;
+};
+
+}  // namespace
+
+TEST_F(ReportingPolicyTests, InactiveConfigDoesntAllocatePolicy) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.deadbandType = Supla::ReportingDeadbandType::Absolute;
+  EXPECT_FALSE(config.isActive());
+  channel.setReportingPolicy(config);
+  EXPECT_EQ(channel.getReportingPolicy(), nullptr);
+
+  config.deadband = 100;
+  channel.setReportingPolicy(config);
+  ASSERT_NE(channel.getReportingPolicy(), nullptr);
+  EXPECT_EQ(channel.getReportingPolicy()->getConfig(), config);
+
+  channel.removeReportingPolicy();
+  EXPECT_EQ(channel.getReportingPolicy(), nullptr);
+  EXPECT_EQ(channel.getSentValueCount(), 0u);
+}
+
+TEST_F(ReportingPolicyTests, AbsoluteDeadbandIsCheckedAgainstLastSentValue) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.deadbandType = Supla::ReportingDeadbandType::Absolute;
+  config.deadband = 500;
+  channel.setReportingPolicy(config);
+
+  channel.setNewValue(20.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  // small changes are suppressed
+  channel.setNewValue(20.3);
+  EXPECT_FALSE(iterate(&channel));
+  channel.setNewValue(19.8);
+  EXPECT_FALSE(iterate(&channel));
+
+  // slow drift is reported once it exceeds deadband
+  channel.setNewValue(20.6);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_DOUBLE_EQ(lastSentDouble(), 20.6);
+
+  channel.setNewValue(20.2);
+  EXPECT_FALSE(iterate(&channel));
+
+  EXPECT_EQ(sentValues.size(), 2u);
+  EXPECT_EQ(channel.getSentValueCount(), 2u);
+  EXPECT_EQ(channel.getSuppressedValueCount(), 3u);
+}
+
+TEST_F(ReportingPolicyTests, RelativeDeadbandAppliesToBothHumidityValues) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_HUMIDITYANDTEMPSENSOR);
+  Supla::ReportingPolicyConfig config;
+  config.deadbandType = Supla::ReportingDeadbandType::Relative;
+  // 5 %
+  config.deadband = 5000;
+  channel.setReportingPolicy(config);
+
+  channel.setNewValue(20.0, 50.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  channel.setNewValue(20.5, 52.0);
+  EXPECT_FALSE(iterate(&channel));
+
+  // humidity change above 5 % of 50
+  channel.setNewValue(20.5, 53.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  // temperature change above 5 % of last sent 20.5
+  channel.setNewValue(22.0, 53.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  EXPECT_EQ(channel.getSentValueCount(), 3u);
+  EXPECT_EQ(channel.getSuppressedValueCount(), 1u);
+}
+
+TEST_F(ReportingPolicyTests, DeadbandIsNotUsedForNonNumericChannels) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_RELAY);
+  Supla::ReportingPolicyConfig config;
+  config.deadbandType = Supla::ReportingDeadbandType::Absolute;
+  config.deadband = 100000;
+  channel.setReportingPolicy(config);
+
+  channel.setNewValue(true);
+  EXPECT_TRUE(iterate(&channel));
+  channel.setNewValue(false);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_EQ(channel.getSuppressedValueCount(), 0u);
+}
+
+TEST_F(ReportingPolicyTests, MinIntervalCoalescesChanges) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.minIntervalMs = 1000;
+  channel.setReportingPolicy(config);
+
+  time.value = 5000;
+  channel.setNewValue(20.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  time.advance(100);
+  channel.setNewValue(21.0);
+  EXPECT_FALSE(iterate(&channel));
+  time.advance(100);
+  channel.setNewValue(22.0);
+  EXPECT_FALSE(iterate(&channel));
+
+  // other pending fields are not blocked by held value
+  channel.setSendGetConfig();
+  EXPECT_TRUE(channel.isUpdateReady());
+  EXPECT_CALL(proto, getChannelConfig(0, _)).Times(1);
+  channel.sendUpdate();
+  EXPECT_FALSE(channel.isUpdateReady());
+
+  time.advance(799);
+  EXPECT_FALSE(iterate(&channel));
+  time.advance(1);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_DOUBLE_EQ(lastSentDouble(), 22.0);
+  EXPECT_FALSE(iterate(&channel));
+
+  EXPECT_EQ(sentValues.size(), 2u);
+  EXPECT_EQ(channel.getSentValueCount(), 2u);
+  EXPECT_EQ(channel.getSuppressedValueCount(), 1u);
+}
+
+TEST_F(ReportingPolicyTests, MinIntervalWithoutCoalescingDropsChanges) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.minIntervalMs = 1000;
+  config.coalescing = 0;
+  channel.setReportingPolicy(config);
+
+  channel.setNewValue(20.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  time.advance(500);
+  channel.setNewValue(21.0);
+  time.advance(1000);
+  EXPECT_FALSE(iterate(&channel));
+
+  channel.setNewValue(22.0);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_DOUBLE_EQ(lastSentDouble(), 22.0);
+  EXPECT_EQ(channel.getSuppressedValueCount(), 1u);
+}
+
+TEST_F(ReportingPolicyTests, MaxIntervalSendsHeartbeat) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.deadbandType = Supla::ReportingDeadbandType::Absolute;
+  config.deadband = 1000;
+  config.maxIntervalMs = 60000;
+  channel.setReportingPolicy(config);
+
+  channel.setNewValue(20.0);
+  EXPECT_TRUE(iterate(&channel));
+
+  time.advance(30000);
+  channel.setNewValue(20.5);
+  EXPECT_FALSE(iterate(&channel));
+
+  time.advance(29999);
+  EXPECT_FALSE(iterate(&channel));
+  time.advance(1);
+  // current value is sent even though it is within deadband
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_DOUBLE_EQ(lastSentDouble(), 20.5);
+  EXPECT_FALSE(iterate(&channel));
+
+  time.advance(60000);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_EQ(channel.getSentValueCount(), 3u);
+}
+
+TEST_F(ReportingPolicyTests, RegistrationCountsAsLastSentValue) {
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  channel.setNewValue(20.0);
+  Supla::ReportingPolicyConfig config;
+  config.minIntervalMs = 1000;
+  channel.setReportingPolicy(config);
+
+  time.value = 10000;
+  channel.onRegistered();
+  channel.setNewValue(21.0);
+  EXPECT_FALSE(iterate(&channel));
+  time.advance(1000);
+  EXPECT_TRUE(iterate(&channel));
+  EXPECT_EQ(channel.getSentValueCount(), 1u);
+}
+
+TEST_F(ReportingPolicyTests, StoredConfigOverridesPolicyFromCode) {
+  NiceMock<ConfigMock> cfg;
+  Supla::Channel channel;
+  channel.setType(SUPLA_CHANNELTYPE_THERMOMETER);
+  Supla::ReportingPolicyConfig config;
+  config.minIntervalMs = 1000;
+  channel.setReportingPolicy(config);
+
+  Supla::ReportingPolicyConfig stored;
+  stored.maxIntervalMs = 30000;
+  EXPECT_CALL(cfg, getBlob(StrEq("0_rep_pol"), _, sizeof(stored)))
+      .WillOnce([&stored](const char *, char *value, size_t size) {
+        memcpy(value, &stored, size);
+        return true;
+      });
+  channel.loadReportingPolicy();
+  ASSERT_NE(channel.getReportingPolicy(), nullptr);
+  EXPECT_EQ(channel.getReportingPolicy()->getConfig(), stored);
+
+  // disabled policy stored in config removes policy set from code
+  EXPECT_CALL(cfg, getBlob(StrEq("0_rep_pol"), _, sizeof(stored)))
+      .WillOnce([](const char *, char *value, size_t size) {
+        Supla::ReportingPolicyConfig disabled;
+        memcpy(value, &disabled, size);
+        return true;
+      });
+  channel.loadReportingPolicy();
+  EXPECT_EQ(channel.getReportingPolicy(), nullptr);
+
+  // missing config keeps current policy
+  channel.setReportingPolicy(config);
+  EXPECT_CALL(cfg, getBlob(StrEq("0_rep_pol"), _, _)).WillOnce(Return(false));
+  channel.loadReportingPolicy();
+  ASSERT_NE(channel.getReportingPolicy(), nullptr);
+  EXPECT_EQ(channel.getReportingPolicy()->getConfig(), config);
+}
@@ -0,0 +1,234 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+
+#include <simple_time.h>
+#include <supla-common/log.h>
+#include <supla/debug/async_log.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+extern "C" const char *supla_test_get_last_log();
+extern "C" void supla_test_clear_last_log();
+
+namespace {
+
+std::vector<std::pair<int, std::string>> outputLines;
+
+void captureOutput(int priority, const char *message) {
+  outputLines.emplace_back(priority, message);
+}
+
+class AsyncLogTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    outputLines.clear();
+  }
+
+  std::string formatAsync(const char *format, ...) {
+    Supla::Debug::AsyncLogRecord record;
+    va_list args;
+    va_start(args, format);
+    Supla::Debug::AsyncLog::pack(&record, LOG_INFO, format, args);
+    va_end(args);
+    char buffer[SUPLA_ASYNC_LOG_LINE_SIZE] = {};
+    Supla::Debug::AsyncLog::format(record, buffer, sizeof(buffer));
+    return buffer;
+  }
+
+  SimpleTime time;
+};
+
+}  // namespace
+
+TEST_F(AsyncLogTests, DeferredFormattingMatchesPrintf) {
+  char expected[SUPLA_ASYNC_LOG_LINE_SIZE] = {};
+  const char *str = "text";
+  int16_t shortValue = -5;
+  uint8_t byteValue = 250;
+  uint64_t bigValue = 0x123456789ABCDEF0ull;
+
+  snprintf(expected, sizeof(expected),
+           "a=%d b=%5u c=%-4x| d=%08.3f e=%s f=%c g=%% h=%ld i=%lld",
+           -12, 34u, 0xabu, 3.14159, str, 'Z', 1234567L, -9876543210LL);
+  EXPECT_EQ(std::string(expected),
+            formatAsync(
+                "a=%d b=%5u c=%-4x| d=%08.3f e=%s f=%c g=%% h=%ld i=%lld",
+                -12, 34u, 0xabu, 3.14159, str, 'Z', 1234567L, -9876543210LL));
+
+  snprintf(expected, sizeof(expected),
+           "j=%zu k=%hd l=%hhu m=%.2s n=%*d o=%.*f p=%g q=%llX r=%p",
+           static_cast<size_t>(77), shortValue, byteValue, str, 6, 42, 1,
+           2.55, 1e-7, static_cast<unsigned long long>(bigValue),  // NOLINT
+           static_cast<const void *>(str));
+  EXPECT_EQ(std::string(expected),
+            formatAsync(
+                "j=%zu k=%hd l=%hhu m=%.2s n=%*d o=%.*f p=%g q=%llX r=%p",
+                static_cast<size_t>(77), shortValue, byteValue, str, 6, 42, 1,
+                2.55, 1e-7,
+                static_cast<unsigned long long>(bigValue),  // NOLINT
+                static_cast<const void *>(str)));
+}
+
+TEST_F(AsyncLogTests, StringArgumentsAreCopied) {
+  Supla::Debug::AsyncLog asyncLog(captureOutput, 4);
+  char transient[16] = "before";
+  asyncLog.log(LOG_DEBUG, "value: %s", transient);
+  snprintf(transient, sizeof(transient), "after");
+
+  EXPECT_EQ(1, asyncLog.drain());
+  ASSERT_EQ(1u, outputLines.size());
+  EXPECT_EQ(LOG_DEBUG, outputLines[0].first);
+  EXPECT_EQ("value: before", outputLines[0].second);
+
+  const char *nullString = nullptr;
+  EXPECT_EQ("null: (null)", formatAsync("null: %s", nullString));
+}
+
+TEST_F(AsyncLogTests, TooLongArgumentsAreTruncated) {
+  std::string longText(SUPLA_ASYNC_LOG_ARGS_SIZE * 2, 'x');
+  auto result = formatAsync("%d %s %d end", 7, longText.c_str(), 8);
+  EXPECT_EQ(0u, result.rfind("7 xxxx", 0));
+  EXPECT_EQ("...", result.substr(result.size() - 3));
+  EXPECT_EQ(std::string::npos, result.find("end"));
+}
+
+TEST_F(AsyncLogTests, PrecisionLimitsReadOfNotTerminatedString) {
+  // text is not NUL terminated, data after it must not be copied
+  struct {
+    char text[6];
+    char after[SUPLA_ASYNC_LOG_ARGS_SIZE * 2];
+  } buffer;
+  memcpy(buffer.text, "ABCDEF", sizeof(buffer.text));
+  memset(buffer.after, 'x', sizeof(buffer.after));
+  buffer.after[sizeof(buffer.after) - 1] = '\0';
+
+  EXPECT_EQ("[ABCDEF] 7",
+            formatAsync("[%.*s] %d",
+                        static_cast<int>(sizeof(buffer.text)),
+                        buffer.text,
+                        7));
+  EXPECT_EQ("[ABCD] 8", formatAsync("[%.4s] %d", buffer.text, 8));
+  // negative precision is ignored, as in printf
+  EXPECT_EQ("[ab] 9", formatAsync("[%.*s] %d", -1, "ab", 9));
+}
+
+TEST_F(AsyncLogTests, FullQueueDropsAndReportsCounter) {
+  Supla::Debug::AsyncLog asyncLog(captureOutput, 4);
+  EXPECT_EQ(4u, asyncLog.getCapacity());
+  EXPECT_TRUE(asyncLog.isEmpty());
+
+  for (int i = 0; i < 6; i++) {
+    bool expected = i < 4;
+    EXPECT_EQ(expected, asyncLog.log(LOG_INFO, "msg %d", i));
+  }
+  EXPECT_FALSE(asyncLog.isEmpty());
+  EXPECT_EQ(2u, asyncLog.getDroppedCount());
+
+  EXPECT_EQ(4, asyncLog.drain());
+  EXPECT_TRUE(asyncLog.isEmpty());
+  ASSERT_EQ(5u, outputLines.size());
+  EXPECT_EQ(LOG_WARNING, outputLines[0].first);
+  EXPECT_EQ("AsyncLog: 2 log messages dropped", outputLines[0].second);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ("msg " + std::to_string(i), outputLines[i + 1].second);
+  }
+  EXPECT_EQ(4u, asyncLog.getWrittenCount());
+
+  // drop counter is reported only once
+  EXPECT_EQ(0, asyncLog.drain());
+  EXPECT_EQ(5u, outputLines.size());
+
+  // queue is reusable after wrap around
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(asyncLog.log(LOG_INFO, "again %d", i));
+    EXPECT_EQ(1, asyncLog.drain(1));
+  }
+  EXPECT_EQ("again 9", outputLines.back().second);
+}
+
+TEST_F(AsyncLogTests, MultipleProducersSingleConsumer) {
+  Supla::Debug::AsyncLog asyncLog(captureOutput, 64);
+  const int producers = 4;
+  const int messagesPerProducer = 2000;
+
+  std::atomic<int> finishedProducers(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&asyncLog, &finishedProducers, p]() {
+      for (int i = 0; i < messagesPerProducer; i++) {
+        asyncLog.log(LOG_INFO, "p%d m%d", p, i);
+      }
+      finishedProducers++;
+    });
+  }
+
+  int drained = 0;
+  while (finishedProducers < producers) {
+    drained += asyncLog.drain();
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  drained += asyncLog.drain();
+
+  EXPECT_EQ(producers * messagesPerProducer,
+            drained + static_cast<int>(asyncLog.getDroppedCount()));
+
+  // messages from a single producer keep their order
+  std::vector<int> lastIndex(producers, -1);
+  for (const auto &line : outputLines) {
+    int p = -1;
+    int m = -1;
+    if (sscanf(line.second.c_str(), "p%d m%d", &p, &m) == 2) {
+      ASSERT_GE(p, 0);
+      ASSERT_LT(p, producers);
+      EXPECT_GT(m, lastIndex[p]);
+      lastIndex[p] = m;
+    }
+  }
+}
+
+TEST_F(AsyncLogTests, CBridgeDoesntTruncateLongLinesWithoutInstance) {
+  ASSERT_EQ(nullptr, Supla::Debug::AsyncLog::Instance());
+  std::string value(3 * SUPLA_ASYNC_LOG_LINE_SIZE, 'x');
+  supla_test_clear_last_log();
+  supla_async_logf(LOG_INFO, "long %s end", value.c_str());
+  EXPECT_EQ("long " + value + " end", supla_test_get_last_log());
+}
+
+TEST_F(AsyncLogTests, CBridgeQueuesWhenInstanceExists) {
+  supla_test_clear_last_log();
+  supla_async_logf(LOG_INFO, "sync %d", 1);
+  EXPECT_STREQ("sync 1", supla_test_get_last_log());
+
+  {
+    Supla::Debug::AsyncLog asyncLog(captureOutput, 8);
+    EXPECT_EQ(&asyncLog, Supla::Debug::AsyncLog::Instance());
+    supla_test_clear_last_log();
+    supla_async_logf(LOG_INFO, "async %d", 2);
+    EXPECT_STREQ("", supla_test_get_last_log());
+    EXPECT_TRUE(outputLines.empty());
+
+    EXPECT_EQ(1, asyncLog.drain());
+    ASSERT_EQ(1u, outputLines.size());
+    EXPECT_EQ("async 2", outputLines[0].second);
+
+    asyncLog.unregisterInstance();
+    EXPECT_EQ(nullptr, Supla::Debug::AsyncLog::Instance());
+    supla_async_logf(LOG_INFO, "sync %d", 3);
+    EXPECT_STREQ("sync 3", supla_test_get_last_log());
+    EXPECT_TRUE(asyncLog.isEmpty());
+
+    asyncLog.registerInstance();
+    EXPECT_EQ(&asyncLog, Supla::Debug::AsyncLog::Instance());
+  }
+  EXPECT_EQ(nullptr, Supla::Debug::AsyncLog::Instance());
+}
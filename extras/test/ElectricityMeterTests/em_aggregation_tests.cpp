@@ -0,0 +1,253 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <simple_time.h>
+#include <supla/channel.h>
+#include <supla/sensor/em_aggregation.h>
+#include <supla/sensor/electricity_meter.h>
+
+#include <functional>
+
+using Supla::Sensor::EmAggregatedValue;
+using Supla::Sensor::EmAggregation;
+using Supla::Sensor::EmAggregationMode;
+using Supla::Sensor::EmRunningStats;
+
+namespace {
+
+// Reads values from function of time (in ms)
+class ScriptedEM : public Supla::Sensor::ElectricityMeter {
+ public:
+  void readValuesFromDevice() override {
+    reads++;
+    if (read) {
+      read(this, millis());
+    }
+  }
+
+  std::function<void(ScriptedEM *, uint32_t)> read;
+  int reads = 0;
+};
+
+class EmAggregationTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+    time.advance(1000);
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  // Runs iterateAlways every ms for durationMs
+  void run(Supla::Sensor::ElectricityMeter *em, int durationMs) {
+    for (int i = 0; i < durationMs; i++) {
+      em->iterateAlways();
+      time.advance(1);
+    }
+  }
+
+  TElectricityMeter_ExtendedValue_V3 channelValue(
+      Supla::Sensor::ElectricityMeter *em) {
+    TElectricityMeter_ExtendedValue_V3 value = {};
+    EXPECT_TRUE(em->getChannel()->getExtValueAsElectricityMeter(&value));
+    return value;
+  }
+
+  SimpleTime time;
+};
+
+}  // namespace
+
+TEST(EmRunningStatsTests, MinMaxMeanLast) {
+  EmRunningStats stats;
+  EXPECT_TRUE(stats.isEmpty());
+  EXPECT_EQ(stats.get(EmAggregationMode::Mean), 0);
+
+  for (int64_t value : {10, -4, 7, 3}) {
+    stats.add(value);
+  }
+  EXPECT_EQ(stats.getCount(), 4u);
+  EXPECT_EQ(stats.get(EmAggregationMode::Last), 3);
+  EXPECT_EQ(stats.get(EmAggregationMode::Min), -4);
+  EXPECT_EQ(stats.get(EmAggregationMode::Max), 10);
+  // 16 / 4
+  EXPECT_EQ(stats.get(EmAggregationMode::Mean), 4);
+
+  stats.add(0);
+  // 3.2 and -3.6 are rounded to the nearest value
+  EXPECT_EQ(stats.get(EmAggregationMode::Mean), 3);
+  stats.reset();
+  for (int64_t value : {-3, -4, -4, -4, -3}) {
+    stats.add(value);
+  }
+  EXPECT_EQ(stats.get(EmAggregationMode::Mean), -4);
+}
+
+TEST(EmAggregationWindowTests, CloseWindowStartsNewOne) {
+  EmAggregation aggregation;
+  aggregation.addSample(EmAggregatedValue::Voltage, 1, 23000);
+  aggregation.addSample(EmAggregatedValue::Voltage, 1, 23100);
+  aggregation.addSample(EmAggregatedValue::Voltage, 5, 1);
+  EXPECT_EQ(aggregation.getCurrent(EmAggregatedValue::Voltage, 1).getCount(),
+            2u);
+  EXPECT_TRUE(aggregation.getLast(EmAggregatedValue::Voltage, 1).isEmpty());
+
+  aggregation.closeWindow();
+  EXPECT_TRUE(aggregation.getCurrent(EmAggregatedValue::Voltage, 1).isEmpty());
+  EXPECT_EQ(aggregation.getLast(EmAggregatedValue::Voltage, 1)
+                .get(EmAggregationMode::Mean),
+            23050);
+  EXPECT_TRUE(aggregation.getLast(EmAggregatedValue::Voltage, 0).isEmpty());
+}
+
+TEST(EmAggregationWindowTests, TrapezoidalEnergyIntegration) {
+  EmAggregation aggregation;
+  EXPECT_EQ(aggregation.integratePower(0, false, 100000000, 0), 0);
+
+  aggregation.setEnergyIntegration(true);
+  // power ramps from 0 W to 2 kW during 1 h, sampled every 36 ms, which
+  // gives exactly 1 kWh
+  int64_t energy = 0;
+  const uint32_t samples = 100000;
+  for (uint32_t i = 0; i <= samples; i++) {
+    int64_t power = 200000000LL * i / samples;
+    energy += aggregation.integratePower(0, false, power, 1000 + i * 36);
+  }
+  EXPECT_EQ(energy, 100000);
+
+  // reverse power gives negative energy, other phase and reactive power are
+  // integrated separately
+  energy = 0;
+  int64_t reactive = 0;
+  for (uint32_t i = 0; i <= 3600; i++) {
+    energy += aggregation.integratePower(2, false, -360000000, i * 1000);
+    reactive += aggregation.integratePower(2, true, 100000000, i * 1000);
+  }
+  EXPECT_EQ(energy, -360000);
+  EXPECT_EQ(reactive, 100000);
+}
+
+TEST(EmAggregationWindowTests, IntegrationHandlesMillisOverflow) {
+  EmAggregation aggregation;
+  aggregation.setEnergyIntegration(true);
+  int64_t energy = 0;
+  // 3.6 kW during 10 s
+  for (uint32_t i = 0; i <= 100; i++) {
+    energy += aggregation.integratePower(
+        0, false, 360000000, UINT32_MAX - 5000 + i * 100);
+  }
+  EXPECT_EQ(energy, 1000);
+}
+
+TEST_F(EmAggregationTests, ChannelValueIsMeanOfSamples) {
+  ScriptedEM em;
+  em.setRefreshRate(1);
+  em.enableSampleAggregation(50);
+  EXPECT_TRUE(em.isSampleAggregationEnabled());
+  EXPECT_EQ(em.getAggregationMode(), EmAggregationMode::Mean);
+  int sample = 0;
+  em.read = [&sample](ScriptedEM *em, uint32_t) {
+    // voltage alternates between 220 V and 240 V, current rises
+    em->setVoltage(0, sample % 2 ? 24000 : 22000);
+    em->setCurrent(0, 1000 + sample * 10);
+    em->setPowerActive(0, (sample % 2 ? 300 : 100) * 100000LL);
+    em->setFreq(5000 + sample);
+    sample++;
+  };
+
+  // first read is sent immediately
+  run(&em, 1);
+  EXPECT_EQ(em.reads, 1);
+  EXPECT_EQ(channelValue(&em).m[0].voltage[0], 22000);
+
+  // 20 samples in the next window
+  run(&em, 1001);
+  EXPECT_EQ(em.reads, 21);
+  auto value = channelValue(&em);
+  EXPECT_EQ(value.m[0].voltage[0], 23000);
+  // mean of 1010 .. 1200
+  EXPECT_EQ(value.m[0].current[0], 1105);
+  EXPECT_EQ(value.m[0].power_active[0], 200 * 100000);
+  // not aggregated values are reported as last read
+  EXPECT_EQ(value.m[0].freq, 5020);
+
+  // getters return last read values
+  EXPECT_EQ(em.getVoltage(0), 22000);
+  EXPECT_EQ(em.getCurrent(0), 1200u);
+  EXPECT_EQ(em.getAggregatedValue(
+                EmAggregatedValue::Voltage, 0, EmAggregationMode::Min),
+            22000);
+  EXPECT_EQ(em.getAggregatedValue(
+                EmAggregatedValue::Current, 0, EmAggregationMode::Max),
+            1200);
+}
+
+TEST_F(EmAggregationTests, ChannelCanUseMaxOrLast) {
+  ScriptedEM em;
+  em.setRefreshRate(1);
+  em.enableSampleAggregation(100, EmAggregationMode::Max);
+  int sample = 0;
+  em.read = [&sample](ScriptedEM *em, uint32_t) {
+    // short spike in the middle of the window
+    em->setPowerActive(1, (sample == 5 ? 5000 : 1000) * 100000LL);
+    sample++;
+  };
+  run(&em, 1);
+  run(&em, 1001);
+  EXPECT_EQ(channelValue(&em).m[0].power_active[1], 5000 * 100000);
+
+  em.setAggregationMode(EmAggregationMode::Last);
+  run(&em, 1001);
+  EXPECT_EQ(channelValue(&em).m[0].power_active[1], 1000 * 100000);
+}
+
+TEST_F(EmAggregationTests, EnergyIsIntegratedFromPower) {
+  ScriptedEM em;
+  // integration without aggregation is ignored
+  em.enableEnergyIntegration();
+  em.enableSampleAggregation(100);
+  em.enableEnergyIntegration();
+  em.read = [](ScriptedEM *em, uint32_t timestamp) {
+    // 3.6 kW import for 10 s, then 1.8 kW export
+    bool exporting = timestamp > 11000;
+    em->setPowerActive(0, (exporting ? -1800 : 3600) * 100000LL);
+    em->setPowerReactive(0, 360 * 100000LL);
+  };
+
+  run(&em, 10001);
+  EXPECT_EQ(em.getFwdActEnergy(0), 1000u);
+  EXPECT_EQ(em.getRvrActEnergy(0), 0u);
+  EXPECT_EQ(em.getFwdReactEnergy(0), 100u);
+
+  // single trapezoid between 3.6 kW and -1.8 kW gives 0.000025 kWh of
+  // forward energy, then 9.9 s of export. Part of energy unit which wasn't
+  // counted as forward is subtracted from reverse one.
+  run(&em, 10000);
+  EXPECT_EQ(em.getFwdActEnergy(0), 1002u);
+  EXPECT_EQ(em.getRvrActEnergy(0), 494u);
+  EXPECT_EQ(em.getFwdReactEnergy(0), 200u);
+
+  auto value = channelValue(&em);
+  EXPECT_TRUE(value.measured_values & EM_VAR_FORWARD_ACTIVE_ENERGY);
+  EXPECT_TRUE(value.measured_values & EM_VAR_REVERSE_ACTIVE_ENERGY);
+  EXPECT_EQ(value.total_forward_active_energy[0], 1002u);
+}
+
+TEST_F(EmAggregationTests, WithoutAggregationCurrentValuesAreReturned) {
+  Supla::Sensor::ElectricityMeter em;
+  em.setVoltage(2, 23456);
+  em.setPowerApparent(2, 1234);
+  EXPECT_FALSE(em.isSampleAggregationEnabled());
+  EXPECT_EQ(em.getAggregatedValue(
+                EmAggregatedValue::Voltage, 2, EmAggregationMode::Mean),
+            23456);
+  EXPECT_EQ(em.getAggregatedValue(
+                EmAggregatedValue::PowerApparent, 2, EmAggregationMode::Max),
+            1234);
+  EXPECT_EQ(em.getAggregatedValue(
+                EmAggregatedValue::PowerApparent, 3, EmAggregationMode::Max),
+            0);
+}
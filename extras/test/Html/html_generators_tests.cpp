@@ -27,6 +27,7 @@
 #include <supla/network/html/button_type_parameters.h>
 #include <supla/network/html/channel_correction.h>
 #include <supla/network/html/channel_function_parameters.h>
+#include <supla/network/html/channel_reporting_policy.h>
 #include <supla/network/html/container_parameters.h>
 #include <supla/network/html/custom_checkbox_parameter.h>
 #include <supla/network/html/custom_parameter.h>
@@ -272,6 +273,74 @@ TEST_F(HtmlCaptureTest, ChannelCorrectionHandleResponseStoresCorrection) {
   EXPECT_TRUE(correction.handleResponse("corr_7_1", "12.3"));
 }
 
+TEST_F(HtmlCaptureTest, ChannelReportingPolicyRendersStoredConfig) {
+  NiceMock<ConfigMock> cfg;
+  SenderMock sender;
+  sendHtml.clear();
+
+  Supla::ReportingPolicyConfig stored;
+  stored.deadbandType = Supla::ReportingDeadbandType::Relative;
+  stored.deadband = 2500;
+  stored.minIntervalMs = 1500;
+  stored.maxIntervalMs = 600000;
+  stored.coalescing = 0;
+  EXPECT_CALL(cfg, getBlob(StrEq("3_rep_pol"), _, sizeof(stored)))
+      .WillOnce([&stored](const char*, char* value, size_t size) {
+        memcpy(value, &stored, size);
+        return true;
+      });
+
+  expectAllSendCalls(sender);
+
+  Supla::Html::ChannelReportingPolicy policy(3, "Boiler");
+  policy.send(&sender);
+
+  EXPECT_THAT(sendHtml, HasSubstr("#3 Boiler reporting deadband"));
+  EXPECT_THAT(sendHtml, HasSubstr("name=\"rpdt_3\""));
+  EXPECT_THAT(sendHtml,
+              HasSubstr("<option value=\"2\" selected>Relative [%]"));
+  EXPECT_THAT(sendHtml, HasSubstr("name=\"rpdb_3\""));
+  EXPECT_THAT(sendHtml, HasSubstr("value=\"2.5\""));
+  EXPECT_THAT(sendHtml, HasSubstr("name=\"rpmin_3\""));
+  EXPECT_THAT(sendHtml, HasSubstr("value=\"1.5\""));
+  EXPECT_THAT(sendHtml, HasSubstr("name=\"rpmax_3\""));
+  EXPECT_THAT(sendHtml, HasSubstr("value=\"600\""));
+  EXPECT_THAT(sendHtml, HasSubstr("<option value=\"0\" selected>Drop"));
+}
+
+TEST_F(HtmlCaptureTest, ChannelReportingPolicyStoresAndAppliesConfig) {
+  NiceMock<ConfigMock> cfg;
+  Supla::Channel::resetToDefaults();
+  Supla::Channel channel;
+  Supla::Html::ChannelReportingPolicy policy(0, "Boiler");
+
+  Supla::ReportingPolicyConfig saved;
+  EXPECT_CALL(cfg, getBlob(StrEq("0_rep_pol"), _, _))
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(cfg, setBlob(StrEq("0_rep_pol"), _, sizeof(saved)))
+      .WillOnce([&saved](const char*, const char* value, size_t size) {
+        memcpy(&saved, value, size);
+        return true;
+      });
+
+  EXPECT_TRUE(policy.handleResponse("rpdt_0", "1"));
+  EXPECT_TRUE(policy.handleResponse("rpdb_0", "0.25"));
+  EXPECT_TRUE(policy.handleResponse("rpmin_0", "2"));
+  EXPECT_TRUE(policy.handleResponse("rpmax_0", "300"));
+  EXPECT_TRUE(policy.handleResponse("rpco_0", "1"));
+  EXPECT_FALSE(policy.handleResponse("rpdb_1", "1"));
+  policy.onProcessingEnd();
+
+  EXPECT_EQ(saved.deadbandType, Supla::ReportingDeadbandType::Absolute);
+  EXPECT_EQ(saved.deadband, 250u);
+  EXPECT_EQ(saved.minIntervalMs, 2000u);
+  EXPECT_EQ(saved.maxIntervalMs, 300000u);
+  EXPECT_EQ(saved.coalescing, 1);
+  ASSERT_NE(channel.getReportingPolicy(), nullptr);
+  EXPECT_EQ(channel.getReportingPolicy()->getConfig(), saved);
+  Supla::Channel::resetToDefaults();
+}
+
 TEST_F(HtmlCaptureTest, CustomParameterTemplateRendersFloatingField) {
   NiceMock<ConfigMock> cfg;
   SenderMock sender;
@@ -0,0 +1,210 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <arduino_mock.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <simple_time.h>
+#include <supla/io/port_snapshot.h>
+#include <supla/mutex.h>
+
+using ::testing::Return;
+
+namespace {
+
+// Emulates I2C bus with one 16 bit expander on it. Each readPort() and
+// writePort() call is one bus transaction.
+class FakeExpanderBus : public Supla::Io::PortSnapshot {
+ public:
+  explicit FakeExpanderBus(Supla::Mutex *mutex = nullptr)
+      : Supla::Io::PortSnapshot(mutex) {
+  }
+
+  uint16_t pins = 0;
+  uint16_t latch = 0;
+  bool connected = true;
+  int transactions = 0;
+
+ protected:
+  bool readPort(uint16_t *value) override {
+    transactions++;
+    if (!connected) {
+      return false;
+    }
+    *value = pins;
+    return true;
+  }
+
+  bool writePort(uint16_t value) override {
+    transactions++;
+    if (!connected) {
+      return false;
+    }
+    latch = value;
+    return true;
+  }
+};
+
+class CountingMutex : public Supla::Mutex {
+ public:
+  void lock() override {
+    locks++;
+  }
+  void unlock() override {
+    unlocks++;
+  }
+
+  int locks = 0;
+  int unlocks = 0;
+};
+
+class PortSnapshotTests : public ::testing::Test {
+ protected:
+  SimpleTime time;
+};
+
+}  // namespace
+
+TEST_F(PortSnapshotTests, PinReadsUseOnePortReadPerTick) {
+  FakeExpanderBus bus;
+  bus.pins = 0b1010000000000101;
+  bus.initSnapshot();
+  EXPECT_EQ(bus.transactions, 1);
+
+  for (int tick = 0; tick < 10; tick++) {
+    bus.tickSnapshot();
+    for (int pin = 0; pin < 16; pin++) {
+      EXPECT_EQ(bus.readBit(pin), ((bus.pins >> pin) & 1) == 1);
+    }
+    time.advance(10);
+  }
+  // 16 pins read 10 times, but only one transaction per tick
+  EXPECT_EQ(bus.transactions, 11);
+  EXPECT_EQ(bus.getReadCount(), 11u);
+  EXPECT_EQ(bus.getWriteCount(), 0u);
+  EXPECT_FALSE(bus.readBit(16));
+}
+
+TEST_F(PortSnapshotTests, ReadOfStaleSnapshotRefreshesPort) {
+  FakeExpanderBus bus;
+  bus.setMaxAgeMs(50);
+  bus.initSnapshot();
+  EXPECT_FALSE(bus.readBit(3));
+
+  bus.pins = 1 << 3;
+  time.advance(50);
+  EXPECT_FALSE(bus.readBit(3));
+  EXPECT_EQ(bus.transactions, 1);
+
+  time.advance(1);
+  EXPECT_TRUE(bus.readBit(3));
+  EXPECT_TRUE(bus.readBit(3));
+  EXPECT_EQ(bus.transactions, 2);
+
+  bus.pins = 0;
+  bus.invalidateSnapshot();
+  EXPECT_FALSE(bus.readBit(3));
+  EXPECT_EQ(bus.transactions, 3);
+}
+
+TEST_F(PortSnapshotTests, WritesAreCoalescedIntoOneTransactionPerTick) {
+  FakeExpanderBus bus;
+  bus.setInterruptPin(5);
+  ::testing::NiceMock<DigitalInterfaceMock> ioMock;
+  EXPECT_CALL(ioMock, digitalRead(5)).WillRepeatedly(Return(HIGH));
+  bus.resetOutputState(0x00FF);
+  bus.initSnapshot();
+  EXPECT_EQ(bus.transactions, 1);
+
+  bus.tickSnapshot();
+  EXPECT_EQ(bus.transactions, 1);
+
+  bus.writeBit(0, false);
+  bus.writeBit(8, true);
+  bus.writeBit(9, true);
+  bus.writeBit(9, false);
+  EXPECT_TRUE(bus.isOutputPending());
+  EXPECT_EQ(bus.latch, 0);
+  bus.tickSnapshot();
+  EXPECT_EQ(bus.latch, 0x01FE);
+  EXPECT_EQ(bus.transactions, 2);
+  EXPECT_FALSE(bus.isOutputPending());
+
+  // value changed back and forth between ticks - nothing to send
+  bus.writeBit(1, false);
+  bus.writeBit(1, true);
+  bus.tickSnapshot();
+  EXPECT_EQ(bus.transactions, 2);
+  EXPECT_EQ(bus.getWriteCount(), 1u);
+}
+
+TEST_F(PortSnapshotTests, PortIsReadOnlyWhenInterruptIsAsserted) {
+  FakeExpanderBus bus;
+  bus.setInterruptPin(4);
+  bus.setMaxAgeMs(1000);
+  ::testing::NiceMock<DigitalInterfaceMock> ioMock;
+  EXPECT_CALL(ioMock, pinMode(4, INPUT_PULLUP)).Times(1);
+  EXPECT_CALL(ioMock, digitalRead(4))
+      .WillOnce(Return(HIGH))
+      .WillOnce(Return(HIGH))
+      .WillOnce(Return(LOW))
+      .WillRepeatedly(Return(HIGH));
+
+  bus.initSnapshot();
+  bus.pins = 1 << 7;
+  for (int tick = 0; tick < 2; tick++) {
+    bus.tickSnapshot();
+    EXPECT_FALSE(bus.readBit(7));
+    time.advance(10);
+  }
+  EXPECT_EQ(bus.transactions, 1);
+
+  bus.tickSnapshot();
+  EXPECT_TRUE(bus.readBit(7));
+  EXPECT_EQ(bus.transactions, 2);
+
+  for (int tick = 0; tick < 10; tick++) {
+    bus.tickSnapshot();
+    time.advance(10);
+  }
+  EXPECT_EQ(bus.transactions, 2);
+}
+
+TEST_F(PortSnapshotTests, FailedTransactionsKeepLastState) {
+  FakeExpanderBus bus;
+  bus.setMaxAgeMs(20);
+  bus.pins = 1;
+  bus.initSnapshot();
+  bus.connected = false;
+  bus.pins = 0;
+
+  time.advance(30);
+  EXPECT_FALSE(bus.refreshSnapshot());
+  // missing chip isn't queried again on each pin read
+  EXPECT_TRUE(bus.readBit(0));
+  EXPECT_TRUE(bus.readBit(0));
+  EXPECT_EQ(bus.transactions, 2);
+
+  bus.writeBit(2, true);
+  bus.tickSnapshot();
+  EXPECT_TRUE(bus.isOutputPending());
+
+  // pending output is sent after bus recovers
+  bus.connected = true;
+  bus.tickSnapshot();
+  EXPECT_FALSE(bus.isOutputPending());
+  EXPECT_EQ(bus.latch, 1 << 2);
+  EXPECT_FALSE(bus.readBit(0));
+}
+
+TEST_F(PortSnapshotTests, MutexIsLockedForEachTransaction) {
+  CountingMutex mutex;
+  FakeExpanderBus bus(&mutex);
+  bus.initSnapshot();
+  bus.writeBit(0, true);
+  bus.tickSnapshot();
+  bus.readBit(0);
+  EXPECT_EQ(bus.transactions, 3);
+  EXPECT_EQ(mutex.locks, 3);
+  EXPECT_EQ(mutex.unlocks, 3);
+}
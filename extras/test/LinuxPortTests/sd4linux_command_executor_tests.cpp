@@ -0,0 +1,281 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <simple_time.h>
+#include <supla/command_executor.h>
+#include <supla/output/cmd.h>
+#include <supla/parser/json.h>
+#include <supla/source/cmd.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <filesystem>  // NOLINT(build/c++17)
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+extern "C" const char *supla_test_get_last_log();
+extern "C" void supla_test_clear_last_log();
+
+using Supla::Linux::CommandExecutor;
+using Supla::Linux::CommandResult;
+
+namespace {
+
+class Sd4linuxCommandExecutorTests : public ::testing::Test {
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  void SetUp() override {
+    std::string directoryTemplate =
+        (std::filesystem::temp_directory_path() /
+         ("supla_cmd_executor_tests_" + std::to_string(getpid()) + "_XXXXXX"))
+            .string();
+    std::vector<char> writableDirectory(directoryTemplate.begin(),
+                                        directoryTemplate.end());
+    writableDirectory.push_back('\0');
+    ASSERT_NE(mkdtemp(writableDirectory.data()), nullptr);
+    tempDirectory = writableDirectory.data();
+  }
+
+  void TearDown() override {
+    std::error_code error;
+    std::filesystem::remove_all(tempDirectory, error);
+  }
+
+  std::string filePath(std::string_view name) const {
+    return (tempDirectory / std::string(name)).string();
+  }
+
+  static std::string readFile(const std::string &path) {
+    std::ifstream input(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input),
+            std::istreambuf_iterator<char>()};
+  }
+
+  static std::vector<std::string> shell(const std::string &command) {
+    return {"/bin/sh", "-c", command};
+  }
+
+  static int64_t elapsedMs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                                 start)
+        .count();
+  }
+
+  std::filesystem::path tempDirectory;
+};
+
+}  // namespace
+
+TEST_F(Sd4linuxCommandExecutorTests, SlowCommandDoesntBlockCaller) {
+  CommandExecutor executor;
+  std::vector<CommandResult> results;
+  const int owner = 0;
+
+  auto start = Clock::now();
+  executor.submit(&owner,
+                  shell("sleep 0.5; echo done; exit 3"),
+                  [&](const CommandResult &result) {
+                    results.push_back(result);
+                  },
+                  true);
+  for (int i = 0; i < 10; i++) {
+    executor.iterateAlways();
+  }
+  EXPECT_LT(elapsedMs(start), 200);
+  EXPECT_EQ(executor.getRunningCount(), 1u);
+  EXPECT_TRUE(results.empty());
+
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_GE(elapsedMs(start), 500);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, CommandResult::Status::Finished);
+  EXPECT_EQ(results[0].exitCode, 3);
+  EXPECT_EQ(results[0].output, "done\n");
+  EXPECT_FALSE(results[0].isSuccess());
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, TimeoutKillsWholeCommand) {
+  CommandExecutor executor;
+  std::vector<CommandResult> results;
+  const int owner = 0;
+  const auto markerPath = filePath("marker");
+
+  auto start = Clock::now();
+  // subshell keeps the output pipe open, so it has to be killed as well
+  executor.submit(&owner,
+                  shell("echo started; (sleep 1; touch " + markerPath +
+                        ") ; echo finished"),
+                  [&](const CommandResult &result) {
+                    results.push_back(result);
+                  },
+                  true,
+                  200);
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_LT(elapsedMs(start), 1500);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].status, CommandResult::Status::Timeout);
+  EXPECT_EQ(results[0].output, "started\n");
+
+  usleep(1300 * 1000);
+  EXPECT_FALSE(std::filesystem::exists(markerPath));
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, LatestCommandOfOwnerWins) {
+  CommandExecutor executor;
+  const int owner = 0;
+  const auto outputPath = filePath("toggles.txt");
+  int callbacks = 0;
+  auto callback = [&](const CommandResult &result) {
+    EXPECT_TRUE(result.isSuccess());
+    callbacks++;
+  };
+
+  executor.submit(
+      &owner, shell("sleep 0.3; echo 1 >> " + outputPath), callback);
+  for (int i = 2; i <= 5; i++) {
+    executor.submit(&owner,
+                    shell("echo " + std::to_string(i) + " >> " + outputPath),
+                    callback);
+  }
+  EXPECT_EQ(executor.getRunningCount(), 1u);
+  EXPECT_EQ(executor.getQueuedCount(), 1u);
+  EXPECT_EQ(executor.getSupersededCount(), 3u);
+
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_EQ(readFile(outputPath), "1\n5\n");
+  EXPECT_EQ(callbacks, 2);
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, RunningCommandsAreBounded) {
+  CommandExecutor executor(2);
+  const int owners[4] = {};
+  int finished = 0;
+
+  auto start = Clock::now();
+  for (auto &owner : owners) {
+    executor.submit(&owner, shell("sleep 0.3"), [&](const CommandResult &) {
+      finished++;
+    });
+  }
+  EXPECT_EQ(executor.getRunningCount(), 2u);
+  EXPECT_EQ(executor.getQueuedCount(), 2u);
+
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_EQ(finished, 4);
+  // two batches
+  EXPECT_GE(elapsedMs(start), 600);
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, CancelledOwnerGetsNoCallback) {
+  CommandExecutor executor;
+  const int owner = 0;
+  int callbacks = 0;
+  executor.submit(&owner, shell("sleep 0.2"), [&](const CommandResult &) {
+    callbacks++;
+  });
+  executor.submit(&owner, shell("true"), [&](const CommandResult &) {
+    callbacks++;
+  });
+  executor.cancel(&owner);
+  EXPECT_EQ(executor.getQueuedCount(), 0u);
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_EQ(callbacks, 0);
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, MissingProgramIsReported) {
+  CommandExecutor executor;
+  const int owner = 0;
+  std::vector<CommandResult> results;
+  executor.submit(&owner,
+                  {filePath("missing-program")},
+                  [&](const CommandResult &result) {
+                    results.push_back(result);
+                  });
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_FALSE(results[0].isSuccess());
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, CmdOutputWithExecutorDoesntWait) {
+  CommandExecutor executor;
+  const auto outputPath = filePath("relay.txt");
+  Supla::Output::Cmd cmd("sleep 0.3; printf '%s\\n' {} >> " + outputPath);
+  cmd.setExecutor(&executor);
+  Supla::Output::Output &output = cmd;
+
+  auto start = Clock::now();
+  EXPECT_TRUE(output.putContent(true));
+  EXPECT_TRUE(output.putContent(false));
+  EXPECT_TRUE(output.putContent(true));
+  EXPECT_TRUE(output.putContent(false));
+  EXPECT_LT(elapsedMs(start), 200);
+
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  // stale toggles were dropped
+  EXPECT_EQ(readFile(outputPath), "true\nfalse\n");
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, CmdOutputFailureIsLogged) {
+  CommandExecutor executor;
+  Supla::Output::Cmd cmd("exit 3; echo");
+  cmd.setExecutor(&executor);
+  Supla::Output::Output &output = cmd;
+
+  supla_test_clear_last_log();
+  EXPECT_TRUE(output.putContent(1));
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_NE(std::string(supla_test_get_last_log())
+                .find("Output::Cmd: command failed (3)"),
+            std::string::npos);
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, CmdSourceOutputIsParsedWhenRunEnds) {
+  SimpleTime time;
+  time.advance(1);
+  CommandExecutor executor;
+  const auto counterPath = filePath("counter");
+  Supla::Source::Cmd source(("sleep 0.2; echo x >> " + counterPath +
+                             "; printf '{\"v\":%d}' $(wc -l < " +
+                             counterPath + ")")
+                                .c_str());
+  source.setExecutor(&executor);
+  Supla::Parser::Json parser(&source);
+  parser.setRefreshTime(10000);
+
+  // first refresh only starts the command
+  auto start = Clock::now();
+  EXPECT_TRUE(parser.refreshParserSource());
+  EXPECT_LT(elapsedMs(start), 150);
+  EXPECT_EQ(source.getContent(), "");
+  EXPECT_EQ(source.getContentVersion(), 0u);
+
+  // output is parsed on the next iteration after the command ends, without
+  // waiting for the next refresh period
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_EQ(source.getContentVersion(), 1u);
+  EXPECT_TRUE(parser.refreshParserSource());
+  EXPECT_TRUE(parser.isValid());
+  EXPECT_EQ(parser.getValue("v"), 1);
+
+  // command is not started again before refresh period ends
+  EXPECT_TRUE(parser.refreshParserSource());
+  EXPECT_TRUE(executor.isIdle());
+
+  time.advance(10001);
+  EXPECT_TRUE(parser.refreshParserSource());
+  EXPECT_FALSE(executor.isIdle());
+  EXPECT_EQ(parser.getValue("v"), 1);
+  ASSERT_TRUE(executor.waitForIdle(5000));
+  EXPECT_TRUE(parser.refreshParserSource());
+  EXPECT_EQ(parser.getValue("v"), 2);
+}
+
+TEST_F(Sd4linuxCommandExecutorTests, CmdSourceWithoutExecutorIsSynchronous) {
+  Supla::Source::Cmd source("echo sync");
+  EXPECT_EQ(source.getContent(), "sync\n");
+}
@@ -0,0 +1,250 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <supla/source/coprocess.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>  // NOLINT(build/c++11)
+#include <filesystem>  // NOLINT(build/c++17)
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using Supla::Source::CoProcess;
+
+namespace {
+
+class Sd4linuxCoProcessTests : public ::testing::Test {
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  void SetUp() override {
+    std::string directoryTemplate =
+        (std::filesystem::temp_directory_path() /
+         ("supla_coprocess_tests_" + std::to_string(getpid()) + "_XXXXXX"))
+            .string();
+    std::vector<char> writableDirectory(directoryTemplate.begin(),
+                                        directoryTemplate.end());
+    writableDirectory.push_back('\0');
+    ASSERT_NE(mkdtemp(writableDirectory.data()), nullptr);
+    tempDirectory = writableDirectory.data();
+  }
+
+  void TearDown() override {
+    std::error_code error;
+    std::filesystem::remove_all(tempDirectory, error);
+  }
+
+  std::string filePath(std::string_view name) const {
+    return (tempDirectory / std::string(name)).string();
+  }
+
+  static std::string readFile(const std::string &path) {
+    std::ifstream input(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input),
+            std::istreambuf_iterator<char>()};
+  }
+
+  // Polls source until condition is met. Returns false on timeout.
+  static bool pollUntil(CoProcess *source,
+                        const std::function<bool()> &condition,
+                        int timeoutMs = 3000) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (Clock::now() < deadline) {
+      source->poll();
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+  }
+
+  static void pollFor(CoProcess *source, int timeMs) {
+    pollUntil(source, []() { return false; }, timeMs);
+  }
+
+  std::filesystem::path tempDirectory;
+};
+
+}  // namespace
+
+TEST_F(Sd4linuxCoProcessTests, LinesFormatReturnsLatestLine) {
+  CoProcess source("printf 'first\\r\\n\\nsecond\\n'; sleep 10");
+  EXPECT_FALSE(source.isConnected());
+  EXPECT_EQ(source.getContent(), "");
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "second";
+  }));
+  EXPECT_TRUE(source.isRunning());
+  EXPECT_TRUE(source.isConnected());
+  EXPECT_EQ(source.getRestartCount(), 0u);
+}
+
+TEST_F(Sd4linuxCoProcessTests, ProcessIsStartedOnceAndReadIncrementally) {
+  const auto startsPath = filePath("starts");
+  CoProcess source("echo started >> " + startsPath +
+                   "; i=0; while true; do i=$((i+1)); echo $i; sleep 0.02;"
+                   " done");
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "2";
+  }));
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "10";
+  }));
+  EXPECT_EQ(readFile(startsPath), "started\n");
+  EXPECT_EQ(source.getRestartCount(), 0u);
+}
+
+TEST_F(Sd4linuxCoProcessTests, JsonRecordsAreKeptPerKey) {
+  const auto outputPath = filePath("output.json");
+  std::ofstream(outputPath)
+      << "noise {\"id\": 1, \"t\": 20.5,\n"
+         "  \"name\": \"a}{\\\"\", \"n\": {\"x\": [1, {}]}}\n"
+         "{\"id\": 2, \"t\": 10}\ngarbage\n{\"t\": 5}\n"
+         "{\"id\": 1, \"t\": 21.5} {\"id\": \"x\", \"t\": 1}\n";
+  CoProcess source("cat " + outputPath + "; sleep 10",
+                   CoProcess::Format::Json);
+  source.setKey("id");
+
+  nlohmann::json content;
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    content = nlohmann::json::parse(source.getContent(), nullptr, false);
+    return content.is_object() && content.contains("x");
+  }));
+  EXPECT_EQ(content.size(), 3u);
+  EXPECT_DOUBLE_EQ(content["/1/t"_json_pointer].get<double>(), 21.5);
+  EXPECT_FALSE(content["/1"_json_pointer].contains("name"));
+  EXPECT_EQ(content["/2/t"_json_pointer].get<int>(), 10);
+  EXPECT_EQ(content["/x/t"_json_pointer].get<int>(), 1);
+  // record without key
+  EXPECT_EQ(source.getDroppedRecordCount(), 1u);
+}
+
+TEST_F(Sd4linuxCoProcessTests, MalformedKeyPointerIsRejected) {
+  CoProcess source(
+      "printf '{\"dev\": {\"id\": 7}, \"t\": 3}\\n{\"t\": 4}\\n';"
+      " sleep 10",
+      CoProcess::Format::Json);
+  EXPECT_FALSE(source.setKey("/a~2"));
+  EXPECT_FALSE(source.setKey("/a~"));
+  EXPECT_TRUE(source.setKey("/dev/id"));
+  // previous valid key is kept
+  EXPECT_FALSE(source.setKey("/dev~3"));
+
+  nlohmann::json content;
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    content = nlohmann::json::parse(source.getContent(), nullptr, false);
+    return content.is_object() && content.contains("7");
+  }));
+  EXPECT_EQ(content["/7/t"_json_pointer].get<int>(), 3);
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getDroppedRecordCount() == 1;
+  }));
+}
+
+TEST_F(Sd4linuxCoProcessTests, JsonWithoutKeyReturnsLatestRecord) {
+  CoProcess source("printf '{\"a\":\\n 1}\\n{\"a\":\\n 2}\\n'; sleep 10",
+                   CoProcess::Format::Json);
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "{\"a\":\n 2}";
+  }));
+}
+
+TEST_F(Sd4linuxCoProcessTests, OversizedRecordsAreDropped) {
+  CoProcess lines("echo short; echo 0123456789abcdefXYZ; echo last; sleep 10");
+  lines.setMaxRecordSize(16);
+  ASSERT_TRUE(pollUntil(&lines, [&]() {
+    return lines.getContent() == "last";
+  }));
+  EXPECT_EQ(lines.getDroppedRecordCount(), 1u);
+
+  CoProcess json(
+      "echo '{\"a\": \"0123456789abcdef\"}{\"a\": 1}'; sleep 10",
+      CoProcess::Format::Json);
+  json.setMaxRecordSize(16);
+  ASSERT_TRUE(pollUntil(&json, [&]() {
+    return json.getContent() == "{\"a\": 1}";
+  }));
+  EXPECT_EQ(json.getDroppedRecordCount(), 1u);
+}
+
+TEST_F(Sd4linuxCoProcessTests, ExitedProcessIsRestartedWithBackoff) {
+  const auto startsPath = filePath("starts");
+  CoProcess source("echo started >> " + startsPath + "; exit 1");
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return readFile(startsPath) == "started\n" && !source.isRunning();
+  }));
+  EXPECT_EQ(source.getRestartDelayMs(), 2000u);
+
+  // first restart after 1 s
+  pollFor(&source, 700);
+  EXPECT_EQ(readFile(startsPath), "started\n");
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return readFile(startsPath) == "started\nstarted\n" &&
+           !source.isRunning();
+  }));
+  EXPECT_EQ(source.getRestartCount(), 1u);
+  // second restart after 2 s
+  EXPECT_EQ(source.getRestartDelayMs(), 4000u);
+  pollFor(&source, 1500);
+  EXPECT_EQ(source.getRestartCount(), 1u);
+}
+
+TEST_F(Sd4linuxCoProcessTests, ReceivedRecordResetsBackoff) {
+  CoProcess source("echo value; exit 1");
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "value" && !source.isRunning();
+  }));
+  // reset to 1 s by the record and doubled for the next restart
+  EXPECT_EQ(source.getRestartDelayMs(), 2000u);
+  // last record is still available while process is restarted
+  EXPECT_TRUE(source.isConnected());
+}
+
+TEST_F(Sd4linuxCoProcessTests, OldRecordsExpire) {
+  CoProcess source("echo value; sleep 10");
+  source.setExpirationTime(1);
+
+  ASSERT_TRUE(pollUntil(&source, [&]() {
+    return source.getContent() == "value";
+  }));
+  EXPECT_TRUE(source.isConnected());
+  pollFor(&source, 1100);
+  EXPECT_FALSE(source.isConnected());
+  EXPECT_EQ(source.getContent(), "");
+}
+
+TEST_F(Sd4linuxCoProcessTests, DestructorStopsWholeProcessGroup) {
+  const auto pidPath = filePath("pid");
+  pid_t pid = -1;
+  {
+    CoProcess source("echo $$ > " + pidPath +
+                     "; while true; do sleep 1; done");
+    ASSERT_TRUE(pollUntil(&source, [&]() {
+      return !readFile(pidPath).empty();
+    }));
+    pid = std::stoi(readFile(pidPath));
+    EXPECT_EQ(kill(-pid, 0), 0);
+  }
+  // shell is reaped and its children are killed
+  auto deadline = Clock::now() + std::chrono::seconds(2);
+  while (kill(-pid, 0) == 0 && Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(kill(-pid, 0), -1);
+  EXPECT_EQ(errno, ESRCH);
+}
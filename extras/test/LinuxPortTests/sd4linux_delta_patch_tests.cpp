@@ -0,0 +1,229 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include <delta_patch_generator.h>
+#include <supla/device/delta_patch.h>
+#include <supla/sha256.h>
+
+namespace {
+
+class StringSource : public Supla::Device::DeltaPatchSource {
+ public:
+  explicit StringSource(const std::string &data) : data(data) {
+  }
+
+  bool readSourceImage(uint32_t offset, uint8_t *buf, int size) override {
+    maxReadSize = std::max(maxReadSize, size);
+    if (offset + size > data.size()) {
+      return false;
+    }
+    memcpy(buf, data.data() + offset, size);
+    return true;
+  }
+
+  std::string data;
+  int maxReadSize = 0;
+};
+
+class StringOutput : public Supla::Device::DeltaPatchOutput {
+ public:
+  bool writeTargetImage(const uint8_t *buf, int size) override {
+    data.append(reinterpret_cast<const char *>(buf), size);
+    return true;
+  }
+
+  std::string data;
+};
+
+std::string sha256(const std::string &data) {
+  Supla::Sha256 hash;
+  hash.update(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+  std::string digest(32, '\0');
+  hash.digest(reinterpret_cast<uint8_t *>(&digest[0]));
+  return digest;
+}
+
+const uint8_t *asBytes(const std::string &data) {
+  return reinterpret_cast<const uint8_t *>(data.data());
+}
+
+std::string makeData(int size, int seed) {
+  std::string data;
+  uint32_t value = seed;
+  for (int i = 0; i < size; i++) {
+    value = value * 1103515245 + 12345;
+    data.push_back(static_cast<char>(value >> 16));
+  }
+  return data;
+}
+
+std::string makePatch(const std::string &source, const std::string &target) {
+  return Supla::DeltaPatchGenerator::Generate(
+      source, target, asBytes(sha256(source)));
+}
+
+// Applies patch passed in chunks of chunkSize bytes
+bool apply(const std::string &source,
+           const std::string &patch,
+           int chunkSize,
+           std::string *result,
+           const char **error = nullptr) {
+  StringSource in(source);
+  StringOutput out;
+  std::string digest = sha256(source);
+  Supla::Device::DeltaPatch deltaPatch(
+      &in, &out, source.size(), asBytes(digest));
+  for (size_t pos = 0; pos < patch.size(); pos += chunkSize) {
+    int size = std::min<size_t>(chunkSize, patch.size() - pos);
+    if (!deltaPatch.feed(asBytes(patch) + pos, size)) {
+      break;
+    }
+  }
+  EXPECT_LE(in.maxReadSize, SUPLA_DELTA_PATCH_COPY_BUFFER_SIZE);
+  if (error) {
+    *error = deltaPatch.getError();
+  }
+  *result = out.data;
+  if (deltaPatch.isComplete()) {
+    EXPECT_EQ(deltaPatch.getWrittenBytes(), deltaPatch.getTargetSize());
+  }
+  return deltaPatch.isComplete() && !deltaPatch.hasError();
+}
+
+void appendUint32(std::string *out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+std::string makeHeader(const std::string &source, uint32_t targetSize) {
+  std::string header("SUPLADP1");
+  appendUint32(&header, source.size());
+  appendUint32(&header, targetSize);
+  return header + sha256(source);
+}
+
+}  // namespace
+
+TEST(DeltaPatchTests, ModifiedImageRoundTrip) {
+  std::string source = makeData(200000, 1);
+  std::string target = source;
+  target[5] ^= 0xFF;
+  target.insert(70000, makeData(1000, 2));
+  target.erase(120000, 5000);
+  // block moved to other place
+  target.append(source.substr(1000, 20000));
+  target += "end";
+
+  std::string patch = makePatch(source, target);
+  EXPECT_LT(patch.size(), 1200u);
+
+  for (int chunkSize : {1, 7, 100, 4096, static_cast<int>(patch.size())}) {
+    std::string result;
+    EXPECT_TRUE(apply(source, patch, chunkSize, &result)) << chunkSize;
+    EXPECT_TRUE(result == target) << chunkSize;
+  }
+}
+
+TEST(DeltaPatchTests, IdenticalImagesAreSingleCopy) {
+  std::string source = makeData(50000, 3);
+  std::string patch = makePatch(source, source);
+  // header, single COPY and END
+  EXPECT_EQ(patch.size(), Supla::Device::DeltaPatch::HeaderSize + 9u + 1u);
+
+  std::string result;
+  EXPECT_TRUE(apply(source, patch, 64, &result));
+  EXPECT_TRUE(result == source);
+}
+
+TEST(DeltaPatchTests, UnrelatedImagesAreInserted) {
+  std::string source = makeData(10000, 4);
+  std::string target = makeData(12345, 5);
+  std::string patch = makePatch(source, target);
+  // header, single INSERT with data and END
+  EXPECT_EQ(patch.size(),
+            Supla::Device::DeltaPatch::HeaderSize + 5u + target.size() + 1u);
+
+  std::string result;
+  EXPECT_TRUE(apply(source, patch, 333, &result));
+  EXPECT_TRUE(result == target);
+}
+
+TEST(DeltaPatchTests, PatchForOtherSourceIsRejected) {
+  std::string source = makeData(10000, 6);
+  std::string target = source + "new";
+  std::string patch = makePatch(source, target);
+  std::string otherSource = source;
+  otherSource[100] ^= 1;
+
+  std::string result;
+  const char *error = nullptr;
+  EXPECT_FALSE(apply(otherSource, patch, 10, &result, &error));
+  EXPECT_STREQ(error, "patch doesn't match current image");
+  EXPECT_TRUE(result.empty());
+
+  patch[0] = 'X';
+  EXPECT_FALSE(apply(source, patch, 10, &result, &error));
+  EXPECT_STREQ(error, "invalid header");
+}
+
+TEST(DeltaPatchTests, TruncatedPatchIsNotComplete) {
+  std::string source = makeData(10000, 7);
+  std::string target = makeData(100, 8) + source;
+  std::string patch = makePatch(source, target);
+  patch.pop_back();
+
+  std::string result;
+  const char *error = nullptr;
+  EXPECT_FALSE(apply(source, patch, 16, &result, &error));
+  EXPECT_EQ(error, nullptr);
+  EXPECT_TRUE(result == target);
+}
+
+TEST(DeltaPatchTests, InvalidOperationsAreRejected) {
+  std::string source = makeData(1000, 9);
+  std::string result;
+  const char *error = nullptr;
+
+  std::string copyOutside = makeHeader(source, 100);
+  copyOutside.push_back(Supla::Device::DeltaPatch::OpCopy);
+  appendUint32(&copyOutside, 950);
+  appendUint32(&copyOutside, 100);
+  EXPECT_FALSE(apply(source, copyOutside, 3, &result, &error));
+  EXPECT_STREQ(error, "copy outside of source image");
+
+  std::string insertTooLong = makeHeader(source, 10);
+  insertTooLong.push_back(Supla::Device::DeltaPatch::OpInsert);
+  appendUint32(&insertTooLong, 11);
+  insertTooLong += std::string(11, 'x');
+  EXPECT_FALSE(apply(source, insertTooLong, 3, &result, &error));
+  EXPECT_STREQ(error, "insert exceeds target image");
+
+  std::string endTooEarly = makeHeader(source, 10);
+  endTooEarly.push_back(Supla::Device::DeltaPatch::OpCopy);
+  appendUint32(&endTooEarly, 0);
+  appendUint32(&endTooEarly, 5);
+  endTooEarly.push_back(Supla::Device::DeltaPatch::OpEnd);
+  EXPECT_FALSE(apply(source, endTooEarly, 3, &result, &error));
+  EXPECT_STREQ(error, "patch ended before end of target image");
+
+  std::string dataAfterEnd = makeHeader(source, 5);
+  dataAfterEnd.push_back(Supla::Device::DeltaPatch::OpCopy);
+  appendUint32(&dataAfterEnd, 0);
+  appendUint32(&dataAfterEnd, 5);
+  dataAfterEnd.push_back(Supla::Device::DeltaPatch::OpEnd);
+  dataAfterEnd.push_back(Supla::Device::DeltaPatch::OpEnd);
+  EXPECT_FALSE(apply(source, dataAfterEnd, 100, &result, &error));
+  EXPECT_STREQ(error, "unexpected data after end of patch");
+
+  std::string unknownOperation = makeHeader(source, 5);
+  unknownOperation.push_back(0x7F);
+  EXPECT_FALSE(apply(source, unknownOperation, 100, &result, &error));
+  EXPECT_STREQ(error, "invalid operation");
+}
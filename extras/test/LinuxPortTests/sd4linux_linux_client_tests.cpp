@@ -0,0 +1,349 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <linux_client.h>
+
+namespace {
+
+// Accepts connections on 127.0.0.1, sends "hello" to each client and waits
+// until client closes connection (or closes it on its own when closeAfterHello
+// is set).
+class TestServer {
+ public:
+  explicit TestServer(bool tls, bool closeAfterHello = false)
+      : tls(tls), closeAfterHello(closeAfterHello) {
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(listenFd, 4);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+    port = ntohs(addr.sin_port);
+
+    if (tls) {
+      setupTls();
+    }
+    thread = std::thread([this]() { run(); });
+  }
+
+  ~TestServer() {
+    stopping = true;
+    ::shutdown(listenFd, SHUT_RDWR);
+    ::close(listenFd);
+    thread.join();
+    SSL_CTX_free(ctx);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+  }
+
+  uint16_t port = 0;
+
+ private:
+  void setupTls() {
+    key = EVP_EC_gen("P-256");
+    cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>(
+                                   "localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(ctx, cert);
+    SSL_CTX_use_PrivateKey(ctx, key);
+  }
+
+  void run() {
+    while (!stopping) {
+      int fd = ::accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      SSL *ssl = nullptr;
+      if (tls) {
+        ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) == 1) {
+          SSL_write(ssl, "hello", 5);
+        }
+      } else {
+        ::write(fd, "hello", 5);
+      }
+      char buf[16];
+      while (!closeAfterHello && (ssl ? SSL_read(ssl, buf, sizeof(buf)) > 0
+                                      : ::read(fd, buf, sizeof(buf)) > 0)) {
+      }
+      SSL_free(ssl);
+      ::close(fd);
+    }
+  }
+
+  bool tls = false;
+  bool closeAfterHello = false;
+  int listenFd = -1;
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+  SSL_CTX *ctx = nullptr;
+  X509 *cert = nullptr;
+  EVP_PKEY *key = nullptr;
+};
+
+std::string readHello(Supla::LinuxClient *client) {
+  std::string result;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (result.size() < 5 && std::chrono::steady_clock::now() < deadline) {
+    char buf[16] = {};
+    int size = client->read(buf, sizeof(buf));
+    if (size > 0) {
+      result.append(buf, size);
+    } else if (size == 0) {
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  return result;
+}
+
+bool waitForConnection(Supla::LinuxClient *client) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (client->isConnecting() &&
+         std::chrono::steady_clock::now() < deadline) {
+    client->connected();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return !client->isConnecting() && client->connected();
+}
+
+class LinuxClientTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::LinuxClient::ClearTlsSessionCache();
+    Supla::LinuxClient::SetNonBlockingConnect(false);
+  }
+
+  void TearDown() override {
+    Supla::LinuxClient::SetNonBlockingConnect(false);
+    Supla::LinuxClient::ClearTlsSessionCache();
+  }
+};
+
+}  // namespace
+
+TEST_F(LinuxClientTests, TlsSessionIsResumedOnReconnect) {
+  TestServer server(true);
+  Supla::LinuxClient client;
+  client.setSSLEnabled(true);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  EXPECT_FALSE(client.isConnecting());
+  // reading processes session tickets sent after handshake
+  EXPECT_EQ(readHello(&client), "hello");
+  client.stop();
+
+  auto stats = Supla::LinuxClient::GetTlsStats();
+  EXPECT_EQ(stats.handshakes, 1);
+  EXPECT_EQ(stats.resumed, 0);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  EXPECT_EQ(readHello(&client), "hello");
+  client.stop();
+
+  stats = Supla::LinuxClient::GetTlsStats();
+  EXPECT_EQ(stats.handshakes, 2);
+  EXPECT_EQ(stats.resumed, 1);
+  EXPECT_GE(stats.maxHandshakeMs, stats.lastHandshakeMs);
+  EXPECT_GE(stats.totalHandshakeMs, stats.maxHandshakeMs);
+
+  // session cache is shared between client instances
+  Supla::LinuxClient otherClient;
+  otherClient.setSSLEnabled(true);
+  ASSERT_EQ(otherClient.connect("localhost", server.port), 1);
+  EXPECT_EQ(readHello(&otherClient), "hello");
+  otherClient.stop();
+  EXPECT_EQ(Supla::LinuxClient::GetTlsStats().resumed, 2);
+}
+
+TEST_F(LinuxClientTests, ClearedCacheForcesFullHandshake) {
+  TestServer server(true);
+  Supla::LinuxClient client;
+  client.setSSLEnabled(true);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  EXPECT_EQ(readHello(&client), "hello");
+  client.stop();
+
+  Supla::LinuxClient::ClearTlsSessionCache();
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  EXPECT_EQ(readHello(&client), "hello");
+  client.stop();
+
+  auto stats = Supla::LinuxClient::GetTlsStats();
+  EXPECT_EQ(stats.handshakes, 1);
+  EXPECT_EQ(stats.resumed, 0);
+}
+
+TEST_F(LinuxClientTests, NonBlockingTlsConnect) {
+  TestServer server(true);
+  Supla::LinuxClient::SetNonBlockingConnect(true);
+  Supla::LinuxClient client;
+  client.setSSLEnabled(true);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  uint8_t buf[8] = {};
+  if (client.isConnecting()) {
+    EXPECT_EQ(client.available(), 0);
+    EXPECT_EQ(client.read(buf, sizeof(buf)), -1);
+  }
+  ASSERT_TRUE(waitForConnection(&client));
+  EXPECT_NE(client.getSrcConnectionIPAddress(), 0);
+  EXPECT_EQ(readHello(&client), "hello");
+  EXPECT_EQ(client.write("ping", 4), 4);
+  client.stop();
+  EXPECT_FALSE(client.isConnecting());
+  EXPECT_EQ(Supla::LinuxClient::GetTlsStats().handshakes, 1);
+}
+
+TEST_F(LinuxClientTests, NonBlockingPlainConnect) {
+  TestServer server(false);
+  Supla::LinuxClient::SetNonBlockingConnect(true);
+  Supla::LinuxClient client;
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  ASSERT_TRUE(waitForConnection(&client));
+  EXPECT_EQ(readHello(&client), "hello");
+  client.stop();
+  EXPECT_EQ(Supla::LinuxClient::GetTlsStats().handshakes, 0);
+}
+
+TEST_F(LinuxClientTests, NonBlockingConnectToClosedPortFails) {
+  uint16_t port = 0;
+  {
+    TestServer server(false);
+    port = server.port;
+  }
+  Supla::LinuxClient::SetNonBlockingConnect(true);
+  Supla::LinuxClient client;
+
+  if (client.connect("localhost", port) == 1) {
+    EXPECT_FALSE(waitForConnection(&client));
+  }
+  EXPECT_FALSE(client.isConnecting());
+  EXPECT_FALSE(client.connected());
+}
+
+TEST_F(LinuxClientTests, BlockingConnectToClosedPortFails) {
+  uint16_t port = 0;
+  {
+    TestServer server(false);
+    port = server.port;
+  }
+  Supla::LinuxClient client;
+  client.setSSLEnabled(true);
+
+  EXPECT_EQ(client.connect("localhost", port), 0);
+  EXPECT_FALSE(client.isConnecting());
+  EXPECT_FALSE(client.connected());
+}
+
+TEST_F(LinuxClientTests, ConnectedUsesCachedStateBetweenProbes) {
+  TestServer server(false);
+  Supla::LinuxClient client;
+  client.setLivenessProbeIntervalMs(60000);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  client.resetSyscallStats();
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(client.connected());
+  }
+  EXPECT_EQ(client.getSyscallStats().peeks, 0);
+
+  EXPECT_EQ(readHello(&client), "hello");
+  EXPECT_EQ(client.write("ping", 4), 4);
+  auto stats = client.getSyscallStats();
+  EXPECT_GE(stats.reads, 1);
+  EXPECT_EQ(stats.writes, 1);
+  EXPECT_EQ(stats.peeks, 0);
+
+  // without probe interval each call checks the socket
+  client.setLivenessProbeIntervalMs(0);
+  client.resetSyscallStats();
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(client.connected());
+  }
+  EXPECT_EQ(client.getSyscallStats().peeks, 10);
+  client.stop();
+  EXPECT_FALSE(client.connected());
+}
+
+TEST_F(LinuxClientTests, ClosedByPeerIsDetectedByProbe) {
+  TestServer server(false, true);
+  Supla::LinuxClient client;
+  client.setLivenessProbeIntervalMs(20);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  EXPECT_EQ(readHello(&client), "hello");
+  client.resetSyscallStats();
+
+  int calls = 0;
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (client.connected() && std::chrono::steady_clock::now() < deadline) {
+    calls++;
+  }
+  EXPECT_FALSE(client.connected());
+  auto stats = client.getSyscallStats();
+  EXPECT_GE(stats.peeks, 1);
+  EXPECT_LT(stats.peeks, calls);
+  // closed state is cached
+  for (int i = 0; i < 10; i++) {
+    EXPECT_FALSE(client.connected());
+  }
+  EXPECT_EQ(client.getSyscallStats().peeks, stats.peeks);
+  EXPECT_EQ(client.read(reinterpret_cast<uint8_t *>(&calls), 1), 0);
+}
+
+TEST_F(LinuxClientTests, TlsSyscallsAreCounted) {
+  TestServer server(true);
+  Supla::LinuxClient client;
+  client.setSSLEnabled(true);
+
+  ASSERT_EQ(client.connect("localhost", server.port), 1);
+  auto stats = client.getSyscallStats();
+  EXPECT_GT(stats.reads, 0);
+  EXPECT_GT(stats.writes, 0);
+
+  client.resetSyscallStats();
+  EXPECT_EQ(readHello(&client), "hello");
+  EXPECT_EQ(client.write("ping", 4), 4);
+  stats = client.getSyscallStats();
+  EXPECT_GE(stats.reads, 1);
+  EXPECT_EQ(stats.writes, 1);
+  client.stop();
+}
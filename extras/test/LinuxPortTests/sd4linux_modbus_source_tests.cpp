@@ -0,0 +1,499 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <linux_modbus_tcp_server.h>
+#include <poll.h>
+#include <simple_time.h>
+#include <stdlib.h>
+#include <supla/channel.h>
+#include <supla/crc16.h>
+#include <supla/modbus/modbus_client_handler.h>
+#include <supla/parser/modbus.h>
+#include <supla/sensor/thermometer_parsed.h>
+#include <supla/source/modbus.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace {
+
+// Modbus slave simulator: holding registers 1000-1099 and coils 0-15.
+// Register value is 0x1000 + register offset, unless set by test.
+class SimulatorHandler : public Supla::ModbusClientHandler {
+ public:
+  SimulatorHandler() {
+    modbusAddressOffset = 1000;
+    usedRegistersCount = 100;
+    for (int i = 0; i < 100; i++) {
+      registers[i] = 0x1000 + i;
+    }
+  }
+
+  bool isHoldingSupported() override {
+    return true;
+  }
+
+  bool isCoilsSupported() override {
+    return true;
+  }
+
+  Supla::Modbus::Result holdingProcessRequest(
+      uint16_t address,
+      uint16_t nRegs,
+      uint8_t *regBuffer,
+      Supla::Modbus::Access access) override {
+    if (access != Supla::Modbus::Access::READ) {
+      return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+    }
+    for (int i = 0; i < nRegs; i++) {
+      auto reg = registers[address - modbusAddressOffset + i];
+      regBuffer[2 * i] = reg >> 8;
+      regBuffer[2 * i + 1] = reg & 0xFF;
+    }
+    return Supla::Modbus::Result::OK;
+  }
+
+  bool coilsRespondsToAddress(uint16_t address, uint16_t nRegs) override {
+    return address + nRegs <= 16;
+  }
+
+  Supla::Modbus::Result coilsProcessRequest(
+      uint16_t address,
+      uint16_t nRegs,
+      uint8_t *regBuffer,
+      Supla::Modbus::Access access) override {
+    if (access != Supla::Modbus::Access::READ) {
+      return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+    }
+    for (int i = 0; i < nRegs; i++) {
+      if (coils & (1 << (address + i))) {
+        regBuffer[i / 8] |= 1 << (i % 8);
+      }
+    }
+    return Supla::Modbus::Result::OK;
+  }
+
+  uint16_t registers[100] = {};
+  uint16_t coils = 0;
+};
+
+class ServerRunner {
+ public:
+  explicit ServerRunner(Supla::Linux::ModbusTcpServer *server)
+      : server(server) {
+    thread = std::thread([this]() {
+      while (running) {
+        this->server->iterate(1);
+      }
+    });
+  }
+
+  ~ServerRunner() {
+    running = false;
+    thread.join();
+  }
+
+ private:
+  Supla::Linux::ModbusTcpServer *server = nullptr;
+  std::atomic<bool> running{true};
+  std::thread thread;
+};
+
+// Modbus RTU slave on pseudo terminal, which forwards requests to
+// ModbusTcpServer::ProcessAdu
+class RtuSlave {
+ public:
+  RtuSlave() {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0) {
+      devicePath = ptsname(master);
+    }
+    thread = std::thread([this]() { run(); });
+  }
+
+  ~RtuSlave() {
+    running = false;
+    thread.join();
+    if (master >= 0) {
+      close(master);
+    }
+  }
+
+  std::string devicePath;
+  std::atomic<int> requestCount{0};
+
+ private:
+  void run() {
+    std::vector<uint8_t> rx;
+    while (running) {
+      pollfd pfd = {master, POLLIN, 0};
+      if (poll(&pfd, 1, 5) != 1) {
+        continue;
+      }
+      uint8_t buffer[256];
+      ssize_t size = read(master, buffer, sizeof(buffer));
+      if (size <= 0) {
+        continue;
+      }
+      rx.insert(rx.end(), buffer, buffer + size);
+      // read requests have fixed size of 8 bytes
+      while (rx.size() >= 8) {
+        std::vector<uint8_t> frame(rx.begin(), rx.begin() + 8);
+        rx.erase(rx.begin(), rx.begin() + 8);
+        uint16_t crc = calculateCrc16(frame.data(), 6);
+        if (frame[6] != (crc & 0xFF) || frame[7] != (crc >> 8)) {
+          continue;
+        }
+        requestCount++;
+        if (frame[0] == 9) {
+          // unit 9 is not present on the bus
+          continue;
+        }
+        uint8_t adu[SUPLA_MODBUS_TCP_MAX_ADU_SIZE] = {0, 1, 0, 0, 0, 6};
+        memcpy(adu + 6, frame.data(), 6);
+        uint8_t response[SUPLA_MODBUS_TCP_MAX_ADU_SIZE] = {};
+        size_t responseSize = Supla::Linux::ModbusTcpServer::ProcessAdu(
+            adu, 12, response, 0);
+        if (responseSize < 8) {
+          continue;
+        }
+        std::vector<uint8_t> out(response + 6, response + responseSize);
+        crc = calculateCrc16(out.data(), out.size());
+        out.push_back(crc & 0xFF);
+        out.push_back(crc >> 8);
+        if (write(master, out.data(), out.size()) < 0) {
+          continue;
+        }
+      }
+    }
+  }
+
+  int master = -1;
+  std::atomic<bool> running{true};
+  std::thread thread;
+};
+
+class Sd4linuxModbusSourceTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  Supla::Source::ModbusConfig tcpConfig(uint16_t port) {
+    Supla::Source::ModbusConfig config;
+    config.host = "127.0.0.1";
+    config.port = port;
+    config.timeoutMs = 500;
+    return config;
+  }
+
+  double value(const Supla::Source::Modbus &source, const std::string &key) {
+    double result = -1;
+    EXPECT_TRUE(source.getValue(source.findKey(key), &result)) << key;
+    return result;
+  }
+
+  SimpleTime time;
+};
+
+}  // namespace
+
+TEST_F(Sd4linuxModbusSourceTests, ParseKey) {
+  uint8_t unitId = 0;
+  Supla::Source::ModbusTable table = {};
+  uint16_t address = 0;
+  Supla::Source::ModbusDataType type = {};
+  bool swapped = false;
+
+  EXPECT_TRUE(Supla::Source::Modbus::ParseKey(
+      "1:holding:100", &unitId, &table, &address, &type, &swapped));
+  EXPECT_EQ(1, unitId);
+  EXPECT_EQ(Supla::Source::ModbusTable::HOLDING_REGISTER, table);
+  EXPECT_EQ(100, address);
+  EXPECT_EQ(Supla::Source::ModbusDataType::UINT16, type);
+  EXPECT_FALSE(swapped);
+
+  EXPECT_TRUE(Supla::Source::Modbus::ParseKey(
+      "247:input:65534:float32_swapped",
+      &unitId, &table, &address, &type, &swapped));
+  EXPECT_EQ(247, unitId);
+  EXPECT_EQ(Supla::Source::ModbusTable::INPUT_REGISTER, table);
+  EXPECT_EQ(Supla::Source::ModbusDataType::FLOAT32, type);
+  EXPECT_TRUE(swapped);
+
+  EXPECT_TRUE(Supla::Source::Modbus::ParseKey(
+      "3:discrete:7", &unitId, &table, &address, &type, &swapped));
+  EXPECT_EQ(Supla::Source::ModbusDataType::BOOL, type);
+
+  for (const char *key : {"",
+                          "1:holding",
+                          "256:holding:1",
+                          "1:foo:1",
+                          "1:holding:65536",
+                          "1:holding:65535:uint32",
+                          "1:holding:1:uint16_swapped",
+                          "1:holding:1:bool",
+                          "1:coil:1:uint16",
+                          "1:holding:-1",
+                          "1:holding:1:int8",
+                          "1:holding:1:int16:x"}) {
+    EXPECT_FALSE(Supla::Source::Modbus::ParseKey(
+        key, &unitId, &table, &address, &type, &swapped))
+        << key;
+  }
+}
+
+TEST_F(Sd4linuxModbusSourceTests, CoalescesReadsAndDecodesValues) {
+  SimulatorHandler handler;
+  handler.registers[1] = static_cast<uint16_t>(-215);
+  handler.registers[2] = 0x0001;
+  handler.registers[3] = 0x0002;
+  float f = 230.5;
+  uint32_t bits = 0;
+  memcpy(&bits, &f, sizeof(bits));
+  handler.registers[4] = bits >> 16;
+  handler.registers[5] = bits & 0xFFFF;
+  handler.registers[10] = 0x5678;
+  handler.registers[11] = 0x1234;
+  handler.coils = 0b1000;
+
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  Supla::Source::Modbus source(tcpConfig(server.getPort()));
+  // unit 1: 1000-1011 in one request (gap of 4 registers is filled),
+  // 1090 in second request, coils in third request
+  for (const char *key : {"1:holding:1010:uint32_swapped",
+                          "1:holding:1000",
+                          "1:holding:1001:int16",
+                          "1:holding:1002:uint32",
+                          "1:holding:1004:float32",
+                          "1:holding:1090",
+                          "1:coil:3",
+                          "1:coil:4",
+                          "2:holding:1000"}) {
+    EXPECT_GE(source.addKey(key), 0) << key;
+  }
+  EXPECT_EQ(-1, source.addKey("1:holding"));
+  // duplicated key
+  EXPECT_EQ(1, source.addKey("1:holding:1000"));
+  EXPECT_EQ(4u, source.getPlannedRequestCount());
+
+  ASSERT_TRUE(source.refresh());
+  EXPECT_EQ(4u, source.getRequestCount());
+  EXPECT_EQ(4u, server.getRequestCount());
+
+  EXPECT_EQ(0x1000, value(source, "1:holding:1000"));
+  EXPECT_EQ(-215, value(source, "1:holding:1001:int16"));
+  EXPECT_EQ(0x00010002, value(source, "1:holding:1002:uint32"));
+  EXPECT_FLOAT_EQ(230.5, value(source, "1:holding:1004:float32"));
+  EXPECT_EQ(0x12345678, value(source, "1:holding:1010:uint32_swapped"));
+  EXPECT_EQ(0x1000 + 90, value(source, "1:holding:1090"));
+  EXPECT_EQ(1, value(source, "1:coil:3"));
+  EXPECT_EQ(0, value(source, "1:coil:4"));
+  EXPECT_EQ(0x1000, value(source, "2:holding:1000"));
+
+  // refresh within 10 ms from previous one is ignored
+  EXPECT_TRUE(source.refresh());
+  EXPECT_EQ(4u, source.getRequestCount());
+  time.advance(1000);
+  EXPECT_TRUE(source.refresh());
+  EXPECT_EQ(8u, source.getRequestCount());
+}
+
+TEST_F(Sd4linuxModbusSourceTests, ExceptionInvalidatesOnlyAffectedValues) {
+  SimulatorHandler handler;
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  Supla::Source::Modbus source(tcpConfig(server.getPort()));
+  int valid = source.addKey("1:holding:1005");
+  int invalid = source.addKey("1:holding:1500");
+  ASSERT_TRUE(source.refresh());
+  double result = 0;
+  EXPECT_TRUE(source.getValue(valid, &result));
+  EXPECT_EQ(0x1005, result);
+  EXPECT_FALSE(source.getValue(invalid, &result));
+  EXPECT_TRUE(source.isConnected());
+}
+
+TEST_F(Sd4linuxModbusSourceTests, ConnectionFailure) {
+  // bind and close server to get port which is not used
+  uint16_t port = 0;
+  {
+    Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+    ASSERT_TRUE(server.begin());
+    port = server.getPort();
+  }
+
+  Supla::Source::Modbus source(tcpConfig(port));
+  int id = source.addKey("1:holding:1000");
+  EXPECT_FALSE(source.refresh());
+  EXPECT_FALSE(source.isConnected());
+  double result = 0;
+  EXPECT_FALSE(source.getValue(id, &result));
+
+  // server is started, but reconnect is attempted after 5 s
+  SimulatorHandler handler;
+  Supla::Linux::ModbusTcpServer server(port, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+  time.advance(1000);
+  EXPECT_FALSE(source.refresh());
+  EXPECT_FALSE(source.isConnected());
+  time.advance(5000);
+  // isConnected() doesn't connect, it reports that refresh() should be called
+  EXPECT_TRUE(source.isConnected());
+  EXPECT_EQ(0u, server.getRequestCount());
+  EXPECT_TRUE(source.refresh());
+  EXPECT_TRUE(source.getValue(id, &result));
+}
+
+TEST_F(Sd4linuxModbusSourceTests, HostNameIsResolved) {
+  SimulatorHandler handler;
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  auto config = tcpConfig(server.getPort());
+  config.host = "localhost";
+  Supla::Source::Modbus source(config);
+  source.addKey("1:holding:1000");
+  bool result = false;
+  for (int i = 0; i < 10 && !result; i++) {
+    time.advance(1000);
+    result = source.refresh();
+  }
+  EXPECT_TRUE(result);
+  EXPECT_EQ(0x1000, value(source, "1:holding:1000"));
+}
+
+TEST_F(Sd4linuxModbusSourceTests, PipelinesRequestsToMultipleUnits) {
+  SimulatorHandler handler;
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  auto config = tcpConfig(server.getPort());
+  config.maxPipelined = 4;
+  Supla::Source::Modbus source(config);
+  for (int unit = 1; unit <= 20; unit++) {
+    std::string prefix = std::to_string(unit) + ":holding:";
+    source.addKey(prefix + "1000:uint32");
+    source.addKey(prefix + "1050");
+  }
+  EXPECT_EQ(40u, source.getPlannedRequestCount());
+
+  for (int cycle = 0; cycle < 10; cycle++) {
+    time.advance(1000);
+    ASSERT_TRUE(source.refresh());
+  }
+  EXPECT_EQ(400u, server.getRequestCount());
+  EXPECT_EQ(0x10001001u, value(source, "20:holding:1000:uint32"));
+  EXPECT_EQ(0x1000 + 50, value(source, "7:holding:1050"));
+}
+
+TEST_F(Sd4linuxModbusSourceTests, RtuMaster) {
+  SimulatorHandler handler;
+  handler.coils = 0b11;
+  RtuSlave slave;
+  ASSERT_FALSE(slave.devicePath.empty());
+
+  Supla::Source::ModbusConfig config;
+  config.protocol = Supla::Source::ModbusProtocol::RTU;
+  config.device = slave.devicePath;
+  config.baudRate = 115200;
+  config.timeoutMs = 200;
+  Supla::Source::Modbus source(config);
+  source.addKey("1:holding:1000");
+  source.addKey("1:holding:1002:uint32");
+  source.addKey("1:coil:1");
+  source.addKey("5:holding:1099");
+  int missing = source.addKey("9:holding:1000");
+
+  ASSERT_TRUE(source.refresh());
+  EXPECT_EQ(4u, source.getRequestCount());
+  EXPECT_EQ(4, slave.requestCount);
+  EXPECT_EQ(0x1000, value(source, "1:holding:1000"));
+  EXPECT_EQ(0x10021003, value(source, "1:holding:1002:uint32"));
+  EXPECT_EQ(1, value(source, "1:coil:1"));
+  EXPECT_EQ(0x1000 + 99, value(source, "5:holding:1099"));
+  double result = 0;
+  EXPECT_FALSE(source.getValue(missing, &result));
+}
+
+TEST_F(Sd4linuxModbusSourceTests, RtuPollCycleHasSingleDeadline) {
+  SimulatorHandler handler;
+  RtuSlave slave;
+  ASSERT_FALSE(slave.devicePath.empty());
+
+  Supla::Source::ModbusConfig config;
+  config.protocol = Supla::Source::ModbusProtocol::RTU;
+  config.device = slave.devicePath;
+  config.baudRate = 115200;
+  config.timeoutMs = 200;
+  Supla::Source::Modbus source(config);
+  // unit 9 doesn't respond; it is queried with two requests
+  source.addKey("1:holding:1000");
+  source.addKey("9:holding:1000");
+  source.addKey("9:holding:1090");
+  ASSERT_EQ(3u, source.getPlannedRequestCount());
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(source.refresh());
+  auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  EXPECT_LT(elapsedMs, 350);
+  // second request to unit 9 was skipped
+  EXPECT_EQ(2u, source.getRequestCount());
+  EXPECT_EQ(0x1000, value(source, "1:holding:1000"));
+
+  // skipped request is sent first in the next cycle
+  time.advance(1000);
+  ASSERT_TRUE(source.refresh());
+  EXPECT_EQ(3u, source.getRequestCount());
+  EXPECT_EQ(3, slave.requestCount);
+}
+
+TEST_F(Sd4linuxModbusSourceTests, ThermometerParsed) {
+  SimulatorHandler handler;
+  handler.registers[20] = static_cast<uint16_t>(-125);
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1");
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  Supla::Source::Modbus source(tcpConfig(server.getPort()));
+  Supla::Parser::Modbus parser(&source);
+  Supla::Sensor::ThermometerParsed sensor1(&parser);
+  sensor1.setMapping(Supla::Parser::Temperature, "1:holding:1020:int16");
+  sensor1.setMultiplier(Supla::Parser::Temperature, 0.1);
+  Supla::Sensor::ThermometerParsed sensor2(&parser);
+  sensor2.setMapping(Supla::Parser::Temperature, "1:holding:1021");
+  Supla::Sensor::ThermometerParsed sensor3(&parser);
+  sensor3.setMapping(Supla::Parser::Temperature, "1:holding:1200");
+
+  sensor1.onInit();
+  sensor2.onInit();
+  sensor3.onInit();
+
+  // sensors are read in a single poll cycle, first two sensors share
+  // the same request
+  EXPECT_EQ(2u, server.getRequestCount());
+  EXPECT_DOUBLE_EQ(-12.5, sensor1.getValue());
+  EXPECT_DOUBLE_EQ(0x1000 + 21, sensor2.getValue());
+  EXPECT_DOUBLE_EQ(TEMPERATURE_NOT_AVAILABLE, sensor3.getValue());
+}
@@ -0,0 +1,527 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <linux_modbus_tcp_server.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <simple_time.h>
+#include <supla/channel.h>
+#include <supla/modbus/modbus_client_handler.h>
+#include <supla/modbus/modbus_em_handler.h>
+#include <supla/sensor/electricity_meter.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace {
+
+// 100 holding registers at address 1000 and 16 coils at address 0
+class MemoryHandler : public Supla::ModbusClientHandler {
+ public:
+  MemoryHandler() {
+    modbusAddressOffset = 1000;
+    usedRegistersCount = 100;
+    for (int i = 0; i < 100; i++) {
+      registers[i] = 0x1000 + i;
+    }
+  }
+
+  bool isHoldingSupported() override {
+    return true;
+  }
+
+  bool isCoilsSupported() override {
+    return true;
+  }
+
+  Supla::Modbus::Result holdingProcessRequest(
+      uint16_t address,
+      uint16_t nRegs,
+      uint8_t *regBuffer,
+      Supla::Modbus::Access access) override {
+    for (int i = 0; i < nRegs; i++) {
+      auto &reg = registers[address - modbusAddressOffset + i];
+      if (access == Supla::Modbus::Access::READ) {
+        regBuffer[2 * i] = reg >> 8;
+        regBuffer[2 * i + 1] = reg & 0xFF;
+      } else {
+        reg = (regBuffer[2 * i] << 8) | regBuffer[2 * i + 1];
+      }
+    }
+    return Supla::Modbus::Result::OK;
+  }
+
+  bool coilsRespondsToAddress(uint16_t address, uint16_t nRegs) override {
+    return address + nRegs <= 16;
+  }
+
+  Supla::Modbus::Result coilsProcessRequest(
+      uint16_t address,
+      uint16_t nRegs,
+      uint8_t *regBuffer,
+      Supla::Modbus::Access access) override {
+    for (int i = 0; i < nRegs; i++) {
+      uint8_t &byte = regBuffer[i / 8];
+      uint8_t mask = 1 << (i % 8);
+      if (access == Supla::Modbus::Access::READ) {
+        if (coils & (1 << (address + i))) {
+          byte |= mask;
+        }
+      } else if (byte & mask) {
+        coils |= (1 << (address + i));
+      } else {
+        coils &= ~(1 << (address + i));
+      }
+    }
+    return Supla::Modbus::Result::OK;
+  }
+
+  uint16_t registers[100] = {};
+  uint16_t coils = 0;
+};
+
+std::vector<uint8_t> makeAdu(uint16_t transactionId,
+                             uint8_t unitId,
+                             const std::vector<uint8_t> &pdu) {
+  std::vector<uint8_t> adu = {static_cast<uint8_t>(transactionId >> 8),
+                              static_cast<uint8_t>(transactionId & 0xFF),
+                              0,
+                              0,
+                              static_cast<uint8_t>((pdu.size() + 1) >> 8),
+                              static_cast<uint8_t>((pdu.size() + 1) & 0xFF),
+                              unitId};
+  adu.insert(adu.end(), pdu.begin(), pdu.end());
+  return adu;
+}
+
+std::vector<uint8_t> readRequest(uint8_t functionCode,
+                                 uint16_t address,
+                                 uint16_t count) {
+  return {functionCode,
+          static_cast<uint8_t>(address >> 8),
+          static_cast<uint8_t>(address & 0xFF),
+          static_cast<uint8_t>(count >> 8),
+          static_cast<uint8_t>(count & 0xFF)};
+}
+
+std::vector<uint8_t> process(const std::vector<uint8_t> &adu,
+                             uint8_t unitId = 0) {
+  uint8_t response[SUPLA_MODBUS_TCP_MAX_ADU_SIZE] = {};
+  size_t size = Supla::Linux::ModbusTcpServer::ProcessAdu(
+      adu.data(), adu.size(), response, unitId);
+  return std::vector<uint8_t>(response, response + size);
+}
+
+std::vector<uint8_t> pduOf(const std::vector<uint8_t> &adu) {
+  if (adu.size() < 7) {
+    return {};
+  }
+  return std::vector<uint8_t>(adu.begin() + 7, adu.end());
+}
+
+class TestClient {
+ public:
+  ~TestClient() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  bool connectTo(uint16_t port) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return false;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    if (receiveBufferSize > 0) {
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize,
+                 sizeof(receiveBufferSize));
+    }
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return connect(fd, reinterpret_cast<sockaddr *>(&address),
+                   sizeof(address)) == 0;
+  }
+
+  bool sendBytes(const std::vector<uint8_t> &data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) ==
+           static_cast<ssize_t>(data.size());
+  }
+
+  std::vector<uint8_t> receiveAdu() {
+    uint8_t header[7] = {};
+    if (!receiveExact(header, sizeof(header))) {
+      return {};
+    }
+    uint16_t length = (header[4] << 8) | header[5];
+    std::vector<uint8_t> adu(header, header + 7);
+    adu.resize(6 + length);
+    if (length > 1 && !receiveExact(adu.data() + 7, length - 1)) {
+      return {};
+    }
+    return adu;
+  }
+
+  // returns false when data can't be sent without blocking
+  bool trySendBytes(const std::vector<uint8_t> &data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL | MSG_DONTWAIT) ==
+           static_cast<ssize_t>(data.size());
+  }
+
+  // Sets SO_SNDBUF of the server side socket of this connection (server runs
+  // in the same process), so server's tx path is blocked by small amount of
+  // data
+  bool setPeerSendBufferSize(int size) {
+    sockaddr_in local = {};
+    socklen_t length = sizeof(local);
+    if (getsockname(fd, reinterpret_cast<sockaddr *>(&local), &length) < 0) {
+      return false;
+    }
+    for (int peerFd = 0; peerFd < 1024; peerFd++) {
+      sockaddr_in peer = {};
+      length = sizeof(peer);
+      if (peerFd != fd &&
+          getpeername(
+              peerFd, reinterpret_cast<sockaddr *>(&peer), &length) == 0 &&
+          peer.sin_port == local.sin_port &&
+          peer.sin_addr.s_addr == local.sin_addr.s_addr) {
+        return setsockopt(
+                   peerFd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == 0;
+      }
+    }
+    return false;
+  }
+
+  void shutdownWrite() {
+    shutdown(fd, SHUT_WR);
+  }
+
+  // reads available data without blocking; returns -1 when nothing was
+  // available and 0 when peer closed connection
+  ssize_t drain() {
+    uint8_t buffer[4096];
+    ssize_t total = -1;
+    while (true) {
+      ssize_t result = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (result == 0) {
+        return 0;
+      }
+      if (result < 0) {
+        return total;
+      }
+      total = (total < 0 ? 0 : total) + result;
+    }
+  }
+
+  // returns true when peer closed connection
+  bool isClosedByPeer() {
+    uint8_t byte = 0;
+    return recv(fd, &byte, 1, 0) == 0;
+  }
+
+  // SO_RCVBUF set before connection, 0 - system default
+  int receiveBufferSize = 0;
+
+ private:
+  bool receiveExact(uint8_t *buffer, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+      ssize_t result = recv(fd, buffer + received, size - received, 0);
+      if (result <= 0) {
+        return false;
+      }
+      received += result;
+    }
+    return true;
+  }
+
+  int fd = -1;
+};
+
+// Runs server loop in background thread
+class ServerRunner {
+ public:
+  explicit ServerRunner(Supla::Linux::ModbusTcpServer *server)
+      : server(server) {
+    thread = std::thread([this]() {
+      while (running) {
+        this->server->iterate(1);
+      }
+    });
+  }
+
+  ~ServerRunner() {
+    running = false;
+    thread.join();
+  }
+
+ private:
+  Supla::Linux::ModbusTcpServer *server = nullptr;
+  std::atomic<bool> running{true};
+  std::thread thread;
+};
+
+class Sd4linuxModbusTcpServerTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  SimpleTime time;
+};
+
+}  // namespace
+
+TEST_F(Sd4linuxModbusTcpServerTests, ReadAndWriteRegisters) {
+  MemoryHandler handler;
+
+  auto response = process(makeAdu(0x1234, 1, readRequest(0x03, 1002, 2)));
+  EXPECT_EQ(makeAdu(0x1234, 1, {0x03, 4, 0x10, 0x02, 0x10, 0x03}), response);
+
+  // input registers are not supported by handler
+  EXPECT_EQ(std::vector<uint8_t>({0x84, 0x01}),
+            pduOf(process(makeAdu(1, 1, readRequest(0x04, 1000, 1)))));
+
+  EXPECT_EQ(std::vector<uint8_t>({0x06, 0x03, 0xE8, 0xAB, 0xCD}),
+            pduOf(process(makeAdu(2, 1, {0x06, 0x03, 0xE8, 0xAB, 0xCD}))));
+  EXPECT_EQ(0xABCD, handler.registers[0]);
+
+  EXPECT_EQ(std::vector<uint8_t>({0x10, 0x03, 0xE9, 0x00, 0x02}),
+            pduOf(process(makeAdu(
+                3, 1, {0x10, 0x03, 0xE9, 0x00, 0x02, 4, 1, 2, 3, 4}))));
+  EXPECT_EQ(0x0102, handler.registers[1]);
+  EXPECT_EQ(0x0304, handler.registers[2]);
+
+  // byte count doesn't match registers count
+  EXPECT_EQ(std::vector<uint8_t>({0x90, 0x03}),
+            pduOf(process(makeAdu(
+                4, 1, {0x10, 0x03, 0xE9, 0x00, 0x02, 2, 1, 2}))));
+}
+
+TEST_F(Sd4linuxModbusTcpServerTests, ExceptionsAndUnitId) {
+  MemoryHandler handler;
+
+  // address outside of handler range
+  EXPECT_EQ(std::vector<uint8_t>({0x83, 0x02}),
+            pduOf(process(makeAdu(1, 1, readRequest(0x03, 1099, 2)))));
+  // too many registers
+  EXPECT_EQ(std::vector<uint8_t>({0x83, 0x03}),
+            pduOf(process(makeAdu(1, 1, readRequest(0x03, 1000, 126)))));
+  // unknown function code
+  EXPECT_EQ(std::vector<uint8_t>({0xAB, 0x01}),
+            pduOf(process(makeAdu(1, 1, {0x2B, 0x0E, 0x01, 0x00}))));
+
+  // unit id filtering
+  EXPECT_TRUE(process(makeAdu(1, 2, readRequest(0x03, 1000, 1)), 1).empty());
+  EXPECT_FALSE(process(makeAdu(1, 1, readRequest(0x03, 1000, 1)), 1).empty());
+  EXPECT_FALSE(
+      process(makeAdu(1, 0xFF, readRequest(0x03, 1000, 1)), 1).empty());
+
+  // malformed MBAP header
+  auto adu = makeAdu(1, 1, readRequest(0x03, 1000, 1));
+  adu[2] = 1;  // protocol id
+  EXPECT_TRUE(process(adu).empty());
+  adu = makeAdu(1, 1, readRequest(0x03, 1000, 1));
+  adu[5]++;  // length
+  EXPECT_TRUE(process(adu).empty());
+}
+
+TEST_F(Sd4linuxModbusTcpServerTests, Coils) {
+  MemoryHandler handler;
+  handler.coils = 0x0105;
+
+  EXPECT_EQ(std::vector<uint8_t>({0x01, 2, 0x05, 0x01}),
+            pduOf(process(makeAdu(1, 1, readRequest(0x01, 0, 10)))));
+  EXPECT_EQ(std::vector<uint8_t>({0x05, 0x00, 0x01, 0xFF, 0x00}),
+            pduOf(process(makeAdu(1, 1, {0x05, 0x00, 0x01, 0xFF, 0x00}))));
+  EXPECT_EQ(0x0107, handler.coils);
+  EXPECT_EQ(std::vector<uint8_t>({0x85, 0x03}),
+            pduOf(process(makeAdu(1, 1, {0x05, 0x00, 0x01, 0x12, 0x34}))));
+  EXPECT_EQ(std::vector<uint8_t>({0x0F, 0x00, 0x08, 0x00, 0x03}),
+            pduOf(process(
+                makeAdu(1, 1, {0x0F, 0x00, 0x08, 0x00, 0x03, 1, 0x06}))));
+  EXPECT_EQ(0x0607, handler.coils);
+  // discrete inputs are not supported
+  EXPECT_EQ(std::vector<uint8_t>({0x82, 0x01}),
+            pduOf(process(makeAdu(1, 1, readRequest(0x02, 0, 1)))));
+}
+
+TEST_F(Sd4linuxModbusTcpServerTests, PipelinedAndFragmentedRequests) {
+  MemoryHandler handler;
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1", 1, 2);
+  ASSERT_TRUE(server.begin());
+  ASSERT_NE(0, server.getPort());
+  ServerRunner runner(&server);
+
+  TestClient client;
+  ASSERT_TRUE(client.connectTo(server.getPort()));
+
+  // two requests in a single segment
+  auto first = makeAdu(10, 1, readRequest(0x03, 1000, 1));
+  auto second = makeAdu(11, 1, readRequest(0x03, 1050, 1));
+  std::vector<uint8_t> both = first;
+  both.insert(both.end(), second.begin(), second.end());
+  ASSERT_TRUE(client.sendBytes(both));
+  EXPECT_EQ(makeAdu(10, 1, {0x03, 2, 0x10, 0x00}), client.receiveAdu());
+  EXPECT_EQ(makeAdu(11, 1, {0x03, 2, 0x10, 0x32}), client.receiveAdu());
+
+  // request split into single bytes
+  auto third = makeAdu(12, 1, readRequest(0x03, 1099, 1));
+  for (auto byte : third) {
+    ASSERT_TRUE(client.sendBytes({byte}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(makeAdu(12, 1, {0x03, 2, 0x10, 0x63}), client.receiveAdu());
+
+  // second client is accepted, third one is over the limit
+  TestClient client2;
+  ASSERT_TRUE(client2.connectTo(server.getPort()));
+  ASSERT_TRUE(client2.sendBytes(makeAdu(13, 1, readRequest(0x03, 1001, 1))));
+  EXPECT_EQ(makeAdu(13, 1, {0x03, 2, 0x10, 0x01}), client2.receiveAdu());
+  TestClient client3;
+  ASSERT_TRUE(client3.connectTo(server.getPort()));
+  EXPECT_TRUE(client3.isClosedByPeer());
+
+  // invalid MBAP length closes connection
+  ASSERT_TRUE(client.sendBytes({0, 1, 0, 0, 0x10, 0x00, 1, 3}));
+  EXPECT_TRUE(client.isClosedByPeer());
+}
+
+TEST_F(Sd4linuxModbusTcpServerTests, HalfClosedClientWithFullBuffers) {
+  MemoryHandler handler;
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1", 1, 2);
+  ASSERT_TRUE(server.begin());
+
+  // client doesn't read responses, so server's tx and rx buffers fill up
+  TestClient client;
+  client.receiveBufferSize = 4096;
+  ASSERT_TRUE(client.connectTo(server.getPort()));
+  server.iterate(100);
+  ASSERT_EQ(1, server.getClientCount());
+  ASSERT_TRUE(client.setPeerSendBufferSize(4096));
+  auto request = makeAdu(1, 1, readRequest(0x03, 1000, 100));
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(client.trySendBytes(request));
+    server.iterate(0);
+  }
+  client.shutdownWrite();
+  for (int i = 0; i < 100; i++) {
+    server.iterate(1);
+  }
+  ASSERT_EQ(1, server.getClientCount());
+
+  // half closed connection with full rx buffer doesn't wake up epoll_wait
+  auto start = std::chrono::steady_clock::now();
+  server.iterate(100);
+  auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  EXPECT_GE(elapsedMs, 50);
+
+  // when responses are read, remaining requests are processed and
+  // connection is closed
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  bool closed = false;
+  while (!closed && std::chrono::steady_clock::now() < deadline) {
+    closed = client.drain() == 0;
+    server.iterate(1);
+  }
+  EXPECT_TRUE(closed);
+  EXPECT_EQ(0, server.getClientCount());
+}
+
+TEST_F(Sd4linuxModbusTcpServerTests, ElectricityMeterThroughputBenchmark) {
+  const int metersCount = 4;
+  const uint16_t meterRegisters = 4 * EM_REGISTER_BLOCK_MAX_SIZE;
+  Supla::Sensor::ElectricityMeter em[metersCount];
+  std::vector<std::unique_ptr<Supla::ModbusEMHandler>> handlers;
+  for (int i = 0; i < metersCount; i++) {
+    em[i].setVoltage(0, 23000 + i);
+    em[i].updateChannelValues();
+    handlers.push_back(std::make_unique<Supla::ModbusEMHandler>(
+        &em[i], i * meterRegisters));
+  }
+
+  Supla::Linux::ModbusTcpServer server(0, "127.0.0.1", 0, 8);
+  ASSERT_TRUE(server.begin());
+  ServerRunner runner(&server);
+
+  const int clientsCount = 4;
+  const int requestsPerClient = 2000;
+  std::vector<std::vector<double>> latencies(clientsCount);
+  std::atomic<int> errors{0};
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clientsCount; c++) {
+    threads.emplace_back([&, c]() {
+      TestClient client;
+      if (!client.connectTo(server.getPort())) {
+        errors++;
+        return;
+      }
+      for (int i = 0; i < requestsPerClient; i++) {
+        uint16_t meter = (c + i) % metersCount;
+        auto request = makeAdu(
+            i, 1, readRequest(0x03, meter * meterRegisters, 60));
+        auto requestStart = std::chrono::steady_clock::now();
+        if (!client.sendBytes(request)) {
+          errors++;
+          return;
+        }
+        auto response = client.receiveAdu();
+        latencies[c].push_back(
+            std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - requestStart)
+                .count());
+        // phase 1 voltage is register 30 of each meter
+        if (response.size() != 9 + 120 || response[7] != 0x03 ||
+            ((response[9 + 60] << 8) | response[9 + 61]) != 23000 + meter) {
+          errors++;
+          return;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  EXPECT_EQ(0, errors.load());
+  std::vector<double> all;
+  for (const auto &clientLatencies : latencies) {
+    all.insert(all.end(), clientLatencies.begin(), clientLatencies.end());
+  }
+  ASSERT_EQ(static_cast<size_t>(clientsCount * requestsPerClient), all.size());
+  std::sort(all.begin(), all.end());
+  double requestsPerSecond = elapsed > 0 ? all.size() / elapsed : 0;
+  printf(
+      "[ BENCHMARK ] Modbus TCP, %d clients, 60 register reads: %.0f req/s, "
+      "latency p50 %.0f us, p99 %.0f us\n",
+      clientsCount,
+      requestsPerSecond,
+      all[all.size() / 2],
+      all[all.size() * 99 / 100]);
+  RecordProperty("requests_per_second", static_cast<int>(requestsPerSecond));
+}
@@ -0,0 +1,272 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <simple_time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <supla/channels/channel.h>
+#include <supla/pv/fronius.h>
+#include <supla/pv/http_poller.h>
+
+namespace {
+
+const char singlePhaseInverterData[] = R"json({
+  "Body" : {
+    "Data" : {
+      "FAC" : { "Unit" : "Hz", "Value" : 50.02 },
+      "IAC" : { "Unit" : "A", "Value" : 10.5 },
+      "PAC" : { "Unit" : "W", "Value" : 2410 },
+      "TOTAL_ENERGY" : { "Unit" : "Wh", "Value" : 1234567 },
+      "UAC" : { "Unit" : "V", "Value" : 231.4 }
+    }
+  }
+})json";
+
+// HTTP server on 127.0.0.1, which answers each GET request with the same
+// body. Connections are handled one by one.
+class MockInverterServer {
+ public:
+  explicit MockInverterServer(const std::string &body) : body(body) {
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(listenFd, 4);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+    port = ntohs(addr.sin_port);
+    thread = std::thread([this]() { run(); });
+  }
+
+  ~MockInverterServer() {
+    stopping = true;
+    ::shutdown(listenFd, SHUT_RDWR);
+    ::close(listenFd);
+    int fd = connectionFd;
+    if (fd >= 0) {
+      ::shutdown(fd, SHUT_RDWR);
+    }
+    thread.join();
+  }
+
+  uint16_t port = 0;
+  std::atomic<int> status{200};
+  // when > 0, connection is closed (without response) on the next request
+  // after given number of responses
+  std::atomic<int> responsesPerConnection{0};
+  std::atomic<int> connections{0};
+  std::atomic<int> requests{0};
+
+ private:
+  void run() {
+    while (!stopping) {
+      int fd = ::accept(listenFd, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      connections++;
+      connectionFd = fd;
+      serve(fd);
+      connectionFd = -1;
+      ::close(fd);
+    }
+  }
+
+  void serve(int fd) {
+    std::string rx;
+    int responses = 0;
+    while (!stopping) {
+      size_t end = 0;
+      while ((end = rx.find("\r\n\r\n")) == std::string::npos) {
+        char buf[512];
+        ssize_t size = ::read(fd, buf, sizeof(buf));
+        if (size <= 0) {
+          return;
+        }
+        rx.append(buf, size);
+      }
+      rx.erase(0, end + 4);
+      requests++;
+      if (responsesPerConnection > 0 &&
+          responses >= responsesPerConnection) {
+        return;
+      }
+      std::string response = "HTTP/1.1 " + std::to_string(status) +
+                             " X\r\nContent-Type: application/json\r\n"
+                             "Content-Length: " +
+                             std::to_string(body.size()) + "\r\n\r\n" + body;
+      if (::write(fd, response.data(), response.size()) !=
+          static_cast<ssize_t>(response.size())) {
+        return;
+      }
+      responses++;
+    }
+  }
+
+  std::string body;
+  int listenFd = -1;
+  std::atomic<int> connectionFd{-1};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
+
+class ResponseCollector : public Supla::PV::HttpResponseHandler {
+ public:
+  void onHttpBody(const char *data, int size) override {
+    body.append(data, size);
+  }
+
+  void onHttpResponseComplete(bool success, int statusCode) override {
+    completed++;
+    lastSuccess = success;
+    lastStatusCode = statusCode;
+  }
+
+  std::string body;
+  int completed = 0;
+  bool lastSuccess = false;
+  int lastStatusCode = 0;
+};
+
+class PvInverterLoopbackTests : public ::testing::Test {
+ protected:
+  SimpleTime time;
+
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+    time.advance(1000);
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  // Calls step until done returns true (max 5 s of real time). Simulated
+  // time is advanced by advanceMs after each step.
+  bool runUntil(const std::function<bool()> &done,
+                const std::function<void()> &step,
+                int advanceMs = 10) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+      step();
+      if (done()) {
+        return true;
+      }
+      time.advance(advanceMs);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+};
+
+}  // namespace
+
+TEST_F(PvInverterLoopbackTests, FroniusReadsValuesOverKeepAliveConnection) {
+  MockInverterServer server(singlePhaseInverterData);
+  Supla::PV::Fronius fronius(IPAddress(127, 0, 0, 1), server.port, 1, 0);
+  fronius.setRefreshRate(1);
+  auto step = [&fronius]() {
+    fronius.iterateConnected();
+    fronius.iterateAlways();
+  };
+
+  ASSERT_TRUE(runUntil([&]() { return fronius.getVoltage(0) != 0; }, step));
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+  EXPECT_EQ(fronius.getPowerActive(0), 241000000);
+  EXPECT_EQ(fronius.getFwdActEnergy(0), 123456700);
+  EXPECT_EQ(server.requests, 1);
+
+  ASSERT_TRUE(runUntil([&]() { return server.requests == 3; }, step, 100));
+  EXPECT_EQ(server.connections, 1);
+}
+
+TEST_F(PvInverterLoopbackTests, FroniusFailedReadsZeroValues) {
+  MockInverterServer server(singlePhaseInverterData);
+  Supla::PV::Fronius fronius(IPAddress(127, 0, 0, 1), server.port, 1, 0);
+  fronius.setRefreshRate(1);
+  auto step = [&fronius]() {
+    fronius.iterateConnected();
+    fronius.iterateAlways();
+  };
+  ASSERT_TRUE(runUntil([&]() { return fronius.getVoltage(0) != 0; }, step));
+
+  // inverter responds with error during the night. Last values are kept for
+  // 3 failed reads, then they are cleared
+  server.status = 500;
+  ASSERT_TRUE(
+      runUntil([&]() { return fronius.getVoltage(0) == 0; }, step, 100));
+  EXPECT_EQ(server.requests, 5);
+  EXPECT_EQ(fronius.getPowerActive(0), 0);
+  // total energy is not cleared
+  EXPECT_EQ(fronius.getFwdActEnergy(0), 123456700);
+}
+
+TEST_F(PvInverterLoopbackTests, ClosedKeepAliveConnectionIsRetried) {
+  MockInverterServer server("{}");
+  server.responsesPerConnection = 1;
+  ResponseCollector collector;
+  Supla::PV::HttpPoller poller(&collector);
+  poller.setServer("127.0.0.1", server.port);
+  auto step = [&poller]() { poller.iterate(); };
+
+  ASSERT_TRUE(poller.sendRequest("/"));
+  ASSERT_TRUE(runUntil([&]() { return collector.completed == 1; }, step));
+  EXPECT_TRUE(collector.lastSuccess);
+
+  // server closes connection after receiving second request, so it is sent
+  // again on a new connection
+  ASSERT_TRUE(poller.sendRequest("/"));
+  ASSERT_TRUE(runUntil([&]() { return collector.completed == 2; }, step));
+  EXPECT_TRUE(collector.lastSuccess);
+  EXPECT_EQ(collector.lastStatusCode, 200);
+  EXPECT_EQ(collector.body, "{}{}");
+  EXPECT_EQ(server.requests, 3);
+  EXPECT_EQ(server.connections, 2);
+  EXPECT_EQ(poller.getConnectionCount(), 2);
+}
+
+TEST_F(PvInverterLoopbackTests, StalledTlsHandshakeDoesNotBlock) {
+  // server never answers, so TLS handshake doesn't progress
+  MockInverterServer server("");
+  ResponseCollector collector;
+  Supla::PV::HttpPoller poller(&collector);
+  poller.setServer("127.0.0.1", server.port);
+  poller.setTimeoutMs(500);
+  poller.getClient()->setSSLEnabled(true);
+
+  auto maxCallTime = std::chrono::steady_clock::duration::zero();
+  auto measure = [&maxCallTime](const std::function<void()> &call) {
+    auto start = std::chrono::steady_clock::now();
+    call();
+    auto duration = std::chrono::steady_clock::now() - start;
+    if (duration > maxCallTime) {
+      maxCallTime = duration;
+    }
+  };
+
+  bool sent = false;
+  measure([&]() { sent = poller.sendRequest("/"); });
+  ASSERT_TRUE(sent);
+  EXPECT_TRUE(poller.isBusy());
+  ASSERT_TRUE(runUntil([&]() { return collector.completed == 1; },
+                       [&]() { measure([&]() { poller.iterate(); }); }));
+  EXPECT_FALSE(collector.lastSuccess);
+  EXPECT_EQ(collector.lastStatusCode, 0);
+  EXPECT_FALSE(poller.isBusy());
+  EXPECT_EQ(server.requests, 0);
+  EXPECT_LT(maxCallTime, std::chrono::milliseconds(100));
+}
@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <simple_time.h>
+#include <supla/channel.h>
+#include <supla/modbus/modbus_client_handler.h>
+#include <supla/modbus/modbus_em_handler.h>
+#include <supla/sensor/electricity_meter.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct HandlerCall {
+  uint16_t address;
+  uint16_t nRegs;
+};
+
+class RangeHandler : public Supla::ModbusClientHandler {
+ public:
+  RangeHandler(uint16_t offset, uint16_t count, uint8_t marker)
+      : marker(marker) {
+    modbusAddressOffset = offset;
+    usedRegistersCount = count;
+  }
+
+  bool isHoldingSupported() override {
+    return true;
+  }
+
+  bool isInputSupported() override {
+    return inputSupported;
+  }
+
+  bool holdingRespondsToAddress(uint16_t address, uint16_t nRegs) override {
+    return !rejectRequests &&
+           ModbusClientHandler::holdingRespondsToAddress(address, nRegs);
+  }
+
+  Supla::Modbus::Result holdingProcessRequest(
+      uint16_t address,
+      uint16_t nRegs,
+      uint8_t *regBuffer,
+      Supla::Modbus::Access access) override {
+    (void)(access);
+    calls.push_back({address, nRegs});
+    for (int i = 0; i < nRegs; i++) {
+      regBuffer[2 * i] = marker;
+      regBuffer[2 * i + 1] = static_cast<uint8_t>(address + i);
+    }
+    return result;
+  }
+
+  uint8_t marker = 0;
+  bool inputSupported = false;
+  bool rejectRequests = false;
+  Supla::Modbus::Result result = Supla::Modbus::Result::OK;
+  std::vector<HandlerCall> calls;
+};
+
+// Handler with own address matching, without usedRegistersCount
+class CustomMatchHandler : public Supla::ModbusClientHandler {
+ public:
+  bool isHoldingSupported() override {
+    return true;
+  }
+
+  bool holdingRespondsToAddress(uint16_t address, uint16_t nRegs) override {
+    return address >= 1000 && address + nRegs <= 1010;
+  }
+
+  Supla::Modbus::Result holdingProcessRequest(
+      uint16_t, uint16_t, uint8_t *, Supla::Modbus::Access) override {
+    calls++;
+    return Supla::Modbus::Result::OK;
+  }
+
+  int calls = 0;
+};
+
+Supla::Modbus::Result readHolding(uint16_t address,
+                                  uint16_t nRegs,
+                                  uint8_t *buffer) {
+  return Supla::ModbusClientHandler::HoldingProcessRequest(
+      address, nRegs, buffer, Supla::Modbus::Access::READ);
+}
+
+}  // namespace
+
+TEST(ModbusClientHandlerTests, SingleHandlerLookup) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(20, 10, 0xB0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(22, 3, buffer));
+  ASSERT_EQ(1u, b.calls.size());
+  EXPECT_TRUE(a.calls.empty());
+  EXPECT_EQ(22, b.calls[0].address);
+  EXPECT_EQ(3, b.calls[0].nRegs);
+
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(10, 1, buffer));
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(29, 2, buffer));
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(30, 1, buffer));
+  EXPECT_EQ(1u, b.calls.size());
+}
+
+TEST(ModbusClientHandlerTests, RequestIsSplitAcrossAdjacentHandlers) {
+  // registration order differs from address order
+  RangeHandler c(20, 5, 0xC0);
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(10, 10, 0xB0);
+  uint8_t buffer[40] = {};
+  Supla::ModbusClientHandler::BuildIndex();
+
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(8, 14, buffer));
+  ASSERT_EQ(1u, a.calls.size());
+  ASSERT_EQ(1u, b.calls.size());
+  ASSERT_EQ(1u, c.calls.size());
+  EXPECT_EQ(8, a.calls[0].address);
+  EXPECT_EQ(2, a.calls[0].nRegs);
+  EXPECT_EQ(10, b.calls[0].address);
+  EXPECT_EQ(10, b.calls[0].nRegs);
+  EXPECT_EQ(20, c.calls[0].address);
+  EXPECT_EQ(2, c.calls[0].nRegs);
+
+  for (int i = 0; i < 14; i++) {
+    uint8_t expectedMarker = i < 2 ? 0xA0 : (i < 12 ? 0xB0 : 0xC0);
+    EXPECT_EQ(expectedMarker, buffer[2 * i]) << "register " << i;
+    EXPECT_EQ(8 + i, buffer[2 * i + 1]) << "register " << i;
+  }
+}
+
+TEST(ModbusClientHandlerTests, GapOrErrorInSplitRequestFails) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(11, 10, 0xB0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(8, 5, buffer));
+  EXPECT_TRUE(b.calls.empty());
+
+  RangeHandler gapFiller(10, 1, 0xF0);
+  Supla::ModbusClientHandler::BuildIndex();
+  gapFiller.result = Supla::Modbus::Result::INVALID_STATE;
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_STATE, readHolding(8, 5, buffer));
+  EXPECT_TRUE(b.calls.empty());
+}
+
+TEST(ModbusClientHandlerTests, SplitRequestIsValidatedBeforeProcessing) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(10, 10, 0xB0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  // second chunk is rejected, so first one is not processed either
+  b.rejectRequests = true;
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(8, 4, buffer));
+  EXPECT_TRUE(a.calls.empty());
+  EXPECT_TRUE(b.calls.empty());
+}
+
+TEST(ModbusClientHandlerTests, WriteIsNotSplitAcrossHandlers) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(10, 10, 0xB0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            Supla::ModbusClientHandler::HoldingProcessRequest(
+                8, 4, buffer, Supla::Modbus::Access::WRITE));
+  EXPECT_TRUE(a.calls.empty());
+  EXPECT_TRUE(b.calls.empty());
+
+  EXPECT_EQ(Supla::Modbus::Result::OK,
+            Supla::ModbusClientHandler::HoldingProcessRequest(
+                10, 4, buffer, Supla::Modbus::Access::WRITE));
+  EXPECT_EQ(1u, b.calls.size());
+}
+
+TEST(ModbusClientHandlerTests, OverlappingRangesPreferFirstRegistered) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(5, 10, 0xB0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(6, 2, buffer));
+  EXPECT_EQ(1u, a.calls.size());
+  EXPECT_TRUE(b.calls.empty());
+
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(8, 4, buffer));
+  ASSERT_EQ(2u, a.calls.size());
+  ASSERT_EQ(1u, b.calls.size());
+  EXPECT_EQ(2, a.calls[1].nRegs);
+  EXPECT_EQ(10, b.calls[0].address);
+  EXPECT_EQ(2, b.calls[0].nRegs);
+}
+
+TEST(ModbusClientHandlerTests, IndexFollowsHandlerLifetime) {
+  uint8_t buffer[40] = {};
+  RangeHandler a(0, 10, 0xA0);
+  {
+    RangeHandler b(10, 10, 0xB0);
+    // without index requests are not split between handlers
+    EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+              readHolding(5, 10, buffer));
+    Supla::ModbusClientHandler::BuildIndex();
+    EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(5, 10, buffer));
+  }
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            readHolding(5, 10, buffer));
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(5, 5, buffer));
+}
+
+TEST(ModbusClientHandlerTests, InputRequestsUseOwnIndex) {
+  RangeHandler a(0, 10, 0xA0);
+  RangeHandler b(10, 10, 0xB0);
+  b.inputSupported = true;
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            Supla::ModbusClientHandler::InputProcessRequest(5, 10, buffer));
+  EXPECT_EQ(Supla::Modbus::Result::OK,
+            Supla::ModbusClientHandler::InputProcessRequest(12, 3, buffer));
+  EXPECT_TRUE(a.calls.empty());
+  EXPECT_EQ(1u, b.calls.size());
+}
+
+TEST(ModbusClientHandlerTests, CustomAddressMatchingStillWorks) {
+  CustomMatchHandler custom;
+  RangeHandler a(0, 10, 0xA0);
+  Supla::ModbusClientHandler::BuildIndex();
+  uint8_t buffer[40] = {};
+
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(1002, 3, buffer));
+  EXPECT_EQ(1, custom.calls);
+  EXPECT_EQ(Supla::Modbus::Result::OK, readHolding(2, 3, buffer));
+  EXPECT_EQ(1, custom.calls);
+}
+
+TEST(ModbusClientHandlerTests, FourMeterLayoutBenchmark) {
+  Supla::Channel::resetToDefaults();
+  SimpleTime time;
+  const int metersCount = 4;
+  const uint16_t meterRegisters = 4 * EM_REGISTER_BLOCK_MAX_SIZE;
+  Supla::Sensor::ElectricityMeter em[metersCount];
+  std::vector<Supla::ModbusEMHandler *> handlers;
+  for (int i = 0; i < metersCount; i++) {
+    em[i].setVoltage(0, 23000 + i);
+    em[i].setFreq(5000 + i);
+    em[i].updateChannelValues();
+    handlers.push_back(new Supla::ModbusEMHandler(&em[i], i * meterRegisters));
+  }
+  Supla::ModbusClientHandler::BuildIndex();
+
+  uint8_t buffer[2 * 125] = {};
+  // phase 1 voltage of each meter
+  for (int i = 0; i < metersCount; i++) {
+    ASSERT_EQ(Supla::Modbus::Result::OK,
+              readHolding(i * meterRegisters + EM_REGISTER_BLOCK_MAX_SIZE,
+                          1,
+                          buffer));
+    EXPECT_EQ(23000 + i, (buffer[0] << 8) | buffer[1]);
+  }
+  // last registers of meter 0 followed by frequency of meter 1
+  ASSERT_EQ(Supla::Modbus::Result::OK,
+            readHolding(meterRegisters - 2, 3, buffer));
+  EXPECT_EQ(5001, (buffer[4] << 8) | buffer[5]);
+
+  const int iterations = 20000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    uint16_t address = (i * 37) % (metersCount * meterRegisters - 60);
+    ASSERT_EQ(Supla::Modbus::Result::OK, readHolding(address, 60, buffer));
+  }
+  auto elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  double requestsPerSecond = elapsed > 0 ? iterations / elapsed : 0;
+  printf("[ BENCHMARK ] 4x ModbusEMHandler, 60 register reads: %.0f req/s\n",
+         requestsPerSecond);
+  RecordProperty("requests_per_second", static_cast<int>(requestsPerSecond));
+
+  for (auto handler : handlers) {
+    delete handler;
+  }
+}
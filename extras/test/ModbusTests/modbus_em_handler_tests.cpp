@@ -0,0 +1,250 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <simple_time.h>
+#include <supla/channel.h>
+#include <supla/modbus/modbus_em_handler.h>
+#include <supla/sensor/electricity_meter.h>
+
+#include <cstring>
+
+namespace {
+
+// Exposes sequence lock steps, so reader and writer can be interleaved
+class SteppedEMHandler : public Supla::ModbusEMHandler {
+ public:
+  using Supla::ModbusEMHandler::ModbusEMHandler;
+  using Supla::ModbusEMHandler::beginImageRead;
+  using Supla::ModbusEMHandler::beginImageWrite;
+  using Supla::ModbusEMHandler::endImageWrite;
+  using Supla::ModbusEMHandler::validateImageRead;
+
+  uint16_t readImageRegister(int reg) const {
+    return (image[2 * reg] << 8) | image[2 * reg + 1];
+  }
+
+  void writeImageRegister(int reg, uint16_t value) {
+    image[2 * reg] = value >> 8;
+    image[2 * reg + 1] = value & 0xFF;
+  }
+};
+
+class ModbusEMHandlerTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  Supla::Modbus::Result read(uint16_t address, uint16_t nRegs) {
+    memset(buffer, 0xAA, sizeof(buffer));
+    return Supla::ModbusClientHandler::HoldingProcessRequest(
+        address, nRegs, buffer, Supla::Modbus::Access::READ);
+  }
+
+  uint16_t reg16(int reg) const {
+    return (buffer[2 * reg] << 8) | buffer[2 * reg + 1];
+  }
+
+  uint32_t reg32(int reg) const {
+    return (static_cast<uint32_t>(reg16(reg)) << 16) | reg16(reg + 1);
+  }
+
+  uint64_t reg64(int reg) const {
+    return (static_cast<uint64_t>(reg32(reg)) << 32) | reg32(reg + 2);
+  }
+
+  SimpleTime time;
+  uint8_t buffer[2 * 125] = {};
+};
+
+}  // namespace
+
+TEST_F(ModbusEMHandlerTests, RegisterLayout) {
+  Supla::Sensor::ElectricityMeter em;
+  Supla::ModbusEMHandler handler(&em, 100);
+
+  em.setFreq(5012);
+  em.setVoltagePhaseSequence(true);
+  em.setVoltagePhaseAngle12(1200);
+  em.setVoltagePhaseAngle13(2400);
+  em.setFwdBalancedEnergy(0x0000000123456789ull);
+  em.setRvrBalancedEnergy(42);
+  em.setVoltage(0, 23012);
+  em.setVoltage(2, 22999);
+  em.setCurrent(0, 1500);
+  em.setPowerActive(0, -12345600);
+  em.setPowerFactor(0, -950);
+  em.setFwdActEnergy(0, 0x0102030405060708ull);
+  em.setRvrReactEnergy(2, 7);
+  em.updateChannelValues();
+
+  // common block and phase 1 in a single request, including unused registers
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(100, 60));
+  EXPECT_EQ(5012, reg16(0));
+  EXPECT_EQ(2, reg16(1));  // clockwise
+  EXPECT_EQ(0, reg16(2));  // current phase sequence is not set
+  EXPECT_EQ(1200, reg16(3));
+  EXPECT_EQ(2400, reg16(4));
+  for (int reg = 5; reg < 10; reg++) {
+    EXPECT_EQ(0, reg16(reg)) << "register " << reg;
+  }
+  EXPECT_EQ(em.getFwdBalancedActEnergy(), reg64(10));
+  EXPECT_EQ(em.getRvrBalancedActEnergy(), reg64(14));
+  EXPECT_EQ(0x0000000123456789ull, reg64(10));
+
+  EXPECT_EQ(23012, reg16(30));
+  EXPECT_EQ(0, reg16(31));
+  EXPECT_EQ(static_cast<uint16_t>(-950), reg16(32));
+  EXPECT_EQ(0, reg16(33));
+  EXPECT_EQ(1500u, reg32(34));
+  EXPECT_EQ(static_cast<uint32_t>(em.getPowerActive(0) / 100), reg32(36));
+  EXPECT_EQ(-123456, static_cast<int32_t>(reg32(36)));
+  EXPECT_EQ(0x0102030405060708ull, reg64(42));
+
+  // phase 3 read with offset inside of 64 bit value
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(100 + 90, 30));
+  EXPECT_EQ(22999, reg16(0));
+  EXPECT_EQ(7u, reg64(24));
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(100 + 90 + 26, 2));
+  EXPECT_EQ(7u, reg32(0));
+
+  // input registers are served from the same image
+  memset(buffer, 0, sizeof(buffer));
+  ASSERT_EQ(Supla::Modbus::Result::OK,
+            Supla::ModbusClientHandler::InputProcessRequest(130, 1, buffer));
+  EXPECT_EQ(23012, reg16(0));
+}
+
+TEST_F(ModbusEMHandlerTests, ImageIsUpdatedOnlyWhenValuesArePublished) {
+  Supla::Sensor::ElectricityMeter em;
+  Supla::ModbusEMHandler handler(&em);
+  time.advance(1000);
+  em.setVoltage(0, 23000);
+  em.setCurrent(0, 1000);
+  em.updateChannelValues();
+  auto version = handler.getImageVersion();
+
+  // values set by the device driver are not visible until they are published
+  em.setVoltage(0, 24000);
+  em.setCurrent(0, 2000);
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(30, 6));
+  EXPECT_EQ(23000, reg16(0));
+  EXPECT_EQ(1000u, reg32(4));
+  EXPECT_EQ(version, handler.getImageVersion());
+
+  em.updateChannelValues();
+  EXPECT_EQ(version + 1, handler.getImageVersion());
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(30, 6));
+  EXPECT_EQ(24000, reg16(0));
+  EXPECT_EQ(2000u, reg32(4));
+
+  // no change -> no image update
+  em.updateChannelValues();
+  EXPECT_EQ(version + 1, handler.getImageVersion());
+}
+
+TEST_F(ModbusEMHandlerTests, InvalidRequests) {
+  Supla::Sensor::ElectricityMeter em;
+  Supla::ModbusEMHandler handler(&em, 10);
+  em.updateChannelValues();
+
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS, read(9, 2));
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS, read(129, 2));
+  EXPECT_EQ(Supla::Modbus::Result::OK, read(129, 1));
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS,
+            Supla::ModbusClientHandler::HoldingProcessRequest(
+                10, 1, buffer, Supla::Modbus::Access::WRITE));
+
+  Supla::ModbusEMHandler nullHandler(nullptr, 200);
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS, read(200, 1));
+}
+
+TEST_F(ModbusEMHandlerTests, HandlerDeletedBeforeMeter) {
+  Supla::Sensor::ElectricityMeter em;
+  {
+    Supla::ModbusEMHandler handler(&em);
+    em.setVoltage(0, 23000);
+    em.updateChannelValues();
+  }
+  em.setVoltage(0, 23100);
+  em.updateChannelValues();
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_REGISTER_ADDRESS, read(30, 1));
+}
+
+TEST_F(ModbusEMHandlerTests, ReadOverlappingNextWriteIsRejected) {
+  Supla::Sensor::ElectricityMeter em;
+  SteppedEMHandler handler(&em);
+  time.advance(1000);
+  em.setVoltage(0, 23000);
+  em.updateChannelValues();
+
+  // reader copies image A
+  uint32_t sequence = handler.beginImageRead();
+  uint16_t copied = handler.readImageRegister(30);
+  EXPECT_EQ(23000, copied);
+
+  // writer publishes image B
+  em.setVoltage(0, 23100);
+  em.updateChannelValues();
+
+  // writer starts next update and overwrites part of the image
+  handler.beginImageWrite();
+  handler.writeImageRegister(30, 0xFFFF);
+
+  // reader's copy can't be accepted
+  EXPECT_FALSE(handler.validateImageRead(sequence));
+
+  // reader which starts during the write has to retry
+  sequence = handler.beginImageRead();
+  EXPECT_FALSE(handler.validateImageRead(sequence));
+  EXPECT_EQ(Supla::Modbus::Result::INVALID_STATE, read(30, 1));
+
+  handler.writeImageRegister(30, 23200);
+  handler.endImageWrite();
+
+  sequence = handler.beginImageRead();
+  EXPECT_EQ(23200, handler.readImageRegister(30));
+  EXPECT_TRUE(handler.validateImageRead(sequence));
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(30, 1));
+  EXPECT_EQ(23200, reg16(0));
+}
+
+TEST_F(ModbusEMHandlerTests, AggregatedValuesCanBeSelected) {
+  Supla::Sensor::ElectricityMeter em;
+  Supla::ModbusEMHandler handler(&em);
+  time.advance(1000);
+  em.setRefreshRate(1);
+  em.enableSampleAggregation(10);
+
+  // Modbus follows channel value (mean) until other mode is selected
+  int voltage = 22000;
+  for (int i = 0; i <= 1001; i++) {
+    if (i % 10 == 0) {
+      voltage += 100;
+    }
+    em.setVoltage(0, voltage);
+    em.iterateAlways();
+    time.advance(1);
+  }
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(30, 1));
+  EXPECT_EQ(em.getAggregatedValue(Supla::Sensor::EmAggregatedValue::Voltage,
+                                  0,
+                                  Supla::Sensor::EmAggregationMode::Mean),
+            reg16(0));
+
+  handler.setAggregationMode(Supla::Sensor::EmAggregationMode::Max);
+  ASSERT_EQ(Supla::Modbus::Result::OK, read(30, 1));
+  EXPECT_EQ(em.getAggregatedValue(Supla::Sensor::EmAggregatedValue::Voltage,
+                                  0,
+                                  Supla::Sensor::EmAggregationMode::Max),
+            reg16(0));
+  EXPECT_GT(reg16(0),
+            em.getAggregatedValue(Supla::Sensor::EmAggregatedValue::Voltage,
+                                  0,
+                                  Supla::Sensor::EmAggregationMode::Mean));
+}
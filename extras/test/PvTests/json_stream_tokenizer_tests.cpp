@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <supla/pv/json_stream_tokenizer.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+class ValueCollector : public Supla::PV::JsonValueHandler {
+ public:
+  void onJsonValue(int keyId, const char *value) override {
+    ids.push_back(keyId);
+    values.push_back(value);
+  }
+
+  std::vector<int> ids;
+  std::vector<std::string> values;
+};
+
+const char *const froniusKeys[] = {"Body/Data/PAC/Value",
+                                   "Body/Data/FAC/Value",
+                                   "Body/Data/DeviceStatus/StatusCode",
+                                   "Head/Status/Reason"};
+
+const char froniusResponse[] = R"json({
+  "Body" : {
+    "Data" : {
+      "DAY_ENERGY" : { "Unit" : "Wh", "Value" : 1234.5 },
+      "DeviceStatus" : {
+        "ErrorCode" : 0,
+        "StatusCode" : 7
+      },
+      "FAC" : { "Unit" : "Hz", "Value" : 50.01 },
+      "PAC" : { "Unit" : "W", "Value" : 2543 }
+    }
+  },
+  "Head" : {
+    "RequestArguments" : { "DataCollection" : "CommonInverterData" },
+    "Status" : { "Code" : 0, "Reason" : "", "UserMessage" : "" },
+    "Timestamp" : "2024-05-01T12:00:00+02:00"
+  }
+})json";
+
+}  // namespace
+
+TEST(JsonStreamTokenizerTests, ReportsOnlySubscribedValues) {
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  tokenizer.setKeys(froniusKeys, 4);
+
+  tokenizer.feed(froniusResponse, strlen(froniusResponse));
+
+  EXPECT_TRUE(tokenizer.isComplete());
+  EXPECT_FALSE(tokenizer.isError());
+  ASSERT_EQ(collector.ids.size(), 4);
+  EXPECT_EQ(collector.ids[0], 2);
+  EXPECT_EQ(collector.values[0], "7");
+  EXPECT_EQ(collector.ids[1], 1);
+  EXPECT_EQ(collector.values[1], "50.01");
+  EXPECT_EQ(collector.ids[2], 0);
+  EXPECT_EQ(collector.values[2], "2543");
+  EXPECT_EQ(collector.ids[3], 3);
+  EXPECT_EQ(collector.values[3], "");
+}
+
+TEST(JsonStreamTokenizerTests, InputSplitAtEveryPosition) {
+  int length = strlen(froniusResponse);
+  for (int split = 1; split < length; split++) {
+    ValueCollector collector;
+    Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+    tokenizer.setKeys(froniusKeys, 4);
+
+    tokenizer.feed(froniusResponse, split);
+    tokenizer.feed(froniusResponse + split, length - split);
+
+    EXPECT_TRUE(tokenizer.isComplete()) << "split " << split;
+    ASSERT_EQ(collector.values.size(), 4) << "split " << split;
+    EXPECT_EQ(collector.values[1], "50.01") << "split " << split;
+    EXPECT_EQ(collector.values[2], "2543") << "split " << split;
+  }
+}
+
+TEST(JsonStreamTokenizerTests, ArraysEscapesAndLiterals) {
+  const char *const keys[] = {"list/1/name",
+                              "list/2",
+                              "flag",
+                              "empty",
+                              "esc\"aped",
+                              "nested/0/1"};
+  const char json[] =
+      R"json({"list": [{"name": "a"}, {"name": "b\"c\\"}, null],)json"
+      R"json("empty": {}, "flag": true, "esc\"aped": -1.5e3,)json"
+      R"json("nested": [[1, 2], [3]]})json";
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  tokenizer.setKeys(keys, 6);
+
+  tokenizer.feed(json, strlen(json));
+
+  EXPECT_TRUE(tokenizer.isComplete());
+  ASSERT_EQ(collector.ids.size(), 5);
+  EXPECT_EQ(collector.ids[0], 0);
+  EXPECT_EQ(collector.values[0], "b\"c\\");
+  EXPECT_EQ(collector.ids[1], 1);
+  EXPECT_EQ(collector.values[1], "null");
+  EXPECT_EQ(collector.ids[2], 2);
+  EXPECT_EQ(collector.values[2], "true");
+  EXPECT_EQ(collector.ids[3], 4);
+  EXPECT_EQ(collector.values[3], "-1.5e3");
+  EXPECT_EQ(collector.ids[4], 5);
+  EXPECT_EQ(collector.values[4], "2");
+}
+
+TEST(JsonStreamTokenizerTests, TooLongValueIsSkipped) {
+  const char *const keys[] = {"a", "b"};
+  std::string json = "{\"a\": \"" + std::string(100, 'x') + "\", \"b\": 5}";
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  tokenizer.setKeys(keys, 2);
+
+  tokenizer.feed(json.c_str(), json.length());
+
+  EXPECT_TRUE(tokenizer.isComplete());
+  ASSERT_EQ(collector.ids.size(), 1);
+  EXPECT_EQ(collector.ids[0], 1);
+  EXPECT_EQ(collector.values[0], "5");
+}
+
+TEST(JsonStreamTokenizerTests, MalformedInputAndReset) {
+  const char *const keys[] = {"a"};
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  tokenizer.setKeys(keys, 1);
+
+  const char broken[] = "{\"a\" 1}";
+  tokenizer.feed(broken, strlen(broken));
+  EXPECT_TRUE(tokenizer.isError());
+  EXPECT_FALSE(tokenizer.isComplete());
+  EXPECT_TRUE(collector.ids.empty());
+
+  const char mismatched[] = "{\"a\": [1}";
+  tokenizer.reset();
+  tokenizer.feed(mismatched, strlen(mismatched));
+  EXPECT_TRUE(tokenizer.isError());
+
+  const char valid[] = "{\"a\": 12}";
+  tokenizer.reset();
+  EXPECT_FALSE(tokenizer.isError());
+  tokenizer.feed(valid, strlen(valid));
+  EXPECT_TRUE(tokenizer.isComplete());
+  ASSERT_EQ(collector.values.size(), 1);
+  EXPECT_EQ(collector.values[0], "12");
+}
+
+TEST(JsonStreamTokenizerTests, TooDeepDocument) {
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+
+  std::string json(SUPLA_JSON_STREAM_MAX_DEPTH + 1, '[');
+  tokenizer.feed(json.c_str(), json.length());
+  EXPECT_TRUE(tokenizer.isError());
+}
+
+TEST(JsonStreamTokenizerTests, PathOverflowAppliesToNestedValues) {
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  // matches truncated path of the nested value
+  std::string truncated(SUPLA_JSON_STREAM_MAX_PATH - 1, 'a');
+  const char *const keys[] = {truncated.c_str(), "b"};
+  tokenizer.setKeys(keys, 2);
+
+  std::string json = "{\"" + std::string(SUPLA_JSON_STREAM_MAX_PATH, 'a') +
+                     "\": {\"x\": 1, \"y\": [2]}, \"b\": 3}";
+  tokenizer.feed(json.c_str(), json.length());
+  EXPECT_TRUE(tokenizer.isComplete());
+  ASSERT_EQ(collector.values.size(), 1);
+  EXPECT_EQ(collector.ids[0], 1);
+  EXPECT_EQ(collector.values[0], "3");
+}
+
+TEST(JsonStreamTokenizerTests, TopLevelLiteralIsReportedOnFinish) {
+  ValueCollector collector;
+  Supla::PV::JsonStreamTokenizer tokenizer(&collector);
+  const char *const keys[] = {""};
+  tokenizer.setKeys(keys, 1);
+
+  tokenizer.feed("-12.5", 5);
+  EXPECT_FALSE(tokenizer.isComplete());
+  EXPECT_TRUE(collector.values.empty());
+  tokenizer.finish();
+  EXPECT_TRUE(tokenizer.isComplete());
+  ASSERT_EQ(collector.values.size(), 1);
+  EXPECT_EQ(collector.values[0], "-12.5");
+
+  // finish doesn't complete unterminated containers
+  tokenizer.reset();
+  tokenizer.feed("[1", 2);
+  tokenizer.finish();
+  EXPECT_FALSE(tokenizer.isComplete());
+  EXPECT_EQ(collector.values.size(), 1);
+}
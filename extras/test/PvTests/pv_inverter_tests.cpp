@@ -0,0 +1,461 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <clock_mock.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <network_client_mock.h>
+#include <simple_time.h>
+#include <string.h>
+#include <supla/channel.h>
+#include <supla/pv/afore.h>
+#include <supla/pv/fronius.h>
+#include <supla/pv/solaredge.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+namespace {
+
+/**
+ * Scripted HTTP server behind NetworkClientMock. Each request written by
+ * the client is answered with the next queued response. When there is no
+ * response queued, server keeps connection open and doesn't respond.
+ */
+class MockInverter {
+ public:
+  struct Response {
+    std::string data;
+    bool closeAfter = false;
+  };
+
+  MockInverter() : client(new NiceMock<NetworkClientMock>) {
+    // client is deleted by HttpPoller
+    ON_CALL(*client, connectImp(_, _))
+        .WillByDefault([this](const char *host, uint16_t port) {
+          lastHost = host;
+          lastPort = port;
+          if (refuseConnections) {
+            return 0;
+          }
+          connections++;
+          open = true;
+          reset();
+          return 1;
+        });
+    ON_CALL(*client, writeImp(_, _))
+        .WillByDefault([this](const uint8_t *buf, size_t size) -> size_t {
+          if (!open || closing) {
+            return 0;
+          }
+          requests.emplace_back(reinterpret_cast<const char *>(buf), size);
+          if (closeOnNextRequest) {
+            closeOnNextRequest = false;
+            closing = true;
+          } else {
+            pendingRequests++;
+          }
+          return size;
+        });
+    ON_CALL(*client, available()).WillByDefault([this]() {
+      pump();
+      return open ? static_cast<int>(rx.size()) : 0;
+    });
+    ON_CALL(*client, readImp(_, _))
+        .WillByDefault([this](uint8_t *buf, size_t size) {
+          pump();
+          readCalls++;
+          if (!open || (rx.empty() && closing)) {
+            open = false;
+            return 0;
+          }
+          if (rx.empty()) {
+            return -1;
+          }
+          size_t count = std::min(size, rx.size());
+          memcpy(buf, rx.data(), count);
+          rx.erase(0, count);
+          return static_cast<int>(count);
+        });
+    ON_CALL(*client, connected()).WillByDefault([this]() {
+      pump();
+      return open && !(closing && rx.empty());
+    });
+    ON_CALL(*client, stop()).WillByDefault([this]() {
+      open = false;
+      reset();
+    });
+  }
+
+  void reset() {
+    closing = false;
+    pendingRequests = 0;
+    rx.clear();
+  }
+
+  void pump() {
+    while (open && !closing && pendingRequests > 0 && !responses.empty()) {
+      rx += responses.front().data;
+      closing = responses.front().closeAfter;
+      responses.pop_front();
+      pendingRequests--;
+    }
+  }
+
+  void addResponse(const std::string &body,
+                   bool chunked = false,
+                   bool closeAfter = false,
+                   const char *contentType = "application/json") {
+    Response response;
+    response.data =
+        "HTTP/1.1 200 OK\r\nContent-Type: " + std::string(contentType) +
+        "\r\n";
+    if (closeAfter) {
+      response.data += "Connection: close\r\n";
+    }
+    if (chunked) {
+      response.data += "Transfer-Encoding: chunked\r\n\r\n";
+      // split body into chunks of various sizes
+      size_t pos = 0;
+      size_t chunkSize = 7;
+      while (pos < body.size()) {
+        size_t size = std::min(chunkSize, body.size() - pos);
+        char sizeHex[16] = {};
+        snprintf(sizeHex, sizeof(sizeHex), "%zx\r\n", size);
+        response.data += sizeHex + body.substr(pos, size) + "\r\n";
+        pos += size;
+        chunkSize = chunkSize * 3 + 1;
+      }
+      response.data += "0\r\n\r\n";
+    } else if (closeAfter) {
+      response.data += "\r\n" + body;
+    } else {
+      response.data += "Content-Length: " + std::to_string(body.size()) +
+                       "\r\n\r\n" + body;
+    }
+    response.closeAfter = closeAfter;
+    responses.push_back(response);
+  }
+
+  NiceMock<NetworkClientMock> *client = nullptr;
+  std::deque<Response> responses;
+  std::vector<std::string> requests;
+  std::string rx;
+  std::string lastHost;
+  uint16_t lastPort = 0;
+  int connections = 0;
+  int readCalls = 0;
+  int pendingRequests = 0;
+  bool open = false;
+  bool closing = false;
+  bool refuseConnections = false;
+  bool closeOnNextRequest = false;
+};
+
+const char singlePhaseInverterData[] = R"json({
+  "Body" : {
+    "Data" : {
+      "DAY_ENERGY" : { "Unit" : "Wh", "Value" : 8000 },
+      "FAC" : { "Unit" : "Hz", "Value" : 50.02 },
+      "IAC" : { "Unit" : "A", "Value" : 10.5 },
+      "PAC" : { "Unit" : "W", "Value" : 2410 },
+      "TOTAL_ENERGY" : { "Unit" : "Wh", "Value" : 1234567 },
+      "UAC" : { "Unit" : "V", "Value" : 231.4 }
+    }
+  },
+  "Head" : { "Status" : { "Code" : 0 } }
+})json";
+
+const char commonInverterData[] = R"json({
+  "Body" : {
+    "Data" : {
+      "FAC" : { "Unit" : "Hz", "Value" : 49.98 },
+      "IAC" : { "Unit" : "A", "Value" : 13.2 },
+      "PAC" : { "Unit" : "W", "Value" : 6000 },
+      "TOTAL_ENERGY" : { "Unit" : "Wh", "Value" : 3000 }
+    }
+  }
+})json";
+
+const char threePhaseInverterData[] = R"json({
+  "Body" : {
+    "Data" : {
+      "IAC_L1" : { "Unit" : "A", "Value" : 4.1 },
+      "IAC_L2" : { "Unit" : "A", "Value" : 4.2 },
+      "IAC_L3" : { "Unit" : "A", "Value" : 4.3 },
+      "UAC_L1" : { "Unit" : "V", "Value" : 231 },
+      "UAC_L2" : { "Unit" : "V", "Value" : 232 },
+      "UAC_L3" : { "Unit" : "V", "Value" : 233 }
+    }
+  }
+})json";
+
+class PvInverterTests : public ::testing::Test {
+ protected:
+  SimpleTime time;
+
+  void SetUp() override {
+    Supla::Channel::resetToDefaults();
+    // lastReadTime == 0 is used by elements as "never read"
+    time.advance(1000);
+  }
+
+  void TearDown() override {
+    Supla::Channel::resetToDefaults();
+  }
+
+  template <typename T>
+  void run(T *element, int steps) {
+    for (int i = 0; i < steps; i++) {
+      element->iterateConnected();
+      element->iterateAlways();
+      time.advance(100);
+    }
+  }
+};
+
+}  // namespace
+
+TEST_F(PvInverterTests, FroniusSinglePhaseReusesConnection) {
+  MockInverter inverter;
+  inverter.addResponse(singlePhaseInverterData);
+  Supla::PV::Fronius fronius(IPAddress(192, 168, 1, 20), 8080, 3, 0);
+
+  run(&fronius, 5);
+
+  EXPECT_EQ(inverter.lastHost, "192.168.1.20");
+  EXPECT_EQ(inverter.lastPort, 8080);
+  ASSERT_EQ(inverter.requests.size(), 1);
+  EXPECT_EQ(inverter.requests[0],
+            "GET /solar_api/v1/GetInverterRealtimeData.cgi?Scope=Device&"
+            "DeviceID=3&DataCollection=CommonInverterData HTTP/1.1\r\n"
+            "Host: 192.168.1.20\r\nConnection: keep-alive\r\n\r\n");
+  EXPECT_EQ(fronius.getFwdActEnergy(0), 123456700);
+  EXPECT_EQ(fronius.getPowerActive(0), 241000000);
+  EXPECT_EQ(fronius.getFreq(), 5002);
+  EXPECT_EQ(fronius.getCurrent(0), 10500);
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+
+  // next query after refresh period goes over the same connection
+  inverter.addResponse(singlePhaseInverterData);
+  run(&fronius, 160);
+  EXPECT_EQ(inverter.requests.size(), 2);
+  EXPECT_EQ(inverter.connections, 1);
+}
+
+TEST_F(PvInverterTests, FroniusThreePhaseInverterChunkedResponses) {
+  MockInverter inverter;
+  inverter.addResponse(commonInverterData, true);
+  inverter.addResponse(threePhaseInverterData, true);
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 2), 80, 1, 1);
+
+  run(&fronius, 5);
+
+  // both data collections are fetched in one cycle over one connection
+  ASSERT_EQ(inverter.requests.size(), 2);
+  EXPECT_NE(inverter.requests[0].find("DataCollection=CommonInverterData"),
+            std::string::npos);
+  EXPECT_NE(inverter.requests[1].find("DataCollection=3PInverterData"),
+            std::string::npos);
+  EXPECT_EQ(inverter.connections, 1);
+
+  EXPECT_EQ(fronius.getFreq(), 4998);
+  EXPECT_EQ(fronius.getCurrent(0), 4100);
+  EXPECT_EQ(fronius.getCurrent(1), 4200);
+  EXPECT_EQ(fronius.getCurrent(2), 4300);
+  EXPECT_EQ(fronius.getVoltage(0), 23100);
+  EXPECT_EQ(fronius.getVoltage(1), 23200);
+  EXPECT_EQ(fronius.getVoltage(2), 23300);
+  EXPECT_EQ(fronius.getPowerActive(0), 200000000);
+  EXPECT_EQ(fronius.getPowerActive(2), 200000000);
+  EXPECT_EQ(fronius.getFwdActEnergy(1), 100000);
+}
+
+TEST_F(PvInverterTests, FroniusMeterLargeResponseIsReadInBulk) {
+  MockInverter inverter;
+  std::string body = R"json({"Body": {"Data": {)json";
+  // unrelated data, which has to be skipped
+  for (int i = 0; i < 200; i++) {
+    body += "\"Unused_" + std::to_string(i) + "\": " + std::to_string(i) +
+            ".125, ";
+  }
+  body += R"json("Voltage_AC_Phase_1": 229.5, "Voltage_AC_Phase_3": 230.5,
+    "Current_AC_Phase_2": 1.5, "EnergyReal_WAC_Sum_Consumed": 5000,
+    "EnergyReal_WAC_Sum_Produced": 7000, "PowerReal_P_Phase_2": -350.5,
+    "Frequency_Phase_Average": 50, "PowerFactor_Phase_1": 0.95,
+    "Details": {"Serial": "123", "Voltage_AC_Phase_2": 1}}}})json";
+  ASSERT_GT(body.size(), 4000);
+  inverter.addResponse(body);
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 3), 80, 0, 2);
+
+  run(&fronius, 10);
+
+  ASSERT_EQ(inverter.requests.size(), 1);
+  EXPECT_NE(inverter.requests[0].find(
+                "GetMeterRealtimeData.cgi?Scope=Device&DeviceId=0 HTTP/1.1"),
+            std::string::npos);
+  EXPECT_EQ(fronius.getVoltage(0), 22950);
+  EXPECT_EQ(fronius.getVoltage(1), 0);
+  EXPECT_EQ(fronius.getVoltage(2), 23050);
+  EXPECT_EQ(fronius.getCurrent(1), 1500);
+  EXPECT_EQ(fronius.getFwdActEnergy(0), 500000);
+  EXPECT_EQ(fronius.getRvrActEnergy(0), 700000);
+  EXPECT_EQ(fronius.getPowerActive(1), -35050000);
+  EXPECT_EQ(fronius.getFreq(), 5000);
+  EXPECT_EQ(fronius.getPowerFactor(0), 950);
+
+  // response is read in SUPLA_HTTP_POLLER_READ_CHUNK blocks
+  int responseSize = body.size() + 100;
+  EXPECT_LE(inverter.readCalls,
+            responseSize / SUPLA_HTTP_POLLER_READ_CHUNK + 2);
+}
+
+TEST_F(PvInverterTests, StalledServerTimesOutWithoutBlocking) {
+  MockInverter inverter;
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 4), 80, 1, 0);
+
+  // 29 s without response - request is still in progress
+  run(&fronius, 290);
+  EXPECT_EQ(inverter.requests.size(), 1);
+  EXPECT_TRUE(inverter.open);
+  EXPECT_EQ(fronius.getVoltage(0), 0);
+
+  // after timeout connection is dropped and, as refresh period already
+  // passed, next query is sent on a new connection
+  run(&fronius, 20);
+  EXPECT_EQ(inverter.requests.size(), 2);
+  EXPECT_EQ(inverter.connections, 2);
+  EXPECT_EQ(fronius.getVoltage(0), 0);
+
+  inverter.addResponse(singlePhaseInverterData);
+  run(&fronius, 5);
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+  EXPECT_EQ(inverter.requests.size(), 2);
+}
+
+TEST_F(PvInverterTests, ClosedKeepAliveConnectionIsRetried) {
+  MockInverter inverter;
+  inverter.addResponse(singlePhaseInverterData);
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 5), 80, 1, 0);
+  run(&fronius, 5);
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+  EXPECT_EQ(inverter.connections, 1);
+
+  // server drops idle connection while our request is on the way
+  inverter.closeOnNextRequest = true;
+  inverter.addResponse(R"json({"Body": {"Data": {
+      "UAC": {"Value": 229.9}}}})json");
+  run(&fronius, 160);
+
+  EXPECT_EQ(inverter.requests.size(), 3);
+  EXPECT_EQ(inverter.requests[1], inverter.requests[2]);
+  EXPECT_EQ(inverter.connections, 2);
+  EXPECT_EQ(fronius.getVoltage(0), 22990);
+}
+
+TEST_F(PvInverterTests, FroniusTruncatedResponseIsRejected) {
+  MockInverter inverter;
+  inverter.addResponse(singlePhaseInverterData);
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 7), 80, 1, 0);
+  run(&fronius, 5);
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+
+  // connection is closed in the middle of the body
+  inverter.addResponse(R"json({"Body": {"Data": {
+      "UAC": {"Value": 229.9}, "FAC": {"Val)json",
+                       false,
+                       true);
+  run(&fronius, 160);
+  EXPECT_EQ(inverter.requests.size(), 2);
+  EXPECT_EQ(fronius.getVoltage(0), 23140);
+  EXPECT_EQ(fronius.getFreq(), 5002);
+
+  // next complete response is accepted
+  inverter.addResponse(R"json({"Body": {"Data": {
+      "UAC": {"Value": 229.9}}}})json");
+  run(&fronius, 160);
+  EXPECT_EQ(inverter.requests.size(), 3);
+  EXPECT_EQ(fronius.getVoltage(0), 22990);
+}
+
+TEST_F(PvInverterTests, FroniusUnreachable) {
+  MockInverter inverter;
+  inverter.refuseConnections = true;
+  Supla::PV::Fronius fronius(IPAddress(10, 0, 0, 6), 80, 1, 0);
+
+  run(&fronius, 160 * 5);
+  EXPECT_EQ(inverter.requests.size(), 0);
+  EXPECT_EQ(fronius.getVoltage(0), 0);
+  EXPECT_EQ(fronius.getFreq(), 0);
+}
+
+TEST_F(PvInverterTests, SolarEdgeCsvOverSslWithoutKeepAlive) {
+  MockInverter inverter;
+  ClockMock clock;
+  EXPECT_CALL(clock, isReady()).WillRepeatedly(Return(true));
+  std::string csv =
+      "date,inverterMode,temperature,totalActivePower,dcVoltage,"
+      "groundFaultResistance,powerLimit,totalEnergy,vL1To2,vL2To3,vL3To1,L1-"
+      "acCurrent,L1-acVoltage,L1-acFrequency,L1-apparentPower,L1-activePower,"
+      "L1-reactivePower,L1-qRef,L1-cosPhi,L2-acCurrent,L2-acVoltage,"
+      "L2-acFrequency,L2-apparentPower,L2-activePower,L2-reactivePower,L2-qRef,"
+      "L2-cosPhi,L3-acCurrent,L3-acVoltage,L3-acFrequency,L3-apparentPower,"
+      "L3-activePower,L3-reactivePower,L3-qRef,L3-cosPhi\r\n"
+      "2024-05-01 12:00:00,MPPT,41.5,5000,700,1000,100,30000,400,400,400,"
+      "7.1,230.5,50.01,1700,1650,10,0,1,7.2,231.5,50.01,1700,1660,11,0,1,"
+      "7.3,232.5,50.01,1700,1670,12,0,1\r\n";
+  inverter.addResponse(csv, false, true, "text/csv");
+  Supla::PV::SolarEdge solarEdge("key", "1234", "ABC-1", &clock);
+  EXPECT_TRUE(inverter.client->getRootCACert() != nullptr);
+
+  run(&solarEdge, 5);
+
+  EXPECT_EQ(inverter.lastHost, "monitoringapi.solaredge.com");
+  EXPECT_EQ(inverter.lastPort, 443);
+  ASSERT_EQ(inverter.requests.size(), 1);
+  EXPECT_EQ(inverter.requests[0].find("GET /equipment/1234/ABC-1/data.csv?"),
+            0);
+  EXPECT_NE(inverter.requests[0].find("&api_key=key HTTP/1.1\r\n"),
+            std::string::npos);
+  EXPECT_NE(inverter.requests[0].find("Connection: close\r\n"),
+            std::string::npos);
+  EXPECT_FALSE(inverter.open);
+
+  EXPECT_EQ(solarEdge.getFwdActEnergy(0), 1000000);
+  EXPECT_EQ(solarEdge.getVoltage(0), 23050);
+  EXPECT_EQ(solarEdge.getVoltage(2), 23250);
+  EXPECT_EQ(solarEdge.getCurrent(1), 7200);
+  EXPECT_EQ(solarEdge.getPowerActive(2), 167000000);
+  EXPECT_EQ(solarEdge.getFreq(), 5001);
+  EXPECT_DOUBLE_EQ(solarEdge.getSecondaryChannel()->getValueDouble(), 41.5);
+}
+
+TEST_F(PvInverterTests, AforeStatusPage) {
+  MockInverter inverter;
+  inverter.addResponse(
+      "<html><script>\n"
+      "var webdata_sn = \"AF123\";\n"
+      "  var webdata_now_p = \"1520\";\n"
+      "var webdata_total_e = \"12.5\";\n"
+      "</script></html>",
+      false,
+      true,
+      "text/html");
+  Supla::PV::Afore afore(IPAddress(192, 168, 0, 9), 80, "YWRtaW46YWRtaW4=");
+
+  run(&afore, 5);
+
+  ASSERT_EQ(inverter.requests.size(), 1);
+  EXPECT_EQ(inverter.requests[0],
+            "GET /status.html HTTP/1.1\r\nHost: 192.168.0.9\r\n"
+            "Connection: keep-alive\r\n"
+            "Authorization: Basic YWRtaW46YWRtaW4=\r\n\r\n");
+  EXPECT_EQ(afore.getPowerActive(0), 152000000);
+  EXPECT_EQ(afore.getFwdActEnergy(0), 1250000);
+}
@@ -720,9 +720,11 @@ TEST_F(RelayRollerShutterPairFixture,
   EXPECT_CALL(config, eraseKey(StrEq("0_fnc"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("0_cfg_chng")))
       .WillOnce(Return(true));
+  EXPECT_CALL(config, eraseKey(StrEq("0_rep_pol"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("0_oc_thr"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("1_fnc"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("1_cfg_chng"))).WillOnce(Return(true));
+  EXPECT_CALL(config, eraseKey(StrEq("1_rep_pol"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("1_oc_thr"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("0_rs_cfg"))).WillOnce(Return(true));
   EXPECT_CALL(config, eraseKey(StrEq("0_tilt_cfg"))).WillOnce(Return(true));
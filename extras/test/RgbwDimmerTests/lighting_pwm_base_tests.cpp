@@ -9,6 +9,8 @@
 #include <storage_mock.h>
 #include <simple_time.h>
 
+#include <math.h>
+
 using ::testing::Return;
 using ::testing::_;
 using ::testing::Le;
@@ -28,8 +30,58 @@ class RgbCctBaseForTest : public Supla::Control::LightingPwmBase {
   void setMaxHwValueForTest(int value) {
     setMaxHwValue(value);
   }
+
+  int adjustBrightnessForTest(int value) {
+    return adjustBrightness(value);
+  }
+
+  void setFadeEffectForTest(int timeMs, int maxHw) {
+    fadeEffect = timeMs;
+    maxHwValue = maxHw;
+  }
+
+  bool updateFadeForTest(int target,
+                         int16_t *hwValue,
+                         uint16_t distance,
+                         uint32_t *lastChangeMs,
+                         uint32_t now) {
+    FadeChannel fadeChannel = {target, hwValue, distance, lastChangeMs};
+    return updateFade(&fadeChannel, 1, now);
+  }
 };
 
+// Previous implementation of GeometricBrightnessAdjuster::adjustBrightness
+int referenceGeometricBrightness(int input,
+                                 double power,
+                                 int offset,
+                                 int maxHwValue) {
+  if (input == 0) {
+    return 0;
+  }
+  double result = pow((input + offset) / (100.0 + offset), power);
+  result = result * maxHwValue;
+  if (result > maxHwValue) {
+    result = maxHwValue;
+  }
+  return round(result);
+}
+
+// Previous (floating point) fade step calculation
+int referenceFadeStep(int distance,
+                      uint32_t timeDiff,
+                      int fadeEffect,
+                      int maxHwValue) {
+  int fadeTime = fadeEffect;
+  if (distance < maxHwValue / 10) {
+    fadeTime = fadeEffect / 3;
+  }
+  float divider = 1.0 * fadeTime / timeDiff;
+  if (divider <= 1) {
+    divider = 1;
+  }
+  return distance / divider;
+}
+
 void setRGBCCTValues(TRGBW_Value *value,
                int red,
                int green,
@@ -277,3 +329,79 @@ TEST(RgbCctTests, LegacyStorageMigrationIsOptIn) {
   rgb.setSkipLegacyMigration();
   EXPECT_FALSE(rgb.isStateStorageMigrationNeeded());
 }
+
+TEST(RgbCctTests, GeometricBrightnessCurveMatchesFormula) {
+  struct {
+    double power;
+    int offset;
+    int maxHwValue;
+  } params[] = {
+      {1.505, 0, 1023}, {1.505, 0, 255}, {2.2, 5, 4095}, {1.0, 0, 100},
+      {1.7, 20, 65535}, {0.5, 0, 1}};
+
+  for (auto &param : params) {
+    Supla::Control::GeometricBrightnessAdjuster adjuster(
+        param.power, param.offset, param.maxHwValue);
+    for (int input = 0; input <= 100; input++) {
+      int expected = referenceGeometricBrightness(
+          input, param.power, param.offset, param.maxHwValue);
+      EXPECT_NEAR(adjuster.adjustBrightness(input), expected, 1)
+          << "power " << param.power << " maxHwValue " << param.maxHwValue
+          << " input " << input;
+    }
+  }
+
+  // table is rebuilt for new hw range
+  Supla::Control::GeometricBrightnessAdjuster adjuster;
+  EXPECT_EQ(adjuster.adjustBrightness(100), 1023);
+  adjuster.setMaxHwValue(255);
+  EXPECT_EQ(adjuster.adjustBrightness(100), 255);
+  for (int input = 0; input <= 100; input++) {
+    EXPECT_NEAR(adjuster.adjustBrightness(input),
+                referenceGeometricBrightness(input, 1.505, 0, 255),
+                1);
+  }
+  // values out of 0..100 range are still calculated
+  EXPECT_EQ(adjuster.adjustBrightness(150), 255);
+}
+
+TEST(RgbCctTests, BrightnessAdjusterFollowsMaxHwValue) {
+  RgbCctBaseForTest rgb;
+  rgb.setBrightnessAdjuster(new Supla::Control::GeometricBrightnessAdjuster());
+  EXPECT_EQ(rgb.adjustBrightnessForTest(100), 1023);
+  EXPECT_EQ(rgb.adjustBrightnessForTest(50),
+            referenceGeometricBrightness(50, 1.505, 0, 1023));
+
+  rgb.setMaxHwValueForTest(4095);
+  EXPECT_EQ(rgb.adjustBrightnessForTest(100), 4095);
+  EXPECT_EQ(rgb.adjustBrightnessForTest(50),
+            referenceGeometricBrightness(50, 1.505, 0, 4095));
+}
+
+TEST(RgbCctTests, IntegerFadeStepMatchesFloatingPointFade) {
+  const int fadeEffects[] = {0, 1, 200, 500, 1000, 3000};
+  const int maxHwValues[] = {255, 1023, 4095};
+  const uint32_t timeDiffs[] = {1, 7, 10, 33, 100, 499, 500, 5000};
+
+  RgbCctBaseForTest rgb;
+  for (int fadeEffect : fadeEffects) {
+    for (int maxHw : maxHwValues) {
+      rgb.setFadeEffectForTest(fadeEffect, maxHw);
+      for (int distance = 1; distance <= maxHw; distance += 7) {
+        for (uint32_t timeDiff : timeDiffs) {
+          int expectedStep =
+              referenceFadeStep(distance, timeDiff, fadeEffect, maxHw);
+          int16_t hwValue = 0;
+          uint32_t lastChangeMs = 1000;
+          bool changed = rgb.updateFadeForTest(
+              maxHw, &hwValue, distance, &lastChangeMs, 1000 + timeDiff);
+          EXPECT_NEAR(hwValue, expectedStep, 1)
+              << "fade " << fadeEffect << " distance " << distance
+              << " timeDiff " << timeDiff;
+          EXPECT_EQ(changed, hwValue != 0);
+          EXPECT_EQ(lastChangeMs, changed ? 1000 + timeDiff : 1000);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,253 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+
+#include <supla/sensor/ds_conversion_scheduler.h>
+#include <supla/sensor/thermometer_driver.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fake_one_wire_bus.h"
+
+using Supla::Sensor::DsConversionScheduler;
+
+namespace {
+
+// Default limit of one bus transaction per iteration: the longest one is
+// scratchpad read (12.56 ms at standard speed)
+constexpr uint32_t kMaxIterationUs = FakeOneWireBus::kReadScratchpadUs;
+
+class DsConversionSchedulerTests : public ::testing::Test {
+ protected:
+  // Runs scheduler every 1 ms until untilMs and returns the longest time
+  // spent on bus communication in a single iteration
+  uint32_t runUntil(uint32_t untilMs) {
+    uint32_t longestIterationUs = 0;
+    for (; nowMs < untilMs; nowMs++) {
+      busTimeUs = 0;
+      scheduler.iterate(nowMs);
+      longestIterationUs = std::max(longestIterationUs, busTimeUs);
+    }
+    return longestIterationUs;
+  }
+
+  int addSensor(int busId,
+                FakeOneWireBus *bus,
+                int index,
+                uint8_t resolution = 12) {
+    return scheduler.addSensor(
+        busId, bus->devices[index].address, resolution);
+  }
+
+  uint32_t nowMs = 0;
+  uint32_t busTimeUs = 0;
+  DsConversionScheduler scheduler;
+};
+
+}  // namespace
+
+TEST(DsConversionSchedulerStaticTests, ConversionTimeDependsOnResolution) {
+  EXPECT_EQ(DsConversionScheduler::ConversionTimeMs(9), 94u);
+  EXPECT_EQ(DsConversionScheduler::ConversionTimeMs(10), 188u);
+  EXPECT_EQ(DsConversionScheduler::ConversionTimeMs(11), 375u);
+  EXPECT_EQ(DsConversionScheduler::ConversionTimeMs(12), 750u);
+  EXPECT_EQ(DsConversionScheduler::ConversionTimeMs(20), 750u);
+}
+
+TEST_F(DsConversionSchedulerTests, TwentySensorsOnTwoBusesDontBlockLoop) {
+  FakeOneWireBus busA(&nowMs, &busTimeUs, 1);
+  FakeOneWireBus busB(&nowMs, &busTimeUs, 2);
+  int busAId = scheduler.addBus(&busA);
+  int busBId = scheduler.addBus(&busB);
+  ASSERT_EQ(busAId, 0);
+  ASSERT_EQ(busBId, 1);
+
+  std::vector<int> sensorIds;
+  for (int i = 0; i < 12; i++) {
+    // 20.0 C + i * 0.5 C
+    busA.addDevice(i, 320 + i * 8);
+    sensorIds.push_back(addSensor(busAId, &busA, i));
+  }
+  for (int i = 0; i < 8; i++) {
+    // 9 bit sensors, lowest bits are undefined and should be ignored
+    busB.addDevice(i, -80 - i * 8 + 3, 9);
+    sensorIds.push_back(addSensor(busBId, &busB, i, 9));
+  }
+  for (auto id : sensorIds) {
+    ASSERT_GE(id, 0);
+    EXPECT_EQ(scheduler.getTemperature(id), TEMPERATURE_NOT_AVAILABLE);
+  }
+
+  // conversions on both buses are started in first iterations
+  EXPECT_LE(runUntil(2), FakeOneWireBus::kStartConversionUs);
+  EXPECT_EQ(busA.conversions, 1);
+  EXPECT_EQ(busB.conversions, 1);
+  EXPECT_TRUE(scheduler.isBusy(busAId));
+  EXPECT_TRUE(scheduler.isBusy(busBId));
+
+  // 9 bit sensors are read long before 12 bit conversion ends
+  EXPECT_LE(runUntil(200), kMaxIterationUs);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(scheduler.getTemperature(sensorIds[12 + i]), -5.0 - i * 0.5);
+  }
+  EXPECT_EQ(scheduler.getTemperature(sensorIds[0]), TEMPERATURE_NOT_AVAILABLE);
+  EXPECT_FALSE(scheduler.isBusy(busBId));
+
+  EXPECT_LE(runUntil(1000), kMaxIterationUs);
+  for (int i = 0; i < 12; i++) {
+    EXPECT_EQ(scheduler.getTemperature(sensorIds[i]), 20.0 + i * 0.5);
+  }
+  EXPECT_FALSE(scheduler.isBusy(busAId));
+  EXPECT_EQ(busA.readsDuringConversion, 0);
+  EXPECT_EQ(busB.readsDuringConversion, 0);
+  EXPECT_EQ(busA.resolutionWrites + busB.resolutionWrites, 0);
+
+  // next cycle starts after interval
+  busA.devices[3].raw = 400;
+  EXPECT_LE(runUntil(10000), kMaxIterationUs);
+  EXPECT_EQ(busA.conversions, 1);
+  EXPECT_LE(runUntil(11000), kMaxIterationUs);
+  EXPECT_EQ(busA.conversions, 2);
+  EXPECT_EQ(busB.conversions, 2);
+  EXPECT_EQ(scheduler.getTemperature(sensorIds[3]), 25.0);
+  for (auto &device : busA.devices) {
+    EXPECT_EQ(device.reads, 2);
+  }
+  for (auto &device : busB.devices) {
+    EXPECT_EQ(device.reads, 2);
+  }
+}
+
+TEST_F(DsConversionSchedulerTests, ResolutionIsRestoredWhenSensorReportsOther) {
+  FakeOneWireBus bus(&nowMs, &busTimeUs, 1);
+  int busId = scheduler.addBus(&bus);
+  // sensor after power loss uses default 12 bit resolution
+  bus.addDevice(0, 321, 12);
+  bus.devices[0].alarmHigh = 0x30;
+  bus.devices[0].alarmLow = 0x05;
+  int sensorId = addSensor(busId, &bus, 0, 10);
+  EXPECT_EQ(scheduler.getResolution(sensorId), 10);
+
+  // conversion time of requested resolution is too short, so sensor returns
+  // power-on value. Reported resolution is used for decoding.
+  runUntil(1000);
+  EXPECT_EQ(bus.readsDuringConversion, 1);
+  EXPECT_EQ(scheduler.getTemperature(sensorId), 85.0);
+  EXPECT_EQ(scheduler.getResolution(sensorId), 12);
+  EXPECT_EQ(bus.resolutionWrites, 0);
+
+  // requested resolution is written before next conversion in a separate
+  // iteration, alarm registers read from scratchpad are kept
+  runUntil(9000);
+  EXPECT_LE(runUntil(10300), kMaxIterationUs);
+  EXPECT_EQ(bus.resolutionWrites, 1);
+  EXPECT_EQ(bus.devices[0].resolution, 10);
+  EXPECT_EQ(bus.devices[0].alarmHigh, 0x30);
+  EXPECT_EQ(bus.devices[0].alarmLow, 0x05);
+  EXPECT_EQ(scheduler.getResolution(sensorId), 10);
+  EXPECT_EQ(bus.conversions, 2);
+  EXPECT_EQ(bus.readsDuringConversion, 1);
+  // 20.0625 C with 10 bit resolution
+  EXPECT_EQ(scheduler.getTemperature(sensorId), 20.0);
+
+  runUntil(30000);
+  EXPECT_EQ(bus.resolutionWrites, 1);
+}
+
+TEST_F(DsConversionSchedulerTests, MissingSensorAndCrcErrorAreReported) {
+  FakeOneWireBus bus(&nowMs, &busTimeUs, 1);
+  int busId = scheduler.addBus(&bus);
+  bus.addDevice(0, 100);
+  bus.addDevice(1, 200);
+  int first = addSensor(busId, &bus, 0);
+  int second = addSensor(busId, &bus, 1);
+  uint8_t unknownAddress[8] = {0x28, 9, 9, 9, 9, 9, 9, 9};
+  int missing = scheduler.addSensor(busId, unknownAddress);
+  EXPECT_EQ(scheduler.findSensor(busId, unknownAddress), missing);
+  EXPECT_EQ(scheduler.addSensor(busId, unknownAddress), missing);
+
+  runUntil(1000);
+  EXPECT_EQ(scheduler.getTemperature(first), 6.25);
+  EXPECT_EQ(scheduler.getTemperature(second), 12.5);
+  EXPECT_EQ(scheduler.getTemperature(missing), DS_DISCONNECTED_TEMPERATURE);
+
+  bus.devices[1].corruptCrc = true;
+  runUntil(11000);
+  EXPECT_EQ(scheduler.getTemperature(second), DS_DISCONNECTED_TEMPERATURE);
+  EXPECT_EQ(bus.resolutionWrites, 0);
+
+  // removed sensor is not read anymore
+  scheduler.removeSensor(missing);
+  EXPECT_EQ(scheduler.findSensor(busId, unknownAddress), -1);
+  EXPECT_EQ(scheduler.getTemperature(missing), TEMPERATURE_NOT_AVAILABLE);
+  bus.devices[1].corruptCrc = false;
+  runUntil(21000);
+  EXPECT_EQ(scheduler.getTemperature(second), 12.5);
+  EXPECT_EQ(bus.devices[0].reads, 3);
+}
+
+TEST_F(DsConversionSchedulerTests, ParasitePowerWaitsForLongestConversion) {
+  FakeOneWireBus bus(&nowMs, &busTimeUs, 1);
+  bus.parasite = true;
+  int busId = scheduler.addBus(&bus);
+  bus.addDevice(0, 160, 9);
+  bus.addDevice(1, 320, 12);
+  int fast = addSensor(busId, &bus, 0, 9);
+  int slow = addSensor(busId, &bus, 1);
+
+  runUntil(700);
+  EXPECT_EQ(bus.devices[0].reads, 0);
+  EXPECT_EQ(scheduler.getTemperature(fast), TEMPERATURE_NOT_AVAILABLE);
+
+  runUntil(800);
+  EXPECT_EQ(scheduler.getTemperature(fast), 10.0);
+  EXPECT_EQ(scheduler.getTemperature(slow), 20.0);
+}
+
+TEST_F(DsConversionSchedulerTests, TransactionLimitIsConfigurable) {
+  FakeOneWireBus busA(&nowMs, &busTimeUs, 1);
+  FakeOneWireBus busB(&nowMs, &busTimeUs, 2);
+  scheduler.addBus(&busA);
+  scheduler.addBus(&busB);
+  busA.addDevice(0, 100);
+  busB.addDevice(0, 100);
+  addSensor(0, &busA, 0);
+  addSensor(1, &busB, 0);
+  EXPECT_EQ(scheduler.addSensor(2, busA.devices[0].address), -1);
+
+  scheduler.setMaxTransactionsPerIteration(2);
+  busTimeUs = 0;
+  scheduler.iterate(nowMs);
+  EXPECT_EQ(busA.conversions, 1);
+  EXPECT_EQ(busB.conversions, 1);
+  EXPECT_EQ(busTimeUs, 2 * FakeOneWireBus::kStartConversionUs);
+}
+
+TEST_F(DsConversionSchedulerTests, Ds18s20IsDecodedWithCountRemain) {
+  FakeOneWireBus bus(&nowMs, &busTimeUs, 1);
+  int busId = scheduler.addBus(&bus);
+  // 25.5 C and -10.25 C
+  bus.addDevice(0, 408, 12, DS_DS18S20_FAMILY);
+  bus.addDevice(1, -164, 12, DS_DS18S20_FAMILY);
+  bus.addDevice(2, 408);
+  // DS18S20 resolution can't be changed
+  int first = addSensor(busId, &bus, 0, 9);
+  int second = addSensor(busId, &bus, 1, 9);
+  int ds18b20 = addSensor(busId, &bus, 2);
+  EXPECT_EQ(scheduler.getResolution(first), 12);
+
+  runUntil(700);
+  EXPECT_EQ(scheduler.getTemperature(first), TEMPERATURE_NOT_AVAILABLE);
+
+  EXPECT_LE(runUntil(1000), kMaxIterationUs);
+  EXPECT_EQ(scheduler.getTemperature(first), 25.5);
+  EXPECT_EQ(scheduler.getTemperature(second), -10.25);
+  EXPECT_EQ(scheduler.getTemperature(ds18b20), 25.5);
+  EXPECT_EQ(bus.readsDuringConversion, 0);
+
+  runUntil(21000);
+  EXPECT_EQ(bus.resolutionWrites, 0);
+  EXPECT_EQ(scheduler.getTemperature(first), 25.5);
+}
@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TEST_SENSORTESTS_FAKE_ONE_WIRE_BUS_H_
+#define EXTRAS_TEST_SENSORTESTS_FAKE_ONE_WIRE_BUS_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <supla/sensor/ds_conversion_scheduler.h>
+
+#include <vector>
+
+inline uint8_t dallasCrc8(const uint8_t *data, int size) {
+  uint8_t crc = 0;
+  for (int i = 0; i < size; i++) {
+    uint8_t byte = data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      uint8_t mix = (crc ^ byte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
+
+// Simulates OneWire bus with DS18B20 (and DS18S20) sensors. Each
+// transaction adds its duration on real bus (standard speed) to busTimeUs.
+class FakeOneWireBus : public Supla::Sensor::DsBus {
+ public:
+  // Standard speed: reset pulse with presence detect takes 960 us and each
+  // time slot 70 us, so one byte takes 560 us
+  static constexpr uint32_t kResetUs = 960;
+  static constexpr uint32_t kByteUs = 8 * 70;
+  // reset, Skip ROM, Convert T
+  static constexpr uint32_t kStartConversionUs = kResetUs + 2 * kByteUs;
+  // reset, Match ROM (9 bytes), Read Scratchpad, 9 bytes, final reset (as
+  // done by DallasTemperature)
+  static constexpr uint32_t kReadScratchpadUs = 2 * kResetUs + 19 * kByteUs;
+  // reset, Match ROM (9 bytes), Write Scratchpad, TH, TL, config, reset
+  static constexpr uint32_t kWriteResolutionUs = 2 * kResetUs + 13 * kByteUs;
+
+  struct Device {
+    uint8_t address[8] = {};
+    // temperature in 1/16 C, as measured by next conversion
+    int16_t raw = 0;
+    // power-on value of temperature register (85 C)
+    int16_t converted = 0x0550;
+    uint8_t resolution = 12;
+    bool present = true;
+    bool corruptCrc = false;
+    int reads = 0;
+    uint8_t alarmHigh = 0x4B;
+    uint8_t alarmLow = 0x46;
+  };
+
+  FakeOneWireBus(const uint32_t *nowMs, uint32_t *busTimeUs, uint8_t id)
+      : nowMs(nowMs), busTimeUs(busTimeUs), id(id) {
+  }
+
+  void addDevice(uint8_t number,
+                 int16_t raw,
+                 uint8_t resolution = 12,
+                 uint8_t family = 0x28) {
+    Device device;
+    uint8_t address[8] = {family, id, number, 0, 0, 0, 0, 0};
+    address[7] = dallasCrc8(address, 7);
+    memcpy(device.address, address, 8);
+    device.raw = raw;
+    device.resolution = resolution;
+    devices.push_back(device);
+  }
+
+  bool startConversion() override {
+    *busTimeUs += kStartConversionUs;
+    conversions++;
+    conversionStartMs = *nowMs;
+    converting = true;
+    return true;
+  }
+
+  bool readScratchpad(const uint8_t *address, uint8_t *scratchpad) override {
+    *busTimeUs += kReadScratchpadUs;
+    auto device = find(address);
+    if (device == nullptr || !device->present) {
+      return false;
+    }
+    device->reads++;
+    uint32_t conversionUs = 93750 << (device->resolution - 9);
+    if (converting &&
+        (*nowMs - conversionStartMs) * 1000 >= conversionUs) {
+      device->converted = device->raw;
+    } else {
+      readsDuringConversion++;
+    }
+    if (device->address[0] == DS_DS18S20_FAMILY) {
+      fillDs18s20Scratchpad(device, scratchpad);
+    } else {
+      scratchpad[0] = device->converted & 0xFF;
+      scratchpad[1] = (device->converted >> 8) & 0xFF;
+      scratchpad[2] = device->alarmHigh;
+      scratchpad[3] = device->alarmLow;
+      scratchpad[4] = ((device->resolution - 9) << 5) | 0x1F;
+      scratchpad[5] = 0xFF;
+      scratchpad[6] = 0x0C;
+      scratchpad[7] = 0x10;
+    }
+    scratchpad[8] = dallasCrc8(scratchpad, 8);
+    if (device->corruptCrc) {
+      scratchpad[8] ^= 0x01;
+    }
+    return true;
+  }
+
+  bool writeResolution(const uint8_t *address,
+                       uint8_t resolution,
+                       uint8_t alarmHigh,
+                       uint8_t alarmLow) override {
+    *busTimeUs += kWriteResolutionUs;
+    auto device = find(address);
+    if (device == nullptr || !device->present) {
+      return false;
+    }
+    resolutionWrites++;
+    device->resolution = resolution;
+    device->alarmHigh = alarmHigh;
+    device->alarmLow = alarmLow;
+    return true;
+  }
+
+  bool isParasitePowered() override {
+    return parasite;
+  }
+
+  Device *find(const uint8_t *address) {
+    for (auto &device : devices) {
+      if (memcmp(device.address, address, 8) == 0) {
+        return &device;
+      }
+    }
+    return nullptr;
+  }
+
+  std::vector<Device> devices;
+  int conversions = 0;
+  int readsDuringConversion = 0;
+  int resolutionWrites = 0;
+  bool parasite = false;
+
+ private:
+  // DS18S20 reports temperature in 0.5 C units and COUNT_REMAIN for
+  // COUNT_PER_C = 16, so raw (in 1/16 C) can be recovered from it
+  static void fillDs18s20Scratchpad(const Device *device,
+                                    uint8_t *scratchpad) {
+    int16_t halfDegrees = (device->converted + 4) >> 3;
+    int16_t tempRead = halfDegrees >> 1;
+    scratchpad[0] = halfDegrees & 0xFF;
+    scratchpad[1] = (halfDegrees >> 8) & 0xFF;
+    scratchpad[2] = device->alarmHigh;
+    scratchpad[3] = device->alarmLow;
+    scratchpad[4] = 0xFF;
+    scratchpad[5] = 0xFF;
+    scratchpad[6] =
+        static_cast<uint8_t>(tempRead * 16 + 12 - device->converted);
+    scratchpad[7] = 0x10;
+  }
+
+  const uint32_t *nowMs;
+  uint32_t *busTimeUs;
+  uint32_t conversionStartMs = 0;
+  bool converting = false;
+  uint8_t id = 0;
+};
+
+#endif  // EXTRAS_TEST_SENSORTESTS_FAKE_ONE_WIRE_BUS_H_
@@ -4,9 +4,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <arduino_mock.h>
+#include <pulse_train_io.h>
 #include <simple_time.h>
 #include <supla/sensor/impulse_counter.h>
 
+#include <memory>
+
 #include "../doubles/supla_io_mock.h"
 
 TEST(ImpulseCounterTests, IoPinConstructorUsesSeparateIoAndPullup) {
@@ -34,3 +38,156 @@ TEST(ImpulseCounterTests, IoPinConstructorUsesSeparateIoAndPullup) {
 
   EXPECT_EQ(counter.getCounter(), 1);
 }
+
+TEST(ImpulseCounterTests, EdgeCaptureCounts10kHzPulseTrain) {
+  Supla::Channel::resetToDefaults();
+  SimpleTime time;
+  PulseTrainIo io(&time);
+  Supla::Sensor::ImpulseCounter counter(&io, 3, true, false, 0, 0);
+  counter.setEdgeCaptureMode(true);
+
+  counter.onInit();
+  EXPECT_TRUE(counter.isEdgeCaptureActive());
+  EXPECT_TRUE(io.isInterruptAttached(3));
+  io.reads = 0;
+
+  // 1 s of 10 kHz signal with 20 us pulses
+  for (int ms = 0; ms < 1000; ms++) {
+    io.pulseTrain(3, 10, 100, 20);
+    counter.onFastTimer();
+    if (ms % 10 == 0) {
+      counter.iterateAlways();
+    }
+  }
+  counter.iterateAlways();
+
+  EXPECT_EQ(counter.getCounter(), 10000);
+  // pin is read only by interrupt handler
+  EXPECT_EQ(io.reads, io.interrupts);
+  EXPECT_EQ(io.interrupts, 20000);
+}
+
+TEST(ImpulseCounterTests, EdgeCaptureFiltersBouncesAndShortPulses) {
+  Supla::Channel::resetToDefaults();
+  SimpleTime time;
+  PulseTrainIo io(&time);
+  // falling edge, 10 ms debounce, pulse has to last at least 1 ms
+  Supla::Sensor::ImpulseCounter counter(&io, 5, false, true, 10, 1);
+  counter.setEdgeCaptureMode(true);
+  io.setLevel(5, HIGH);
+  counter.onInit();
+  ASSERT_TRUE(counter.isEdgeCaptureActive());
+
+  // bouncing leading edge
+  io.setLevel(5, LOW);
+  io.wait(50);
+  io.setLevel(5, HIGH);
+  io.wait(30);
+  io.setLevel(5, LOW);
+  io.wait(5000);
+  io.setLevel(5, HIGH);
+  counter.iterateAlways();
+  EXPECT_EQ(counter.getCounter(), 1);
+
+  // glitch
+  io.pulseTrain(5, 1, 1000, 200, LOW);
+  // valid pulse, but within debounce time from the previous one
+  io.pulseTrain(5, 1, 3000, 2000, LOW);
+  counter.iterateAlways();
+  EXPECT_EQ(counter.getCounter(), 1);
+
+  io.wait(10000);
+  io.pulseTrain(5, 3, 20000, 2000, LOW);
+  counter.iterateAlways();
+  EXPECT_EQ(counter.getCounter(), 4);
+}
+
+TEST(ImpulseCounterTests, EdgeCaptureFallsBackToPolling) {
+  Supla::Channel::resetToDefaults();
+  SimpleTime time;
+  PulseTrainIo io(&time);
+  std::unique_ptr<Supla::Sensor::ImpulseCounter>
+      counters[SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS];
+  for (int i = 0; i < SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS; i++) {
+    counters[i].reset(
+        new Supla::Sensor::ImpulseCounter(&io, i, true, false, 0, 0));
+    counters[i]->setEdgeCaptureMode(true);
+    counters[i]->onInit();
+    EXPECT_TRUE(counters[i]->isEdgeCaptureActive());
+  }
+
+  Supla::Sensor::ImpulseCounter polled(&io, 10, true, false, 0, 0);
+  polled.setEdgeCaptureMode(true);
+  polled.onInit();
+  EXPECT_FALSE(polled.isEdgeCaptureActive());
+  EXPECT_FALSE(io.isInterruptAttached(10));
+  for (int i = 0; i < 3; i++) {
+    io.setLevel(10, HIGH);
+    time.advance(1);
+    polled.onFastTimer();
+    io.setLevel(10, LOW);
+    time.advance(1);
+    polled.onFastTimer();
+  }
+  EXPECT_EQ(polled.getCounter(), 3);
+
+  // slot is released with its counter
+  counters[1].reset();
+  EXPECT_FALSE(io.isInterruptAttached(1));
+  Supla::Sensor::ImpulseCounter next(&io, 11, true, false, 0, 0);
+  next.setEdgeCaptureMode(true);
+  next.onInit();
+  EXPECT_TRUE(next.isEdgeCaptureActive());
+  io.pulseTrain(11, 2, 1000, 100);
+  next.iterateAlways();
+  EXPECT_EQ(next.getCounter(), 2);
+}
+
+TEST(ImpulseCounterTests, EdgeCaptureIsNotUsedWithIsrUnsafeIo) {
+  Supla::Channel::resetToDefaults();
+  ::testing::NiceMock<SuplaIoMock> ioMock;
+  SimpleTime time;
+
+  int gpioValue = LOW;
+  ON_CALL(ioMock, customDigitalRead(0, 7))
+      .WillByDefault(::testing::ReturnPointee(&gpioValue));
+  EXPECT_CALL(ioMock, customAttachInterrupt(::testing::_, ::testing::_,
+                                            ::testing::_))
+      .Times(0);
+
+  Supla::Sensor::ImpulseCounter counter(&ioMock, 7, true, false, 10);
+  counter.setEdgeCaptureMode(true);
+  counter.onInit();
+  EXPECT_FALSE(counter.isEdgeCaptureActive());
+
+  gpioValue = HIGH;
+  time.advance(11);
+  counter.onFastTimer();
+  EXPECT_EQ(counter.getCounter(), 1);
+}
+
+TEST(ImpulseCounterTests, EdgeCaptureWithoutIoUsesPollingOutsideArduino) {
+  Supla::Channel::resetToDefaults();
+  ::testing::NiceMock<DigitalInterfaceMock> ioMock;
+  SimpleTime time;
+
+  int gpioValue = LOW;
+  ON_CALL(ioMock, digitalRead(4))
+      .WillByDefault(::testing::ReturnPointee(&gpioValue));
+
+  Supla::Sensor::ImpulseCounter counter(4, true, false, 10);
+  counter.setEdgeCaptureMode(true);
+  counter.onInit();
+  // native attachInterrupt is a stub in ESP-IDF and Linux builds
+  EXPECT_FALSE(counter.isEdgeCaptureActive());
+
+  for (int i = 0; i < 3; i++) {
+    gpioValue = HIGH;
+    time.advance(11);
+    counter.onFastTimer();
+    gpioValue = LOW;
+    time.advance(11);
+    counter.onFastTimer();
+  }
+  EXPECT_EQ(counter.getCounter(), 3);
+}
@@ -11,6 +11,7 @@
 #include <supla/protocol/supla_srpc.h>
 #include <supla/sensor/multi_ds_handler_base.h>
 #include <supla/storage/config_tags.h>
+#include <supla/storage/key_value.h>
 #include <supla/storage/storage.h>
 
 #include <array>
@@ -19,6 +20,8 @@
 #include <string>
 #include <vector>
 
+#include "fake_one_wire_bus.h"
+
 namespace {
 
 using ::testing::Invoke;
@@ -38,6 +41,10 @@ class TestMultiDsHandler : public Supla::Sensor::MultiDsHandlerBase {
     return addDevice(address, channelNumber, subDeviceId);
   }
 
+  Supla::Sensor::MultiDsSensor *addAddress(uint8_t *address) {
+    return addDevice(address);
+  }
+
   Supla::Sensor::MultiDsSensor *slot(int index) const {
     return index >= 0 && index < MULTI_DS_MAX_DEVICES_COUNT ? sensors[index]
                                                              : nullptr;
@@ -58,7 +65,7 @@ class TestMultiDsHandler : public Supla::Sensor::MultiDsHandlerBase {
 
  protected:
   int refreshSensorsCount() override { return sensorDiscovered ? 1 : 0; }
-  void requestTemperatures() override {}
+  void requestTemperatures() override { temperatureRequests++; }
   bool getSensorAddress(uint8_t *address, int index) override {
     if (!sensorDiscovered || address == nullptr || index != 0) {
       return false;
@@ -67,6 +74,11 @@ class TestMultiDsHandler : public Supla::Sensor::MultiDsHandlerBase {
     return true;
   }
   double getTemperature(const uint8_t *) override { return 20.0; }
+  Supla::Sensor::DsBus *getDsBus() override { return dsBus; }
+
+ public:
+  Supla::Sensor::DsBus *dsBus = nullptr;
+  int temperatureRequests = 0;
 
  private:
   std::array<uint8_t, 8> discoveredAddress = {};
@@ -219,6 +231,59 @@ TEST_F(MultiDsHandlerTests, RestoreScansIdsAboveMaxDeviceCount) {
             0);
 }
 
+class CountingKeyValue : public Supla::KeyValue {
+ public:
+  bool init() override {
+    return true;
+  }
+  void removeAll() override {
+  }
+  bool getBlob(const char *key, char *value, size_t blobSize) override {
+    readKeys.push_back(key);
+    return Supla::KeyValue::getBlob(key, value, blobSize);
+  }
+
+  std::vector<std::string> readKeys;
+};
+
+TEST_F(MultiDsHandlerTests, RestoreWithKeyIterationReadsOnlyStoredConfigs) {
+  CountingKeyValue config;
+  for (int subDeviceId : {200, 12, 3}) {
+    auto sensorConfig = makeConfig(subDeviceId % 50, subDeviceId);
+    ASSERT_TRUE(config.setBlob(configKey(subDeviceId).c_str(),
+                               reinterpret_cast<char *>(&sensorConfig),
+                               sizeof(sensorConfig)));
+  }
+  ASSERT_TRUE(config.setUInt8("name", 1));
+  Supla::Storage::SetConfigInstance(&config);
+
+  TestMultiDsHandler handler;
+  handler.setMaxDeviceCount(5);
+  handler.onLoadConfig(nullptr);
+
+  // only existing sensor configs are read, without probing all SubDeviceIds
+  std::vector<std::string> sensorConfigReads;
+  for (const auto &key : config.readKeys) {
+    for (int subDeviceId = 1; subDeviceId <= UINT8_MAX; subDeviceId++) {
+      if (key == configKey(subDeviceId)) {
+        sensorConfigReads.push_back(key);
+      }
+    }
+  }
+  EXPECT_THAT(sensorConfigReads,
+              ::testing::ElementsAre(
+                  configKey(3), configKey(12), configKey(200)));
+
+  // sensors are restored in SubDeviceId order
+  ASSERT_NE(handler.slot(0), nullptr);
+  ASSERT_NE(handler.slot(1), nullptr);
+  ASSERT_NE(handler.slot(2), nullptr);
+  EXPECT_EQ(handler.slot(0)->getSubDeviceId(), 3);
+  EXPECT_EQ(handler.slot(1)->getSubDeviceId(), 12);
+  EXPECT_EQ(handler.slot(2)->getSubDeviceId(), 200);
+  EXPECT_EQ(handler.slot(2)->getChannel()->getChannelNumber(), 0);
+}
+
 TEST_F(MultiDsHandlerTests, RemovingSensorDoesNotChangeOtherIds) {
   Supla::Channel occupied;
   occupied.setSubDeviceId(1);
@@ -379,4 +444,43 @@ TEST_F(MultiDsHandlerTests, ConflictObserverReportsRemovedSensor) {
   EXPECT_TRUE(observer.lastHandled);
 }
 
+TEST_F(MultiDsHandlerTests, ConversionSchedulerReadsPairedSensors) {
+  uint32_t nowMs = 0;
+  uint32_t busTimeUs = 0;
+  FakeOneWireBus bus(&nowMs, &busTimeUs, 0);
+  bus.addDevice(1, 328, 11);
+  bus.addDevice(2, -8, 11);
+  Supla::Sensor::DsConversionScheduler scheduler;
+
+  TestMultiDsHandler handler;
+  handler.dsBus = &bus;
+  handler.setConversionScheduler(&scheduler, 11);
+  auto first = handler.add(1);
+  ASSERT_NE(first, nullptr);
+  memcpy(first->getAddress(), bus.devices[0].address, 8);
+  // sensors restored before onInit are added to the scheduler in onInit
+  ASSERT_EQ(scheduler.findSensor(0, bus.devices[0].address), -1);
+  handler.onInit();
+  int firstId = scheduler.findSensor(0, bus.devices[0].address);
+  ASSERT_GE(firstId, 0);
+  EXPECT_EQ(scheduler.getResolution(firstId), 11);
+
+  uint8_t address[8] = {};
+  memcpy(address, bus.devices[1].address, 8);
+  ASSERT_NE(handler.addAddress(address), nullptr);
+  EXPECT_GE(scheduler.findSensor(0, address), 0);
+
+  EXPECT_EQ(handler.getSensorTemperature(address),
+            TEMPERATURE_NOT_AVAILABLE);
+  for (; nowMs < 1000; nowMs++) {
+    scheduler.iterate(nowMs);
+    handler.iterateAlways();
+  }
+  EXPECT_EQ(handler.temperatureRequests, 0);
+  EXPECT_EQ(bus.conversions, 1);
+  EXPECT_EQ(bus.readsDuringConversion, 0);
+  EXPECT_EQ(handler.getSensorTemperature(bus.devices[0].address), 20.5);
+  EXPECT_EQ(handler.getSensorTemperature(address), -0.5);
+}
+
 }  // namespace
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Real device stack (SuplaDeviceClass, Supla::Protocol::SuplaSrpc with
+// supla-common srpc and LinuxClient) connected over TLS to SRPC emulator.
+// Emulator uses server variant of supla-common, which can't be linked with
+// the device one, so it runs as a child process.
+
+#include <SuplaDevice.h>
+#include <arduino_mock.h>
+#include <board_mock.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <linux_client.h>
+#include <network_mock.h>
+#include <signal.h>
+#include <simple_time.h>
+#include <supla/clock/clock.h>
+#include <supla/control/virtual_relay.h>
+#include <supla/protocol/supla_srpc.h>
+#include <sys/wait.h>
+#include <timer_mock.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "tls_test_certificate.h"
+
+using ::testing::NiceMock;
+using ::testing::Return;
+
+namespace {
+
+class SrpcEmulatorDeviceTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(certificate.isValid());
+    ASSERT_TRUE(startEmulator());
+    ON_CALL(net, isReady()).WillByDefault(Return(true));
+  }
+
+  void TearDown() override {
+    if (emulatorPid > 0) {
+      kill(emulatorPid, SIGTERM);
+      waitpid(emulatorPid, nullptr, 0);
+    }
+    if (emulatorOutput != nullptr) {
+      fclose(emulatorOutput);
+    }
+    Supla::Channel::resetToDefaults();
+  }
+
+  // Emulator sends SetChannelValue command (off) to channel 0 of each
+  // registered device
+  bool startEmulator() {
+    int fds[2] = {};
+    if (pipe(fds) != 0) {
+      return false;
+    }
+    emulatorPid = fork();
+    if (emulatorPid == 0) {
+      dup2(fds[1], STDOUT_FILENO);
+      close(fds[0]);
+      close(fds[1]);
+      execl(SRPC_EMULATOR_PATH,
+            SRPC_EMULATOR_PATH,
+            "--address", "127.0.0.1",
+            "--port", "0",
+            "--cert", certificate.certFile.c_str(),
+            "--key", certificate.keyFile.c_str(),
+            "--commands", "1",
+            "--channel", "0",
+            "--duration", "60",
+            static_cast<char *>(nullptr));
+      _exit(127);
+    }
+    close(fds[1]);
+    if (emulatorPid < 0) {
+      close(fds[0]);
+      return false;
+    }
+    emulatorOutput = fdopen(fds[0], "r");
+    std::string line;
+    if (!readLine(&line)) {
+      return false;
+    }
+    unsigned port = 0;
+    if (sscanf(line.c_str(), "SRPC emulator listening on 127.0.0.1:%u (TLS)",
+               &port) != 1) {
+      return false;
+    }
+    emulatorPort = static_cast<int>(port);
+    return emulatorPort > 0;
+  }
+
+  bool readLine(std::string *line) {
+    char buffer[256] = {};
+    if (emulatorOutput == nullptr ||
+        fgets(buffer, sizeof(buffer), emulatorOutput) == nullptr) {
+      return false;
+    }
+    *line = buffer;
+    return true;
+  }
+
+  TlsTestCertificate certificate;
+  pid_t emulatorPid = -1;
+  FILE *emulatorOutput = nullptr;
+  int emulatorPort = 0;
+
+  SimpleTime time;
+  NiceMock<NetworkMock> net;
+  NiceMock<TimerMock> timer;
+  NiceMock<BoardMock> board;
+  DigitalInterfaceMock ioMock;
+};
+
+}  // namespace
+
+TEST_F(SrpcEmulatorDeviceTests, DeviceRegistersOverTlsAndExecutesCommands) {
+  Supla::Control::VirtualRelay relay;
+  SuplaDeviceClass sd;
+
+  char guid[SUPLA_GUID_SIZE] = {1, 2, 3};
+  char authkey[SUPLA_AUTHKEY_SIZE] = {4, 5, 6};
+  ASSERT_TRUE(sd.begin(guid, "localhost", "test@supla.org", authkey));
+  sd.getClock()->setAutomaticTimeSync(false);
+
+  // emulator isn't on 2016, so TLS and CA certificate are set on client
+  // directly. LinuxClient verifies server certificate and host name.
+  auto client = new Supla::LinuxClient;
+  client->setSSLEnabled(true);
+  client->setCACert(certificate.certPem.c_str());
+  sd.getSrpcLayer()->setServerPort(emulatorPort);
+  sd.getSrpcLayer()->setNetworkClient(client);
+  auto handshakes = Supla::LinuxClient::GetTlsStats().handshakes;
+
+  relay.turnOn();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+  while (std::chrono::steady_clock::now() < deadline &&
+         !(sd.getCurrentStatus() == STATUS_REGISTERED_AND_READY &&
+           !relay.isOn())) {
+    sd.iterate();
+    time.advance(5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  EXPECT_EQ(sd.getCurrentStatus(), STATUS_REGISTERED_AND_READY);
+  EXPECT_FALSE(relay.isOn());
+  EXPECT_GT(Supla::LinuxClient::GetTlsStats().handshakes, handshakes);
+
+  std::string line;
+  bool registered = false;
+  while (sd.getCurrentStatus() == STATUS_REGISTERED_AND_READY && !registered &&
+         readLine(&line)) {
+    registered = line.find("Device 1 registered") == 0;
+  }
+  EXPECT_TRUE(registered);
+}
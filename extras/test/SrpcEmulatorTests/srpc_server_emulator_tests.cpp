@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <latency_stats.h>
+#include <openssl/ssl.h>
+#include <srpc_server_emulator.h>
+#include <srpc_simulated_device.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tls_test_certificate.h"
+
+using Supla::LatencyStats;
+using Supla::SrpcServerEmulator;
+using Supla::SrpcSimulatedDevice;
+using Command = Supla::SrpcServerEmulator::Command;
+
+namespace {
+
+class SrpcServerEmulatorTests : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(server.listen(0, "127.0.0.1"));
+    ASSERT_NE(server.getPort(), 0);
+  }
+
+  SrpcSimulatedDevice *connect(int channelCount) {
+    auto device = SrpcSimulatedDevice::Connect("127.0.0.1",
+                                               server.getPort(),
+                                               devices.size() + 1,
+                                               channelCount,
+                                               tlsContext);
+    if (!device) {
+      return nullptr;
+    }
+    devices.push_back(std::move(device));
+    return devices.back().get();
+  }
+
+  void pump() {
+    server.iterate();
+    for (auto &device : devices) {
+      device->sendChangedValues();
+      device->iterate();
+    }
+  }
+
+  bool pumpUntil(const std::function<bool()> &condition) {
+    auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      pump();
+    }
+    return true;
+  }
+
+  int registerDevice(int channelCount) {
+    auto device = connect(channelCount);
+    if (device == nullptr ||
+        !pumpUntil([device]() { return device->isRegistered(); })) {
+      return 0;
+    }
+    auto registered = server.getRegisteredDevices();
+    return registered.empty() ? 0 : registered.back();
+  }
+
+  SrpcServerEmulator server;
+  std::vector<std::unique_ptr<SrpcSimulatedDevice>> devices;
+  // used by devices connected with connect()
+  SSL_CTX *tlsContext = nullptr;
+};
+
+class SrpcServerEmulatorTlsTests : public SrpcServerEmulatorTests {
+ protected:
+  void SetUp() override {
+    SrpcServerEmulatorTests::SetUp();
+    ASSERT_TRUE(certificate.isValid());
+    ASSERT_TRUE(server.enableTls(certificate.certFile.c_str(),
+                                 certificate.keyFile.c_str()));
+    tlsContext = SSL_CTX_new(TLS_client_method());
+    ASSERT_NE(tlsContext, nullptr);
+    SSL_CTX_set_verify(tlsContext, SSL_VERIFY_PEER, nullptr);
+    ASSERT_EQ(SSL_CTX_load_verify_locations(
+                  tlsContext, certificate.certFile.c_str(), nullptr),
+              1);
+  }
+
+  void TearDown() override {
+    devices.clear();
+    SSL_CTX_free(tlsContext);
+    tlsContext = nullptr;
+  }
+
+  TlsTestCertificate certificate;
+};
+
+}  // namespace
+
+TEST(LatencyStatsTests, PercentilesUseNearestRank) {
+  LatencyStats stats;
+  EXPECT_EQ(stats.percentile(50), 0u);
+  for (uint64_t value = 100; value >= 1; value--) {
+    stats.add(value);
+  }
+  EXPECT_EQ(stats.count(), 100u);
+  EXPECT_EQ(stats.percentile(0), 1u);
+  EXPECT_EQ(stats.percentile(50), 50u);
+  EXPECT_EQ(stats.percentile(99), 99u);
+  EXPECT_EQ(stats.max(), 100u);
+  EXPECT_DOUBLE_EQ(stats.mean(), 50.5);
+
+  stats.clear();
+  EXPECT_EQ(stats.count(), 0u);
+  EXPECT_EQ(stats.max(), 0u);
+}
+
+TEST_F(SrpcServerEmulatorTests, SimulatedDeviceRegisters) {
+  int id = registerDevice(3);
+  ASSERT_NE(id, 0);
+
+  auto info = server.getDeviceInfo(id);
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->name, "Simulated device 1");
+  EXPECT_EQ(info->channelCount, 3);
+  EXPECT_EQ(info->protoVersion, SUPLA_PROTO_VERSION);
+  EXPECT_EQ(info->channelFunctions,
+            std::vector<int>(3, SUPLA_CHANNELFNC_LIGHTSWITCH));
+  EXPECT_EQ(server.getRegistrationTime().count(), 1u);
+  EXPECT_GT(devices[0]->getRegistrationTimeUs(), 0u);
+}
+
+TEST_F(SrpcServerEmulatorTests, RegistrationLargerThanDevicePacketLimit) {
+  // 128 channels don't fit into SUPLA_MAX_DATA_SIZE of device builds, so
+  // server side codec has to accept it
+  int id = registerDevice(SUPLA_CHANNELMAXCOUNT);
+  ASSERT_NE(id, 0);
+  EXPECT_EQ(server.getDeviceInfo(id)->channelCount, SUPLA_CHANNELMAXCOUNT);
+}
+
+TEST_F(SrpcServerEmulatorTests, CommandRoundTripsAreMeasured) {
+  int id = registerDevice(2);
+  ASSERT_NE(id, 0);
+
+  char value[SUPLA_CHANNELVALUE_SIZE] = {1};
+  uint8_t config[4] = {};
+  EXPECT_TRUE(server.setChannelValue(id, 1, value));
+  EXPECT_TRUE(server.calCfg(id, 0, SUPLA_CALCFG_CMD_IDENTIFY_DEVICE));
+  EXPECT_TRUE(server.setChannelConfig(id,
+                                      1,
+                                      SUPLA_CHANNELFNC_LIGHTSWITCH,
+                                      SUPLA_CONFIG_TYPE_DEFAULT,
+                                      config,
+                                      sizeof(config)));
+  EXPECT_TRUE(server.setDeviceConfig(id, 0, nullptr, 0));
+  EXPECT_EQ(server.getPendingCommandCount(), 4u);
+
+  ASSERT_TRUE(
+      pumpUntil([this]() { return server.getPendingCommandCount() == 0; }));
+  for (auto command : {Command::SetChannelValue,
+                       Command::CalCfg,
+                       Command::ChannelConfig,
+                       Command::DeviceConfig}) {
+    EXPECT_EQ(server.getSentCommandCount(command), 1u);
+    EXPECT_EQ(server.getLatency(command).count(), 1u);
+  }
+  EXPECT_EQ(devices[0]->getHandledCommandCount(), 4u);
+  // relay reports its new value
+  ASSERT_TRUE(
+      pumpUntil([this]() { return server.getValueUpdateCount() > 0; }));
+}
+
+TEST_F(SrpcServerEmulatorTests, CommandStormIsThrottledBySrpcQueue) {
+  int id = registerDevice(1);
+  ASSERT_NE(id, 0);
+
+  int sent = 0;
+  char value[SUPLA_CHANNELVALUE_SIZE] = {};
+  while (server.setChannelValue(id, 0, value)) {
+    sent++;
+  }
+  // srpc output queue is limited, caller has to iterate
+  EXPECT_GT(sent, 0);
+  EXPECT_LT(sent, 10);
+
+  for (int i = sent; i < 200; i++) {
+    value[0] = i % 2;
+    ASSERT_TRUE(pumpUntil([&]() {
+      return server.setChannelValue(id, 0, value);
+    }));
+  }
+  ASSERT_TRUE(
+      pumpUntil([this]() { return server.getPendingCommandCount() == 0; }));
+  EXPECT_EQ(server.getLatency(Command::SetChannelValue).count(), 200u);
+  EXPECT_EQ(devices[0]->getHandledCommandCount(), 200u);
+}
+
+TEST_F(SrpcServerEmulatorTests, ValueUpdatesFromManyDevicesAreCounted) {
+  for (int i = 0; i < 5; i++) {
+    ASSERT_NE(connect(16), nullptr);
+  }
+  ASSERT_TRUE(pumpUntil(
+      [this]() { return server.getRegisteredDevices().size() == 5; }));
+  ASSERT_TRUE(pumpUntil([this]() {
+    for (auto &device : devices) {
+      if (!device->isRegistered()) {
+        return false;
+      }
+    }
+    return true;
+  }));
+
+  for (int burst = 0; burst < 10; burst++) {
+    for (auto &device : devices) {
+      device->changeAllValues();
+    }
+    // values not sent yet would be merged with the next burst
+    ASSERT_TRUE(pumpUntil([this]() {
+      int waiting = 0;
+      for (auto &device : devices) {
+        waiting += device->sendChangedValues();
+      }
+      return waiting == 0;
+    }));
+  }
+  ASSERT_TRUE(
+      pumpUntil([this]() { return server.getValueUpdateCount() >= 800; }));
+  EXPECT_EQ(server.getValueUpdateCount(), 800u);
+  EXPECT_GT(server.getValueUpdateRate(), 0);
+}
+
+TEST_F(SrpcServerEmulatorTests, DisconnectedDeviceIsForgotten) {
+  int id = registerDevice(1);
+  ASSERT_NE(id, 0);
+  EXPECT_EQ(server.getConnectionCount(), 1u);
+
+  devices.clear();
+  ASSERT_TRUE(pumpUntil([this]() { return server.getConnectionCount() == 0; }));
+  EXPECT_TRUE(server.getRegisteredDevices().empty());
+  EXPECT_EQ(server.getDeviceInfo(id), nullptr);
+  char value[SUPLA_CHANNELVALUE_SIZE] = {};
+  EXPECT_FALSE(server.setChannelValue(id, 0, value));
+}
+
+TEST_F(SrpcServerEmulatorTlsTests, DeviceRegistersAndHandlesCommandsOverTls) {
+  EXPECT_TRUE(server.isTlsEnabled());
+  int id = registerDevice(2);
+  ASSERT_NE(id, 0);
+  EXPECT_TRUE(devices[0]->isTls());
+  EXPECT_EQ(server.getDeviceInfo(id)->channelCount, 2);
+
+  // more data than a single TLS record
+  for (int i = 0; i < 200; i++) {
+    char value[SUPLA_CHANNELVALUE_SIZE] = {static_cast<char>(i % 2)};
+    ASSERT_TRUE(pumpUntil([&]() {
+      return server.setChannelValue(id, i % 2, value);
+    }));
+  }
+  ASSERT_TRUE(
+      pumpUntil([this]() { return server.getPendingCommandCount() == 0; }));
+  EXPECT_EQ(devices[0]->getHandledCommandCount(), 200u);
+}
+
+TEST_F(SrpcServerEmulatorTlsTests, PlainDeviceIsDisconnected) {
+  SSL_CTX *context = tlsContext;
+  tlsContext = nullptr;
+  auto device = connect(1);
+  tlsContext = context;
+  ASSERT_NE(device, nullptr);
+
+  // registration isn't a TLS handshake
+  ASSERT_TRUE(pumpUntil([this]() { return server.getConnectionCount() == 0; }));
+  EXPECT_FALSE(device->isRegistered());
+  EXPECT_TRUE(server.getRegisteredDevices().empty());
+}
+
+TEST_F(SrpcServerEmulatorTests, TlsRequiresMatchingCertificateAndKey) {
+  TlsTestCertificate certificate;
+  TlsTestCertificate otherCertificate;
+  ASSERT_TRUE(certificate.isValid());
+  EXPECT_FALSE(server.enableTls("/nonexistent/cert.pem",
+                                certificate.keyFile.c_str()));
+  EXPECT_FALSE(server.enableTls(certificate.certFile.c_str(),
+                                otherCertificate.keyFile.c_str()));
+  EXPECT_FALSE(server.isTlsEnabled());
+  EXPECT_TRUE(server.enableTls(certificate.certFile.c_str(),
+                               certificate.keyFile.c_str()));
+  EXPECT_TRUE(server.isTlsEnabled());
+}
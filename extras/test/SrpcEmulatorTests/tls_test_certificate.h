@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TEST_SRPCEMULATORTESTS_TLS_TEST_CERTIFICATE_H_
+#define EXTRAS_TEST_SRPCEMULATORTESTS_TLS_TEST_CERTIFICATE_H_
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <filesystem>  // NOLINT(build/c++17)
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Self-signed certificate for "localhost" with its key, written as PEM files
+// to a temporary directory, which is removed in destructor.
+class TlsTestCertificate {
+ public:
+  TlsTestCertificate() {
+    std::string directoryTemplate =
+        (std::filesystem::temp_directory_path() /
+         ("supla_tls_test_" + std::to_string(getpid()) + "_XXXXXX"))
+            .string();
+    std::vector<char> writableDirectory(directoryTemplate.begin(),
+                                        directoryTemplate.end());
+    writableDirectory.push_back('\0');
+    if (mkdtemp(writableDirectory.data()) == nullptr) {
+      return;
+    }
+    directory = writableDirectory.data();
+    certFile = (directory / "cert.pem").string();
+    keyFile = (directory / "key.pem").string();
+
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>(
+                                   "localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, key, EVP_sha256());
+
+    BIO *bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, cert);
+    certPem = readBio(bio);
+    PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+    std::string keyPem = readBio(bio);
+    BIO_free(bio);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+
+    std::ofstream(certFile) << certPem;
+    std::ofstream(keyFile) << keyPem;
+  }
+
+  ~TlsTestCertificate() {
+    if (!directory.empty()) {
+      std::error_code error;
+      std::filesystem::remove_all(directory, error);
+    }
+  }
+
+  TlsTestCertificate(const TlsTestCertificate &) = delete;
+  TlsTestCertificate &operator=(const TlsTestCertificate &) = delete;
+
+  bool isValid() const {
+    return !certPem.empty();
+  }
+
+  std::string certFile;
+  std::string keyFile;
+  std::string certPem;
+
+ private:
+  static std::string readBio(BIO *bio) {
+    std::string result;
+    char buffer[1024];
+    int size = 0;
+    while ((size = BIO_read(bio, buffer, sizeof(buffer))) > 0) {
+      result.append(buffer, size);
+    }
+    return result;
+  }
+
+  std::filesystem::path directory;
+};
+
+#endif  // EXTRAS_TEST_SRPCEMULATORTESTS_TLS_TEST_CERTIFICATE_H_
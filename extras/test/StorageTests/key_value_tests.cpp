@@ -1,12 +1,17 @@
 // SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <config_mock.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <supla/storage/key_value.h>
 #include <supla-common/proto.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "supla/storage/config.h"
 
 class KeyValueTest : public Supla::KeyValue {
@@ -595,3 +600,108 @@ TEST(KeyValueTests, addEraseAddTest) {
   EXPECT_TRUE(kvStorage.getInt32("key100", &result32));
   EXPECT_EQ(result32, 5000);
 }
+
+namespace {
+std::vector<std::string> collectKeys(Supla::Config *config,
+                                     Supla::ConfigKeyCursor *cursor,
+                                     std::vector<int> *numbers = nullptr) {
+  std::vector<std::string> keys;
+  for (bool found = config->findFirstKey(cursor); found;
+       found = config->findNextKey(cursor)) {
+    keys.push_back(cursor->getKey());
+    if (numbers) {
+      numbers->push_back(cursor->getNumber());
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+}  // namespace
+
+TEST(KeyValueTests, cursorEnumeratesKeysByTag) {
+  KeyValueTest kvStorage;
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  for (int number : {1, 12, 255}) {
+    Supla::Config::generateKey(key, number, "ds_cfg");
+    EXPECT_TRUE(kvStorage.setUInt8(key, 1));
+  }
+  // tag truncated by generateKey
+  Supla::Config::generateKey(key, 100, "very_long_tag_name");
+  EXPECT_TRUE(kvStorage.setUInt8(key, 1));
+  EXPECT_TRUE(kvStorage.setUInt8("3_ds_cfg_x", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("03_ds_cfg", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("x_ds_cfg", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("ds_cfg", 1));
+  EXPECT_TRUE(kvStorage.isKeyIterationSupported());
+
+  Supla::ConfigKeyCursor cursor;
+  cursor.setTag("ds_cfg");
+  std::vector<int> numbers;
+  EXPECT_THAT(collectKeys(&kvStorage, &cursor, &numbers),
+              ::testing::ElementsAre("12_ds_cfg", "1_ds_cfg", "255_ds_cfg"));
+  EXPECT_THAT(numbers, ::testing::UnorderedElementsAre(1, 12, 255));
+
+  cursor.setTag("very_long_tag_name");
+  numbers.clear();
+  EXPECT_THAT(collectKeys(&kvStorage, &cursor, &numbers),
+              ::testing::ElementsAre("100_very_long_t"));
+  EXPECT_THAT(numbers, ::testing::ElementsAre(100));
+
+  cursor.setTag("ds_", false);
+  EXPECT_THAT(collectKeys(&kvStorage, &cursor),
+              ::testing::ElementsAre(
+                  "12_ds_cfg", "1_ds_cfg", "255_ds_cfg", "3_ds_cfg_x"));
+}
+
+TEST(KeyValueTests, cursorEnumeratesKeysByPrefix) {
+  KeyValueTest kvStorage;
+  EXPECT_TRUE(kvStorage.setUInt8("spld1_act", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("spld12_0", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("spl", 1));
+  EXPECT_TRUE(kvStorage.setUInt8("name", 1));
+
+  Supla::ConfigKeyCursor cursor;
+  cursor.setPrefix("spld");
+  std::vector<int> numbers;
+  EXPECT_THAT(collectKeys(&kvStorage, &cursor, &numbers),
+              ::testing::ElementsAre("spld12_0", "spld1_act"));
+  EXPECT_THAT(numbers, ::testing::ElementsAre(-1, -1));
+
+  cursor.setPrefix("");
+  EXPECT_EQ(collectKeys(&kvStorage, &cursor).size(), 4u);
+
+  cursor.setPrefix("missing");
+  EXPECT_FALSE(kvStorage.findFirstKey(&cursor));
+  EXPECT_FALSE(kvStorage.findNextKey(&cursor));
+}
+
+TEST(KeyValueTests, currentKeyCanBeErasedDuringEnumeration) {
+  KeyValueTest kvStorage;
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  for (int number = 1; number <= 20; number++) {
+    Supla::Config::generateKey(key, number, number % 2 ? "odd" : "even");
+    EXPECT_TRUE(kvStorage.setUInt8(key, 1));
+  }
+
+  Supla::ConfigKeyCursor cursor;
+  cursor.setTag("odd");
+  int erased = 0;
+  for (bool found = kvStorage.findFirstKey(&cursor); found;
+       found = kvStorage.findNextKey(&cursor)) {
+    EXPECT_TRUE(kvStorage.eraseKey(cursor.getKey()));
+    erased++;
+  }
+  EXPECT_EQ(erased, 10);
+
+  cursor.setPrefix("");
+  EXPECT_EQ(collectKeys(&kvStorage, &cursor).size(), 10u);
+}
+
+TEST(KeyValueTests, configWithoutIterationReportsNoKeys) {
+  ::testing::NiceMock<ConfigMock> config;
+  Supla::ConfigKeyCursor cursor;
+  cursor.setPrefix("");
+  EXPECT_FALSE(config.isKeyIterationSupported());
+  EXPECT_FALSE(config.findFirstKey(&cursor));
+  EXPECT_FALSE(config.findNextKey(&cursor));
+}
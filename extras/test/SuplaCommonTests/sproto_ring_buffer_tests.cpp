@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <proto.h>
+
+#include <memory>
+#include <vector>
+
+// Tests use server variant of supla-common (no SUPLA_DEVICE): BUFFER_MIN_SIZE
+// is 0, so the first append sizes the ring exactly to the appended data and
+// tests can place the wrap point at any byte of the next packet.
+
+namespace {
+
+struct SprotoDeleter {
+  void operator()(void *spd) const {
+    sproto_free(spd);
+  }
+};
+
+using Sproto = std::unique_ptr<void, SprotoDeleter>;
+
+Sproto makeSproto() {
+  return Sproto(sproto_init());
+}
+
+std::unique_ptr<TSuplaDataPacket> makePacket(void *spd,
+                                             unsigned int callId,
+                                             unsigned int dataSize) {
+  std::unique_ptr<TSuplaDataPacket> sdp(new TSuplaDataPacket);
+  sproto_sdp_init(spd, sdp.get());
+  std::vector<char> data(dataSize);
+  for (unsigned int i = 0; i < dataSize; i++) {
+    data[i] = static_cast<char>(callId * 31 + i);
+  }
+  sproto_set_data(sdp.get(), data.data(), dataSize, callId);
+  return sdp;
+}
+
+// Packet as sent over the wire: header, data and end tag
+std::vector<char> serialize(const TSuplaDataPacket &sdp) {
+  size_t size = sizeof(TSuplaDataPacket) - SUPLA_MAX_DATA_SIZE + sdp.data_size;
+  auto begin = reinterpret_cast<const char *>(&sdp);
+  std::vector<char> result(begin, begin + size);
+  result.insert(result.end(), sproto_tag, sproto_tag + SUPLA_TAG_SIZE);
+  return result;
+}
+
+void expectSamePacket(const TSuplaDataPacket &expected,
+                      const TSuplaDataPacket &actual) {
+  EXPECT_EQ(actual.version, expected.version);
+  EXPECT_EQ(actual.rr_id, expected.rr_id);
+  EXPECT_EQ(actual.call_id, expected.call_id);
+  ASSERT_EQ(actual.data_size, expected.data_size);
+  EXPECT_EQ(memcmp(actual.data, expected.data, expected.data_size), 0);
+}
+
+}  // namespace
+
+TEST(SprotoRingBufferTests, InPacketSpanningWrapPointDecodesAtEveryOffset) {
+  auto sender = makeSproto();
+  auto first = makePacket(sender.get(), 100, 200);
+  auto second = makePacket(sender.get(), 200, 150);
+  auto firstBytes = serialize(*first);
+  auto secondBytes = serialize(*second);
+  ASSERT_LE(secondBytes.size(), firstBytes.size());
+
+  std::unique_ptr<TSuplaDataPacket> received(new TSuplaDataPacket);
+  for (size_t split = 0; split <= secondBytes.size(); split++) {
+    SCOPED_TRACE(split);
+    auto spd = makeSproto();
+    // ring is sized to first packet + head of the second one
+    std::vector<char> head(firstBytes);
+    head.insert(
+        head.end(), secondBytes.begin(), secondBytes.begin() + split);
+    ASSERT_EQ(sproto_in_buffer_append(spd.get(), head.data(), head.size()),
+              SUPLA_RESULT_TRUE);
+
+    ASSERT_EQ(sproto_pop_in_sdp(spd.get(), received.get()), SUPLA_RESULT_TRUE);
+    expectSamePacket(*first, *received);
+
+    // remaining bytes fit into space freed by the first packet, so they are
+    // written from the beginning of the ring
+    ASSERT_EQ(sproto_in_buffer_append(spd.get(),
+                                      secondBytes.data() + split,
+                                      secondBytes.size() - split),
+              SUPLA_RESULT_TRUE);
+    ASSERT_EQ(sproto_pop_in_sdp(spd.get(), received.get()), SUPLA_RESULT_TRUE);
+    expectSamePacket(*second, *received);
+    EXPECT_EQ(sproto_in_dataexists(spd.get()), SUPLA_RESULT_FALSE);
+  }
+}
+
+TEST(SprotoRingBufferTests, OutDataSpanningWrapPointIsPoppedInOrder) {
+  auto spd = makeSproto();
+  auto first = makePacket(spd.get(), 100, 300);
+  auto second = makePacket(spd.get(), 200, 100);
+  auto firstBytes = serialize(*first);
+  auto secondBytes = serialize(*second);
+
+  for (size_t popped = secondBytes.size(); popped < firstBytes.size();
+       popped += 7) {
+    SCOPED_TRACE(popped);
+    ASSERT_EQ(sproto_out_buffer_append(spd.get(), first.get()),
+              SUPLA_RESULT_TRUE);
+    std::vector<char> out(firstBytes.size() + secondBytes.size());
+    ASSERT_EQ(sproto_pop_out_data(spd.get(), out.data(), popped), popped);
+
+    ASSERT_EQ(sproto_out_buffer_append(spd.get(), second.get()),
+              SUPLA_RESULT_TRUE);
+    size_t rest = out.size() - popped;
+    ASSERT_EQ(sproto_pop_out_data(spd.get(), out.data() + popped, out.size()),
+              rest);
+    EXPECT_EQ(sproto_out_dataexists(spd.get()), SUPLA_RESULT_FALSE);
+
+    std::vector<char> expected(firstBytes);
+    expected.insert(expected.end(), secondBytes.begin(), secondBytes.end());
+    EXPECT_EQ(out, expected);
+  }
+}
+
+TEST(SprotoRingBufferTests, StreamWithUnalignedChunksDecodesIdentically) {
+  auto sender = makeSproto();
+  auto receiver = makeSproto();
+  std::vector<std::unique_ptr<TSuplaDataPacket>> sent;
+  std::unique_ptr<TSuplaDataPacket> received(new TSuplaDataPacket);
+  size_t receivedCount = 0;
+
+  unsigned int seed = 1;
+  auto next = [&seed]() {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7FFF;
+  };
+
+  for (unsigned int i = 0; i < 2000; i++) {
+    sent.push_back(makePacket(sender.get(), i, next() % 600));
+    ASSERT_EQ(sproto_out_buffer_append(sender.get(), sent.back().get()),
+              SUPLA_RESULT_TRUE);
+
+    // sender output is delivered in chunks not aligned with packets, so
+    // receiver ring always holds a partial packet and its offset keeps moving
+    char chunk[97] = {};
+    unsigned int size = 0;
+    while ((size = sproto_pop_out_data(
+                sender.get(), chunk, 1 + next() % sizeof(chunk))) > 0) {
+      ASSERT_EQ(sproto_in_buffer_append(receiver.get(), chunk, size),
+                SUPLA_RESULT_TRUE);
+      char result = SUPLA_RESULT_FALSE;
+      while ((result = sproto_pop_in_sdp(receiver.get(), received.get())) ==
+             SUPLA_RESULT_TRUE) {
+        ASSERT_LT(receivedCount, sent.size());
+        expectSamePacket(*sent[receivedCount], *received);
+        receivedCount++;
+      }
+      ASSERT_EQ(result, SUPLA_RESULT_FALSE);
+    }
+  }
+  EXPECT_EQ(receivedCount, sent.size());
+  EXPECT_EQ(sproto_in_dataexists(receiver.get()), SUPLA_RESULT_FALSE);
+}
+
+TEST(SprotoRingBufferTests, GarbageBeforePacketIsDroppedAndStreamRecovers) {
+  auto spd = makeSproto();
+  auto packet = makePacket(spd.get(), 10, 40);
+  auto bytes = serialize(*packet);
+  std::unique_ptr<TSuplaDataPacket> received(new TSuplaDataPacket);
+
+  char garbage[] = "not a packet";
+  ASSERT_EQ(sproto_in_buffer_append(spd.get(), garbage, sizeof(garbage)),
+            SUPLA_RESULT_TRUE);
+  EXPECT_EQ(sproto_pop_in_sdp(spd.get(), received.get()),
+            SUPLA_RESULT_DATA_ERROR);
+  EXPECT_EQ(sproto_in_dataexists(spd.get()), SUPLA_RESULT_FALSE);
+
+  ASSERT_EQ(sproto_in_buffer_append(spd.get(), bytes.data(), bytes.size()),
+            SUPLA_RESULT_TRUE);
+  ASSERT_EQ(sproto_pop_in_sdp(spd.get(), received.get()), SUPLA_RESULT_TRUE);
+  expectSamePacket(*packet, *received);
+
+  // broken end tag drops buffered data
+  bytes.back() = 'X';
+  ASSERT_EQ(sproto_in_buffer_append(spd.get(), bytes.data(), bytes.size()),
+            SUPLA_RESULT_TRUE);
+  EXPECT_EQ(sproto_pop_in_sdp(spd.get(), received.get()),
+            SUPLA_RESULT_DATA_ERROR);
+  EXPECT_EQ(sproto_in_dataexists(spd.get()), SUPLA_RESULT_FALSE);
+}
+
+TEST(SprotoRingBufferTests, AppendBeyondMaxSizeOverflows) {
+  auto spd = makeSproto();
+  std::vector<char> data(131072);
+  EXPECT_EQ(sproto_in_buffer_append(spd.get(), data.data(), data.size()),
+            SUPLA_RESULT_BUFFER_OVERFLOW);
+  EXPECT_EQ(sproto_in_dataexists(spd.get()), SUPLA_RESULT_FALSE);
+
+  EXPECT_EQ(sproto_in_buffer_append(spd.get(), data.data(), data.size() - 1),
+            SUPLA_RESULT_TRUE);
+  EXPECT_EQ(sproto_in_buffer_append(spd.get(), data.data(), 1),
+            SUPLA_RESULT_BUFFER_OVERFLOW);
+}
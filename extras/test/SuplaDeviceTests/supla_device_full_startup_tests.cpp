@@ -1008,3 +1008,85 @@ TEST_F(SuplaDeviceFullStartupTests, CheckCustomNameSoftVer) {
   EXPECT_STREQ(Supla::RegisterDevice::getName(), "Some name");
   EXPECT_STREQ(Supla::RegisterDevice::getSoftVer(), "1.2.3");
 }
+
+TEST_F(SuplaDeviceTestsFullStartup, SrpcIsInitializedAfterBackgroundConnect) {
+  bool isConnected = false;
+  EXPECT_CALL(net, isReady()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*client, connected()).WillRepeatedly(ReturnPointee(&isConnected));
+  EXPECT_CALL(*client, connectImp(_, _))
+      .WillOnce(DoAll(Assign(&isConnected, true),
+                      Assign(&client->connecting, true),
+                      Return(1)));
+
+  EXPECT_CALL(net, setup()).Times(1);
+  EXPECT_CALL(net, iterate()).Times(AtLeast(1));
+  EXPECT_CALL(el1, iterateAlways()).Times(AtLeast(1));
+  EXPECT_CALL(el2, iterateAlways()).Times(AtLeast(1));
+
+  int srpcInitCount = 0;
+  int dummy;
+  EXPECT_CALL(srpc, srpc_params_init(_)).Times(AtLeast(0));
+  EXPECT_CALL(srpc, srpc_init(_)).WillRepeatedly([&](TsrpcParams *) {
+    srpcInitCount++;
+    return &dummy;
+  });
+  EXPECT_CALL(srpc, srpc_set_proto_version(&dummy, defaultProtoVersion))
+      .Times(AtLeast(0));
+  EXPECT_CALL(srpc, srpc_iterate(_)).WillRepeatedly(Return(SUPLA_RESULT_TRUE));
+  EXPECT_CALL(srpc, srpc_ds_async_registerdevice_in_chunks(_, _)).Times(1);
+
+  for (int i = 0; i < 5; i++) {
+    sd.iterate();
+    time.advance(100);
+  }
+  // TLS handshake is still in progress, so srpc can't be used yet
+  EXPECT_EQ(srpcInitCount, 0);
+  EXPECT_NE(sd.getCurrentStatus(), STATUS_REGISTER_IN_PROGRESS);
+
+  client->connecting = false;
+  for (int i = 0; i < 5; i++) {
+    sd.iterate();
+    time.advance(100);
+  }
+  EXPECT_EQ(srpcInitCount, 1);
+  EXPECT_EQ(sd.getCurrentStatus(), STATUS_REGISTER_IN_PROGRESS);
+}
+
+TEST_F(SuplaDeviceTestsFullStartup, FailedBackgroundConnectIsConnectionFail) {
+  int connectCount = 0;
+  int connectedCalls = 0;
+  EXPECT_CALL(net, isReady()).WillRepeatedly(Return(true));
+  EXPECT_CALL(*client, connectImp(_, _)).WillRepeatedly([&](const char *,
+                                                            uint16_t) {
+    connectCount++;
+    connectedCalls = 0;
+    client->connecting = true;
+    return 1;
+  });
+  // handshake fails in background on second check of connection state
+  EXPECT_CALL(*client, connected()).WillRepeatedly([&]() -> uint8_t {
+    if (!client->connecting) {
+      return false;
+    }
+    if (++connectedCalls >= 2) {
+      client->connecting = false;
+      return false;
+    }
+    return true;
+  });
+  EXPECT_CALL(*client, stop()).WillRepeatedly(Assign(&client->connecting,
+                                                     false));
+
+  EXPECT_CALL(net, setup()).Times(AtLeast(0));
+  EXPECT_CALL(net, iterate()).Times(AtLeast(1));
+  EXPECT_CALL(el1, iterateAlways()).Times(AtLeast(1));
+  EXPECT_CALL(el2, iterateAlways()).Times(AtLeast(1));
+  EXPECT_CALL(srpc, srpc_init(_)).Times(0);
+
+  for (int i = 0; i < 200; i++) {
+    sd.iterate();
+    time.advance(100);
+  }
+  EXPECT_GE(connectCount, 2);
+  EXPECT_EQ(sd.getCurrentStatus(), STATUS_SERVER_DISCONNECTED);
+}
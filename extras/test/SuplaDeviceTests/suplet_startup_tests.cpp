@@ -765,7 +765,7 @@ TEST_F(SuplaDeviceSupletStartupTests,
   EXPECT_EQ(supletResult.DetailCode, SUPLA_CALCFG_SUPLET_RESULT_OK);
   EXPECT_EQ(registry.findDefinition(5002, 1), nullptr);
   Supla::Suplet::JsonDefinition loadedDefinition;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 5002, 1, &loadedDefinition));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 5002, 1, &loadedDefinition));
   ASSERT_NE(loadedDefinition.getDefinition(), nullptr);
   EXPECT_EQ(loadedDefinition.getDefinition()->definitionId, 5002u);
   EXPECT_EQ(loadedDefinition.getDefinition()->definitionVersion, 1);
@@ -1158,7 +1158,7 @@ TEST_F(SuplaDeviceSupletStartupTests,
   EXPECT_EQ(handler.saveDownloadedDefinition(3001, 1, sameVersionJson, sha),
             Supla::Suplet::ServerConfigResult::DefinitionCannotBeChanged);
   Supla::Suplet::JsonDefinition loadedDefinition;
-  EXPECT_FALSE(downloadedDefinitions.load(cache, 3001, 1, &loadedDefinition));
+  EXPECT_FALSE(downloadedDefinitions.load(&cache, 3001, 1, &loadedDefinition));
 }
 
 TEST_F(SuplaDeviceSupletStartupTests,
@@ -1200,7 +1200,7 @@ TEST_F(SuplaDeviceSupletStartupTests,
   EXPECT_EQ(handler.saveDownloadedDefinition(3001, 2, newVersionJson, sha),
             Supla::Suplet::ServerConfigResult::Applied);
   Supla::Suplet::JsonDefinition loadedDefinition;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 3001, 2, &loadedDefinition));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 3001, 2, &loadedDefinition));
   ASSERT_NE(loadedDefinition.getDefinition(), nullptr);
   EXPECT_EQ(loadedDefinition.getDefinition()->definitionId, 3001u);
   EXPECT_EQ(loadedDefinition.getDefinition()->definitionVersion, 2);
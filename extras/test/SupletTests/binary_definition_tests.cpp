@@ -0,0 +1,436 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <supla/storage/config.h>
+#include <supla/suplet/binary_definition.h>
+#include <supla/suplet/definition_cache.h>
+#include <supla/suplet/json_definition.h>
+#include <supla/suplet/server_config.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+class InMemoryConfig : public Supla::Config {
+ public:
+  bool init() override {
+    return true;
+  }
+  void removeAll() override {
+    blobs.clear();
+    uint8Values.clear();
+  }
+  bool setString(const char *, const char *) override {
+    return false;
+  }
+  bool getString(const char *, char *, size_t) override {
+    return false;
+  }
+  int getStringSize(const char *) override {
+    return -1;
+  }
+  bool setBlob(const char *key, const char *value, size_t blobSize) override {
+    if (key == nullptr || value == nullptr) {
+      return false;
+    }
+    blobs[key] = std::vector<char>(value, value + blobSize);
+    return true;
+  }
+  bool getBlob(const char *key, char *value, size_t blobSize) override {
+    if (key == nullptr || value == nullptr || blobs.count(key) == 0 ||
+        blobs[key].size() != blobSize) {
+      return false;
+    }
+    blobReads[key]++;
+    memcpy(value, blobs[key].data(), blobSize);
+    return true;
+  }
+  int getBlobSize(const char *key) override {
+    if (key == nullptr || blobs.count(key) == 0) {
+      return -1;
+    }
+    return blobs[key].size();
+  }
+  bool getInt8(const char *, int8_t *) override {
+    return false;
+  }
+  bool getUInt8(const char *key, uint8_t *result) override {
+    if (key == nullptr || result == nullptr || uint8Values.count(key) == 0) {
+      return false;
+    }
+    *result = uint8Values[key];
+    return true;
+  }
+  bool getInt32(const char *, int32_t *) override {
+    return false;
+  }
+  bool getUInt32(const char *, uint32_t *) override {
+    return false;
+  }
+  bool setInt8(const char *, const int8_t) override {
+    return false;
+  }
+  bool setUInt8(const char *key, const uint8_t value) override {
+    if (key == nullptr) {
+      return false;
+    }
+    uint8Values[key] = value;
+    return true;
+  }
+  bool setInt32(const char *, const int32_t) override {
+    return false;
+  }
+  bool setUInt32(const char *, const uint32_t) override {
+    return false;
+  }
+  bool eraseKey(const char *key) override {
+    if (key == nullptr) {
+      return false;
+    }
+    bool erased = blobs.erase(key) > 0;
+    erased = (uint8Values.erase(key) > 0) || erased;
+    return erased;
+  }
+
+  std::map<std::string, std::vector<char>> blobs;
+  std::map<std::string, uint8_t> uint8Values;
+  std::map<std::string, int> blobReads;
+};
+
+class FakeSha256Provider : public Supla::Suplet::Sha256Provider {
+ public:
+  bool calculate(const uint8_t *data,
+                 size_t dataSize,
+                 uint8_t *output,
+                 size_t outputSize) override {
+    if (data == nullptr || output == nullptr || outputSize < 32) {
+      return false;
+    }
+    uint8_t sum = 0;
+    uint8_t x = 0x5A;
+    for (size_t i = 0; i < dataSize; i++) {
+      sum = static_cast<uint8_t>(sum + data[i]);
+      x = static_cast<uint8_t>((x << 1) ^ data[i] ^ (x >> 7));
+    }
+    for (uint8_t i = 0; i < 32; i++) {
+      output[i] = static_cast<uint8_t>(sum + x + i + dataSize);
+    }
+    return true;
+  }
+};
+
+void makeSha(FakeSha256Provider *provider, const char *json, uint8_t *sha) {
+  ASSERT_TRUE(provider->calculate(
+      reinterpret_cast<const uint8_t *>(json), strlen(json), sha, 32));
+}
+
+// One definition of every kind, with all parameter types and optional fields
+// both present and missing
+const char *const definitionCorpus[] = {
+    "{\"schemaVersion\":1,\"handlerVersion\":2,\"definitionId\":1001,"
+    "\"definitionVersion\":7,\"maxInstances\":6,\"category\":\"virtual\","
+    "\"kind\":\"virtualRelay\",\"name\":\"Virtual controls\","
+    "\"parameters\":["
+    "{\"key\":\"relay.count\",\"type\":\"uint8\",\"default\":4,"
+    "\"min\":1,\"max\":16,\"lifecycle\":\"createOnly\","
+    "\"affectsTopology\":true},"
+    "{\"key\":\"mode\",\"type\":\"enum\",\"default\":\"avg\","
+    "\"values\":[\"avg\",\"min\",\"max\"],\"required\":true},"
+    "{\"key\":\"password\",\"type\":\"secret\",\"lifecycle\":\"secret\"},"
+    "{\"key\":\"offset\",\"type\":\"int16\",\"default\":-300,"
+    "\"min\":-1000,\"max\":1000},"
+    "{\"key\":\"enabled\",\"type\":\"bool\",\"default\":false}"
+    "],"
+    "\"channels\":["
+    "{\"channelId\":1,\"kind\":\"virtualRelay\","
+    "\"function\":\"powerSwitch\",\"caption\":\"Main relay\"},"
+    "{\"channelId\":7,\"kind\":\"virtualRelay\",\"function\":\"lightSwitch\","
+    "\"caption\":\"\"}"
+    "]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtBinSensor\","
+    "\"n\":\"Door\",\"ch\":[{\"id\":2,\"k\":\"virtBinSensor\","
+    "\"fn\":\"osd\"}]}",
+    "{\"definitionId\":1003,\"definitionVersion\":65535,"
+    "\"category\":\"aggregate\",\"kind\":\"thermometerGroup\","
+    "\"parameters\":["
+    "{\"key\":\"sources\",\"type\":\"channelList\",\"required\":true},"
+    "{\"key\":\"mode\",\"type\":\"enum\",\"default\":\"avg\","
+    "\"values\":[\"avg\",\"min\",\"max\"]}],"
+    "\"channels\":[{\"channelId\":1,\"kind\":\"virtualThermometer\","
+    "\"function\":\"thermometer\",\"caption\":\"Average \\\"temp\\\"\"}]}",
+    "{\"definitionId\":4294967295,\"definitionVersion\":3,"
+    "\"maxInstances\":255,\"category\":\"modbus\",\"kind\":\"modbusRtu\","
+    "\"name\":\"Meter\",\"parameters\":["
+    "{\"key\":\"address\",\"type\":\"uint8\",\"min\":1,\"max\":247,"
+    "\"default\":1,\"lifecycle\":\"readonly\"},"
+    "{\"key\":\"baud\",\"type\":\"uint16\",\"default\":9600}],"
+    "\"channels\":[{\"channelId\":3,\"kind\":\"virtualThermometer\","
+    "\"defaultFunction\":-1}]}",
+    "{\"definitionId\":1005,\"definitionVersion\":2,"
+    "\"category\":\"httpIntegration\",\"kind\":\"httpInverter\","
+    "\"parameters\":["
+    "{\"key\":\"host\",\"type\":\"string\",\"required\":true,"
+    "\"default\":\"192.168.1.2\"},"
+    "{\"key\":\"token\",\"type\":\"secret\",\"lifecycle\":\"secret\"}],"
+    "\"channels\":[{\"channelId\":1,\"kind\":\"virtualRelay\"},"
+    "{\"channelId\":2,\"kind\":\"virtualBinarySensor\"}]}",
+};
+
+void expectSameText(const char *expected, const char *actual) {
+  if (expected == nullptr) {
+    EXPECT_EQ(actual, nullptr);
+  } else {
+    ASSERT_NE(actual, nullptr);
+    EXPECT_STREQ(actual, expected);
+  }
+}
+
+void expectSameDefinition(const Supla::Suplet::Definition &expected,
+                          const Supla::Suplet::Definition &actual) {
+  EXPECT_EQ(actual.category, expected.category);
+  EXPECT_EQ(actual.kind, expected.kind);
+  EXPECT_EQ(actual.schemaVersion, expected.schemaVersion);
+  EXPECT_EQ(actual.handlerVersion, expected.handlerVersion);
+  EXPECT_EQ(actual.definitionId, expected.definitionId);
+  EXPECT_EQ(actual.definitionVersion, expected.definitionVersion);
+  EXPECT_EQ(actual.maxInstances, expected.maxInstances);
+  expectSameText(expected.name, actual.name);
+  EXPECT_EQ(actual.runtimeHandler, nullptr);
+  EXPECT_EQ(actual.definitionJson, nullptr);
+
+  ASSERT_EQ(actual.channelCount, expected.channelCount);
+  for (uint8_t i = 0; i < expected.channelCount; i++) {
+    SCOPED_TRACE(i);
+    EXPECT_EQ(actual.channels[i].channelId, expected.channels[i].channelId);
+    EXPECT_EQ(actual.channels[i].kind, expected.channels[i].kind);
+    EXPECT_EQ(actual.channels[i].defaultFunction,
+              expected.channels[i].defaultFunction);
+    expectSameText(expected.channels[i].caption, actual.channels[i].caption);
+  }
+
+  ASSERT_EQ(actual.parameterCount, expected.parameterCount);
+  for (uint8_t i = 0; i < expected.parameterCount; i++) {
+    SCOPED_TRACE(i);
+    const auto &a = actual.parameters[i];
+    const auto &e = expected.parameters[i];
+    expectSameText(e.key, a.key);
+    EXPECT_EQ(a.type, e.type);
+    EXPECT_EQ(a.lifecycle, e.lifecycle);
+    EXPECT_EQ(a.min, e.min);
+    EXPECT_EQ(a.max, e.max);
+    EXPECT_EQ(a.defaultNumber, e.defaultNumber);
+    expectSameText(e.defaultText, a.defaultText);
+    expectSameText(e.enumValues, a.enumValues);
+    EXPECT_EQ(a.required, e.required);
+    EXPECT_EQ(a.hasDefault, e.hasDefault);
+    EXPECT_EQ(a.affectsTopology, e.affectsTopology);
+  }
+}
+
+std::vector<uint8_t> encode(const Supla::Suplet::Definition &definition) {
+  std::vector<uint8_t> image(SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE);
+  uint16_t size = Supla::Suplet::BinaryDefinition::encode(
+      definition, image.data(), image.size());
+  image.resize(size);
+  return image;
+}
+
+}  // namespace
+
+TEST(SupletBinaryDefinitionTests, RoundTripsEveryDefinitionKind) {
+  for (const char *json : definitionCorpus) {
+    SCOPED_TRACE(json);
+    Supla::Suplet::JsonDefinition parsed;
+    ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(json, &parsed));
+
+    auto image = encode(*parsed.getDefinition());
+    ASSERT_FALSE(image.empty());
+    EXPECT_LT(image.size(), strlen(json));
+    EXPECT_EQ(image[0], Supla::Suplet::BinaryDefinition::kFormatVersion);
+
+    Supla::Suplet::JsonDefinition decoded;
+    ASSERT_TRUE(Supla::Suplet::BinaryDefinition::decode(
+        image.data(), image.size(), &decoded));
+    expectSameDefinition(*parsed.getDefinition(), *decoded.getDefinition());
+    // decoded strings live in decoded object, not in the image
+    EXPECT_EQ(decoded.getDefinition()->name, decoded.getNameBuffer());
+  }
+}
+
+TEST(SupletBinaryDefinitionTests, RejectsDamagedImages) {
+  Supla::Suplet::JsonDefinition parsed;
+  ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(definitionCorpus[0],
+                                                         &parsed));
+  auto image = encode(*parsed.getDefinition());
+  ASSERT_FALSE(image.empty());
+
+  Supla::Suplet::JsonDefinition decoded;
+  for (size_t size = 0; size < image.size(); size++) {
+    EXPECT_FALSE(Supla::Suplet::BinaryDefinition::decode(
+        image.data(), size, &decoded))
+        << size;
+  }
+
+  auto trailing = image;
+  trailing.push_back(0);
+  EXPECT_FALSE(Supla::Suplet::BinaryDefinition::decode(
+      trailing.data(), trailing.size(), &decoded));
+
+  auto otherFormat = image;
+  otherFormat[0]++;
+  EXPECT_FALSE(Supla::Suplet::BinaryDefinition::decode(
+      otherFormat.data(), otherFormat.size(), &decoded));
+
+  // category is stored right after the format version
+  auto badCategory = image;
+  badCategory[1] = 0x7F;
+  EXPECT_FALSE(Supla::Suplet::BinaryDefinition::decode(
+      badCategory.data(), badCategory.size(), &decoded));
+
+  // name length (after fixed size header fields) longer than name buffer
+  auto longName = image;
+  longName[12] = SUPLA_SUPLET_MAX_NAME_SIZE;
+  EXPECT_FALSE(Supla::Suplet::BinaryDefinition::decode(
+      longName.data(), longName.size(), &decoded));
+
+  ASSERT_TRUE(Supla::Suplet::BinaryDefinition::decode(
+      image.data(), image.size(), &decoded));
+}
+
+TEST(SupletBinaryDefinitionTests, EncodeFailsWhenOutputIsTooSmall) {
+  Supla::Suplet::JsonDefinition parsed;
+  ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(definitionCorpus[0],
+                                                         &parsed));
+  auto image = encode(*parsed.getDefinition());
+  ASSERT_FALSE(image.empty());
+
+  std::vector<uint8_t> output(image.size());
+  EXPECT_EQ(Supla::Suplet::BinaryDefinition::encode(
+                *parsed.getDefinition(), output.data(), output.size() - 1),
+            0);
+  EXPECT_EQ(Supla::Suplet::BinaryDefinition::encode(
+                *parsed.getDefinition(), output.data(), output.size()),
+            image.size());
+  EXPECT_EQ(output, image);
+}
+
+TEST(SupletBinaryDefinitionTests, CachedDefinitionLoadsFromCompiledImage) {
+  InMemoryConfig config;
+  FakeSha256Provider shaProvider;
+  Supla::Suplet::DefinitionCache cache(&config, &shaProvider);
+  Supla::Suplet::DownloadedDefinitionStore store;
+
+  for (const char *json : definitionCorpus) {
+    SCOPED_TRACE(json);
+    config.removeAll();
+    config.blobReads.clear();
+    Supla::Suplet::JsonDefinition parsed;
+    ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(json, &parsed));
+    const auto *expected = parsed.getDefinition();
+    uint8_t sha[32] = {};
+    makeSha(&shaProvider, json, sha);
+    ASSERT_TRUE(cache.save(
+        expected->definitionId, expected->definitionVersion, json, sha));
+    EXPECT_EQ(config.blobs.count("spld0_1b"), 0u);
+
+    // first load parses JSON and stores compiled image
+    Supla::Suplet::JsonDefinition fromJson;
+    ASSERT_TRUE(store.load(&cache,
+                           expected->definitionId,
+                           expected->definitionVersion,
+                           &fromJson));
+    expectSameDefinition(*expected, *fromJson.getDefinition());
+    EXPECT_EQ(config.blobReads["spld0_1c0"], 1);
+    ASSERT_EQ(config.blobs.count("spld0_1b"), 1u);
+
+    // next one uses only compiled image
+    Supla::Suplet::JsonDefinition fromImage;
+    Supla::Suplet::CachedDefinitionInfo info = {};
+    ASSERT_TRUE(store.load(&cache,
+                           expected->definitionId,
+                           expected->definitionVersion,
+                           &fromImage,
+                           &info));
+    expectSameDefinition(*expected, *fromImage.getDefinition());
+    EXPECT_EQ(config.blobReads["spld0_1c0"], 1);
+    EXPECT_EQ(config.blobReads["spld0_1b"], 1);
+    EXPECT_EQ(info.definitionId, expected->definitionId);
+    EXPECT_EQ(memcmp(info.sha256, sha, sizeof(sha)), 0);
+  }
+}
+
+TEST(SupletBinaryDefinitionTests, CompiledImageIsIgnoredWhenDigestChanges) {
+  InMemoryConfig config;
+  FakeSha256Provider shaProvider;
+  Supla::Suplet::DefinitionCache cache(&config, &shaProvider);
+  Supla::Suplet::DownloadedDefinitionStore store;
+
+  const char *json = definitionCorpus[1];
+  uint8_t sha[32] = {};
+  makeSha(&shaProvider, json, sha);
+  ASSERT_TRUE(cache.save(1002, 1, json, sha));
+  Supla::Suplet::JsonDefinition loaded;
+  ASSERT_TRUE(store.load(&cache, 1002, 1, &loaded));
+  ASSERT_EQ(config.blobs.count("spld0_1b"), 1u);
+
+  // compiled image of other JSON can't be stored nor loaded
+  uint8_t otherSha[32] = {};
+  memcpy(otherSha, sha, sizeof(sha));
+  otherSha[0]++;
+  auto image = encode(*loaded.getDefinition());
+  EXPECT_FALSE(cache.saveCompiled(1002, 1, otherSha, image.data(),
+                                  image.size()));
+  // compiled image header: magic, version, reserved, size, crc16, sha256
+  config.blobs["spld0_1b"][10]++;
+  uint8_t output[SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE] = {};
+  uint16_t outputSize = 0;
+  EXPECT_FALSE(
+      cache.loadCompiled(1002, 1, output, sizeof(output), &outputSize));
+
+  config.blobReads.clear();
+  ASSERT_TRUE(store.load(&cache, 1002, 1, &loaded));
+  EXPECT_EQ(config.blobReads["spld0_1c0"], 1);
+  EXPECT_TRUE(
+      cache.loadCompiled(1002, 1, output, sizeof(output), &outputSize));
+  EXPECT_EQ(outputSize, image.size());
+
+  // new JSON goes to other variant, old compiled image is erased with it
+  const char *updated =
+      "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtBinSensor\","
+      "\"n\":\"Gate\",\"ch\":[{\"id\":2,\"k\":\"virtBinSensor\","
+      "\"fn\":\"osd\"}]}";
+  makeSha(&shaProvider, updated, sha);
+  ASSERT_TRUE(cache.save(1002, 1, updated, sha));
+  EXPECT_EQ(config.blobs.count("spld0_1b"), 0u);
+  ASSERT_TRUE(store.load(&cache, 1002, 1, &loaded));
+  EXPECT_STREQ(loaded.getDefinition()->name, "Gate");
+  EXPECT_EQ(config.blobs.count("spld0_2b"), 1u);
+}
+
+TEST(SupletBinaryDefinitionTests, DownloadedDefinitionIsCompiledWhenSaved) {
+  InMemoryConfig config;
+  FakeSha256Provider shaProvider;
+  Supla::Suplet::DefinitionCache cache(&config, &shaProvider);
+  Supla::Suplet::DownloadedDefinitionStore store;
+  Supla::Suplet::ServerConfigHandler handler(
+      nullptr, nullptr, &cache, &store);
+
+  const char *json = definitionCorpus[0];
+  uint8_t sha[32] = {};
+  makeSha(&shaProvider, json, sha);
+  ASSERT_EQ(handler.saveDownloadedDefinition(1001, 7, json, sha),
+            Supla::Suplet::ServerConfigResult::Applied);
+  ASSERT_EQ(config.blobs.count("spld0_1b"), 1u);
+
+  Supla::Suplet::JsonDefinition parsed;
+  ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(json, &parsed));
+  Supla::Suplet::JsonDefinition loaded;
+  ASSERT_TRUE(store.load(&cache, 1001, 7, &loaded));
+  expectSameDefinition(*parsed.getDefinition(), *loaded.getDefinition());
+  EXPECT_EQ(config.blobReads.count("spld0_1c0"), 0u);
+}
@@ -0,0 +1,327 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <supla/suplet/config.h>
+#include <supla/suplet/json_definition.h>
+#include <supla/suplet/json_definition_stream.h>
+
+#include <string>
+
+namespace {
+
+// Definitions accepted by JsonDefinitionParser, covering all definition kinds,
+// compact aliases, escapes, whitespace and skipped unknown values.
+const char *const validCorpus[] = {
+    "{\"schemaVersion\":1,\"handlerVersion\":2,\"definitionId\":1001,"
+    "\"definitionVersion\":7,\"maxInstances\":6,\"category\":\"virtual\","
+    "\"kind\":\"virtualRelay\",\"name\":\"Virtual \\\"controls\\\"\","
+    "\"parameters\":["
+    "{\"key\":\"relay.count\",\"type\":\"uint8\",\"default\":4,"
+    "\"min\":1,\"max\":16,\"lifecycle\":\"createOnly\","
+    "\"affectsTopology\":true},"
+    "{\"key\":\"mode\",\"type\":\"enum\",\"default\":\"avg\","
+    "\"values\":[\"avg\",\"min\",\"max\"],\"required\":true},"
+    "{\"key\":\"password\",\"type\":\"secret\",\"lifecycle\":\"secret\"},"
+    "{\"key\":\"offset\",\"type\":\"int16\",\"default\":-300,"
+    "\"min\":-1000,\"max\":1000},"
+    "{\"key\":\"enabled\",\"type\":\"bool\",\"default\":false,"
+    "\"required\":false,\"affectsTopology\":false}"
+    "],"
+    "\"channels\":["
+    "{\"channelId\":1,\"kind\":\"virtualRelay\","
+    "\"function\":\"powerSwitch\",\"caption\":\"Main\\trelay\\n\"},"
+    "{\"channelId\":7,\"kind\":\"virtualRelay\",\"function\":\"lightSwitch\","
+    "\"caption\":\"\"}"
+    "]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtBinSensor\","
+    "\"n\":\"Door\",\"ch\":[{\"id\":2,\"k\":\"virtBinSensor\","
+    "\"fn\":\"osd\",\"cap\":\"a\\/b\\\\c\"}]}",
+    "{\"definitionId\":1003,\"definitionVersion\":65535,"
+    "\"category\":\"aggregate\",\"kind\":\"thermometerGroup\","
+    "\"parameters\":["
+    "{\"key\":\"sources\",\"type\":\"channelList\",\"required\":true},"
+    "{\"key\":\"mode\",\"t\":\"e\",\"d\":\"avg\","
+    "\"v\":[\"avg\",\"min\",\"max\"],\"lc\":\"ed\"}],"
+    "\"channels\":[{\"channelId\":1,\"kind\":\"virtualThermometer\","
+    "\"function\":\"thermometer\"}]}",
+    " \r\n\t{ \"definitionId\" : 4294967295 , \"definitionVersion\" : 3 ,\n"
+    "  \"maxInstances\" : 255, \"category\" : \"modbus\",\n"
+    "  \"kind\" : \"modbusRtu\", \"name\" : \"Meter\",\n"
+    "  \"parameters\" : [ { \"key\" : \"address\", \"type\" : \"u8\",\n"
+    "    \"min\" : 1, \"max\" : 247, \"default\" : 1, \"lc\" : \"ro\" } ,\n"
+    "    { \"key\" : \"baud\", \"type\" : \"u16\", \"default\" : 9600 } ],\n"
+    "  \"channels\" : [ { \"channelId\" : 3, \"kind\" : \"virtThermo\",\n"
+    "    \"defaultFunction\" : - 1 } ] }\n\t ",
+    "{\"definitionId\":1005,\"definitionVersion\":2,"
+    "\"category\":\"http\",\"kind\":\"httpInverter\","
+    "\"ui\":{\"layout\":[1,[2,{\"deep\":[null,true,false,-2147483648]}],{}],"
+    "\"title\":\"\\u0041 \\{ skipped\",\"empty\":[]},"
+    "\"parameters\":["
+    "{\"key\":\"host\",\"type\":\"string\",\"required\":true,"
+    "\"default\":\"192.168.1.2\",\"hint\":{\"x\":\"y\"}},"
+    "{\"key\":\"token\",\"type\":\"sec\",\"lc\":\"sec\"},"
+    "{\"key\":\"flags\",\"t\":\"e\",\"v\":[\"\",\"a\"]}],"
+    "\"channels\":[{\"channelId\":1,\"kind\":\"virtualRelay\","
+    "\"df\":140,\"note\":\"x\"},"
+    "{\"channelId\":2,\"kind\":\"virtualBinarySensor\"}],"
+    "\"channels\":[{\"channelId\":4,\"kind\":\"virtualRelay\"}],"
+    "\"name\":\"Inverter\",\"name\":\"Inverter 2\"}",
+    "{\"di\":1006,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\",\"p\":[],"
+    "\"ch\":[],\"ch\":[{\"id\":1,\"k\":\"virtRelay\"}]}",
+};
+
+// Documents rejected by JsonDefinitionParser. Stream parser has to reject
+// them too, at any chunk boundary.
+const char *const invalidCorpus[] = {
+    "",
+    "{}",
+    "{\"di\":1002",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\"} x",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\",}",
+    "{\"di\":1002 1,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":-1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":4294967296,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":1002,\"dv\":65536,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":1002,\"dv\":1,\"mi\":0,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":1002,\"dv\":1,\"sv\":256,\"c\":\"virt\",\"k\":\"virtRelay\"}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virtual2\",\"k\":\"virtRelay\"}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"n\":\"\\u0041\"}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"n\":\"0123456789012345678901234567890123456789012345678\"}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"key-which-is-too-long-24\":1}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"x\":2147483648}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"x\":tru}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"x\":1.5}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":0,\"k\":\"virtRelay\"}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":1}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":1,\"k\":\"virtRelay\",\"df\":\"ps\"}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":1,\"k\":\"virtRelay\",\"fn\":\"dimmer\"}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"\",\"t\":\"b\"}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"a\",\"t\":\"u8\",\"min\":5,\"max\":4}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"a\",\"t\":\"e\",\"v\":[]}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"a\",\"t\":\"e\",\"v\":[\"0123456789\","
+    "\"0123456789\",\"0123456789\",\"0123456789\",\"0123456789\","
+    "\"0123456789\"]}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"a\",\"t\":\"b\",\"r\":1}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"p\":[{\"key\":\"a\",\"t\":\"b\",\"d\":null}]}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":1,\"k\":\"virtRelay\"}],}",
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+    "\"ch\":[{\"id\":1,\"k\":\"virtRelay\"},]}",
+    // valid JSON, but not valid definition
+    "{\"di\":1002,\"dv\":1,\"c\":\"virt\"}",
+};
+
+void expectSameText(const char *expected, const char *actual) {
+  if (expected == nullptr) {
+    EXPECT_EQ(actual, nullptr);
+  } else {
+    ASSERT_NE(actual, nullptr);
+    EXPECT_STREQ(actual, expected);
+  }
+}
+
+void expectSameDefinition(const Supla::Suplet::Definition &expected,
+                          const Supla::Suplet::Definition &actual) {
+  EXPECT_EQ(actual.category, expected.category);
+  EXPECT_EQ(actual.kind, expected.kind);
+  EXPECT_EQ(actual.schemaVersion, expected.schemaVersion);
+  EXPECT_EQ(actual.handlerVersion, expected.handlerVersion);
+  EXPECT_EQ(actual.definitionId, expected.definitionId);
+  EXPECT_EQ(actual.definitionVersion, expected.definitionVersion);
+  EXPECT_EQ(actual.maxInstances, expected.maxInstances);
+  expectSameText(expected.name, actual.name);
+
+  ASSERT_EQ(actual.channelCount, expected.channelCount);
+  for (uint8_t i = 0; i < expected.channelCount; i++) {
+    SCOPED_TRACE(i);
+    EXPECT_EQ(actual.channels[i].channelId, expected.channels[i].channelId);
+    EXPECT_EQ(actual.channels[i].kind, expected.channels[i].kind);
+    EXPECT_EQ(actual.channels[i].defaultFunction,
+              expected.channels[i].defaultFunction);
+    expectSameText(expected.channels[i].caption, actual.channels[i].caption);
+  }
+
+  ASSERT_EQ(actual.parameterCount, expected.parameterCount);
+  for (uint8_t i = 0; i < expected.parameterCount; i++) {
+    SCOPED_TRACE(i);
+    const auto &a = actual.parameters[i];
+    const auto &e = expected.parameters[i];
+    expectSameText(e.key, a.key);
+    EXPECT_EQ(a.type, e.type);
+    EXPECT_EQ(a.lifecycle, e.lifecycle);
+    EXPECT_EQ(a.min, e.min);
+    EXPECT_EQ(a.max, e.max);
+    EXPECT_EQ(a.defaultNumber, e.defaultNumber);
+    expectSameText(e.defaultText, a.defaultText);
+    expectSameText(e.enumValues, a.enumValues);
+    EXPECT_EQ(a.required, e.required);
+    EXPECT_EQ(a.hasDefault, e.hasDefault);
+    EXPECT_EQ(a.affectsTopology, e.affectsTopology);
+  }
+}
+
+// Feeds json in chunks: first one ends at split, following ones have
+// chunkSize bytes (or less for the last one).
+bool parseInChunks(Supla::Suplet::JsonDefinitionStreamParser *parser,
+                   const std::string &json,
+                   size_t split,
+                   size_t chunkSize,
+                   Supla::Suplet::JsonDefinition *output) {
+  parser->begin(output);
+  if (!parser->feed(json.data(), split)) {
+    return false;
+  }
+  for (size_t pos = split; pos < json.size(); pos += chunkSize) {
+    size_t size = json.size() - pos;
+    if (size > chunkSize) {
+      size = chunkSize;
+    }
+    if (!parser->feed(json.data() + pos, size)) {
+      return false;
+    }
+  }
+  return parser->finish();
+}
+
+}  // namespace
+
+TEST(SupletJsonDefinitionStreamTests, ValidCorpusMatchesParserAtAnyChunking) {
+  Supla::Suplet::JsonDefinitionStreamParser parser;
+  for (const char *text : validCorpus) {
+    SCOPED_TRACE(text);
+    std::string json(text);
+    Supla::Suplet::JsonDefinition expected;
+    ASSERT_TRUE(Supla::Suplet::JsonDefinitionParser::parse(text, &expected));
+
+    for (size_t split = 0; split <= json.size(); split++) {
+      SCOPED_TRACE(split);
+      Supla::Suplet::JsonDefinition actual;
+      ASSERT_TRUE(
+          parseInChunks(&parser, json, split, json.size(), &actual));
+      expectSameDefinition(*expected.getDefinition(),
+                           *actual.getDefinition());
+    }
+    for (size_t chunkSize = 1; chunkSize <= json.size(); chunkSize++) {
+      SCOPED_TRACE(chunkSize);
+      Supla::Suplet::JsonDefinition actual;
+      ASSERT_TRUE(parseInChunks(&parser, json, 0, chunkSize, &actual));
+      expectSameDefinition(*expected.getDefinition(),
+                           *actual.getDefinition());
+    }
+  }
+}
+
+TEST(SupletJsonDefinitionStreamTests, InvalidCorpusIsRejectedAtAnyChunking) {
+  Supla::Suplet::JsonDefinitionStreamParser parser;
+  for (const char *text : invalidCorpus) {
+    SCOPED_TRACE(text);
+    std::string json(text);
+    Supla::Suplet::JsonDefinition expected;
+    ASSERT_FALSE(Supla::Suplet::JsonDefinitionParser::parse(text, &expected));
+
+    for (size_t split = 0; split <= json.size(); split++) {
+      Supla::Suplet::JsonDefinition actual;
+      EXPECT_FALSE(parseInChunks(&parser, json, split, json.size(), &actual))
+          << split;
+    }
+    for (size_t chunkSize = 1; chunkSize <= json.size(); chunkSize++) {
+      Supla::Suplet::JsonDefinition actual;
+      EXPECT_FALSE(parseInChunks(&parser, json, 0, chunkSize, &actual))
+          << chunkSize;
+    }
+  }
+}
+
+TEST(SupletJsonDefinitionStreamTests, LargeDefinitionIsParsedChunkByChunk) {
+  // Skipped values don't use parser memory, so definition may be longer
+  // than any buffer used while parsing.
+  std::string json =
+      "{\"di\":1007,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+      "\"description\":\"";
+  json.append(5000, 'x');
+  json += "\",\"ch\":[";
+  for (int i = 1; i <= SUPLA_SUPLET_MAX_CHANNELS_PER_INSTANCE; i++) {
+    if (i > 1) {
+      json += ",";
+    }
+    json += "{\"id\":" + std::to_string(i) +
+            ",\"k\":\"virtRelay\",\"fn\":\"ps\",\"cap\":\"Relay " +
+            std::to_string(i) + "\"}";
+  }
+  json += "]}";
+
+  Supla::Suplet::JsonDefinition expected;
+  ASSERT_TRUE(
+      Supla::Suplet::JsonDefinitionParser::parse(json.c_str(), &expected));
+
+  Supla::Suplet::JsonDefinitionStreamParser parser;
+  Supla::Suplet::JsonDefinition actual;
+  ASSERT_TRUE(parseInChunks(&parser,
+                            json,
+                            0,
+                            SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE,
+                            &actual));
+  expectSameDefinition(*expected.getDefinition(), *actual.getDefinition());
+  EXPECT_LT(sizeof(parser), 256u);
+}
+
+TEST(SupletJsonDefinitionStreamTests, NestingOfSkippedValuesIsLimited) {
+  const std::string head =
+      "{\"di\":1008,\"dv\":1,\"c\":\"virt\",\"k\":\"virtRelay\","
+      "\"ch\":[{\"id\":1,\"k\":\"virtRelay\"}],\"x\":";
+  Supla::Suplet::JsonDefinitionStreamParser parser;
+  Supla::Suplet::JsonDefinition output;
+
+  // root object and its value nested up to the limit
+  std::string json = head +
+                     std::string(SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH - 1, '[') +
+                     std::string(SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH - 1, ']') +
+                     "}";
+  EXPECT_TRUE(parseInChunks(&parser, json, 0, 1, &output));
+
+  json = head + std::string(SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH, '[') +
+         std::string(SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH, ']') + "}";
+  EXPECT_FALSE(parseInChunks(&parser, json, 0, 1, &output));
+}
+
+TEST(SupletJsonDefinitionStreamTests, FailureIsStickyAndTextEndsAtNul) {
+  Supla::Suplet::JsonDefinitionStreamParser parser;
+  Supla::Suplet::JsonDefinition output;
+
+  EXPECT_FALSE(parser.feed("{", 1));
+  EXPECT_FALSE(parser.finish());
+
+  parser.begin(&output);
+  EXPECT_FALSE(parser.feed("x", 1));
+  EXPECT_FALSE(parser.feed(validCorpus[1], strlen(validCorpus[1])));
+  EXPECT_FALSE(parser.finish());
+
+  std::string json(validCorpus[1]);
+  json.push_back('\0');
+  json += "garbage";
+  parser.begin(&output);
+  EXPECT_TRUE(parser.feed(json.data(), json.size()));
+  EXPECT_TRUE(parser.feed("more garbage", 12));
+  EXPECT_TRUE(parser.finish());
+  EXPECT_STREQ(output.getDefinition()->name, "Door");
+}
@@ -9,6 +9,7 @@
 #include <supla/channels/channel.h>
 #include <supla/element.h>
 #include <supla/storage/config.h>
+#include <supla/suplet/config.h>
 #include <supla/suplet/server_config.h>
 
 #include <map>
@@ -933,7 +934,7 @@ TEST(SupletServerConfigTests, SavesDownloadedDefinitionAndAppliesAssignment) {
   EXPECT_EQ(downloadedDefinitions.getCount(cache), 1);
   EXPECT_EQ(registry.findDefinition(1701, 1), nullptr);
   Supla::Suplet::JsonDefinition loadedDefinition;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 1701, 1, &loadedDefinition));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1701, 1, &loadedDefinition));
   EXPECT_EQ(loadedDefinition.getDefinition()->maxInstances, 3);
   EXPECT_EQ(
       handler.applyAssignmentJson(downloadedAssignmentJson, 1701, 1),
@@ -968,7 +969,7 @@ TEST(SupletServerConfigTests, ReplacesUnusedConflictingDownloadedDefinition) {
   ASSERT_TRUE(cache.load(1701, 1, storedJson, sizeof(storedJson)));
   EXPECT_STREQ(storedJson, conflictingDownloadedDefinitionJson);
   Supla::Suplet::JsonDefinition loadedDefinition;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 1701, 1, &loadedDefinition));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1701, 1, &loadedDefinition));
   EXPECT_STREQ(loadedDefinition.getDefinition()->channels[0].caption,
                "Changed");
 }
@@ -1138,8 +1139,8 @@ TEST(SupletServerConfigTests, LoadsMultipleDownloadedDefinitionVersions) {
   EXPECT_EQ(downloadedDefinitions.getCount(cache), 2);
   Supla::Suplet::JsonDefinition loadedV1;
   Supla::Suplet::JsonDefinition loadedV2;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 1701, 1, &loadedV1));
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 1701, 2, &loadedV2));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1701, 1, &loadedV1));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1701, 2, &loadedV2));
   EXPECT_STREQ(loadedV1.getDefinition()->channels[0].caption,
                "Param relay v1");
   EXPECT_STREQ(loadedV2.getDefinition()->channels[0].caption,
@@ -1272,7 +1273,7 @@ TEST(SupletServerConfigTests,
   ASSERT_TRUE(cache.save(1701, 1, downloadedDefinitionJson, sha));
 
   Supla::Suplet::JsonDefinition loadedDefinition;
-  ASSERT_TRUE(downloadedDefinitions.load(cache, 1701, 1, &loadedDefinition));
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1701, 1, &loadedDefinition));
   EXPECT_EQ(loadedDefinition.getDefinition()->maxInstances, 3);
 }
 
@@ -1439,8 +1440,80 @@ TEST(SupletServerConfigTests,
   ASSERT_TRUE(cache.save(702, 1, badJson, sha));
 
   Supla::Suplet::JsonDefinition loadedDefinition;
-  EXPECT_FALSE(downloadedDefinitions.load(cache, 702, 1, &loadedDefinition));
+  EXPECT_FALSE(downloadedDefinitions.load(&cache, 702, 1, &loadedDefinition));
   EXPECT_EQ(downloadedDefinitions.getCount(cache), 2);
   EXPECT_EQ(registry.findDefinition(1701, 1), nullptr);
   EXPECT_EQ(registry.findDefinition(702, 1), nullptr);
 }
+
+TEST(SupletServerConfigTests, CommitsStagedDefinitionParsedChunkByChunk) {
+  InMemoryConfig config;
+  FakeSha256Provider shaProvider;
+  Supla::Suplet::DefinitionCache cache(&config, &shaProvider);
+  Supla::Suplet::DownloadedDefinitionStore downloadedDefinitions;
+  Supla::Suplet::Manager manager(&config);
+  Supla::Suplet::Registry registry;
+  Supla::Suplet::ServerConfigHandler handler(
+      &manager, &registry, &cache, &downloadedDefinitions);
+
+  // Long unknown value spans the first chunk boundary and the channel
+  // caption spans the second one.
+  const size_t chunkSize = SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE;
+  std::string json =
+      "{"
+      "\"schemaVersion\":1,"
+      "\"handlerVersion\":1,"
+      "\"definitionId\":1702,"
+      "\"definitionVersion\":1,"
+      "\"maxInstances\":3,"
+      "\"category\":\"virtual\","
+      "\"kind\":\"virtualRelay\","
+      "\"description\":\"";
+  json.append(chunkSize + 100, 'x');
+  json += "\",\"notes\":\"";
+  json.append(2 * chunkSize - json.size() - 48, 'y');
+  json +=
+      "\","
+      "\"channels\":[{"
+      "\"channelId\":1,"
+      "\"kind\":\"virtualRelay\","
+      "\"caption\":\"Chunked relay\""
+      "}]"
+      "}";
+  ASSERT_GT(json.size(), 2 * chunkSize);
+
+  auto stage = [&](const std::string &text) {
+    uint8_t sha[32] = {};
+    makeSha(&shaProvider, text.c_str(), sha);
+    Supla::Suplet::DefinitionCacheHandle handle = {};
+    EXPECT_EQ(handler.beginStagedDownloadedDefinition(
+                  1702, 1, text.size(), sha, &handle),
+              Supla::Suplet::ServerConfigResult::Applied);
+    for (size_t offset = 0; offset < text.size(); offset += chunkSize) {
+      size_t size = text.size() - offset;
+      if (size > chunkSize) {
+        size = chunkSize;
+      }
+      EXPECT_EQ(handler.writeStagedDownloadedDefinitionChunk(
+                    handle,
+                    offset / chunkSize,
+                    reinterpret_cast<const uint8_t *>(text.data() + offset),
+                    size),
+                Supla::Suplet::ServerConfigResult::Applied);
+    }
+    return handler.commitStagedDownloadedDefinition(
+        handle, 1702, 1, text.size(), sha);
+  };
+
+  std::string broken = json;
+  broken[broken.size() - 2] = ',';
+  EXPECT_EQ(stage(broken),
+            Supla::Suplet::ServerConfigResult::InvalidDefinition);
+  EXPECT_FALSE(cache.contains(1702, 1));
+
+  ASSERT_EQ(stage(json), Supla::Suplet::ServerConfigResult::Applied);
+  Supla::Suplet::JsonDefinition loaded;
+  ASSERT_TRUE(downloadedDefinitions.load(&cache, 1702, 1, &loaded));
+  ASSERT_EQ(loaded.getDefinition()->channelCount, 1);
+  EXPECT_STREQ(loaded.getDefinition()->channels[0].caption, "Chunked relay");
+}
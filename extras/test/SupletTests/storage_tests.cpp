@@ -148,7 +148,19 @@ class KeyValueConfig : public Supla::KeyValue {
     commitCount++;
   }
 
+  bool getUInt8(const char *key, uint8_t *result) override {
+    uint8Reads++;
+    return Supla::KeyValue::getUInt8(key, result);
+  }
+
+  int getBlobSize(const char *key) override {
+    blobSizeReads++;
+    return Supla::KeyValue::getBlobSize(key);
+  }
+
   int commitCount = 0;
+  int uint8Reads = 0;
+  int blobSizeReads = 0;
 };
 
 Supla::Suplet::InstanceRecord makeRecord(uint8_t instanceId,
@@ -194,6 +206,32 @@ TEST(SupletStorageTests, EmptyKeyValueStorageDoesNotCleanupMissingSlots) {
   EXPECT_EQ(config.commitCount, 0);
 }
 
+TEST(SupletStorageTests, KeyValueStorageVisitsOnlyStoredInstances) {
+  KeyValueConfig config;
+  Supla::Suplet::InstanceTable table;
+  ASSERT_TRUE(table.add(makeRecord(7, 10)));
+  ASSERT_TRUE(table.add(makeRecord(150, 20)));
+  Supla::Suplet::Storage storage(&config);
+  ASSERT_TRUE(storage.save(table));
+
+  config.uint8Reads = 0;
+  config.blobSizeReads = 0;
+  Supla::Suplet::InstanceTable loaded;
+  ASSERT_TRUE(storage.load(&loaded));
+  EXPECT_EQ(loaded.getCount(), 2);
+  EXPECT_NE(loaded.findByInstanceId(7), nullptr);
+  EXPECT_NE(loaded.findByInstanceId(150), nullptr);
+  // instead of 255 probes of act key (and headers)
+  EXPECT_LE(config.uint8Reads, 4);
+  EXPECT_LE(config.blobSizeReads, 16);
+
+  ASSERT_TRUE(storage.erase());
+  EXPECT_FALSE(storage.load(&loaded));
+  Supla::ConfigKeyCursor cursor;
+  cursor.setPrefix("");
+  EXPECT_FALSE(config.findFirstKey(&cursor));
+}
+
 TEST(SupletStorageTests, SavesAndLoadsInstanceTable) {
   InMemoryConfig config;
   Supla::Suplet::InstanceTable table;
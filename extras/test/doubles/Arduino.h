@@ -41,6 +41,7 @@ void attachInterrupt(uint8_t pin, void (*func)(void), int mode);
 void detachInterrupt(uint8_t pin);
 uint8_t digitalPinToInterrupt(uint8_t pin);
 uint32_t millis();
+uint32_t micros();
 void delay(uint64_t ms);
 long map(long, long, long, long, long);  // NOLINT
 
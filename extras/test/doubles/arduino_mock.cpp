@@ -29,6 +29,10 @@ TimeInterface::~TimeInterface() {
 
 TimeInterface *TimeInterface::instance = nullptr;
 
+uint32_t TimeInterface::micros() {
+  return millis() * 1000;
+}
+
 void analogWrite(uint8_t pin, int val) {
   assert(DigitalInterface::instance);
   DigitalInterface::instance->analogWrite(pin, val);
@@ -98,6 +102,11 @@ uint32_t millis() {
   return TimeInterface::instance->millis();
 }
 
+uint32_t micros() {
+  assert(TimeInterface::instance);
+  return TimeInterface::instance->micros();
+}
+
 void delay(uint64_t) {
 }
 
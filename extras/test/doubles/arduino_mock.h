@@ -34,6 +34,8 @@ class TimeInterface {
   TimeInterface();
   virtual ~TimeInterface();
   virtual uint32_t millis() = 0;
+  // By default it follows millis() with 1 ms resolution
+  virtual uint32_t micros();
 
   static TimeInterface *instance;
 };
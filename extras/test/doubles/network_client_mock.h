@@ -22,6 +22,12 @@ class NetworkClientMock : public Supla::Client {
   MOCK_METHOD(size_t, writeImp, (const uint8_t *buf, size_t size), (override));
   MOCK_METHOD(int, readImp, (uint8_t * buf, size_t size), (override));
 
+  bool isConnecting() override {
+    return connecting;
+  }
+
+  bool connecting = false;
+
   const char *getRootCACert() {
     return rootCACert;
   }
@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "pulse_train_io.h"
+
+PulseTrainIo::PulseTrainIo(SimpleTime *time) : Supla::Io::Base(), time(time) {
+}
+
+void PulseTrainIo::customPinMode(int, uint8_t, uint8_t) {
+}
+
+int PulseTrainIo::customDigitalRead(int, uint8_t pin) {
+  reads++;
+  return pin < kPins ? levels[pin] : LOW;
+}
+
+void PulseTrainIo::customAttachInterrupt(uint8_t pin,
+                                         void (*func)(void),
+                                         int mode) {
+  if (pin < kPins && mode == CHANGE) {
+    handlers[pin] = func;
+  }
+}
+
+void PulseTrainIo::customDetachInterrupt(uint8_t pin) {
+  if (pin < kPins) {
+    handlers[pin] = nullptr;
+  }
+}
+
+uint8_t PulseTrainIo::customPinToInterrupt(uint8_t pin) {
+  return pin;
+}
+
+bool PulseTrainIo::customDigitalReadIsrSafe() const {
+  return true;
+}
+
+void PulseTrainIo::setLevel(uint8_t pin, int level) {
+  if (pin >= kPins || levels[pin] == level) {
+    return;
+  }
+  levels[pin] = level;
+  if (handlers[pin]) {
+    interrupts++;
+    handlers[pin]();
+  }
+}
+
+void PulseTrainIo::pulseTrain(uint8_t pin,
+                              int count,
+                              uint32_t periodUs,
+                              uint32_t widthUs,
+                              int activeLevel) {
+  for (int i = 0; i < count; i++) {
+    setLevel(pin, activeLevel);
+    wait(widthUs);
+    setLevel(pin, activeLevel == HIGH ? LOW : HIGH);
+    wait(periodUs - widthUs);
+  }
+}
+
+void PulseTrainIo::wait(uint32_t us) {
+  time->advanceMicros(us);
+}
+
+bool PulseTrainIo::isInterruptAttached(uint8_t pin) const {
+  return pin < kPins && handlers[pin] != nullptr;
+}
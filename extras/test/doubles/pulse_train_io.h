@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TEST_DOUBLES_PULSE_TRAIN_IO_H_
+#define EXTRAS_TEST_DOUBLES_PULSE_TRAIN_IO_H_
+
+#include <supla/io.h>
+
+#include "simple_time.h"
+
+/**
+ * GPIO double, which generates pulse trains on its pins. Pin level changes
+ * call attached interrupt handler (as for CHANGE mode) and time is advanced
+ * with SimpleTime with us resolution.
+ */
+class PulseTrainIo : public Supla::Io::Base {
+ public:
+  static constexpr int kPins = 16;
+
+  explicit PulseTrainIo(SimpleTime *time);
+
+  void customPinMode(int channelNumber, uint8_t pin, uint8_t mode) override;
+  int customDigitalRead(int channelNumber, uint8_t pin) override;
+  void customAttachInterrupt(uint8_t pin,
+                             void (*func)(void),
+                             int mode) override;
+  void customDetachInterrupt(uint8_t pin) override;
+  uint8_t customPinToInterrupt(uint8_t pin) override;
+  bool customDigitalReadIsrSafe() const override;
+
+  void setLevel(uint8_t pin, int level);
+  // Generates count pulses of activeLevel, widthUs long, every periodUs
+  void pulseTrain(uint8_t pin,
+                  int count,
+                  uint32_t periodUs,
+                  uint32_t widthUs,
+                  int activeLevel = HIGH);
+  void wait(uint32_t us);
+  bool isInterruptAttached(uint8_t pin) const;
+
+  int reads = 0;
+  int interrupts = 0;
+
+ private:
+  SimpleTime *time = nullptr;
+  int levels[kPins] = {};
+  void (*handlers[kPins])(void) = {};
+};
+
+#endif  // EXTRAS_TEST_DOUBLES_PULSE_TRAIN_IO_H_
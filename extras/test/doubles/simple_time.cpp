@@ -7,6 +7,16 @@ uint32_t SimpleTime::millis() {
   return value;
 }
 
+uint32_t SimpleTime::micros() {
+  return value * 1000 + subMillisUs;
+}
+
 void SimpleTime::advance(int advanceMs) {
   value += advanceMs;
 }
+
+void SimpleTime::advanceMicros(int advanceUs) {
+  subMillisUs += advanceUs;
+  value += subMillisUs / 1000;
+  subMillisUs %= 1000;
+}
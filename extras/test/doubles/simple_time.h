@@ -10,9 +10,13 @@
 class SimpleTime : public TimeInterface {
  public:
   uint32_t millis() override;
+  uint32_t micros() override;
   void advance(int advanceMs);
+  void advanceMicros(int advanceUs);
 
   uint32_t value = 0;
+  // part of current millisecond, in us
+  uint32_t subMillisUs = 0;
 };
 
 #endif  // EXTRAS_TEST_DOUBLES_SIMPLE_TIME_H_
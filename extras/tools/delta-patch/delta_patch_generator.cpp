@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "delta_patch_generator.h"
+
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char deltaPatchMagic[8] = {'S', 'U', 'P', 'L', 'A', 'D', 'P', '1'};
+const uint8_t opEnd = 0x00;
+const uint8_t opCopy = 0x01;
+const uint8_t opInsert = 0x02;
+
+const uint32_t hashBase = 257;
+// max number of source offsets checked for one hash value
+const size_t maxCandidates = 16;
+
+void appendUint32(std::string *out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+uint32_t blockHash(const uint8_t *data) {
+  uint32_t hash = 0;
+  for (int i = 0; i < Supla::DeltaPatchGenerator::BlockSize; i++) {
+    hash = hash * hashBase + data[i];
+  }
+  return hash;
+}
+
+class PatchWriter {
+ public:
+  explicit PatchWriter(std::string *out) : out(out) {
+  }
+
+  void insert(const uint8_t *data, uint32_t size) {
+    if (size == 0) {
+      return;
+    }
+    out->push_back(static_cast<char>(opInsert));
+    appendUint32(out, size);
+    out->append(reinterpret_cast<const char *>(data), size);
+  }
+
+  void copy(uint32_t offset, uint32_t size) {
+    out->push_back(static_cast<char>(opCopy));
+    appendUint32(out, offset);
+    appendUint32(out, size);
+  }
+
+  void end() {
+    out->push_back(static_cast<char>(opEnd));
+  }
+
+ private:
+  std::string *out;
+};
+
+}  // namespace
+
+std::string Supla::DeltaPatchGenerator::Generate(const std::string &source,
+                                                 const std::string &target,
+                                                 const uint8_t *sourceSha256) {
+  std::string patch(deltaPatchMagic, sizeof(deltaPatchMagic));
+  appendUint32(&patch, source.size());
+  appendUint32(&patch, target.size());
+  patch.append(reinterpret_cast<const char *>(sourceSha256), 32);
+
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(source.data());
+  const uint8_t *tgt = reinterpret_cast<const uint8_t *>(target.data());
+  const size_t srcSize = source.size();
+  const size_t tgtSize = target.size();
+
+  std::unordered_map<uint32_t, std::vector<uint32_t>> index;
+  for (size_t offset = 0; offset + BlockSize <= srcSize; offset += BlockSize) {
+    auto &candidates = index[blockHash(src + offset)];
+    if (candidates.size() < maxCandidates) {
+      candidates.push_back(offset);
+    }
+  }
+
+  // value used to remove oldest byte from rolling hash
+  uint32_t oldestByteFactor = 1;
+  for (int i = 1; i < BlockSize; i++) {
+    oldestByteFactor *= hashBase;
+  }
+
+  PatchWriter writer(&patch);
+  size_t pending = 0;  // first target byte not encoded yet
+  size_t pos = 0;
+  // source offset which follows the last copy, used to find data right
+  // after a modified fragment
+  size_t expectedSrc = 0;
+  bool hashValid = false;
+  uint32_t hash = 0;
+
+  while (pos + BlockSize <= tgtSize) {
+    if (!hashValid) {
+      hash = blockHash(tgt + pos);
+      hashValid = true;
+    }
+
+    size_t bestSrc = 0;
+    size_t bestBack = 0;
+    size_t bestLength = 0;
+    auto check = [&](size_t offset) {
+      if (offset + BlockSize > srcSize ||
+          memcmp(src + offset, tgt + pos, BlockSize) != 0) {
+        return;
+      }
+      size_t length = BlockSize;
+      while (offset + length < srcSize && pos + length < tgtSize &&
+             src[offset + length] == tgt[pos + length]) {
+        length++;
+      }
+      size_t back = 0;
+      while (back < offset && back < pos - pending &&
+             src[offset - back - 1] == tgt[pos - back - 1]) {
+        back++;
+      }
+      if (length + back > bestLength + bestBack) {
+        bestSrc = offset;
+        bestBack = back;
+        bestLength = length;
+      }
+    };
+
+    auto candidates = index.find(hash);
+    if (candidates != index.end()) {
+      for (auto offset : candidates->second) {
+        check(offset);
+      }
+    }
+    if (bestLength == 0) {
+      check(expectedSrc + (pos - pending));
+    }
+
+    if (bestLength > 0) {
+      writer.insert(tgt + pending, pos - bestBack - pending);
+      writer.copy(bestSrc - bestBack, bestLength + bestBack);
+      pos += bestLength;
+      pending = pos;
+      expectedSrc = bestSrc + bestLength;
+      hashValid = false;
+      continue;
+    }
+
+    if (pos + BlockSize < tgtSize) {
+      hash = (hash - tgt[pos] * oldestByteFactor) * hashBase +
+             tgt[pos + BlockSize];
+    }
+    pos++;
+  }
+
+  writer.insert(tgt + pending, tgtSize - pending);
+  writer.end();
+  return patch;
+}
@@ -0,0 +1,34 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TOOLS_DELTA_PATCH_DELTA_PATCH_GENERATOR_H_
+#define EXTRAS_TOOLS_DELTA_PATCH_DELTA_PATCH_GENERATOR_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace Supla {
+
+/**
+ * Host side generator of delta patches applied on device by
+ * Supla::Device::DeltaPatch (see src/supla/device/delta_patch.h for format).
+ *
+ * Source image is indexed in BlockSize blocks. Target is scanned with
+ * rolling hash and each match is extended in both directions, so any common
+ * part longer than 2 * BlockSize is encoded as COPY. Remaining bytes are
+ * sent as INSERT.
+ */
+class DeltaPatchGenerator {
+ public:
+  static constexpr int BlockSize = 32;
+
+  // sourceSha256 - SHA-256 of source image, it is stored in patch header
+  static std::string Generate(const std::string &source,
+                              const std::string &target,
+                              const uint8_t *sourceSha256);
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_TOOLS_DELTA_PATCH_DELTA_PATCH_GENERATOR_H_
@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Generates delta patch between two signed firmware images:
+//   supla-delta-patch <current image> <new image> <output patch>
+// Patch is offered by update server to devices which reported SHA-256 of
+// <current image> in check update request.
+
+#include <openssl/sha.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "delta_patch_generator.h"
+
+namespace {
+
+bool readFile(const char *path, std::string *data) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(in), {});
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fprintf(stderr,
+            "Usage: %s <current image> <new image> <output patch>\n",
+            argv[0]);
+    return 1;
+  }
+
+  std::string source;
+  std::string target;
+  if (!readFile(argv[1], &source) || !readFile(argv[2], &target)) {
+    fprintf(stderr, "Failed to read input images\n");
+    return 1;
+  }
+
+  uint8_t sourceSha256[SHA256_DIGEST_LENGTH] = {};
+  SHA256(reinterpret_cast<const uint8_t *>(source.data()),
+         source.size(),
+         sourceSha256);
+
+  std::string patch =
+      Supla::DeltaPatchGenerator::Generate(source, target, sourceSha256);
+
+  std::ofstream out(argv[3], std::ios::binary | std::ios::trunc);
+  out.write(patch.data(), patch.size());
+  if (!out) {
+    fprintf(stderr, "Failed to write %s\n", argv[3]);
+    return 1;
+  }
+
+  printf("Source image: %zu B, SHA-256: ", source.size());
+  for (auto byte : sourceSha256) {
+    printf("%02x", byte);
+  }
+  printf("\nTarget image: %zu B\nPatch: %zu B (%.1f%% of target)\n",
+         target.size(),
+         patch.size(),
+         target.empty() ? 0.0 : 100.0 * patch.size() / target.size());
+  return 0;
+}
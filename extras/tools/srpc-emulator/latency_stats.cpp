@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "latency_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Supla {
+
+void LatencyStats::add(uint64_t valueUs) {
+  if (!samples.empty() && valueUs < samples.back()) {
+    sorted = false;
+  }
+  samples.push_back(valueUs);
+  sum += valueUs;
+}
+
+void LatencyStats::clear() {
+  samples.clear();
+  sorted = true;
+  sum = 0;
+}
+
+size_t LatencyStats::count() const {
+  return samples.size();
+}
+
+uint64_t LatencyStats::percentile(double percent) const {
+  if (samples.empty()) {
+    return 0;
+  }
+  if (!sorted) {
+    std::sort(samples.begin(), samples.end());
+    sorted = true;
+  }
+  percent = std::clamp(percent, 0.0, 100.0);
+  size_t rank = static_cast<size_t>(
+      std::ceil(percent / 100.0 * static_cast<double>(samples.size())));
+  if (rank > 0) {
+    rank--;
+  }
+  return samples[std::min(rank, samples.size() - 1)];
+}
+
+uint64_t LatencyStats::max() const {
+  return percentile(100);
+}
+
+double LatencyStats::mean() const {
+  if (samples.empty()) {
+    return 0;
+  }
+  return static_cast<double>(sum) / static_cast<double>(samples.size());
+}
+
+}  // namespace Supla
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TOOLS_SRPC_EMULATOR_LATENCY_STATS_H_
+#define EXTRAS_TOOLS_SRPC_EMULATOR_LATENCY_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace Supla {
+
+/**
+ * Collects latency samples (in microseconds) and reports percentiles.
+ * All samples are kept, so it is meant for bounded benchmark runs.
+ */
+class LatencyStats {
+ public:
+  void add(uint64_t valueUs);
+  void clear();
+
+  size_t count() const;
+  // Nearest-rank percentile, percent in range 0..100. 0 when empty.
+  uint64_t percentile(double percent) const;
+  uint64_t max() const;
+  double mean() const;
+
+ private:
+  mutable std::vector<uint64_t> samples;
+  mutable bool sorted = true;
+  uint64_t sum = 0;
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_TOOLS_SRPC_EMULATOR_LATENCY_STATS_H_
@@ -0,0 +1,392 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Local SRPC server emulator and load generator:
+//   supla-srpc-emulator [options]
+//
+// With --devices N, N simulated devices connect to the emulator, register,
+// receive command storm and send value updates. Without it, emulator only
+// serves devices (i.e. sd4linux with "server" set to this host) and prints
+// statistics periodically.
+//
+// Emulator uses plain TCP unless --cert and --key are given. Devices use TLS
+// on port 2016 only, so that port requires TLS. Simulated devices use TLS
+// when it is enabled (without certificate verification).
+
+#include <log.h>
+#include <openssl/ssl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "latency_stats.h"
+#include "srpc_server_emulator.h"
+#include "srpc_simulated_device.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Supla::SrpcServerEmulator;
+using Supla::SrpcSimulatedDevice;
+
+volatile sig_atomic_t interrupted = 0;
+
+struct Options {
+  const char *address = "0.0.0.0";
+  uint16_t port = 2015;
+  const char *certFile = nullptr;
+  const char *keyFile = nullptr;
+  int devices = 0;
+  int channels = 4;
+  int commands = 100;
+  int values = 10;
+  int channel = 0;
+  int durationSec = 0;
+  int timeoutSec = 30;
+};
+
+void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --address A    listen address, simulated devices connect to\n"
+          "                 127.0.0.1 (default 0.0.0.0)\n"
+          "  --port P       listen port, 0 - any (default 2015)\n"
+          "  --cert F       PEM certificate (chain) file, enables TLS\n"
+          "  --key F        PEM private key file of --cert\n"
+          "  --devices N    simulated devices, 0 - serve external devices\n"
+          "                 only (default 0)\n"
+          "  --channels C   channels per simulated device (default 4)\n"
+          "  --commands K   SetChannelValue commands per device; every 10th\n"
+          "                 one is followed by CalCfg, ChannelConfig and\n"
+          "                 DeviceConfig (default 100)\n"
+          "  --channel C    channel used for commands sent to external\n"
+          "                 devices (default 0)\n"
+          "  --values V     value update bursts per simulated device\n"
+          "                 (default 10)\n"
+          "  --duration S   run time in external devices mode, 0 - until\n"
+          "                 Ctrl+C (default 0)\n"
+          "  --timeout S    max time of each load phase (default 30)\n"
+          "  -v             verbose srpc log\n",
+          name);
+}
+
+bool parseOptions(int argc, char **argv, Options *options) {
+  for (int i = 1; i < argc; i++) {
+    auto is = [&](const char *name) {
+      return strcmp(argv[i], name) == 0 && i + 1 < argc;
+    };
+    if (strcmp(argv[i], "-v") == 0) {
+      supla_log_set_level(LOG_DEBUG);
+    } else if (is("--address")) {
+      options->address = argv[++i];
+    } else if (is("--port")) {
+      options->port = atoi(argv[++i]);
+    } else if (is("--cert")) {
+      options->certFile = argv[++i];
+    } else if (is("--key")) {
+      options->keyFile = argv[++i];
+    } else if (is("--devices")) {
+      options->devices = atoi(argv[++i]);
+    } else if (is("--channels")) {
+      options->channels = atoi(argv[++i]);
+    } else if (is("--commands")) {
+      options->commands = atoi(argv[++i]);
+    } else if (is("--channel")) {
+      options->channel = atoi(argv[++i]);
+    } else if (is("--values")) {
+      options->values = atoi(argv[++i]);
+    } else if (is("--duration")) {
+      options->durationSec = atoi(argv[++i]);
+    } else if (is("--timeout")) {
+      options->timeoutSec = atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options->channels > 0 && options->channels <= SUPLA_CHANNELMAXCOUNT &&
+         options->devices >= 0 && options->commands >= 0 &&
+         options->values >= 0 &&
+         (options->certFile == nullptr) == (options->keyFile == nullptr);
+}
+
+class LoadGenerator {
+ public:
+  LoadGenerator(SrpcServerEmulator *server, const Options &options)
+      : server(server), options(options) {
+    if (server->isTlsEnabled()) {
+      // emulator is usually run with self-signed certificate
+      tlsContext = SSL_CTX_new(TLS_client_method());
+      SSL_CTX_set_verify(tlsContext, SSL_VERIFY_NONE, nullptr);
+    }
+  }
+
+  ~LoadGenerator() {
+    devices.clear();
+    if (tlsContext) {
+      SSL_CTX_free(tlsContext);
+    }
+  }
+
+  bool connectDevices() {
+    printf("Connecting %d devices with %d channels...\n",
+           options.devices,
+           options.channels);
+    for (int i = 0; i < options.devices && !interrupted; i++) {
+      auto device = SrpcSimulatedDevice::Connect("127.0.0.1",
+                                                 server->getPort(),
+                                                 i + 1,
+                                                 options.channels,
+                                                 tlsContext);
+      if (!device) {
+        return false;
+      }
+      devices.push_back(std::move(device));
+      // don't overflow listen backlog
+      if (i % 32 == 31) {
+        pump();
+      }
+    }
+    bool result = pumpUntil([this]() {
+      return server->getRegisteredDevices().size() == devices.size() &&
+             registeredDevices() == devices.size();
+    });
+    for (auto &device : devices) {
+      deviceRegistration.add(device->getRegistrationTimeUs());
+    }
+    return result;
+  }
+
+  bool sendCommands(const std::vector<int> &deviceIds, int channelCount) {
+    printf("Sending %d commands to %zu devices...\n",
+           options.commands,
+           deviceIds.size());
+    for (int round = 0; round < options.commands && !interrupted; round++) {
+      for (auto id : deviceIds) {
+        uint8_t channel = channelCount > 0 ? round % channelCount
+                                           : options.channel;
+        char value[SUPLA_CHANNELVALUE_SIZE] = {};
+        value[0] = round % 2;
+        if (!pumpUntil([&]() {
+              return server->setChannelValue(id, channel, value);
+            })) {
+          return false;
+        }
+        if (round % 10 != 9) {
+          continue;
+        }
+        uint8_t config[4] = {};
+        if (!pumpUntil([&]() {
+              return server->calCfg(
+                  id, channel, SUPLA_CALCFG_CMD_IDENTIFY_DEVICE);
+            }) ||
+            !pumpUntil([&]() {
+              return server->setChannelConfig(id,
+                                              channel,
+                                              SUPLA_CHANNELFNC_LIGHTSWITCH,
+                                              SUPLA_CONFIG_TYPE_DEFAULT,
+                                              config,
+                                              sizeof(config));
+            }) ||
+            !pumpUntil([&]() {
+              return server->setDeviceConfig(id, 0, nullptr, 0);
+            })) {
+          return false;
+        }
+      }
+    }
+    return pumpUntil([this]() {
+      return server->getPendingCommandCount() == 0;
+    });
+  }
+
+  bool sendValues() {
+    printf("Sending %d value bursts from %zu devices...\n",
+           options.values,
+           devices.size());
+    uint64_t initial = server->getValueUpdateCount();
+    uint64_t expected = initial + static_cast<uint64_t>(options.values) *
+                                      devices.size() * options.channels;
+    auto start = Clock::now();
+    for (int burst = 0; burst < options.values && !interrupted; burst++) {
+      for (auto &device : devices) {
+        device->changeAllValues();
+      }
+      if (!pumpUntil([this]() { return sendChangedValues() == 0; })) {
+        return false;
+      }
+    }
+    bool result = pumpUntil([this, expected]() {
+      return server->getValueUpdateCount() >= expected;
+    });
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    if (seconds > 0) {
+      valueRate = (server->getValueUpdateCount() - initial) / seconds;
+    }
+    return result;
+  }
+
+  void printReport() const {
+    printf("\n%s", server->report().c_str());
+    if (!devices.empty()) {
+      printf("Device side registration [us]: p50 %llu, p99 %llu, max %llu\n",
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 deviceRegistration.percentile(50)),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 deviceRegistration.percentile(99)),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 deviceRegistration.max()));
+    }
+    if (valueRate > 0) {
+      printf("Value bursts throughput: %.0f values/s\n", valueRate);
+    }
+  }
+
+  void pump() {
+    server->iterate();
+    sendChangedValues();
+    for (auto &device : devices) {
+      device->iterate();
+    }
+  }
+
+ private:
+  size_t registeredDevices() const {
+    size_t count = 0;
+    for (auto &device : devices) {
+      if (device->isRegistered()) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  int sendChangedValues() {
+    int waiting = 0;
+    for (auto &device : devices) {
+      waiting += device->sendChangedValues();
+    }
+    return waiting;
+  }
+
+  template <typename Condition>
+  bool pumpUntil(Condition condition) {
+    auto deadline = Clock::now() + std::chrono::seconds(options.timeoutSec);
+    while (!condition()) {
+      if (interrupted || Clock::now() > deadline) {
+        fprintf(stderr, "Load phase didn't finish in %d s\n",
+                options.timeoutSec);
+        return false;
+      }
+      if (devices.empty()) {
+        server->iterate(10);
+      } else {
+        pump();
+      }
+    }
+    return true;
+  }
+
+  SrpcServerEmulator *server = nullptr;
+  const Options &options;
+  SSL_CTX *tlsContext = nullptr;
+  std::vector<std::unique_ptr<SrpcSimulatedDevice>> devices;
+  Supla::LatencyStats deviceRegistration;
+  double valueRate = 0;
+};
+
+void onSignal(int) {
+  interrupted = 1;
+}
+
+int runSimulation(SrpcServerEmulator *server, const Options &options) {
+  LoadGenerator generator(server, options);
+  bool ok = generator.connectDevices() &&
+            generator.sendCommands(server->getRegisteredDevices(),
+                                   options.channels) &&
+            generator.sendValues();
+  generator.printReport();
+  return ok ? 0 : 1;
+}
+
+int serveExternalDevices(SrpcServerEmulator *server, const Options &options) {
+  LoadGenerator generator(server, options);
+  std::set<int> handledDevices;
+  auto start = Clock::now();
+  auto nextReport = start + std::chrono::seconds(10);
+  while (!interrupted) {
+    server->iterate(100);
+    for (auto id : server->getRegisteredDevices()) {
+      if (!handledDevices.insert(id).second) {
+        continue;
+      }
+      auto info = server->getDeviceInfo(id);
+      printf("Device %d registered: \"%s\" %s, %d channels, proto %d\n",
+             id,
+             info->name.c_str(),
+             info->softVer.c_str(),
+             info->channelCount,
+             info->protoVersion);
+      fflush(stdout);
+      if (options.commands > 0 && options.channel < info->channelCount) {
+        generator.sendCommands({id}, 0);
+      }
+    }
+    auto now = Clock::now();
+    if (now >= nextReport) {
+      generator.printReport();
+      nextReport = now + std::chrono::seconds(10);
+    }
+    if (options.durationSec > 0 &&
+        now - start >= std::chrono::seconds(options.durationSec)) {
+      break;
+    }
+  }
+  generator.printReport();
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (options.port == 2016 && options.certFile == nullptr) {
+    fprintf(stderr, "Port 2016 is used by devices with TLS, set --cert\n");
+    return 1;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  SrpcServerEmulator server;
+  if (options.certFile &&
+      !server.enableTls(options.certFile, options.keyFile)) {
+    return 1;
+  }
+  if (!server.listen(options.port, options.address)) {
+    return 1;
+  }
+  printf("SRPC emulator listening on %s:%u%s\n",
+         options.address,
+         server.getPort(),
+         server.isTlsEnabled() ? " (TLS)" : "");
+  // port is read by scripts and tests from piped output
+  fflush(stdout);
+
+  if (options.devices > 0) {
+    return runSimulation(&server, options);
+  }
+  return serveExternalDevices(&server, options);
+}
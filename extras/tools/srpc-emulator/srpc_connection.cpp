@@ -0,0 +1,304 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "srpc_connection.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace {
+
+// srpc out queue holds 10 packets (SRPC_QUEUE_SIZE), keep room for replies
+constexpr unsigned char OutQueueLimit = 8;
+
+}  // namespace
+
+namespace Supla {
+
+SrpcConnection::SrpcConnection(int fd, SSL_CTX *tlsContext, bool tlsServer)
+    : fd(fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  int noDelay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+  if (tlsContext) {
+    ssl = SSL_new(tlsContext);
+    if (ssl == nullptr || SSL_set_fd(ssl, fd) != 1) {
+      fprintf(stderr, "SRPC connection: TLS setup failed\n");
+      disconnect();
+    } else {
+      // output buffer may be reallocated between retries of SSL_write
+      SSL_set_mode(ssl,
+                   SSL_MODE_ENABLE_PARTIAL_WRITE |
+                       SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+      if (tlsServer) {
+        SSL_set_accept_state(ssl);
+      } else {
+        SSL_set_connect_state(ssl);
+      }
+      handshakeDone = false;
+    }
+  }
+
+  TsrpcParams params;
+  srpc_params_init(&params);
+  params.data_read = &SrpcConnection::DataRead;
+  params.data_write = &SrpcConnection::DataWrite;
+  params.on_remote_call_received = &SrpcConnection::OnRemoteCallReceived;
+  params.user_params = this;
+  srpc = srpc_init(&params);
+}
+
+SrpcConnection::~SrpcConnection() {
+  disconnect();
+  if (srpc) {
+    srpc_free(srpc);
+    srpc = nullptr;
+  }
+}
+
+bool SrpcConnection::iterate() {
+  if (!isConnected()) {
+    return false;
+  }
+  if (!handshakeDone && !handshake()) {
+    return isConnected();
+  }
+
+  readEnabled = true;
+  for (int i = 0; i < MaxPacketsPerIterate && isConnected(); i++) {
+    sendDeferred();
+    packetReceived = false;
+    readWouldBlock = false;
+    if (!srpc_iterate(srpc)) {
+      disconnect();
+      break;
+    }
+    // srpc decodes one packet per iteration, so socket is read again only
+    // when buffered data doesn't contain complete packet
+    readEnabled = !packetReceived;
+    if (!packetReceived && readWouldBlock && deferred.empty() &&
+        srpc_out_queue_item_count(srpc) == 0) {
+      break;
+    }
+  }
+
+  return flush();
+}
+
+void SrpcConnection::disconnect() {
+  if (ssl) {
+    SSL_free(ssl);
+    ssl = nullptr;
+  }
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  deferred.clear();
+  output.clear();
+  outputOffset = 0;
+}
+
+bool SrpcConnection::isConnected() const {
+  return fd >= 0;
+}
+
+int SrpcConnection::getFd() const {
+  return fd;
+}
+
+bool SrpcConnection::canSend() const {
+  return isConnected() && deferred.empty() &&
+         srpc_out_queue_item_count(srpc) < OutQueueLimit;
+}
+
+void SrpcConnection::send(std::function<void(void *srpc)> call) {
+  if (canSend()) {
+    call(srpc);
+  } else if (isConnected()) {
+    deferred.push_back(std::move(call));
+  }
+}
+
+void SrpcConnection::sendDeferred() {
+  while (!deferred.empty() &&
+         srpc_out_queue_item_count(srpc) < OutQueueLimit) {
+    auto call = std::move(deferred.front());
+    deferred.pop_front();
+    call(srpc);
+  }
+}
+
+size_t SrpcConnection::getPendingOutputSize() const {
+  return output.size() - outputOffset;
+}
+
+bool SrpcConnection::wantsWrite() const {
+  return handshakeDone ? getPendingOutputSize() > 0 : tlsWantsWrite;
+}
+
+bool SrpcConnection::hasBufferedInput() const {
+  return ssl != nullptr && SSL_pending(ssl) > 0;
+}
+
+bool SrpcConnection::isTls() const {
+  return ssl != nullptr;
+}
+
+bool SrpcConnection::handshake() {
+  ERR_clear_error();
+  int result = SSL_do_handshake(ssl);
+  if (result == 1) {
+    handshakeDone = true;
+    tlsWantsWrite = false;
+    return true;
+  }
+  int error = SSL_get_error(ssl, result);
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    tlsWantsWrite = error == SSL_ERROR_WANT_WRITE;
+    return false;
+  }
+  char reason[256] = {};
+  ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+  fprintf(stderr, "SRPC connection: TLS handshake failed: %s\n", reason);
+  disconnect();
+  return false;
+}
+
+ssize_t SrpcConnection::tlsResult(int result) {
+  if (result > 0) {
+    return result;
+  }
+  int error = SSL_get_error(ssl, result);
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    return -1;
+  }
+  return 0;
+}
+
+ssize_t SrpcConnection::readSome(void *buf, size_t count) {
+  if (ssl) {
+    ERR_clear_error();
+    return tlsResult(SSL_read(ssl, buf, static_cast<int>(count)));
+  }
+  while (true) {
+    ssize_t size = recv(fd, buf, count, 0);
+    if (size >= 0) {
+      return size;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : 0;
+  }
+}
+
+ssize_t SrpcConnection::writeSome(const void *buf, size_t count) {
+  if (ssl) {
+    ERR_clear_error();
+    return tlsResult(SSL_write(ssl, buf, static_cast<int>(count)));
+  }
+  while (true) {
+    ssize_t size = ::send(fd, buf, count, MSG_NOSIGNAL);
+    if (size > 0) {
+      return size;
+    }
+    if (size == -1 && errno == EINTR) {
+      continue;
+    }
+    return size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
+  }
+}
+
+uint64_t SrpcConnection::ElapsedUs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+_supla_int_t SrpcConnection::DataRead(void *buf,
+                                      _supla_int_t count,
+                                      void *user) {
+  auto connection = static_cast<SrpcConnection *>(user);
+  if (!connection->readEnabled || !connection->isConnected() || count <= 0) {
+    return -1;
+  }
+  ssize_t size = connection->readSome(buf, count);
+  if (size == -1) {
+    connection->readWouldBlock = true;
+  }
+  // 0 - closed by peer or error, srpc_iterate returns false then
+  return size;
+}
+
+_supla_int_t SrpcConnection::DataWrite(void *buf,
+                                       _supla_int_t count,
+                                       void *user) {
+  auto connection = static_cast<SrpcConnection *>(user);
+  if (!connection->isConnected() || count <= 0) {
+    return -1;
+  }
+  auto data = static_cast<const char *>(buf);
+  connection->output.insert(connection->output.end(), data, data + count);
+  return count;
+}
+
+void SrpcConnection::OnRemoteCallReceived(void *srpc,
+                                          unsigned _supla_int_t,
+                                          unsigned _supla_int_t callId,
+                                          void *user,
+                                          unsigned char protoVersion) {
+  auto connection = static_cast<SrpcConnection *>(user);
+  connection->packetReceived = true;
+  // answer with the version used by the peer, like supla-server does
+  if (srpc_get_proto_version(srpc) != protoVersion) {
+    srpc_set_proto_version(srpc, protoVersion);
+  }
+
+  // packet is taken from srpc input queue right after it was pushed there
+  TsrpcReceivedData rd = {};
+  if (srpc_getdata(srpc, &rd, 0) == SUPLA_RESULT_TRUE) {
+    connection->onCall(&rd, callId);
+    srpc_rd_free(&rd);
+  }
+}
+
+bool SrpcConnection::flush() {
+  while (isConnected() && handshakeDone && outputOffset < output.size()) {
+    ssize_t size = writeSome(output.data() + outputOffset,
+                             output.size() - outputOffset);
+    if (size > 0) {
+      outputOffset += size;
+      continue;
+    }
+    if (size == -1) {
+      break;
+    }
+    disconnect();
+    return false;
+  }
+
+  if (outputOffset == output.size()) {
+    output.clear();
+    outputOffset = 0;
+  } else if (outputOffset > output.size() / 2) {
+    output.erase(output.begin(), output.begin() + outputOffset);
+    outputOffset = 0;
+  }
+  if (getPendingOutputSize() > MaxPendingOutput) {
+    disconnect();
+  }
+  return isConnected();
+}
+
+}  // namespace Supla
@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_CONNECTION_H_
+#define EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_CONNECTION_H_
+
+#include <openssl/ssl.h>
+#include <srpc.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace Supla {
+
+/**
+ * Nonblocking SRPC endpoint over a TCP socket, optionally with TLS.
+ *
+ * Packets are encoded and decoded by supla-common srpc. Received calls are
+ * passed to onCall() and outgoing data is buffered, so iterate() never blocks
+ * and one busy peer can't stall other connections handled by the same loop.
+ * With TLS, handshake is driven from iterate() and packets queued before it
+ * ends are sent afterwards.
+ */
+class SrpcConnection {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Max number of received packets handled in one iterate() call
+  static constexpr int MaxPacketsPerIterate = 256;
+  // Connection is dropped when peer doesn't read and more data is pending
+  static constexpr size_t MaxPendingOutput = 4 * 1024 * 1024;
+
+  // Takes ownership of connected socket. With tlsContext, TLS is used on the
+  // socket (server or client side of the handshake).
+  explicit SrpcConnection(int fd,
+                          SSL_CTX *tlsContext = nullptr,
+                          bool tlsServer = true);
+  virtual ~SrpcConnection();
+
+  SrpcConnection(const SrpcConnection &) = delete;
+  SrpcConnection &operator=(const SrpcConnection &) = delete;
+
+  // Handles received packets and sends queued ones. Returns false when
+  // connection is closed.
+  bool iterate();
+  void disconnect();
+  bool isConnected() const;
+  int getFd() const;
+  // false when srpc output queue is full, so next async call would fail
+  bool canSend() const;
+  size_t getPendingOutputSize() const;
+  // true when socket should be polled for POLLOUT
+  bool wantsWrite() const;
+  // true when TLS layer holds already received data, which won't be
+  // reported by poll()
+  bool hasBufferedInput() const;
+  bool isTls() const;
+
+  static uint64_t ElapsedUs(Clock::time_point since);
+
+ protected:
+  virtual void onCall(TsrpcReceivedData *rd, uint32_t callId) = 0;
+  // Calls srpc_*_async_* function now, or later when srpc output queue is
+  // full (i.e. when one received packet is answered with two packets)
+  void send(std::function<void(void *srpc)> call);
+
+  void *srpc = nullptr;
+
+ private:
+  static _supla_int_t DataRead(void *buf, _supla_int_t count, void *user);
+  static _supla_int_t DataWrite(void *buf, _supla_int_t count, void *user);
+  static void OnRemoteCallReceived(void *srpc,
+                                   unsigned _supla_int_t rrId,
+                                   unsigned _supla_int_t callId,
+                                   void *user,
+                                   unsigned char protoVersion);
+  void sendDeferred();
+  bool flush();
+  // Returns false when handshake isn't finished yet or failed
+  bool handshake();
+  // Return number of bytes, -1 when operation would block and 0 when
+  // connection is closed or failed
+  ssize_t readSome(void *buf, size_t count);
+  ssize_t writeSome(const void *buf, size_t count);
+  // Maps result of SSL_read/SSL_write to readSome/writeSome result
+  ssize_t tlsResult(int result);
+
+  int fd = -1;
+  SSL *ssl = nullptr;
+  bool handshakeDone = true;
+  bool tlsWantsWrite = false;
+  bool readEnabled = true;
+  bool readWouldBlock = false;
+  bool packetReceived = false;
+  std::deque<std::function<void(void *srpc)>> deferred;
+  std::vector<char> output;
+  size_t outputOffset = 0;
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_CONNECTION_H_
@@ -0,0 +1,662 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "srpc_server_emulator.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <poll.h>
+#include <srpc.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "srpc_connection.h"
+
+namespace Supla {
+
+class SrpcServerEmulator::Session : public SrpcConnection {
+ public:
+  Session(SrpcServerEmulator *server, int fd, int id)
+      : SrpcConnection(fd, server->tlsContext),
+        server(server),
+        acceptedAt(Clock::now()) {
+    info.id = id;
+  }
+
+  void *getSrpc() const {
+    return srpc;
+  }
+
+  SrpcServerEmulator *server = nullptr;
+  Clock::time_point acceptedAt;
+  bool registered = false;
+  DeviceInfo info;
+
+  // SetChannelValue and CalCfg results are matched by SenderID
+  std::map<int32_t, std::pair<Command, Clock::time_point>> pendingBySender;
+  // config results don't carry request id, device handles them in order
+  std::deque<std::pair<uint8_t, Clock::time_point>> pendingChannelConfig;
+  std::deque<Clock::time_point> pendingDeviceConfig;
+
+ protected:
+  void onCall(TsrpcReceivedData *rd, uint32_t callId) override;
+
+ private:
+  template <typename RegisterDevice>
+  void onRegister(const RegisterDevice *request, bool resultB);
+  void onCommandResult(uint32_t callId, TsrpcReceivedData *rd);
+};
+
+template <typename RegisterDevice>
+void SrpcServerEmulator::Session::onRegister(const RegisterDevice *request,
+                                             bool resultB) {
+  if (request == nullptr) {
+    return;
+  }
+  info.name.assign(request->Name,
+                   strnlen(request->Name, sizeof(request->Name)));
+  info.softVer.assign(request->SoftVer,
+                      strnlen(request->SoftVer, sizeof(request->SoftVer)));
+  info.protoVersion = srpc_get_proto_version(srpc);
+  info.channelCount = std::min<int>(request->channel_count,
+                                    SUPLA_CHANNELMAXCOUNT);
+  info.channelFunctions.assign(info.channelCount, 0);
+  for (int i = 0; i < info.channelCount; i++) {
+    int number = request->channels[i].Number;
+    if (number >= static_cast<int>(info.channelFunctions.size())) {
+      info.channelFunctions.resize(number + 1, 0);
+    }
+    info.channelFunctions[number] = request->channels[i].Default;
+  }
+
+  if (resultB) {
+    TSD_SuplaRegisterDeviceResult_B result = {};
+    result.result_code = SUPLA_RESULTCODE_TRUE;
+    result.activity_timeout = server->activityTimeout;
+    result.version = SUPLA_PROTO_VERSION;
+    result.version_min = SUPLA_PROTO_VERSION_MIN;
+    result.channel_report_size = info.channelCount;
+    for (int i = 0; i < info.channelCount; i++) {
+      result.channel_report[i] = CHANNEL_REPORT_CHANNEL_REGISTERED;
+    }
+    send([result](void *srpc) mutable {
+      srpc_sd_async_registerdevice_result_b(srpc, &result);
+    });
+  } else {
+    TSD_SuplaRegisterDeviceResult result = {};
+    result.result_code = SUPLA_RESULTCODE_TRUE;
+    result.activity_timeout = server->activityTimeout;
+    result.version = SUPLA_PROTO_VERSION;
+    result.version_min = SUPLA_PROTO_VERSION_MIN;
+    send([result](void *srpc) mutable {
+      srpc_sd_async_registerdevice_result(srpc, &result);
+    });
+  }
+
+  if (!registered) {
+    registered = true;
+    server->registrationOrder.push_back(info.id);
+    server->registrationTime.add(ElapsedUs(acceptedAt));
+  }
+}
+
+void SrpcServerEmulator::Session::onCall(TsrpcReceivedData *rd,
+                                         uint32_t callId) {
+  switch (callId) {
+    case SUPLA_DS_CALL_REGISTER_DEVICE_E:
+      onRegister(rd->data.ds_register_device_e, false);
+      break;
+    case SUPLA_DS_CALL_REGISTER_DEVICE_F:
+      onRegister(rd->data.ds_register_device_f, false);
+      break;
+    case SUPLA_DS_CALL_REGISTER_DEVICE_G:
+      onRegister(rd->data.ds_register_device_g, true);
+      break;
+    case SUPLA_DCS_CALL_PING_SERVER:
+      send([](void *srpc) { srpc_sdc_async_ping_server_result(srpc); });
+      break;
+    case SUPLA_DCS_CALL_SET_ACTIVITY_TIMEOUT: {
+      if (rd->data.dcs_set_activity_timeout == nullptr) {
+        break;
+      }
+      TSDC_SuplaSetActivityTimeoutResult result = {};
+      result.min = 10;
+      result.max = 240;
+      result.activity_timeout =
+          std::clamp(rd->data.dcs_set_activity_timeout->activity_timeout,
+                     result.min,
+                     result.max);
+      send([result](void *srpc) mutable {
+        srpc_dcs_async_set_activity_timeout_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_DCS_CALL_GET_USER_LOCALTIME: {
+      TSDC_UserLocalTimeResult result = {};
+      time_t now = time(nullptr);
+      struct tm utc = {};
+      gmtime_r(&now, &utc);
+      result.year = utc.tm_year + 1900;
+      result.month = utc.tm_mon + 1;
+      result.day = utc.tm_mday;
+      result.dayOfWeek = utc.tm_wday + 1;
+      result.hour = utc.tm_hour;
+      result.min = utc.tm_min;
+      result.sec = utc.tm_sec;
+      snprintf(result.timezone, sizeof(result.timezone), "UTC");
+      result.timezoneSize = strlen(result.timezone) + 1;
+      send([result](void *srpc) mutable {
+        srpc_sdc_async_get_user_localtime_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_DS_CALL_GET_CHANNEL_CONFIG: {
+      auto request = rd->data.ds_get_channel_config_request;
+      if (request == nullptr) {
+        break;
+      }
+      // emulator doesn't store configs - device keeps its defaults
+      TSD_ChannelConfig config = {};
+      config.ChannelNumber = request->ChannelNumber;
+      config.ConfigType = request->ConfigType;
+      if (request->ChannelNumber < info.channelFunctions.size()) {
+        config.Func = info.channelFunctions[request->ChannelNumber];
+      }
+      send([config](void *srpc) mutable {
+        srpc_sd_async_get_channel_config_result(srpc, &config);
+      });
+      TSD_ChannelConfigFinished finished = {};
+      finished.ChannelNumber = request->ChannelNumber;
+      send([finished](void *srpc) mutable {
+        srpc_sd_async_channel_config_finished(srpc, &finished);
+      });
+      break;
+    }
+    case SUPLA_DS_CALL_SET_CHANNEL_CONFIG: {
+      auto request = rd->data.sds_set_channel_config_request;
+      if (request == nullptr) {
+        break;
+      }
+      TSDS_SetChannelConfigResult result = {};
+      result.Result = SUPLA_CONFIG_RESULT_TRUE;
+      result.ConfigType = request->ConfigType;
+      result.ChannelNumber = request->ChannelNumber;
+      send([result](void *srpc) mutable {
+        srpc_sd_async_set_channel_config_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_DS_CALL_SET_DEVICE_CONFIG: {
+      TSDS_SetDeviceConfigResult result = {};
+      result.Result = SUPLA_CONFIG_RESULT_TRUE;
+      send([result](void *srpc) mutable {
+        srpc_sd_async_set_device_config_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_DS_CALL_DEVICE_CHANNEL_VALUE_CHANGED:
+    case SUPLA_DS_CALL_DEVICE_CHANNEL_VALUE_CHANGED_B:
+    case SUPLA_DS_CALL_DEVICE_CHANNEL_VALUE_CHANGED_C:
+      server->onValueUpdate();
+      break;
+    case SUPLA_DS_CALL_CHANNEL_SET_VALUE_RESULT:
+    case SUPLA_DS_CALL_DEVICE_CALCFG_RESULT:
+    case SUPLA_DS_CALL_SET_CHANNEL_CONFIG_RESULT:
+    case SUPLA_DS_CALL_SET_DEVICE_CONFIG_RESULT:
+      onCommandResult(callId, rd);
+      break;
+    default:
+      // extended values, action triggers, notifications etc. are accepted
+      // without reply
+      break;
+  }
+}
+
+void SrpcServerEmulator::Session::onCommandResult(uint32_t callId,
+                                                  TsrpcReceivedData *rd) {
+  if (callId == SUPLA_DS_CALL_CHANNEL_SET_VALUE_RESULT ||
+      callId == SUPLA_DS_CALL_DEVICE_CALCFG_RESULT) {
+    int32_t senderId = 0;
+    if (callId == SUPLA_DS_CALL_CHANNEL_SET_VALUE_RESULT) {
+      if (rd->data.ds_channel_new_value_result == nullptr) {
+        return;
+      }
+      senderId = rd->data.ds_channel_new_value_result->SenderID;
+    } else {
+      if (rd->data.ds_device_calcfg_result == nullptr) {
+        return;
+      }
+      senderId = rd->data.ds_device_calcfg_result->ReceiverID;
+    }
+    auto it = pendingBySender.find(senderId);
+    if (it != pendingBySender.end()) {
+      server->onCommandResult(it->second.first, it->second.second);
+      pendingBySender.erase(it);
+    }
+    return;
+  }
+
+  if (callId == SUPLA_DS_CALL_SET_CHANNEL_CONFIG_RESULT) {
+    if (rd->data.sds_set_channel_config_result == nullptr) {
+      return;
+    }
+    uint8_t channel = rd->data.sds_set_channel_config_result->ChannelNumber;
+    auto it = std::find_if(
+        pendingChannelConfig.begin(),
+        pendingChannelConfig.end(),
+        [channel](const auto &pending) { return pending.first == channel; });
+    if (it != pendingChannelConfig.end()) {
+      server->onCommandResult(Command::ChannelConfig, it->second);
+      pendingChannelConfig.erase(it);
+    }
+    return;
+  }
+
+  if (!pendingDeviceConfig.empty()) {
+    server->onCommandResult(Command::DeviceConfig,
+                            pendingDeviceConfig.front());
+    pendingDeviceConfig.pop_front();
+  }
+}
+
+SrpcServerEmulator::SrpcServerEmulator() = default;
+
+SrpcServerEmulator::~SrpcServerEmulator() {
+  stop();
+  if (tlsContext) {
+    SSL_CTX_free(tlsContext);
+    tlsContext = nullptr;
+  }
+}
+
+bool SrpcServerEmulator::enableTls(const char *certFile, const char *keyFile) {
+  SSL_CTX *context = SSL_CTX_new(TLS_server_method());
+  if (context == nullptr ||
+      SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION) != 1 ||
+      SSL_CTX_use_certificate_chain_file(context, certFile) != 1 ||
+      SSL_CTX_use_PrivateKey_file(context, keyFile, SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(context) != 1) {
+    char reason[256] = {};
+    ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+    fprintf(stderr, "SRPC emulator: can't use TLS certificate: %s\n", reason);
+    SSL_CTX_free(context);
+    return false;
+  }
+  if (tlsContext) {
+    SSL_CTX_free(tlsContext);
+  }
+  tlsContext = context;
+  return true;
+}
+
+bool SrpcServerEmulator::isTlsEnabled() const {
+  return tlsContext != nullptr;
+}
+
+bool SrpcServerEmulator::listen(uint16_t port, const char *address) {
+  stop();
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+    fprintf(stderr, "SRPC emulator: invalid address %s\n", address);
+    return false;
+  }
+
+  listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd < 0) {
+    perror("SRPC emulator: socket");
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      ::listen(listenFd, SOMAXCONN) != 0) {
+    perror("SRPC emulator: bind/listen");
+    stop();
+    return false;
+  }
+
+  socklen_t addrSize = sizeof(addr);
+  getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &addrSize);
+  this->port = ntohs(addr.sin_port);
+  return true;
+}
+
+void SrpcServerEmulator::stop() {
+  sessions.clear();
+  registrationOrder.clear();
+  if (listenFd >= 0) {
+    close(listenFd);
+    listenFd = -1;
+  }
+  port = 0;
+}
+
+uint16_t SrpcServerEmulator::getPort() const {
+  return port;
+}
+
+void SrpcServerEmulator::iterate(int timeoutMs) {
+  for (auto &session : sessions) {
+    if (session->hasBufferedInput()) {
+      timeoutMs = 0;
+      break;
+    }
+  }
+  if (timeoutMs > 0) {
+    std::vector<pollfd> fds;
+    fds.reserve(sessions.size() + 1);
+    if (listenFd >= 0) {
+      fds.push_back({listenFd, POLLIN, 0});
+    }
+    for (auto &session : sessions) {
+      int16_t events = POLLIN;
+      if (session->wantsWrite()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({session->getFd(), events, 0});
+    }
+    poll(fds.data(), fds.size(), timeoutMs);
+  }
+
+  while (listenFd >= 0) {
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      break;
+    }
+    sessions.push_back(std::make_unique<Session>(this, fd, nextDeviceId++));
+  }
+
+  for (auto &session : sessions) {
+    session->iterate();
+  }
+
+  auto removed = std::remove_if(
+      sessions.begin(), sessions.end(), [this](const auto &session) {
+        if (session->isConnected()) {
+          return false;
+        }
+        auto id = session->info.id;
+        registrationOrder.erase(std::remove(registrationOrder.begin(),
+                                            registrationOrder.end(),
+                                            id),
+                                registrationOrder.end());
+        return true;
+      });
+  sessions.erase(removed, sessions.end());
+}
+
+void SrpcServerEmulator::setActivityTimeout(uint8_t timeoutSec) {
+  activityTimeout = timeoutSec;
+}
+
+size_t SrpcServerEmulator::getConnectionCount() const {
+  return sessions.size();
+}
+
+std::vector<int> SrpcServerEmulator::getRegisteredDevices() const {
+  return registrationOrder;
+}
+
+const SrpcServerEmulator::DeviceInfo *SrpcServerEmulator::getDeviceInfo(
+    int deviceId) const {
+  auto session = findRegistered(deviceId);
+  return session ? &session->info : nullptr;
+}
+
+SrpcServerEmulator::Session *SrpcServerEmulator::findRegistered(
+    int deviceId) const {
+  for (auto &session : sessions) {
+    if (session->info.id == deviceId) {
+      return session->registered && session->isConnected() ? session.get()
+                                                           : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+bool SrpcServerEmulator::setChannelValue(int deviceId,
+                                         uint8_t channel,
+                                         const char *value,
+                                         uint32_t durationMs) {
+  auto session = findRegistered(deviceId);
+  if (session == nullptr || !session->canSend()) {
+    return false;
+  }
+  TSD_SuplaChannelNewValue newValue = {};
+  newValue.SenderID = nextSenderId++;
+  newValue.ChannelNumber = channel;
+  newValue.DurationMS = durationMs;
+  memcpy(newValue.value, value, SUPLA_CHANNELVALUE_SIZE);
+  if (!srpc_sd_async_set_channel_value(session->getSrpc(), &newValue)) {
+    return false;
+  }
+  session->pendingBySender[newValue.SenderID] = {Command::SetChannelValue,
+                                                 Clock::now()};
+  sentCommands[static_cast<int>(Command::SetChannelValue)]++;
+  return true;
+}
+
+bool SrpcServerEmulator::calCfg(int deviceId,
+                                int32_t channel,
+                                int32_t command,
+                                const void *data,
+                                uint32_t dataSize) {
+  auto session = findRegistered(deviceId);
+  if (session == nullptr || !session->canSend() ||
+      dataSize > SUPLA_CALCFG_DATA_MAXSIZE) {
+    return false;
+  }
+  TSD_DeviceCalCfgRequest request = {};
+  request.SenderID = nextSenderId++;
+  request.ChannelNumber = channel;
+  request.Command = command;
+  request.SuperUserAuthorized = 1;
+  request.DataSize = dataSize;
+  if (dataSize > 0) {
+    memcpy(request.Data, data, dataSize);
+  }
+  if (!srpc_sd_async_device_calcfg_request(session->getSrpc(), &request)) {
+    return false;
+  }
+  session->pendingBySender[request.SenderID] = {Command::CalCfg,
+                                                Clock::now()};
+  sentCommands[static_cast<int>(Command::CalCfg)]++;
+  return true;
+}
+
+bool SrpcServerEmulator::setChannelConfig(int deviceId,
+                                          uint8_t channel,
+                                          int32_t function,
+                                          uint8_t configType,
+                                          const void *config,
+                                          uint16_t configSize) {
+  auto session = findRegistered(deviceId);
+  if (session == nullptr || !session->canSend() ||
+      configSize > SUPLA_CHANNEL_CONFIG_MAXSIZE) {
+    return false;
+  }
+  TSDS_SetChannelConfig request = {};
+  request.ChannelNumber = channel;
+  request.Func = function;
+  request.ConfigType = configType;
+  request.ConfigSize = configSize;
+  if (configSize > 0) {
+    memcpy(request.Config, config, configSize);
+  }
+  if (!srpc_sd_async_set_channel_config_request(session->getSrpc(),
+                                                &request)) {
+    return false;
+  }
+  session->pendingChannelConfig.emplace_back(channel, Clock::now());
+  sentCommands[static_cast<int>(Command::ChannelConfig)]++;
+  return true;
+}
+
+bool SrpcServerEmulator::setDeviceConfig(int deviceId,
+                                         uint64_t fields,
+                                         const void *config,
+                                         uint16_t configSize) {
+  auto session = findRegistered(deviceId);
+  if (session == nullptr || !session->canSend() ||
+      configSize > SUPLA_DEVICE_CONFIG_MAXSIZE) {
+    return false;
+  }
+  TSDS_SetDeviceConfig request = {};
+  request.EndOfDataFlag = 1;
+  request.AvailableFields = fields;
+  request.Fields = fields;
+  request.ConfigSize = configSize;
+  if (configSize > 0) {
+    memcpy(request.Config, config, configSize);
+  }
+  if (!srpc_sd_async_set_device_config_request(session->getSrpc(),
+                                               &request)) {
+    return false;
+  }
+  session->pendingDeviceConfig.push_back(Clock::now());
+  sentCommands[static_cast<int>(Command::DeviceConfig)]++;
+  return true;
+}
+
+size_t SrpcServerEmulator::getPendingCommandCount() const {
+  size_t count = 0;
+  for (auto &session : sessions) {
+    count += session->pendingBySender.size() +
+             session->pendingChannelConfig.size() +
+             session->pendingDeviceConfig.size();
+  }
+  return count;
+}
+
+const LatencyStats &SrpcServerEmulator::getRegistrationTime() const {
+  return registrationTime;
+}
+
+const LatencyStats &SrpcServerEmulator::getLatency(Command command) const {
+  return latency[static_cast<int>(command)];
+}
+
+uint64_t SrpcServerEmulator::getSentCommandCount(Command command) const {
+  return sentCommands[static_cast<int>(command)];
+}
+
+uint64_t SrpcServerEmulator::getValueUpdateCount() const {
+  return valueUpdates;
+}
+
+double SrpcServerEmulator::getValueUpdateRate() const {
+  if (valueUpdates < 2) {
+    return 0;
+  }
+  double seconds =
+      std::chrono::duration<double>(lastValueUpdate - firstValueUpdate)
+          .count();
+  return seconds > 0 ? static_cast<double>(valueUpdates - 1) / seconds : 0;
+}
+
+void SrpcServerEmulator::resetStats() {
+  registrationTime.clear();
+  for (auto &stats : latency) {
+    stats.clear();
+  }
+  for (auto &count : sentCommands) {
+    count = 0;
+  }
+  valueUpdates = 0;
+}
+
+void SrpcServerEmulator::onValueUpdate() {
+  auto now = Clock::now();
+  if (valueUpdates == 0) {
+    firstValueUpdate = now;
+  }
+  lastValueUpdate = now;
+  valueUpdates++;
+}
+
+void SrpcServerEmulator::onCommandResult(Command command,
+                                         Clock::time_point sentAt) {
+  latency[static_cast<int>(command)].add(
+      SrpcConnection::ElapsedUs(sentAt));
+}
+
+const char *SrpcServerEmulator::CommandName(Command command) {
+  switch (command) {
+    case Command::SetChannelValue:
+      return "SetChannelValue";
+    case Command::CalCfg:
+      return "CalCfg";
+    case Command::ChannelConfig:
+      return "ChannelConfig";
+    case Command::DeviceConfig:
+      return "DeviceConfig";
+    case Command::Count:
+      break;
+  }
+  return "?";
+}
+
+std::string SrpcServerEmulator::report() const {
+  std::string result;
+  char line[160];
+  auto addStats = [&](const char *name,
+                      uint64_t sent,
+                      const LatencyStats &stats) {
+    snprintf(line,
+             sizeof(line),
+             "%-16s %8llu %8zu %9.0f %9llu %9llu %9llu %9llu\n",
+             name,
+             static_cast<unsigned long long>(sent),  // NOLINT(runtime/int)
+             stats.count(),
+             stats.mean(),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 stats.percentile(50)),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 stats.percentile(90)),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 stats.percentile(99)),
+             static_cast<unsigned long long>(  // NOLINT(runtime/int)
+                 stats.max()));
+    result += line;
+  };
+
+  snprintf(line,
+           sizeof(line),
+           "%-16s %8s %8s %9s %9s %9s %9s %9s\n",
+           "latency [us]",
+           "sent",
+           "done",
+           "mean",
+           "p50",
+           "p90",
+           "p99",
+           "max");
+  result += line;
+  addStats("Registration", registrationTime.count(), registrationTime);
+  for (int i = 0; i < static_cast<int>(Command::Count); i++) {
+    addStats(CommandName(static_cast<Command>(i)), sentCommands[i], latency[i]);
+  }
+  snprintf(line,
+           sizeof(line),
+           "Value updates: %llu (%.0f/s)\n",
+           static_cast<unsigned long long>(valueUpdates),  // NOLINT
+           getValueUpdateRate());
+  result += line;
+  return result;
+}
+
+}  // namespace Supla
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SERVER_EMULATOR_H_
+#define EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SERVER_EMULATOR_H_
+
+#include <openssl/ssl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "latency_stats.h"
+
+namespace Supla {
+
+/**
+ * Local emulator of supla-server device endpoint (plain TCP or TLS).
+ *
+ * It answers registration, ping, activity timeout, user local time and
+ * channel/device config calls, so real device (i.e. sd4linux configured with
+ * emulator address) or SrpcSimulatedDevice stays online. With enableTls(),
+ * devices connect like to port 2016 of supla-server, so TLS handshake cost
+ * is included in registration time.
+ *
+ * Commands can be sent to registered devices: SetChannelValue, CalCfg,
+ * ChannelConfig and DeviceConfig. Round trip time from sending command to
+ * receiving its result is measured per command kind. Registration time (TCP
+ * accept -> register result sent) and received channel value updates are
+ * collected as well.
+ *
+ * Everything runs in caller's thread from iterate().
+ */
+class SrpcServerEmulator {
+ public:
+  enum class Command {
+    SetChannelValue,
+    CalCfg,
+    ChannelConfig,
+    DeviceConfig,
+    Count,
+  };
+
+  struct DeviceInfo {
+    int id = 0;
+    std::string name;
+    std::string softVer;
+    int protoVersion = 0;
+    int channelCount = 0;
+    std::vector<int> channelFunctions;
+  };
+
+  SrpcServerEmulator();
+  ~SrpcServerEmulator();
+
+  SrpcServerEmulator(const SrpcServerEmulator &) = delete;
+  SrpcServerEmulator &operator=(const SrpcServerEmulator &) = delete;
+
+  // Loads PEM certificate (chain) and private key used for TLS on all
+  // connections accepted later. Returns false when files can't be used.
+  bool enableTls(const char *certFile, const char *keyFile);
+  bool isTlsEnabled() const;
+  // port 0 - ephemeral port, check getPort()
+  bool listen(uint16_t port, const char *address = "0.0.0.0");
+  void stop();
+  uint16_t getPort() const;
+
+  // Accepts connections and handles all connected devices. Waits up to
+  // timeoutMs for socket activity (0 - doesn't wait).
+  void iterate(int timeoutMs = 0);
+
+  void setActivityTimeout(uint8_t timeoutSec);
+
+  size_t getConnectionCount() const;
+  // ids of registered devices, in registration order
+  std::vector<int> getRegisteredDevices() const;
+  const DeviceInfo *getDeviceInfo(int deviceId) const;
+
+  // Commands return false when device isn't registered or its srpc output
+  // queue is full (call iterate() and retry).
+  bool setChannelValue(int deviceId,
+                       uint8_t channel,
+                       const char *value,
+                       uint32_t durationMs = 0);
+  bool calCfg(int deviceId,
+              int32_t channel,
+              int32_t command,
+              const void *data = nullptr,
+              uint32_t dataSize = 0);
+  bool setChannelConfig(int deviceId,
+                        uint8_t channel,
+                        int32_t function,
+                        uint8_t configType,
+                        const void *config,
+                        uint16_t configSize);
+  bool setDeviceConfig(int deviceId,
+                       uint64_t fields,
+                       const void *config,
+                       uint16_t configSize);
+
+  // Commands without result yet
+  size_t getPendingCommandCount() const;
+
+  const LatencyStats &getRegistrationTime() const;
+  const LatencyStats &getLatency(Command command) const;
+  uint64_t getSentCommandCount(Command command) const;
+  uint64_t getValueUpdateCount() const;
+  // values per second between first and last received value update
+  double getValueUpdateRate() const;
+  void resetStats();
+
+  std::string report() const;
+  static const char *CommandName(Command command);
+
+ private:
+  class Session;
+  friend class Session;
+  using Clock = std::chrono::steady_clock;
+
+  Session *findRegistered(int deviceId) const;
+  void onValueUpdate();
+  void onCommandResult(Command command, Clock::time_point sentAt);
+
+  int listenFd = -1;
+  uint16_t port = 0;
+  SSL_CTX *tlsContext = nullptr;
+  uint8_t activityTimeout = 120;
+  int nextDeviceId = 1;
+  int32_t nextSenderId = 1;
+  std::vector<std::unique_ptr<Session>> sessions;
+  std::vector<int> registrationOrder;
+
+  LatencyStats registrationTime;
+  LatencyStats latency[static_cast<int>(Command::Count)];
+  uint64_t sentCommands[static_cast<int>(Command::Count)] = {};
+  uint64_t valueUpdates = 0;
+  Clock::time_point firstValueUpdate;
+  Clock::time_point lastValueUpdate;
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SERVER_EMULATOR_H_
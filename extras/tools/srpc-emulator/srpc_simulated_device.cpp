@@ -0,0 +1,218 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "srpc_simulated_device.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace Supla {
+
+std::unique_ptr<SrpcSimulatedDevice> SrpcSimulatedDevice::Connect(
+    const char *host,
+    uint16_t port,
+    int index,
+    int channelCount,
+    SSL_CTX *tlsContext) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0) {
+    fprintf(stderr, "Simulated device: can't resolve %s\n", host);
+    return nullptr;
+  }
+
+  int fd = -1;
+  for (auto address = addresses; address; address = address->ai_next) {
+    fd = socket(address->ai_family,
+                address->ai_socktype | SOCK_CLOEXEC,
+                address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    perror("Simulated device: connect");
+    return nullptr;
+  }
+
+  std::unique_ptr<SrpcSimulatedDevice> device(
+      new SrpcSimulatedDevice(fd, index, channelCount, tlsContext));
+  device->sendRegistration();
+  return device;
+}
+
+SrpcSimulatedDevice::SrpcSimulatedDevice(int fd,
+                                         int index,
+                                         int channelCount,
+                                         SSL_CTX *tlsContext)
+    : SrpcConnection(fd, tlsContext, false),
+      index(index),
+      connectedAt(Clock::now()),
+      values(channelCount),
+      changed(channelCount, false) {
+  for (auto &value : values) {
+    value.fill(0);
+  }
+}
+
+void SrpcSimulatedDevice::sendRegistration() {
+  TDS_SuplaRegisterDevice_G request = {};
+  snprintf(request.Email, sizeof(request.Email), "emulator@localhost");
+  // deterministic GUID, so server side sees the same device after restart
+  for (int i = 0; i < SUPLA_GUID_SIZE; i++) {
+    request.GUID[i] = static_cast<char>((index >> ((i % 4) * 8)) + i);
+  }
+  snprintf(request.Name, sizeof(request.Name), "Simulated device %d", index);
+  snprintf(request.SoftVer, sizeof(request.SoftVer), "srpc-emulator");
+  request.Flags = SUPLA_DEVICE_FLAG_DEVICE_CONFIG_SUPPORTED;
+  request.channel_count = values.size();
+  for (size_t i = 0; i < values.size(); i++) {
+    auto &channel = request.channels[i];
+    channel.Number = i;
+    channel.Type = SUPLA_CHANNELTYPE_RELAY;
+    channel.FuncList = SUPLA_BIT_FUNC_LIGHTSWITCH;
+    channel.Default = SUPLA_CHANNELFNC_LIGHTSWITCH;
+  }
+  srpc_ds_async_registerdevice_g(srpc, &request);
+}
+
+bool SrpcSimulatedDevice::isRegistered() const {
+  return registerResultCode == SUPLA_RESULTCODE_TRUE;
+}
+
+int SrpcSimulatedDevice::getRegisterResultCode() const {
+  return registerResultCode;
+}
+
+uint64_t SrpcSimulatedDevice::getRegistrationTimeUs() const {
+  return registrationTimeUs;
+}
+
+int SrpcSimulatedDevice::getChannelCount() const {
+  return values.size();
+}
+
+uint64_t SrpcSimulatedDevice::getHandledCommandCount() const {
+  return handledCommands;
+}
+
+void SrpcSimulatedDevice::changeAllValues() {
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i][0] = values[i][0] ? 0 : 1;
+    if (!changed[i]) {
+      changed[i] = true;
+      changedCount++;
+    }
+  }
+}
+
+int SrpcSimulatedDevice::sendChangedValues() {
+  for (size_t i = 0; i < changed.size() && changedCount > 0; i++) {
+    if (!changed[i]) {
+      continue;
+    }
+    if (!isRegistered() || !canSend()) {
+      break;
+    }
+    srpc_ds_async_channel_value_changed_c(srpc, i, values[i].data(), 0, 0);
+    changed[i] = false;
+    changedCount--;
+  }
+  return changedCount;
+}
+
+void SrpcSimulatedDevice::onCall(TsrpcReceivedData *rd, uint32_t callId) {
+  switch (callId) {
+    case SUPLA_SD_CALL_REGISTER_DEVICE_RESULT:
+      if (rd->data.sd_register_device_result) {
+        registerResultCode = rd->data.sd_register_device_result->result_code;
+        registrationTimeUs = ElapsedUs(connectedAt);
+      }
+      break;
+    case SUPLA_SD_CALL_REGISTER_DEVICE_RESULT_B:
+      if (rd->data.sd_register_device_result_b) {
+        registerResultCode = rd->data.sd_register_device_result_b->result_code;
+        registrationTimeUs = ElapsedUs(connectedAt);
+      }
+      break;
+    case SUPLA_SD_CALL_CHANNEL_SET_VALUE: {
+      auto request = rd->data.sd_channel_new_value;
+      if (request == nullptr) {
+        break;
+      }
+      handledCommands++;
+      uint8_t channel = request->ChannelNumber;
+      bool success = channel < values.size();
+      if (success) {
+        memcpy(values[channel].data(), request->value, SUPLA_CHANNELVALUE_SIZE);
+        if (!changed[channel]) {
+          changed[channel] = true;
+          changedCount++;
+        }
+      }
+      int32_t senderId = request->SenderID;
+      send([channel, senderId, success](void *srpc) {
+        srpc_ds_async_set_channel_result(srpc, channel, senderId, success);
+      });
+      break;
+    }
+    case SUPLA_SD_CALL_DEVICE_CALCFG_REQUEST: {
+      auto request = rd->data.sd_device_calcfg_request;
+      if (request == nullptr) {
+        break;
+      }
+      handledCommands++;
+      TDS_DeviceCalCfgResult result = {};
+      result.ReceiverID = request->SenderID;
+      result.ChannelNumber = request->ChannelNumber;
+      result.Command = request->Command;
+      result.Result = SUPLA_CALCFG_RESULT_DONE;
+      send([result](void *srpc) mutable {
+        srpc_ds_async_device_calcfg_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_SD_CALL_SET_CHANNEL_CONFIG: {
+      auto request = rd->data.sds_set_channel_config_request;
+      if (request == nullptr) {
+        break;
+      }
+      handledCommands++;
+      TSDS_SetChannelConfigResult result = {};
+      result.Result = SUPLA_CONFIG_RESULT_TRUE;
+      result.ConfigType = request->ConfigType;
+      result.ChannelNumber = request->ChannelNumber;
+      send([result](void *srpc) mutable {
+        srpc_ds_async_set_channel_config_result(srpc, &result);
+      });
+      break;
+    }
+    case SUPLA_SD_CALL_SET_DEVICE_CONFIG: {
+      handledCommands++;
+      TSDS_SetDeviceConfigResult result = {};
+      result.Result = SUPLA_CONFIG_RESULT_TRUE;
+      send([result](void *srpc) mutable {
+        srpc_ds_async_set_device_config_result(srpc, &result);
+      });
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+}  // namespace Supla
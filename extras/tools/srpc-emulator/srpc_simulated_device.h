@@ -0,0 +1,71 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SIMULATED_DEVICE_H_
+#define EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SIMULATED_DEVICE_H_
+
+#include <stdint.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "srpc_connection.h"
+
+namespace Supla {
+
+/**
+ * Lightweight device used by the load generator: it registers with relay
+ * channels (REGISTER_DEVICE_G), answers SetChannelValue, CalCfg, channel and
+ * device config requests, and reports changed channel values.
+ *
+ * Many instances run in one process, so it doesn't use SuplaDevice and
+ * elements - only srpc codec shared with real devices.
+ */
+class SrpcSimulatedDevice : public SrpcConnection {
+ public:
+  // Connects to server and queues registration (sent after TLS handshake
+  // when tlsContext is given). Returns nullptr on error.
+  static std::unique_ptr<SrpcSimulatedDevice> Connect(
+      const char *host,
+      uint16_t port,
+      int index,
+      int channelCount,
+      SSL_CTX *tlsContext = nullptr);
+
+  bool isRegistered() const;
+  int getRegisterResultCode() const;
+  // TCP connect -> register result received
+  uint64_t getRegistrationTimeUs() const;
+  int getChannelCount() const;
+  uint64_t getHandledCommandCount() const;
+
+  // Changes value of each channel and queues value update
+  void changeAllValues();
+  // Sends queued value updates while srpc output queue has room. Returns
+  // number of values still waiting.
+  int sendChangedValues();
+
+ protected:
+  void onCall(TsrpcReceivedData *rd, uint32_t callId) override;
+
+ private:
+  SrpcSimulatedDevice(int fd,
+                      int index,
+                      int channelCount,
+                      SSL_CTX *tlsContext);
+  void sendRegistration();
+
+  int index = 0;
+  Clock::time_point connectedAt;
+  int registerResultCode = 0;
+  uint64_t registrationTimeUs = 0;
+  uint64_t handledCommands = 0;
+  std::vector<std::array<char, SUPLA_CHANNELVALUE_SIZE>> values;
+  std::vector<bool> changed;
+  int changedCount = 0;
+};
+
+}  // namespace Supla
+
+#endif  // EXTRAS_TOOLS_SRPC_EMULATOR_SRPC_SIMULATED_DEVICE_H_
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// supla-common log.c server variant depends on supla-server config, so
+// emulator provides its own log functions used by srpc and proto.
+
+#include <log.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace {
+
+int logLevel = LOG_WARNING;
+
+}  // namespace
+
+void supla_log_set_level(int level) {
+  logLevel = level;
+}
+
+int supla_log_get_level(void) {
+  return logLevel;
+}
+
+char supla_log_is_enabled(int level) {
+  return level <= logLevel ? 1 : 0;
+}
+
+void supla_log(int __pri, const char *__fmt, ...) {
+  if (__fmt == nullptr || !supla_log_is_enabled(__pri)) {
+    return;
+  }
+  va_list args;
+  va_start(args, __fmt);
+  vfprintf(stderr, __fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void supla_write_state_file(const char *, int, const char *, ...) {
+}
@@ -237,6 +237,10 @@ bool SuplaDeviceClass::begin(unsigned char protoVersion) {
       element->onLoadConfig(this);
       delay(0);
     }
+    for (auto channel = Supla::Channel::Begin(); channel != nullptr;
+         channel = channel->next()) {
+      channel->loadReportingPolicy();
+    }
     SUPLA_LOG_INFO(" *** Supla - Config load for elements done");
   }
 
@@ -5,7 +5,6 @@
 
 #include "proto.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,29 +46,28 @@
 
 char sproto_tag[SUPLA_TAG_SIZE] = {'S', 'U', 'P', 'L', 'A'};
 
+// Ring buffer: data_size bytes starting at offset, wrapping at size. Popping
+// data only moves offset, capacity grows up to BUFFER_MAX_SIZE - 1 and is
+// kept until sproto_free.
 typedef struct {
-  unsigned char begin_tag;
   unsigned _supla_int_t size;
   unsigned _supla_int_t data_size;
+  unsigned _supla_int_t offset;
 
   char *buffer;
-} TSuplaProtoInBuffer;
+} TSuplaProtoBuffer;
 
-#ifndef SPROTO_WITHOUT_OUT_BUFFER
 typedef struct {
-  unsigned _supla_int_t size;
-  unsigned _supla_int_t data_size;
-
-  char *buffer;
-} TSuplaProtoOutBuffer;
-#endif
+  unsigned char begin_tag;
+  TSuplaProtoBuffer ring;
+} TSuplaProtoInBuffer;
 
 typedef struct {
   unsigned _supla_int_t next_rr_id;
   unsigned char version;
   TSuplaProtoInBuffer in;
 #ifndef SPROTO_WITHOUT_OUT_BUFFER
-  TSuplaProtoOutBuffer out;
+  TSuplaProtoBuffer out;
 #endif
 } TSuplaProtoData;
 
@@ -87,7 +85,7 @@ void *sproto_init(void) {
 void sproto_free(void *spd_ptr) {
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
   if (spd != NULL) {
-    if (spd->in.buffer != NULL) free(spd->in.buffer);
+    if (spd->in.ring.buffer != NULL) free(spd->in.ring.buffer);
 #ifndef SPROTO_WITHOUT_OUT_BUFFER
     if (spd->out.buffer != NULL) free(spd->out.buffer);
 #endif
@@ -96,51 +94,118 @@ void sproto_free(void *spd_ptr) {
   }
 }
 
-unsigned char PROTO_ICACHE_FLASH sproto_buffer_append(
-    void *spd_ptr, char **buffer, unsigned _supla_int_t *buffer_size,
-    unsigned _supla_int_t *buffer_data_size, char *data,
-    unsigned _supla_int_t data_size) {
-  (void)(spd_ptr);
-  unsigned _supla_int_t size = *buffer_size;
+static unsigned _supla_int_t PROTO_ICACHE_FLASH
+sproto_ring_index(const TSuplaProtoBuffer *ring, unsigned _supla_int_t pos) {
+  pos += ring->offset;
+  return pos >= ring->size ? pos - ring->size : pos;
+}
+
+// Copies size bytes starting at pos (relative to the oldest byte)
+static void PROTO_ICACHE_FLASH sproto_ring_read(const TSuplaProtoBuffer *ring,
+                                                unsigned _supla_int_t pos,
+                                                char *dest,
+                                                unsigned _supla_int_t size) {
+  if (size == 0) return;
+
+  unsigned _supla_int_t idx = sproto_ring_index(ring, pos);
+  unsigned _supla_int_t first = ring->size - idx;
 
-  if (size < BUFFER_MIN_SIZE) {
-    size = BUFFER_MIN_SIZE;
+  if (size <= first) {
+    memcpy(dest, &ring->buffer[idx], size);
+  } else {
+    memcpy(dest, &ring->buffer[idx], first);
+    memcpy(&dest[first], ring->buffer, size - first);
   }
+}
 
-  if (data_size > size - (*buffer_data_size)) {
-    size += data_size - (size - (*buffer_data_size));
+static int PROTO_ICACHE_FLASH sproto_ring_compare(const TSuplaProtoBuffer *ring,
+                                                  unsigned _supla_int_t pos,
+                                                  const char *data,
+                                                  unsigned _supla_int_t size) {
+  unsigned _supla_int_t idx = sproto_ring_index(ring, pos);
+  unsigned _supla_int_t first = ring->size - idx;
+
+  if (size <= first) {
+    return memcmp(&ring->buffer[idx], data, size);
   }
 
-  if (size >= BUFFER_MAX_SIZE) return (SUPLA_RESULT_BUFFER_OVERFLOW);
+  int result = memcmp(&ring->buffer[idx], data, first);
+  if (result == 0) {
+    result = memcmp(ring->buffer, &data[first], size - first);
+  }
+  return result;
+}
 
-  if (size != (*buffer_size)) {
-    char *new_buffer = (char *)realloc(*buffer, size);
+static void PROTO_ICACHE_FLASH sproto_ring_consume(TSuplaProtoBuffer *ring,
+                                                   unsigned _supla_int_t size) {
+  if (size >= ring->data_size) {
+    ring->data_size = 0;
+    ring->offset = 0;
+    return;
+  }
 
-    if (size > 0 && new_buffer == NULL) {
-      return (SUPLA_RESULT_FALSE);
-    }
+  ring->offset = sproto_ring_index(ring, size);
+  ring->data_size -= size;
+}
 
-#if !defined(ESP8266) && !defined(ESP32) && !defined(ARDUINO) && \
-    !defined(SUPLA_DEVICE)
-    if (errno == ENOMEM) return (SUPLA_RESULT_FALSE);
-#endif
+// Makes room for size more bytes. Buffer is reallocated only when it has to
+// grow; the content is linearized then.
+static char PROTO_ICACHE_FLASH sproto_ring_reserve(TSuplaProtoBuffer *ring,
+                                                   unsigned _supla_int_t size) {
+  if (size <= ring->size - ring->data_size) return (SUPLA_RESULT_TRUE);
 
-    *buffer = new_buffer;
-  }
+  unsigned _supla_int_t required = ring->data_size + size;
+  if (required >= BUFFER_MAX_SIZE) return (SUPLA_RESULT_BUFFER_OVERFLOW);
+
+  unsigned _supla_int_t new_size = ring->size * 2;
+  if (new_size < required) new_size = required;
+  if (new_size < BUFFER_MIN_SIZE) new_size = BUFFER_MIN_SIZE;
+  if (new_size >= BUFFER_MAX_SIZE) new_size = BUFFER_MAX_SIZE - 1;
 
-  memcpy(&(*buffer)[(*buffer_data_size)], data, data_size);
+  char *new_buffer = (char *)malloc(new_size);
+  if (new_buffer == NULL) return (SUPLA_RESULT_FALSE);
 
-  (*buffer_size) = size;
-  (*buffer_data_size) += data_size;
+  if (ring->buffer != NULL) {
+    sproto_ring_read(ring, 0, new_buffer, ring->data_size);
+    free(ring->buffer);
+  }
+
+  ring->buffer = new_buffer;
+  ring->size = new_size;
+  ring->offset = 0;
 
   return (SUPLA_RESULT_TRUE);
 }
 
+// Caller has to reserve space first
+static void PROTO_ICACHE_FLASH sproto_ring_write(TSuplaProtoBuffer *ring,
+                                                 const char *data,
+                                                 unsigned _supla_int_t size) {
+  if (size == 0) return;
+
+  unsigned _supla_int_t idx = sproto_ring_index(ring, ring->data_size);
+  unsigned _supla_int_t first = ring->size - idx;
+
+  if (size <= first) {
+    memcpy(&ring->buffer[idx], data, size);
+  } else {
+    memcpy(&ring->buffer[idx], data, first);
+    memcpy(ring->buffer, &data[first], size - first);
+  }
+
+  ring->data_size += size;
+}
+
 char PROTO_ICACHE_FLASH sproto_in_buffer_append(
     void *spd_ptr, char *data, unsigned _supla_int_t data_size) {
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
-  return sproto_buffer_append(spd_ptr, &spd->in.buffer, &spd->in.size,
-                              &spd->in.data_size, data, data_size);
+  char result = sproto_ring_reserve(&spd->in.ring, data_size);
+
+  if (result == SUPLA_RESULT_TRUE) {
+    sproto_ring_write(&spd->in.ring, data, data_size);
+  }
+
+  return result;
 }
 
 #ifndef SPROTO_WITHOUT_OUT_BUFFER
@@ -153,55 +218,27 @@ char PROTO_ICACHE_FLASH sproto_out_buffer_append(void *spd_ptr,
 
   if (packet_size > sdp_size) return SUPLA_RESULT_DATA_TOO_LARGE;
 
-  if (SUPLA_RESULT_TRUE ==
-      sproto_buffer_append(spd_ptr, &spd->out.buffer, &spd->out.size,
-                           &spd->out.data_size, (char *)sdp, packet_size)) {
-    return sproto_buffer_append(spd_ptr, &spd->out.buffer, &spd->out.size,
-                                &spd->out.data_size, sproto_tag,
-                                SUPLA_TAG_SIZE);
+  if (SUPLA_RESULT_TRUE !=
+      sproto_ring_reserve(&spd->out, packet_size + SUPLA_TAG_SIZE)) {
+    return (SUPLA_RESULT_FALSE);
   }
 
-  return (SUPLA_RESULT_FALSE);
+  sproto_ring_write(&spd->out, (char *)sdp, packet_size);
+  sproto_ring_write(&spd->out, sproto_tag, SUPLA_TAG_SIZE);
+
+  return (SUPLA_RESULT_TRUE);
 }
 
 unsigned _supla_int_t PROTO_ICACHE_FLASH sproto_pop_out_data(
     void *spd_ptr, char *buffer, unsigned _supla_int_t buffer_size) {
-  unsigned _supla_int_t a;
-  unsigned _supla_int_t b;
-
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
 
   if (spd->out.data_size <= 0 || buffer_size == 0 || buffer == NULL) return (0);
 
   if (spd->out.data_size < buffer_size) buffer_size = spd->out.data_size;
 
-  memcpy(buffer, spd->out.buffer, buffer_size);
-
-  b = 0;
-
-  for (a = buffer_size; a < spd->out.data_size; a++) {
-    spd->out.buffer[b] = spd->out.buffer[a];
-    b++;
-  }
-
-  spd->out.data_size -= buffer_size;
-
-  if (spd->out.data_size < spd->out.size) {
-    b = spd->out.size;
-
-    spd->out.size = spd->out.data_size;
-    if (spd->out.size < BUFFER_MIN_SIZE) spd->out.size = BUFFER_MIN_SIZE;
-
-    if (b != spd->out.size) {
-      char *new_out_buffer = (char *)realloc(spd->out.buffer, spd->out.size);
-
-      if (new_out_buffer == NULL && spd->out.size > 0) {
-        spd->out.size = b;
-      } else {
-        spd->out.buffer = new_out_buffer;
-      }
-    }
-  }
+  sproto_ring_read(&spd->out, 0, buffer, buffer_size);
+  sproto_ring_consume(&spd->out, buffer_size);
 
   return (buffer_size);
 }
@@ -218,96 +255,66 @@ char PROTO_ICACHE_FLASH sproto_out_dataexists(void *spd_ptr) {
 }
 
 char PROTO_ICACHE_FLASH sproto_in_dataexists(void *spd_ptr) {
-  return ((TSuplaProtoData *)spd_ptr)->in.data_size > 0 ? SUPLA_RESULT_TRUE
-                                                        : SUPLA_RESULT_FALSE;
+  return ((TSuplaProtoData *)spd_ptr)->in.ring.data_size > 0
+             ? SUPLA_RESULT_TRUE
+             : SUPLA_RESULT_FALSE;
 }
 
 void PROTO_ICACHE_FLASH sproto_shrink_in_buffer(TSuplaProtoInBuffer *in,
                                                 unsigned _supla_int_t size) {
-  unsigned _supla_int_t old_size = in->size;
-  unsigned _supla_int_t a, b;
-
   in->begin_tag = 0;
-
-  if (size > in->data_size) size = in->data_size;
-
-  b = 0;
-
-  for (a = size; a < in->data_size; a++) {
-    in->buffer[b] = in->buffer[a];
-    b++;
-  }
-
-  in->data_size -= size;
-
-  if (in->data_size < in->size) {
-    in->size = in->data_size;
-
-    if (in->size < BUFFER_MIN_SIZE) in->size = BUFFER_MIN_SIZE;
-
-    if (old_size != in->size) {
-      char *new_in_buffer = (char *)realloc(in->buffer, in->size);
-
-      if (new_in_buffer == NULL && in->size > 0) {
-        in->size = old_size;
-      } else {
-        in->buffer = new_in_buffer;
-      }
-    }
-  }
+  sproto_ring_consume(&in->ring, size);
 }
 
 char PROTO_ICACHE_FLASH sproto_pop_in_sdp(void *spd_ptr,
                                           TSuplaDataPacket *sdp) {
   unsigned _supla_int_t header_size;
-  TSuplaDataPacket *_sdp;
 
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
+  TSuplaProtoBuffer *ring = &spd->in.ring;
 
-  if (spd->in.begin_tag == 0 && spd->in.data_size >= SUPLA_TAG_SIZE) {
-    if (memcmp(spd->in.buffer, sproto_tag, SUPLA_TAG_SIZE) == 0) {
+  if (spd->in.begin_tag == 0 && ring->data_size >= SUPLA_TAG_SIZE) {
+    if (sproto_ring_compare(ring, 0, sproto_tag, SUPLA_TAG_SIZE) == 0) {
       spd->in.begin_tag = 1;
     } else {
-      sproto_shrink_in_buffer(&spd->in, spd->in.data_size);
+      sproto_shrink_in_buffer(&spd->in, ring->data_size);
       return SUPLA_RESULT_DATA_ERROR;
     }
   }
 
   if (spd->in.begin_tag == 1) {
     header_size = sizeof(TSuplaDataPacket) - SUPLA_MAX_DATA_SIZE;
-    if ((spd->in.data_size - SUPLA_TAG_SIZE) >= header_size) {
-      _sdp = (TSuplaDataPacket *)spd->in.buffer;
+    if ((ring->data_size - SUPLA_TAG_SIZE) >= header_size) {
+      // header may wrap, so it is decoded from a copy
+      sproto_ring_read(ring, 0, (char *)sdp, header_size);
 
-      if (_sdp->version > SUPLA_PROTO_VERSION ||
-          _sdp->version < SUPLA_PROTO_VERSION_MIN) {
-        sdp->version = _sdp->version;
-        sproto_shrink_in_buffer(&spd->in, spd->in.data_size);
+      if (sdp->version > SUPLA_PROTO_VERSION ||
+          sdp->version < SUPLA_PROTO_VERSION_MIN) {
+        sproto_shrink_in_buffer(&spd->in, ring->data_size);
 
         return SUPLA_RESULT_VERSION_ERROR;
       }
 
-      if (_sdp->data_size > sizeof(TSuplaDataPacket) - header_size) {
-        sproto_shrink_in_buffer(&spd->in, spd->in.data_size);
+      if (sdp->data_size > sizeof(TSuplaDataPacket) - header_size) {
+        sproto_shrink_in_buffer(&spd->in, ring->data_size);
         return SUPLA_RESULT_DATA_ERROR;
       }
 
-      size_t packet_size = header_size + (size_t)_sdp->data_size;
+      size_t packet_size = header_size + (size_t)sdp->data_size;
 
-      if (packet_size + SUPLA_TAG_SIZE > spd->in.data_size) {
+      if (packet_size + SUPLA_TAG_SIZE > ring->data_size) {
         return SUPLA_RESULT_FALSE;
       }
 
-      if (packet_size >= spd->in.size ||
-          memcmp(&spd->in.buffer[packet_size], sproto_tag, SUPLA_TAG_SIZE) !=
-              0) {
-        sproto_shrink_in_buffer(&spd->in, spd->in.data_size);
+      if (sproto_ring_compare(ring, packet_size, sproto_tag, SUPLA_TAG_SIZE) !=
+          0) {
+        sproto_shrink_in_buffer(&spd->in, ring->data_size);
 
         return SUPLA_RESULT_DATA_ERROR;
       }
 
-      memcpy(sdp, spd->in.buffer, packet_size);
-      sproto_shrink_in_buffer(&spd->in,
-                              packet_size + SUPLA_TAG_SIZE);
+      sproto_ring_read(ring, header_size, (char *)sdp->data, sdp->data_size);
+      sproto_shrink_in_buffer(&spd->in, packet_size + SUPLA_TAG_SIZE);
 
       return (SUPLA_RESULT_TRUE);
     }
@@ -375,8 +382,8 @@ void PROTO_ICACHE_FLASH sproto_log_summary(void *spd_ptr) {
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
 
   supla_log(LOG_DEBUG, "BUFFER IN");
-  supla_log(LOG_DEBUG, "         size: %i", spd->in.size);
-  supla_log(LOG_DEBUG, "    data_size: %i", spd->in.data_size);
+  supla_log(LOG_DEBUG, "         size: %i", spd->in.ring.size);
+  supla_log(LOG_DEBUG, "    data_size: %i", spd->in.ring.data_size);
   supla_log(LOG_DEBUG, "    begin_tag: %i", spd->in.begin_tag);
 #ifndef SPROTO_WITHOUT_OUT_BUFFER
   supla_log(LOG_DEBUG, "BUFFER OUT");
@@ -386,24 +393,25 @@ void PROTO_ICACHE_FLASH sproto_log_summary(void *spd_ptr) {
 }
 
 void PROTO_ICACHE_FLASH sproto_buffer_dump(void *spd_ptr, unsigned char in) {
-  _supla_int_t a;
-  char *buffer = NULL;
-  _supla_int_t size = 0;
+  unsigned _supla_int_t a;
+  TSuplaProtoBuffer *ring = NULL;
 
   TSuplaProtoData *spd = (TSuplaProtoData *)spd_ptr;
 
   if (in != 0) {
-    buffer = spd->in.buffer;
-    size = spd->in.data_size;
+    ring = &spd->in.ring;
 #ifndef SPROTO_WITHOUT_OUT_BUFFER
   } else {
-    buffer = spd->out.buffer;
-    size = spd->out.data_size;
+    ring = &spd->out;
 #endif /*SPROTO_WITHOUT_OUT_BUFFER*/
   }
 
-  for (a = 0; a < size; a++)
-    supla_log(LOG_DEBUG, "%c [%i]", buffer[a], buffer[a]);
+  if (ring == NULL) return;
+
+  for (a = 0; a < ring->data_size; a++) {
+    char c = ring->buffer[sproto_ring_index(ring, a)];
+    supla_log(LOG_DEBUG, "%c [%i]", c, c);
+  }
 }
 
 void PROTO_ICACHE_FLASH sproto_set_null_terminated_string(
@@ -11,6 +11,7 @@
 #include <supla/correction.h>
 #include <math.h>
 #include <supla/device/register_device.h>
+#include <supla/time.h>
 
 #include <string.h>
 
@@ -74,6 +75,7 @@ Channel::~Channel() {
     delete[] initialCaption;
     initialCaption = nullptr;
   }
+  removeReportingPolicy();
 
   if (Begin() == this) {
     firstPtr = next();
@@ -295,7 +297,13 @@ void Channel::setNewValue(
 bool Channel::setNewValue(const char *newValue) {
   if (memcmp(value, newValue, SUPLA_CHANNELVALUE_SIZE) != 0) {
     memcpy(value, newValue, SUPLA_CHANNELVALUE_SIZE);
-    setSendValue();
+    if (reportingPolicy == nullptr ||
+        reportingPolicy->onValueChanged(
+            channelType, value, changedFields & CHANNEL_SEND_VALUE, millis())) {
+      setSendValue();
+    } else {
+      clearSendValue();
+    }
     return true;
   }
   return false;
@@ -391,7 +399,11 @@ bool Channel::isGetConfigRequested() const {
 }
 
 bool Channel::isValueUpdateReady() const {
-  return changedFields & CHANNEL_SEND_VALUE;
+  bool valuePending = changedFields & CHANNEL_SEND_VALUE;
+  if (reportingPolicy) {
+    return reportingPolicy->isSendAllowed(valuePending, millis());
+  }
+  return valuePending;
 }
 
 void Channel::setSendInitialCaption() {
@@ -421,6 +433,9 @@ bool Channel::isStateInfoUpdateReady() const {
 void Channel::sendUpdate() {
   if (isValueUpdateReady()) {
     clearSendValue();
+    if (reportingPolicy) {
+      reportingPolicy->onValueSent(value, millis(), true);
+    }
     for (auto proto = Supla::Protocol::ProtocolLayer::first();
         proto != nullptr; proto = proto->next()) {
       proto->sendChannelValueChanged(channelNumber,
@@ -480,7 +495,9 @@ bool Channel::getExtValueAsElectricityMeter(
 }
 
 bool Channel::isUpdateReady() const {
-  return changedFields != 0;
+  // pending value may be held back by reporting policy, and heartbeat may
+  // be due without any pending value
+  return (changedFields & ~CHANNEL_SEND_VALUE) != 0 || isValueUpdateReady();
 }
 
 bool Channel::isExtended() const {
@@ -1978,6 +1995,10 @@ void Channel::onRegistered() {
   if (isInitialCaptionSet()) {
     setSendInitialCaption();
   }
+  if (reportingPolicy && !isSleepingEnabled()) {
+    // value is sent in registration message
+    reportingPolicy->onValueSent(value, millis(), false);
+  }
   if (isSleepingEnabled()) {
     setSendValue();
     if (isChannelStateEnabled()) {
@@ -2013,3 +2034,50 @@ bool Channel::isRelayOvercurrentCutOff() const {
   }
   return false;
 }
+
+void Channel::setReportingPolicy(const ReportingPolicyConfig &config) {
+  if (!config.isActive()) {
+    removeReportingPolicy();
+    return;
+  }
+  if (reportingPolicy) {
+    reportingPolicy->setConfig(config);
+    return;
+  }
+  reportingPolicy = new ReportingPolicy(config);
+}
+
+void Channel::removeReportingPolicy() {
+  if (reportingPolicy) {
+    delete reportingPolicy;
+    reportingPolicy = nullptr;
+  }
+}
+
+Supla::ReportingPolicy *Channel::getReportingPolicy() const {
+  return reportingPolicy;
+}
+
+void Channel::loadReportingPolicy() {
+  ReportingPolicyConfig config;
+  if (ReportingPolicy::LoadConfig(getChannelNumber(), &config)) {
+    SUPLA_LOG_DEBUG(
+        "Channel[%d] reporting policy: deadband %d (type %d), interval "
+        "%d..%d ms, coalescing %d",
+        getChannelNumber(),
+        config.deadband,
+        static_cast<int>(config.deadbandType),
+        config.minIntervalMs,
+        config.maxIntervalMs,
+        config.coalescing);
+    setReportingPolicy(config);
+  }
+}
+
+uint32_t Channel::getSentValueCount() const {
+  return reportingPolicy ? reportingPolicy->getSentCount() : 0;
+}
+
+uint32_t Channel::getSuppressedValueCount() const {
+  return reportingPolicy ? reportingPolicy->getSuppressedCount() : 0;
+}
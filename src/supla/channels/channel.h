@@ -9,6 +9,7 @@
 #include <supla-common/proto.h>
 #include <supla/local_action.h>
 #include "channel_types.h"
+#include "reporting_policy.h"
 
 namespace Supla {
 
@@ -349,6 +350,24 @@ class Channel : public LocalAction {
   bool isChannelStateEnabled() const;
   void clearSendValue();
 
+  /**
+   * Sets reporting policy (deadband, min/max interval, coalescing) used for
+   * channel value updates. Policy is allocated only when it is active.
+   * Config stored by the web interface overrides policy set from code (see
+   * loadReportingPolicy()).
+   *
+   * @param config
+   */
+  void setReportingPolicy(const ReportingPolicyConfig &config);
+  void removeReportingPolicy();
+  ReportingPolicy *getReportingPolicy() const;
+  // Loads reporting policy stored in config (if any)
+  void loadReportingPolicy();
+
+  // Counters are updated only when reporting policy is set
+  uint32_t getSentValueCount() const;
+  uint32_t getSuppressedValueCount() const;
+
  protected:
   void setSendValue();
   bool isValueUpdateReady() const;
@@ -369,6 +388,7 @@ class Channel : public LocalAction {
   Channel *nextPtr = nullptr;
 
   char *initialCaption = nullptr;
+  ReportingPolicy *reportingPolicy = nullptr;
 
   uint32_t functionsBitmap = 0;
 
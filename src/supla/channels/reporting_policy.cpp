@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "reporting_policy.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <supla/storage/config.h>
+#include <supla/storage/config_tags.h>
+#include <supla/storage/storage.h>
+#include <supla/tools.h>
+
+using Supla::ReportingPolicy;
+using Supla::ReportingPolicyConfig;
+
+namespace {
+
+double decodeDouble(const int8_t *value) {
+  double result = 0;
+  if (sizeof(double) == 8) {
+    memcpy(&result, value, 8);
+  } else if (sizeof(double) == 4) {
+    uint8_t packed[8] = {};
+    memcpy(packed, value, sizeof(packed));
+    result = doublePacked2float(packed);
+  }
+  return result;
+}
+
+double decodeInt32(const int8_t *value) {
+  int32_t result = 0;
+  memcpy(&result, value, sizeof(result));
+  return result / 1000.0;
+}
+
+}  // namespace
+
+bool ReportingPolicyConfig::operator==(
+    const ReportingPolicyConfig &other) const {
+  return deadband == other.deadband && minIntervalMs == other.minIntervalMs &&
+         maxIntervalMs == other.maxIntervalMs &&
+         deadbandType == other.deadbandType && coalescing == other.coalescing;
+}
+
+bool ReportingPolicyConfig::operator!=(
+    const ReportingPolicyConfig &other) const {
+  return !(*this == other);
+}
+
+bool ReportingPolicyConfig::isActive() const {
+  return (deadbandType != Supla::ReportingDeadbandType::None &&
+          deadband > 0) ||
+         minIntervalMs > 0 || maxIntervalMs > 0;
+}
+
+ReportingPolicy::ReportingPolicy(const ReportingPolicyConfig &config)
+    : config(config) {
+}
+
+void ReportingPolicy::setConfig(const ReportingPolicyConfig &config) {
+  this->config = config;
+}
+
+const ReportingPolicyConfig &ReportingPolicy::getConfig() const {
+  return config;
+}
+
+bool ReportingPolicy::onValueChanged(ChannelType type,
+                                     const int8_t *newValue,
+                                     bool valuePending,
+                                     uint32_t nowMs) {
+  if (valueSent && isWithinDeadband(type, newValue)) {
+    // net change since last send is too small, so pending value (if any) is
+    // dropped as well
+    suppressedCount++;
+    return false;
+  }
+
+  if (valueSent && config.minIntervalMs > 0 &&
+      nowMs - lastSentMs < config.minIntervalMs && !config.coalescing) {
+    suppressedCount++;
+    return false;
+  }
+
+  if (valuePending) {
+    // previous value was not sent and is replaced by the new one
+    suppressedCount++;
+  }
+  return true;
+}
+
+bool ReportingPolicy::isSendAllowed(bool valuePending, uint32_t nowMs) const {
+  if (!valueSent) {
+    return valuePending;
+  }
+  uint32_t sinceLastSend = nowMs - lastSentMs;
+  if (valuePending) {
+    return sinceLastSend >= config.minIntervalMs;
+  }
+  return config.maxIntervalMs > 0 && sinceLastSend >= config.maxIntervalMs;
+}
+
+void ReportingPolicy::onValueSent(const int8_t *value,
+                                  uint32_t nowMs,
+                                  bool countAsSent) {
+  memcpy(lastSentValue, value, sizeof(lastSentValue));
+  lastSentMs = nowMs;
+  valueSent = true;
+  if (countAsSent) {
+    sentCount++;
+  }
+}
+
+uint32_t ReportingPolicy::getSentCount() const {
+  return sentCount;
+}
+
+uint32_t ReportingPolicy::getSuppressedCount() const {
+  return suppressedCount;
+}
+
+void ReportingPolicy::resetCounters() {
+  sentCount = 0;
+  suppressedCount = 0;
+}
+
+bool ReportingPolicy::isWithinDeadband(ChannelType type,
+                                       const int8_t *newValue) const {
+  if (config.deadbandType == Supla::ReportingDeadbandType::None ||
+      config.deadband == 0) {
+    return false;
+  }
+
+  switch (type) {
+    case ChannelType::THERMOMETER:
+    case ChannelType::DISTANCESENSOR:
+    case ChannelType::WINDSENSOR:
+    case ChannelType::PRESSURESENSOR:
+    case ChannelType::RAINSENSOR:
+    case ChannelType::WEIGHTSENSOR:
+    case ChannelType::GENERAL_PURPOSE_MEASUREMENT:
+    case ChannelType::GENERAL_PURPOSE_METER: {
+      return isWithinDeadband(decodeDouble(lastSentValue),
+                              decodeDouble(newValue));
+    }
+    case ChannelType::HUMIDITYSENSOR:
+    case ChannelType::HUMIDITYANDTEMPSENSOR: {
+      return isWithinDeadband(decodeInt32(lastSentValue),
+                              decodeInt32(newValue)) &&
+             isWithinDeadband(decodeInt32(lastSentValue + 4),
+                              decodeInt32(newValue + 4));
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+bool ReportingPolicy::isWithinDeadband(double lastValue,
+                                       double newValue) const {
+  if (isnan(lastValue) || isnan(newValue)) {
+    return isnan(lastValue) && isnan(newValue);
+  }
+  double threshold = config.deadband / 1000.0;
+  if (config.deadbandType == Supla::ReportingDeadbandType::Relative) {
+    threshold = fabs(lastValue) * threshold / 100.0;
+  }
+  return fabs(newValue - lastValue) < threshold;
+}
+
+bool ReportingPolicy::LoadConfig(int channelNumber,
+                                 ReportingPolicyConfig *config) {
+  auto cfg = Supla::Storage::ConfigInstance();
+  if (cfg == nullptr || config == nullptr || channelNumber < 0) {
+    return false;
+  }
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  Supla::Config::generateKey(
+      key, channelNumber, Supla::ConfigTag::ReportingPolicyCfgTag);
+  ReportingPolicyConfig stored;
+  if (!cfg->getBlob(
+          key, reinterpret_cast<char *>(&stored), sizeof(stored))) {
+    return false;
+  }
+  *config = stored;
+  return true;
+}
+
+bool ReportingPolicy::SaveConfig(int channelNumber,
+                                 const ReportingPolicyConfig &config) {
+  auto cfg = Supla::Storage::ConfigInstance();
+  if (cfg == nullptr || channelNumber < 0) {
+    return false;
+  }
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  Supla::Config::generateKey(
+      key, channelNumber, Supla::ConfigTag::ReportingPolicyCfgTag);
+  return cfg->setBlob(
+      key, reinterpret_cast<const char *>(&config), sizeof(config));
+}
+
+void ReportingPolicy::EraseConfig(int channelNumber) {
+  auto cfg = Supla::Storage::ConfigInstance();
+  if (cfg == nullptr || channelNumber < 0) {
+    return;
+  }
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  Supla::Config::generateKey(
+      key, channelNumber, Supla::ConfigTag::ReportingPolicyCfgTag);
+  cfg->eraseKey(key);
+}
@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_CHANNELS_REPORTING_POLICY_H_
+#define SRC_SUPLA_CHANNELS_REPORTING_POLICY_H_
+
+#include <stdint.h>
+
+#include <supla-common/proto.h>
+
+#include "channel_types.h"
+
+namespace Supla {
+
+enum class ReportingDeadbandType : uint8_t {
+  None = 0,
+  // deadband is given in 0.001 of channel unit
+  Absolute = 1,
+  // deadband is given in 0.001 % of last sent value
+  Relative = 2,
+};
+
+#pragma pack(push, 1)
+struct ReportingPolicyConfig {
+  uint32_t deadband = 0;
+  // minimum time between two value updates (0 - disabled)
+  uint32_t minIntervalMs = 0;
+  // value is sent again after this time even if it didn't change
+  // (0 - disabled)
+  uint32_t maxIntervalMs = 0;
+  ReportingDeadbandType deadbandType = ReportingDeadbandType::None;
+  // 1 - changes done within min interval are sent (latest value) when the
+  // interval ends, 0 - they are dropped
+  uint8_t coalescing = 1;
+
+  bool operator==(const ReportingPolicyConfig &other) const;
+  bool operator!=(const ReportingPolicyConfig &other) const;
+  // Returns false when all options are disabled
+  bool isActive() const;
+};
+#pragma pack(pop)
+
+/**
+ * Decides when channel value is sent to protocol layers.
+ *
+ * Without a policy, channel sends every value which differs in any byte.
+ * Policy adds deadband (applied only to channels with numeric value:
+ * thermometers, humidity, GPM and other double based sensors), minimum and
+ * maximum (heartbeat) interval between updates and coalescing of changes
+ * done within minimum interval. Deadband is checked against the last sent
+ * value, so slow drift is still reported.
+ */
+class ReportingPolicy {
+ public:
+  explicit ReportingPolicy(const ReportingPolicyConfig &config);
+
+  void setConfig(const ReportingPolicyConfig &config);
+  const ReportingPolicyConfig &getConfig() const;
+
+  // Called when channel value changed. Returns true when value should be
+  // marked as pending for send. valuePending tells if previous value is
+  // still waiting for send.
+  bool onValueChanged(ChannelType type,
+                      const int8_t *newValue,
+                      bool valuePending,
+                      uint32_t nowMs);
+  // Returns true when value should be sent now
+  bool isSendAllowed(bool valuePending, uint32_t nowMs) const;
+  // Called when value was sent (or registered). Only sent updates are counted.
+  void onValueSent(const int8_t *value, uint32_t nowMs, bool countAsSent);
+
+  uint32_t getSentCount() const;
+  uint32_t getSuppressedCount() const;
+  void resetCounters();
+
+  // Reads config stored for channel. Returns false if it is not available.
+  static bool LoadConfig(int channelNumber, ReportingPolicyConfig *config);
+  static bool SaveConfig(int channelNumber,
+                         const ReportingPolicyConfig &config);
+  static void EraseConfig(int channelNumber);
+
+ protected:
+  bool isWithinDeadband(ChannelType type, const int8_t *newValue) const;
+  bool isWithinDeadband(double lastValue, double newValue) const;
+
+  ReportingPolicyConfig config;
+  int8_t lastSentValue[SUPLA_CHANNELVALUE_SIZE] = {};
+  uint32_t lastSentMs = 0;
+  uint32_t sentCount = 0;
+  uint32_t suppressedCount = 0;
+  bool valueSent = false;
+};
+
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_CHANNELS_REPORTING_POLICY_H_
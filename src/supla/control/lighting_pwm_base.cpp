@@ -64,9 +64,17 @@ GeometricBrightnessAdjuster::GeometricBrightnessAdjuster(double power,
                                                          int offset,
                                                          int maxHwValue)
     : power(power), offset(offset), maxHwValue(maxHwValue) {
+  rebuildCurve();
 }
 
 int GeometricBrightnessAdjuster::adjustBrightness(int input) {
+  if (input >= 0 && input <= 100) {
+    return curve[input];
+  }
+  return calculateBrightness(input);
+}
+
+int GeometricBrightnessAdjuster::calculateBrightness(int input) const {
   if (input == 0) {
     return 0;
   }
@@ -82,8 +90,18 @@ int GeometricBrightnessAdjuster::adjustBrightness(int input) {
   return round(result);
 }
 
+void GeometricBrightnessAdjuster::rebuildCurve() {
+  for (int i = 0; i <= 100; i++) {
+    curve[i] = calculateBrightness(i);
+  }
+}
+
 void GeometricBrightnessAdjuster::setMaxHwValue(int maxHwValue) {
+  if (this->maxHwValue == maxHwValue) {
+    return;
+  }
   this->maxHwValue = maxHwValue;
+  rebuildCurve();
 }
 
 LightingPwmBase::LightingPwmBase(LightingPwmBase *parent) : parent(parent) {
@@ -752,17 +770,18 @@ bool LightingPwmBase::calculateAndUpdate(int targetValue,
     return false;
   }
 
-  int currentFadeEffectTime = fadeEffect;
+  uint32_t currentFadeEffectTime = fadeEffect;
   if (distance < maxHwValue / 10) {
     currentFadeEffectTime = fadeEffect / 3;
   }
 
-  float divider = 1.0 * currentFadeEffectTime / timeDiff;
-  if (divider <= 1) {
-    divider = 1;
+  // step = distance * timeDiff / fadeTime, limited to distance. Distance is
+  // at most UINT16_MAX and timeDiff is lower than fade time here, so product
+  // fits in 32 bits.
+  uint32_t step = distance;
+  if (currentFadeEffectTime > timeDiff) {
+    step = static_cast<uint32_t>(distance) * timeDiff / currentFadeEffectTime;
   }
-
-  int step = distance / divider;
   if (step < 1) {
     return false;
   }
@@ -777,6 +796,22 @@ bool LightingPwmBase::calculateAndUpdate(int targetValue,
   return true;
 }
 
+bool LightingPwmBase::updateFade(const FadeChannel *channels,
+                                 int count,
+                                 const uint32_t now) const {
+  bool valueChanged = false;
+  for (int i = 0; i < count; i++) {
+    if (calculateAndUpdate(channels[i].target,
+                           channels[i].hwValue,
+                           channels[i].distance,
+                           channels[i].lastChangeMs,
+                           now)) {
+      valueChanged = true;
+    }
+  }
+  return valueChanged;
+}
+
 void LightingPwmBase::onFastTimer() {
   if (!enabled) {
     return;
@@ -905,53 +940,42 @@ void LightingPwmBase::onFastTimer() {
     valueChanged = true;
     instant = false;
   } else {
+    FadeChannel fadeChannels[6] = {};
+    int fadeChannelCount = 0;
     if (useRGB) {
-      if (calculateAndUpdate(targetRed,
-                             &hardware.red,
-                             hardware.redDistance,
-                             &timing.lastChangeRedMs,
-                             now)) {
-        valueChanged = true;
-      }
-      if (calculateAndUpdate(targetGreen,
-                             &hardware.green,
-                             hardware.greenDistance,
-                             &timing.lastChangeGreenMs,
-                             now)) {
-        valueChanged = true;
-      }
-      if (calculateAndUpdate(targetBlue,
-                             &hardware.blue,
-                             hardware.blueDistance,
-                             &timing.lastChangeBlueMs,
-                             now)) {
-        valueChanged = true;
-      }
-      if (calculateAndUpdate(targetColorBrightness,
-                             &hardware.colorBrightness,
-                             hardware.colorBrightnessDistance,
-                             &timing.lastChangeColorBrightnessMs,
-                             now)) {
-        valueChanged = true;
-      }
+      fadeChannels[fadeChannelCount++] = {targetRed,
+                                          &hardware.red,
+                                          hardware.redDistance,
+                                          &timing.lastChangeRedMs};
+      fadeChannels[fadeChannelCount++] = {targetGreen,
+                                          &hardware.green,
+                                          hardware.greenDistance,
+                                          &timing.lastChangeGreenMs};
+      fadeChannels[fadeChannelCount++] = {targetBlue,
+                                          &hardware.blue,
+                                          hardware.blueDistance,
+                                          &timing.lastChangeBlueMs};
+      fadeChannels[fadeChannelCount++] = {
+          targetColorBrightness,
+          &hardware.colorBrightness,
+          hardware.colorBrightnessDistance,
+          &timing.lastChangeColorBrightnessMs};
     }
     if (useDimmer) {
-      if (calculateAndUpdate(targetBrightness,
-                             &hardware.brightness,
-                             hardware.brightnessDistance,
-                             &timing.lastChangeBrightnessMs,
-                             now)) {
-        valueChanged = true;
-      }
+      fadeChannels[fadeChannelCount++] = {targetBrightness,
+                                          &hardware.brightness,
+                                          hardware.brightnessDistance,
+                                          &timing.lastChangeBrightnessMs};
     }
     if (useCCT) {
-      if (calculateAndUpdate(targetWhiteTemperature,
-                             &hardware.whiteTemperature,
-                             hardware.whiteTemperatureDistance,
-                             &timing.lastChangeWhiteTemperatureMs,
-                             now)) {
-        valueChanged = true;
-      }
+      fadeChannels[fadeChannelCount++] = {
+          targetWhiteTemperature,
+          &hardware.whiteTemperature,
+          hardware.whiteTemperatureDistance,
+          &timing.lastChangeWhiteTemperatureMs};
+    }
+    if (updateFade(fadeChannels, fadeChannelCount, now)) {
+      valueChanged = true;
     }
   }
 
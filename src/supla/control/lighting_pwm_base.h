@@ -29,6 +29,9 @@ class BrightnessAdjuster {
   virtual void setMaxHwValue(int maxHwValue) = 0;
 };
 
+// Adjusted values for inputs 0..100 are precomputed in a table, so pow() is
+// called only when the table is rebuilt (on construction and on
+// setMaxHwValue()).
 class GeometricBrightnessAdjuster : public BrightnessAdjuster {
  public:
   explicit GeometricBrightnessAdjuster(double power = 1.505,
@@ -38,9 +41,13 @@ class GeometricBrightnessAdjuster : public BrightnessAdjuster {
   int adjustBrightness(int input) override;
 
  private:
+  int calculateBrightness(int input) const;
+  void rebuildCurve();
+
   double power = 1.505;
   int offset = 0;
   int maxHwValue = 1023;
+  uint16_t curve[101] = {};
 };
 
 class Button;
@@ -289,12 +296,26 @@ class LightingPwmBase : public ChannelElement, public ActionHandler {
   // Returns value in range 0-1023 adjusted by selected function.
   int adjustBrightness(int value);
 
+  // One faded output: current hw value moves towards target by
+  // distance * elapsed / fade time per tick.
+  struct FadeChannel {
+    int target;
+    int16_t *hwValue;
+    uint16_t distance;
+    uint32_t *lastChangeMs;
+  };
+
   int getStep(int step, int target, int current) const;
   bool calculateAndUpdate(int targetValue,
                           int16_t *hwValue,
                           int distance,
                           uint32_t *lastChangeMs,
                           const uint32_t now) const;
+  // Updates all given channels in one pass. Returns true if any hw value
+  // changed.
+  bool updateFade(const FadeChannel *channels,
+                  int count,
+                  const uint32_t now) const;
 
   struct RequestedState {
     uint8_t red = 0;               // 0 - 255
@@ -0,0 +1,751 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+// Not supported on Arduino Mega (no <atomic>)
+#ifndef ARDUINO_ARCH_AVR
+
+#include "async_log.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <supla/log_wrapper.h>
+
+namespace {
+
+std::atomic<Supla::Debug::AsyncLog *> asyncLogInstance(nullptr);
+
+enum class ArgType : uint8_t {
+  None,
+  Signed,
+  Unsigned,
+  Double,
+  LongDouble,
+  Pointer,
+  String,
+  Char,
+  Store,
+};
+
+enum class LengthModifier : uint8_t {
+  None,
+  Hh,
+  H,
+  L,
+  Ll,
+  J,
+  Z,
+  T,
+  BigL,
+};
+
+struct ConversionSpec {
+  // length of whole spec, including '%'
+  int length = 0;
+  // length of flags, width and precision part (after '%')
+  int prefixLength = 0;
+  int stars = 0;
+  // literal precision, -1 when not given
+  int precision = -1;
+  // precision is passed as the last '*' argument
+  bool precisionStar = false;
+  LengthModifier modifier = LengthModifier::None;
+  char conversion = 0;
+  ArgType type = ArgType::None;
+};
+
+// Parses printf conversion spec starting at '%'
+ConversionSpec parseSpec(const char *spec) {
+  ConversionSpec result;
+  const char *ptr = spec + 1;
+  while (*ptr == '-' || *ptr == '+' || *ptr == ' ' || *ptr == '#' ||
+         *ptr == '0') {
+    ptr++;
+  }
+  if (*ptr == '*') {
+    result.stars++;
+    ptr++;
+  } else {
+    while (*ptr >= '0' && *ptr <= '9') {
+      ptr++;
+    }
+  }
+  if (*ptr == '.') {
+    ptr++;
+    if (*ptr == '*') {
+      result.stars++;
+      result.precisionStar = true;
+      ptr++;
+    } else {
+      result.precision = 0;
+      while (*ptr >= '0' && *ptr <= '9') {
+        if (result.precision < 10000) {
+          result.precision = result.precision * 10 + (*ptr - '0');
+        }
+        ptr++;
+      }
+    }
+  }
+  result.prefixLength = static_cast<int>(ptr - spec - 1);
+
+  switch (*ptr) {
+    case 'h':
+      ptr++;
+      result.modifier = LengthModifier::H;
+      if (*ptr == 'h') {
+        ptr++;
+        result.modifier = LengthModifier::Hh;
+      }
+      break;
+    case 'l':
+      ptr++;
+      result.modifier = LengthModifier::L;
+      if (*ptr == 'l') {
+        ptr++;
+        result.modifier = LengthModifier::Ll;
+      }
+      break;
+    case 'j':
+      ptr++;
+      result.modifier = LengthModifier::J;
+      break;
+    case 'z':
+      ptr++;
+      result.modifier = LengthModifier::Z;
+      break;
+    case 't':
+      ptr++;
+      result.modifier = LengthModifier::T;
+      break;
+    case 'L':
+      ptr++;
+      result.modifier = LengthModifier::BigL;
+      break;
+  }
+
+  result.conversion = *ptr;
+  switch (*ptr) {
+    case 'd':
+    case 'i':
+      result.type = ArgType::Signed;
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      result.type = ArgType::Unsigned;
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      result.type = result.modifier == LengthModifier::BigL
+                        ? ArgType::LongDouble
+                        : ArgType::Double;
+      break;
+    case 'c':
+      result.type = ArgType::Char;
+      break;
+    case 's':
+      result.type = ArgType::String;
+      break;
+    case 'p':
+      result.type = ArgType::Pointer;
+      break;
+    case 'n':
+      result.type = ArgType::Store;
+      break;
+    case '\0':
+      // incomplete spec at the end of format
+      result.length = static_cast<int>(ptr - spec);
+      return result;
+    default:
+      // unknown conversion (or "%%") - printed as it is, no argument
+      break;
+  }
+  result.length = static_cast<int>(ptr - spec + 1);
+  return result;
+}
+
+class ArgWriter {
+ public:
+  explicit ArgWriter(Supla::Debug::AsyncLogRecord *record) : record(record) {
+  }
+
+  template <typename T>
+  bool put(T value) {
+    if (offset + sizeof(T) > sizeof(record->args)) {
+      return false;
+    }
+    memcpy(record->args + offset, &value, sizeof(T));
+    offset += sizeof(T);
+    return true;
+  }
+
+  // maxLength limits number of read characters (printf precision), so
+  // value doesn't have to be NUL terminated. -1 means no limit.
+  bool putString(const char *value, int maxLength = -1) {
+    if (value == nullptr) {
+      value = "(null)";
+    }
+    if (offset >= sizeof(record->args)) {
+      return false;
+    }
+    size_t available = sizeof(record->args) - offset;
+    size_t length = 0;
+    if (maxLength >= 0 && static_cast<size_t>(maxLength) < available) {
+      length = strnlen(value, maxLength);
+    } else {
+      length = strnlen(value, available);
+    }
+    if (length >= available) {
+      // store truncated string, but report it as not complete
+      memcpy(record->args + offset, value, available - 1);
+      record->args[sizeof(record->args) - 1] = '\0';
+      offset = sizeof(record->args);
+      return false;
+    }
+    memcpy(record->args + offset, value, length);
+    record->args[offset + length] = '\0';
+    offset += length + 1;
+    return true;
+  }
+
+ private:
+  Supla::Debug::AsyncLogRecord *record = nullptr;
+  size_t offset = 0;
+};
+
+class ArgReader {
+ public:
+  explicit ArgReader(const Supla::Debug::AsyncLogRecord &record)
+      : record(record) {
+  }
+
+  template <typename T>
+  T get() {
+    T value = {};
+    if (offset + sizeof(T) <= sizeof(record.args)) {
+      memcpy(&value, record.args + offset, sizeof(T));
+      offset += sizeof(T);
+    }
+    return value;
+  }
+
+  const char *getString() {
+    if (offset >= sizeof(record.args)) {
+      return "";
+    }
+    const char *value = reinterpret_cast<const char *>(record.args + offset);
+    offset += strnlen(value, sizeof(record.args) - offset) + 1;
+    return value;
+  }
+
+ private:
+  const Supla::Debug::AsyncLogRecord &record;
+  size_t offset = 0;
+};
+
+// Integer arguments are stored on 8 bytes only when they may not fit in 4
+bool isWide(LengthModifier modifier) {
+  switch (modifier) {
+    case LengthModifier::L:
+    case LengthModifier::Ll:
+    case LengthModifier::J:
+    case LengthModifier::Z:
+    case LengthModifier::T:
+      return sizeof(long) > 4 || modifier != LengthModifier::L;  // NOLINT
+    default:
+      return false;
+  }
+}
+
+int64_t readSigned(LengthModifier modifier, va_list *args) {
+  switch (modifier) {
+    case LengthModifier::Hh:
+      return static_cast<signed char>(va_arg(*args, int));
+    case LengthModifier::H:
+      return static_cast<int16_t>(va_arg(*args, int));
+    case LengthModifier::L:
+      return va_arg(*args, long);  // NOLINT(runtime/int)
+    case LengthModifier::Ll:
+      return va_arg(*args, long long);  // NOLINT(runtime/int)
+    case LengthModifier::J:
+      return va_arg(*args, intmax_t);
+    case LengthModifier::Z:
+      return static_cast<int64_t>(va_arg(*args, size_t));
+    case LengthModifier::T:
+      return va_arg(*args, ptrdiff_t);
+    default:
+      return va_arg(*args, int);
+  }
+}
+
+uint64_t readUnsigned(LengthModifier modifier, va_list *args) {
+  switch (modifier) {
+    case LengthModifier::Hh:
+      return static_cast<unsigned char>(va_arg(*args, unsigned int));
+    case LengthModifier::H:
+      return static_cast<uint16_t>(va_arg(*args, unsigned int));
+    case LengthModifier::L:
+      return va_arg(*args, unsigned long);  // NOLINT(runtime/int)
+    case LengthModifier::Ll:
+      return va_arg(*args, unsigned long long);  // NOLINT(runtime/int)
+    case LengthModifier::J:
+      return va_arg(*args, uintmax_t);
+    case LengthModifier::Z:
+      return va_arg(*args, size_t);
+    case LengthModifier::T:
+      return static_cast<uint64_t>(va_arg(*args, ptrdiff_t));
+    default:
+      return va_arg(*args, unsigned int);
+  }
+}
+
+class LineWriter {
+ public:
+  LineWriter(char *buffer, int size) : buffer(buffer), size(size) {
+    if (size > 0) {
+      buffer[0] = '\0';
+    }
+  }
+
+  void append(const char *text, int length) {
+    if (length <= 0 || size <= 0) {
+      return;
+    }
+    int available = size - 1 - used;
+    if (length > available) {
+      length = available;
+    }
+    if (length > 0) {
+      memcpy(buffer + used, text, length);
+      used += length;
+      buffer[used] = '\0';
+    }
+  }
+
+  // Formats single conversion. "spec" is rebuilt printf spec for a single
+  // argument, optionally preceded by star arguments.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  template <typename T>
+  void appendFormatted(const char *spec, const int *stars, int starsCount,
+                       T value) {
+    if (size <= 0) {
+      return;
+    }
+    int available = size - used;
+    int written = 0;
+    switch (starsCount) {
+      case 0:
+        written = snprintf(buffer + used, available, spec, value);
+        break;
+      case 1:
+        written = snprintf(buffer + used, available, spec, stars[0], value);
+        break;
+      default:
+        written = snprintf(
+            buffer + used, available, spec, stars[0], stars[1], value);
+        break;
+    }
+    if (written < 0) {
+      return;
+    }
+    used += written >= available ? available - 1 : written;
+  }
+#pragma GCC diagnostic pop
+
+  int length() const {
+    return used;
+  }
+
+ private:
+  char *buffer = nullptr;
+  int size = 0;
+  int used = 0;
+};
+
+}  // namespace
+
+namespace Supla {
+namespace Debug {
+
+AsyncLog::AsyncLog(Output output, uint32_t capacity)
+    : output(output), enqueuePos(0), dequeuePos(0), droppedCount(0) {
+  uint32_t size = 2;
+  while (size < capacity && size < 0x80000000u) {
+    size <<= 1;
+  }
+  cells = new Cell[size];
+  mask = size - 1;
+  for (uint32_t i = 0; i < size; i++) {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  registerInstance();
+}
+
+AsyncLog::~AsyncLog() {
+  unregisterInstance();
+  delete[] cells;
+  cells = nullptr;
+}
+
+void AsyncLog::registerInstance() {
+  asyncLogInstance = this;
+}
+
+void AsyncLog::unregisterInstance() {
+  AsyncLog *expected = this;
+  asyncLogInstance.compare_exchange_strong(expected, nullptr);
+}
+
+AsyncLog *AsyncLog::Instance() {
+  return asyncLogInstance;
+}
+
+bool AsyncLog::log(int priority, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool result = vlog(priority, format, args);
+  va_end(args);
+  return result;
+}
+
+bool AsyncLog::vlog(int priority, const char *format, va_list args) {
+  AsyncLogRecord record;
+  if (!pack(&record, priority, format, args)) {
+    return false;
+  }
+
+  uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+  Cell *cell = nullptr;
+  while (true) {
+    cell = &cells[pos & mask];
+    uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+    int32_t diff = static_cast<int32_t>(sequence - pos);
+    if (diff == 0) {
+      if (enqueuePos.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->record = record;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+int AsyncLog::drain(int maxRecords) {
+  char line[SUPLA_ASYNC_LOG_LINE_SIZE] = {};
+  int processed = 0;
+
+  uint32_t dropped = droppedCount.load(std::memory_order_relaxed);
+  if (dropped != reportedDroppedCount) {
+    snprintf(line,
+             sizeof(line),
+             "AsyncLog: %u log messages dropped",
+             static_cast<unsigned>(dropped - reportedDroppedCount));
+    reportedDroppedCount = dropped;
+    if (output) {
+      output(LOG_WARNING, line);
+    }
+  }
+
+  while (maxRecords <= 0 || processed < maxRecords) {
+    uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell *cell = &cells[pos & mask];
+    uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (static_cast<int32_t>(sequence - (pos + 1)) < 0) {
+      break;
+    }
+    AsyncLogRecord record = cell->record;
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+
+    format(record, line, sizeof(line));
+    if (output) {
+      output(record.priority, line);
+    }
+    writtenCount++;
+    processed++;
+  }
+  return processed;
+}
+
+bool AsyncLog::isEmpty() const {
+  uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+  uint32_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+  return sequence != pos + 1;
+}
+
+uint32_t AsyncLog::getCapacity() const {
+  return mask + 1;
+}
+
+uint32_t AsyncLog::getDroppedCount() const {
+  return droppedCount.load(std::memory_order_relaxed);
+}
+
+uint32_t AsyncLog::getWrittenCount() const {
+  return writtenCount;
+}
+
+bool AsyncLog::pack(AsyncLogRecord *record,
+                    int priority,
+                    const char *format,
+                    va_list args) {
+  if (record == nullptr || format == nullptr) {
+    return false;
+  }
+  record->priority = static_cast<int8_t>(priority);
+  record->format = format;
+  record->packedConversions = 0;
+  record->truncated = false;
+
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+  ArgWriter writer(record);
+  const char *ptr = format;
+  while (*ptr != '\0') {
+    if (*ptr != '%') {
+      ptr++;
+      continue;
+    }
+    ConversionSpec spec = parseSpec(ptr);
+    if (spec.type == ArgType::None) {
+      ptr += spec.length > 0 ? spec.length : 1;
+      continue;
+    }
+
+    bool ok = true;
+    int precision = spec.precision;
+    for (int i = 0; i < spec.stars && ok; i++) {
+      int star = va_arg(argsCopy, int);
+      if (spec.precisionStar && i == spec.stars - 1) {
+        // negative precision is treated by printf as if it was omitted
+        precision = star < 0 ? -1 : star;
+      }
+      ok = writer.put<int32_t>(star);
+    }
+    if (ok) {
+      switch (spec.type) {
+        case ArgType::Signed:
+          if (isWide(spec.modifier)) {
+            ok = writer.put<int64_t>(readSigned(spec.modifier, &argsCopy));
+          } else {
+            ok = writer.put<int32_t>(static_cast<int32_t>(
+                readSigned(spec.modifier, &argsCopy)));
+          }
+          break;
+        case ArgType::Unsigned:
+          if (isWide(spec.modifier)) {
+            ok = writer.put<uint64_t>(readUnsigned(spec.modifier, &argsCopy));
+          } else {
+            ok = writer.put<uint32_t>(static_cast<uint32_t>(
+                readUnsigned(spec.modifier, &argsCopy)));
+          }
+          break;
+        case ArgType::Double:
+          ok = writer.put<double>(va_arg(argsCopy, double));
+          break;
+        case ArgType::LongDouble:
+          ok = writer.put<double>(
+              static_cast<double>(va_arg(argsCopy, long double)));
+          break;
+        case ArgType::Char:
+          ok = writer.put<int32_t>(va_arg(argsCopy, int));
+          break;
+        case ArgType::Pointer:
+          ok = writer.put<uint64_t>(
+              reinterpret_cast<uintptr_t>(va_arg(argsCopy, void *)));
+          break;
+        case ArgType::String:
+          if (spec.modifier == LengthModifier::L) {
+            // wide strings are not supported
+            va_arg(argsCopy, void *);
+            ok = writer.putString("?");
+          } else {
+            ok = writer.putString(va_arg(argsCopy, const char *), precision);
+          }
+          break;
+        case ArgType::Store:
+          va_arg(argsCopy, void *);
+          break;
+        case ArgType::None:
+          break;
+      }
+    }
+    if (!ok) {
+      record->truncated = true;
+      // truncated string is still printed
+      if (spec.type == ArgType::String) {
+        record->packedConversions++;
+      }
+      break;
+    }
+    record->packedConversions++;
+    ptr += spec.length;
+  }
+  va_end(argsCopy);
+  return true;
+}
+
+int AsyncLog::format(const AsyncLogRecord &record, char *buffer, int size) {
+  LineWriter out(buffer, size);
+  if (record.format == nullptr) {
+    return 0;
+  }
+
+  ArgReader reader(record);
+  int conversions = 0;
+  const char *ptr = record.format;
+  while (*ptr != '\0') {
+    const char *percent = strchr(ptr, '%');
+    if (percent == nullptr) {
+      out.append(ptr, static_cast<int>(strlen(ptr)));
+      break;
+    }
+    out.append(ptr, static_cast<int>(percent - ptr));
+    ConversionSpec spec = parseSpec(percent);
+    if (spec.length == 0) {
+      break;
+    }
+    if (spec.type == ArgType::None) {
+      if (spec.conversion == '%') {
+        out.append("%", 1);
+      } else {
+        out.append(percent, spec.length);
+      }
+      ptr = percent + spec.length;
+      continue;
+    }
+    if (conversions >= record.packedConversions) {
+      break;
+    }
+    conversions++;
+
+    // rebuild spec: '%' + flags/width/precision + normalized modifier + conv
+    char specBuffer[32] = {};
+    int prefixLength = spec.prefixLength;
+    if (prefixLength > static_cast<int>(sizeof(specBuffer)) - 5) {
+      prefixLength = static_cast<int>(sizeof(specBuffer)) - 5;
+    }
+    specBuffer[0] = '%';
+    memcpy(specBuffer + 1, percent + 1, prefixLength);
+    int specLength = 1 + prefixLength;
+    if (spec.type == ArgType::Signed || spec.type == ArgType::Unsigned) {
+      specBuffer[specLength++] = 'l';
+      specBuffer[specLength++] = 'l';
+    }
+    specBuffer[specLength++] = spec.conversion;
+    specBuffer[specLength] = '\0';
+
+    int stars[2] = {};
+    for (int i = 0; i < spec.stars; i++) {
+      stars[i] = reader.get<int32_t>();
+    }
+
+    switch (spec.type) {
+      case ArgType::Signed: {
+        int64_t value = isWide(spec.modifier) ? reader.get<int64_t>()
+                                              : reader.get<int32_t>();
+        out.appendFormatted(specBuffer, stars, spec.stars,
+                            static_cast<long long>(value));  // NOLINT
+        break;
+      }
+      case ArgType::Unsigned: {
+        uint64_t value = isWide(spec.modifier) ? reader.get<uint64_t>()
+                                               : reader.get<uint32_t>();
+        out.appendFormatted(specBuffer, stars, spec.stars,
+                            static_cast<unsigned long long>(value));  // NOLINT
+        break;
+      }
+      case ArgType::Double:
+      case ArgType::LongDouble:
+        out.appendFormatted(
+            specBuffer, stars, spec.stars, reader.get<double>());
+        break;
+      case ArgType::Char:
+        out.appendFormatted(
+            specBuffer, stars, spec.stars,
+            static_cast<int>(reader.get<int32_t>()));
+        break;
+      case ArgType::Pointer:
+        out.appendFormatted(
+            specBuffer, stars, spec.stars,
+            reinterpret_cast<void *>(
+                static_cast<uintptr_t>(reader.get<uint64_t>())));
+        break;
+      case ArgType::String:
+        out.appendFormatted(
+            specBuffer, stars, spec.stars, reader.getString());
+        break;
+      case ArgType::Store:
+      case ArgType::None:
+        break;
+    }
+    ptr = percent + spec.length;
+  }
+
+  if (record.truncated) {
+    out.append("...", 3);
+  }
+  return out.length();
+}
+
+}  // namespace Debug
+}  // namespace Supla
+
+extern "C" void supla_async_logf(int priority, const char *format, ...) {
+  if (format == nullptr || !supla_log_is_enabled(priority)) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, format);
+  auto asyncLog = Supla::Debug::AsyncLog::Instance();
+  if (asyncLog) {
+    asyncLog->vlog(priority, format, args);
+    va_end(args);
+    return;
+  }
+
+  // Without worker line is written synchronously and isn't limited by
+  // SUPLA_ASYNC_LOG_LINE_SIZE: longer lines are formatted on the heap, like
+  // in supla_log
+  char line[SUPLA_ASYNC_LOG_LINE_SIZE] = {};
+  char *buffer = line;
+  va_list sizeArgs;
+  va_copy(sizeArgs, args);
+  int length = vsnprintf(line, sizeof(line), format, sizeArgs);  // NOLINT
+  va_end(sizeArgs);
+  if (length >= static_cast<int>(sizeof(line))) {
+    buffer = new char[length + 1];
+    vsnprintf(buffer, length + 1, format, args);  // NOLINT
+  }
+  va_end(args);
+  if (length >= 0) {
+#ifdef SUPLA_DEVICE_ESP32
+    supla_device_log_write(priority, buffer);
+#else
+    supla_log(priority, "%s", buffer);
+#endif
+  }
+  if (buffer != line) {
+    delete[] buffer;
+  }
+}
+
+#endif  // ARDUINO_ARCH_AVR
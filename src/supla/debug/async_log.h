@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_DEBUG_ASYNC_LOG_H_
+#define SRC_SUPLA_DEBUG_ASYNC_LOG_H_
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Size of packed printf arguments stored in a single log record. Strings are
+// copied into this area, so long string arguments are truncated.
+#ifndef SUPLA_ASYNC_LOG_ARGS_SIZE
+#define SUPLA_ASYNC_LOG_ARGS_SIZE 96
+#endif
+
+// Number of records in the queue. Has to be a power of 2.
+#ifndef SUPLA_ASYNC_LOG_CAPACITY
+#define SUPLA_ASYNC_LOG_CAPACITY 64
+#endif
+
+// Max length of a formatted log line passed to the output
+#ifndef SUPLA_ASYNC_LOG_LINE_SIZE
+#define SUPLA_ASYNC_LOG_LINE_SIZE 256
+#endif
+
+namespace Supla {
+namespace Debug {
+
+struct AsyncLogRecord {
+  int8_t priority = 0;
+  // number of printf conversions for which arguments were packed
+  uint8_t packedConversions = 0;
+  // true when not all arguments fit into args buffer
+  bool truncated = false;
+  const char *format = nullptr;
+  uint8_t args[SUPLA_ASYNC_LOG_ARGS_SIZE] = {};
+};
+
+/**
+ * Asynchronous log backend.
+ *
+ * Producers (any thread, including timer callbacks) call log()/vlog(), which
+ * only copy the format pointer and printf arguments into a bounded lock-free
+ * MPSC queue. Formatting and writing to the output (printf, syslog, ESP_LOG,
+ * debug log sinks) is done later by a consumer calling drain(), i.e. from
+ * a low priority worker thread or from the main loop.
+ *
+ * Format string has to be a string literal (or have static storage duration),
+ * because only the pointer is stored. SUPLA_LOG_* macros fulfill this.
+ * When queue is full, record is dropped and dropped counter is incremented.
+ */
+class AsyncLog {
+ public:
+  using Output = void (*)(int priority, const char *message);
+
+  /**
+   * Constructor. Created instance becomes the global one returned by
+   * Instance().
+   *
+   * @param output function called by drain() for each formatted record
+   * @param capacity number of records in queue (rounded up to power of 2)
+   */
+  explicit AsyncLog(Output output,
+                    uint32_t capacity = SUPLA_ASYNC_LOG_CAPACITY);
+  virtual ~AsyncLog();
+
+  static AsyncLog *Instance();
+
+  // Makes this instance the global one (done by constructor) or stops
+  // routing SUPLA_LOG_* to it. Logs are written synchronously when there is
+  // no global instance.
+  void registerInstance();
+  void unregisterInstance();
+
+  /**
+   * Adds log record to the queue. Safe to call from multiple threads.
+   *
+   * @return true on success, false when record was dropped
+   */
+  bool log(int priority, const char *format, ...);
+  bool vlog(int priority, const char *format, va_list args);
+
+  /**
+   * Formats queued records and passes them to the output. Has to be called
+   * from a single consumer thread.
+   *
+   * @param maxRecords limit of records to process, 0 means no limit
+   *
+   * @return number of processed records
+   */
+  int drain(int maxRecords = 0);
+
+  bool isEmpty() const;
+  uint32_t getCapacity() const;
+  uint32_t getDroppedCount() const;
+  uint32_t getWrittenCount() const;
+
+  /**
+   * Formats record into buffer.
+   *
+   * @return length of formatted message
+   */
+  static int format(const AsyncLogRecord &record, char *buffer, int size);
+
+  /**
+   * Packs printf arguments into record. Returns false when format can't be
+   * packed (i.e. it is nullptr).
+   */
+  static bool pack(AsyncLogRecord *record,
+                   int priority,
+                   const char *format,
+                   va_list args);
+
+ protected:
+  struct Cell {
+    std::atomic<uint32_t> sequence;
+    AsyncLogRecord record;
+  };
+
+  Output output = nullptr;
+  Cell *cells = nullptr;
+  uint32_t mask = 0;
+  std::atomic<uint32_t> enqueuePos;
+  std::atomic<uint32_t> dequeuePos;
+  std::atomic<uint32_t> droppedCount;
+  uint32_t reportedDroppedCount = 0;
+  uint32_t writtenCount = 0;
+};
+
+}  // namespace Debug
+}  // namespace Supla
+
+// Used by SUPLA_LOG_* macros when SUPLA_ASYNC_LOG is defined. Falls back to
+// synchronous logging when AsyncLog instance doesn't exist.
+extern "C" void supla_async_logf(int priority, const char *format, ...);
+
+#endif  // SRC_SUPLA_DEBUG_ASYNC_LOG_H_
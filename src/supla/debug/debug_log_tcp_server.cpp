@@ -239,6 +239,7 @@ void DebugLogTcpServer::acceptClient() {
     return;
   }
   setNonBlocking(socket);
+  std::lock_guard<std::recursive_mutex> lock(clientMutex);
   if (clientSocket >= 0) {
     static const char busy[] = "{\"ok\":false,\"error\":\"busy\"}\n";
     send(socket, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
@@ -256,6 +257,7 @@ void DebugLogTcpServer::closeListenSocket() {
 }
 
 void DebugLogTcpServer::closeClient() {
+  std::lock_guard<std::recursive_mutex> lock(clientMutex);
   if (clientSocket >= 0) {
     close(clientSocket);
     clientSocket = -1;
@@ -263,6 +265,7 @@ void DebugLogTcpServer::closeClient() {
 }
 
 bool DebugLogTcpServer::writeBytes(const char *data, unsigned int size) {
+  std::lock_guard<std::recursive_mutex> lock(clientMutex);
   if (clientSocket < 0 || data == nullptr || size == 0) {
     return false;
   }
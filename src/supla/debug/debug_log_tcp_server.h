@@ -9,6 +9,10 @@
 #include <supla/debug/debug_config.h>
 #include <supla/debug/debug_log.h>
 
+#if SUPLA_INSECURE_DEBUG_INTERFACE && defined(SUPLA_LINUX)
+#include <mutex>  // NOLINT(build/c++11)
+#endif
+
 namespace Supla {
 namespace Debug {
 
@@ -29,6 +33,9 @@ class DebugLogTcpServer : public LogSink {
   uint16_t port = 7778;
 
 #if SUPLA_INSECURE_DEBUG_INTERFACE && defined(SUPLA_LINUX)
+  // Logs may be written from async log worker thread, while client is
+  // accepted and closed from the main loop
+  std::recursive_mutex clientMutex;
   int listenSocket = -1;
   int clientSocket = -1;
   bool openListenSocket();
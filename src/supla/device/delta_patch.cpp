@@ -0,0 +1,202 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "delta_patch.h"
+
+#include <string.h>
+#include <supla/log_wrapper.h>
+
+namespace {
+const char deltaPatchMagic[8] = {'S', 'U', 'P', 'L', 'A', 'D', 'P', '1'};
+}  // namespace
+
+using Supla::Device::DeltaPatch;
+
+DeltaPatch::DeltaPatch(Supla::Device::DeltaPatchSource *source,
+                       Supla::Device::DeltaPatchOutput *output,
+                       uint32_t sourceSize,
+                       const uint8_t *sourceSha256)
+    : source(source), output(output), sourceSize(sourceSize) {
+  if (sourceSha256) {
+    memcpy(this->sourceSha256, sourceSha256, sizeof(this->sourceSha256));
+  }
+}
+
+bool DeltaPatch::isComplete() const {
+  return state == State::COMPLETE;
+}
+
+bool DeltaPatch::hasError() const {
+  return state == State::FAILED;
+}
+
+const char *DeltaPatch::getError() const {
+  return error;
+}
+
+uint32_t DeltaPatch::getTargetSize() const {
+  return targetSize;
+}
+
+uint32_t DeltaPatch::getWrittenBytes() const {
+  return written;
+}
+
+uint32_t DeltaPatch::readUint32(const uint8_t *data) {
+  return static_cast<uint32_t>(data[0]) |
+         (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) |
+         (static_cast<uint32_t>(data[3]) << 24);
+}
+
+bool DeltaPatch::setError(const char *reason) {
+  if (state != State::FAILED) {
+    SUPLA_LOG_WARNING("DeltaPatch: %s", reason);
+  }
+  state = State::FAILED;
+  error = reason;
+  return false;
+}
+
+int DeltaPatch::collect(const uint8_t *data, int size, int expected) {
+  int count = expected - argsSize;
+  if (count > size) {
+    count = size;
+  }
+  memcpy(args + argsSize, data, count);
+  argsSize += count;
+  return count;
+}
+
+bool DeltaPatch::feed(const uint8_t *data, int size) {
+  while (size > 0) {
+    int consumed = 0;
+    switch (state) {
+      case State::HEADER: {
+        consumed = collect(data, size, HeaderSize);
+        if (argsSize == HeaderSize && !parseHeader()) {
+          return false;
+        }
+        break;
+      }
+      case State::OPCODE: {
+        consumed = 1;
+        argsSize = 0;
+        switch (data[0]) {
+          case OpEnd: {
+            if (written != targetSize) {
+              return setError("patch ended before end of target image");
+            }
+            state = State::COMPLETE;
+            break;
+          }
+          case OpCopy: {
+            state = State::COPY_ARGS;
+            break;
+          }
+          case OpInsert: {
+            state = State::INSERT_ARGS;
+            break;
+          }
+          default: {
+            return setError("invalid operation");
+          }
+        }
+        break;
+      }
+      case State::COPY_ARGS: {
+        consumed = collect(data, size, 8);
+        if (argsSize == 8) {
+          if (!copyFromSource(readUint32(args), readUint32(args + 4))) {
+            return false;
+          }
+          state = State::OPCODE;
+        }
+        break;
+      }
+      case State::INSERT_ARGS: {
+        consumed = collect(data, size, 4);
+        if (argsSize == 4) {
+          insertRemaining = readUint32(args);
+          if (insertRemaining > targetSize - written) {
+            return setError("insert exceeds target image");
+          }
+          state = insertRemaining ? State::INSERT_DATA : State::OPCODE;
+        }
+        break;
+      }
+      case State::INSERT_DATA: {
+        consumed = size;
+        if (static_cast<uint32_t>(consumed) > insertRemaining) {
+          consumed = insertRemaining;
+        }
+        if (!write(data, consumed)) {
+          return false;
+        }
+        insertRemaining -= consumed;
+        if (insertRemaining == 0) {
+          state = State::OPCODE;
+        }
+        break;
+      }
+      case State::COMPLETE: {
+        return setError("unexpected data after end of patch");
+      }
+      case State::FAILED: {
+        return false;
+      }
+    }
+    data += consumed;
+    size -= consumed;
+  }
+  return true;
+}
+
+bool DeltaPatch::parseHeader() {
+  if (memcmp(args, deltaPatchMagic, sizeof(deltaPatchMagic)) != 0) {
+    return setError("invalid header");
+  }
+  if (readUint32(args + 8) != sourceSize ||
+      memcmp(args + 16, sourceSha256, sizeof(sourceSha256)) != 0) {
+    return setError("patch doesn't match current image");
+  }
+  targetSize = readUint32(args + 12);
+  if (targetSize == 0) {
+    return setError("empty target image");
+  }
+  state = State::OPCODE;
+  return true;
+}
+
+bool DeltaPatch::copyFromSource(uint32_t offset, uint32_t length) {
+  if (offset > sourceSize || length > sourceSize - offset) {
+    return setError("copy outside of source image");
+  }
+  if (length > targetSize - written) {
+    return setError("copy exceeds target image");
+  }
+  uint8_t buf[SUPLA_DELTA_PATCH_COPY_BUFFER_SIZE];
+  while (length > 0) {
+    int size = sizeof(buf);
+    if (length < static_cast<uint32_t>(size)) {
+      size = length;
+    }
+    if (source == nullptr || !source->readSourceImage(offset, buf, size)) {
+      return setError("source image read failed");
+    }
+    if (!write(buf, size)) {
+      return false;
+    }
+    offset += size;
+    length -= size;
+  }
+  return true;
+}
+
+bool DeltaPatch::write(const uint8_t *data, int size) {
+  if (output == nullptr || !output->writeTargetImage(data, size)) {
+    return setError("target image write failed");
+  }
+  written += size;
+  return true;
+}
@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_DEVICE_DELTA_PATCH_H_
+#define SRC_SUPLA_DEVICE_DELTA_PATCH_H_
+
+#include <stdint.h>
+
+// size of buffer used for copying data from source image
+#ifndef SUPLA_DELTA_PATCH_COPY_BUFFER_SIZE
+#define SUPLA_DELTA_PATCH_COPY_BUFFER_SIZE 512
+#endif
+
+namespace Supla::Device {
+
+// Source image (currently running firmware) which is patched
+class DeltaPatchSource {
+ public:
+  virtual ~DeltaPatchSource() = default;
+  virtual bool readSourceImage(uint32_t offset, uint8_t *buf, int size) = 0;
+};
+
+// Receives reconstructed image in order
+class DeltaPatchOutput {
+ public:
+  virtual ~DeltaPatchOutput() = default;
+  virtual bool writeTargetImage(const uint8_t *data, int size) = 0;
+};
+
+/**
+ * Streaming applier of delta patch between two firmware images.
+ *
+ * Patch format (all integers are little endian):
+ *   header:
+ *     "SUPLADP1" magic (8 B)
+ *     source image size (uint32)
+ *     target image size (uint32)
+ *     SHA-256 of source image (32 B)
+ *   followed by operations:
+ *     0x01 COPY: source offset (uint32), length (uint32)
+ *     0x02 INSERT: length (uint32), followed by length bytes of data
+ *     0x00 END
+ *
+ * Target image is the complete signed image (app, signature and footer),
+ * so it is verified in the same way as a full download.
+ * Patch may be passed in chunks of any size. Only fixed size buffers are
+ * used, so RAM usage doesn't depend on image or patch size.
+ */
+class DeltaPatch {
+ public:
+  static constexpr int HeaderSize = 48;
+  static constexpr uint8_t OpEnd = 0x00;
+  static constexpr uint8_t OpCopy = 0x01;
+  static constexpr uint8_t OpInsert = 0x02;
+
+  // sourceSha256 - SHA-256 of source image, patch created for other image
+  // is rejected
+  DeltaPatch(DeltaPatchSource *source,
+             DeltaPatchOutput *output,
+             uint32_t sourceSize,
+             const uint8_t *sourceSha256);
+
+  // Returns false on error. Following calls are ignored then.
+  bool feed(const uint8_t *data, int size);
+
+  bool isComplete() const;
+  bool hasError() const;
+  // Returns reason of the error or nullptr
+  const char *getError() const;
+  // Target size from header (0 if header wasn't received yet)
+  uint32_t getTargetSize() const;
+  uint32_t getWrittenBytes() const;
+
+ protected:
+  enum class State : uint8_t {
+    HEADER,
+    OPCODE,
+    COPY_ARGS,
+    INSERT_ARGS,
+    INSERT_DATA,
+    COMPLETE,
+    FAILED
+  };
+
+  // Collects argument bytes. Returns number of consumed bytes.
+  int collect(const uint8_t *data, int size, int expected);
+  bool parseHeader();
+  bool copyFromSource(uint32_t offset, uint32_t length);
+  bool write(const uint8_t *data, int size);
+  bool setError(const char *reason);
+  static uint32_t readUint32(const uint8_t *data);
+
+  DeltaPatchSource *source = nullptr;
+  DeltaPatchOutput *output = nullptr;
+  uint32_t sourceSize = 0;
+  uint8_t sourceSha256[32] = {};
+
+  State state = State::HEADER;
+  const char *error = nullptr;
+  uint8_t args[HeaderSize] = {};
+  int argsSize = 0;
+  uint32_t targetSize = 0;
+  uint32_t written = 0;
+  uint32_t insertRemaining = 0;
+};
+
+}  // namespace Supla::Device
+
+#endif  // SRC_SUPLA_DEVICE_DELTA_PATCH_H_
@@ -17,6 +17,43 @@ union {
   TDS_SuplaDeviceChannel_E version_E = {};
   TDS_SuplaDeviceChannel_D version_D;
 } deviceChannelStruct;
+
+// Registration asks for channels with consecutive indexes, so position of
+// the last returned channel is kept and the next one is reached in O(1)
+// instead of walking the list from the beginning for each channel.
+Supla::Channel *cursorChannel = nullptr;
+int cursorIndex = -1;
+
+void resetChannelCursor() {
+  cursorChannel = nullptr;
+  cursorIndex = -1;
+}
+
+Supla::Channel *getChannelAtIndex(int index) {
+  if (index < 0 || index >= reg_dev.channel_count) {
+    return nullptr;
+  }
+
+  auto channel = Supla::Channel::Begin();
+  int currentIndex = 0;
+  // index 0 always starts from the beginning, so each registration is
+  // a fresh pass over the list
+  if (cursorChannel != nullptr && index > 0 && index >= cursorIndex) {
+    channel = cursorChannel;
+    currentIndex = cursorIndex;
+  }
+  for (; channel != nullptr && currentIndex < index; currentIndex++) {
+    channel = channel->next();
+  }
+
+  if (channel == nullptr) {
+    resetChannelCursor();
+    return nullptr;
+  }
+  cursorChannel = channel;
+  cursorIndex = index;
+  return channel;
+}
 }  // namespace
 
 #ifdef SUPLA_TEST
@@ -24,6 +61,7 @@ void Supla::RegisterDevice::resetToDefaults() {
   memset(&reg_dev, 0, sizeof(reg_dev));
   memset(
       &deviceChannelStruct.version_E, 0, sizeof(deviceChannelStruct.version_E));
+  resetChannelCursor();
 }
 
 int32_t Supla::RegisterDevice::getChannelType(int channelNumber) {
@@ -54,16 +92,7 @@ int32_t Supla::RegisterDevice::getChannelFunctionList(int channelNumber) {
 }
 
 int Supla::RegisterDevice::getChannelNumber(int index) {
-  if (index >= reg_dev.channel_count) {
-    return -1;
-  }
-
-  int currentIndex = 0;
-  Supla::Channel *ch = Supla::Channel::Begin();
-  for (; ch != nullptr && currentIndex < index; ch = ch->next()) {
-    currentIndex++;
-  }
-
+  auto ch = getChannelAtIndex(index);
   if (ch == nullptr) {
     return -1;
   }
@@ -108,30 +137,22 @@ TDS_SuplaRegisterDeviceHeader *Supla::RegisterDevice::getRegDevHeaderPtr() {
 }
 
 TDS_SuplaDeviceChannel_D *Supla::RegisterDevice::getChannelPtr_D(int index) {
-  if (index >= reg_dev.channel_count || index == -1) {
+  auto channel = getChannelAtIndex(index);
+  if (channel == nullptr) {
     return nullptr;
   }
 
-  auto channel = Supla::Channel::Begin();
-  for (int i = 0; i < reg_dev.channel_count && i < index && channel; i++) {
-    channel = channel->next();
-  }
-
   channel->fillDeviceChannelStruct(&deviceChannelStruct.version_D);
 
   return &deviceChannelStruct.version_D;
 }
 
 TDS_SuplaDeviceChannel_E *Supla::RegisterDevice::getChannelPtr_E(int index) {
-  if (index >= reg_dev.channel_count || index == -1) {
+  auto channel = getChannelAtIndex(index);
+  if (channel == nullptr) {
     return nullptr;
   }
 
-  auto channel = Supla::Channel::Begin();
-  for (int i = 0; i < reg_dev.channel_count && i < index && channel; i++) {
-    channel = channel->next();
-  }
-
   channel->fillDeviceChannelStruct(&deviceChannelStruct.version_E);
 
   return &deviceChannelStruct.version_E;
@@ -326,6 +347,8 @@ void Supla::RegisterDevice::addChannel(int channelNumber) {
 }
 
 void Supla::RegisterDevice::removeChannel(int channelNumber) {
+  // removed channel may be the one kept by cursor
+  resetChannelCursor();
   if (channelNumber >= SUPLA_CHANNELMAXCOUNT || channelNumber == -1) {
     return;
   }
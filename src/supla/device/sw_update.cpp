@@ -3,11 +3,18 @@
 
 #include "sw_update.h"
 
+#include <ctype.h>
+#include <stdio.h>
 #include <string.h>
+#include <supla/device/register_device.h>
+#include <supla/sha256.h>
 #include <supla/storage/config.h>
+#include <supla/tools.h>
+
+#define CHECK_UPDATE_BUF_SIZE 512
 
 #if !defined(SUPLA_TEST)
-#if defined(ARDUINO) || defined(SUPLA_LINUX) || defined(SUPLA_FREERTOS)
+#if defined(ARDUINO) || defined(SUPLA_FREERTOS)
 // TODO(klew): implement sw update for remaining targets
 Supla::Device::SwUpdate *Supla::Device::SwUpdate::Create(
     SuplaDeviceClass *sdc, const char *newUrl, Supla::SwUpdateMode mode) {
@@ -47,3 +54,148 @@ void Supla::Device::SwUpdate::setUrl(const char *newUrl) {
     url[SUPLA_MAX_URL_LENGTH - 1] = '\0';
   }
 }
+
+void Supla::Device::SwUpdate::setCurrentImageSha256(const uint8_t *sha256) {
+  currentImageSha256Set = sha256 != nullptr;
+  if (sha256) {
+    memcpy(currentImageSha256, sha256, sizeof(currentImageSha256));
+  }
+}
+
+bool Supla::Device::SwUpdate::generateCheckUpdateQuery(char *queryParams,
+                                                       int size) const {
+  if (queryParams == nullptr || size <= 0) {
+    return false;
+  }
+  queryParams[0] = '\0';
+  char buf[CHECK_UPDATE_BUF_SIZE] = {};
+  int curPos = 0;
+
+  int v = 0;
+
+  while (1) {
+    v = stringAppend(
+        queryParams + curPos, "manufacturerId=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    snprintf(
+        buf, sizeof(buf), "%d", Supla::RegisterDevice::getManufacturerId());
+    v = stringAppend(queryParams + curPos, buf, size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+
+    v = stringAppend(queryParams + curPos, "&productId=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    snprintf(buf, sizeof(buf), "%d", Supla::RegisterDevice::getProductId());
+    v = stringAppend(queryParams + curPos, buf, size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+
+    v = stringAppend(
+        queryParams + curPos, "&productName=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    urlEncode(Supla::RegisterDevice::getName(), buf, CHECK_UPDATE_BUF_SIZE);
+    v = stringAppend(queryParams + curPos, buf, size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+
+    v = stringAppend(queryParams + curPos, "&platform=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    snprintf(buf, sizeof(buf), "%d", Supla::getPlatformId());
+    v = stringAppend(queryParams + curPos, buf, size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+
+    v = stringAppend(queryParams + curPos, "&version=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    urlEncode(
+        Supla::RegisterDevice::getSoftVer(), buf, CHECK_UPDATE_BUF_SIZE);
+    v = stringAppend(queryParams + curPos, buf, size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+
+    v = stringAppend(queryParams + curPos, "&guidHash=", size - curPos - 1);
+    if (v == 0) break;
+    curPos += v;
+    {
+      Supla::Sha256 hash;
+      hash.update(
+          reinterpret_cast<const uint8_t *>(Supla::RegisterDevice::getGUID()),
+          SUPLA_GUID_SIZE);
+
+      uint8_t sha[32] = {};
+      hash.digest(sha);
+
+      if (curPos < size - 1 - 32 * 2) {
+        curPos += generateHexString(sha, queryParams + curPos, 32);
+      } else {
+        v = 0;
+        break;
+      }
+    }
+
+    if (!Supla::RegisterDevice::isEmailEmpty()) {
+      v = stringAppend(
+          queryParams + curPos, "&userEmailHash=", size - curPos - 1);
+      if (v == 0) break;
+      curPos += v;
+      Supla::Sha256 hash;
+      strncpy(
+          buf, Supla::RegisterDevice::getEmail(), CHECK_UPDATE_BUF_SIZE - 1);
+      buf[CHECK_UPDATE_BUF_SIZE - 1] = '\0';
+      auto bufPtr = buf;
+      int emailLength = 0;
+      while (*bufPtr) {
+        *bufPtr = tolower(*bufPtr);
+        bufPtr++;
+        emailLength++;
+      }
+      hash.update(reinterpret_cast<uint8_t *>(buf), emailLength);
+      uint8_t sha[32] = {};
+      hash.digest(sha);
+      if (curPos < size - 1 - 32 * 2) {
+        curPos += generateHexString(sha, queryParams + curPos, 32);
+      } else {
+        v = 0;
+        break;
+      }
+    }
+
+    if (currentImageSha256Set) {
+      v = stringAppend(
+          queryParams + curPos, "&imageSha256=", size - curPos - 1);
+      if (v == 0) break;
+      curPos += v;
+      if (curPos < size - 1 - 32 * 2) {
+        curPos += generateHexString(currentImageSha256,
+                                    queryParams + curPos,
+                                    sizeof(currentImageSha256));
+      } else {
+        v = 0;
+        break;
+      }
+    }
+
+    if (beta) {
+      v = stringAppend(
+          queryParams + curPos, "&beta=true", size - curPos - 1);
+      if (v == 0) break;
+      curPos += v;
+    }
+
+    if (isSecurityOnly()) {
+      v = stringAppend(
+          queryParams + curPos, "&securityOnly=true", size - curPos - 1);
+      if (v == 0) break;
+      curPos += v;
+    }
+
+    break;
+  }
+
+  return v != 0;
+}
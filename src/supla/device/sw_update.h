@@ -89,6 +89,15 @@ class SwUpdate {
                     const char *newUrl,
                     Supla::SwUpdateMode mode);
 
+  // Generates form encoded parameters of check update request (device
+  // identification, current version, beta and security only flags).
+  // Returns false if they don't fit in size bytes.
+  bool generateCheckUpdateQuery(char *queryParams, int size) const;
+
+  // SHA-256 of currently running image. When set, it is sent in check update
+  // request, so server may offer delta patch for it.
+  void setCurrentImageSha256(const uint8_t *sha256);
+
   void notifyProgress(uint32_t downloadedBytes, uint32_t totalBytes) {
     if (observer) {
       observer->onSwUpdateProgress(downloadedBytes, totalBytes);
@@ -117,6 +126,8 @@ class SwUpdate {
   char *newVersion = nullptr;
   char *changelogUrl = nullptr;
   bool retryAllowed = false;
+  bool currentImageSha256Set = false;
+  uint8_t currentImageSha256[32] = {};
   Supla::SwUpdateMode mode = Supla::SwUpdateMode::NotSet;
 
   char url[SUPLA_MAX_URL_LENGTH] = {};
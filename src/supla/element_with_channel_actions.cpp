@@ -500,6 +500,8 @@ void Supla::ElementWithChannelActions::purgeConfig() {
     cfg->eraseKey(key);
     generateKey(key, Supla::ConfigTag::ChannelConfigChangedFlagTag);
     cfg->eraseKey(key);
+    generateKey(key, Supla::ConfigTag::ReportingPolicyCfgTag);
+    cfg->eraseKey(key);
   }
 }
 
@@ -367,5 +367,9 @@ uint8_t Base::customPinToInterrupt(uint8_t) {
   return 0;
 }
 
+bool Base::customDigitalReadIsrSafe() const {
+  return false;
+}
+
 }  // namespace Io
 }  // namespace Supla
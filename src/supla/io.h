@@ -49,6 +49,9 @@ class Base {
   virtual void customAttachInterrupt(uint8_t pin, void (*func)(void), int mode);
   virtual void customDetachInterrupt(uint8_t pin);
   virtual uint8_t customPinToInterrupt(uint8_t pin);
+  // Returns true when customDigitalRead can be called from an interrupt
+  // handler. I/O expanders (i.e. on I2C) are not ISR safe.
+  virtual bool customDigitalReadIsrSafe() const;
 
  private:
   mutable uint8_t pwmResolutionBitsValue;
@@ -11,6 +11,7 @@
 #include <MCP23017.h>
 
 #include <supla/io.h>
+#include <supla/io/port_snapshot.h>
 #include <supla/mutex.h>
 #include <supla/element.h>
 #include <supla/log_wrapper.h>
@@ -18,13 +19,22 @@
 namespace Supla {
 namespace Io {
 
-class MCP23017 : public Supla::Io::Base, Supla::Element {
+// Port is read once per timer tick and per-pin reads return cached bits.
+// Writes are sent with one transaction per tick. When interrupt-on-change
+// is enabled on the chip and its INT output is connected, call
+// setInterruptPin() and port will be read only when INT is asserted.
+class MCP23017 : public Supla::Io::Base,
+                 Supla::Element,
+                 public Supla::Io::PortSnapshot {
  public:
   explicit MCP23017(uint8_t address = 0x20,
                     Supla::Mutex *mutex = nullptr,
                     TwoWire *wire = &Wire,
                     bool pullUp = false)
-      : Supla::Io::Base(), mcp_(address, wire), mutex_(mutex) {
+      : Supla::Io::Base(),
+        Supla::Io::PortSnapshot(mutex),
+        mcp_(address, wire),
+        mutex_(mutex) {
     if (!mcp_.begin(pullUp)) {
       SUPLA_LOG_ERROR("Unable to find MCP23017 at address: 0x%x", address);
     } else {
@@ -33,9 +43,8 @@ class MCP23017 : public Supla::Io::Base, Supla::Element {
   }
 
   void onInit() {
-    read16FromMCP();
-    outState_ = inState_;
-    lastOutState_ = inState_;
+    initSnapshot();
+    resetOutputState(getInputState());
   }
 
   void customPinMode(int channelNumber, uint8_t pin, uint8_t mode) override {
@@ -52,11 +61,7 @@ class MCP23017 : public Supla::Io::Base, Supla::Element {
       SUPLA_LOG_WARNING("[MCP23017] can't write, pin %d out of range", pin);
       return;
     }
-    if (val) {
-      outState_ |= (1 << pin);
-    } else {
-      outState_ &= ~(1 << pin);
-    }
+    writeBit(pin, val);
   }
 
   int customDigitalRead(int channelNumber, uint8_t pin) override {
@@ -64,7 +69,7 @@ class MCP23017 : public Supla::Io::Base, Supla::Element {
       SUPLA_LOG_WARNING("[MCP23017] can't read, pin %d out of range", pin);
       return 0;
     }
-    return (inState_ >> pin) & 0x01;
+    return readBit(pin);
   }
 
   unsigned int customPulseIn(int channelNumber, uint8_t pin, uint8_t value,
@@ -79,34 +84,33 @@ class MCP23017 : public Supla::Io::Base, Supla::Element {
   }
 
   void onTimer() override {
-    read16FromMCP();
-    write16ToMCP();
+    tickSnapshot();
   }
 
   void read16FromMCP() {
-    if (mutex_) mutex_->lock();
-    if (mcp_.isConnected()) {
-      uint16_t data = mcp_.read16();
-      inState_ = (data >> 8) | (data << 8);
-    }
-    if (mutex_) mutex_->unlock();
+    refreshSnapshot();
   }
 
   void write16ToMCP() {
-    if (mutex_) mutex_->lock();
-    if (mcp_.isConnected() && outState_ != lastOutState_) {
-      uint16_t data = (outState_ >> 8) | (outState_ << 8);
-      mcp_.write16(data);
-      lastOutState_ = outState_;
-    }
-    if (mutex_) mutex_->unlock();
+    flushSnapshot();
   }
 
  protected:
+  bool readPort(uint16_t *value) override {
+    uint16_t data = mcp_.read16();
+    if (mcp_.lastError() != MCP23017_OK) {
+      return false;
+    }
+    *value = (data >> 8) | (data << 8);
+    return true;
+  }
+
+  bool writePort(uint16_t value) override {
+    uint16_t data = (value >> 8) | (value << 8);
+    return mcp_.write16(data);
+  }
+
   ::MCP23017 mcp_;
-  uint16_t outState_ = 0;
-  uint16_t inState_ = 0;
-  uint16_t lastOutState_ = 0;
   Supla::Mutex *mutex_ = nullptr;
 };
 
@@ -11,27 +11,67 @@ Use library manager to install it
 #include <PCF8574.h>
 
 #include <supla/io.h>
+#include <supla/io/port_snapshot.h>
 #include <supla/mutex.h>
+#include <supla/element.h>
 #include <supla/log_wrapper.h>
 
 namespace Supla {
 namespace Io {
 
-class PCF8574 : public Supla::Io::Base {
+// In port snapshot mode (disabled by default) whole port is read once per
+// timer tick (or only when INT line is asserted, see setInterruptPin()) and
+// per-pin reads return cached bits. Writes are sent once per tick.
+class PCF8574 : public Supla::Io::Base,
+                public Supla::Element,
+                public Supla::Io::PortSnapshot {
  public:
   explicit PCF8574(uint8_t address = 0x20,
                    Supla::Mutex *mutex = nullptr,
                    uint8_t initialPinState = 0xFF,
                    TwoWire *wire = &Wire)
-      : Supla::Io::Base(), pcf_(address, wire), mutex_(mutex) {
+      : Supla::Io::Base(),
+        Supla::Io::PortSnapshot(mutex),
+        pcf_(address, wire),
+        mutex_(mutex) {
     if (!pcf_.begin(initialPinState)) {
       SUPLA_LOG_ERROR("Unable to find PCF8574 at address 0x%x", address);
     } else {
       SUPLA_LOG_DEBUG("PCF8574 is connected at address: 0x%x", address);
     }
+    resetOutputState(initialPinState);
+  }
+
+  void setPortSnapshotMode(bool enabled) {
+    portSnapshotMode_ = enabled;
+  }
+
+  bool isPortSnapshotMode() const {
+    return portSnapshotMode_;
+  }
+
+  void onInit() override {
+    if (portSnapshotMode_) {
+      resetOutputState(pcf_.valueOut());
+      initSnapshot();
+    }
+  }
+
+  void onTimer() override {
+    if (portSnapshotMode_) {
+      tickSnapshot();
+    }
   }
 
   void customPinMode(int channelNumber, uint8_t pin, uint8_t mode) override {
+    if (portSnapshotMode_) {
+      if (mode == INPUT_PULLUP) {
+        // quasi-bidirectional port: input has to be set high
+        writeBit(pin, true);
+        flushSnapshot();
+      }
+      return;
+    }
     if (mutex_) mutex_->lock();
     if (mode == INPUT_PULLUP && pcf_.isConnected()) {
       pcf_.write(pin, HIGH);
@@ -41,6 +81,10 @@ class PCF8574 : public Supla::Io::Base {
 
   void customDigitalWrite(int channelNumber, uint8_t pin,
                                                         uint8_t val) override {
+    if (portSnapshotMode_) {
+      writeBit(pin, val);
+      return;
+    }
     if (mutex_) mutex_->lock();
     if (pcf_.isConnected()) {
       pcf_.write(pin, val);
@@ -49,6 +93,9 @@ class PCF8574 : public Supla::Io::Base {
   }
 
   int customDigitalRead(int channelNumber, uint8_t pin) override {
+    if (portSnapshotMode_) {
+      return readBit(pin);
+    }
     uint8_t val;
     if (mutex_) mutex_->lock();
     val =  pcf_.isConnected() ? pcf_.read(pin) : 0;
@@ -68,8 +115,23 @@ class PCF8574 : public Supla::Io::Base {
   }
 
  protected:
+  bool readPort(uint16_t *value) override {
+    uint8_t data = pcf_.read8();
+    if (pcf_.lastError() != PCF8574_OK) {
+      return false;
+    }
+    *value = data;
+    return true;
+  }
+
+  bool writePort(uint16_t value) override {
+    pcf_.write8(static_cast<uint8_t>(value));
+    return pcf_.lastError() == PCF8574_OK;
+  }
+
   ::PCF8574 pcf_;
   Supla::Mutex *mutex_ = nullptr;
+  bool portSnapshotMode_ = false;
 };
 
 };  // namespace Io
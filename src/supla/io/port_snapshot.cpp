@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "port_snapshot.h"
+
+#include <supla/auto_lock.h>
+#include <supla/io.h>
+#include <supla/time.h>
+
+namespace Supla {
+namespace Io {
+
+PortSnapshot::PortSnapshot(Supla::Mutex *mutex) : portMutex(mutex) {
+}
+
+void PortSnapshot::setMaxAgeMs(uint32_t maxAgeMs) {
+  this->maxAgeMs = maxAgeMs;
+}
+
+uint32_t PortSnapshot::getMaxAgeMs() const {
+  return maxAgeMs;
+}
+
+void PortSnapshot::setInterruptPin(int pin) {
+  interruptPin = pin;
+}
+
+int PortSnapshot::getInterruptPin() const {
+  return interruptPin;
+}
+
+void PortSnapshot::initSnapshot() {
+  if (interruptPin >= 0) {
+    // INT output of expanders is open drain, active low
+    Supla::Io::pinMode(static_cast<uint8_t>(interruptPin), INPUT_PULLUP);
+  }
+  refreshSnapshot();
+}
+
+void PortSnapshot::tickSnapshot() {
+  if (!snapshotValid || interruptPin < 0 || isInterruptAsserted()) {
+    refreshSnapshot();
+  }
+  flushSnapshot();
+}
+
+bool PortSnapshot::readBit(uint8_t bit) {
+  if (bit >= 16) {
+    return false;
+  }
+  if (!snapshotValid || millis() - lastReadMs > maxAgeMs) {
+    refreshSnapshot();
+  }
+  return (inState >> bit) & 0x01;
+}
+
+void PortSnapshot::writeBit(uint8_t bit, bool value) {
+  if (bit >= 16) {
+    return;
+  }
+  if (value) {
+    outState |= (1 << bit);
+  } else {
+    outState &= ~(1 << bit);
+  }
+}
+
+uint16_t PortSnapshot::getInputState() const {
+  return inState;
+}
+
+uint16_t PortSnapshot::getOutputState() const {
+  return outState;
+}
+
+void PortSnapshot::resetOutputState(uint16_t state) {
+  outState = state;
+  lastOutState = state;
+}
+
+bool PortSnapshot::isOutputPending() const {
+  return outState != lastOutState;
+}
+
+void PortSnapshot::invalidateSnapshot() {
+  snapshotValid = false;
+}
+
+uint32_t PortSnapshot::getReadCount() const {
+  return readCount;
+}
+
+uint32_t PortSnapshot::getWriteCount() const {
+  return writeCount;
+}
+
+bool PortSnapshot::refreshSnapshot() {
+  // Timestamp is updated also on failure, so missing chip is not queried on
+  // each readBit() call. Last known state is kept in such case.
+  lastReadMs = millis();
+  snapshotValid = true;
+  uint16_t value = 0;
+  bool result = false;
+  {
+    Supla::AutoLock lock(portMutex);
+    result = readPort(&value);
+  }
+  readCount++;
+  if (result) {
+    inState = value;
+  }
+  return result;
+}
+
+bool PortSnapshot::flushSnapshot() {
+  if (!isOutputPending()) {
+    return true;
+  }
+  uint16_t value = outState;
+  bool result = false;
+  {
+    Supla::AutoLock lock(portMutex);
+    result = writePort(value);
+  }
+  writeCount++;
+  if (result) {
+    lastOutState = value;
+  }
+  return result;
+}
+
+bool PortSnapshot::isInterruptAsserted() const {
+  return Supla::Io::digitalRead(static_cast<uint8_t>(interruptPin)) == LOW;
+}
+
+}  // namespace Io
+}  // namespace Supla
@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_IO_PORT_SNAPSHOT_H_
+#define SRC_SUPLA_IO_PORT_SNAPSHOT_H_
+
+#include <stdint.h>
+
+#ifndef SUPLA_IO_PORT_SNAPSHOT_MAX_AGE_MS
+#define SUPLA_IO_PORT_SNAPSHOT_MAX_AGE_MS 100
+#endif
+
+namespace Supla {
+
+class Mutex;
+
+namespace Io {
+
+// Cached copy of a whole port (up to 16 pins) of an I/O expander.
+//
+// Port is read with a single bus transaction in tick() and per-pin reads
+// return bits from that snapshot. When interrupt pin of expander is
+// configured, port is read in tick() only when INT is asserted (active low).
+// In both cases readBit() refreshes the snapshot when it is older than
+// max age.
+// Writes only modify the cached output state. All changes made between
+// ticks are sent to the expander with one transaction in tick().
+//
+// Derived class provides readPort()/writePort() for specific chip. Mutex
+// (if provided) is locked for each bus transaction.
+class PortSnapshot {
+ public:
+  explicit PortSnapshot(Supla::Mutex *mutex = nullptr);
+  virtual ~PortSnapshot() = default;
+
+  // Maximum age of snapshot returned by readBit(). 0 - always read port.
+  void setMaxAgeMs(uint32_t maxAgeMs);
+  uint32_t getMaxAgeMs() const;
+
+  // GPIO (of MCU) connected to INT output of the expander.
+  void setInterruptPin(int pin);
+  int getInterruptPin() const;
+
+  // Configures INT pin and reads port for the first time
+  void initSnapshot();
+
+  // Reads port if needed and writes pending outputs
+  void tickSnapshot();
+
+  bool readBit(uint8_t bit);
+  void writeBit(uint8_t bit, bool value);
+
+  uint16_t getInputState() const;
+  uint16_t getOutputState() const;
+  // Sets output state which is already present on the expander (e.g. after
+  // chip initialization), so it is not written again
+  void resetOutputState(uint16_t state);
+  bool isOutputPending() const;
+
+  // Forces port read on next tick or readBit()
+  void invalidateSnapshot();
+
+  // Number of bus transactions made by this snapshot
+  uint32_t getReadCount() const;
+  uint32_t getWriteCount() const;
+
+  bool refreshSnapshot();
+  bool flushSnapshot();
+
+ protected:
+  virtual bool readPort(uint16_t *value) = 0;
+  virtual bool writePort(uint16_t value) = 0;
+
+  bool isInterruptAsserted() const;
+
+  Supla::Mutex *portMutex = nullptr;
+  uint32_t maxAgeMs = SUPLA_IO_PORT_SNAPSHOT_MAX_AGE_MS;
+  uint32_t lastReadMs = 0;
+  uint32_t readCount = 0;
+  uint32_t writeCount = 0;
+  uint16_t inState = 0;
+  uint16_t outState = 0;
+  uint16_t lastOutState = 0;
+  int16_t interruptPin = -1;
+  bool snapshotValid = false;
+};
+
+}  // namespace Io
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_IO_PORT_SNAPSHOT_H_
@@ -11,6 +11,7 @@ const char *SUPLA_TAG = "SUPLA";
 
 #include <esp_log.h>
 #include <supla-common/log.h>
+#include <supla/log_wrapper.h>
 
 void supla_device_logf(int __pri, const char *__fmt, ...) {
   if (__fmt == NULL || !supla_log_is_enabled(__pri)) {
@@ -33,6 +34,10 @@ void supla_device_logf(int __pri, const char *__fmt, ...) {
     buffer[sizeof(buffer) - 2] = '\0';
   }
 
+  supla_device_log_write(__pri, buffer);
+}
+
+void supla_device_log_write(int __pri, const char *buffer) {
   switch (__pri) {
     case LOG_VERBOSE:
       ESP_LOGV(SUPLA_TAG, "%s", buffer);
@@ -49,6 +49,62 @@ void supla_logf(int __pri, const __FlashStringHelper *__fmt, ...);
 #include <esp_log.h>
 extern const char *SUPLA_TAG;
 void supla_device_logf(int __pri, const char *__fmt, ...);
+// writes already formatted message to ESP_LOG* and debug log sink
+void supla_device_log_write(int __pri, const char *buffer);
+#endif
+
+// Define SUPLA_ASYNC_LOG to route SUPLA_LOG_* through Supla::Debug::AsyncLog
+// (see supla/debug/async_log.h). Formatting and writing is then done by the
+// AsyncLog consumer instead of the calling thread.
+#if defined(SUPLA_ASYNC_LOG) && !defined(ARDUINO)
+extern "C" void supla_async_logf(int __pri, const char *__fmt, ...);
+#ifndef SUPLA_LOG_VERBOSE
+#define SUPLA_LOG_VERBOSE(arg_format, ...) \
+            do { \
+              if (SUPLA_LOG_IS_ENABLED(LOG_VERBOSE)) { \
+                supla_async_logf(LOG_VERBOSE, arg_format, ## __VA_ARGS__); \
+              } \
+            } while (0)
+#endif
+
+#ifndef SUPLA_LOG_DEBUG
+#define SUPLA_LOG_DEBUG(arg_format, ...) \
+            do { \
+              if (SUPLA_LOG_IS_ENABLED(LOG_DEBUG)) { \
+                supla_async_logf(LOG_DEBUG, arg_format, ## __VA_ARGS__); \
+              } \
+            } while (0)
+#endif
+
+#ifndef SUPLA_LOG_INFO
+#define SUPLA_LOG_INFO(arg_format, ...) \
+            do { \
+              if (SUPLA_LOG_IS_ENABLED(LOG_INFO)) { \
+                supla_async_logf(LOG_INFO, arg_format, ## __VA_ARGS__); \
+              } \
+            } while (0)
+#endif
+
+#ifndef SUPLA_LOG_WARNING
+#define SUPLA_LOG_WARNING(arg_format, ...) \
+            do { \
+              if (SUPLA_LOG_IS_ENABLED(LOG_WARNING)) { \
+                supla_async_logf(LOG_WARNING, arg_format, ## __VA_ARGS__); \
+              } \
+            } while (0)
+#endif
+
+#ifndef SUPLA_LOG_ERROR
+#define SUPLA_LOG_ERROR(arg_format, ...) \
+            do { \
+              if (SUPLA_LOG_IS_ENABLED(LOG_ERR)) { \
+                supla_async_logf(LOG_ERR, arg_format, ## __VA_ARGS__); \
+              } \
+            } while (0)
+#endif
+#endif  // defined(SUPLA_ASYNC_LOG) && !defined(ARDUINO)
+
+#ifdef SUPLA_DEVICE_ESP32
 #ifndef SUPLA_LOG_VERBOSE
 #define SUPLA_LOG_VERBOSE(arg_format, ...) \
             do { \
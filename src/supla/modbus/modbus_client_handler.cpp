@@ -9,6 +9,7 @@ using Supla::ModbusClientHandler;
 
 
 ModbusClientHandler::ModbusClientHandler() {
+  InvalidateIndex();
   if (first == nullptr) {
     first = this;
   } else {
@@ -21,6 +22,7 @@ ModbusClientHandler::ModbusClientHandler() {
 }
 
 ModbusClientHandler::~ModbusClientHandler() {
+  InvalidateIndex();
   if (first == this) {
     first = next;
   } else {
@@ -40,30 +42,30 @@ Supla::Modbus::Result ModbusClientHandler::HoldingProcessRequest(
     uint16_t nRegs,
     uint8_t *regBuffer,
     Supla::Modbus::Access access) {
-  auto handler = GetHoldingHandler(address, nRegs);
-  if (handler != nullptr) {
-    return handler->holdingProcessRequest(address, nRegs, regBuffer, access);
-  }
-  return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+  return ProcessRequest(Supla::Modbus::RegisterType::HOLDING_REGISTER,
+                        address,
+                        nRegs,
+                        regBuffer,
+                        access);
 }
 
 Supla::Modbus::Result ModbusClientHandler::InputProcessRequest(uint16_t address,
                                                        uint16_t nRegs,
                                                        uint8_t *regBuffer) {
-  auto handler = GetInputHandler(address, nRegs);
-  if (handler != nullptr) {
-    return handler->inputProcessRequest(address, nRegs, regBuffer);
-  }
-  return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+  return ProcessRequest(Supla::Modbus::RegisterType::INPUT_REGISTER,
+                        address,
+                        nRegs,
+                        regBuffer,
+                        Supla::Modbus::Access::READ);
 }
 
 Supla::Modbus::Result ModbusClientHandler::DiscreteProcessRequest(
     uint16_t address, uint16_t nRegs, uint8_t *regBuffer) {
-  auto handler = GetDiscreteHandler(address, nRegs);
-  if (handler != nullptr) {
-    return handler->discreteProcessRequest(address, nRegs, regBuffer);
-  }
-  return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+  return ProcessRequest(Supla::Modbus::RegisterType::DISCRETE_INPUT,
+                        address,
+                        nRegs,
+                        regBuffer,
+                        Supla::Modbus::Access::READ);
 }
 
 Supla::Modbus::Result ModbusClientHandler::CoilsProcessRequest(
@@ -71,13 +73,264 @@ Supla::Modbus::Result ModbusClientHandler::CoilsProcessRequest(
     uint16_t nRegs,
     uint8_t *regBuffer,
     Supla::Modbus::Access access) {
-  auto handler = GetCoilsHandler(address, nRegs);
+  return ProcessRequest(Supla::Modbus::RegisterType::COIL,
+                        address,
+                        nRegs,
+                        regBuffer,
+                        access);
+}
+
+void ModbusClientHandler::BuildIndex() {
+  BuildIndex(Supla::Modbus::RegisterType::HOLDING_REGISTER);
+  BuildIndex(Supla::Modbus::RegisterType::INPUT_REGISTER);
+  BuildIndex(Supla::Modbus::RegisterType::COIL);
+  BuildIndex(Supla::Modbus::RegisterType::DISCRETE_INPUT);
+}
+
+void ModbusClientHandler::InvalidateIndex() {
+  // segments are not released here, they are replaced by next BuildIndex()
+  for (auto &index : indexes) {
+    __atomic_store_n(&index.valid, false, __ATOMIC_RELEASE);
+  }
+}
+
+void ModbusClientHandler::BuildIndex(Supla::Modbus::RegisterType type) {
+  auto index = &indexes[static_cast<int>(type)];
+  __atomic_store_n(&index->valid, false, __ATOMIC_RELEASE);
+
+  delete[] index->segments;
+  index->segments = nullptr;
+  index->count = 0;
+
+  // collect range boundaries of all handlers supporting given register type
+  int handlersCount = 0;
+  for (auto handler = first; handler != nullptr; handler = handler->next) {
+    if (handler->usedRegistersCount > 0 &&
+        handler->supportsRegisterType(type)) {
+      handlersCount++;
+    }
+  }
+  if (handlersCount == 0) {
+    __atomic_store_n(&index->valid, true, __ATOMIC_RELEASE);
+    return;
+  }
+
+  auto boundaries = new uint32_t[handlersCount * 2];
+  int boundariesCount = 0;
+  for (auto handler = first; handler != nullptr; handler = handler->next) {
+    if (handler->usedRegistersCount > 0 &&
+        handler->supportsRegisterType(type)) {
+      boundaries[boundariesCount++] = handler->modbusAddressOffset;
+      boundaries[boundariesCount++] = static_cast<uint32_t>(
+          handler->modbusAddressOffset + handler->usedRegistersCount);
+    }
+  }
+  // insertion sort - handlers count is small
+  for (int i = 1; i < boundariesCount; i++) {
+    auto value = boundaries[i];
+    int j = i - 1;
+    while (j >= 0 && boundaries[j] > value) {
+      boundaries[j + 1] = boundaries[j];
+      j--;
+    }
+    boundaries[j + 1] = value;
+  }
+
+  // each elementary range between two boundaries is assigned to the first
+  // registered handler covering it; adjacent ranges with the same handler are
+  // merged
+  index->segments = new IndexSegment[boundariesCount];
+  for (int i = 0; i + 1 < boundariesCount; i++) {
+    uint32_t start = boundaries[i];
+    uint32_t end = boundaries[i + 1];
+    if (start == end) {
+      continue;
+    }
+    ModbusClientHandler *owner = nullptr;
+    for (auto handler = first; handler != nullptr; handler = handler->next) {
+      if (handler->usedRegistersCount > 0 &&
+          handler->supportsRegisterType(type) &&
+          handler->modbusAddressOffset <= start &&
+          static_cast<uint32_t>(handler->modbusAddressOffset +
+                                handler->usedRegistersCount) >= end) {
+        owner = handler;
+        break;
+      }
+    }
+    if (owner == nullptr) {
+      continue;
+    }
+    if (index->count > 0) {
+      auto last = &index->segments[index->count - 1];
+      if (last->handler == owner && last->end == start) {
+        last->end = end;
+        continue;
+      }
+    }
+    auto segment = &index->segments[index->count++];
+    segment->start = start;
+    segment->end = end;
+    segment->handler = owner;
+  }
+  delete[] boundaries;
+  __atomic_store_n(&index->valid, true, __ATOMIC_RELEASE);
+}
+
+int ModbusClientHandler::FindSegment(const RegisterIndex *index,
+                                     uint32_t address) {
+  int low = 0;
+  int high = index->count - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    const auto &segment = index->segments[mid];
+    if (address < segment.start) {
+      high = mid - 1;
+    } else if (address >= segment.end) {
+      low = mid + 1;
+    } else {
+      return mid;
+    }
+  }
+  return -1;
+}
+
+Supla::Modbus::Result ModbusClientHandler::ProcessRequest(
+    Supla::Modbus::RegisterType type,
+    uint16_t address,
+    uint16_t nRegs,
+    uint8_t *regBuffer,
+    Supla::Modbus::Access access) {
+  auto index = &indexes[static_cast<int>(type)];
+  uint32_t requestEnd = static_cast<uint32_t>(address) + nRegs;
+  int firstSegment = -1;
+  if (__atomic_load_n(&index->valid, __ATOMIC_ACQUIRE)) {
+    firstSegment = FindSegment(index, address);
+  }
+  if (firstSegment >= 0) {
+    // check if request is covered by adjacent segments without gaps
+    int lastSegment = firstSegment;
+    while (index->segments[lastSegment].end < requestEnd &&
+           lastSegment + 1 < index->count &&
+           index->segments[lastSegment + 1].start ==
+               index->segments[lastSegment].end) {
+      lastSegment++;
+    }
+    bool covered = index->segments[lastSegment].end >= requestEnd;
+    // bit based registers can't be split without bit shifting of the buffer.
+    // Writes are not split, because failure of one handler would leave
+    // request partially applied.
+    bool splittable = (type == Supla::Modbus::RegisterType::HOLDING_REGISTER ||
+                       type == Supla::Modbus::RegisterType::INPUT_REGISTER) &&
+                      access == Supla::Modbus::Access::READ;
+    if (covered && (firstSegment == lastSegment || splittable)) {
+      // all chunks are validated before any of them is processed
+      bool accepted = true;
+      uint32_t chunkStart = address;
+      for (int i = firstSegment; i <= lastSegment && accepted; i++) {
+        uint32_t chunkEnd = index->segments[i].end;
+        if (chunkEnd > requestEnd) {
+          chunkEnd = requestEnd;
+        }
+        accepted = index->segments[i].handler->respondsToAddress(
+            type,
+            static_cast<uint16_t>(chunkStart),
+            static_cast<uint16_t>(chunkEnd - chunkStart));
+        chunkStart = chunkEnd;
+      }
+      chunkStart = address;
+      for (int i = firstSegment; i <= lastSegment && accepted; i++) {
+        uint32_t chunkEnd = index->segments[i].end;
+        if (chunkEnd > requestEnd) {
+          chunkEnd = requestEnd;
+        }
+        auto result = index->segments[i].handler->processRequest(
+            type,
+            static_cast<uint16_t>(chunkStart),
+            static_cast<uint16_t>(chunkEnd - chunkStart),
+            regBuffer + (chunkStart - address) * 2,
+            access);
+        if (result != Supla::Modbus::Result::OK || i == lastSegment) {
+          return result;
+        }
+        chunkStart = chunkEnd;
+      }
+    }
+  }
+
+  // fallback to linear search for handlers which define their own address
+  // matching (respondsToAddress) instead of modbusAddressOffset and
+  // usedRegistersCount
+  ModbusClientHandler *handler = nullptr;
+  switch (type) {
+    case Supla::Modbus::RegisterType::HOLDING_REGISTER:
+      handler = GetHoldingHandler(address, nRegs);
+      break;
+    case Supla::Modbus::RegisterType::INPUT_REGISTER:
+      handler = GetInputHandler(address, nRegs);
+      break;
+    case Supla::Modbus::RegisterType::COIL:
+      handler = GetCoilsHandler(address, nRegs);
+      break;
+    case Supla::Modbus::RegisterType::DISCRETE_INPUT:
+      handler = GetDiscreteHandler(address, nRegs);
+      break;
+  }
   if (handler != nullptr) {
-    return handler->coilsProcessRequest(address, nRegs, regBuffer, access);
+    return handler->processRequest(type, address, nRegs, regBuffer, access);
   }
   return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
 }
 
+bool ModbusClientHandler::supportsRegisterType(
+    Supla::Modbus::RegisterType type) {
+  switch (type) {
+    case Supla::Modbus::RegisterType::HOLDING_REGISTER:
+      return isHoldingSupported();
+    case Supla::Modbus::RegisterType::INPUT_REGISTER:
+      return isInputSupported();
+    case Supla::Modbus::RegisterType::COIL:
+      return isCoilsSupported();
+    case Supla::Modbus::RegisterType::DISCRETE_INPUT:
+      return isDiscreteSupported();
+  }
+  return false;
+}
+
+bool ModbusClientHandler::respondsToAddress(Supla::Modbus::RegisterType type,
+                                            uint16_t address,
+                                            uint16_t nRegs) {
+  switch (type) {
+    case Supla::Modbus::RegisterType::HOLDING_REGISTER:
+      return holdingRespondsToAddress(address, nRegs);
+    case Supla::Modbus::RegisterType::INPUT_REGISTER:
+      return inputRespondsToAddress(address, nRegs);
+    case Supla::Modbus::RegisterType::COIL:
+      return coilsRespondsToAddress(address, nRegs);
+    case Supla::Modbus::RegisterType::DISCRETE_INPUT:
+      return discreteRespondsToAddress(address, nRegs);
+  }
+  return false;
+}
+
+Supla::Modbus::Result ModbusClientHandler::processRequest(
+    Supla::Modbus::RegisterType type,
+    uint16_t address,
+    uint16_t nRegs,
+    uint8_t *regBuffer,
+    Supla::Modbus::Access access) {
+  switch (type) {
+    case Supla::Modbus::RegisterType::HOLDING_REGISTER:
+      return holdingProcessRequest(address, nRegs, regBuffer, access);
+    case Supla::Modbus::RegisterType::INPUT_REGISTER:
+      return inputProcessRequest(address, nRegs, regBuffer);
+    case Supla::Modbus::RegisterType::COIL:
+      return coilsProcessRequest(address, nRegs, regBuffer, access);
+    case Supla::Modbus::RegisterType::DISCRETE_INPUT:
+      return discreteProcessRequest(address, nRegs, regBuffer);
+  }
+  return Supla::Modbus::Result::INVALID_STATE;
+}
+
 ModbusClientHandler *ModbusClientHandler::GetHoldingHandler(uint16_t address,
                                                             uint16_t nRegs) {
   ModbusClientHandler *handler = first;
@@ -291,3 +544,4 @@ bool ModbusClientHandler::inputRespondsToAddress(uint16_t address,
 }
 
 ModbusClientHandler *ModbusClientHandler::first = nullptr;
+ModbusClientHandler::RegisterIndex ModbusClientHandler::indexes[4] = {};
@@ -20,6 +20,13 @@ enum class Access {
   READ,
   WRITE,
 };
+
+enum class RegisterType : uint8_t {
+  HOLDING_REGISTER = 0,
+  INPUT_REGISTER = 1,
+  COIL = 2,
+  DISCRETE_INPUT = 3,
+};
 }  // namespace Modbus
 
 class ModbusClientHandler {
@@ -48,6 +55,22 @@ class ModbusClientHandler {
                                                       uint16_t nRegs,
                                                       uint8_t *regBuffer);
 
+  /**
+   * Builds register address index of all handlers. It is called from
+   * onInit() of Modbus server elements, before requests are processed.
+   * It can't be called concurrently with request processing.
+   */
+  static void BuildIndex();
+
+  /**
+   * Marks register address index as outdated. Requests are then handled by
+   * linear search of handlers (without splitting of requests between
+   * handlers) until BuildIndex() is called again. It is called
+   * automatically when handler is created or deleted. Call it manually when
+   * handler changes its address range later.
+   */
+  static void InvalidateIndex();
+
   static bool IsInputSupported();
   static bool IsDiscreteSupported();
   static bool IsCoilsSupported();
@@ -91,6 +114,41 @@ class ModbusClientHandler {
   uint16_t usedRegistersCount = 0;
 
  private:
+  // Continuous address range [start, end) served by single handler.
+  // Index contains non overlapping segments sorted by start address. When
+  // handlers' ranges overlap, segment is assigned to the handler registered
+  // first.
+  struct IndexSegment {
+    uint32_t start = 0;
+    uint32_t end = 0;
+    ModbusClientHandler *handler = nullptr;
+  };
+
+  struct RegisterIndex {
+    IndexSegment *segments = nullptr;
+    int count = 0;
+    bool valid = false;
+  };
+
+  static Supla::Modbus::Result ProcessRequest(Supla::Modbus::RegisterType type,
+                                              uint16_t address,
+                                              uint16_t nRegs,
+                                              uint8_t *regBuffer,
+                                              Supla::Modbus::Access access);
+  static void BuildIndex(Supla::Modbus::RegisterType type);
+  static int FindSegment(const RegisterIndex *index, uint32_t address);
+  bool supportsRegisterType(Supla::Modbus::RegisterType type);
+  bool respondsToAddress(Supla::Modbus::RegisterType type,
+                         uint16_t address,
+                         uint16_t nRegs);
+  Supla::Modbus::Result processRequest(Supla::Modbus::RegisterType type,
+                                       uint16_t address,
+                                       uint16_t nRegs,
+                                       uint8_t *regBuffer,
+                                       Supla::Modbus::Access access);
+
+  static RegisterIndex indexes[4];
+
   static ModbusClientHandler *GetHoldingHandler(uint16_t address,
                                                 uint16_t nRegs);
   static ModbusClientHandler *GetInputHandler(uint16_t address, uint16_t nRegs);
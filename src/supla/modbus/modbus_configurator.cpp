@@ -4,6 +4,7 @@
 #include "modbus_configurator.h"
 
 #include <supla/log_wrapper.h>
+#include <supla/modbus/modbus_client_handler.h>
 #include <supla/storage/config.h>
 #include <supla/storage/storage.h>
 #include <supla/storage/config_tags.h>
@@ -181,6 +182,9 @@ bool Supla::Modbus::Config::validateAndFix(const ConfigProperties &properties) {
 Configurator::Configurator() {}
 
 void Configurator::onInit() {
+  // handlers are created before onInit, so index can be built here, before
+  // Modbus stack starts processing requests
+  Supla::ModbusClientHandler::BuildIndex();
   initDone = true;
 }
 
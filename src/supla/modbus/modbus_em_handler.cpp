@@ -3,7 +3,7 @@
 
 #include "modbus_em_handler.h"
 
-#include <supla/log_wrapper.h>
+#include <supla/events.h>
 #include <supla/sensor/electricity_meter.h>
 #include <string.h>
 #include "modbus_client_handler.h"
@@ -40,281 +40,220 @@ using Supla::ModbusEMHandler;
 #define EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE 10  // 64 bit
 #define EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE 14  // 64 bit
 
+// block 0 -> common, blocks 1..3 -> phases 1..3
+#define EM_REGISTER_COUNT (4 * EM_REGISTER_BLOCK_MAX_SIZE)
+
+// Image write takes only a memcpy, so reader doesn't have to wait long
+#define EM_IMAGE_READ_ATTEMPTS 100
+
 ModbusEMHandler::ModbusEMHandler(Supla::Sensor::ElectricityMeter *em,
                                  uint16_t offset)
     : em(em) {
   modbusAddressOffset = offset;
-  usedRegistersCount = 4 * EM_REGISTER_BLOCK_MAX_SIZE;
+  usedRegistersCount = EM_REGISTER_COUNT;
+  if (em != nullptr) {
+    // register image is refreshed each time EM publishes new values
+    em->addAction(Supla::ON_CHANGE, this, Supla::ON_CHANGE, true);
+    updateRegisterImage();
+  }
+}
+
+void ModbusEMHandler::handleAction(int event, int action) {
+  (void)(event);
+  if (action == Supla::ON_CHANGE) {
+    updateRegisterImage();
+  }
+}
+
+void ModbusEMHandler::setAggregationMode(
+    Supla::Sensor::EmAggregationMode mode) {
+  aggregationModeSet = true;
+  aggregationMode = mode;
+  updateRegisterImage();
+}
+
+int64_t ModbusEMHandler::getValue(Supla::Sensor::EmAggregatedValue value,
+                                  int phase) const {
+  if (aggregationModeSet && em->isSampleAggregationEnabled()) {
+    return em->getAggregatedValue(value, phase, aggregationMode);
+  }
+  switch (value) {
+    case Supla::Sensor::EmAggregatedValue::Voltage:
+      return em->getVoltage(phase);
+    case Supla::Sensor::EmAggregatedValue::Current:
+      return em->getCurrent(phase);
+    case Supla::Sensor::EmAggregatedValue::PowerActive:
+      return em->getPowerActive(phase);
+    case Supla::Sensor::EmAggregatedValue::PowerReactive:
+      return em->getPowerReactive(phase);
+    case Supla::Sensor::EmAggregatedValue::PowerApparent:
+      return em->getPowerApparent(phase);
+  }
+  return 0;
+}
+
+uint32_t ModbusEMHandler::getImageVersion() const {
+  return __atomic_load_n(&imageSequence, __ATOMIC_ACQUIRE) / 2;
+}
+
+// GCC __atomic builtins are used instead of std::atomic, because <atomic> is
+// not available on all Arduino targets.
+void ModbusEMHandler::beginImageWrite() {
+  uint32_t sequence = __atomic_load_n(&imageSequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&imageSequence, sequence + 1, __ATOMIC_RELAXED);
+  // image writes can't be reordered before the odd sequence store
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void ModbusEMHandler::endImageWrite() {
+  uint32_t sequence = __atomic_load_n(&imageSequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&imageSequence, sequence + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t ModbusEMHandler::beginImageRead() const {
+  return __atomic_load_n(&imageSequence, __ATOMIC_ACQUIRE);
+}
+
+bool ModbusEMHandler::validateImageRead(uint32_t sequence) const {
+  // image reads can't be reordered after the second sequence load
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return (sequence & 1) == 0 &&
+         __atomic_load_n(&imageSequence, __ATOMIC_RELAXED) == sequence;
+}
+
+void ModbusEMHandler::updateRegisterImage() {
+  if (em == nullptr) {
+    return;
+  }
+  // values are collected in staging buffer (used only here) and then
+  // copied to the published image under the sequence lock, so the write
+  // window seen by readers is as short as possible
+  memset(staging, 0, EM_REGISTER_COUNT * 2);
+
+  // block 0 -> common
+  storeBigEndian(em->getFreq(), staging + EM_COMMON_REG_FREQUENCY * 2, 3, 1);
+  if (em->isVoltagePhaseSequenceSet()) {
+    uint8_t value = em->isVoltagePhaseSequenceClockwise() ? 2 : 1;
+    storeBigEndian(
+        value, staging + EM_COMMON_REG_VOLTAGE_PHASE_SEQUENCE * 2, 3, 1);
+  }
+  if (em->isCurrentPhaseSequenceSet()) {
+    uint8_t value = em->isCurrentPhaseSequenceClockwise() ? 2 : 1;
+    storeBigEndian(
+        value, staging + EM_COMMON_REG_CURRENT_PHASE_SEQUENCE * 2, 3, 1);
+  }
+  storeBigEndian(em->getVoltagePhaseAngle12(),
+                 staging + EM_COMMON_REG_VOLTAGE_PHASE_ANGLE_12 * 2,
+                 3,
+                 1);
+  storeBigEndian(em->getVoltagePhaseAngle13(),
+                 staging + EM_COMMON_REG_VOLTAGE_PHASE_ANGLE_13 * 2,
+                 3,
+                 1);
+  storeBigEndian(em->getFwdBalancedActEnergy(),
+                 staging +
+                     EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE * 2,
+                 0,
+                 4);
+  storeBigEndian(em->getRvrBalancedActEnergy(),
+                 staging +
+                     EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE * 2,
+                 0,
+                 4);
+
+  // blocks 1..3 -> phases 1..3
+  for (int phase = 0; phase < MAX_PHASES; phase++) {
+    uint8_t *block = staging + (phase + 1) * EM_REGISTER_BLOCK_MAX_SIZE * 2;
+    storeBigEndian(static_cast<uint16_t>(getValue(
+                       Supla::Sensor::EmAggregatedValue::Voltage, phase)),
+                   block + EM_PHASE_REG_VOLTAGE * 2,
+                   3,
+                   1);
+    // signed 16 bit values are stored in two's complement
+    storeBigEndian(static_cast<uint16_t>(em->getPhaseAngle(phase)),
+                   block + EM_PHASE_REG_PHASE_ANGLE * 2,
+                   3,
+                   1);
+    storeBigEndian(static_cast<uint16_t>(em->getPowerFactor(phase)),
+                   block + EM_PHASE_REG_POWER_FACTOR * 2,
+                   3,
+                   1);
+    storeBigEndian(static_cast<uint32_t>(getValue(
+                       Supla::Sensor::EmAggregatedValue::Current, phase)),
+                   block + EM_PHASE_REG_CURRENT * 2,
+                   2,
+                   2);
+    // power is in int64 in 0.00001 W units
+    // We will use int32 with 0.001 W units
+    storeBigEndian(
+        static_cast<uint32_t>(
+            getValue(Supla::Sensor::EmAggregatedValue::PowerActive, phase) /
+            100),
+        block + EM_PHASE_REG_POWER_ACTIVE * 2,
+        2,
+        2);
+    storeBigEndian(
+        static_cast<uint32_t>(
+            getValue(Supla::Sensor::EmAggregatedValue::PowerReactive, phase) /
+            100),
+        block + EM_PHASE_REG_POWER_REACTIVE * 2,
+        2,
+        2);
+    storeBigEndian(
+        static_cast<uint32_t>(
+            getValue(Supla::Sensor::EmAggregatedValue::PowerApparent, phase) /
+            100),
+        block + EM_PHASE_REG_POWER_APPARENT * 2,
+        2,
+        2);
+    storeBigEndian(em->getFwdActEnergy(phase),
+                   block + EM_PHASE_REG_FWD_ENERGY_ACTIVE * 2,
+                   0,
+                   4);
+    storeBigEndian(em->getRvrActEnergy(phase),
+                   block + EM_PHASE_REG_RVR_ENERGY_ACTIVE * 2,
+                   0,
+                   4);
+    storeBigEndian(em->getFwdReactEnergy(phase),
+                   block + EM_PHASE_REG_FWD_ENERGY_REACTIVE * 2,
+                   0,
+                   4);
+    storeBigEndian(em->getRvrReactEnergy(phase),
+                   block + EM_PHASE_REG_RVR_ENERGY_REACTIVE * 2,
+                   0,
+                   4);
+  }
+
+  beginImageWrite();
+  memcpy(image, staging, EM_REGISTER_COUNT * 2);
+  endImageWrite();
 }
 
 Supla::Modbus::Result ModbusEMHandler::holdingProcessRequest(uint16_t address,
                                               uint16_t nRegs,
                                               uint8_t *regBuffer,
                                               Supla::Modbus::Access access) {
-  if (em == nullptr) {
+  if (em == nullptr || access != Supla::Modbus::Access::READ) {
+    return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+  }
+  if (address < modbusAddressOffset ||
+      address - modbusAddressOffset + nRegs > EM_REGISTER_COUNT) {
     return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
   }
 
   auto localAddress = address - modbusAddressOffset;
-
-  if (access == Supla::Modbus::Access::READ) {
-    memset(regBuffer, 0, nRegs * 2);
-    for (int reg = 0; reg < nRegs; reg++) {
-      // block 0 -> common
-      // block 1 -> phase 1
-      // block 2 -> phase 2
-      // block 3 -> phase 3
-      auto registersBlock = (localAddress + reg) / EM_REGISTER_BLOCK_MAX_SIZE;
-      auto addressInsideBlock =
-          (localAddress + reg) % EM_REGISTER_BLOCK_MAX_SIZE;
-
-      if (registersBlock == 0) {
-        switch (addressInsideBlock) {
-          case EM_COMMON_REG_FREQUENCY: {
-            auto freq = em->getFreq();
-            // store in big endian format
-            *(regBuffer++) = freq >> 8;
-            *(regBuffer++) = freq & 0xFF;
-            break;
-          }
-          case EM_COMMON_REG_VOLTAGE_PHASE_SEQUENCE: {
-            if (em->isVoltagePhaseSequenceSet()) {
-              uint8_t value = 1;
-              if (em->isVoltagePhaseSequenceClockwise()) {
-                value = 2;
-              }
-              regBuffer++;  // empty byte
-              *(regBuffer++) = value;
-            }
-            break;
-          }
-          case EM_COMMON_REG_CURRENT_PHASE_SEQUENCE: {
-            if (em->isCurrentPhaseSequenceSet()) {
-              uint8_t value = 1;
-              if (em->isCurrentPhaseSequenceClockwise()) {
-                value = 2;
-              }
-              regBuffer++;  // empty byte
-              *(regBuffer++) = value;
-            }
-            break;
-          }
-          case EM_COMMON_REG_VOLTAGE_PHASE_ANGLE_12: {
-            auto angle = em->getVoltagePhaseAngle12();
-            // store in big endian format
-            *(regBuffer++) = angle >> 8;
-            *(regBuffer++) = angle & 0xFF;
-            break;
-          }
-          case EM_COMMON_REG_VOLTAGE_PHASE_ANGLE_13: {
-            auto angle = em->getVoltagePhaseAngle13();
-            // store in big endian format
-            *(regBuffer++) = angle >> 8;
-            *(regBuffer++) = angle & 0xFF;
-            break;
-          }
-          case EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE:
-          case EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE + 1:
-          case EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE + 2:
-          case EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE + 3: {
-            auto value = em->getFwdBalancedActEnergy();
-            value = 0x0123456789ABCDEF;
-            // store in big endian format
-            int regOffset = addressInsideBlock -
-                            EM_COMMON_REG_FORWARD_ACTIVE_ENERGY_VECTOR_BALANCE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(value, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE:
-          case EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE + 1:
-          case EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE + 2:
-          case EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE + 3: {
-            auto value = em->getRvrBalancedActEnergy();
-            // store in big endian format
-            int regOffset = addressInsideBlock -
-                            EM_COMMON_REG_REVERSE_ACTIVE_ENERGY_VECTOR_BALANCE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(value, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-        }
-      } else if (registersBlock < 4) {
-        auto phase = registersBlock - 1;
-        switch (addressInsideBlock) {
-          case EM_PHASE_REG_VOLTAGE: {
-            auto voltage = em->getVoltage(phase);
-            // store in big endian format
-            *(regBuffer++) = voltage >> 8;
-            *(regBuffer++) = voltage & 0xFF;
-            break;
-          }
-          case EM_PHASE_REG_PHASE_ANGLE: {
-            auto angle = em->getPhaseAngle(phase);
-            // store in big endian format
-            *(regBuffer++) = angle >> 8;
-            *(regBuffer++) = angle & 0xFF;
-            break;
-          }
-          case EM_PHASE_REG_POWER_FACTOR: {
-            auto factor = em->getPowerFactor(phase);
-            // store in big endian format
-            *(regBuffer++) = factor >> 8;
-            *(regBuffer++) = factor & 0xFF;
-            break;
-          }
-          case EM_PHASE_REG_CURRENT:
-          case EM_PHASE_REG_CURRENT + 1: {
-            auto current = em->getCurrent(phase);
-            // store in big endian format
-            int regOffset = addressInsideBlock - EM_PHASE_REG_CURRENT + 2;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(current, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_POWER_ACTIVE:
-          case EM_PHASE_REG_POWER_ACTIVE + 1: {
-            // active power is in int64 in 0.00001 W units
-            // We will use int32 with 0.001 W units
-            auto active = em->getPowerActive(phase);
-            int32_t value = active / 100;
-            // store in big endian format
-            int regOffset = addressInsideBlock - EM_PHASE_REG_POWER_ACTIVE + 2;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(value, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_POWER_REACTIVE:
-          case EM_PHASE_REG_POWER_REACTIVE + 1: {
-            // reactive power is in int64 in 0.00001 W units
-            // We will use int32 with 0.001 W units
-            auto reactive = em->getPowerReactive(phase);
-            int32_t value = reactive / 100;
-            // store in big endian format
-            int regOffset =
-                addressInsideBlock - EM_PHASE_REG_POWER_REACTIVE + 2;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(value, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_POWER_APPARENT:
-          case EM_PHASE_REG_POWER_APPARENT + 1: {
-            // apparent power is in int64 in 0.00001 W units
-            // We will use int32 with 0.001 W units
-            auto apparent = em->getPowerApparent(phase);
-            int32_t value = apparent / 100;
-            // store in big endian format
-            int regOffset =
-                addressInsideBlock - EM_PHASE_REG_POWER_APPARENT + 2;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(value, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_FWD_ENERGY_ACTIVE:
-          case EM_PHASE_REG_FWD_ENERGY_ACTIVE + 1:
-          case EM_PHASE_REG_FWD_ENERGY_ACTIVE + 2:
-          case EM_PHASE_REG_FWD_ENERGY_ACTIVE + 3: {
-            auto energy = em->getFwdActEnergy(phase);
-            // store in big endian format
-            int regOffset = addressInsideBlock - EM_PHASE_REG_FWD_ENERGY_ACTIVE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(energy, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_RVR_ENERGY_ACTIVE:
-          case EM_PHASE_REG_RVR_ENERGY_ACTIVE + 1:
-          case EM_PHASE_REG_RVR_ENERGY_ACTIVE + 2:
-          case EM_PHASE_REG_RVR_ENERGY_ACTIVE + 3: {
-            auto energy = em->getRvrActEnergy(phase);
-            // store in big endian format
-            int regOffset = addressInsideBlock - EM_PHASE_REG_RVR_ENERGY_ACTIVE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(energy, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_FWD_ENERGY_REACTIVE:
-          case EM_PHASE_REG_FWD_ENERGY_REACTIVE + 1:
-          case EM_PHASE_REG_FWD_ENERGY_REACTIVE + 2:
-          case EM_PHASE_REG_FWD_ENERGY_REACTIVE + 3: {
-            auto energy = em->getFwdReactEnergy(phase);
-            // store in big endian format
-            int regOffset =
-                addressInsideBlock - EM_PHASE_REG_FWD_ENERGY_REACTIVE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(energy, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-          case EM_PHASE_REG_RVR_ENERGY_REACTIVE:
-          case EM_PHASE_REG_RVR_ENERGY_REACTIVE + 1:
-          case EM_PHASE_REG_RVR_ENERGY_REACTIVE + 2:
-          case EM_PHASE_REG_RVR_ENERGY_REACTIVE + 3: {
-            auto energy = em->getRvrReactEnergy(phase);
-            // store in big endian format
-            int regOffset =
-                addressInsideBlock - EM_PHASE_REG_RVR_ENERGY_REACTIVE;
-            int size = nRegs - reg;
-            if (size > 4 - regOffset) {
-              size = 4 - regOffset;
-            }
-            storeBigEndian(energy, regBuffer, regOffset, size);
-            reg += size - 1;
-            regBuffer += size * 2;
-            break;
-          }
-        }
-      } else {
-        return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
-      }
+  // Copy is repeated when image was being written before or during it
+  for (int attempt = 0; attempt < EM_IMAGE_READ_ATTEMPTS; attempt++) {
+    uint32_t sequence = beginImageRead();
+    if (sequence & 1) {
+      continue;
+    }
+    memcpy(regBuffer, image + localAddress * 2, nRegs * 2);
+    if (validateImageRead(sequence)) {
+      return Supla::Modbus::Result::OK;
     }
-    return Supla::Modbus::Result::OK;
   }
-
-  return Supla::Modbus::Result::INVALID_REGISTER_ADDRESS;
+  return Supla::Modbus::Result::INVALID_STATE;
 }
 
 bool ModbusEMHandler::isHoldingSupported() {
@@ -4,6 +4,9 @@
 #ifndef SRC_SUPLA_MODBUS_MODBUS_EM_HANDLER_H_
 #define SRC_SUPLA_MODBUS_MODBUS_EM_HANDLER_H_
 
+#include <supla/action_handler.h>
+#include <supla/sensor/em_aggregation.h>
+
 #include "modbus_client_handler.h"
 
 #define EM_REGISTER_BLOCK_MAX_SIZE (30)
@@ -14,7 +17,17 @@ namespace Sensor {
 class ElectricityMeter;
 }  // namespace Sensor
 
-class ModbusEMHandler : public ModbusClientHandler {
+/**
+ * Exposes ElectricityMeter values as holding/input registers.
+ *
+ * Registers are kept in a precomputed big-endian image, which is refreshed
+ * when ElectricityMeter publishes new values (ON_CHANGE from
+ * updateChannelValues), so Modbus read is only a memcpy. Image is built in
+ * a staging buffer and published under a sequence lock, so multi-register
+ * read (which may run in Modbus task on other core) always returns values
+ * from a single update.
+ */
+class ModbusEMHandler : public ModbusClientHandler, public ActionHandler {
  public:
   explicit ModbusEMHandler(Supla::Sensor::ElectricityMeter *em,
                            uint16_t offset = 0);
@@ -26,8 +39,40 @@ class ModbusEMHandler : public ModbusClientHandler {
   bool isHoldingSupported() override;
   bool isInputSupported() override;
 
- private:
+  void handleAction(int event, int action) override;
+
+  // Voltage, current and powers are taken from EM sample aggregation
+  // window with given mode instead of values sent in the channel (used only
+  // when aggregation is enabled in EM)
+  void setAggregationMode(Supla::Sensor::EmAggregationMode mode);
+
+  // Rebuilds register image from current EM values
+  void updateRegisterImage();
+  // Incremented on each register image update
+  uint32_t getImageVersion() const;
+
+ protected:
+  // Sequence lock: odd sequence means that image is being written.
+  // Writer side (called only from updateRegisterImage):
+  void beginImageWrite();
+  void endImageWrite();
+  // Reader side: readImage copy is valid only if validateImageRead returns
+  // true for sequence returned by beginImageRead
+  uint32_t beginImageRead() const;
+  bool validateImageRead(uint32_t sequence) const;
+
+  // Returns value used in register image
+  int64_t getValue(Supla::Sensor::EmAggregatedValue value, int phase) const;
+
   Supla::Sensor::ElectricityMeter *em = nullptr;
+  bool aggregationModeSet = false;
+  Supla::Sensor::EmAggregationMode aggregationMode =
+      Supla::Sensor::EmAggregationMode::Last;
+  // written only by updateRegisterImage
+  uint8_t staging[4 * EM_REGISTER_BLOCK_MAX_SIZE * 2] = {};
+  // published copy of staging, read by Modbus requests
+  uint8_t image[4 * EM_REGISTER_BLOCK_MAX_SIZE * 2] = {};
+  uint32_t imageSequence = 0;
 };
 
 }  // namespace Supla
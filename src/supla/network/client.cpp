@@ -20,6 +20,18 @@ Supla::ConnectionError Supla::Client::getConnectionError() const {
   return Supla::ConnectionError::NONE;
 }
 
+bool Supla::Client::isConnecting() {
+  return false;
+}
+
+void Supla::Client::setNonBlockingConnect(bool enabled) {
+  nonBlockingConnect = enabled;
+}
+
+bool Supla::Client::isNonBlockingConnect() const {
+  return nonBlockingConnect;
+}
+
 int Supla::Client::connect(IPAddress ip, uint16_t port) {
   char server[100] = {};
   snprintf(server,
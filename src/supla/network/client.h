@@ -31,6 +31,14 @@ class Client {
   virtual uint8_t connected() = 0;
   virtual void setTimeoutMs(uint16_t timeoutMs) = 0;
   virtual ConnectionError getConnectionError() const;
+  // Returns true when connect() returned before connection was fully
+  // established (i.e. TLS handshake is continued in background). Connection
+  // can't be used for data exchange until it returns false.
+  virtual bool isConnecting();
+  // Allows connect() to return before connection is established (see
+  // isConnecting()). Ignored on platforms which always connect synchronously.
+  void setNonBlockingConnect(bool enabled);
+  bool isNonBlockingConnect() const;
 
   int connect(IPAddress ip, uint16_t port);
   int connect(const char *host, uint16_t port);
@@ -68,6 +76,7 @@ class Client {
 
   bool sslEnabled = false;
   bool debugLogs = false;
+  bool nonBlockingConnect = false;
   const char *rootCACert = nullptr;
   unsigned int rootCACertSize = 0;
   SuplaDeviceClass *sdc = nullptr;
@@ -0,0 +1,230 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef ARDUINO_ARCH_AVR
+#include "channel_reporting_policy.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <supla/channels/channel.h>
+#include <supla/network/web_sender.h>
+#include <supla/storage/config.h>
+#include <supla/tools.h>
+
+using Supla::Html::ChannelReportingPolicy;
+
+namespace {
+
+const char DeadbandField[] = "rpdb";
+const char DeadbandTypeField[] = "rpdt";
+const char MinIntervalField[] = "rpmin";
+const char MaxIntervalField[] = "rpmax";
+const char CoalescingField[] = "rpco";
+
+// deadband in 0.001 units
+constexpr int32_t DeadbandMax = 1000000;
+// intervals are edited in 0.1 s
+constexpr int32_t MinIntervalMax = 36000;
+constexpr int32_t MaxIntervalMax = 864000;
+
+}  // namespace
+
+ChannelReportingPolicy::ChannelReportingPolicy(int channelNumber,
+                                               const char *displayName)
+    : HtmlElement(HTML_SECTION_FORM), channelNumber(channelNumber) {
+  if (displayName) {
+    int size = strlen(displayName);
+    this->displayName = new char[size + 1];
+    if (this->displayName) {
+      snprintf(this->displayName, size + 1, "%s", displayName);
+    }
+  }
+}
+
+ChannelReportingPolicy::~ChannelReportingPolicy() {
+  if (displayName) {
+    delete[] displayName;
+    displayName = nullptr;
+  }
+}
+
+void ChannelReportingPolicy::generateKey(char *key, const char *field) const {
+  snprintf(key, SUPLA_CONFIG_MAX_KEY_SIZE, "%s_%d", field, channelNumber);
+}
+
+void ChannelReportingPolicy::loadConfig() {
+  if (configLoaded) {
+    return;
+  }
+  originalConfig = {};
+  if (!Supla::ReportingPolicy::LoadConfig(channelNumber, &originalConfig)) {
+    // use policy set from code
+    auto channel = Supla::Channel::GetByChannelNumber(channelNumber);
+    if (channel && channel->getReportingPolicy()) {
+      originalConfig = channel->getReportingPolicy()->getConfig();
+    }
+  }
+  pendingConfig = originalConfig;
+  configLoaded = true;
+}
+
+void ChannelReportingPolicy::send(Supla::WebSender *sender) {
+  configLoaded = false;
+  loadConfig();
+
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  char label[100] = {};
+  const char *name = displayName ? displayName : "";
+  const char *separator = displayName ? " " : "";
+
+  generateKey(key, DeadbandTypeField);
+  snprintf(label, sizeof(label), "#%d%s%s reporting deadband",
+      channelNumber, separator, name);
+  sender->labeledField(key, label, [&]() {
+    sender->selectInput(key, key, [&]() {
+      auto type = pendingConfig.deadbandType;
+      sender->selectOption(static_cast<int>(ReportingDeadbandType::None),
+                           "Off",
+                           type == ReportingDeadbandType::None);
+      sender->selectOption(static_cast<int>(ReportingDeadbandType::Absolute),
+                           "Absolute",
+                           type == ReportingDeadbandType::Absolute);
+      sender->selectOption(static_cast<int>(ReportingDeadbandType::Relative),
+                           "Relative [%]",
+                           type == ReportingDeadbandType::Relative);
+    });
+  });
+
+  generateKey(key, DeadbandField);
+  snprintf(label, sizeof(label), "#%d%s%s deadband value",
+      channelNumber, separator, name);
+  sender->labeledField(key, label, [&]() {
+    sender->numberInput(
+        key,
+        {
+            .min = fixed(0, 3),
+            .max = fixed(DeadbandMax, 3),
+            .value = fixed(static_cast<int>(pendingConfig.deadband), 3),
+            .step = fixed(1, 3),
+        });
+  });
+
+  generateKey(key, MinIntervalField);
+  snprintf(label, sizeof(label), "#%d%s%s min report interval [s]",
+      channelNumber, separator, name);
+  sender->labeledField(key, label, [&]() {
+    sender->numberInput(
+        key,
+        {
+            .min = fixed(0, 1),
+            .max = fixed(MinIntervalMax, 1),
+            .value = fixed(
+                static_cast<int>(pendingConfig.minIntervalMs / 100), 1),
+            .step = fixed(1, 1),
+        });
+  });
+
+  generateKey(key, MaxIntervalField);
+  snprintf(label, sizeof(label), "#%d%s%s max report interval [s]",
+      channelNumber, separator, name);
+  sender->labeledField(key, label, [&]() {
+    sender->numberInput(
+        key,
+        {
+            .min = fixed(0, 1),
+            .max = fixed(MaxIntervalMax, 1),
+            .value = fixed(
+                static_cast<int>(pendingConfig.maxIntervalMs / 100), 1),
+            .step = fixed(1, 1),
+        });
+  });
+
+  generateKey(key, CoalescingField);
+  snprintf(label, sizeof(label), "#%d%s%s changes within min interval",
+      channelNumber, separator, name);
+  sender->labeledField(key, label, [&]() {
+    sender->selectInput(key, key, [&]() {
+      sender->selectOption(1, "Send latest", pendingConfig.coalescing);
+      sender->selectOption(0, "Drop", !pendingConfig.coalescing);
+    });
+  });
+}
+
+bool ChannelReportingPolicy::handleResponse(const char *key,
+                                            const char *value) {
+  if (key == nullptr || value == nullptr) {
+    return false;
+  }
+  char keyRef[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+
+  generateKey(keyRef, DeadbandTypeField);
+  if (strcmp(key, keyRef) == 0) {
+    int32_t type = stringToInt(value);
+    if (type >= static_cast<int>(ReportingDeadbandType::None) &&
+        type <= static_cast<int>(ReportingDeadbandType::Relative)) {
+      loadConfig();
+      pendingConfig.deadbandType = static_cast<ReportingDeadbandType>(type);
+      fieldFound = true;
+    }
+    return true;
+  }
+
+  generateKey(keyRef, DeadbandField);
+  if (strcmp(key, keyRef) == 0) {
+    int32_t deadband = floatStringToInt(value, 3);
+    if (deadband >= 0 && deadband <= DeadbandMax) {
+      loadConfig();
+      pendingConfig.deadband = deadband;
+      fieldFound = true;
+    }
+    return true;
+  }
+
+  generateKey(keyRef, MinIntervalField);
+  if (strcmp(key, keyRef) == 0) {
+    int32_t interval = floatStringToInt(value, 1);
+    if (interval >= 0 && interval <= MinIntervalMax) {
+      loadConfig();
+      pendingConfig.minIntervalMs = interval * 100;
+      fieldFound = true;
+    }
+    return true;
+  }
+
+  generateKey(keyRef, MaxIntervalField);
+  if (strcmp(key, keyRef) == 0) {
+    int32_t interval = floatStringToInt(value, 1);
+    if (interval >= 0 && interval <= MaxIntervalMax) {
+      loadConfig();
+      pendingConfig.maxIntervalMs = interval * 100;
+      fieldFound = true;
+    }
+    return true;
+  }
+
+  generateKey(keyRef, CoalescingField);
+  if (strcmp(key, keyRef) == 0) {
+    loadConfig();
+    pendingConfig.coalescing = (strcmp(value, "0") == 0) ? 0 : 1;
+    fieldFound = true;
+    return true;
+  }
+
+  return false;
+}
+
+void ChannelReportingPolicy::onProcessingEnd() {
+  if (fieldFound && pendingConfig != originalConfig) {
+    if (Supla::ReportingPolicy::SaveConfig(channelNumber, pendingConfig)) {
+      auto channel = Supla::Channel::GetByChannelNumber(channelNumber);
+      if (channel) {
+        channel->setReportingPolicy(pendingConfig);
+      }
+    }
+  }
+  configLoaded = false;
+  fieldFound = false;
+}
+
+#endif  // ARDUINO_ARCH_AVR
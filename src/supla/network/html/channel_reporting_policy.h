@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_NETWORK_HTML_CHANNEL_REPORTING_POLICY_H_
+#define SRC_SUPLA_NETWORK_HTML_CHANNEL_REPORTING_POLICY_H_
+
+#include <supla/channels/reporting_policy.h>
+#include <supla/network/html_element.h>
+
+namespace Supla {
+
+namespace Html {
+
+// Deadband, min/max send interval and coalescing of channel value updates
+class ChannelReportingPolicy : public HtmlElement {
+ public:
+  ChannelReportingPolicy(int channelNumber, const char *displayName);
+  virtual ~ChannelReportingPolicy();
+  void send(Supla::WebSender *sender) override;
+  bool handleResponse(const char *key, const char *value) override;
+  void onProcessingEnd() override;
+
+ protected:
+  void loadConfig();
+  void generateKey(char *key, const char *field) const;
+
+  int channelNumber = -1;
+  char *displayName = nullptr;
+  Supla::ReportingPolicyConfig originalConfig;
+  Supla::ReportingPolicyConfig pendingConfig;
+  bool configLoaded = false;
+  bool fieldFound = false;
+};
+
+};  // namespace Html
+};  // namespace Supla
+
+#endif  // SRC_SUPLA_NETWORK_HTML_CHANNEL_REPORTING_POLICY_H_
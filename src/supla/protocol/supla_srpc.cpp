@@ -2116,13 +2116,20 @@ bool Supla::Protocol::SuplaSrpc::iterate(uint32_t _millis) {
         port = 2015;
       }
     }
-    int result = client->connect(Supla::RegisterDevice::getServerName(), port);
+    int result = 0;
+    if (connectInProgress) {
+      // connection started in background in previous iteration failed
+      connectInProgress = false;
+    } else {
+      result = client->connect(Supla::RegisterDevice::getServerName(), port);
+    }
     if (1 == result) {
-      sdc->uptime.resetConnectionUptime();
-      connectionFailCounter = 0;
-      //      lastConnectionResetCounter = 0;
-      SUPLA_LOG_INFO("Connected to Supla Server");
-      initializeSrpc();
+      if (client->isConnecting()) {
+        // TCP connect/TLS handshake is continued by client in background
+        connectInProgress = true;
+        return false;
+      }
+      onServerConnected();
     } else {
       if (!firstConnectionAttempt) {
         sdc->status(STATUS_SERVER_DISCONNECTED,
@@ -2142,6 +2149,14 @@ bool Supla::Protocol::SuplaSrpc::iterate(uint32_t _millis) {
     }
   }
 
+  if (connectInProgress) {
+    if (client->isConnecting()) {
+      return false;
+    }
+    connectInProgress = false;
+    onServerConnected();
+  }
+
   char srpcIterateResult = srpc_iterate_device(srpc);
 
   if (writeFailure) {
@@ -2273,6 +2288,13 @@ void Supla::Protocol::SuplaSrpc::addLastStateAdError(char *buf) {
   }
 }
 
+void Supla::Protocol::SuplaSrpc::onServerConnected() {
+  sdc->uptime.resetConnectionUptime();
+  connectionFailCounter = 0;
+  SUPLA_LOG_INFO("Connected to Supla Server");
+  initializeSrpc();
+}
+
 void Supla::Protocol::SuplaSrpc::disconnect() {
   versionErrorDisconnectPending = false;
   if (!isEnabled()) {
@@ -2280,6 +2302,7 @@ void Supla::Protocol::SuplaSrpc::disconnect() {
   }
 
   firstConnectionAttempt = true;
+  connectInProgress = false;
   registered = 0;
   if (client) {
     client->stop();
@@ -170,6 +170,7 @@ class SuplaSrpc : public ProtocolLayer {
   bool ping();
   void scheduleReconnect(uint32_t now);
   void initializeSrpc();
+  void onServerConnected();
   void deinitializeSrpc();
   void addLastStateAdError(char *buf);
 
@@ -181,6 +182,7 @@ class SuplaSrpc : public ProtocolLayer {
   bool enabled = true;
   bool setDeviceConfigReceivedAfterRegistration = false;
   bool firstConnectionAttempt = true;
+  bool connectInProgress = false;
   bool adErrorLogged = false;
   bool writeFailure = false;
   uint8_t autodiscoverRetryCounter = 0;
@@ -13,87 +13,24 @@ namespace Supla {
 namespace PV {
 
 Afore::Afore(IPAddress ip, int port, const char *loginAndPass)
-    : ip(ip),
-      port(port),
-      buf(),
+    : poller(this),
       totalGeneratedEnergy(0),
       currentPower(0),
-      bytesCounter(0),
       retryCounter(0),
-      vFound(false),
-      varFound(false),
       dataIsReady(false),
-      dataFetchInProgress(false),
-      connectionTimeoutMs(0) {
+      powerFound(false) {
   refreshRateSec = 15;
   int len = strlen(loginAndPass);
-  if (len > LOGIN_AND_PASSOWORD_MAX_LENGTH) {
-    len = LOGIN_AND_PASSOWORD_MAX_LENGTH;
+  if (len > LOGIN_AND_PASSOWORD_MAX_LENGTH - 1) {
+    len = LOGIN_AND_PASSOWORD_MAX_LENGTH - 1;
   }
   strncpy(loginAndPassword, loginAndPass, len);
-  client = Supla::ClientBuilder();
+  poller.setServer(ip, port);
+  poller.setLineMode(79);
 }
 
 void Afore::iterateAlways() {
-  if (dataFetchInProgress) {
-    if (millis() - connectionTimeoutMs > 30000) {
-      SUPLA_LOG_DEBUG(
-                "AFORE: connection timeout. Remote host is not responding");
-      client->stop();
-      dataFetchInProgress = false;
-      dataIsReady = false;
-      return;
-    }
-    if (!client->connected()) {
-      SUPLA_LOG_DEBUG("AFORE fetch completed");
-      dataFetchInProgress = false;
-      dataIsReady = true;
-    }
-    if (client->available()) {
-      SUPLA_LOG_DEBUG("Reading data from afore: %d", client->available());
-    }
-    while (client->available()) {
-      char c;
-      c = client->read();
-      if (c == '\n') {
-        if (varFound) {
-          if (bytesCounter > 79) bytesCounter = 79;
-          buf[bytesCounter] = '\0';
-          char varName[80];
-          char varValue[80];
-          sscanf(buf, "%s = \"%s\";", varName, varValue);
-          if (strncmp(varName, "webdata_now_p", strlen("webdata_now_p")) == 0) {
-            float curPower = atof(varValue);
-            currentPower = curPower * 100000;
-          }
-          if (strncmp(varName, "webdata_total_e", strlen("webdata_total_e")) ==
-              0) {
-            float totalProd = atof(varValue);
-
-            totalGeneratedEnergy = totalProd * 100000;
-          }
-        }
-        bytesCounter = 0;
-        vFound = false;
-        varFound = false;
-      } else if (c == 'v' || vFound) {
-        vFound = true;
-        if (bytesCounter < 80) {
-          buf[bytesCounter] = c;
-        }
-        bytesCounter++;
-        if (bytesCounter == 4 && !varFound) {
-          if (strncmp(buf, "var ", 4) == 0) {
-            varFound = true;
-            bytesCounter = 0;
-          }
-        }
-      }
-    }
-    if (!client->connected()) {
-      client->stop();
-    }
-  }
+  poller.iterate();
   if (dataIsReady) {
     dataIsReady = false;
     setFwdActEnergy(0, totalGeneratedEnergy);
@@ -103,34 +40,67 @@ void Afore::iterateAlways() {
 }
 
 bool Afore::iterateConnected() {
-  if (!dataFetchInProgress) {
+  if (!poller.isBusy()) {
     if (lastReadTime == 0 || millis() - lastReadTime > refreshRateSec * 1000) {
       lastReadTime = millis();
       SUPLA_LOG_DEBUG("AFORE connecting");
-      if (client->connect(ip, port)) {
-        retryCounter = 0;
-        dataFetchInProgress = true;
-        connectionTimeoutMs = lastReadTime;
-
-        client->print("GET /status.html HTTP/1.1\nAuthorization: Basic ");
-        client->println(loginAndPassword);
-        client->println("Connection: close");
-        client->println();
-
-      } else {  // if connection wasn't successful, try few times. If it fails,
-                // then assume that inverter is off during the night
+      char headers[LOGIN_AND_PASSOWORD_MAX_LENGTH + 32] = {};
+      snprintf(headers,
+               sizeof(headers),
+               "Authorization: Basic %s\r\n",
+               loginAndPassword);
+      powerFound = false;
+      if (!poller.sendRequest("/status.html", headers)) {
         SUPLA_LOG_DEBUG("Failed to connect to Afore");
-        retryCounter++;
-        if (retryCounter > 3) {
-          currentPower = 0;
-          dataIsReady = true;
-        }
+        onReadFailed();
       }
     }
   }
   return Element::iterateConnected();
 }
 
+void Afore::onReadFailed() {
+  // if read wasn't successful, try few times. If it fails, then assume that
+  // inverter is off during the night
+  retryCounter++;
+  if (retryCounter > 3) {
+    currentPower = 0;
+    dataIsReady = true;
+  }
+}
+
+void Afore::onHttpBodyLine(char *line) {
+  const char *var = strstr(line, "var ");
+  if (var == nullptr) {
+    return;
+  }
+  char varName[80];
+  char varValue[80];
+  if (sscanf(var + 4, "%79s = \"%79s", varName, varValue) != 2) {
+    return;
+  }
+  if (strncmp(varName, "webdata_now_p", strlen("webdata_now_p")) == 0) {
+    float curPower = atof(varValue);
+    currentPower = curPower * 100000;
+    powerFound = true;
+  }
+  if (strncmp(varName, "webdata_total_e", strlen("webdata_total_e")) == 0) {
+    float totalProd = atof(varValue);
+    totalGeneratedEnergy = totalProd * 100000;
+  }
+}
+
+void Afore::onHttpResponseComplete(bool success, int statusCode) {
+  if (!success || statusCode != 200 || !powerFound) {
+    SUPLA_LOG_DEBUG("AFORE: query failed (status: %d)", statusCode);
+    onReadFailed();
+    return;
+  }
+  retryCounter = 0;
+  SUPLA_LOG_DEBUG("AFORE fetch completed");
+  dataIsReady = true;
+}
+
 void Afore::readValuesFromDevice() {
 }
 
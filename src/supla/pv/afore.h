@@ -4,36 +4,36 @@
 #ifndef SRC_SUPLA_PV_AFORE_H_
 #define SRC_SUPLA_PV_AFORE_H_
 
-#include <IPAddress.h>
+#include <supla/network/ip_address.h>
 #include <supla/sensor/one_phase_electricity_meter.h>
-#include <supla/network/client.h>
+
+#include "http_poller.h"
 
 #define LOGIN_AND_PASSOWORD_MAX_LENGTH 100
 
 namespace Supla {
 namespace PV {
-class Afore : public Supla::Sensor::OnePhaseElectricityMeter {
+class Afore : public Supla::Sensor::OnePhaseElectricityMeter,
+              public HttpResponseHandler {
  public:
   Afore(IPAddress ip, int port, const char *loginAndPassword);
   void readValuesFromDevice();
   void iterateAlways();
   bool iterateConnected();
 
+  void onHttpBodyLine(char *line) override;
+  void onHttpResponseComplete(bool success, int statusCode) override;
+
  protected:
-  ::Supla::Client *client = nullptr;
-  IPAddress ip;
-  int port;
-  char loginAndPassword[LOGIN_AND_PASSOWORD_MAX_LENGTH];
-  char buf[80];
+  void onReadFailed();
+
+  HttpPoller poller;
+  char loginAndPassword[LOGIN_AND_PASSOWORD_MAX_LENGTH] = {};
   unsigned _supla_int64_t totalGeneratedEnergy;
   _supla_int_t currentPower;
-  int bytesCounter;
   int retryCounter;
-  bool vFound;
-  bool varFound;
   bool dataIsReady;
-  bool dataFetchInProgress;
-  uint32_t connectionTimeoutMs;
+  bool powerFound;
 };
 };  // namespace PV
 };  // namespace Supla
@@ -9,12 +9,55 @@
 #include <supla/log_wrapper.h>
 #include <supla/time.h>
 
-#include "supla/network/client.h"
-
 #define FRONIUS_SINGLE_PHASE_INVERTER 0
 #define FRONIUS_THREE_PHASE_INVERTER  1
 #define FRONIUS_THREE_PHASE_METER     2
 
+#define FRONIUS_DATA_PATH "Body/Data/"
+
+namespace {
+
+// Inverter values are objects with "Value" and "Unit" members
+const char *const inverterKeys[] = {
+    FRONIUS_DATA_PATH "TOTAL_ENERGY/Value",
+    FRONIUS_DATA_PATH "PAC/Value",
+    FRONIUS_DATA_PATH "FAC/Value",
+    FRONIUS_DATA_PATH "IAC/Value",
+    FRONIUS_DATA_PATH "UAC/Value",
+    FRONIUS_DATA_PATH "IAC_L1/Value",
+    FRONIUS_DATA_PATH "IAC_L2/Value",
+    FRONIUS_DATA_PATH "IAC_L3/Value",
+    FRONIUS_DATA_PATH "UAC_L1/Value",
+    FRONIUS_DATA_PATH "UAC_L2/Value",
+    FRONIUS_DATA_PATH "UAC_L3/Value"};
+
+const char *const meterKeys[] = {
+    FRONIUS_DATA_PATH "Current_AC_Phase_1",
+    FRONIUS_DATA_PATH "Current_AC_Phase_2",
+    FRONIUS_DATA_PATH "Current_AC_Phase_3",
+    FRONIUS_DATA_PATH "EnergyReactive_VArAC_Sum_Consumed",
+    FRONIUS_DATA_PATH "EnergyReactive_VArAC_Sum_Produced",
+    FRONIUS_DATA_PATH "EnergyReal_WAC_Sum_Consumed",
+    FRONIUS_DATA_PATH "EnergyReal_WAC_Sum_Produced",
+    FRONIUS_DATA_PATH "Frequency_Phase_Average",
+    FRONIUS_DATA_PATH "PowerApparent_S_Phase_1",
+    FRONIUS_DATA_PATH "PowerApparent_S_Phase_2",
+    FRONIUS_DATA_PATH "PowerApparent_S_Phase_3",
+    FRONIUS_DATA_PATH "PowerFactor_Phase_1",
+    FRONIUS_DATA_PATH "PowerFactor_Phase_2",
+    FRONIUS_DATA_PATH "PowerFactor_Phase_3",
+    FRONIUS_DATA_PATH "PowerReactive_Q_Phase_1",
+    FRONIUS_DATA_PATH "PowerReactive_Q_Phase_2",
+    FRONIUS_DATA_PATH "PowerReactive_Q_Phase_3",
+    FRONIUS_DATA_PATH "PowerReal_P_Phase_1",
+    FRONIUS_DATA_PATH "PowerReal_P_Phase_2",
+    FRONIUS_DATA_PATH "PowerReal_P_Phase_3",
+    FRONIUS_DATA_PATH "Voltage_AC_Phase_1",
+    FRONIUS_DATA_PATH "Voltage_AC_Phase_2",
+    FRONIUS_DATA_PATH "Voltage_AC_Phase_3"};
+
+}  // namespace
+
 namespace Supla {
 namespace PV {
 
@@ -25,7 +68,8 @@ bool Fronius::isDeviceTypeSupported(int deviceType) {
 }
 
 Fronius::Fronius(IPAddress ip, int port, int deviceId, int deviceType)
-    : ip(ip), port(port),
+    : poller(this),
+      tokenizer(this),
       deviceType(isDeviceTypeSupported(deviceType)
                      ? deviceType
                      : FRONIUS_SINGLE_PHASE_INVERTER),
@@ -38,15 +82,22 @@ Fronius::Fronius(IPAddress ip, int port, int deviceId, int deviceType)
     extChannel.setFlag(SUPLA_CHANNEL_FLAG_PHASE3_UNSUPPORTED);
   }
   refreshRateSec = 15;
-  client = Supla::ClientBuilder();
+  poller.setServer(ip, port);
+  if (this->deviceType == FRONIUS_THREE_PHASE_METER) {
+    keys = meterKeys;
+    tokenizer.setKeys(meterKeys, sizeof(meterKeys) / sizeof(meterKeys[0]));
+  } else {
+    keys = inverterKeys;
+    tokenizer.setKeys(inverterKeys,
+                      sizeof(inverterKeys) / sizeof(inverterKeys[0]));
+  }
 }
 
 Fronius::~Fronius() {
-  delete client;
-  client = nullptr;
 }
 
-void Fronius::getSinglePhaseInverterValues(char* varName, char* varValue) {
+void Fronius::getSinglePhaseInverterValues(const char* varName,
+                                           const char* varValue) {
   if (strncmp(varName, "TOTAL_ENERGY", strlen("TOTAL_ENERGY")) == 0) {
     totalGeneratedEnergy = atof(varValue) * 100;
     /* received data from inverter, so increment counter
@@ -66,7 +117,8 @@ void Fronius::getSinglePhaseInverterValues(char* varName, char* varValue) {
   }
 }
 
-void Fronius::getThreePhaseInverterValues(char* varName, char* varValue) {
+void Fronius::getThreePhaseInverterValues(const char* varName,
+                                          const char* varValue) {
   if (strncmp(varName, "TOTAL_ENERGY", strlen("TOTAL_ENERGY")) == 0) {
     totalGeneratedEnergy = atof(varValue) * 100;
     /* received data from inverter, so increment counter
@@ -94,7 +146,8 @@ void Fronius::getThreePhaseInverterValues(char* varName, char* varValue) {
   }
 }
 
-void Fronius::getThreePhaseMeterValues(char* varName, char* varValue) {
+void Fronius::getThreePhaseMeterValues(const char* varName,
+                                       const char* varValue) {
   if (strncmp(varName, "Current_AC_Phase_1", strlen("Current_AC_Phase_1")) ==
       0) {
     currentCurrent[0] = atof(varValue) * 1000;
@@ -287,78 +340,7 @@ void Fronius::setThreePhaseMeterValues(bool zeroValues) {
 }
 
 void Fronius::iterateAlways() {
-  if (dataFetchInProgress) {
-    if (millis() - connectionTimeoutMs > 30000) {
-      SUPLA_LOG_DEBUG(
-          "Fronius: connection timeout. Remote host is not responding");
-      client->stop();
-      dataFetchInProgress = false;
-      dataIsReady = false;
-      return;
-    }
-    if (!client->connected()) {
-      SUPLA_LOG_DEBUG("Fronius fetch completed");
-      dataFetchInProgress = false;
-      dataIsReady = true;
-    }
-    if (client->available()) {
-      SUPLA_LOG_DEBUG("Reading data from Fronius: %d", client->available());
-    }
-    while (client->available()) {
-      char c;
-      c = client->read();
-      if (c == '\n') {
-        if (startCharFound) {
-          if (bytesCounter > 79) bytesCounter = 79;
-          // remove last char if it is a comma
-          if (buf[bytesCounter - 1] == ',') {
-            buf[bytesCounter - 1] = '\0';
-          } else {
-            buf[bytesCounter] = '\0';
-          }
-          char varName[80];
-          char varValue[80];
-          sscanf(buf, " %s  : %s", varName, varValue);
-          if (deviceType == FRONIUS_THREE_PHASE_METER) {
-            // meter values are in same line so call directly
-            Fronius::getThreePhaseMeterValues(varName, varValue);
-          } else {
-            // inverter values are in dict so we need to look for "Value"
-            if (strncmp(varName, "Unit", strlen("Unit")) != 0) {
-              if (strlen(variableToFetch) != 0 &&
-                  strncmp(varName, "Value", strlen("Value")) == 0) {
-                if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
-                  Fronius::getSinglePhaseInverterValues(variableToFetch,
-                                                        varValue);
-                } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
-                  Fronius::getThreePhaseInverterValues(variableToFetch,
-                                                       varValue);
-                }
-                variableToFetch[0] = 0;
-              } else {
-                snprintf(
-                    variableToFetch, sizeof(variableToFetch), "%s", varName);
-              }
-            }
-          }
-        }
-        bytesCounter = 0;
-        startCharFound = false;
-      } else if (c == '"' || startCharFound) {
-        startCharFound = true;
-        if (c == '"') {
-          c = ' ';
-        }
-        if (bytesCounter < 80) {
-          buf[bytesCounter] = c;
-        }
-        bytesCounter++;
-      }
-    }
-    if (!client->connected()) {
-      client->stop();
-    }
-  }
+  poller.iterate();
   if (dataIsReady) {
     dataIsReady = false;
     if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
@@ -393,83 +375,122 @@ void Fronius::iterateAlways() {
 void Fronius::getSinglePhaseInverterURL(char* buf, char* idBuf) {
   snprintf(buf,
            200,
-           "GET "
            "/solar_api/v1/GetInverterRealtimeData.cgi?Scope=Device&DeviceID="
-           "%s&DataCollection=CommonInverterData HTTP/1.1",
+           "%s&DataCollection=CommonInverterData",
            idBuf);
 }
 
 void Fronius::getThreePhaseInverterURL(char* buf, char* idBuf) {
   snprintf(buf,
            200,
-           "GET "
            "/solar_api/v1/GetInverterRealtimeData.cgi?Scope=Device&DeviceID="
-           "%s&DataCollection=%s HTTP/1.1",
+           "%s&DataCollection=%s",
            idBuf,
            fetch3p ? "3PInverterData" : "CommonInverterData");
-  fetch3p = !fetch3p;
 }
 
 void Fronius::getThreePhaseMeterURL(char* buf, char* idBuf) {
   snprintf(buf,
            200,
-           "GET "
            "/solar_api/v1/GetMeterRealtimeData.cgi?Scope=Device&DeviceId="
-           "%s HTTP/1.1",
+           "%s",
            idBuf);
 }
 
+bool Fronius::sendQuery() {
+  char idBuf[20];
+  snprintf(idBuf, sizeof(idBuf), "%d", deviceId);
+  char buf[200] = {};
+  if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
+    Fronius::getSinglePhaseInverterURL(buf, idBuf);
+  } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
+    Fronius::getThreePhaseInverterURL(buf, idBuf);
+  } else {
+    Fronius::getThreePhaseMeterURL(buf, idBuf);
+  }
+  SUPLA_LOG_VERBOSE("Fronius query: %s", buf);
+  tokenizer.reset();
+  return poller.sendRequest(buf);
+}
+
 bool Fronius::iterateConnected() {
-  if (!dataFetchInProgress) {
+  if (!poller.isBusy()) {
     if (lastReadTime == 0 || millis() - lastReadTime > refreshRateSec * 1000) {
       lastReadTime = millis();
-      SUPLA_LOG_DEBUG("Fronius connecting %d", deviceId);
-      if (client->connect(ip, port)) {
-        retryCounter = 0;
-        dataFetchInProgress = true;
-        connectionTimeoutMs = lastReadTime;
-
-        char idBuf[20];
-        snprintf(idBuf, sizeof(idBuf), "%d", deviceId);
-        char buf[200] = {};
-        if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
-          Fronius::getSinglePhaseInverterURL(buf, idBuf);
-        } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
-          Fronius::getThreePhaseInverterURL(buf, idBuf);
-        } else if (deviceType == FRONIUS_THREE_PHASE_METER) {
-          Fronius::getThreePhaseMeterURL(buf, idBuf);
-        } else {
-          SUPLA_LOG_ERROR("Unsupported Fronius device type: %d", deviceType);
-          client->stop();
-          dataFetchInProgress = false;
-          return Element::iterateConnected();
-        }
-        SUPLA_LOG_VERBOSE("Fronius query: %s", buf);
-        client->println(buf);
-        client->println("Host: localhost");
-        client->println("Connection: close");
-        client->println();
-
-      } else {  // if connection wasn't successful, try few times. If it fails,
-                // then assume that inverter is off during the night
+      SUPLA_LOG_DEBUG("Fronius query %d", deviceId);
+      // three phase inverter data is fetched with two requests sent over
+      // the same connection: CommonInverterData and 3PInverterData
+      fetch3p = false;
+      if (!sendQuery()) {
         SUPLA_LOG_DEBUG("Failed to connect to Fronius");
-        retryCounter++;
-        if (retryCounter > 3) {
-          if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
-            Fronius::setSinglePhaseInverterValues(true);
-          } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
-            Fronius::setThreePhaseInverterValues(true);
-          } else if (deviceType == FRONIUS_THREE_PHASE_METER) {
-            Fronius::setThreePhaseMeterValues(true);
-          }
-          dataIsReady = true;
-        }
+        onReadFailed();
       }
     }
   }
   return Element::iterateConnected();
 }
 
+void Fronius::onReadFailed() {
+  // if read wasn't successful, try few times. If it fails, then assume that
+  // inverter is off during the night
+  retryCounter++;
+  if (retryCounter > 3) {
+    if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
+      Fronius::setSinglePhaseInverterValues(true);
+    } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
+      Fronius::setThreePhaseInverterValues(true);
+    } else if (deviceType == FRONIUS_THREE_PHASE_METER) {
+      Fronius::setThreePhaseMeterValues(true);
+    }
+    dataIsReady = true;
+  }
+}
+
+void Fronius::onHttpBody(const char *data, int size) {
+  tokenizer.feed(data, size);
+}
+
+void Fronius::onJsonValue(int keyId, const char *value) {
+  // variable name is the path segment following "Body/Data/"
+  char varName[40] = {};
+  const char *name = keys[keyId] + strlen(FRONIUS_DATA_PATH);
+  int len = 0;
+  while (name[len] != '\0' && name[len] != '/' &&
+         len < static_cast<int>(sizeof(varName)) - 1) {
+    varName[len] = name[len];
+    len++;
+  }
+  if (deviceType == FRONIUS_SINGLE_PHASE_INVERTER) {
+    Fronius::getSinglePhaseInverterValues(varName, value);
+  } else if (deviceType == FRONIUS_THREE_PHASE_INVERTER) {
+    Fronius::getThreePhaseInverterValues(varName, value);
+  } else {
+    Fronius::getThreePhaseMeterValues(varName, value);
+  }
+}
+
+void Fronius::onHttpResponseComplete(bool success, int statusCode) {
+  if (success && statusCode == 200) {
+    tokenizer.finish();
+  }
+  // connection closed in the middle of the body leaves tokenizer without
+  // error, but document is not complete
+  if (!success || statusCode != 200 || !tokenizer.isComplete()) {
+    SUPLA_LOG_DEBUG("Fronius: query failed (status: %d)", statusCode);
+    onReadFailed();
+    return;
+  }
+  retryCounter = 0;
+  if (deviceType == FRONIUS_THREE_PHASE_INVERTER && !fetch3p) {
+    fetch3p = true;
+    if (sendQuery()) {
+      return;
+    }
+  }
+  SUPLA_LOG_DEBUG("Fronius fetch completed");
+  dataIsReady = true;
+}
+
 void Fronius::readValuesFromDevice() {
 }
 
@@ -9,13 +9,17 @@
 #ifndef SRC_SUPLA_PV_FRONIUS_H_
 #define SRC_SUPLA_PV_FRONIUS_H_
 
-#include <IPAddress.h>
+#include <supla/network/ip_address.h>
 #include <supla/sensor/electricity_meter.h>
-#include <supla/network/client.h>
+
+#include "http_poller.h"
+#include "json_stream_tokenizer.h"
 
 namespace Supla {
 namespace PV {
-class Fronius : public Supla::Sensor::ElectricityMeter {
+class Fronius : public Supla::Sensor::ElectricityMeter,
+                public HttpResponseHandler,
+                public JsonValueHandler {
  public:
   explicit Fronius(
     IPAddress ip,
@@ -28,21 +32,26 @@ class Fronius : public Supla::Sensor::ElectricityMeter {
   void iterateAlways();
   bool iterateConnected();
 
+  void onHttpBody(const char *data, int size) override;
+  void onHttpResponseComplete(bool success, int statusCode) override;
+  void onJsonValue(int keyId, const char *value) override;
+
  protected:
-  void getSinglePhaseInverterValues(char* varName, char* varValue);
-  void getThreePhaseInverterValues(char* varName, char* varValue);
-  void getThreePhaseMeterValues(char* varName, char* varValue);
+  bool sendQuery();
+  void onReadFailed();
+  void getSinglePhaseInverterValues(const char* varName, const char* varValue);
+  void getThreePhaseInverterValues(const char* varName, const char* varValue);
+  void getThreePhaseMeterValues(const char* varName, const char* varValue);
   void setSinglePhaseInverterValues(bool zeroValues);
   void setThreePhaseInverterValues(bool zeroValues);
   void setThreePhaseMeterValues(bool zeroValues);
   void getSinglePhaseInverterURL(char* buf, char* idBuf);
   void getThreePhaseInverterURL(char* buf, char* idBuf);
   void getThreePhaseMeterURL(char* buf, char* idBuf);
-  ::Supla::Client *client = nullptr;
-  IPAddress ip;
-  int port;
+  HttpPoller poller;
+  JsonStreamTokenizer tokenizer;
   int deviceType;
-  char buf[80] = {};
+  const char *const *keys = nullptr;
   unsigned _supla_int64_t totalGeneratedEnergy = 0;
   unsigned _supla_int64_t fwdReactEnergy = 0;
   unsigned _supla_int64_t rvrReactEnergy = 0;
@@ -55,14 +64,9 @@ class Fronius : public Supla::Sensor::ElectricityMeter {
   unsigned _supla_int16_t currentCurrent[3] = {};
   unsigned _supla_int16_t currentFreq = 0;
   unsigned _supla_int16_t currentVoltage[3] = {};
-  int bytesCounter = 0;
   int retryCounter = 0;
   int deviceId;
-  bool startCharFound = false;
   bool dataIsReady = false;
-  bool dataFetchInProgress = false;
-  uint64_t connectionTimeoutMs = 0;
-  char variableToFetch[80] = {};
   bool fetch3p = false;
   int invDisabledCounter = 0;
 };
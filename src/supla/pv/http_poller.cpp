@@ -0,0 +1,492 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "http_poller.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <supla/log_wrapper.h>
+#include <supla/time.h>
+
+namespace {
+
+// Case insensitive check if line starts with lower case prefix
+bool startsWith(const char *line, const char *prefix) {
+  for (; *prefix; line++, prefix++) {
+    char c = *line;
+    if (c >= 'A' && c <= 'Z') {
+      c = c - 'A' + 'a';
+    }
+    if (c != *prefix) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Case insensitive search for lower case word
+bool contains(const char *line, const char *word) {
+  for (; *line; line++) {
+    if (startsWith(line, word)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace Supla {
+namespace PV {
+
+void HttpResponseHandler::onHttpBody(const char *, int) {
+}
+
+void HttpResponseHandler::onHttpBodyLine(char *) {
+}
+
+void HttpResponseHandler::onHttpHeaders(int, int32_t) {
+}
+
+HttpPoller::HttpPoller(HttpResponseHandler *handler) : handler(handler) {
+  client = Supla::ClientBuilder();
+  if (client) {
+    client->setNonBlockingConnect(true);
+  }
+}
+
+HttpPoller::~HttpPoller() {
+  releaseRequest();
+  delete[] bodyLine;
+  bodyLine = nullptr;
+  delete client;
+  client = nullptr;
+}
+
+void HttpPoller::setServer(const char *host, uint16_t port) {
+  snprintf(this->host, sizeof(this->host), "%s", host);
+  this->port = port;
+}
+
+void HttpPoller::setServer(IPAddress ip, uint16_t port) {
+  snprintf(
+      host, sizeof(host), "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
+  this->port = port;
+}
+
+void HttpPoller::setKeepAlive(bool keepAlive) {
+  this->keepAlive = keepAlive;
+}
+
+void HttpPoller::setTimeoutMs(uint32_t timeoutMs) {
+  this->timeoutMs = timeoutMs;
+}
+
+void HttpPoller::setLineMode(int maxLineLength) {
+  delete[] bodyLine;
+  bodyLine = nullptr;
+  maxBodyLineLength = 0;
+  if (maxLineLength > 0) {
+    bodyLine = new char[maxLineLength + 1];
+    maxBodyLineLength = maxLineLength;
+  }
+  bodyLineLength = 0;
+}
+
+::Supla::Client *HttpPoller::getClient() {
+  return client;
+}
+
+bool HttpPoller::isBusy() const {
+  return state != State::IDLE;
+}
+
+uint32_t HttpPoller::getConnectionCount() const {
+  return connectionCount;
+}
+
+uint32_t HttpPoller::getRequestCount() const {
+  return requestCount;
+}
+
+void HttpPoller::stop() {
+  state = State::IDLE;
+  releaseRequest();
+  if (client) {
+    client->stop();
+  }
+}
+
+bool HttpPoller::sendRequest(const char *path, const char *extraHeaders) {
+  return prepareRequest("GET", path, extraHeaders, nullptr, nullptr);
+}
+
+bool HttpPoller::sendPostRequest(const char *path,
+                                 const char *contentType,
+                                 const char *body) {
+  if (contentType == nullptr || body == nullptr) {
+    return false;
+  }
+  return prepareRequest("POST", path, nullptr, contentType, body);
+}
+
+bool HttpPoller::prepareRequest(const char *method,
+                                const char *path,
+                                const char *extraHeaders,
+                                const char *contentType,
+                                const char *body) {
+  if (isBusy() || client == nullptr || path == nullptr) {
+    return false;
+  }
+  if (extraHeaders == nullptr) {
+    extraHeaders = "";
+  }
+
+  const char format[] =
+      "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n%s";
+  const char *connection = keepAlive ? "keep-alive" : "close";
+  int length = snprintf(request,
+                        sizeof(request),
+                        format,
+                        method,
+                        path,
+                        host,
+                        connection,
+                        extraHeaders);
+  if (length > 0 && length < static_cast<int>(sizeof(request))) {
+    if (body) {
+      length += snprintf(request + length,
+                         sizeof(request) - length,
+                         "Content-Type: %s\r\nContent-Length: %d\r\n\r\n"
+                         "%s",
+                         contentType,
+                         static_cast<int>(strlen(body)),
+                         body);
+    } else {
+      length += snprintf(
+          request + length, sizeof(request) - length, "\r\n");
+    }
+  }
+  if (length <= 0 || length >= static_cast<int>(sizeof(request))) {
+    SUPLA_LOG_ERROR("HttpPoller: request to %s is too long", host);
+    releaseRequest();
+    return false;
+  }
+  requestLength = length;
+
+  responseStarted = false;
+  chunked = false;
+  serverClose = false;
+  hasContentLength = false;
+  statusCode = 0;
+  remaining = 0;
+  headerLineLength = 0;
+  bodyLineLength = 0;
+  lastActivityMs = millis();
+
+  reusedConnection = keepAlive && client->connected();
+  if (reusedConnection && writeRequest()) {
+    state = State::STATUS_LINE;
+  } else if (!startRequest()) {
+    SUPLA_LOG_DEBUG("HttpPoller: failed to send request to %s", host);
+    state = State::IDLE;
+    client->stop();
+    releaseRequest();
+    return false;
+  }
+  requestCount++;
+  return true;
+}
+
+bool HttpPoller::connect() {
+  client->stop();
+  reusedConnection = false;
+  if (!client->connect(host, port)) {
+    SUPLA_LOG_DEBUG("HttpPoller: failed to connect to %s:%d", host, port);
+    return false;
+  }
+  connectionCount++;
+  return true;
+}
+
+bool HttpPoller::startRequest() {
+  if (!connect()) {
+    return false;
+  }
+  if (client->isConnecting()) {
+    // request is written from iterate() when connection is ready
+    state = State::CONNECTING;
+    return true;
+  }
+  if (!writeRequest()) {
+    return false;
+  }
+  state = State::STATUS_LINE;
+  return true;
+}
+
+void HttpPoller::iterateConnecting() {
+  // connected() drives non-blocking connect and returns false on failure
+  if (!client->connected()) {
+    SUPLA_LOG_DEBUG("HttpPoller: failed to connect to %s:%d", host, port);
+    finish(false);
+    return;
+  }
+  if (client->isConnecting()) {
+    return;
+  }
+  if (!writeRequest()) {
+    SUPLA_LOG_DEBUG("HttpPoller: failed to send request to %s", host);
+    finish(false);
+    return;
+  }
+  lastActivityMs = millis();
+  state = State::STATUS_LINE;
+}
+
+bool HttpPoller::writeRequest() {
+  return client->write(request, requestLength) ==
+         static_cast<size_t>(requestLength);
+}
+
+void HttpPoller::iterate() {
+  if (state == State::CONNECTING) {
+    iterateConnecting();
+    if (state == State::CONNECTING) {
+      if (millis() - lastActivityMs > timeoutMs) {
+        SUPLA_LOG_DEBUG("HttpPoller: timeout, can't connect to %s", host);
+        finish(false);
+      }
+      return;
+    }
+  }
+  if (state == State::IDLE) {
+    return;
+  }
+
+  char buf[SUPLA_HTTP_POLLER_READ_CHUNK];
+  int budget = SUPLA_HTTP_POLLER_ITERATE_BUDGET;
+  while (budget > 0 && state != State::IDLE) {
+    if (client->available() <= 0) {
+      if (!client->connected()) {
+        handleClose();
+      }
+      break;
+    }
+    int size = static_cast<int>(sizeof(buf));
+    if (budget < size) {
+      size = budget;
+    }
+    int received = client->read(buf, size);
+    if (received == 0) {
+      handleClose();
+      break;
+    }
+    if (received < 0) {
+      break;
+    }
+    lastActivityMs = millis();
+    responseStarted = true;
+    budget -= received;
+    process(buf, received);
+  }
+
+  if (state != State::IDLE && millis() - lastActivityMs > timeoutMs) {
+    SUPLA_LOG_DEBUG("HttpPoller: timeout, %s is not responding", host);
+    finish(false);
+  }
+}
+
+void HttpPoller::process(const char *data, int size) {
+  // handler may send next request from completion callback, so remaining
+  // data of the previous response has to be dropped
+  uint32_t requestId = requestCount;
+  while (size > 0 && state != State::IDLE && requestId == requestCount) {
+    int consumed = 0;
+    switch (state) {
+      case State::BODY_LENGTH:
+      case State::CHUNK_DATA: {
+        consumed = size;
+        if (static_cast<uint32_t>(consumed) > remaining) {
+          consumed = remaining;
+        }
+        remaining -= consumed;
+        processBody(data, consumed);
+        if (remaining == 0) {
+          if (state == State::CHUNK_DATA) {
+            state = State::CHUNK_DATA_END;
+          } else {
+            finish(true);
+          }
+        }
+        break;
+      }
+      case State::BODY_UNTIL_CLOSE: {
+        consumed = size;
+        processBody(data, consumed);
+        break;
+      }
+      default: {
+        consumed = processLine(data, size);
+        break;
+      }
+    }
+    data += consumed;
+    size -= consumed;
+  }
+}
+
+int HttpPoller::processLine(const char *data, int size) {
+  for (int i = 0; i < size; i++) {
+    char c = data[i];
+    if (c == '\n') {
+      if (headerLineLength > 0 && headerLine[headerLineLength - 1] == '\r') {
+        headerLineLength--;
+      }
+      headerLine[headerLineLength] = '\0';
+      headerLineLength = 0;
+      processHeaderLine();
+      return i + 1;
+    }
+    if (headerLineLength < SUPLA_HTTP_POLLER_MAX_HEADER_LINE - 1) {
+      headerLine[headerLineLength++] = c;
+    }
+  }
+  return size;
+}
+
+void HttpPoller::processHeaderLine() {
+  switch (state) {
+    case State::STATUS_LINE: {
+      const char *code = strchr(headerLine, ' ');
+      if (strncmp(headerLine, "HTTP/", 5) != 0 || code == nullptr) {
+        SUPLA_LOG_DEBUG("HttpPoller: invalid status line");
+        finish(false);
+        return;
+      }
+      statusCode = atoi(code + 1);
+      state = State::HEADERS;
+      return;
+    }
+    case State::HEADERS: {
+      if (headerLine[0] != '\0') {
+        if (startsWith(headerLine, "content-length:")) {
+          hasContentLength = true;
+          remaining = strtoul(headerLine + 15, nullptr, 10);
+        } else if (startsWith(headerLine, "transfer-encoding:")) {
+          chunked = contains(headerLine + 18, "chunked");
+        } else if (startsWith(headerLine, "connection:")) {
+          serverClose = contains(headerLine + 11, "close");
+        }
+        return;
+      }
+      if (statusCode >= 100 && statusCode < 200) {
+        // informational response, the final one follows
+        state = State::STATUS_LINE;
+        chunked = false;
+        serverClose = false;
+        hasContentLength = false;
+        return;
+      }
+      handler->onHttpHeaders(statusCode,
+                             hasContentLength && !chunked
+                                 ? static_cast<int32_t>(remaining)
+                                 : -1);
+      if (state != State::HEADERS) {
+        // request was stopped from callback
+        return;
+      }
+      if (chunked) {
+        state = State::CHUNK_SIZE;
+      } else if (hasContentLength) {
+        state = State::BODY_LENGTH;
+        if (remaining == 0) {
+          finish(true);
+        }
+      } else {
+        state = State::BODY_UNTIL_CLOSE;
+      }
+      return;
+    }
+    case State::CHUNK_SIZE: {
+      remaining = strtoul(headerLine, nullptr, 16);
+      state = remaining == 0 ? State::CHUNK_TRAILER : State::CHUNK_DATA;
+      return;
+    }
+    case State::CHUNK_DATA_END: {
+      state = State::CHUNK_SIZE;
+      return;
+    }
+    case State::CHUNK_TRAILER: {
+      if (headerLine[0] == '\0') {
+        finish(true);
+      }
+      return;
+    }
+    default: {
+      return;
+    }
+  }
+}
+
+void HttpPoller::processBody(const char *data, int size) {
+  handler->onHttpBody(data, size);
+  if (bodyLine == nullptr) {
+    return;
+  }
+  for (int i = 0; i < size; i++) {
+    if (data[i] == '\n') {
+      if (bodyLineLength > 0 && bodyLine[bodyLineLength - 1] == '\r') {
+        bodyLineLength--;
+      }
+      bodyLine[bodyLineLength] = '\0';
+      bodyLineLength = 0;
+      handler->onHttpBodyLine(bodyLine);
+    } else if (bodyLineLength < maxBodyLineLength) {
+      bodyLine[bodyLineLength++] = data[i];
+    }
+  }
+}
+
+void HttpPoller::handleClose() {
+  if (state == State::BODY_UNTIL_CLOSE) {
+    finish(true);
+    return;
+  }
+  if (reusedConnection && !responseStarted) {
+    // server closed idle keep-alive connection before our request arrived.
+    // New connection is not reused, so request is retried only once.
+    SUPLA_LOG_DEBUG("HttpPoller: reused connection closed, retrying");
+    if (startRequest()) {
+      lastActivityMs = millis();
+      return;
+    }
+  }
+  SUPLA_LOG_DEBUG("HttpPoller: connection closed by %s", host);
+  finish(false);
+}
+
+void HttpPoller::finish(bool success) {
+  if (success && bodyLine != nullptr && bodyLineLength > 0) {
+    bodyLine[bodyLineLength] = '\0';
+    bodyLineLength = 0;
+    handler->onHttpBodyLine(bodyLine);
+  }
+  bool close = !success || !keepAlive || serverClose ||
+               state == State::BODY_UNTIL_CLOSE;
+  state = State::IDLE;
+  releaseRequest();
+  if (close) {
+    client->stop();
+  }
+  handler->onHttpResponseComplete(success, statusCode);
+}
+
+void HttpPoller::releaseRequest() {
+  request[0] = '\0';
+  requestLength = 0;
+}
+
+}  // namespace PV
+}  // namespace Supla
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_PV_HTTP_POLLER_H_
+#define SRC_SUPLA_PV_HTTP_POLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <supla/network/client.h>
+#include <supla/network/ip_address.h>
+
+// size of a single read from client
+#define SUPLA_HTTP_POLLER_READ_CHUNK 256
+// max number of bytes processed in a single iterate() call
+#define SUPLA_HTTP_POLLER_ITERATE_BUDGET 1024
+#define SUPLA_HTTP_POLLER_MAX_HOST 64
+#define SUPLA_HTTP_POLLER_MAX_HEADER_LINE 128
+#ifndef SUPLA_HTTP_POLLER_MAX_REQUEST
+// request line with headers
+#define SUPLA_HTTP_POLLER_MAX_REQUEST 768
+#endif
+
+namespace Supla {
+namespace PV {
+
+class HttpResponseHandler {
+ public:
+  virtual ~HttpResponseHandler() = default;
+  // Called with each received part of (decoded) response body
+  virtual void onHttpBody(const char *data, int size);
+  // Called with each body line (without line ending) when line mode is
+  // enabled. Too long lines are truncated.
+  virtual void onHttpBodyLine(char *line);
+  /**
+   * Called when headers of final response are received, before any body
+   * data.
+   *
+   * @param statusCode HTTP status code
+   * @param contentLength value of Content-Length header, -1 if missing
+   */
+  virtual void onHttpHeaders(int statusCode, int32_t contentLength);
+  /**
+   * Called once per request.
+   *
+   * @param success true when whole response was received
+   * @param statusCode HTTP status code, 0 if status line wasn't received
+   */
+  virtual void onHttpResponseComplete(bool success, int statusCode) = 0;
+};
+
+/**
+ * Non-blocking HTTP/1.1 GET client shared by PV inverter readers.
+ *
+ * Connection is established without blocking when client supports it
+ * (DNS lookup may still block). Request is kept in a fixed buffer of
+ * SUPLA_HTTP_POLLER_MAX_REQUEST bytes and it is written with a single write
+ * call once connection is ready. Response is read in
+ * SUPLA_HTTP_POLLER_READ_CHUNK blocks and parsed incrementally from
+ * iterate(), which processes at most SUPLA_HTTP_POLLER_ITERATE_BUDGET bytes
+ * per call and never waits for data. Content-Length, chunked and
+ * close delimited bodies are supported.
+ *
+ * With keep-alive enabled, connection is reused for following requests.
+ * If reused connection turns out to be closed by the server before
+ * response arrives, request is sent once again on a new connection.
+ * Timeout applies to the connection phase as well.
+ */
+class HttpPoller {
+ public:
+  explicit HttpPoller(HttpResponseHandler *handler);
+  ~HttpPoller();
+
+  void setServer(const char *host, uint16_t port);
+  void setServer(IPAddress ip, uint16_t port);
+  void setKeepAlive(bool keepAlive);
+  // Max time without any data received from server
+  void setTimeoutMs(uint32_t timeoutMs);
+  // Enables onHttpBodyLine callbacks with lines up to maxLineLength chars
+  void setLineMode(int maxLineLength);
+
+  // Returns client, i.e. for SSL configuration
+  ::Supla::Client *getClient();
+
+  /**
+   * Sends GET request.
+   *
+   * @param path request path with query
+   * @param extraHeaders optional headers, each terminated with "\r\n"
+   *
+   * @return false if request can't be sent (i.e. it doesn't fit in
+   *         SUPLA_HTTP_POLLER_MAX_REQUEST or connection failed
+   *         immediately). In such case onHttpResponseComplete is not called
+   */
+  bool sendRequest(const char *path, const char *extraHeaders = nullptr);
+  /**
+   * Sends POST request with body. Body is sent together with headers, so
+   * it has to fit in SUPLA_HTTP_POLLER_MAX_REQUEST as well.
+   *
+   * @param path request path with query
+   * @param contentType value of Content-Type header
+   * @param body request body
+   *
+   * @return false if request can't be sent (see sendRequest)
+   */
+  bool sendPostRequest(const char *path,
+                       const char *contentType,
+                       const char *body);
+  void iterate();
+  bool isBusy() const;
+  // Closes connection and drops request in progress (without callback)
+  void stop();
+
+  uint32_t getConnectionCount() const;
+  uint32_t getRequestCount() const;
+
+ protected:
+  enum class State : uint8_t {
+    IDLE,
+    CONNECTING,
+    STATUS_LINE,
+    HEADERS,
+    BODY_LENGTH,
+    BODY_UNTIL_CLOSE,
+    CHUNK_SIZE,
+    CHUNK_DATA,
+    CHUNK_DATA_END,
+    CHUNK_TRAILER
+  };
+
+  bool prepareRequest(const char *method,
+                      const char *path,
+                      const char *extraHeaders,
+                      const char *contentType,
+                      const char *body);
+  bool connect();
+  bool startRequest();
+  void iterateConnecting();
+  bool writeRequest();
+  void process(const char *data, int size);
+  int processLine(const char *data, int size);
+  void processHeaderLine();
+  void processBody(const char *data, int size);
+  void handleClose();
+  void finish(bool success);
+  void releaseRequest();
+
+  HttpResponseHandler *handler = nullptr;
+  ::Supla::Client *client = nullptr;
+  char host[SUPLA_HTTP_POLLER_MAX_HOST] = {};
+  uint16_t port = 80;
+  bool keepAlive = true;
+  uint32_t timeoutMs = 30000;
+
+  State state = State::IDLE;
+  char request[SUPLA_HTTP_POLLER_MAX_REQUEST] = {};
+  int requestLength = 0;
+  bool reusedConnection = false;
+  bool responseStarted = false;
+  bool chunked = false;
+  bool serverClose = false;
+  bool hasContentLength = false;
+  int statusCode = 0;
+  uint32_t remaining = 0;
+  uint32_t lastActivityMs = 0;
+
+  char headerLine[SUPLA_HTTP_POLLER_MAX_HEADER_LINE] = {};
+  int headerLineLength = 0;
+
+  char *bodyLine = nullptr;
+  int maxBodyLineLength = 0;
+  int bodyLineLength = 0;
+
+  uint32_t connectionCount = 0;
+  uint32_t requestCount = 0;
+};
+
+}  // namespace PV
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_PV_HTTP_POLLER_H_
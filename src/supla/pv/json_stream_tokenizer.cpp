@@ -0,0 +1,262 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "json_stream_tokenizer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+bool isWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}  // namespace
+
+namespace Supla {
+namespace PV {
+
+JsonStreamTokenizer::JsonStreamTokenizer(JsonValueHandler *handler)
+    : handler(handler) {
+}
+
+void JsonStreamTokenizer::setKeys(const char *const *keys, int count) {
+  this->keys = keys;
+  keyCount = count;
+}
+
+void JsonStreamTokenizer::reset() {
+  state = State::VALUE;
+  escape = false;
+  depth = 0;
+  matchedKey = -1;
+  valueLength = 0;
+  valueOverflow = false;
+  overflowDepth = -1;
+  truncatePath(0);
+}
+
+void JsonStreamTokenizer::finish() {
+  if (state == State::LITERAL && depth == 0) {
+    endValue();
+  }
+}
+
+bool JsonStreamTokenizer::isComplete() const {
+  return state == State::DONE;
+}
+
+bool JsonStreamTokenizer::isError() const {
+  return state == State::ERROR;
+}
+
+void JsonStreamTokenizer::feed(const char *data, int size) {
+  for (int i = 0; i < size && state != State::ERROR; i++) {
+    processChar(data[i]);
+  }
+}
+
+void JsonStreamTokenizer::processChar(char c) {
+  switch (state) {
+    case State::VALUE:
+    case State::VALUE_OR_END: {
+      if (isWhitespace(c)) {
+        return;
+      }
+      if (state == State::VALUE_OR_END && c == ']') {
+        closeContainer();
+        return;
+      }
+      beginValue(c);
+      return;
+    }
+    case State::KEY:
+    case State::KEY_OR_END: {
+      if (isWhitespace(c)) {
+        return;
+      }
+      if (state == State::KEY_OR_END && c == '}') {
+        closeContainer();
+        return;
+      }
+      if (c != '"') {
+        state = State::ERROR;
+        return;
+      }
+      truncatePath(stack[depth - 1].pathLength);
+      if (pathLength > 0) {
+        appendPath('/');
+      }
+      state = State::KEY_STRING;
+      return;
+    }
+    case State::KEY_STRING: {
+      if (escape) {
+        escape = false;
+      } else if (c == '\\') {
+        escape = true;
+        return;
+      } else if (c == '"') {
+        state = State::COLON;
+        return;
+      }
+      appendPath(c);
+      return;
+    }
+    case State::COLON: {
+      if (c == ':') {
+        state = State::VALUE;
+      } else if (!isWhitespace(c)) {
+        state = State::ERROR;
+      }
+      return;
+    }
+    case State::STRING_VALUE: {
+      if (escape) {
+        escape = false;
+      } else if (c == '\\') {
+        escape = true;
+        return;
+      } else if (c == '"') {
+        endValue();
+        return;
+      }
+      appendValue(c);
+      return;
+    }
+    case State::LITERAL: {
+      if (isWhitespace(c) || c == ',' || c == '}' || c == ']') {
+        endValue();
+        processChar(c);
+        return;
+      }
+      appendValue(c);
+      return;
+    }
+    case State::COMMA_OR_END: {
+      if (isWhitespace(c)) {
+        return;
+      }
+      Level &level = stack[depth - 1];
+      if (c == ',') {
+        if (level.isArray) {
+          level.index++;
+          state = State::VALUE;
+        } else {
+          state = State::KEY;
+        }
+      } else if ((c == ']' && level.isArray) || (c == '}' && !level.isArray)) {
+        closeContainer();
+      } else {
+        state = State::ERROR;
+      }
+      return;
+    }
+    case State::DONE:
+    case State::ERROR: {
+      return;
+    }
+  }
+}
+
+void JsonStreamTokenizer::beginValue(char c) {
+  if (depth > 0 && stack[depth - 1].isArray) {
+    truncatePath(stack[depth - 1].pathLength);
+    char index[8] = {};
+    snprintf(index, sizeof(index), "%u", stack[depth - 1].index);
+    if (pathLength > 0) {
+      appendPath('/');
+    }
+    for (int i = 0; index[i] != '\0'; i++) {
+      appendPath(index[i]);
+    }
+  }
+
+  if (c == '{' || c == '[') {
+    if (depth >= SUPLA_JSON_STREAM_MAX_DEPTH) {
+      state = State::ERROR;
+      return;
+    }
+    if (pathOverflow && overflowDepth < 0) {
+      // nested paths are truncated as well, so none of them can be matched
+      overflowDepth = depth;
+    }
+    Level &level = stack[depth++];
+    level.isArray = (c == '[');
+    level.index = 0;
+    level.pathLength = pathLength;
+    state = level.isArray ? State::VALUE_OR_END : State::KEY_OR_END;
+    return;
+  }
+
+  matchedKey = findKey();
+  valueLength = 0;
+  valueOverflow = false;
+  value[0] = '\0';
+  if (c == '"') {
+    state = State::STRING_VALUE;
+  } else {
+    state = State::LITERAL;
+    appendValue(c);
+  }
+}
+
+void JsonStreamTokenizer::endValue() {
+  if (matchedKey >= 0 && !valueOverflow && handler) {
+    value[valueLength] = '\0';
+    handler->onJsonValue(matchedKey, value);
+  }
+  matchedKey = -1;
+  state = depth == 0 ? State::DONE : State::COMMA_OR_END;
+}
+
+void JsonStreamTokenizer::closeContainer() {
+  depth--;
+  if (depth == overflowDepth) {
+    overflowDepth = -1;
+  }
+  truncatePath(stack[depth].pathLength);
+  state = depth == 0 ? State::DONE : State::COMMA_OR_END;
+}
+
+void JsonStreamTokenizer::truncatePath(uint8_t length) {
+  pathLength = length;
+  path[pathLength] = '\0';
+  pathOverflow = overflowDepth >= 0;
+}
+
+void JsonStreamTokenizer::appendPath(char c) {
+  if (pathLength >= SUPLA_JSON_STREAM_MAX_PATH - 1) {
+    pathOverflow = true;
+    return;
+  }
+  path[pathLength++] = c;
+  path[pathLength] = '\0';
+}
+
+void JsonStreamTokenizer::appendValue(char c) {
+  if (matchedKey < 0) {
+    return;
+  }
+  if (valueLength >= SUPLA_JSON_STREAM_MAX_VALUE - 1) {
+    valueOverflow = true;
+    return;
+  }
+  value[valueLength++] = c;
+}
+
+int JsonStreamTokenizer::findKey() const {
+  if (pathOverflow || keys == nullptr) {
+    return -1;
+  }
+  for (int i = 0; i < keyCount; i++) {
+    if (strcmp(path, keys[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+}  // namespace PV
+}  // namespace Supla
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_PV_JSON_STREAM_TOKENIZER_H_
+#define SRC_SUPLA_PV_JSON_STREAM_TOKENIZER_H_
+
+#include <stdint.h>
+
+#define SUPLA_JSON_STREAM_MAX_DEPTH 10
+#define SUPLA_JSON_STREAM_MAX_PATH 96
+#define SUPLA_JSON_STREAM_MAX_VALUE 32
+
+namespace Supla {
+namespace PV {
+
+class JsonValueHandler {
+ public:
+  virtual ~JsonValueHandler() = default;
+  /**
+   * Called for each value of subscribed key.
+   *
+   * @param keyId index of key in array passed to JsonStreamTokenizer::setKeys
+   * @param value value as text. Strings are passed without quotes
+   */
+  virtual void onJsonValue(int keyId, const char *value) = 0;
+};
+
+/**
+ * Incremental JSON tokenizer, which reports only values of subscribed keys.
+ *
+ * Input can be split at any position, so it can be fed directly with data
+ * received from network. Only current path and value of subscribed key are
+ * stored, so memory usage doesn't depend on document size.
+ *
+ * Keys are paths built from object member names and array indexes separated
+ * with '/', i.e. "Body/Data/PAC/Value" or "Body/Data/0/Voltage".
+ * Escape sequences are replaced with the escaped character (no \u decoding).
+ * Values longer than SUPLA_JSON_STREAM_MAX_VALUE - 1 chars are skipped.
+ */
+class JsonStreamTokenizer {
+ public:
+  explicit JsonStreamTokenizer(JsonValueHandler *handler);
+
+  // keys array has to be valid during tokenizer lifetime
+  void setKeys(const char *const *keys, int count);
+  // Prepares tokenizer for next document
+  void reset();
+  void feed(const char *data, int size);
+  // Signals end of input. Top level literal (i.e. number) is terminated only
+  // by end of input, so it is reported from here.
+  void finish();
+
+  bool isComplete() const;
+  bool isError() const;
+
+ protected:
+  enum class State : uint8_t {
+    VALUE,
+    VALUE_OR_END,
+    KEY,
+    KEY_OR_END,
+    KEY_STRING,
+    COLON,
+    STRING_VALUE,
+    LITERAL,
+    COMMA_OR_END,
+    DONE,
+    ERROR
+  };
+
+  struct Level {
+    bool isArray = false;
+    uint16_t index = 0;
+    uint8_t pathLength = 0;
+  };
+
+  void processChar(char c);
+  void beginValue(char c);
+  void endValue();
+  void closeContainer();
+  void truncatePath(uint8_t length);
+  void appendPath(char c);
+  void appendValue(char c);
+  int findKey() const;
+
+  JsonValueHandler *handler = nullptr;
+  const char *const *keys = nullptr;
+  int keyCount = 0;
+
+  State state = State::VALUE;
+  bool escape = false;
+  bool pathOverflow = false;
+  bool valueOverflow = false;
+  int depth = 0;
+  // index of the outermost level with overflowed path, -1 if none
+  int overflowDepth = -1;
+  int matchedKey = -1;
+  uint8_t pathLength = 0;
+  uint8_t valueLength = 0;
+  Level stack[SUPLA_JSON_STREAM_MAX_DEPTH];
+  char path[SUPLA_JSON_STREAM_MAX_PATH] = {};
+  char value[SUPLA_JSON_STREAM_MAX_VALUE] = {};
+};
+
+}  // namespace PV
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_PV_JSON_STREAM_TOKENIZER_H_
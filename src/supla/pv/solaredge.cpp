@@ -65,11 +65,14 @@ SolarEdge::SolarEdge(const char *apiKeyValue,
                      const char *siteIdValue,
                      const char *inverterSerialNumberValue,
                      Supla::Clock *clock)
-    : clock(clock) {
-  pvClient = Supla::ClientBuilder();
-  pvClient->setSSLEnabled(true);
+    : poller(this), clock(clock) {
+  poller.setServer("monitoringapi.solaredge.com", 443);
+  // data is fetched every few minutes, so connection isn't kept open
+  poller.setKeepAlive(false);
+  poller.setLineMode(1023);
+  poller.getClient()->setSSLEnabled(true);
 #if !defined(SUPLA_ALLOW_INSECURE_EXTERNAL_TLS)
-  pvClient->setCACert(SOLAREDGE_CA_CERT);
+  poller.getClient()->setCACert(SOLAREDGE_CA_CERT);
 #endif
 
   // SolarEdge api allows 300 requests daily, so it is one request per almost 5
@@ -100,213 +103,10 @@ SolarEdge::SolarEdge(const char *apiKeyValue,
 }
 
 SolarEdge::~SolarEdge() {
-  delete pvClient;
-  pvClient = nullptr;
 }
 
 void SolarEdge::iterateAlways() {
-  if (dataFetchInProgress) {
-    if (millis() - connectionTimeoutMs > 30000) {
-      SUPLA_LOG_DEBUG(
-          "SolarEdge: connection timeout. Remote host is not responding");
-      pvClient->stop();
-      dataFetchInProgress = false;
-      dataIsReady = false;
-      return;
-    }
-    if (!pvClient->connected()) {
-      SUPLA_LOG_DEBUG("SolarEdge fetch completed");
-      dataFetchInProgress = false;
-      dataIsReady = true;
-    }
-    if (pvClient->available()) {
-      SUPLA_LOG_DEBUG("Reading data from SolarEdge: %d", pvClient->available());
-    }
-    while (pvClient->available()) {
-      int readResult = pvClient->read();
-      if (readResult < 0) {
-        break;
-      }
-      char c = static_cast<char>(readResult);
-      if (c == '\n') {
-        if (bytesCounter > 0) {
-          // new line is found with bytesCounter > 0 means that we have full
-          // received line of data in buf
-          buf[bytesCounter] =
-              '\0';  // add null character at the end of received string
-          SUPLA_LOG_VERBOSE("Received line: %s", buf);
-          if (!headerFound) {
-            if (0 == strncmp(headerVerification,
-                             buf,
-                             sizeof(headerVerification) - 1)) {
-              headerFound = true;
-            }
-          } else {
-            int commaCount = 0;
-            for (unsigned int i = 0; i < strlen(buf); i++) {
-              if (buf[i] == ',') commaCount++;
-            }
-            // proper line of data should contain at least 34 commas
-            if (commaCount >= 34) {
-              strtok(buf, ",");
-              for (int i = 1; i < 34; i++) {
-                char *value =
-                    strtok(nullptr, ",");  // NOLINT(runtime/threadsafe_fn)
-                /*
-0 date,
-1 inverterMode,
-2 temperature,
-3 totalActivePower,
-4 dcVoltage,
-5 groundFaultResistance,
-6 powerLimit,
-7 totalEnergy,
-8 vL1To2,
-9 vL2To3,
-10 vL3To1,
-11 L1-acCurrent,
-12 L1-acVoltage,
-13 L1-acFrequency,
-14 L1-apparentPower,
-15 L1-activePower,
-16 L1-reactivePower,
-17 L1-qRef,
-18 L1-cosPhi,
-19 L2-acCurrent,
-20 L2-acVoltage,
-21 L2-acFrequency,
-22 L2-apparentPower,
-23 L2-activePower,
-24 L2-reactivePower,
-25 L2-qRef,
-26 L2-cosPhi,
-27 L3-acCurrent,
-28 L3-acVoltage,
-29 L3-acFrequency,
-30 L3-apparentPower,
-31 L3-activePower,
-32 L3-reactivePower,
-33 L3-qRef,
-34 L3-cosPhi
-*/
-                switch (i) {
-                  case 1: {  // inverterMode
-                    if (strncmp(value, "MPPT", 4) != 0) {
-                      // ignoring data for inverter in mode other than MPPT
-                      i = commaCount;
-                    }
-                    break;
-                  }
-                  case 2: {  // temperature
-                    temperature = atof(value);
-                    break;
-                  }
-                  case 7: {  // totalEnergy - split per 3 phases
-                    double energy = atof(value);
-                    totalGeneratedEnergy = energy * 100;
-                    break;
-                  }
-                  case 11: {  // L1 - acCurrent
-                    double current = atof(value);
-                    currentCurrent[0] = current * 1000;
-                    break;
-                  }
-                  case 12: {  // L1 - acVoltage
-                    double voltage = atof(value);
-                    currentVoltage[0] = voltage * 100;
-                    break;
-                  }
-                  case 13: {  // L1 - acFrequency
-                    double frequency = atof(value);
-                    currentFreq = frequency * 100;
-                    break;
-                  }
-                  case 14: {  // L1 - apparentPower
-                    double power = atof(value);
-                    currentApparentPower[0] = power * 100000;
-                    break;
-                  }
-                  case 15: {  // L1 - activePower
-                    double power = atof(value);
-                    currentActivePower[0] = power * 100000;
-                    break;
-                  }
-                  case 16: {  // L1 - ReactivePower
-                    double power = atof(value);
-                    currentReactivePower[0] = power * 100000;
-                    break;
-                  }
-                  case 19: {                       // L2 - acCurrent
-                    double current = atof(value);  // Wh
-                    currentCurrent[1] = current * 1000;
-                    break;
-                  }
-                  case 20: {                       // L2 - acVoltage
-                    double voltage = atof(value);  // Wh
-                    currentVoltage[1] = voltage * 100;
-                    break;
-                  }
-                  case 22: {  // L2 - apparentPower
-                    double power = atof(value);
-                    currentApparentPower[1] = power * 100000;
-                    break;
-                  }
-                  case 23: {  // L2 - activePower
-                    double power = atof(value);
-                    currentActivePower[1] = power * 100000;
-                    break;
-                  }
-                  case 24: {  // L2 - ReactivePower
-                    double power = atof(value);
-                    currentReactivePower[1] = power * 100000;
-                    break;
-                  }
-                  case 27: {                       // L3 - acCurrent
-                    double current = atof(value);  // Wh
-                    currentCurrent[2] = current * 1000;
-                    break;
-                  }
-                  case 28: {                       // L3 - acVoltage
-                    double voltage = atof(value);  // Wh
-                    currentVoltage[2] = voltage * 100;
-                    break;
-                  }
-                  case 30: {  // L3 - apparentPower
-                    double power = atof(value);
-                    currentApparentPower[2] = power * 100000;
-                    break;
-                  }
-                  case 31: {  // L3 - activePower
-                    double power = atof(value);
-                    currentActivePower[2] = power * 100000;
-                    break;
-                  }
-                  case 32: {  // L3 - ReactivePower
-                    double power = atof(value);
-                    currentReactivePower[2] = power * 100000;
-                    break;
-                  }
-                    // acCurrent setCurrent
-                    // acVoltage
-                    // acFreq
-                    // apparentPower
-                    // activePower
-                    // ReactivePower
-                }
-              }
-            }
-          }
-        }
-        bytesCounter = 0;
-      } else if (bytesCounter < 1023) {
-        buf[bytesCounter] = c;
-        bytesCounter++;
-      }
-    }
-    if (!pvClient->connected()) {
-      pvClient->stop();
-    }
-  }
+  poller.iterate();
   if (dataIsReady) {
     dataIsReady = false;
     headerFound = false;
@@ -337,73 +137,58 @@ void SolarEdge::iterateAlways() {
 
 bool SolarEdge::iterateConnected() {
   if (clock && clock->isReady()) {
-    if (!dataFetchInProgress) {
-      bytesCounter = 0;
+    if (!poller.isBusy()) {
       if (lastReadTime == 0 ||
           millis() - lastReadTime >
               (retryCounter > 0 ? 5000 : refreshRateSec * 1000)) {
         lastReadTime = millis();
         SUPLA_LOG_DEBUG("SolarEdge connecting");
-        int returnCode = pvClient->connect("monitoringapi.solaredge.com", 443);
-        if (returnCode) {
-          retryCounter = 0;
-          dataFetchInProgress = true;
-          connectionTimeoutMs = lastReadTime;
-          SUPLA_LOG_DEBUG("Succesful connect");
-
-          time_t timestamp = time(0);  // get current time
-          timestamp -= 10 * 60;        // go back in time 10 minutes
+        time_t timestamp = time(0);  // get current time
+        timestamp -= 10 * 60;        // go back in time 10 minutes
 
 #define SOLAR_TMP_BUFFER_SIZE 100
 
-          char startTime[SOLAR_TMP_BUFFER_SIZE];
-          char endTime[SOLAR_TMP_BUFFER_SIZE];
+        char startTime[SOLAR_TMP_BUFFER_SIZE];
+        char endTime[SOLAR_TMP_BUFFER_SIZE];
 
-          struct tm timeinfo;
-          gmtime_r(&timestamp, &timeinfo);
+        struct tm timeinfo;
+        gmtime_r(&timestamp, &timeinfo);
 
-          snprintf(startTime,
-                   SOLAR_TMP_BUFFER_SIZE,
-                   "%d-%d-%d%%20%d:%d:%d",
-                   timeinfo.tm_year + 1900,
-                   timeinfo.tm_mon + 1,
-                   timeinfo.tm_mday,
-                   timeinfo.tm_hour,
-                   timeinfo.tm_min,
-                   timeinfo.tm_sec);
-          snprintf(endTime,
-                   SOLAR_TMP_BUFFER_SIZE,
-                   "%d-%d-%d%%2023:59:59",
-                   timeinfo.tm_year + 1900,
-                   timeinfo.tm_mon + 1,
-                   timeinfo.tm_mday);
+        snprintf(startTime,
+                 SOLAR_TMP_BUFFER_SIZE,
+                 "%d-%d-%d%%20%d:%d:%d",
+                 timeinfo.tm_year + 1900,
+                 timeinfo.tm_mon + 1,
+                 timeinfo.tm_mday,
+                 timeinfo.tm_hour,
+                 timeinfo.tm_min,
+                 timeinfo.tm_sec);
+        snprintf(endTime,
+                 SOLAR_TMP_BUFFER_SIZE,
+                 "%d-%d-%d%%2023:59:59",
+                 timeinfo.tm_year + 1900,
+                 timeinfo.tm_mon + 1,
+                 timeinfo.tm_mday);
 
-          char query[512];
-          int queryLen = snprintf(query,
-                                  sizeof(query),
-                                  "GET /equipment/%s/%s/data.csv?startTime=%s"
-                                  "&endTime=%s&api_key=%s HTTP/1.1",
-                                  siteId,
-                                  inverterSerialNumber,
-                                  startTime,
-                                  endTime,
-                                  apiKey);
-          if (queryLen < 0 || queryLen >= static_cast<int>(sizeof(query))) {
-            SUPLA_LOG_ERROR("SolarEdge query buffer overflow");
-            pvClient->stop();
-            dataFetchInProgress = false;
-            return Element::iterateConnected();
-          }
-
-          SUPLA_LOG_VERBOSE("SolarEdge query: %s", query);
-          pvClient->println(query);
-          pvClient->println(F("Host: localhost"));
-          pvClient->println(F("Connection: close"));
-          pvClient->println();
+        char query[512];
+        int queryLen = snprintf(query,
+                                sizeof(query),
+                                "/equipment/%s/%s/data.csv?startTime=%s"
+                                "&endTime=%s&api_key=%s",
+                                siteId,
+                                inverterSerialNumber,
+                                startTime,
+                                endTime,
+                                apiKey);
+        if (queryLen < 0 || queryLen >= static_cast<int>(sizeof(query))) {
+          SUPLA_LOG_ERROR("SolarEdge query buffer overflow");
+          return Element::iterateConnected();
+        }
 
-        } else {  // if connection wasn't successful, try few times
-          SUPLA_LOG_DEBUG("Failed to connect to SolarEdge api, return code: %d",
-                          returnCode);
+        SUPLA_LOG_VERBOSE("SolarEdge query: %s", query);
+        headerFound = false;
+        if (!poller.sendRequest(query)) {  // if it fails, try again sooner
+          SUPLA_LOG_DEBUG("Failed to connect to SolarEdge api");
           retryCounter++;
         }
       }
@@ -412,6 +197,185 @@ bool SolarEdge::iterateConnected() {
   return Element::iterateConnected();
 }
 
+void SolarEdge::onHttpBodyLine(char *line) {
+  if (line[0] == '\0') {
+    return;
+  }
+  SUPLA_LOG_VERBOSE("Received line: %s", line);
+  if (!headerFound) {
+    if (0 == strncmp(headerVerification,
+                     line,
+                     sizeof(headerVerification) - 1)) {
+      headerFound = true;
+    }
+  } else {
+    int commaCount = 0;
+    for (unsigned int i = 0; i < strlen(line); i++) {
+      if (line[i] == ',') commaCount++;
+    }
+    // proper line of data should contain at least 34 commas
+    if (commaCount >= 34) {
+      strtok(line, ",");
+      for (int i = 1; i < 34; i++) {
+        char *value =
+            strtok(nullptr, ",");  // NOLINT(runtime/threadsafe_fn)
+        /*
+0 date,
+1 inverterMode,
+2 temperature,
+3 totalActivePower,
+4 dcVoltage,
+5 groundFaultResistance,
+6 powerLimit,
+7 totalEnergy,
+8 vL1To2,
+9 vL2To3,
+10 vL3To1,
+11 L1-acCurrent,
+12 L1-acVoltage,
+13 L1-acFrequency,
+14 L1-apparentPower,
+15 L1-activePower,
+16 L1-reactivePower,
+17 L1-qRef,
+18 L1-cosPhi,
+19 L2-acCurrent,
+20 L2-acVoltage,
+21 L2-acFrequency,
+22 L2-apparentPower,
+23 L2-activePower,
+24 L2-reactivePower,
+25 L2-qRef,
+26 L2-cosPhi,
+27 L3-acCurrent,
+28 L3-acVoltage,
+29 L3-acFrequency,
+30 L3-apparentPower,
+31 L3-activePower,
+32 L3-reactivePower,
+33 L3-qRef,
+34 L3-cosPhi
+*/
+        switch (i) {
+          case 1: {  // inverterMode
+            if (strncmp(value, "MPPT", 4) != 0) {
+              // ignoring data for inverter in mode other than MPPT
+              i = commaCount;
+            }
+            break;
+          }
+          case 2: {  // temperature
+            temperature = atof(value);
+            break;
+          }
+          case 7: {  // totalEnergy - split per 3 phases
+            double energy = atof(value);
+            totalGeneratedEnergy = energy * 100;
+            break;
+          }
+          case 11: {  // L1 - acCurrent
+            double current = atof(value);
+            currentCurrent[0] = current * 1000;
+            break;
+          }
+          case 12: {  // L1 - acVoltage
+            double voltage = atof(value);
+            currentVoltage[0] = voltage * 100;
+            break;
+          }
+          case 13: {  // L1 - acFrequency
+            double frequency = atof(value);
+            currentFreq = frequency * 100;
+            break;
+          }
+          case 14: {  // L1 - apparentPower
+            double power = atof(value);
+            currentApparentPower[0] = power * 100000;
+            break;
+          }
+          case 15: {  // L1 - activePower
+            double power = atof(value);
+            currentActivePower[0] = power * 100000;
+            break;
+          }
+          case 16: {  // L1 - ReactivePower
+            double power = atof(value);
+            currentReactivePower[0] = power * 100000;
+            break;
+          }
+          case 19: {                       // L2 - acCurrent
+            double current = atof(value);  // Wh
+            currentCurrent[1] = current * 1000;
+            break;
+          }
+          case 20: {                       // L2 - acVoltage
+            double voltage = atof(value);  // Wh
+            currentVoltage[1] = voltage * 100;
+            break;
+          }
+          case 22: {  // L2 - apparentPower
+            double power = atof(value);
+            currentApparentPower[1] = power * 100000;
+            break;
+          }
+          case 23: {  // L2 - activePower
+            double power = atof(value);
+            currentActivePower[1] = power * 100000;
+            break;
+          }
+          case 24: {  // L2 - ReactivePower
+            double power = atof(value);
+            currentReactivePower[1] = power * 100000;
+            break;
+          }
+          case 27: {                       // L3 - acCurrent
+            double current = atof(value);  // Wh
+            currentCurrent[2] = current * 1000;
+            break;
+          }
+          case 28: {                       // L3 - acVoltage
+            double voltage = atof(value);  // Wh
+            currentVoltage[2] = voltage * 100;
+            break;
+          }
+          case 30: {  // L3 - apparentPower
+            double power = atof(value);
+            currentApparentPower[2] = power * 100000;
+            break;
+          }
+          case 31: {  // L3 - activePower
+            double power = atof(value);
+            currentActivePower[2] = power * 100000;
+            break;
+          }
+          case 32: {  // L3 - ReactivePower
+            double power = atof(value);
+            currentReactivePower[2] = power * 100000;
+            break;
+          }
+            // acCurrent setCurrent
+            // acVoltage
+            // acFreq
+            // apparentPower
+            // activePower
+            // ReactivePower
+        }
+      }
+    }
+  }
+}
+
+void SolarEdge::onHttpResponseComplete(bool success, int statusCode) {
+  if (!success || statusCode != 200 || !headerFound) {
+    SUPLA_LOG_DEBUG("SolarEdge: query failed (status: %d)", statusCode);
+    retryCounter++;
+    return;
+  }
+  retryCounter = 0;
+  SUPLA_LOG_DEBUG("SolarEdge fetch completed");
+  dataIsReady = true;
+}
+
 void SolarEdge::readValuesFromDevice() {
 }
 
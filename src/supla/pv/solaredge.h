@@ -8,15 +8,17 @@
 // Arduino Mega can't establish https connection, so it can't be supported
 
 #include <supla/clock/clock.h>
-#include <supla/network/client.h>
 #include <supla/sensor/electricity_meter.h>
 
+#include "http_poller.h"
+
 #define APIKEY_MAX_LENGTH    100
 #define PARAMETER_MAX_LENGTH 20
 
 namespace Supla {
 namespace PV {
-class SolarEdge : public Supla::Sensor::ElectricityMeter {
+class SolarEdge : public Supla::Sensor::ElectricityMeter,
+                  public HttpResponseHandler {
  public:
   SolarEdge(const char *apiKeyValue,
             const char *siteIdValue,
@@ -28,10 +30,11 @@ class SolarEdge : public Supla::Sensor::ElectricityMeter {
   bool iterateConnected();
   Channel *getSecondaryChannel();
 
- protected:
-  ::Supla::Client *pvClient = nullptr;
+  void onHttpBodyLine(char *line) override;
+  void onHttpResponseComplete(bool success, int statusCode) override;
 
-  char buf[1024];
+ protected:
+  HttpPoller poller;
 
   double temperature;
   unsigned _supla_int64_t totalGeneratedEnergy;
@@ -47,12 +50,9 @@ class SolarEdge : public Supla::Sensor::ElectricityMeter {
   // apparentPower
   // activePower
   // ReactivePower
-  int bytesCounter;
-  int retryCounter;
-  bool dataIsReady;
-  bool dataFetchInProgress;
-  bool headerFound;
-  uint32_t connectionTimeoutMs;
+  int retryCounter = 0;
+  bool dataIsReady = false;
+  bool headerFound = false;
 
   char apiKey[APIKEY_MAX_LENGTH] = {};
   char siteId[PARAMETER_MAX_LENGTH] = {};
@@ -1,15 +1,23 @@
 // SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
 // SPDX-License-Identifier: GPL-2.0-or-later
 
-#ifndef SUPLA_TEST
+#if !defined(SUPLA_TEST) || defined(SUPLA_TEST_RSA_VERIFICATOR)
 
 #include "rsa_verificator.h"
 
-#if defined(ESP32) || defined(SUPLA_DEVICE_ESP32)
+#if defined(ESP32) || defined(SUPLA_DEVICE_ESP32) || defined(SUPLA_LINUX) || \
+    defined(SUPLA_TEST_RSA_VERIFICATOR)
+
+#include <string.h>
 
+#if defined(ESP32) || defined(SUPLA_DEVICE_ESP32)
 #include <mbedtls/md.h>
 #include <mbedtls/pk.h>
-#include <string.h>
+#else
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#endif
 
 namespace {
 
@@ -139,6 +147,8 @@ static bool buildRsaSpkiDer(const uint8_t *modulus,
 
 }  // namespace
 
+#if defined(ESP32) || defined(SUPLA_DEVICE_ESP32)
+
 Supla::RsaVerificator::RsaVerificator(const uint8_t *publicKeyBytes)
     : rsa_ctx(nullptr), ready(false) {
   if (publicKeyBytes == nullptr) {
@@ -194,6 +204,59 @@ bool Supla::RsaVerificator::verify(Supla::Sha256 *hash,
   return result == 0;
 }
 
-#endif  // defined(ESP32) || defined(SUPLA_DEVICE_ESP32)
+#else  // SUPLA_LINUX
+
+Supla::RsaVerificator::RsaVerificator(const uint8_t *publicKeyBytes)
+    : rsa_ctx(nullptr), ready(false) {
+  if (publicKeyBytes == nullptr) {
+    return;
+  }
+  uint8_t spkiDer[800] = {};
+  size_t spkiLen = 0;
+  if (!buildRsaSpkiDer(publicKeyBytes,
+                       RSA_NUM_BYTES,
+                       spkiDer,
+                       sizeof(spkiDer),
+                       &spkiLen)) {
+    return;
+  }
+  const unsigned char *der = spkiDer;
+  EVP_PKEY *pkey = d2i_PUBKEY(nullptr, &der, spkiLen);
+  if (pkey != nullptr) {
+    rsa_ctx = pkey;
+    ready = true;
+  }
+}
+
+Supla::RsaVerificator::~RsaVerificator() {
+  EVP_PKEY_free(static_cast<EVP_PKEY *>(rsa_ctx));
+  rsa_ctx = nullptr;
+}
+
+bool Supla::RsaVerificator::verify(Supla::Sha256 *hash,
+                                   const uint8_t *signatureBytes) {
+  if (!ready || hash == nullptr || signatureBytes == nullptr) {
+    return false;
+  }
+  uint8_t digest[32] = {};
+  hash->digest(digest, sizeof(digest));
+
+  EVP_PKEY_CTX *ctx =
+      EVP_PKEY_CTX_new(static_cast<EVP_PKEY *>(rsa_ctx), nullptr);
+  if (ctx == nullptr) {
+    return false;
+  }
+  bool result =
+      EVP_PKEY_verify_init(ctx) == 1 &&
+      EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) == 1 &&
+      EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) == 1 &&
+      EVP_PKEY_verify(
+          ctx, signatureBytes, RSA_NUM_BYTES, digest, sizeof(digest)) == 1;
+  EVP_PKEY_CTX_free(ctx);
+  return result;
+}
+
+#endif
+#endif  // defined(ESP32) || defined(SUPLA_DEVICE_ESP32) || SUPLA_LINUX
 
-#endif  // SUPLA_TEST
+#endif  // !SUPLA_TEST || SUPLA_TEST_RSA_VERIFICATOR
@@ -4,7 +4,8 @@
 #ifndef SRC_SUPLA_RSA_VERIFICATOR_H_
 #define SRC_SUPLA_RSA_VERIFICATOR_H_
 
-#ifndef SUPLA_TEST
+// SUPLA_TEST_RSA_VERIFICATOR enables real implementation in Linux tests
+#if !defined(SUPLA_TEST) || defined(SUPLA_TEST_RSA_VERIFICATOR)
 
 /*
  * Simple wrapper for mbedTLS RSA methods used to verify sha256 hash
@@ -32,5 +33,5 @@ class RsaVerificator {
 
 };  // namespace Supla
 
-#endif  // SUPLA_TEST
+#endif  // !SUPLA_TEST || SUPLA_TEST_RSA_VERIFICATOR
 #endif  // SRC_SUPLA_RSA_VERIFICATOR_H_
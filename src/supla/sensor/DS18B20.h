@@ -10,6 +10,7 @@
 
 #include <supla/log_wrapper.h>
 
+#include "supla/sensor/dallas_ds_bus.h"
 #include "supla/sensor/thermometer.h"
 
 namespace Supla {
@@ -18,7 +19,11 @@ namespace Sensor {
 class OneWireBus {
  public:
   explicit OneWireBus(uint8_t pinNumber)
-      : pin(pinNumber), nextBus(nullptr), lastReadTime(0), oneWire(pinNumber) {
+      : pin(pinNumber),
+        nextBus(nullptr),
+        lastReadTime(0),
+        dsBus(&sensors, &oneWire),
+        oneWire(pinNumber) {
     SUPLA_LOG_DEBUG("Initializing OneWire bus at pin %d", pinNumber);
     sensors.setOneWire(&oneWire);
     sensors.begin();
@@ -84,6 +89,9 @@ class OneWireBus {
   OneWireBus *nextBus;
   uint32_t lastReadTime;
   DallasTemperature sensors;
+  DallasDsBus dsBus;
+  // bus id in conversion scheduler, -1 if not used
+  int schedulerBusId = -1;
 
  protected:
   OneWire oneWire;
@@ -127,7 +135,37 @@ class DS18B20 : public Thermometer {
     }
   }
 
+  /**
+   * Uses non-blocking conversion scheduler instead of reading the bus
+   * directly. All DS18B20 instances should use the same scheduler.
+   *
+   * @param scheduler conversion scheduler
+   * @param resolution resolution (9..12 bits) of this sensor
+   */
+  void setConversionScheduler(DsConversionScheduler *scheduler,
+                              uint8_t resolution = 12) {
+    if (myBus->schedulerBusId == -1) {
+      myBus->schedulerBusId = scheduler->addBus(&myBus->dsBus);
+    }
+    if (address[0] == 0 && !myBus->sensors.getAddress(address, 0)) {
+      SUPLA_LOG_WARNING("DS18B20: no device found for conversion scheduler");
+      return;
+    }
+    schedulerSensorId =
+        scheduler->addSensor(myBus->schedulerBusId, address, resolution);
+    if (schedulerSensorId >= 0) {
+      this->scheduler = scheduler;
+    }
+  }
+
   void iterateAlways() {
+    if (scheduler) {
+      if (millis() - lastReadTime > 1000) {
+        channel.setNewValue(getValue());
+        lastReadTime = millis();
+      }
+      return;
+    }
     if (millis() - myBus->lastReadTime > 10000) {
       myBus->sensors.requestTemperatures();
       myBus->lastReadTime = millis();
@@ -141,7 +179,9 @@ class DS18B20 : public Thermometer {
 
   double getValue() {
     double value = TEMPERATURE_NOT_AVAILABLE;
-    if (address[0] == 0) {
+    if (scheduler) {
+      value = scheduler->getTemperature(schedulerSensorId);
+    } else if (address[0] == 0) {
       value = myBus->sensors.getTempCByIndex(0);
     } else {
       value = myBus->sensors.getTempC(address);
@@ -176,6 +216,8 @@ class DS18B20 : public Thermometer {
   DeviceAddress address;
   int8_t retryCounter;
   double lastValidValue;
+  DsConversionScheduler *scheduler = nullptr;
+  int schedulerSensorId = -1;
 };
 
 OneWireBus *DS18B20::oneWireBus = nullptr;
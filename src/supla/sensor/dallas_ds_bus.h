@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_SENSOR_DALLAS_DS_BUS_H_
+#define SRC_SUPLA_SENSOR_DALLAS_DS_BUS_H_
+
+#include <DallasTemperature.h>
+#include <OneWire.h>
+
+#include "ds_conversion_scheduler.h"
+
+namespace Supla {
+namespace Sensor {
+
+// DsBus implementation for Arduino DallasTemperature library
+class DallasDsBus : public DsBus {
+ public:
+  DallasDsBus(DallasTemperature *sensors, OneWire *oneWire)
+      : sensors(sensors), oneWire(oneWire) {
+  }
+
+  bool startConversion() override {
+    bool wait = sensors->getWaitForConversion();
+    sensors->setWaitForConversion(false);
+    sensors->requestTemperatures();
+    sensors->setWaitForConversion(wait);
+    return true;
+  }
+
+  bool readScratchpad(const uint8_t *address, uint8_t *scratchpad) override {
+    return sensors->readScratchPad(address, scratchpad);
+  }
+
+  // DallasTemperature::setResolution reads scratchpad before the write and
+  // copies it to EEPROM (with 20 ms delay), so Write Scratchpad is sent
+  // directly as a single transaction.
+  bool writeResolution(const uint8_t *address,
+                       uint8_t resolution,
+                       uint8_t alarmHigh,
+                       uint8_t alarmLow) override {
+    if (address[0] == DS18S20MODEL) {
+      // no configuration register
+      return true;
+    }
+    if (!oneWire->reset()) {
+      return false;
+    }
+    oneWire->select(address);
+    oneWire->write(WRITESCRATCH);
+    oneWire->write(alarmHigh);
+    oneWire->write(alarmLow);
+    // configuration register: 0 R1 R0 1 1 1 1 1
+    oneWire->write(((resolution - 9) << 5) | 0x1F);
+    return oneWire->reset() == 1;
+  }
+
+  bool isParasitePowered() override {
+    return sensors->isParasitePowerMode();
+  }
+
+ protected:
+  DallasTemperature *sensors = nullptr;
+  OneWire *oneWire = nullptr;
+};
+
+};  // namespace Sensor
+};  // namespace Supla
+
+#endif  // SRC_SUPLA_SENSOR_DALLAS_DS_BUS_H_
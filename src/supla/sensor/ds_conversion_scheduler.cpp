@@ -0,0 +1,320 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "ds_conversion_scheduler.h"
+
+#include <string.h>
+
+#include <supla/log_wrapper.h>
+#include <supla/sensor/thermometer_driver.h>
+#include <supla/time.h>
+
+using Supla::Sensor::DsConversionScheduler;
+
+namespace {
+
+// Dallas/Maxim CRC-8 (x^8 + x^5 + x^4 + 1), as used by OneWire devices
+uint8_t dallasCrc8(const uint8_t *data, int size) {
+  uint8_t crc = 0;
+  for (int i = 0; i < size; i++) {
+    uint8_t byte = data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      uint8_t mix = (crc ^ byte) & 0x01;
+      crc >>= 1;
+      if (mix) {
+        crc ^= 0x8C;
+      }
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
+
+bool isDs18s20(const uint8_t *address) {
+  return address[0] == DS_DS18S20_FAMILY;
+}
+
+uint8_t clampResolution(uint8_t resolution) {
+  if (resolution < 9) {
+    return 9;
+  }
+  if (resolution > 12) {
+    return 12;
+  }
+  return resolution;
+}
+
+}  // namespace
+
+void DsConversionScheduler::iterateAlways() {
+  iterate(millis());
+}
+
+void DsConversionScheduler::iterate(uint32_t nowMs) {
+  if (busCount == 0) {
+    return;
+  }
+  uint8_t transactions = 0;
+  for (int i = 0; i < busCount; i++) {
+    if (transactions >= maxTransactionsPerIteration) {
+      break;
+    }
+    int busId = (nextBus + i) % busCount;
+    if (iterateBus(busId, nowMs)) {
+      transactions++;
+    }
+  }
+  nextBus = (nextBus + 1) % busCount;
+}
+
+bool DsConversionScheduler::iterateBus(int busId, uint32_t nowMs) {
+  auto &slot = buses[busId];
+  if (slot.converting) {
+    if (readNextSensor(busId, nowMs - slot.conversionStartMs)) {
+      return true;
+    }
+    for (auto &sensor : sensors) {
+      if (sensor.busId == busId && sensor.readPending) {
+        // waiting for conversion end
+        return false;
+      }
+    }
+    slot.converting = false;
+  }
+
+  if (slot.cycleStarted && nowMs - slot.conversionStartMs < intervalMs) {
+    return false;
+  }
+
+  if (writePendingResolution(busId)) {
+    return true;
+  }
+
+  bool anySensor = false;
+  for (auto &sensor : sensors) {
+    if (sensor.busId == busId) {
+      sensor.readPending = true;
+      anySensor = true;
+    }
+  }
+  if (!anySensor) {
+    return false;
+  }
+
+  if (!slot.bus->startConversion()) {
+    SUPLA_LOG_DEBUG("DS scheduler: bus %d failed to start conversion", busId);
+  }
+  slot.conversionStartMs = nowMs;
+  slot.cycleStarted = true;
+  slot.converting = true;
+  return true;
+}
+
+bool DsConversionScheduler::writePendingResolution(int busId) {
+  for (auto &sensor : sensors) {
+    if (sensor.busId == busId && sensor.resolutionPending) {
+      sensor.resolutionPending = false;
+      if (buses[busId].bus->writeResolution(sensor.address,
+                                            sensor.requestedResolution,
+                                            sensor.alarmHigh,
+                                            sensor.alarmLow)) {
+        sensor.resolution = sensor.requestedResolution;
+      } else {
+        SUPLA_LOG_DEBUG("DS scheduler: failed to set resolution on bus %d",
+                        busId);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DsConversionScheduler::readNextSensor(int busId, uint32_t elapsedMs) {
+  auto bus = buses[busId].bus;
+  uint32_t longestConversionMs = 0;
+  SensorSlot *next = nullptr;
+  for (auto &sensor : sensors) {
+    if (sensor.busId != busId || !sensor.readPending) {
+      continue;
+    }
+    uint32_t conversionMs = ConversionTimeMs(sensor.resolution);
+    if (conversionMs > longestConversionMs) {
+      longestConversionMs = conversionMs;
+    }
+    if (next == nullptr && elapsedMs >= conversionMs) {
+      next = &sensor;
+    }
+  }
+
+  if (next == nullptr ||
+      (bus->isParasitePowered() && elapsedMs < longestConversionMs)) {
+    return false;
+  }
+
+  next->readPending = false;
+  readSensor(next, bus);
+  return true;
+}
+
+void DsConversionScheduler::readSensor(SensorSlot *sensor, DsBus *bus) {
+  uint8_t scratchpad[DS_SCRATCHPAD_SIZE] = {};
+  if (!bus->readScratchpad(sensor->address, scratchpad) ||
+      dallasCrc8(scratchpad, DS_SCRATCHPAD_SIZE - 1) !=
+          scratchpad[DS_SCRATCHPAD_SIZE - 1]) {
+    sensor->temperature = DS_DISCONNECTED_TEMPERATURE;
+    return;
+  }
+
+  int16_t raw = static_cast<int16_t>(
+      static_cast<uint16_t>(scratchpad[1]) << 8 | scratchpad[0]);
+  sensor->alarmHigh = scratchpad[2];
+  sensor->alarmLow = scratchpad[3];
+
+  if (isDs18s20(sensor->address)) {
+    // raw value is in 0.5 C units. As in DallasTemperature, extended
+    // resolution is calculated from COUNT_REMAIN and COUNT_PER_C:
+    // TEMP_READ (0.5 C bit truncated) - 0.25 + (COUNT_PER_C - COUNT_REMAIN)
+    // / COUNT_PER_C
+    uint8_t countRemain = scratchpad[6];
+    uint8_t countPerC = scratchpad[7];
+    if (countPerC == 0) {
+      sensor->temperature = raw / 2.0;
+      return;
+    }
+    sensor->temperature =
+        (raw & ~1) / 2 - 0.25 +
+        static_cast<double>(countPerC - countRemain) / countPerC;
+    return;
+  }
+
+  // configuration register: 0 R1 R0 1 1 1 1 1
+  uint8_t resolution = 9 + ((scratchpad[4] >> 5) & 0x03);
+  if (resolution != sensor->resolution) {
+    SUPLA_LOG_DEBUG("DS scheduler: sensor resolution %d, expected %d",
+                    resolution, sensor->resolution);
+    sensor->resolution = resolution;
+  }
+  if (resolution != sensor->requestedResolution) {
+    sensor->resolutionPending = true;
+  }
+
+  // bits below resolution are undefined
+  raw &= ~((1 << (12 - resolution)) - 1);
+  sensor->temperature = raw / 16.0;
+}
+
+int DsConversionScheduler::addBus(DsBus *bus) {
+  if (bus == nullptr || busCount >= DS_SCHEDULER_MAX_BUSES) {
+    SUPLA_LOG_WARNING("DS scheduler: can't add more buses");
+    return -1;
+  }
+  buses[busCount] = {};
+  buses[busCount].bus = bus;
+  return busCount++;
+}
+
+int DsConversionScheduler::addSensor(int busId,
+                                     const uint8_t *address,
+                                     uint8_t resolution) {
+  if (busId < 0 || busId >= busCount || address == nullptr) {
+    return -1;
+  }
+  int existing = findSensor(busId, address);
+  if (existing >= 0) {
+    setResolution(existing, resolution);
+    return existing;
+  }
+  for (int i = 0; i < DS_SCHEDULER_MAX_SENSORS; i++) {
+    auto &sensor = sensors[i];
+    if (sensor.busId == -1) {
+      sensor = {};
+      sensor.busId = busId;
+      memcpy(sensor.address, address, sizeof(sensor.address));
+      sensor.temperature = TEMPERATURE_NOT_AVAILABLE;
+      setResolution(i, resolution);
+      return i;
+    }
+  }
+  SUPLA_LOG_WARNING("DS scheduler: can't add more sensors");
+  return -1;
+}
+
+void DsConversionScheduler::removeSensor(int sensorId) {
+  if (isValidSensorId(sensorId)) {
+    sensors[sensorId] = {};
+  }
+}
+
+int DsConversionScheduler::findSensor(int busId,
+                                      const uint8_t *address) const {
+  if (address == nullptr) {
+    return -1;
+  }
+  for (int i = 0; i < DS_SCHEDULER_MAX_SENSORS; i++) {
+    if (sensors[i].busId == busId && busId >= 0 &&
+        memcmp(sensors[i].address, address, sizeof(sensors[i].address)) ==
+            0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void DsConversionScheduler::setResolution(int sensorId, uint8_t resolution) {
+  if (!isValidSensorId(sensorId)) {
+    return;
+  }
+  auto &sensor = sensors[sensorId];
+  if (isDs18s20(sensor.address)) {
+    // resolution can't be changed, conversion always takes 750 ms
+    resolution = 12;
+  }
+  sensor.requestedResolution = clampResolution(resolution);
+  // Sensor keeps resolution in EEPROM, so it is written only when the
+  // first read shows a different value. Until then, conversion time of
+  // requested resolution is used.
+  sensor.resolution = sensor.requestedResolution;
+}
+
+uint8_t DsConversionScheduler::getResolution(int sensorId) const {
+  if (!isValidSensorId(sensorId)) {
+    return 0;
+  }
+  return sensors[sensorId].resolution;
+}
+
+void DsConversionScheduler::setInterval(uint32_t intervalMs) {
+  this->intervalMs = intervalMs;
+}
+
+void DsConversionScheduler::setMaxTransactionsPerIteration(uint8_t count) {
+  if (count == 0) {
+    count = 1;
+  }
+  maxTransactionsPerIteration = count;
+}
+
+double DsConversionScheduler::getTemperature(int sensorId) const {
+  if (!isValidSensorId(sensorId)) {
+    return TEMPERATURE_NOT_AVAILABLE;
+  }
+  return sensors[sensorId].temperature;
+}
+
+bool DsConversionScheduler::isBusy(int busId) const {
+  if (busId < 0 || busId >= busCount) {
+    return false;
+  }
+  return buses[busId].converting;
+}
+
+uint32_t DsConversionScheduler::ConversionTimeMs(uint8_t resolution) {
+  // 93.75 ms for 9 bits, doubled with each additional bit (rounded up)
+  int shift = 12 - clampResolution(resolution);
+  return (750 + (1 << shift) - 1) >> shift;
+}
+
+bool DsConversionScheduler::isValidSensorId(int sensorId) const {
+  return sensorId >= 0 && sensorId < DS_SCHEDULER_MAX_SENSORS &&
+         sensors[sensorId].busId != -1;
+}
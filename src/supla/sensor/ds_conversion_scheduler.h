@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_SENSOR_DS_CONVERSION_SCHEDULER_H_
+#define SRC_SUPLA_SENSOR_DS_CONVERSION_SCHEDULER_H_
+
+#include <stdint.h>
+
+#include <supla/element.h>
+
+#define DS_SCHEDULER_MAX_BUSES 4
+#define DS_SCHEDULER_MAX_SENSORS 32
+#define DS_SCHEDULER_DEFAULT_INTERVAL_MS 10000
+#define DS_SCRATCHPAD_SIZE 9
+// DS18S20/DS1820 family code. It has fixed 9 bit resolution (with extended
+// resolution from COUNT_REMAIN/COUNT_PER_C) and no configuration register.
+#define DS_DS18S20_FAMILY 0x10
+// Value reported by DallasTemperature for not responding sensor
+#define DS_DISCONNECTED_TEMPERATURE -127.0
+
+namespace Supla {
+namespace Sensor {
+
+/**
+ * Low level access to one OneWire bus with DS18B20 (or compatible) sensors.
+ *
+ * Each method performs a single bus transaction and must not wait for
+ * temperature conversion to finish.
+ */
+class DsBus {
+ public:
+  virtual ~DsBus() = default;
+  // Sends Skip ROM + Convert T, so all sensors on the bus start conversion
+  virtual bool startConversion() = 0;
+  // Reads 9 bytes of scratchpad (including CRC byte) of given sensor.
+  // Returns false when sensor didn't respond. CRC is checked by scheduler.
+  virtual bool readScratchpad(const uint8_t *address, uint8_t *scratchpad) = 0;
+  // Writes scratchpad of given sensor: alarm registers (as read from the
+  // sensor) and configuration register (resolution 9..12 bits). Scratchpad
+  // is not copied to EEPROM, as it takes another 10 ms and wears EEPROM.
+  virtual bool writeResolution(const uint8_t *address,
+                               uint8_t resolution,
+                               uint8_t alarmHigh,
+                               uint8_t alarmLow) = 0;
+  // Sensors in parasite power mode can't be read during conversion of
+  // other sensors, so all of them are read after the longest conversion.
+  virtual bool isParasitePowered() {
+    return false;
+  }
+};
+
+/**
+ * Non-blocking DS18B20 conversion scheduler.
+ *
+ * Every interval, one bus-wide conversion is started on each registered bus.
+ * Conversions on all buses run in parallel. Scratchpads are collected on
+ * later iterations: each sensor is read as soon as conversion time for its
+ * resolution has elapsed. By default only one bus transaction is done in a
+ * single iteration (buses are served in round robin), so device loop is
+ * never blocked by the OneWire communication for longer than one scratchpad
+ * read. It can be increased with setMaxTransactionsPerIteration() (up to one
+ * transaction per bus).
+ *
+ * Resolution reported in the scratchpad is used for decoding and for the
+ * conversion time of the next cycle. When it differs from the requested one
+ * (i.e. after sensor power loss), requested resolution is written again
+ * before the next conversion.
+ *
+ * DS18S20/DS1820 sensors (family 0x10) are decoded as in DallasTemperature
+ * and always use 750 ms conversion time.
+ */
+class DsConversionScheduler : public Element {
+ public:
+  void iterateAlways() override;
+  // Does a single scheduler step. Public for tests.
+  void iterate(uint32_t nowMs);
+
+  // Returns bus id or -1 when there is no free slot
+  int addBus(DsBus *bus);
+  // Returns sensor id or -1 when there is no free slot or busId is invalid
+  int addSensor(int busId, const uint8_t *address, uint8_t resolution = 12);
+  void removeSensor(int sensorId);
+  // Returns id of sensor with given address or -1
+  int findSensor(int busId, const uint8_t *address) const;
+
+  void setResolution(int sensorId, uint8_t resolution);
+  uint8_t getResolution(int sensorId) const;
+  // Time between starts of consecutive conversions on the bus
+  void setInterval(uint32_t intervalMs);
+  // Limits number of bus transactions done in one iteration on all buses
+  void setMaxTransactionsPerIteration(uint8_t count);
+
+  // Returns TEMPERATURE_NOT_AVAILABLE until first read of the sensor and
+  // DS_DISCONNECTED_TEMPERATURE when sensor didn't respond in last cycle
+  double getTemperature(int sensorId) const;
+  // Returns true when cycle (conversion and reads) is in progress on the bus
+  bool isBusy(int busId) const;
+
+  // Worst case conversion time for given resolution
+  static uint32_t ConversionTimeMs(uint8_t resolution);
+
+ protected:
+  struct BusSlot {
+    DsBus *bus = nullptr;
+    uint32_t conversionStartMs = 0;
+    bool converting = false;
+    bool cycleStarted = false;
+  };
+
+  struct SensorSlot {
+    int8_t busId = -1;
+    uint8_t address[8] = {};
+    uint8_t requestedResolution = 12;
+    // resolution reported by sensor
+    uint8_t resolution = 12;
+    bool resolutionPending = false;
+    bool readPending = false;
+    // TH and TL registers from last read, kept on resolution write
+    uint8_t alarmHigh = 0;
+    uint8_t alarmLow = 0;
+    double temperature = 0;
+  };
+
+  // Returns true when bus transaction was done
+  bool iterateBus(int busId, uint32_t nowMs);
+  bool writePendingResolution(int busId);
+  bool readNextSensor(int busId, uint32_t elapsedMs);
+  void readSensor(SensorSlot *sensor, DsBus *bus);
+  bool isValidSensorId(int sensorId) const;
+
+  BusSlot buses[DS_SCHEDULER_MAX_BUSES];
+  SensorSlot sensors[DS_SCHEDULER_MAX_SENSORS];
+  uint32_t intervalMs = DS_SCHEDULER_DEFAULT_INTERVAL_MS;
+  uint8_t maxTransactionsPerIteration = 1;
+  uint8_t busCount = 0;
+  uint8_t nextBus = 0;
+};
+
+}  // namespace Sensor
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_SENSOR_DS_CONVERSION_SCHEDULER_H_
@@ -25,6 +25,11 @@ Supla::Sensor::ElectricityMeter::ElectricityMeter() {
   usedConfigTypes.set(SUPLA_CONFIG_TYPE_DEFAULT);
 }
 
+Supla::Sensor::ElectricityMeter::~ElectricityMeter() {
+  delete aggregation;
+  aggregation = nullptr;
+}
+
 void Supla::Sensor::ElectricityMeter::updateChannelValues() {
   if (!valueChanged && lastChannelUpdateTime != 0) {
     return;
@@ -720,6 +725,19 @@ void Supla::Sensor::ElectricityMeter::onInit() {
 }
 
 void Supla::Sensor::ElectricityMeter::iterateAlways() {
+  if (aggregation) {
+    uint32_t now = millis();
+    if (lastSampleTime == 0 || now - lastSampleTime >= samplingIntervalMs) {
+      lastSampleTime = now;
+      readValuesFromDevice();
+      addAggregationSample(now);
+    }
+    if (lastReadTime == 0 || now - lastReadTime > refreshRateSec * 1000) {
+      lastReadTime = now;
+      publishAggregatedValues();
+    }
+    return;
+  }
   if (lastReadTime == 0 || millis() - lastReadTime > refreshRateSec * 1000) {
     lastReadTime = millis();
     readValuesFromDevice();
@@ -727,6 +745,144 @@ void Supla::Sensor::ElectricityMeter::iterateAlways() {
   }
 }
 
+void Supla::Sensor::ElectricityMeter::enableSampleAggregation(
+    uint32_t samplingIntervalMs, EmAggregationMode mode) {
+  if (aggregation == nullptr) {
+    aggregation = new EmAggregation;
+  }
+  this->samplingIntervalMs = samplingIntervalMs;
+  aggregationMode = mode;
+}
+
+bool Supla::Sensor::ElectricityMeter::isSampleAggregationEnabled() const {
+  return aggregation != nullptr;
+}
+
+void Supla::Sensor::ElectricityMeter::setAggregationMode(
+    EmAggregationMode mode) {
+  aggregationMode = mode;
+}
+
+Supla::Sensor::EmAggregationMode
+Supla::Sensor::ElectricityMeter::getAggregationMode() const {
+  return aggregationMode;
+}
+
+void Supla::Sensor::ElectricityMeter::enableEnergyIntegration() {
+  if (aggregation == nullptr) {
+    SUPLA_LOG_WARNING("EM[%d]: energy integration requires sample aggregation",
+                      getChannelNumber());
+    return;
+  }
+  aggregation->setEnergyIntegration(true);
+}
+
+int64_t Supla::Sensor::ElectricityMeter::getAggregatedValue(
+    EmAggregatedValue value, int phase, EmAggregationMode mode) const {
+  if (phase < 0 || phase >= MAX_PHASES) {
+    return 0;
+  }
+  if (aggregation) {
+    return aggregation->getLast(value, phase).get(mode);
+  }
+  switch (value) {
+    case EmAggregatedValue::Voltage:
+      return emValue.m[0].voltage[phase];
+    case EmAggregatedValue::Current:
+      return rawCurrent[phase];
+    case EmAggregatedValue::PowerActive:
+      return rawActivePower[phase];
+    case EmAggregatedValue::PowerReactive:
+      return rawReactivePower[phase];
+    case EmAggregatedValue::PowerApparent:
+      return rawApparentPower[phase];
+  }
+  return 0;
+}
+
+void Supla::Sensor::ElectricityMeter::addAggregationSample(
+    uint32_t timestampMs) {
+  bool integrate = aggregation->isEnergyIntegrationEnabled();
+  for (int i = 0; i < MAX_PHASES; i++) {
+    if (emValue.measured_values & EM_VAR_VOLTAGE) {
+      aggregation->addSample(
+          EmAggregatedValue::Voltage, i, emValue.m[0].voltage[i]);
+    }
+    if (currentMeasurementAvailable) {
+      aggregation->addSample(EmAggregatedValue::Current, i, rawCurrent[i]);
+    }
+    if (powerActiveMeasurementAvailable) {
+      aggregation->addSample(
+          EmAggregatedValue::PowerActive, i, rawActivePower[i]);
+      if (integrate) {
+        int64_t energy = aggregation->integratePower(
+            i, false, rawActivePower[i], timestampMs);
+        setFwdActEnergy(i, getFwdActEnergy(i) + (energy > 0 ? energy : 0));
+        setRvrActEnergy(i, getRvrActEnergy(i) + (energy < 0 ? -energy : 0));
+      }
+    }
+    if (powerReactiveMeasurementAvailable) {
+      aggregation->addSample(
+          EmAggregatedValue::PowerReactive, i, rawReactivePower[i]);
+      if (integrate) {
+        int64_t energy = aggregation->integratePower(
+            i, true, rawReactivePower[i], timestampMs);
+        setFwdReactEnergy(i,
+                          getFwdReactEnergy(i) + (energy > 0 ? energy : 0));
+        setRvrReactEnergy(i,
+                          getRvrReactEnergy(i) + (energy < 0 ? -energy : 0));
+      }
+    }
+    if (powerApparentMeasurementAvailable) {
+      aggregation->addSample(
+          EmAggregatedValue::PowerApparent, i, rawApparentPower[i]);
+    }
+  }
+}
+
+void Supla::Sensor::ElectricityMeter::publishAggregatedValues() {
+  aggregation->closeWindow();
+  applyAggregatedValues(aggregationMode);
+  updateChannelValues();
+
+  // getters return last read values again, so they are not taken as
+  // samples in case device doesn't set all values on each read. When they
+  // differ from published ones, valueChanged is set, so the next window is
+  // sent even if device keeps reporting the same values.
+  applyAggregatedValues(EmAggregationMode::Last);
+}
+
+void Supla::Sensor::ElectricityMeter::applyAggregatedValues(
+    EmAggregationMode mode) {
+  for (int i = 0; i < MAX_PHASES; i++) {
+    for (int v = 0; v < EmAggregatedValueCount; v++) {
+      auto value = static_cast<EmAggregatedValue>(v);
+      auto &stats = aggregation->getLast(value, i);
+      if (stats.isEmpty()) {
+        continue;
+      }
+      int64_t result = stats.get(mode);
+      switch (value) {
+        case EmAggregatedValue::Voltage:
+          setVoltage(i, result);
+          break;
+        case EmAggregatedValue::Current:
+          setCurrent(i, result);
+          break;
+        case EmAggregatedValue::PowerActive:
+          setPowerActive(i, result);
+          break;
+        case EmAggregatedValue::PowerReactive:
+          setPowerReactive(i, result);
+          break;
+        case EmAggregatedValue::PowerApparent:
+          setPowerApparent(i, result);
+          break;
+      }
+    }
+  }
+}
+
 // Implement this method to reset stored energy value (i.e. to set energy
 // counter back to 0 kWh
 void Supla::Sensor::ElectricityMeter::resetStorage() {
@@ -10,6 +10,7 @@
 
 #include "../channel_extended.h"
 #include "../local_action.h"
+#include "em_aggregation.h"
 
 #define MAX_PHASES 3
 
@@ -52,6 +53,7 @@ class ElectricityMeter : public ElementWithChannelActions,
                          public ActionHandler {
  public:
   ElectricityMeter();
+  ~ElectricityMeter();
 
   virtual void updateChannelValues();
 
@@ -362,6 +364,32 @@ class ElectricityMeter : public ElementWithChannelActions,
 
   void setRefreshRate(unsigned int sec);
 
+  /**
+   * Enables aggregation of samples read between channel updates.
+   * readValuesFromDevice() is called every samplingIntervalMs and channel
+   * value (sent every refresh rate) contains voltage, current and powers
+   * selected by mode from all samples read since the previous update.
+   * Remaining parameters are reported as last read.
+   */
+  void enableSampleAggregation(
+      uint32_t samplingIntervalMs,
+      EmAggregationMode mode = EmAggregationMode::Mean);
+  bool isSampleAggregationEnabled() const;
+  void setAggregationMode(EmAggregationMode mode);
+  EmAggregationMode getAggregationMode() const;
+
+  // Integrates active and reactive power of each sample (trapezoidal rule)
+  // into energy counters. Use it only for devices which don't provide
+  // energy. Sample aggregation has to be enabled.
+  void enableEnergyIntegration();
+
+  // Returns value selected by mode from samples sent in the last channel
+  // update. When aggregation is disabled, current value is returned.
+  // Units are the same as in getters above.
+  int64_t getAggregatedValue(EmAggregatedValue value,
+                             int phase,
+                             EmAggregationMode mode) const;
+
   void sendDataWithDelay(int delayMs = 0);
 
   Channel *getChannel() override;
@@ -381,6 +409,11 @@ class ElectricityMeter : public ElementWithChannelActions,
   bool isPhaseLedTypeSupported(uint64_t ledType) const;
 
  protected:
+  void addAggregationSample(uint32_t timestampMs);
+  void publishAggregatedValues();
+  // Sets values from the last aggregation window selected by mode
+  void applyAggregatedValues(EmAggregationMode mode);
+
   TElectricityMeter_ExtendedValue_V3 emValue = {};
   ChannelExtended extChannel;
   uint32_t lastChannelUpdateTime = 0;
@@ -390,6 +423,10 @@ class ElectricityMeter : public ElementWithChannelActions,
   int64_t rawApparentPower[MAX_PHASES] = {};
 
   uint32_t lastReadTime = 0;
+  uint32_t lastSampleTime = 0;
+  uint32_t samplingIntervalMs = 0;
+  EmAggregation *aggregation = nullptr;
+  EmAggregationMode aggregationMode = EmAggregationMode::Mean;
   uint16_t refreshRateSec = 5;
   bool valueChanged = false;
   bool currentMeasurementAvailable = false;
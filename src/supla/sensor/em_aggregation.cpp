@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "em_aggregation.h"
+
+namespace {
+// 1 kWh = 3 600 000 000 W * ms, the same ratio applies to 0.00001 units.
+// Integrator sums (p1 + p2) * dt, so it is doubled.
+constexpr int64_t doubledPowerMsPerEnergyUnit = 2 * 3600000000LL;
+}  // namespace
+
+using Supla::Sensor::EmAggregatedValue;
+using Supla::Sensor::EmAggregation;
+using Supla::Sensor::EmAggregationMode;
+using Supla::Sensor::EmRunningStats;
+
+void EmRunningStats::add(int64_t value) {
+  if (count == 0 || value < min) {
+    min = value;
+  }
+  if (count == 0 || value > max) {
+    max = value;
+  }
+  last = value;
+  sum += value;
+  count++;
+}
+
+void EmRunningStats::reset() {
+  *this = {};
+}
+
+bool EmRunningStats::isEmpty() const {
+  return count == 0;
+}
+
+uint32_t EmRunningStats::getCount() const {
+  return count;
+}
+
+int64_t EmRunningStats::get(EmAggregationMode mode) const {
+  if (count == 0) {
+    return 0;
+  }
+  switch (mode) {
+    case EmAggregationMode::Last:
+      return last;
+    case EmAggregationMode::Min:
+      return min;
+    case EmAggregationMode::Max:
+      return max;
+    case EmAggregationMode::Mean: {
+      // rounded to the nearest value
+      int64_t half = count / 2;
+      return (sum >= 0 ? sum + half : sum - half) / count;
+    }
+  }
+  return last;
+}
+
+void EmAggregation::addSample(EmAggregatedValue value,
+                              int phase,
+                              int64_t sample) {
+  if (phase < 0 || phase >= EM_AGGREGATION_MAX_PHASES) {
+    return;
+  }
+  current[static_cast<int>(value)][phase].add(sample);
+}
+
+void EmAggregation::closeWindow() {
+  for (int value = 0; value < EmAggregatedValueCount; value++) {
+    for (int phase = 0; phase < EM_AGGREGATION_MAX_PHASES; phase++) {
+      last[value][phase] = current[value][phase];
+      current[value][phase].reset();
+    }
+  }
+}
+
+const EmRunningStats &EmAggregation::getCurrent(EmAggregatedValue value,
+                                                int phase) const {
+  if (phase < 0 || phase >= EM_AGGREGATION_MAX_PHASES) {
+    phase = 0;
+  }
+  return current[static_cast<int>(value)][phase];
+}
+
+const EmRunningStats &EmAggregation::getLast(EmAggregatedValue value,
+                                             int phase) const {
+  if (phase < 0 || phase >= EM_AGGREGATION_MAX_PHASES) {
+    phase = 0;
+  }
+  return last[static_cast<int>(value)][phase];
+}
+
+void EmAggregation::setEnergyIntegration(bool enabled) {
+  energyIntegration = enabled;
+}
+
+bool EmAggregation::isEnergyIntegrationEnabled() const {
+  return energyIntegration;
+}
+
+int64_t EmAggregation::integratePower(int phase,
+                                      bool reactive,
+                                      int64_t power,
+                                      uint32_t timestampMs) {
+  if (!energyIntegration || phase < 0 || phase >= EM_AGGREGATION_MAX_PHASES) {
+    return 0;
+  }
+  auto &integrator = integrators[reactive ? 1 : 0][phase];
+  if (integrator.started) {
+    int64_t elapsedMs = timestampMs - integrator.lastTimestampMs;
+    integrator.remainder += (integrator.lastPower + power) * elapsedMs;
+  }
+  integrator.started = true;
+  integrator.lastPower = power;
+  integrator.lastTimestampMs = timestampMs;
+
+  int64_t energy = integrator.remainder / doubledPowerMsPerEnergyUnit;
+  integrator.remainder -= energy * doubledPowerMsPerEnergyUnit;
+  return energy;
+}
@@ -0,0 +1,100 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_SENSOR_EM_AGGREGATION_H_
+#define SRC_SUPLA_SENSOR_EM_AGGREGATION_H_
+
+#include <stdint.h>
+
+#define EM_AGGREGATION_MAX_PHASES 3
+
+namespace Supla {
+namespace Sensor {
+
+// Value reported for aggregation window
+enum class EmAggregationMode : uint8_t {
+  Last,
+  Mean,
+  Min,
+  Max,
+};
+
+// Per phase values which are aggregated
+enum class EmAggregatedValue : uint8_t {
+  Voltage,
+  Current,
+  PowerActive,
+  PowerReactive,
+  PowerApparent,
+};
+
+constexpr int EmAggregatedValueCount = 5;
+
+// Running min/max/mean/last of one value. Updated in O(1) per sample.
+class EmRunningStats {
+ public:
+  void add(int64_t value);
+  void reset();
+  bool isEmpty() const;
+  uint32_t getCount() const;
+  // Returns 0 when there were no samples
+  int64_t get(EmAggregationMode mode) const;
+
+ protected:
+  int64_t last = 0;
+  int64_t min = 0;
+  int64_t max = 0;
+  int64_t sum = 0;
+  uint32_t count = 0;
+};
+
+/**
+ * Aggregates ElectricityMeter samples read between channel updates.
+ *
+ * Current window collects running statistics of each per phase value.
+ * closeWindow() makes it available as the last window and starts a new one.
+ *
+ * Optional energy integration (for drivers which only provide power)
+ * integrates active and reactive power of consecutive samples with
+ * trapezoidal rule. Result is kept in power units * ms and only whole
+ * energy units are returned, so no energy is lost on rounding.
+ */
+class EmAggregation {
+ public:
+  void addSample(EmAggregatedValue value, int phase, int64_t sample);
+  void closeWindow();
+
+  // Values from current (not closed yet) window
+  const EmRunningStats &getCurrent(EmAggregatedValue value, int phase) const;
+  // Values from last closed window
+  const EmRunningStats &getLast(EmAggregatedValue value, int phase) const;
+
+  void setEnergyIntegration(bool enabled);
+  bool isEnergyIntegrationEnabled() const;
+  // Integrates power sample (in 0.00001 W or var) taken at timestampMs.
+  // Returns energy (in 0.00001 kWh or kvarh) which should be added to
+  // forward (positive) or reverse (negative) counter.
+  int64_t integratePower(int phase,
+                         bool reactive,
+                         int64_t power,
+                         uint32_t timestampMs);
+
+ protected:
+  struct Integrator {
+    int64_t lastPower = 0;
+    // energy not returned yet, in 0.00001 W * ms * 2
+    int64_t remainder = 0;
+    uint32_t lastTimestampMs = 0;
+    bool started = false;
+  };
+
+  EmRunningStats current[EmAggregatedValueCount][EM_AGGREGATION_MAX_PHASES];
+  EmRunningStats last[EmAggregatedValueCount][EM_AGGREGATION_MAX_PHASES];
+  Integrator integrators[2][EM_AGGREGATION_MAX_PHASES];
+  bool energyIntegration = false;
+};
+
+}  // namespace Sensor
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_SENSOR_EM_AGGREGATION_H_
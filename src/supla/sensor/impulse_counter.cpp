@@ -8,8 +8,32 @@
 #include <supla/storage/storage.h>
 #include <supla/time.h>
 
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+#define SUPLA_IC_ISR_ATTR IRAM_ATTR
+#else
+#define SUPLA_IC_ISR_ATTR
+#endif
+
 using Supla::Sensor::ImpulseCounter;
 
+ImpulseCounter
+    *ImpulseCounter::edgeCaptureSlots[SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS] =
+        {};
+
+template <int N>
+void SUPLA_IC_ISR_ATTR ImpulseCounter::edgeIsr() {
+  ImpulseCounter *counter = edgeCaptureSlots[N];
+  if (counter) {
+    counter->onEdge();
+  }
+}
+
+void (*const ImpulseCounter::edgeIsrs[SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS])(
+    void) = {ImpulseCounter::edgeIsr<0>,
+             ImpulseCounter::edgeIsr<1>,
+             ImpulseCounter::edgeIsr<2>,
+             ImpulseCounter::edgeIsr<3>};
+
 ImpulseCounter::ImpulseCounter(Supla::Io::IoPin impulsePin,
                                bool _detectLowToHigh,
                                bool _inputPullup,
@@ -59,13 +83,135 @@ ImpulseCounter::ImpulseCounter(int _impulsePin,
                      minSignalTimeToCountMs) {
 }
 
+ImpulseCounter::~ImpulseCounter() {
+  if (edgeCaptureSlot >= 0) {
+    Supla::Io::detachInterrupt(
+        Supla::Io::pinToInterrupt(impulsePin.getPin(), impulsePin.io),
+        impulsePin.io);
+    edgeCaptureSlots[edgeCaptureSlot] = nullptr;
+    edgeCaptureSlot = -1;
+  }
+}
+
+void ImpulseCounter::setEdgeCaptureMode(bool enabled) {
+  edgeCaptureRequested = enabled;
+}
+
+bool ImpulseCounter::isEdgeCaptureActive() const {
+  return edgeCaptureSlot >= 0;
+}
+
 void ImpulseCounter::onInit() {
   impulsePin.pinMode(channel.getChannelNumber());
   prevState = impulsePin.digitalRead(channel.getChannelNumber());
   newStateCandidate = prevState;
+
+  if (!edgeCaptureRequested || edgeCaptureSlot >= 0 ||
+      impulsePin.getPin() < 0) {
+    return;
+  }
+#ifdef SUPLA_FREERTOS
+  // micros() has only tick resolution, so debounce and minimum signal time
+  // can't be checked in interrupt handler
+  SUPLA_LOG_WARNING("IC[%d]: no us timer for edge capture, using polling",
+                    getChannelNumber());
+  return;
+#endif
+#ifndef ARDUINO
+  // native attachInterrupt is implemented only in Arduino builds (ESP-IDF
+  // and Linux ports have stubs), so custom Io is required
+  if (impulsePin.io == nullptr) {
+    SUPLA_LOG_WARNING("IC[%d]: GPIO interrupt not supported, using polling",
+                      getChannelNumber());
+    return;
+  }
+#endif
+  if (impulsePin.io && !impulsePin.io->customDigitalReadIsrSafe()) {
+    SUPLA_LOG_WARNING("IC[%d]: Io can't be read from interrupt, using polling",
+                      getChannelNumber());
+    return;
+  }
+  for (int i = 0; i < SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS; i++) {
+    if (edgeCaptureSlots[i] == nullptr) {
+      edgeCaptureSlot = i;
+      break;
+    }
+  }
+  if (edgeCaptureSlot < 0) {
+    SUPLA_LOG_WARNING("IC[%d]: no free edge capture slot, using polling",
+                      getChannelNumber());
+    return;
+  }
+  isrPulseActive = false;
+  isrPulses = 0;
+  drainedPulses = 0;
+  // first pulse is not affected by debounce delay
+  isrLastCountUs = micros() - debounceDelayMs * 1000UL;
+  edgeCaptureSlots[edgeCaptureSlot] = this;
+  Supla::Io::attachInterrupt(
+      Supla::Io::pinToInterrupt(impulsePin.getPin(), impulsePin.io),
+      edgeIsrs[edgeCaptureSlot],
+      CHANGE,
+      impulsePin.io);
+  SUPLA_LOG_DEBUG("IC[%d]: edge capture enabled", getChannelNumber());
+}
+
+void SUPLA_IC_ISR_ATTR ImpulseCounter::onEdge() {
+  uint32_t nowUs = micros();
+  // custom Io is used only when it reported that it is ISR safe
+#ifdef ARDUINO
+  // Arduino's digitalRead can be used from interrupt handler
+  int state = impulsePin.io ? impulsePin.digitalRead()
+                            : ::digitalRead(impulsePin.getPin());
+#else
+  int state = impulsePin.digitalRead();
+#endif
+  int activeState = detectLowToHigh ? HIGH : LOW;
+  if (state == activeState) {
+    if (isrPulseActive) {
+      return;
+    }
+    isrPulseActive = true;
+    isrPulseStartUs = nowUs;
+    if (minSignalTimeToCountMs > 0) {
+      return;
+    }
+  } else {
+    if (!isrPulseActive) {
+      return;
+    }
+    isrPulseActive = false;
+    if (minSignalTimeToCountMs == 0 ||
+        nowUs - isrPulseStartUs < minSignalTimeToCountMs * 1000UL) {
+      return;
+    }
+  }
+  if (isrPulseStartUs - isrLastCountUs < debounceDelayMs * 1000UL) {
+    return;
+  }
+  isrLastCountUs = isrPulseStartUs;
+  __atomic_store_n(&isrPulses, isrPulses + 1, __ATOMIC_RELEASE);
+}
+
+void ImpulseCounter::drainEdgeCapture() {
+  uint32_t pulses = __atomic_load_n(&isrPulses, __ATOMIC_ACQUIRE);
+  // unsigned arithmetic handles wrap around of isrPulses
+  for (; drainedPulses != pulses; drainedPulses++) {
+    incCounter();
+  }
+}
+
+void ImpulseCounter::iterateAlways() {
+  if (edgeCaptureSlot >= 0) {
+    drainEdgeCapture();
+  }
+  VirtualImpulseCounter::iterateAlways();
 }
 
 void ImpulseCounter::onFastTimer() {
+  if (edgeCaptureSlot >= 0) {
+    return;
+  }
   int currentState = impulsePin.digitalRead(channel.getChannelNumber());
   if (currentState != newStateCandidate) {
     newStateCandidate = currentState;
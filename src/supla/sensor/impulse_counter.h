@@ -8,6 +8,9 @@
 #include <supla/io.h>
 #include <supla/sensor/virtual_impulse_counter.h>
 
+// Max number of counters with enabled edge capture mode
+#define SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS 4
+
 namespace Supla {
 
 namespace Sensor {
@@ -29,11 +32,36 @@ class ImpulseCounter : public VirtualImpulseCounter {
                  bool inputPullup = true,
                  uint16_t _debounceDelay = 10,
                  uint16_t minSignalTimeToCountMs = 0);
+  ~ImpulseCounter();
+
+  /**
+   * Enables counting from pin change interrupt instead of sampling the pin
+   * in onFastTimer(). It has to be called before onInit().
+   *
+   * Interrupt handler only timestamps edges and updates lock-free pulse
+   * counter, which is drained to the channel counter in iterateAlways().
+   * Debounce delay is measured between counted pulses and, when minimum
+   * signal time is set, pulse is counted on its trailing edge if it was long
+   * enough. If interrupt can't be used (i.e. all
+   * SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS are taken, or custom Io doesn't
+   * report customDigitalReadIsrSafe()), counter falls back to polling.
+   * Outside of Arduino builds native GPIO interrupts are not implemented, so
+   * edge capture works only with ISR safe custom Io. It is not available
+   * with SUPLA_FREERTOS, where micros() has only tick resolution.
+   */
+  void setEdgeCaptureMode(bool enabled);
+  bool isEdgeCaptureActive() const;
 
   void onInit() override;
   void onFastTimer() override;
+  void iterateAlways() override;
 
  protected:
+  template <int N>
+  static void edgeIsr();
+  void onEdge();
+  void drainEdgeCapture();
+
   uint32_t lastImpulseMillis =
       0;  // Stores timestamp of last impulse (used to ignore
           // changes of state during 10 ms timeframe)
@@ -48,6 +76,23 @@ class ImpulseCounter : public VirtualImpulseCounter {
   int8_t prevState = 0;  // Store previous state of pin (LOW/HIGH). It is used
                          // to track changes on pin state.
   int8_t newStateCandidate = 0;  // Stores new state of pin (LOW/HIGH)
+
+  bool edgeCaptureRequested = false;
+  int8_t edgeCaptureSlot = -1;
+  // Edge capture state, modified only by interrupt handler (apart from
+  // onInit). Times are in us.
+  bool isrPulseActive = false;
+  uint32_t isrPulseStartUs = 0;
+  uint32_t isrLastCountUs = 0;
+  uint32_t isrPulses = 0;
+  // number of isrPulses already added to the counter
+  uint32_t drainedPulses = 0;
+
+  static ImpulseCounter
+      *edgeCaptureSlots[SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS];
+  // interrupt handler for each slot
+  static void (*const edgeIsrs[SUPLA_IMPULSE_COUNTER_EDGE_CAPTURE_SLOTS])(
+      void);
 };
 
 }  // namespace Sensor
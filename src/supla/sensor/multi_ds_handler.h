@@ -4,6 +4,7 @@
 #ifndef SRC_SUPLA_SENSOR_MULTI_DS_HANDLER_H_
 #define SRC_SUPLA_SENSOR_MULTI_DS_HANDLER_H_
 
+#include "dallas_ds_bus.h"
 #include "multi_ds_handler_base.h"
 
 #include <DallasTemperature.h>
@@ -15,7 +16,9 @@ namespace Sensor {
 class MultiDsHandler : public MultiDsHandlerBase {
  public:
   explicit MultiDsHandler(SuplaDeviceClass *sdc, uint8_t pin) :
-      MultiDsHandlerBase(sdc, pin), oneWire(pin) {}
+      MultiDsHandlerBase(sdc, pin),
+      oneWire(pin),
+      dsBus(&dallasTemperature, &oneWire) {}
 
   ~MultiDsHandler() {}
 
@@ -73,6 +76,7 @@ class MultiDsHandler : public MultiDsHandlerBase {
  protected:
   OneWire oneWire;
   DallasTemperature dallasTemperature;
+  DallasDsBus dsBus;
 
   int refreshSensorsCount() override {
     oneWire.reset_search();
@@ -88,6 +92,10 @@ class MultiDsHandler : public MultiDsHandlerBase {
   bool getSensorAddress(uint8_t *address, int index) override {
     return dallasTemperature.getAddress(address, index);
   }
+
+  DsBus *getDsBus() override {
+    return &dsBus;
+  }
 };
 
 };  // namespace Sensor
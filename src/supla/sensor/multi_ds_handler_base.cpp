@@ -30,6 +30,7 @@ MultiDsHandlerBase::~MultiDsHandlerBase() {
   for (int i = 0; i < MULTI_DS_MAX_DEVICES_COUNT; i++) {
     auto sensor = sensors[i];
     if (sensor != nullptr) {
+      removeFromScheduler(sensor);
       delete sensor;
       sensors[i] = nullptr;
     }
@@ -45,8 +46,27 @@ void MultiDsHandlerBase::onLoadConfig(SuplaDeviceClass *) {
   anySensorLoaded = false;
   char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
   // The numeric part of the key is the persisted SubDeviceId. It is not a
-  // runtime sensor slot, so scan the complete protocol range here.
+  // runtime sensor slot, so scan the complete protocol range here. When
+  // config can enumerate keys, only stored SubDeviceIds are checked.
+  uint8_t storedIds[(UINT8_MAX + 1) / 8] = {};
+  if (config->isKeyIterationSupported()) {
+    Supla::ConfigKeyCursor cursor;
+    cursor.setTag(Supla::ConfigTag::DsSensorConfig);
+    for (bool found = config->findFirstKey(&cursor); found;
+         found = config->findNextKey(&cursor)) {
+      int subDeviceId = cursor.getNumber();
+      if (subDeviceId >= 1 && subDeviceId <= UINT8_MAX) {
+        storedIds[subDeviceId / 8] |= (1 << (subDeviceId % 8));
+      }
+    }
+  } else {
+    memset(storedIds, 0xFF, sizeof(storedIds));
+  }
+
   for (int subDeviceId = 1; subDeviceId <= UINT8_MAX; subDeviceId++) {
+    if ((storedIds[subDeviceId / 8] & (1 << (subDeviceId % 8))) == 0) {
+      continue;
+    }
     Supla::Config::generateKey(key, subDeviceId,
                                Supla::ConfigTag::DsSensorConfig);
     Supla::Sensor::DsSensorConfig sensorConfig = {};
@@ -87,6 +107,20 @@ void MultiDsHandlerBase::onInit() {
   if (searchFirstDevice && !anySensorLoaded) {
     initialSensorSearch();
   }
+
+  if (scheduler && schedulerBusId == -1) {
+    auto bus = getDsBus();
+    if (bus == nullptr) {
+      SUPLA_LOG_WARNING("MultiDS: Conversion scheduler is not supported");
+    } else {
+      schedulerBusId = scheduler->addBus(bus);
+      for (int i = 0; i < maxDeviceCount; i++) {
+        if (sensors[i] != nullptr) {
+          addToScheduler(sensors[i]);
+        }
+      }
+    }
+  }
 }
 
 void MultiDsHandlerBase::onRegistered(Supla::Protocol::SuplaSrpc *suplaSrpc) {
@@ -168,7 +202,7 @@ void MultiDsHandlerBase::iterateAlways() {
     }
   }
 
-  if (state == MultiDsState::READY) {
+  if (state == MultiDsState::READY && schedulerBusId == -1) {
     if (millis() - lastBusReadTime > 10000) {
       requestTemperatures();
       lastBusReadTime = millis();
@@ -273,6 +307,7 @@ Supla::Sensor::MultiDsSensor *MultiDsHandlerBase::addDevice(
       subDeviceId, sensor->getChannel()->getChannelNumber());
 
   sensors[sensorSlot] = sensor;
+  addToScheduler(sensor);
   return sensor;
 }
 
@@ -391,6 +426,7 @@ bool MultiDsHandlerBase::onChannelConflictReport(
                         sensor->getSubDeviceId(), channelNumber);
 
         sensor->purgeConfig();
+        removeFromScheduler(sensor);
         delete sensor;
         sensor = nullptr;
         sensors[i] = nullptr;
@@ -403,6 +439,39 @@ bool MultiDsHandlerBase::onChannelConflictReport(
   return handled;
 }
 
+double MultiDsHandlerBase::getSensorTemperature(const uint8_t *address) {
+  if (scheduler && schedulerBusId >= 0) {
+    return scheduler->getTemperature(
+        scheduler->findSensor(schedulerBusId, address));
+  }
+  return getTemperature(address);
+}
+
+void MultiDsHandlerBase::setConversionScheduler(
+    DsConversionScheduler *scheduler, uint8_t resolution) {
+  this->scheduler = scheduler;
+  schedulerResolution = resolution;
+}
+
+Supla::Sensor::DsBus *MultiDsHandlerBase::getDsBus() {
+  return nullptr;
+}
+
+void MultiDsHandlerBase::addToScheduler(MultiDsSensor *sensor) {
+  if (scheduler && schedulerBusId >= 0 &&
+      scheduler->addSensor(schedulerBusId, sensor->getAddress(),
+                           schedulerResolution) == -1) {
+    SUPLA_LOG_ERROR("MultiDS: Failed to add device to conversion scheduler");
+  }
+}
+
+void MultiDsHandlerBase::removeFromScheduler(MultiDsSensor *sensor) {
+  if (scheduler && schedulerBusId >= 0) {
+    scheduler->removeSensor(
+        scheduler->findSensor(schedulerBusId, sensor->getAddress()));
+  }
+}
+
 void MultiDsHandlerBase::setMaxDeviceCount(uint8_t count) {
   if (count > MULTI_DS_MAX_DEVICES_COUNT) {
     SUPLA_LOG_WARNING("MultiDS: Setting max count bigger then allowed"
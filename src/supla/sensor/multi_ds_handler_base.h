@@ -11,6 +11,7 @@
 #include <supla/device/subdevice_pairing_handler.h>
 #include <supla/device/channel_conflict_resolver.h>
 
+#include "ds_conversion_scheduler.h"
 #include "multi_ds_sensor.h"
 
 #define MUTLI_DS_DEFAULT_PAIRING_DURATION_SEC 5
@@ -51,6 +52,28 @@ class MultiDsHandlerBase : public Element,
 
   virtual double getTemperature(const uint8_t *address) = 0;
 
+  /**
+   * Returns temperature of the sensor with given address.
+   *
+   * When conversion scheduler is used, value collected by the scheduler is
+   * returned. Otherwise getTemperature() of platform handler is called.
+   */
+  double getSensorTemperature(const uint8_t *address);
+
+  /**
+   * Uses non-blocking conversion scheduler for this bus.
+   *
+   * Scheduler starts one bus-wide conversion and collects scratchpads on
+   * later iterations, so the device loop is not blocked. The same scheduler
+   * can be shared by handlers of several buses. It requires platform handler
+   * which provides DsBus (getDsBus()), otherwise it is ignored.
+   *
+   * @param scheduler conversion scheduler
+   * @param resolution resolution (9..12 bits) set on all sensors on the bus
+   */
+  void setConversionScheduler(DsConversionScheduler *scheduler,
+                              uint8_t resolution = 12);
+
   /**
    * Sets the maximum number of DS18B20 devices handled by this instance.
    *
@@ -133,6 +156,8 @@ class MultiDsHandlerBase : public Element,
   virtual int refreshSensorsCount() = 0;
   virtual void requestTemperatures() = 0;
   virtual bool getSensorAddress(uint8_t *address, int index) = 0;
+  // Returns bus used by conversion scheduler. nullptr if not supported.
+  virtual DsBus *getDsBus();
 
   int findFreeSensorSlot() const;
   int findNextFreeSubDeviceId() const;
@@ -142,9 +167,14 @@ class MultiDsHandlerBase : public Element,
   void notifySrpcAboutParingEnd(int pairingResult, const char *name = nullptr);
   void addressToString(char *buffor, uint8_t bufforLength, uint8_t *address);
   void initialSensorSearch();
+  void addToScheduler(MultiDsSensor *sensor);
+  void removeFromScheduler(MultiDsSensor *sensor);
 
   uint8_t pin;
   Supla::Protocol::SuplaSrpc *srpc = nullptr;
+  DsConversionScheduler *scheduler = nullptr;
+  int schedulerBusId = -1;
+  uint8_t schedulerResolution = 12;
   MultiDsState state = MultiDsState::READY;
 
   uint32_t pairingStartTimeMs = 0;
@@ -537,6 +537,94 @@ void Config::generateKey(char* output, int number, const char* key) {
   snprintf(output, SUPLA_CONFIG_MAX_KEY_SIZE, "%d_%s", number, key);
 }
 
+bool Config::isKeyIterationSupported() const {
+  return false;
+}
+
+bool Config::findFirstKey(ConfigKeyCursor* cursor) {
+  (void)(cursor);
+  return false;
+}
+
+bool Config::findNextKey(ConfigKeyCursor* cursor) {
+  (void)(cursor);
+  return false;
+}
+
+void Config::releaseKeyCursor(ConfigKeyCursor* cursor) {
+  if (cursor) {
+    cursor->owner = nullptr;
+    cursor->handle = nullptr;
+    cursor->position = 0;
+  }
+}
+
+ConfigKeyCursor::~ConfigKeyCursor() {
+  if (owner) {
+    owner->releaseKeyCursor(this);
+  }
+}
+
+void ConfigKeyCursor::setTag(const char* tag, bool exactTag) {
+  filter = tag;
+  tagMode = true;
+  this->exactTag = exactTag;
+}
+
+void ConfigKeyCursor::setPrefix(const char* prefix) {
+  filter = prefix;
+  tagMode = false;
+}
+
+const char* ConfigKeyCursor::getKey() const {
+  return key;
+}
+
+int ConfigKeyCursor::getNumber() const {
+  return number;
+}
+
+bool ConfigKeyCursor::match(const char* candidate) {
+  if (candidate == nullptr ||
+      strnlen(candidate, SUPLA_CONFIG_MAX_KEY_SIZE) >=
+          SUPLA_CONFIG_MAX_KEY_SIZE) {
+    return false;
+  }
+  const char* expected = filter ? filter : "";
+  int candidateNumber = -1;
+
+  if (tagMode) {
+    // format from Config::generateKey: "%d_%s" (without leading zeros)
+    const char* ptr = candidate;
+    int value = 0;
+    while (*ptr >= '0' && *ptr <= '9') {
+      value = value * 10 + (*ptr - '0');
+      ptr++;
+    }
+    if (ptr == candidate || *ptr != '_' ||
+        (candidate[0] == '0' && ptr - candidate > 1)) {
+      return false;
+    }
+    if (exactTag) {
+      // generated key may be truncated, so compare with regenerated one
+      char generated[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+      Config::generateKey(generated, value, expected);
+      if (strcmp(generated, candidate) != 0) {
+        return false;
+      }
+    } else if (strncmp(ptr + 1, expected, strlen(expected)) != 0) {
+      return false;
+    }
+    candidateNumber = value;
+  } else if (strncmp(candidate, expected, strlen(expected)) != 0) {
+    return false;
+  }
+
+  number = candidateNumber;
+  snprintf(key, sizeof(key), "%s", candidate);
+  return true;
+}
+
 bool Config::isMinimalConfigReady(bool showLogs) {
   char buf[512] = {};
   // TODO(klew): minimal config check for protocol related params shoud be
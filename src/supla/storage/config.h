@@ -26,6 +26,45 @@
 namespace Supla {
 
 class Storage;
+class Config;
+
+// Cursor for enumeration of existing config keys, see Config::findFirstKey().
+// Filter strings are not copied, so they have to outlive the cursor.
+// Backend state is released when cursor is destroyed.
+class ConfigKeyCursor {
+ public:
+  ConfigKeyCursor() = default;
+  ConfigKeyCursor(const ConfigKeyCursor &) = delete;
+  ConfigKeyCursor &operator=(const ConfigKeyCursor &) = delete;
+  ~ConfigKeyCursor();
+
+  // Matches keys created by Config::generateKey() with given tag and any
+  // number. With exactTag = false, tag is matched as a prefix of the part
+  // after number (e.g. "splt_" matches "3_splt_act" and "3_splt_0").
+  void setTag(const char *tag, bool exactTag = true);
+  // Matches keys starting with prefix. Empty prefix matches all keys.
+  void setPrefix(const char *prefix);
+
+  const char *getKey() const;
+  // Number part of key matched by tag, -1 otherwise
+  int getNumber() const;
+
+  // Used by Config implementations. Checks if candidate key matches the
+  // filter and if so, stores it as current key.
+  bool match(const char *candidate);
+
+  // Backend state, owned by the Config implementation
+  Config *owner = nullptr;
+  void *handle = nullptr;
+  uintptr_t position = 0;
+
+ protected:
+  const char *filter = nullptr;
+  bool tagMode = false;
+  bool exactTag = true;
+  int number = -1;
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+};
 
 #pragma pack(push, 1)
 struct SaltPassword {
@@ -86,6 +125,21 @@ class Config {
 
   static void generateKey(char *, int, const char *);
 
+  // Enumerates existing keys matching cursor's filter in one pass, so
+  // callers don't have to probe every possible key:
+  //   ConfigKeyCursor cursor;
+  //   cursor.setTag(ConfigTag::DsSensorConfig);
+  //   for (bool found = config->findFirstKey(&cursor); found;
+  //        found = config->findNextKey(&cursor)) { ... }
+  // Order of keys is implementation specific. Keys other than the current
+  // one should not be added or erased during enumeration.
+  // When isKeyIterationSupported() returns false, find methods always return
+  // false and callers should fall back to probing keys.
+  virtual bool isKeyIterationSupported() const;
+  virtual bool findFirstKey(ConfigKeyCursor *cursor);
+  virtual bool findNextKey(ConfigKeyCursor *cursor);
+  virtual void releaseKeyCursor(ConfigKeyCursor *cursor);
+
   virtual void commit();
   virtual void saveWithDelay(uint16_t delayMs);
   virtual void saveIfNeeded();
@@ -78,6 +78,7 @@ const char InputActivationCfgTag[] = "input_act";
 const char OtaModeTag[] = "ota_mode";
 
 const char DsSensorConfig[] = "ds_sensor";
+const char ReportingPolicyCfgTag[] = "rep_pol";
 
 static_assert(sizeof(DeviceConfigChangeCfgTag) < 16);
 static_assert(sizeof(ChannelFunctionTag) < 12);
@@ -132,6 +133,7 @@ static_assert(sizeof(InputActivationCfgTag) < 16);
 static_assert(sizeof(OtaModeTag) < 16);
 static_assert(sizeof(PwmFrequencyTag) < 16);
 static_assert(sizeof(DsSensorConfig) < 12);
+static_assert(sizeof(ReportingPolicyCfgTag) < 12);
 
 }  // namespace ConfigTag
 }  // namespace Supla
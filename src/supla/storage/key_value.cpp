@@ -192,6 +192,43 @@ KeyValueElement* KeyValue::find(const char* key) {
   return nullptr;
 }
 
+bool KeyValue::isKeyIterationSupported() const {
+  return true;
+}
+
+bool KeyValue::findFirstKey(ConfigKeyCursor* cursor) {
+  if (cursor == nullptr) {
+    return false;
+  }
+  if (cursor->owner) {
+    cursor->owner->releaseKeyCursor(cursor);
+  }
+  cursor->owner = this;
+  cursor->handle = first;
+  return findKeyFromHandle(cursor);
+}
+
+bool KeyValue::findNextKey(ConfigKeyCursor* cursor) {
+  if (cursor == nullptr || cursor->owner != this) {
+    return false;
+  }
+  return findKeyFromHandle(cursor);
+}
+
+bool KeyValue::findKeyFromHandle(ConfigKeyCursor* cursor) {
+  // handle points to the element after the current one, so the current key
+  // may be erased during enumeration
+  auto element = static_cast<KeyValueElement*>(cursor->handle);
+  while (element) {
+    cursor->handle = element->getNext();
+    if (cursor->match(element->getKey())) {
+      return true;
+    }
+    element = element->getNext();
+  }
+  return false;
+}
+
 KeyValueElement* KeyValue::findOrCreate(const char* key) {
   auto element = find(key);
   if (!element) {
@@ -326,6 +363,10 @@ bool KeyValueElement::isKeyEqual(const char* keyToCheck) {
   return strncmp(key, keyToCheck, SUPLA_STORAGE_KEY_SIZE) == 0;
 }
 
+const char* KeyValueElement::getKey() const {
+  return key;
+}
+
 KeyValueElement* KeyValueElement::getNext() {
   return next;
 }
@@ -43,8 +43,14 @@ class KeyValue : public Config {
   bool setUInt32(const char* key, const uint32_t value) override;
   bool eraseKey(const char* key) override;
 
+  bool isKeyIterationSupported() const override;
+  bool findFirstKey(ConfigKeyCursor* cursor) override;
+  bool findNextKey(ConfigKeyCursor* cursor) override;
+
  protected:
   int getBlobSize(const char* key) override;
+  // Continues enumeration from element stored in cursor's handle
+  bool findKeyFromHandle(ConfigKeyCursor* cursor);
   KeyValueElement* find(const char* key);
   KeyValueElement* findOrCreate(const char* key);
   KeyValueElement* first = nullptr;
@@ -65,6 +71,7 @@ class KeyValueElement {
   explicit KeyValueElement(const char* keyName);
   ~KeyValueElement();
   bool isKeyEqual(const char* keyToCheck);
+  const char* getKey() const;
   KeyValueElement* getNext();
   bool hasNext();
   void setNext(KeyValueElement* toBeSet);
@@ -346,6 +346,14 @@ void Supla::LittleFsConfig::removeAll() {
   Supla::KeyValue::removeAll();
 }
 
+bool Supla::LittleFsConfig::isKeyIterationSupported() const {
+  return false;
+}
+
+bool Supla::LittleFsConfig::findFirstKey(ConfigKeyCursor* cursor) {
+  return Supla::Config::findFirstKey(cursor);
+}
+
 bool Supla::LittleFsConfig::setBlob(const char* key,
                                     const char* value,
                                     size_t blobSize) {
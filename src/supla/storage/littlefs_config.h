@@ -32,6 +32,10 @@ class LittleFsConfig : public KeyValue {
   bool getBlob(const char* key, char* value, size_t blobSize) override;
   bool eraseKey(const char* key) override;
 
+  // Big blobs are stored in files, which aren't enumerated
+  bool isKeyIterationSupported() const override;
+  bool findFirstKey(ConfigKeyCursor* cursor) override;
+
  protected:
   int getBlobSize(const char* key) override;
   bool initLittleFs();
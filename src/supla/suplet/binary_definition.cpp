@@ -0,0 +1,284 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <supla/suplet/config.h>
+
+#if SUPLA_SUPLET_ENABLED
+
+#include <string.h>
+#include <supla/suplet/binary_definition.h>
+#include <supla/suplet/runtime.h>
+
+namespace {
+
+constexpr uint8_t kNullString = 0xFF;
+
+class ImageWriter {
+ public:
+  ImageWriter(uint8_t *output, uint16_t outputSize)
+      : output(output), outputSize(outputSize) {
+  }
+
+  void writeUInt8(uint8_t value) {
+    if (output == nullptr || size >= outputSize) {
+      overflow = true;
+      return;
+    }
+    output[size++] = value;
+  }
+
+  void writeUInt16(uint16_t value) {
+    writeUInt8(static_cast<uint8_t>(value & 0xFF));
+    writeUInt8(static_cast<uint8_t>(value >> 8));
+  }
+
+  void writeUInt32(uint32_t value) {
+    writeUInt16(static_cast<uint16_t>(value & 0xFFFF));
+    writeUInt16(static_cast<uint16_t>(value >> 16));
+  }
+
+  void writeInt32(int32_t value) {
+    writeUInt32(static_cast<uint32_t>(value));
+  }
+
+  void writeString(const char *value) {
+    if (value == nullptr) {
+      writeUInt8(kNullString);
+      return;
+    }
+    size_t len = strlen(value);
+    if (len >= kNullString) {
+      overflow = true;
+      return;
+    }
+    writeUInt8(static_cast<uint8_t>(len));
+    for (size_t i = 0; i < len; i++) {
+      writeUInt8(static_cast<uint8_t>(value[i]));
+    }
+  }
+
+  uint16_t getSize() const {
+    return overflow ? 0 : size;
+  }
+
+ private:
+  uint8_t *output = nullptr;
+  uint16_t outputSize = 0;
+  uint16_t size = 0;
+  bool overflow = false;
+};
+
+class ImageReader {
+ public:
+  ImageReader(const uint8_t *image, uint16_t imageSize)
+      : image(image), imageSize(imageSize) {
+  }
+
+  bool readUInt8(uint8_t *value) {
+    if (image == nullptr || pos >= imageSize) {
+      return false;
+    }
+    *value = image[pos++];
+    return true;
+  }
+
+  bool readUInt16(uint16_t *value) {
+    uint8_t low = 0;
+    uint8_t high = 0;
+    if (!readUInt8(&low) || !readUInt8(&high)) {
+      return false;
+    }
+    *value = static_cast<uint16_t>(low | (high << 8));
+    return true;
+  }
+
+  bool readUInt32(uint32_t *value) {
+    uint16_t low = 0;
+    uint16_t high = 0;
+    if (!readUInt16(&low) || !readUInt16(&high)) {
+      return false;
+    }
+    *value = static_cast<uint32_t>(low) | (static_cast<uint32_t>(high) << 16);
+    return true;
+  }
+
+  bool readInt32(int32_t *value) {
+    uint32_t tmp = 0;
+    if (!readUInt32(&tmp)) {
+      return false;
+    }
+    *value = static_cast<int32_t>(tmp);
+    return true;
+  }
+
+  // Reads string into buffer and sets target to it, or to nullptr
+  bool readString(char *buffer, size_t bufferSize, const char **target) {
+    uint8_t len = 0;
+    if (!readUInt8(&len)) {
+      return false;
+    }
+    if (len == kNullString) {
+      *target = nullptr;
+      return true;
+    }
+    if (buffer == nullptr || len >= bufferSize || imageSize - pos < len) {
+      return false;
+    }
+    memcpy(buffer, image + pos, len);
+    buffer[len] = '\0';
+    pos += len;
+    *target = buffer;
+    return true;
+  }
+
+  template <typename T>
+  bool readEnum(T *value, T maxValue) {
+    uint8_t tmp = 0;
+    if (!readUInt8(&tmp) || tmp > static_cast<uint8_t>(maxValue)) {
+      return false;
+    }
+    *value = static_cast<T>(tmp);
+    return true;
+  }
+
+  bool atEnd() const {
+    return pos == imageSize;
+  }
+
+ private:
+  const uint8_t *image = nullptr;
+  uint16_t imageSize = 0;
+  uint16_t pos = 0;
+};
+
+}  // namespace
+
+namespace Supla {
+namespace Suplet {
+
+uint16_t BinaryDefinition::encode(const Definition &definition,
+                                  uint8_t *output,
+                                  uint16_t outputSize) {
+  if ((definition.channelCount > 0 && definition.channels == nullptr) ||
+      (definition.parameterCount > 0 && definition.parameters == nullptr) ||
+      definition.channelCount > SUPLA_SUPLET_MAX_CHANNELS_PER_INSTANCE ||
+      definition.parameterCount > SUPLA_SUPLET_MAX_PARAMETERS) {
+    return 0;
+  }
+
+  ImageWriter writer(output, outputSize);
+  writer.writeUInt8(kFormatVersion);
+  writer.writeUInt8(static_cast<uint8_t>(definition.category));
+  writer.writeUInt8(static_cast<uint8_t>(definition.kind));
+  writer.writeUInt8(definition.schemaVersion);
+  writer.writeUInt8(definition.handlerVersion);
+  writer.writeUInt32(definition.definitionId);
+  writer.writeUInt16(definition.definitionVersion);
+  writer.writeUInt8(definition.maxInstances);
+  writer.writeString(definition.name);
+
+  writer.writeUInt8(definition.channelCount);
+  for (uint8_t i = 0; i < definition.channelCount; i++) {
+    const auto &channel = definition.channels[i];
+    writer.writeUInt8(channel.channelId);
+    writer.writeUInt8(static_cast<uint8_t>(channel.kind));
+    writer.writeInt32(channel.defaultFunction);
+    writer.writeString(channel.caption);
+  }
+
+  writer.writeUInt8(definition.parameterCount);
+  for (uint8_t i = 0; i < definition.parameterCount; i++) {
+    const auto &parameter = definition.parameters[i];
+    writer.writeString(parameter.key);
+    writer.writeUInt8(static_cast<uint8_t>(parameter.type));
+    writer.writeUInt8(static_cast<uint8_t>(parameter.lifecycle));
+    writer.writeInt32(parameter.min);
+    writer.writeInt32(parameter.max);
+    writer.writeInt32(parameter.defaultNumber);
+    writer.writeString(parameter.defaultText);
+    writer.writeString(parameter.enumValues);
+    writer.writeUInt8(parameter.required);
+    writer.writeUInt8(parameter.hasDefault);
+    writer.writeUInt8(parameter.affectsTopology);
+  }
+
+  return writer.getSize();
+}
+
+bool BinaryDefinition::decode(const uint8_t *image,
+                              uint16_t imageSize,
+                              JsonDefinition *output) {
+  if (image == nullptr || output == nullptr) {
+    return false;
+  }
+
+  output->clear();
+  ImageReader reader(image, imageSize);
+  Definition *definition = output->getDefinition();
+
+  uint8_t formatVersion = 0;
+  const char *name = nullptr;
+  if (!reader.readUInt8(&formatVersion) || formatVersion != kFormatVersion ||
+      !reader.readEnum(&definition->category, Category::HttpIntegration) ||
+      !reader.readEnum(&definition->kind, Kind::HttpInverter) ||
+      !reader.readUInt8(&definition->schemaVersion) ||
+      !reader.readUInt8(&definition->handlerVersion) ||
+      !reader.readUInt32(&definition->definitionId) ||
+      !reader.readUInt16(&definition->definitionVersion) ||
+      !reader.readUInt8(&definition->maxInstances) ||
+      // name always points to the name buffer, as after parsing JSON
+      !reader.readString(
+          output->getNameBuffer(), SUPLA_SUPLET_MAX_NAME_SIZE, &name) ||
+      !reader.readUInt8(&definition->channelCount) ||
+      definition->channelCount > SUPLA_SUPLET_MAX_CHANNELS_PER_INSTANCE) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < definition->channelCount; i++) {
+    auto channel = output->getChannel(i);
+    if (!reader.readUInt8(&channel->channelId) ||
+        !reader.readEnum(&channel->kind, ChannelKind::VirtualThermometer) ||
+        !reader.readInt32(&channel->defaultFunction) ||
+        !reader.readString(output->getCaptionBuffer(i),
+                           SUPLA_SUPLET_MAX_CAPTION_SIZE,
+                           &channel->caption)) {
+      return false;
+    }
+  }
+
+  if (!reader.readUInt8(&definition->parameterCount) ||
+      definition->parameterCount > SUPLA_SUPLET_MAX_PARAMETERS) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < definition->parameterCount; i++) {
+    auto parameter = output->getParameter(i);
+    if (!reader.readString(output->getParameterKeyBuffer(i),
+                           SUPLA_SUPLET_MAX_PARAMETER_KEY_SIZE,
+                           &parameter->key) ||
+        !reader.readEnum(&parameter->type, ParameterType::ChannelList) ||
+        !reader.readEnum(&parameter->lifecycle,
+                         ParameterLifecycle::Secret) ||
+        !reader.readInt32(&parameter->min) ||
+        !reader.readInt32(&parameter->max) ||
+        !reader.readInt32(&parameter->defaultNumber) ||
+        !reader.readString(output->getParameterDefaultTextBuffer(i),
+                           SUPLA_SUPLET_MAX_PARAMETER_TEXT_SIZE,
+                           &parameter->defaultText) ||
+        !reader.readString(output->getParameterEnumValuesBuffer(i),
+                           SUPLA_SUPLET_MAX_PARAMETER_TEXT_SIZE,
+                           &parameter->enumValues) ||
+        !reader.readUInt8(&parameter->required) ||
+        !reader.readUInt8(&parameter->hasDefault) ||
+        !reader.readUInt8(&parameter->affectsTopology)) {
+      return false;
+    }
+  }
+
+  return reader.atEnd() && Runtime::validateDefinition(*definition);
+}
+
+}  // namespace Suplet
+}  // namespace Supla
+
+#endif  // SUPLA_SUPLET_ENABLED
@@ -0,0 +1,41 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_SUPLET_BINARY_DEFINITION_H_
+#define SRC_SUPLA_SUPLET_BINARY_DEFINITION_H_
+
+#include <stdint.h>
+#include <supla/suplet/definition.h>
+#include <supla/suplet/json_definition.h>
+
+namespace Supla {
+namespace Suplet {
+
+/**
+ * Compact binary image of a parsed Definition. DefinitionCache keeps it next
+ * to the definition JSON, so downloaded definitions can be recreated without
+ * running JsonDefinitionParser on every boot and runtime refresh.
+ *
+ * Image starts with kFormatVersion. Images with other format version are
+ * rejected by decode() and the definition is parsed from JSON again.
+ * Multibyte values are stored little endian, strings as length byte and
+ * characters (length 0xFF marks nullptr).
+ */
+class BinaryDefinition {
+ public:
+  static constexpr uint8_t kFormatVersion = 1;
+
+  // Returns image size or 0 when definition doesn't fit into output.
+  static uint16_t encode(const Definition &definition,
+                         uint8_t *output,
+                         uint16_t outputSize);
+  // Fills output the same way as JsonDefinitionParser::parse does.
+  static bool decode(const uint8_t *image,
+                     uint16_t imageSize,
+                     JsonDefinition *output);
+};
+
+}  // namespace Suplet
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_SUPLET_BINARY_DEFINITION_H_
@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <supla/crc16.h>
 #include <supla/storage/config.h>
 #if !defined(SUPLA_TEST) && (defined(ESP32) || defined(SUPLA_DEVICE_ESP32))
 #include <supla/sha256.h>
@@ -21,6 +22,8 @@ namespace {
 
 constexpr uint32_t kCacheMagic = 0x5344504C;  // SDPL
 constexpr uint8_t kCacheVersion = 3;
+constexpr uint32_t kCompiledMagic = 0x53445043;  // SDPC
+constexpr uint8_t kCompiledVersion = 1;
 constexpr uint16_t kChunkSize = SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE;
 constexpr uint8_t kMaxCacheSlots = SUPLA_SUPLET_MAX_CACHED_DEFINITIONS;
 constexpr uint16_t kMaxChunkCount =
@@ -41,6 +44,15 @@ struct BlobHeader {
   uint16_t chunkSize = 0;
   uint8_t sha256[32] = {};
 };
+
+struct CompiledHeader {
+  uint32_t magic = 0;
+  uint8_t version = 0;
+  uint8_t reserved = 0;
+  uint16_t imageSize = 0;
+  uint16_t crc16 = 0;
+  uint8_t sha256[32] = {};
+};
 #pragma pack(pop)
 
 uint16_t chunkCountForSize(uint16_t size) {
@@ -294,6 +306,31 @@ bool DefinitionCache::loadStaged(DefinitionCacheHandle handle,
   return true;
 }
 
+bool DefinitionCache::loadStagedChunk(DefinitionCacheHandle handle,
+                                      uint16_t jsonSize,
+                                      uint16_t chunkIndex,
+                                      char *chunk,
+                                      size_t chunkSize,
+                                      uint16_t *loadedSize) const {
+  if (config == nullptr || !isValidHandle(handle) || chunk == nullptr ||
+      loadedSize == nullptr || jsonSize == 0 ||
+      jsonSize > SUPLA_SUPLET_MAX_DEFINITION_JSON_SIZE) {
+    return false;
+  }
+
+  const uint16_t expectedSize = chunkPayloadSize(jsonSize, chunkIndex);
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  if (expectedSize == 0 || chunkSize < expectedSize ||
+      !makeChunkKey(
+          handle.slot, handle.variant, chunkIndex, key, sizeof(key)) ||
+      config->getBlobSize(key) != expectedSize ||
+      !config->getBlob(key, chunk, expectedSize)) {
+    return false;
+  }
+  *loadedSize = expectedSize;
+  return true;
+}
+
 bool DefinitionCache::commitStaged(DefinitionCacheHandle handle,
                                    uint32_t definitionId,
                                    uint16_t definitionVersion,
@@ -352,6 +389,112 @@ bool DefinitionCache::abortStaged(DefinitionCacheHandle handle) {
   return result;
 }
 
+bool DefinitionCache::saveCompiled(uint32_t definitionId,
+                                   uint16_t definitionVersion,
+                                   const uint8_t *sha256,
+                                   const uint8_t *image,
+                                   uint16_t imageSize) {
+  if (config == nullptr || sha256 == nullptr || image == nullptr ||
+      imageSize == 0 || imageSize > kChunkSize) {
+    return false;
+  }
+
+  int slot = findSlot(definitionId, definitionVersion, true);
+  if (slot < 0) {
+    return false;
+  }
+
+  CachedDefinitionInfo info = {};
+  uint8_t activeVariant = kDeletedVariant;
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  if (!loadAndRepairActiveHeader(
+          static_cast<uint8_t>(slot), &info, &activeVariant) ||
+      memcmp(info.sha256, sha256, sizeof(info.sha256)) != 0 ||
+      !makeCompiledKey(
+          static_cast<uint8_t>(slot), activeVariant, key, sizeof(key))) {
+    return false;
+  }
+
+  const size_t blobSize = sizeof(CompiledHeader) + imageSize;
+  char *blob = new char[blobSize];
+  if (blob == nullptr) {
+    return false;
+  }
+
+  CompiledHeader header = {};
+  header.magic = kCompiledMagic;
+  header.version = kCompiledVersion;
+  header.imageSize = imageSize;
+  header.crc16 = calculateCrc16(image, imageSize);
+  memcpy(header.sha256, sha256, sizeof(header.sha256));
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), image, imageSize);
+
+  bool result = config->setBlob(key, blob, blobSize);
+  delete[] blob;
+  if (result) {
+    config->commit();
+  }
+  return result;
+}
+
+bool DefinitionCache::loadCompiled(uint32_t definitionId,
+                                   uint16_t definitionVersion,
+                                   uint8_t *image,
+                                   size_t imageSize,
+                                   uint16_t *loadedSize) const {
+  if (config == nullptr || image == nullptr || loadedSize == nullptr) {
+    return false;
+  }
+
+  int slot = findSlot(definitionId, definitionVersion, true);
+  if (slot < 0) {
+    return false;
+  }
+
+  CachedDefinitionInfo info = {};
+  uint8_t activeVariant = kDeletedVariant;
+  char key[SUPLA_CONFIG_MAX_KEY_SIZE] = {};
+  if (!loadAndRepairActiveHeader(
+          static_cast<uint8_t>(slot), &info, &activeVariant) ||
+      !makeCompiledKey(
+          static_cast<uint8_t>(slot), activeVariant, key, sizeof(key))) {
+    return false;
+  }
+
+  const int blobSize = config->getBlobSize(key);
+  if (blobSize <= static_cast<int>(sizeof(CompiledHeader)) ||
+      blobSize > static_cast<int>(sizeof(CompiledHeader) + kChunkSize) ||
+      static_cast<size_t>(blobSize) - sizeof(CompiledHeader) > imageSize) {
+    return false;
+  }
+
+  char *blob = new char[blobSize];
+  if (blob == nullptr) {
+    return false;
+  }
+
+  bool result = config->getBlob(key, blob, blobSize);
+  if (result) {
+    CompiledHeader header = {};
+    memcpy(&header, blob, sizeof(header));
+    const uint8_t *payload =
+        reinterpret_cast<const uint8_t *>(blob + sizeof(header));
+    result = header.magic == kCompiledMagic &&
+             header.version == kCompiledVersion &&
+             header.imageSize ==
+                 static_cast<size_t>(blobSize) - sizeof(header) &&
+             memcmp(header.sha256, info.sha256, sizeof(info.sha256)) == 0 &&
+             header.crc16 == calculateCrc16(payload, header.imageSize);
+    if (result) {
+      memcpy(image, payload, header.imageSize);
+      *loadedSize = header.imageSize;
+    }
+  }
+  delete[] blob;
+  return result;
+}
+
 bool DefinitionCache::calculateAndVerify(const char *json,
                                          uint16_t jsonSize,
                                          const uint8_t *expectedSha256,
@@ -620,6 +763,9 @@ bool DefinitionCache::eraseVariant(uint8_t index, uint8_t variant) {
   if (makeHeaderKey(index, variant, key, sizeof(key))) {
     config->eraseKey(key);
   }
+  if (makeCompiledKey(index, variant, key, sizeof(key))) {
+    config->eraseKey(key);
+  }
   eraseChunks(index, variant);
   return true;
 }
@@ -700,10 +846,44 @@ bool DefinitionCache::slotExists(uint8_t index) const {
   return false;
 }
 
+void DefinitionCache::findStoredSlots(SlotSet *slots) const {
+  if (config == nullptr || !config->isKeyIterationSupported()) {
+    memset(*slots, 0xFF, sizeof(*slots));
+    return;
+  }
+  memset(*slots, 0, sizeof(*slots));
+  // all keys of slot start with "spld<index>"
+  Supla::ConfigKeyCursor cursor;
+  cursor.setPrefix("spld");
+  for (bool found = config->findFirstKey(&cursor); found;
+       found = config->findNextKey(&cursor)) {
+    const char *ptr = cursor.getKey() + 4;
+    int index = 0;
+    int digits = 0;
+    while (*ptr >= '0' && *ptr <= '9' && digits < 4) {
+      index = index * 10 + (*ptr - '0');
+      ptr++;
+      digits++;
+    }
+    if (digits > 0 && index < kMaxCacheSlots) {
+      (*slots)[index / 8] |= (1 << (index % 8));
+    }
+  }
+}
+
+bool DefinitionCache::hasSlot(const SlotSet &slots, uint8_t index) {
+  return (slots[index / 8] & (1 << (index % 8))) != 0;
+}
+
 int DefinitionCache::findSlot(uint32_t definitionId,
                               uint16_t definitionVersion,
                               bool repair) const {
+  SlotSet storedSlots = {};
+  findStoredSlots(&storedSlots);
   for (uint8_t i = 0; i < kMaxCacheSlots; i++) {
+    if (!hasSlot(storedSlots, i)) {
+      continue;
+    }
     CachedDefinitionInfo info = {};
     const bool loaded = repair ? loadAndRepairActiveHeader(i, &info)
                                : readActiveHeader(i, &info);
@@ -716,9 +896,11 @@ int DefinitionCache::findSlot(uint32_t definitionId,
 }
 
 int DefinitionCache::findFreeSlot() const {
+  SlotSet storedSlots = {};
+  findStoredSlots(&storedSlots);
   for (uint8_t i = 0; i < kMaxCacheSlots; i++) {
     CachedDefinitionInfo info = {};
-    if (!readActiveHeader(i, &info)) {
+    if (!hasSlot(storedSlots, i) || !readActiveHeader(i, &info)) {
       return i;
     }
   }
@@ -777,6 +959,18 @@ bool DefinitionCache::makeChunkKey(uint8_t index,
   return written > 0 && static_cast<size_t>(written) < outputSize;
 }
 
+bool DefinitionCache::makeCompiledKey(uint8_t index,
+                                      uint8_t variant,
+                                      char *output,
+                                      size_t outputSize) {
+  if (output == nullptr || outputSize == 0 || index >= kMaxCacheSlots ||
+      !isValidVariant(variant)) {
+    return false;
+  }
+  int written = snprintf(output, outputSize, "spld%u_%ub", index, variant);
+  return written > 0 && static_cast<size_t>(written) < outputSize;
+}
+
 bool DefinitionCache::makeLegacyHeaderKey(uint8_t index,
                                           char *output,
                                           size_t outputSize) {
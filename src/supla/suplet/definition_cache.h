@@ -78,12 +78,33 @@ class DefinitionCache {
                   char *json,
                   size_t jsonSize,
                   CachedDefinitionInfo *info = nullptr) const;
+  // Reads one chunk of staged JSON, so it can be parsed without keeping
+  // whole definition in RAM.
+  bool loadStagedChunk(DefinitionCacheHandle handle,
+                       uint16_t jsonSize,
+                       uint16_t chunkIndex,
+                       char *chunk,
+                       size_t chunkSize,
+                       uint16_t *loadedSize) const;
   bool commitStaged(DefinitionCacheHandle handle,
                     uint32_t definitionId,
                     uint16_t definitionVersion,
                     uint16_t jsonSize,
                     const uint8_t *sha256);
   bool abortStaged(DefinitionCacheHandle handle);
+  // Compiled (binary) image of the definition is kept next to the JSON of
+  // the active variant, together with SHA-256 of that JSON. It is returned
+  // only while the digest matches the cached JSON.
+  bool saveCompiled(uint32_t definitionId,
+                    uint16_t definitionVersion,
+                    const uint8_t *sha256,
+                    const uint8_t *image,
+                    uint16_t imageSize);
+  bool loadCompiled(uint32_t definitionId,
+                    uint16_t definitionVersion,
+                    uint8_t *image,
+                    size_t imageSize,
+                    uint16_t *loadedSize) const;
 
  private:
   bool calculateAndVerify(const char *json,
@@ -130,6 +151,11 @@ class DefinitionCache {
   bool setActiveVariant(uint8_t index, uint8_t variant);
   bool variantExists(uint8_t index, uint8_t variant) const;
   bool slotExists(uint8_t index) const;
+  typedef uint8_t SlotSet[(SUPLA_SUPLET_MAX_CACHED_DEFINITIONS + 7) / 8];
+  // Marks slots which have any key stored in config. When config can't
+  // enumerate keys, all slots are marked.
+  void findStoredSlots(SlotSet *slots) const;
+  static bool hasSlot(const SlotSet &slots, uint8_t index);
   int findSlot(uint32_t definitionId,
                uint16_t definitionVersion,
                bool repair) const;
@@ -147,6 +173,10 @@ class DefinitionCache {
                            uint16_t chunkIndex,
                            char *output,
                            size_t outputSize);
+  static bool makeCompiledKey(uint8_t index,
+                              uint8_t variant,
+                              char *output,
+                              size_t outputSize);
   static bool makeLegacyHeaderKey(uint8_t index,
                                   char *output,
                                   size_t outputSize);
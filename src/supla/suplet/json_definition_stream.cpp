@@ -0,0 +1,762 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <supla/suplet/config.h>
+
+#if SUPLA_SUPLET_ENABLED
+
+#include <supla/suplet/json_definition_stream.h>
+#include <supla/suplet/runtime.h>
+
+#include <string.h>
+
+namespace {
+
+bool isWhitespace(char value) {
+  return value == ' ' || value == '\n' || value == '\r' || value == '\t';
+}
+
+bool isDigit(char value) {
+  return value >= '0' && value <= '9';
+}
+
+bool equalText(const char *a, const char *b) {
+  return a != nullptr && b != nullptr && strcmp(a, b) == 0;
+}
+
+bool equalText(const char *value, const char *verbose, const char *compact) {
+  return equalText(value, verbose) || equalText(value, compact);
+}
+
+}  // namespace
+
+namespace Supla {
+namespace Suplet {
+
+JsonDefinitionStreamParser::JsonDefinitionStreamParser() {
+  begin(nullptr);
+}
+
+void JsonDefinitionStreamParser::begin(JsonDefinition *output) {
+  this->output = output;
+  if (output != nullptr) {
+    output->clear();
+  }
+  depth = 0;
+  expect = Expect::Root;
+  field = Field::Skip;
+  valueField = Field::Skip;
+  token = Token::None;
+  failed = (output == nullptr);
+  terminated = false;
+  text = nullptr;
+  textSize = 0;
+  textLength = 0;
+  escape = false;
+  number = 0;
+  negative = false;
+  hasDigits = false;
+  literal = nullptr;
+  literalPos = 0;
+  enumValuesLength = 0;
+}
+
+bool JsonDefinitionStreamParser::feed(const char *data, size_t size) {
+  if (failed || (data == nullptr && size > 0)) {
+    failed = true;
+    return false;
+  }
+  for (size_t i = 0; i < size && !terminated; i++) {
+    if (data[i] == '\0') {
+      terminated = true;
+      break;
+    }
+    if (!step(data[i])) {
+      failed = true;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool JsonDefinitionStreamParser::finish() {
+  if (failed || token != Token::None || expect != Expect::Done) {
+    failed = true;
+    return false;
+  }
+  return Runtime::validateDefinition(*output->getDefinition());
+}
+
+bool JsonDefinitionStreamParser::step(char value) {
+  switch (token) {
+    case Token::String:
+      return stepString(value);
+    case Token::Literal:
+      return stepLiteral(value);
+    case Token::Number: {
+      bool consumed = false;
+      if (!stepNumber(value, &consumed)) {
+        return false;
+      }
+      if (consumed) {
+        return true;
+      }
+      // character after number is handled below
+      break;
+    }
+    case Token::None:
+      break;
+  }
+
+  if (isWhitespace(value)) {
+    return true;
+  }
+
+  switch (expect) {
+    case Expect::Root:
+      return value == '{' && push(Frame::Root, Expect::FirstKeyOrEnd);
+    case Expect::FirstKeyOrEnd:
+      if (value == '}') {
+        // only objects of unknown keys may be empty
+        return top() == Frame::SkipObject && endContainer(Frame::SkipObject);
+      }
+      expect = Expect::Key;
+      return value == '"' && (top() == Frame::SkipObject
+                                  ? beginSkippedString()
+                                  : beginString(scratch, kKeySize));
+    case Expect::Key:
+      return value == '"' && (top() == Frame::SkipObject
+                                  ? beginSkippedString()
+                                  : beginString(scratch, kKeySize));
+    case Expect::Colon:
+      if (value != ':') {
+        return false;
+      }
+      expect = Expect::Value;
+      return true;
+    case Expect::FirstValueOrEnd:
+      if (value == ']') {
+        // at least one enum value is required
+        return top() != Frame::EnumValues && endContainer(top());
+      }
+      return beginValue(value);
+    case Expect::Value:
+      return beginValue(value);
+    case Expect::CommaOrEnd:
+      if (value == ',') {
+        expect = isObject(top()) ? Expect::Key : Expect::Value;
+        return true;
+      }
+      if ((value == '}' && isObject(top())) ||
+          (value == ']' && !isObject(top()))) {
+        return endContainer(top());
+      }
+      return false;
+    case Expect::Done:
+      return false;
+  }
+  return false;
+}
+
+bool JsonDefinitionStreamParser::stepString(char value) {
+  if (escape) {
+    escape = false;
+    switch (value) {
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      case 'b':
+        value = '\b';
+        break;
+      case 'f':
+        value = '\f';
+        break;
+      case 'n':
+        value = '\n';
+        break;
+      case 'r':
+        value = '\r';
+        break;
+      case 't':
+        value = '\t';
+        break;
+      default:
+        // skipped strings accept any escape sequence
+        return text == nullptr;
+    }
+  } else if (value == '\\') {
+    escape = true;
+    return true;
+  } else if (value == '"') {
+    return endString();
+  }
+
+  if (text == nullptr) {
+    return true;
+  }
+  if (textLength + 1 >= textSize) {
+    return false;
+  }
+  text[textLength++] = value;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::stepNumber(char value, bool *consumed) {
+  *consumed = true;
+  if (isDigit(value)) {
+    uint32_t digit = static_cast<uint32_t>(value - '0');
+    if (number > (UINT32_MAX - digit) / 10) {
+      return false;
+    }
+    number = number * 10 + digit;
+    hasDigits = true;
+    return true;
+  }
+  if (!hasDigits) {
+    // JsonDefinitionParser accepts whitespace between '-' and digits
+    return isWhitespace(value);
+  }
+  *consumed = false;
+  return endNumber();
+}
+
+bool JsonDefinitionStreamParser::stepLiteral(char value) {
+  if (value != literal[literalPos]) {
+    return false;
+  }
+  literalPos++;
+  if (literal[literalPos] == '\0') {
+    return endLiteral();
+  }
+  return true;
+}
+
+bool JsonDefinitionStreamParser::beginValue(char value) {
+  valueField = currentField();
+  expect = Expect::Value;
+  Definition *definition = output->getDefinition();
+  const uint8_t channelIndex = definition->channelCount;
+  const uint8_t parameterIndex = definition->parameterCount;
+
+  switch (valueField) {
+    case Field::Skip:
+      if (value == '"') {
+        return beginSkippedString();
+      }
+      if (value == '{') {
+        return push(Frame::SkipObject, Expect::FirstKeyOrEnd);
+      }
+      if (value == '[') {
+        return push(Frame::SkipArray, Expect::FirstValueOrEnd);
+      }
+      if (value == 't') {
+        return beginLiteral("true");
+      }
+      if (value == 'f') {
+        return beginLiteral("false");
+      }
+      if (value == 'n') {
+        return beginLiteral("null");
+      }
+      return beginNumber(value, true);
+    case Field::SchemaVersion:
+    case Field::HandlerVersion:
+    case Field::DefinitionId:
+    case Field::DefinitionVersion:
+    case Field::MaxInstances:
+    case Field::ChannelId:
+      return beginNumber(value, false);
+    case Field::DefaultFunction:
+    case Field::Min:
+    case Field::Max:
+      return beginNumber(value, true);
+    case Field::Category:
+    case Field::Kind:
+    case Field::ChannelKind:
+    case Field::Function:
+    case Field::ParameterType:
+    case Field::Lifecycle:
+      return value == '"' && beginString(scratch, kKeySize);
+    case Field::EnumValue:
+      return value == '"' &&
+             beginString(scratch, SUPLA_SUPLET_MAX_PARAMETER_KEY_SIZE);
+    case Field::Name:
+      return value == '"' && beginString(output->getNameBuffer(),
+                                         SUPLA_SUPLET_MAX_NAME_SIZE);
+    case Field::Caption:
+      return value == '"' && beginString(output->getCaptionBuffer(channelIndex),
+                                         SUPLA_SUPLET_MAX_CAPTION_SIZE);
+    case Field::ParameterKey:
+      return value == '"' &&
+             beginString(output->getParameterKeyBuffer(parameterIndex),
+                         SUPLA_SUPLET_MAX_PARAMETER_KEY_SIZE);
+    case Field::Required:
+    case Field::AffectsTopology:
+      if (value == 't') {
+        return beginLiteral("true");
+      }
+      return value == 'f' && beginLiteral("false");
+    case Field::Default:
+      output->getParameter(parameterIndex)->hasDefault = 1;
+      if (value == '"') {
+        return beginString(
+            output->getParameterDefaultTextBuffer(parameterIndex),
+            SUPLA_SUPLET_MAX_PARAMETER_TEXT_SIZE);
+      }
+      if (value == 't') {
+        return beginLiteral("true");
+      }
+      if (value == 'f') {
+        return beginLiteral("false");
+      }
+      return beginNumber(value, true);
+    case Field::Channels:
+      if (value != '[') {
+        return false;
+      }
+      definition->channelCount = 0;
+      return push(Frame::Channels, Expect::FirstValueOrEnd);
+    case Field::Parameters:
+      if (value != '[') {
+        return false;
+      }
+      definition->parameterCount = 0;
+      return push(Frame::Parameters, Expect::FirstValueOrEnd);
+    case Field::Values: {
+      char *buffer = output->getParameterEnumValuesBuffer(parameterIndex);
+      if (value != '[' || buffer == nullptr) {
+        return false;
+      }
+      buffer[0] = '\0';
+      enumValuesLength = 0;
+      return push(Frame::EnumValues, Expect::FirstValueOrEnd);
+    }
+    case Field::Channel: {
+      if (value != '{' ||
+          channelIndex >= SUPLA_SUPLET_MAX_CHANNELS_PER_INSTANCE) {
+        return false;
+      }
+      auto channel = output->getChannel(channelIndex);
+      channel->channelId = kInvalidChannelId;
+      channel->kind = ChannelKind::Unknown;
+      channel->defaultFunction = 0;
+      channel->caption = nullptr;
+      return push(Frame::Channel, Expect::FirstKeyOrEnd);
+    }
+    case Field::Parameter: {
+      if (value != '{' || parameterIndex >= SUPLA_SUPLET_MAX_PARAMETERS) {
+        return false;
+      }
+      auto parameter = output->getParameter(parameterIndex);
+      *parameter = ParameterDefinition();
+      parameter->min = INT32_MIN;
+      parameter->max = INT32_MAX;
+      return push(Frame::Parameter, Expect::FirstKeyOrEnd);
+    }
+  }
+  return false;
+}
+
+bool JsonDefinitionStreamParser::beginString(char *buffer, size_t bufferSize) {
+  if (buffer == nullptr || bufferSize == 0) {
+    return false;
+  }
+  token = Token::String;
+  text = buffer;
+  textSize = bufferSize;
+  textLength = 0;
+  escape = false;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::beginSkippedString() {
+  token = Token::String;
+  text = nullptr;
+  textSize = 0;
+  textLength = 0;
+  escape = false;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::beginNumber(char value, bool allowNegative) {
+  token = Token::Number;
+  number = 0;
+  negative = false;
+  hasDigits = false;
+  if (value == '-' && allowNegative) {
+    negative = true;
+    return true;
+  }
+  if (isDigit(value)) {
+    number = static_cast<uint32_t>(value - '0');
+    hasDigits = true;
+    return true;
+  }
+  return false;
+}
+
+bool JsonDefinitionStreamParser::beginLiteral(const char *expected) {
+  token = Token::Literal;
+  literal = expected;
+  literalPos = 1;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::push(Frame frame, Expect next) {
+  if (depth >= SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH) {
+    return false;
+  }
+  stack[depth++] = frame;
+  expect = next;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::endContainer(Frame frame) {
+  if (depth == 0 || top() != frame) {
+    return false;
+  }
+  depth--;
+
+  Definition *definition = output->getDefinition();
+  switch (frame) {
+    case Frame::Root:
+      expect = Expect::Done;
+      return true;
+    case Frame::Channel: {
+      auto channel = output->getChannel(definition->channelCount);
+      if (channel->channelId == kInvalidChannelId ||
+          channel->kind == ChannelKind::Unknown) {
+        return false;
+      }
+      definition->channelCount++;
+      break;
+    }
+    case Frame::Parameter: {
+      auto parameter = output->getParameter(definition->parameterCount);
+      if (parameter->key == nullptr || parameter->key[0] == '\0' ||
+          parameter->type == ParameterType::Unknown ||
+          parameter->min > parameter->max) {
+        return false;
+      }
+      definition->parameterCount++;
+      break;
+    }
+    case Frame::EnumValues:
+      output->getParameter(definition->parameterCount)->enumValues =
+          output->getParameterEnumValuesBuffer(definition->parameterCount);
+      break;
+    case Frame::Channels:
+    case Frame::Parameters:
+    case Frame::SkipObject:
+    case Frame::SkipArray:
+      break;
+  }
+  return endValue();
+}
+
+bool JsonDefinitionStreamParser::endKey() {
+  expect = Expect::Colon;
+  field = top() == Frame::SkipObject ? Field::Skip : findField(scratch);
+  return true;
+}
+
+bool JsonDefinitionStreamParser::endString() {
+  token = Token::None;
+  if (text != nullptr) {
+    text[textLength] = '\0';
+  }
+  if (expect == Expect::Key) {
+    return endKey();
+  }
+
+  Definition *definition = output->getDefinition();
+  auto channel = output->getChannel(definition->channelCount);
+  auto parameter = output->getParameter(definition->parameterCount);
+  switch (valueField) {
+    case Field::Category:
+      if (!JsonDefinitionParser::parseCategory(scratch,
+                                               &definition->category)) {
+        return false;
+      }
+      break;
+    case Field::Kind:
+      if (!JsonDefinitionParser::parseKind(scratch, &definition->kind)) {
+        return false;
+      }
+      break;
+    case Field::ChannelKind:
+      if (!JsonDefinitionParser::parseChannelKind(scratch, &channel->kind)) {
+        return false;
+      }
+      break;
+    case Field::Function:
+      if (!JsonDefinitionParser::parseDefaultFunction(
+              scratch, &channel->defaultFunction)) {
+        return false;
+      }
+      break;
+    case Field::Caption:
+      channel->caption = text;
+      break;
+    case Field::ParameterKey:
+      parameter->key = text;
+      break;
+    case Field::ParameterType:
+      if (!JsonDefinitionParser::parseParameterType(scratch,
+                                                    &parameter->type)) {
+        return false;
+      }
+      break;
+    case Field::Lifecycle:
+      if (!JsonDefinitionParser::parseParameterLifecycle(
+              scratch, &parameter->lifecycle)) {
+        return false;
+      }
+      break;
+    case Field::Default:
+      parameter->defaultText = text;
+      break;
+    case Field::EnumValue:
+      if (!appendEnumValue()) {
+        return false;
+      }
+      break;
+    default:
+      break;
+  }
+  return endValue();
+}
+
+bool JsonDefinitionStreamParser::endNumber() {
+  token = Token::None;
+  Definition *definition = output->getDefinition();
+  auto channel = output->getChannel(definition->channelCount);
+  auto parameter = output->getParameter(definition->parameterCount);
+  switch (valueField) {
+    case Field::Skip: {
+      int32_t ignored = 0;
+      if (!readInt32(&ignored)) {
+        return false;
+      }
+      break;
+    }
+    case Field::SchemaVersion:
+      if (!readUInt8(&definition->schemaVersion)) {
+        return false;
+      }
+      break;
+    case Field::HandlerVersion:
+      if (!readUInt8(&definition->handlerVersion)) {
+        return false;
+      }
+      break;
+    case Field::DefinitionId:
+      definition->definitionId = number;
+      break;
+    case Field::DefinitionVersion:
+      if (number > UINT16_MAX) {
+        return false;
+      }
+      definition->definitionVersion = static_cast<uint16_t>(number);
+      break;
+    case Field::MaxInstances:
+      if (!readUInt8(&definition->maxInstances) ||
+          definition->maxInstances == 0) {
+        return false;
+      }
+      break;
+    case Field::ChannelId:
+      if (!readUInt8(&channel->channelId) ||
+          channel->channelId == kInvalidChannelId) {
+        return false;
+      }
+      break;
+    case Field::DefaultFunction:
+      if (!readInt32(&channel->defaultFunction)) {
+        return false;
+      }
+      break;
+    case Field::Min:
+      if (!readInt32(&parameter->min)) {
+        return false;
+      }
+      break;
+    case Field::Max:
+      if (!readInt32(&parameter->max)) {
+        return false;
+      }
+      break;
+    case Field::Default:
+      if (!readInt32(&parameter->defaultNumber)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  return endValue();
+}
+
+bool JsonDefinitionStreamParser::endLiteral() {
+  token = Token::None;
+  const bool value = (literal[0] == 't');
+  Definition *definition = output->getDefinition();
+  auto parameter = output->getParameter(definition->parameterCount);
+  switch (valueField) {
+    case Field::Skip:
+      break;
+    case Field::Required:
+      parameter->required = value ? 1 : 0;
+      break;
+    case Field::AffectsTopology:
+      parameter->affectsTopology = value ? 1 : 0;
+      break;
+    case Field::Default:
+      parameter->defaultNumber = value ? 1 : 0;
+      break;
+    default:
+      return false;
+  }
+  return endValue();
+}
+
+bool JsonDefinitionStreamParser::endValue() {
+  expect = Expect::CommaOrEnd;
+  return true;
+}
+
+bool JsonDefinitionStreamParser::appendEnumValue() {
+  char *buffer = output->getParameterEnumValuesBuffer(
+      output->getDefinition()->parameterCount);
+  const size_t needed = textLength + (enumValuesLength == 0 ? 0 : 1);
+  if (buffer == nullptr ||
+      enumValuesLength + needed + 1 > SUPLA_SUPLET_MAX_PARAMETER_TEXT_SIZE) {
+    return false;
+  }
+  if (enumValuesLength != 0) {
+    buffer[enumValuesLength++] = ',';
+  }
+  memcpy(buffer + enumValuesLength, scratch, textLength);
+  enumValuesLength += textLength;
+  buffer[enumValuesLength] = '\0';
+  return true;
+}
+
+bool JsonDefinitionStreamParser::readInt32(int32_t *value) const {
+  if ((!negative && number > static_cast<uint32_t>(INT32_MAX)) ||
+      (negative && number > static_cast<uint32_t>(INT32_MAX) + 1)) {
+    return false;
+  }
+  *value = static_cast<int32_t>(negative ? -static_cast<int64_t>(number)
+                                         : static_cast<int64_t>(number));
+  return true;
+}
+
+bool JsonDefinitionStreamParser::readUInt8(uint8_t *value) const {
+  if (negative || number > UINT8_MAX) {
+    return false;
+  }
+  *value = static_cast<uint8_t>(number);
+  return true;
+}
+
+JsonDefinitionStreamParser::Field JsonDefinitionStreamParser::currentField()
+    const {
+  switch (top()) {
+    case Frame::SkipObject:
+    case Frame::SkipArray:
+      return Field::Skip;
+    case Frame::EnumValues:
+      return Field::EnumValue;
+    case Frame::Channels:
+      return Field::Channel;
+    case Frame::Parameters:
+      return Field::Parameter;
+    case Frame::Root:
+    case Frame::Channel:
+    case Frame::Parameter:
+      break;
+  }
+  return field;
+}
+
+JsonDefinitionStreamParser::Frame JsonDefinitionStreamParser::top() const {
+  return depth > 0 ? stack[depth - 1] : Frame::Root;
+}
+
+bool JsonDefinitionStreamParser::isObject(Frame frame) const {
+  return frame == Frame::Root || frame == Frame::Channel ||
+         frame == Frame::Parameter || frame == Frame::SkipObject;
+}
+
+JsonDefinitionStreamParser::Field JsonDefinitionStreamParser::findField(
+    const char *key) const {
+  switch (top()) {
+    case Frame::Root:
+      if (equalText(key, "schemaVersion", "sv")) {
+        return Field::SchemaVersion;
+      } else if (equalText(key, "handlerVersion", "hv")) {
+        return Field::HandlerVersion;
+      } else if (equalText(key, "definitionId", "di")) {
+        return Field::DefinitionId;
+      } else if (equalText(key, "definitionVersion", "dv")) {
+        return Field::DefinitionVersion;
+      } else if (equalText(key, "maxInstances", "mi")) {
+        return Field::MaxInstances;
+      } else if (equalText(key, "category", "c")) {
+        return Field::Category;
+      } else if (equalText(key, "kind", "k")) {
+        return Field::Kind;
+      } else if (equalText(key, "name", "n")) {
+        return Field::Name;
+      } else if (equalText(key, "channels", "ch")) {
+        return Field::Channels;
+      } else if (equalText(key, "parameters", "p")) {
+        return Field::Parameters;
+      }
+      break;
+    case Frame::Channel:
+      if (equalText(key, "channelId", "id")) {
+        return Field::ChannelId;
+      } else if (equalText(key, "kind", "k")) {
+        return Field::ChannelKind;
+      } else if (equalText(key, "defaultFunction", "df")) {
+        return Field::DefaultFunction;
+      } else if (equalText(key, "function", "fn")) {
+        return Field::Function;
+      } else if (equalText(key, "caption", "cap")) {
+        return Field::Caption;
+      }
+      break;
+    case Frame::Parameter:
+      if (equalText(key, "key")) {
+        return Field::ParameterKey;
+      } else if (equalText(key, "type", "t")) {
+        return Field::ParameterType;
+      } else if (equalText(key, "lifecycle", "lc")) {
+        return Field::Lifecycle;
+      } else if (equalText(key, "required", "r")) {
+        return Field::Required;
+      } else if (equalText(key, "affectsTopology", "at")) {
+        return Field::AffectsTopology;
+      } else if (equalText(key, "min")) {
+        return Field::Min;
+      } else if (equalText(key, "max")) {
+        return Field::Max;
+      } else if (equalText(key, "default", "d")) {
+        return Field::Default;
+      } else if (equalText(key, "values", "v")) {
+        return Field::Values;
+      }
+      break;
+    default:
+      break;
+  }
+  return Field::Skip;
+}
+
+}  // namespace Suplet
+}  // namespace Supla
+
+#endif  // SUPLA_SUPLET_ENABLED
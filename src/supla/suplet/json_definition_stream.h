@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: AC SOFTWARE SP. Z O.O.
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef SRC_SUPLA_SUPLET_JSON_DEFINITION_STREAM_H_
+#define SRC_SUPLA_SUPLET_JSON_DEFINITION_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <supla/suplet/json_definition.h>
+
+#ifndef SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH
+#define SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH 8
+#endif
+
+namespace Supla {
+namespace Suplet {
+
+/**
+ * Push parser for suplet definition JSON. It accepts the same documents as
+ * JsonDefinitionParser::parse, but text may be delivered in chunks of any
+ * size (e.g. DefinitionCache chunks one at a time), so the whole JSON
+ * doesn't have to be kept in RAM. Definition is filled in place while
+ * parsing and parser state has fixed size.
+ *
+ * Values of unknown keys may be nested up to SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH
+ * levels (root object included). Deeper documents are rejected.
+ *
+ * Usage:
+ *   parser.begin(&definition);
+ *   for each chunk: if (!parser.feed(chunk, size)) -> error
+ *   if (!parser.finish()) -> error
+ */
+class JsonDefinitionStreamParser {
+ public:
+  JsonDefinitionStreamParser();
+
+  // Clears output and starts parsing of a new document.
+  void begin(JsonDefinition *output);
+  // Returns false when data is invalid. Following calls fail until begin().
+  // Text ends at first '\0' character, remaining data is ignored.
+  bool feed(const char *data, size_t size);
+  // Returns true when whole document was parsed and definition is valid.
+  bool finish();
+
+ private:
+  enum class Frame : uint8_t {
+    Root,
+    Channels,
+    Channel,
+    Parameters,
+    Parameter,
+    EnumValues,
+    SkipObject,
+    SkipArray,
+  };
+
+  enum class Expect : uint8_t {
+    Root,
+    FirstKeyOrEnd,
+    Key,
+    Colon,
+    FirstValueOrEnd,
+    Value,
+    CommaOrEnd,
+    Done,
+  };
+
+  enum class Token : uint8_t {
+    None,
+    String,
+    Number,
+    Literal,
+  };
+
+  enum class Field : uint8_t {
+    Skip,
+    SchemaVersion,
+    HandlerVersion,
+    DefinitionId,
+    DefinitionVersion,
+    MaxInstances,
+    Category,
+    Kind,
+    Name,
+    Channels,
+    Parameters,
+    Channel,
+    ChannelId,
+    ChannelKind,
+    DefaultFunction,
+    Function,
+    Caption,
+    Parameter,
+    ParameterKey,
+    ParameterType,
+    Lifecycle,
+    Required,
+    AffectsTopology,
+    Min,
+    Max,
+    Default,
+    Values,
+    EnumValue,
+  };
+
+  // Keys and values like category or kind are read into scratch. Known
+  // values are shorter than kKeySize, so longer ones are rejected early.
+  static constexpr size_t kKeySize = 24;
+  static constexpr size_t kScratchSize =
+      SUPLA_SUPLET_MAX_PARAMETER_KEY_SIZE > kKeySize
+          ? SUPLA_SUPLET_MAX_PARAMETER_KEY_SIZE
+          : kKeySize;
+
+  bool step(char value);
+  bool stepString(char value);
+  bool stepNumber(char value, bool *consumed);
+  bool stepLiteral(char value);
+  bool beginValue(char value);
+  bool beginString(char *buffer, size_t bufferSize);
+  bool beginSkippedString();
+  bool beginNumber(char value, bool allowNegative);
+  bool beginLiteral(const char *expected);
+  bool push(Frame frame, Expect next);
+  bool endContainer(Frame frame);
+  bool endKey();
+  bool endString();
+  bool endNumber();
+  bool endLiteral();
+  bool endValue();
+  bool appendEnumValue();
+  bool readInt32(int32_t *value) const;
+  bool readUInt8(uint8_t *value) const;
+  Field currentField() const;
+  Frame top() const;
+  bool isObject(Frame frame) const;
+  Field findField(const char *key) const;
+
+  JsonDefinition *output = nullptr;
+  Frame stack[SUPLA_SUPLET_JSON_STREAM_MAX_DEPTH] = {};
+  uint8_t depth = 0;
+  Expect expect = Expect::Root;
+  Field field = Field::Skip;
+  Field valueField = Field::Skip;
+  Token token = Token::None;
+  bool failed = false;
+  bool terminated = false;
+
+  // String token: characters are written directly to the target buffer.
+  // When target is nullptr, string is validated and dropped.
+  char *text = nullptr;
+  size_t textSize = 0;
+  size_t textLength = 0;
+  bool escape = false;
+  char scratch[kScratchSize] = {};
+
+  // Number token
+  uint32_t number = 0;
+  bool negative = false;
+  bool hasDigits = false;
+
+  // Literal token
+  const char *literal = nullptr;
+  uint8_t literalPos = 0;
+
+  size_t enumValuesLength = 0;
+};
+
+}  // namespace Suplet
+}  // namespace Supla
+
+#endif  // SRC_SUPLA_SUPLET_JSON_DEFINITION_STREAM_H_
@@ -9,6 +9,8 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <supla/suplet/binary_definition.h>
+#include <supla/suplet/json_definition_stream.h>
 #include <supla/suplet/json_instance_config.h>
 #include <supla/suplet/server_config.h>
 
@@ -867,7 +869,7 @@ bool isInstanceLimitAvailable(const Supla::Suplet::Manager *manager,
 const Supla::Suplet::Definition *findDefinitionOnDemand(
     const Supla::Suplet::Registry *registry,
     const Supla::Suplet::DownloadedDefinitionStore *downloadedDefinitions,
-    const Supla::Suplet::DefinitionCache *definitionCache,
+    Supla::Suplet::DefinitionCache *definitionCache,
     uint32_t definitionId,
     uint16_t definitionVersion,
     ScopedJsonDefinition *downloadedDefinition,
@@ -905,7 +907,7 @@ const Supla::Suplet::Definition *findDefinitionOnDemand(
     return nullptr;
   }
   if (downloadedDefinition->get() == nullptr ||
-      !downloadedDefinitions->load(*definitionCache,
+      !downloadedDefinitions->load(definitionCache,
                                    definitionId,
                                    definitionVersion,
                                    downloadedDefinition->get())) {
@@ -988,17 +990,66 @@ bool findCachedDefinitionAndRepair(Supla::Suplet::DefinitionCache *cache,
   return false;
 }
 
+constexpr uint16_t kMaxCompiledDefinitionSize =
+    SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE;
+
+// Failure isn't an error - definition is parsed from JSON on next load then
+void saveCompiledDefinition(Supla::Suplet::DefinitionCache *cache,
+                            const Supla::Suplet::Definition &definition,
+                            const uint8_t *sha256) {
+  if (cache == nullptr || sha256 == nullptr) {
+    return;
+  }
+  uint8_t *image = new uint8_t[kMaxCompiledDefinitionSize];
+  if (image == nullptr) {
+    return;
+  }
+  uint16_t imageSize = Supla::Suplet::BinaryDefinition::encode(
+      definition, image, kMaxCompiledDefinitionSize);
+  if (imageSize > 0) {
+    cache->saveCompiled(definition.definitionId,
+                        definition.definitionVersion,
+                        sha256,
+                        image,
+                        imageSize);
+  }
+  delete[] image;
+}
+
+bool loadCompiledDefinition(const Supla::Suplet::DefinitionCache &cache,
+                            uint32_t definitionId,
+                            uint16_t definitionVersion,
+                            Supla::Suplet::JsonDefinition *definition) {
+  uint8_t *image = new uint8_t[kMaxCompiledDefinitionSize];
+  if (image == nullptr) {
+    return false;
+  }
+  uint16_t imageSize = 0;
+  bool result =
+      cache.loadCompiled(definitionId,
+                         definitionVersion,
+                         image,
+                         kMaxCompiledDefinitionSize,
+                         &imageSize) &&
+      Supla::Suplet::BinaryDefinition::decode(image, imageSize, definition) &&
+      definition->getDefinition()->definitionId == definitionId &&
+      definition->getDefinition()->definitionVersion == definitionVersion;
+  delete[] image;
+  return result;
+}
+
 }  // namespace
 
 namespace Supla {
 namespace Suplet {
 
-bool DownloadedDefinitionStore::load(const DefinitionCache &cache,
+bool DownloadedDefinitionStore::load(DefinitionCache *cache,
                                      uint32_t definitionId,
                                      uint16_t definitionVersion,
                                      JsonDefinition *definition,
                                      CachedDefinitionInfo *info) const {
-  if (definition == nullptr || definitionId == 0 || definitionVersion == 0) {
+  if (cache == nullptr || definition == nullptr || definitionId == 0 ||
+      definitionVersion == 0) {
     return false;
   }
 
@@ -1007,7 +1058,7 @@ bool DownloadedDefinitionStore::load(const DefinitionCache &cache,
   uint16_t jsonSize = 0;
   for (uint8_t i = 0; i < SUPLA_SUPLET_MAX_CACHED_DEFINITIONS; i++) {
     CachedDefinitionInfo current = {};
-    if (!cache.getInfoAndRepair(i, &current) ||
+    if (!cache->getInfoAndRepair(i, &current) ||
         current.definitionId != definitionId ||
         current.definitionVersion != definitionVersion) {
       continue;
@@ -1020,19 +1071,31 @@ bool DownloadedDefinitionStore::load(const DefinitionCache &cache,
     return false;
   }
 
+  if (loadCompiledDefinition(
+          *cache, definitionId, definitionVersion, definition)) {
+    return true;
+  }
+
   char *json = new char[static_cast<size_t>(jsonSize) + 1];
   if (json == nullptr) {
     return false;
   }
 
-  bool result = cache.load(definitionId,
-                           definitionVersion,
-                           json,
-                           static_cast<size_t>(jsonSize) + 1,
-                           infoOutput) &&
+  bool result = cache->load(definitionId,
+                            definitionVersion,
+                            json,
+                            static_cast<size_t>(jsonSize) + 1,
+                            infoOutput) &&
                 JsonDefinitionParser::parse(json, definition) &&
                 Runtime::validateDefinition(*definition->getDefinition());
   delete[] json;
+  if (result) {
+    // missing or outdated compiled image is repaired like other cache
+    // entries, so JSON is parsed again only after its digest changes
+    saveCompiledDefinition(cache,
+                           *definition->getDefinition(),
+                           infoOutput->sha256);
+  }
   return result;
 }
 
@@ -1054,7 +1117,7 @@ bool ServerConfigHandler::loadDownloadedDefinition(
     JsonDefinition *definition,
     CachedDefinitionInfo *info) const {
   return definitionCache != nullptr && downloadedDefinitions != nullptr &&
-         downloadedDefinitions->load(*definitionCache,
+         downloadedDefinitions->load(definitionCache,
                                      definitionId,
                                      definitionVersion,
                                      definition,
@@ -1089,7 +1152,7 @@ ServerConfigResult ServerConfigHandler::loadDownloadedDefinitions() {
     if (!definition.allocate()) {
       return ServerConfigResult::StorageError;
     }
-    if (!downloadedDefinitions->load(*definitionCache,
+    if (!downloadedDefinitions->load(definitionCache,
                                      info.definitionId,
                                      info.definitionVersion,
                                      definition.get())) {
@@ -1152,6 +1215,8 @@ ServerConfigResult ServerConfigHandler::saveDownloadedDefinition(
               definitionId, definitionVersion, definitionJson, sha256)) {
         return ServerConfigResult::StorageError;
       }
+      saveCompiledDefinition(
+          definitionCache, *parsed.get()->getDefinition(), sha256);
       runtimeRefreshRequired = true;
       return ServerConfigResult::Applied;
     }
@@ -1163,6 +1228,8 @@ ServerConfigResult ServerConfigHandler::saveDownloadedDefinition(
           definitionId, definitionVersion, definitionJson, sha256)) {
     return ServerConfigResult::StorageError;
   }
+  saveCompiledDefinition(
+      definitionCache, *parsed.get()->getDefinition(), sha256);
 
   runtimeRefreshRequired = true;
   return ServerConfigResult::Applied;
@@ -1226,35 +1293,42 @@ ServerConfigResult ServerConfigHandler::commitStagedDownloadedDefinition(
     return ServerConfigResult::DefinitionCannotBeChanged;
   }
 
-  char *definitionJson = new char[static_cast<size_t>(jsonSize) + 1];
-  if (definitionJson == nullptr) {
+  ScopedJsonDefinition parsed;
+  if (!parsed.allocate()) {
     return ServerConfigResult::StorageError;
   }
 
-  bool loaded = definitionCache->loadStaged(handle,
-                                            definitionId,
-                                            definitionVersion,
-                                            definitionJson,
-                                            static_cast<size_t>(jsonSize) + 1);
-  if (!loaded) {
-    delete[] definitionJson;
+  // Staged JSON is parsed chunk by chunk, so only one chunk is kept in RAM
+  const uint16_t chunkBufferSize = SUPLA_SUPLET_DEFINITION_CACHE_CHUNK_SIZE;
+  char *chunk = new char[chunkBufferSize];
+  if (chunk == nullptr) {
     return ServerConfigResult::StorageError;
   }
 
-  ScopedJsonDefinition parsed;
-  if (!parsed.allocate()) {
-    delete[] definitionJson;
-    return ServerConfigResult::StorageError;
+  JsonDefinitionStreamParser parser;
+  parser.begin(parsed.get());
+  bool loaded = true;
+  bool valid = true;
+  uint16_t chunkIndex = 0;
+  for (uint32_t offset = 0; loaded && offset < jsonSize;
+       offset += chunkBufferSize, chunkIndex++) {
+    uint16_t chunkSize = 0;
+    loaded = definitionCache->loadStagedChunk(
+        handle, jsonSize, chunkIndex, chunk, chunkBufferSize, &chunkSize);
+    if (loaded && valid) {
+      valid = parser.feed(chunk, chunkSize);
+    }
   }
+  delete[] chunk;
 
-  if (!JsonDefinitionParser::parse(definitionJson, parsed.get()) ||
+  if (!loaded) {
+    return ServerConfigResult::StorageError;
+  }
+  if (!valid || !parser.finish() ||
       parsed.get()->getDefinition()->definitionId != definitionId ||
-      parsed.get()->getDefinition()->definitionVersion != definitionVersion ||
-      !Runtime::validateDefinition(*parsed.get()->getDefinition())) {
-    delete[] definitionJson;
+      parsed.get()->getDefinition()->definitionVersion != definitionVersion) {
     return ServerConfigResult::InvalidDefinition;
   }
-  delete[] definitionJson;
 
   CachedDefinitionInfo info = {};
   if (findCachedDefinitionAndRepair(
@@ -1271,6 +1345,8 @@ ServerConfigResult ServerConfigHandler::commitStagedDownloadedDefinition(
           handle, definitionId, definitionVersion, jsonSize, sha256)) {
     return ServerConfigResult::StorageError;
   }
+  saveCompiledDefinition(
+      definitionCache, *parsed.get()->getDefinition(), sha256);
 
   runtimeRefreshRequired = true;
   return ServerConfigResult::Applied;
@@ -1345,7 +1421,7 @@ bool ServerConfigHandler::getCachedDefinitionDetails(
     if (!parsed.allocate()) {
       return false;
     }
-    if (!downloadedDefinitions->load(*definitionCache,
+    if (!downloadedDefinitions->load(definitionCache,
                                      info.definitionId,
                                      info.definitionVersion,
                                      parsed.get(),
@@ -44,7 +44,8 @@ struct CachedDefinitionDetails {
 
 class DownloadedDefinitionStore {
  public:
-  bool load(const DefinitionCache &cache,
+  // Missing or outdated compiled image of parsed JSON is saved to cache
+  bool load(DefinitionCache *cache,
             uint32_t definitionId,
             uint16_t definitionVersion,
             JsonDefinition *definition,
@@ -222,7 +222,12 @@ bool Storage::load(InstanceTable *table) {
 
   table->clear();
   bool loadedAny = false;
+  InstanceIdSet storedIds = {};
+  findStoredInstanceIds(&storedIds);
   for (uint16_t i = 1; i <= SUPLA_SUPLET_MAX_INSTANCE_ID; i++) {
+    if (!hasInstanceId(storedIds, static_cast<uint8_t>(i))) {
+      continue;
+    }
     InstanceRecord record = {};
     if (loadInstance(static_cast<uint8_t>(i), &record)) {
       if (!table->add(record)) {
@@ -242,7 +247,12 @@ bool Storage::loadIndex(InstanceTable *table) {
 
   table->clear();
   bool loadedAny = false;
+  InstanceIdSet storedIds = {};
+  findStoredInstanceIds(&storedIds);
   for (uint16_t i = 1; i <= SUPLA_SUPLET_MAX_INSTANCE_ID; i++) {
+    if (!hasInstanceId(storedIds, static_cast<uint8_t>(i))) {
+      continue;
+    }
     InstanceRecord record = {};
     uint8_t activeVariant = kDeletedSlot;
     if (loadActiveVariant(
@@ -296,9 +306,12 @@ bool Storage::save(const InstanceTable &table) {
     present[record->instanceId] = true;
   }
 
+  InstanceIdSet storedIds = {};
+  findStoredInstanceIds(&storedIds);
   for (uint16_t i = 1; i <= SUPLA_SUPLET_MAX_INSTANCE_ID; i++) {
     uint8_t instanceId = static_cast<uint8_t>(i);
-    if (!present[instanceId] && slotExists(instanceId)) {
+    if (!present[instanceId] && hasInstanceId(storedIds, instanceId) &&
+        slotExists(instanceId)) {
       eraseInstance(instanceId);
     }
   }
@@ -309,9 +322,11 @@ bool Storage::erase() {
   if (config == nullptr) {
     return false;
   }
+  InstanceIdSet storedIds = {};
+  findStoredInstanceIds(&storedIds);
   for (uint16_t i = 1; i <= SUPLA_SUPLET_MAX_INSTANCE_ID; i++) {
     uint8_t instanceId = static_cast<uint8_t>(i);
-    if (slotExists(instanceId)) {
+    if (hasInstanceId(storedIds, instanceId) && slotExists(instanceId)) {
       eraseInstance(instanceId);
     }
   }
@@ -596,6 +611,28 @@ bool Storage::cleanupLoadedInstance(uint8_t instanceId,
   return true;
 }
 
+void Storage::findStoredInstanceIds(InstanceIdSet *ids) const {
+  if (!config->isKeyIterationSupported()) {
+    memset(*ids, 0xFF, sizeof(*ids));
+    return;
+  }
+  memset(*ids, 0, sizeof(*ids));
+  // all keys of instance are generated with "splt_" prefixed tags
+  Supla::ConfigKeyCursor cursor;
+  cursor.setTag("splt_", false);
+  for (bool found = config->findFirstKey(&cursor); found;
+       found = config->findNextKey(&cursor)) {
+    int instanceId = cursor.getNumber();
+    if (instanceId >= 1 && instanceId <= SUPLA_SUPLET_MAX_INSTANCE_ID) {
+      (*ids)[instanceId / 8] |= (1 << (instanceId % 8));
+    }
+  }
+}
+
+bool Storage::hasInstanceId(const InstanceIdSet &ids, uint8_t instanceId) {
+  return (ids[instanceId / 8] & (1 << (instanceId % 8))) != 0;
+}
+
 bool Storage::slotExists(uint8_t instanceId) const {
   if (config == nullptr || instanceId == 0) {
     return false;
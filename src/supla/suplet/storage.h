@@ -103,6 +103,11 @@ class Storage {
   bool cleanupLoadedInstance(uint8_t instanceId,
                              uint8_t activeVariant,
                              uint8_t loadedVariant);
+  typedef uint8_t InstanceIdSet[(SUPLA_SUPLET_MAX_INSTANCE_ID + 8) / 8];
+  // Marks instance ids which have any key stored in config. When config
+  // can't enumerate keys, all ids are marked.
+  void findStoredInstanceIds(InstanceIdSet *ids) const;
+  static bool hasInstanceId(const InstanceIdSet &ids, uint8_t instanceId);
   bool slotExists(uint8_t instanceId) const;
   void makeActKey(uint8_t instanceId, char *output) const;
   void makeHeaderKey(uint8_t instanceId, uint8_t variant, char *output) const;
@@ -18,6 +18,10 @@ uint32_t millis(void) {
   return xTaskGetTickCount();
 }
 
+uint32_t micros(void) {
+  return xTaskGetTickCount() * portTICK_PERIOD_MS * 1000;
+}
+
 void delay(uint64_t delayMs) {
 // TODO(klew):  usleep(delayMs * 1000);
 }
@@ -31,12 +35,17 @@ void delayMicroseconds(uint64_t delayMicro) {
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <unistd.h>
+#include <esp_attr.h>
 #include <esp_timer.h>
 
 uint32_t millis(void) {
   return static_cast<uint64_t>(esp_timer_get_time()) / 1000ULL;
 }
 
+uint32_t IRAM_ATTR micros(void) {
+  return static_cast<uint64_t>(esp_timer_get_time());
+}
+
 void delay(uint64_t delayMs) {
   usleep(delayMs * 1000);
 }
@@ -57,6 +66,12 @@ uint32_t millis() {
     .count();
 }
 
+uint32_t micros() {
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+    .count();
+}
+
 void delay(uint64_t v) {
   std::this_thread::sleep_for(std::chrono::milliseconds(v));
 }
@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 uint32_t millis(void);
+uint32_t micros(void);
 void delay(uint64_t);
 void delayMicroseconds(uint64_t);
 